@@ -0,0 +1,925 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "next.h"
+#include "next_platform.h"
+#include "next_address.h"
+#include "next_crypto.h"
+#include "next_stream.h"
+#include "next_serialize.h"
+#include "next_packets.h"
+#include "next_fast_serialize.h"
+#include "next_header.h"
+#include "next_packet_filter.h"
+#include "next_replay_protection.h"
+#include "next_packet_loss_tracker.h"
+#include "next_out_of_order_tracker.h"
+#include "next_jitter_tracker.h"
+#include "next_ping_history.h"
+#include "next_session_manager.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const double BenchSeconds = 0.1;
+const int BenchBatch = 1000;
+const int BenchMaxResults = 1024;
+
+extern int next_signed_packets[256];
+extern int next_encrypted_packets[256];
+
+static uint8_t bench_buffer[NEXT_MAX_PACKET_BYTES];
+
+static uint8_t bench_magic[8];
+static uint8_t bench_from_address[4];
+static uint8_t bench_to_address[4];
+static uint8_t bench_session_private_key[NEXT_SESSION_PRIVATE_KEY_BYTES];
+static uint8_t bench_sign_public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+static uint8_t bench_sign_private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+
+struct bench_result_t
+{
+    char name[64];
+    char path[16];
+    int bytes;
+    int iterations;
+    double ns;
+    double mb_per_second;
+};
+
+static bool bench_json = false;
+static int bench_num_results = 0;
+static bench_result_t bench_results[BenchMaxResults];
+
+static void bench_clobber( const void * pointer )
+{
+    // IMPORTANT: stops the compiler hoisting or discarding serialize work whose result is otherwise unused
+#if defined(__GNUC__)
+    asm volatile( "" : : "g"( pointer ) : "memory" );
+#else // #if defined(__GNUC__)
+    static const void * volatile sink;
+    sink = pointer;
+#endif // #if defined(__GNUC__)
+}
+
+static void bench_print( const char * name, const char * path, int bytes, int iterations, double time )
+{
+    const double ns = time / iterations * 1000000000.0;
+    const double mb_per_second = ( double(bytes) * iterations ) / time / ( 1024.0 * 1024.0 );
+
+    if ( bench_num_results < BenchMaxResults )
+    {
+        bench_result_t * result = &bench_results[bench_num_results++];
+        next_copy_string( result->name, name, sizeof(result->name) );
+        next_copy_string( result->path, path, sizeof(result->path) );
+        result->bytes = bytes;
+        result->iterations = iterations;
+        result->ns = ns;
+        result->mb_per_second = mb_per_second;
+    }
+
+    if ( !bench_json )
+    {
+        printf( "%-40s %-8s %5d bytes %10.1f ns %10.1f MB/sec\n", name, path, bytes, ns, mb_per_second );
+    }
+}
+
+static void bench_print_json()
+{
+    printf( "{\n" );
+    printf( "    \"version\": \"%s\",\n", NEXT_VERSION_FULL );
+    printf( "    \"results\": [\n" );
+    for ( int i = 0; i < bench_num_results; ++i )
+    {
+        const bench_result_t * result = &bench_results[i];
+        printf( "        { \"name\": \"%s\", \"path\": \"%s\", \"bytes\": %d, \"iterations\": %d, \"ns\": %.1f, \"mb_per_second\": %.1f }%s\n", 
+            result->name, result->path, result->bytes, result->iterations, result->ns, result->mb_per_second, ( i < bench_num_results - 1 ) ? "," : "" );
+    }
+    printf( "    ]\n" );
+    printf( "}\n" );
+}
+
+template <typename F> void bench_run( const char * name, const char * path, int bytes, F function )
+{
+    // IMPORTANT: batches double in size up to BenchBatch so slow paths (eg. with memory checks) still finish in about BenchSeconds
+
+    int iterations = 0;
+    int batch = 1;
+    double start_time = next_platform_time();
+    double time = 0.0;
+    do
+    {
+        for ( int i = 0; i < batch; ++i )
+        {
+            function();
+        }
+        iterations += batch;
+        batch = ( batch * 2 < BenchBatch ) ? batch * 2 : BenchBatch;
+        time = next_platform_time() - start_time;
+    }
+    while ( time < BenchSeconds );
+    bench_print( name, path, bytes, iterations, time );
+}
+
+template <typename T> void bench_serialize( const char * name, T & packet )
+{
+    next::MeasureStream measure_stream;
+    if ( !packet.Serialize( measure_stream ) )
+    {
+        printf( "error: failed to measure %s\n", name );
+        exit( 1 );
+    }
+
+    const int bytes = measure_stream.GetBytesProcessed();
+
+    next_assert( bytes <= NEXT_MAX_PACKET_BYTES );
+
+    // IMPORTANT: each path runs in batches until it has run for at least BenchSeconds
+
+    int iterations = 0;
+    double start_time = next_platform_time();
+    double time = 0.0;
+    do
+    {
+        for ( int i = 0; i < BenchBatch; ++i )
+        {
+            bench_clobber( &packet );
+            next::WriteStream stream( bench_buffer, NEXT_MAX_PACKET_BYTES );
+            packet.Serialize( stream );
+            stream.Flush();
+            bench_clobber( bench_buffer );
+        }
+        iterations += BenchBatch;
+        time = next_platform_time() - start_time;
+    }
+    while ( time < BenchSeconds );
+    bench_print( name, "write", bytes, iterations, time );
+
+    static T read_packet;
+    iterations = 0;
+    start_time = next_platform_time();
+    do
+    {
+        for ( int i = 0; i < BenchBatch; ++i )
+        {
+            bench_clobber( bench_buffer );
+            next::ReadStream stream( bench_buffer, bytes );
+            if ( !read_packet.Serialize( stream ) )
+            {
+                printf( "error: failed to read %s\n", name );
+                exit( 1 );
+            }
+            bench_clobber( &read_packet );
+        }
+        iterations += BenchBatch;
+        time = next_platform_time() - start_time;
+    }
+    while ( time < BenchSeconds );
+    bench_print( name, "read", bytes, iterations, time );
+
+    iterations = 0;
+    start_time = next_platform_time();
+    do
+    {
+        for ( int i = 0; i < BenchBatch; ++i )
+        {
+            bench_clobber( &packet );
+            next::MeasureStream stream;
+            packet.Serialize( stream );
+            int bits = stream.GetBitsProcessed();
+            bench_clobber( &bits );
+        }
+        iterations += BenchBatch;
+        time = next_platform_time() - start_time;
+    }
+    while ( time < BenchSeconds );
+    bench_print( name, "measure", bytes, iterations, time );
+}
+
+template <typename T> void bench_fast_serialize( const char * name, T & packet )
+{
+    const int bytes = next::FastPacketSerializer<T>::Write( packet, bench_buffer );
+    if ( bytes < 0 )
+    {
+        printf( "error: failed to fast write %s\n", name );
+        exit( 1 );
+    }
+
+    int iterations = 0;
+    double start_time = next_platform_time();
+    double time = 0.0;
+    do
+    {
+        for ( int i = 0; i < BenchBatch; ++i )
+        {
+            bench_clobber( &packet );
+            next::FastPacketSerializer<T>::Write( packet, bench_buffer );
+            bench_clobber( bench_buffer );
+        }
+        iterations += BenchBatch;
+        time = next_platform_time() - start_time;
+    }
+    while ( time < BenchSeconds );
+    bench_print( name, "fwrite", bytes, iterations, time );
+
+    static T read_packet;
+    iterations = 0;
+    start_time = next_platform_time();
+    do
+    {
+        for ( int i = 0; i < BenchBatch; ++i )
+        {
+            bench_clobber( bench_buffer );
+            if ( !next::FastPacketSerializer<T>::Read( read_packet, bench_buffer, bytes ) )
+            {
+                printf( "error: failed to fast read %s\n", name );
+                exit( 1 );
+            }
+            bench_clobber( &read_packet );
+        }
+        iterations += BenchBatch;
+        time = next_platform_time() - start_time;
+    }
+    while ( time < BenchSeconds );
+    bench_print( name, "fread", bytes, iterations, time );
+}
+
+static void bench_random_bytes( uint8_t * data, int bytes )
+{
+    for ( int i = 0; i < bytes; ++i )
+        data[i] = uint8_t( rand() );
+}
+
+static uint64_t bench_random_uint64()
+{
+    uint64_t value = 0;
+    bench_random_bytes( (uint8_t*) &value, sizeof(value) );
+    return value;
+}
+
+const int BenchPacketCount = 64;
+
+template <typename T> void bench_packet( const char * name, uint8_t packet_id, T & packet )
+{
+    // IMPORTANT: measures the full wire path including packet filter bytes, signing or encryption and replay protection
+
+    const bool backend = packet_id >= NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET;
+
+    uint64_t write_sequence = 1;
+
+    auto write = [&]( uint8_t * packet_data, int * packet_bytes ) -> int
+    {
+        if ( backend )
+            return next_write_backend_packet( packet_id, &packet, packet_data, packet_bytes, next_signed_packets, bench_sign_private_key, bench_magic, bench_from_address, bench_to_address );
+        else
+            return next_write_packet( packet_id, &packet, packet_data, packet_bytes, next_signed_packets, next_encrypted_packets, &write_sequence, bench_sign_private_key, bench_session_private_key, bench_magic, bench_from_address, bench_to_address );
+    };
+
+    // IMPORTANT: reads decrypt in place and replay protection rejects repeated sequence numbers,
+    // so keep a set of packets with distinct sequence numbers and copy each one to scratch before reading it
+
+    static uint8_t packet_data[BenchPacketCount][NEXT_MAX_PACKET_BYTES];
+    static int packet_bytes[BenchPacketCount];
+    for ( int i = 0; i < BenchPacketCount; ++i )
+    {
+        if ( write( packet_data[i], &packet_bytes[i] ) != NEXT_OK )
+        {
+            printf( "error: failed to write packet %s\n", name );
+            exit( 1 );
+        }
+    }
+
+    const int bytes = packet_bytes[0];
+
+    bench_run( name, "pwrite", bytes, [&]()
+    {
+        bench_clobber( &packet );
+        int write_bytes = 0;
+        write( bench_buffer, &write_bytes );
+        bench_clobber( bench_buffer );
+    } );
+
+    static T read_packet;
+    static next_replay_protection_t replay_protection;
+    next_replay_protection_reset( &replay_protection );
+    int index = 0;
+
+    bench_run( name, "pread", bytes, [&]()
+    {
+        if ( index == 0 )
+        {
+            next_replay_protection_reset( &replay_protection );
+        }
+
+        memcpy( bench_buffer, packet_data[index], packet_bytes[index] );
+
+        int result;
+        if ( backend )
+        {
+            result = next_read_backend_packet( packet_id, bench_buffer, 18, packet_bytes[index], &read_packet, next_signed_packets, bench_sign_public_key );
+        }
+        else
+        {
+            uint64_t read_sequence = 0;
+            result = next_read_packet( packet_id, bench_buffer, 18, packet_bytes[index], &read_packet, next_signed_packets, next_encrypted_packets, &read_sequence, bench_sign_public_key, bench_session_private_key, &replay_protection );
+        }
+
+        if ( result != packet_id )
+        {
+            printf( "error: failed to read packet %s\n", name );
+            exit( 1 );
+        }
+
+        bench_clobber( &read_packet );
+
+        index = ( index + 1 ) % BenchPacketCount;
+    } );
+}
+
+void bench_packet_serialization()
+{
+    next_address_t address;
+    next_address_parse( &address, "127.0.0.1:50000" );
+
+    {
+        static NextUpgradeRequestPacket packet;
+        packet.protocol_version = next_protocol_version();
+        packet.session_id = bench_random_uint64();
+        packet.client_address = address;
+        packet.server_address = address;
+        bench_random_bytes( packet.server_kx_public_key, sizeof(packet.server_kx_public_key) );
+        bench_random_bytes( packet.upgrade_token, sizeof(packet.upgrade_token) );
+        bench_random_bytes( packet.upcoming_magic, 8 );
+        bench_random_bytes( packet.current_magic, 8 );
+        bench_random_bytes( packet.previous_magic, 8 );
+        bench_serialize( "NextUpgradeRequestPacket", packet );
+        bench_packet( "NextUpgradeRequestPacket", NEXT_UPGRADE_REQUEST_PACKET, packet );
+    }
+
+    {
+        static NextUpgradeResponsePacket packet;
+        packet.client_open_session_sequence = 10;
+        bench_random_bytes( packet.client_kx_public_key, sizeof(packet.client_kx_public_key) );
+        bench_random_bytes( packet.client_route_public_key, sizeof(packet.client_route_public_key) );
+        bench_random_bytes( packet.upgrade_token, sizeof(packet.upgrade_token) );
+        packet.platform_id = NEXT_PLATFORM_LINUX;
+        packet.connection_type = NEXT_CONNECTION_TYPE_WIRED;
+        bench_serialize( "NextUpgradeResponsePacket", packet );
+        bench_packet( "NextUpgradeResponsePacket", NEXT_UPGRADE_RESPONSE_PACKET, packet );
+    }
+
+    {
+        static NextUpgradeConfirmPacket packet;
+        packet.upgrade_sequence = bench_random_uint64();
+        packet.session_id = bench_random_uint64();
+        packet.server_address = address;
+        bench_random_bytes( packet.client_kx_public_key, sizeof(packet.client_kx_public_key) );
+        bench_random_bytes( packet.server_kx_public_key, sizeof(packet.server_kx_public_key) );
+        bench_serialize( "NextUpgradeConfirmPacket", packet );
+        bench_packet( "NextUpgradeConfirmPacket", NEXT_UPGRADE_CONFIRM_PACKET, packet );
+    }
+
+    {
+        static NextDirectPingPacket packet;
+        packet.ping_sequence = bench_random_uint64();
+        bench_serialize( "NextDirectPingPacket", packet );
+        bench_fast_serialize( "NextDirectPingPacket", packet );
+        bench_packet( "NextDirectPingPacket", NEXT_DIRECT_PING_PACKET, packet );
+    }
+
+    {
+        static NextDirectPongPacket packet;
+        packet.ping_sequence = bench_random_uint64();
+        bench_serialize( "NextDirectPongPacket", packet );
+        bench_fast_serialize( "NextDirectPongPacket", packet );
+        bench_packet( "NextDirectPongPacket", NEXT_DIRECT_PONG_PACKET, packet );
+    }
+
+    {
+        static NextClientStatsPacket packet;
+        packet.reported = true;
+        packet.next = true;
+        packet.platform_id = NEXT_PLATFORM_LINUX;
+        packet.connection_type = NEXT_CONNECTION_TYPE_WIRED;
+        packet.direct_rtt = 50.0f;
+        packet.direct_jitter = 10.0f;
+        packet.direct_packet_loss = 0.1f;
+        packet.next_rtt = 30.0f;
+        packet.next_jitter = 5.0f;
+        packet.next_packet_loss = 0.01f;
+        packet.num_client_relays = NEXT_MAX_CLIENT_RELAYS;
+        for ( int i = 0; i < NEXT_MAX_CLIENT_RELAYS; ++i )
+        {
+            packet.client_relay_ids[i] = bench_random_uint64();
+            packet.client_relay_rtt[i] = uint8_t( i );
+            packet.client_relay_jitter[i] = uint8_t( i );
+            packet.client_relay_packet_loss[i] = 0.1f * i;
+        }
+        packet.packets_sent_client_to_server = 100000;
+        packet.packets_lost_server_to_client = 100;
+        packet.packets_out_of_order_server_to_client = 10;
+        packet.client_relay_request_id = bench_random_uint64();
+        bench_serialize( "NextClientStatsPacket", packet );
+        bench_fast_serialize( "NextClientStatsPacket", packet );
+        bench_packet( "NextClientStatsPacket", NEXT_CLIENT_STATS_PACKET, packet );
+    }
+
+    {
+        static NextClientRelayUpdatePacket packet;
+        packet.request_id = bench_random_uint64();
+        packet.num_client_relays = NEXT_MAX_CLIENT_RELAYS;
+        for ( int i = 0; i < NEXT_MAX_CLIENT_RELAYS; ++i )
+        {
+            packet.client_relay_ids[i] = bench_random_uint64();
+            packet.client_relay_addresses[i] = address;
+            bench_random_bytes( packet.client_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES );
+        }
+        packet.expire_timestamp = bench_random_uint64();
+        bench_serialize( "NextClientRelayUpdatePacket", packet );
+        bench_packet( "NextClientRelayUpdatePacket", NEXT_CLIENT_RELAY_UPDATE_PACKET, packet );
+    }
+
+    {
+        static NextClientRelayAckPacket packet;
+        packet.request_id = bench_random_uint64();
+        bench_serialize( "NextClientRelayAckPacket", packet );
+        bench_packet( "NextClientRelayAckPacket", NEXT_CLIENT_RELAY_ACK_PACKET, packet );
+    }
+
+    {
+        static NextRouteUpdatePacket packet;
+        packet.sequence = bench_random_uint64();
+        packet.update_type = NEXT_UPDATE_TYPE_ROUTE;
+        packet.num_tokens = NEXT_MAX_TOKENS;
+        bench_random_bytes( packet.tokens, sizeof(packet.tokens) );
+        packet.packets_sent_server_to_client = 100000;
+        packet.packets_lost_client_to_server = 100;
+        packet.packets_out_of_order_client_to_server = 10;
+        bench_random_bytes( packet.upcoming_magic, 8 );
+        bench_random_bytes( packet.current_magic, 8 );
+        bench_random_bytes( packet.previous_magic, 8 );
+        bench_serialize( "NextRouteUpdatePacket", packet );
+        bench_fast_serialize( "NextRouteUpdatePacket", packet );
+        bench_packet( "NextRouteUpdatePacket", NEXT_ROUTE_UPDATE_PACKET, packet );
+    }
+
+    {
+        static NextRouteAckPacket packet;
+        packet.sequence = bench_random_uint64();
+        bench_serialize( "NextRouteAckPacket", packet );
+        bench_fast_serialize( "NextRouteAckPacket", packet );
+        bench_packet( "NextRouteAckPacket", NEXT_ROUTE_ACK_PACKET, packet );
+    }
+
+    {
+        static NextBackendServerInitRequestPacket packet;
+        packet.buyer_id = bench_random_uint64();
+        packet.request_id = bench_random_uint64();
+        packet.datacenter_id = bench_random_uint64();
+        strcpy( packet.datacenter_name, "local" );
+        bench_serialize( "NextBackendServerInitRequestPacket", packet );
+        bench_packet( "NextBackendServerInitRequestPacket", NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET, packet );
+    }
+
+    {
+        static NextBackendServerInitResponsePacket packet;
+        packet.request_id = bench_random_uint64();
+        packet.response = NEXT_SERVER_INIT_RESPONSE_OK;
+        bench_random_bytes( packet.upcoming_magic, 8 );
+        bench_random_bytes( packet.current_magic, 8 );
+        bench_random_bytes( packet.previous_magic, 8 );
+        bench_serialize( "NextBackendServerInitResponsePacket", packet );
+        bench_packet( "NextBackendServerInitResponsePacket", NEXT_BACKEND_SERVER_INIT_RESPONSE_PACKET, packet );
+    }
+
+    {
+        static NextBackendServerUpdateRequestPacket packet;
+        packet.buyer_id = bench_random_uint64();
+        packet.request_id = bench_random_uint64();
+        packet.datacenter_id = bench_random_uint64();
+        packet.num_sessions = 1000;
+        packet.server_address = address;
+        packet.uptime = 100000;
+        bench_serialize( "NextBackendServerUpdateRequestPacket", packet );
+        bench_packet( "NextBackendServerUpdateRequestPacket", NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET, packet );
+    }
+
+    {
+        static NextBackendServerUpdateResponsePacket packet;
+        packet.request_id = bench_random_uint64();
+        bench_random_bytes( packet.upcoming_magic, 8 );
+        bench_random_bytes( packet.current_magic, 8 );
+        bench_random_bytes( packet.previous_magic, 8 );
+        bench_serialize( "NextBackendServerUpdateResponsePacket", packet );
+        bench_packet( "NextBackendServerUpdateResponsePacket", NEXT_BACKEND_SERVER_UPDATE_RESPONSE_PACKET, packet );
+    }
+
+    {
+        static NextBackendClientRelayRequestPacket packet;
+        packet.buyer_id = bench_random_uint64();
+        packet.request_id = bench_random_uint64();
+        packet.datacenter_id = bench_random_uint64();
+        packet.client_address = address;
+        bench_serialize( "NextBackendClientRelayRequestPacket", packet );
+        bench_packet( "NextBackendClientRelayRequestPacket", NEXT_BACKEND_CLIENT_RELAY_REQUEST_PACKET, packet );
+    }
+
+    {
+        static NextBackendClientRelayResponsePacket packet;
+        packet.client_address = address;
+        packet.request_id = bench_random_uint64();
+        packet.latitude = 43.0f;
+        packet.longitude = -75.0f;
+        packet.num_client_relays = NEXT_MAX_CLIENT_RELAYS;
+        for ( int i = 0; i < NEXT_MAX_CLIENT_RELAYS; ++i )
+        {
+            packet.client_relay_ids[i] = bench_random_uint64();
+            packet.client_relay_addresses[i] = address;
+            bench_random_bytes( packet.client_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES );
+        }
+        packet.expire_timestamp = bench_random_uint64();
+        bench_serialize( "NextBackendClientRelayResponsePacket", packet );
+        bench_packet( "NextBackendClientRelayResponsePacket", NEXT_BACKEND_CLIENT_RELAY_RESPONSE_PACKET, packet );
+    }
+
+    {
+        static NextBackendServerRelayRequestPacket packet;
+        packet.buyer_id = bench_random_uint64();
+        packet.request_id = bench_random_uint64();
+        packet.datacenter_id = bench_random_uint64();
+        bench_serialize( "NextBackendServerRelayRequestPacket", packet );
+        bench_packet( "NextBackendServerRelayRequestPacket", NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, packet );
+    }
+
+    {
+        static NextBackendServerRelayResponsePacket packet;
+        packet.request_id = bench_random_uint64();
+        packet.num_server_relays = NEXT_MAX_SERVER_RELAYS;
+        for ( int i = 0; i < NEXT_MAX_SERVER_RELAYS; ++i )
+        {
+            packet.server_relay_ids[i] = bench_random_uint64();
+            packet.server_relay_addresses[i] = address;
+            bench_random_bytes( packet.server_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES );
+        }
+        packet.expire_timestamp = bench_random_uint64();
+        bench_serialize( "NextBackendServerRelayResponsePacket", packet );
+        bench_packet( "NextBackendServerRelayResponsePacket", NEXT_BACKEND_SERVER_RELAY_RESPONSE_PACKET, packet );
+    }
+
+    {
+        static NextBackendSessionUpdateRequestPacket packet;
+        packet.buyer_id = bench_random_uint64();
+        packet.datacenter_id = bench_random_uint64();
+        packet.session_id = bench_random_uint64();
+        packet.slice_number = 100;
+        packet.session_data_bytes = NEXT_MAX_SESSION_DATA_BYTES;
+        bench_random_bytes( packet.session_data, NEXT_MAX_SESSION_DATA_BYTES );
+        bench_random_bytes( packet.session_data_signature, NEXT_CRYPTO_SIGN_BYTES );
+        packet.client_address = address;
+        packet.server_address = address;
+        bench_random_bytes( packet.client_route_public_key, sizeof(packet.client_route_public_key) );
+        bench_random_bytes( packet.server_route_public_key, sizeof(packet.server_route_public_key) );
+        packet.user_hash = bench_random_uint64();
+        packet.platform_id = NEXT_PLATFORM_LINUX;
+        packet.connection_type = NEXT_CONNECTION_TYPE_WIRED;
+        packet.next = true;
+        packet.has_client_relay_pings = true;
+        packet.has_server_relay_pings = true;
+        packet.session_events = 1;
+        packet.internal_events = 1;
+        packet.num_client_relays = NEXT_MAX_CLIENT_RELAYS;
+        for ( int i = 0; i < NEXT_MAX_CLIENT_RELAYS; ++i )
+        {
+            packet.client_relay_ids[i] = bench_random_uint64();
+            packet.client_relay_rtt[i] = uint8_t( i );
+            packet.client_relay_jitter[i] = uint8_t( i );
+            packet.client_relay_packet_loss[i] = 0.1f * i;
+        }
+        packet.num_server_relays = NEXT_MAX_SERVER_RELAYS;
+        for ( int i = 0; i < NEXT_MAX_SERVER_RELAYS; ++i )
+        {
+            packet.server_relay_ids[i] = bench_random_uint64();
+            packet.server_relay_rtt[i] = uint8_t( i );
+            packet.server_relay_jitter[i] = uint8_t( i );
+            packet.server_relay_packet_loss[i] = 0.1f * i;
+        }
+        packet.packets_sent_client_to_server = 100000;
+        packet.packets_sent_server_to_client = 100000;
+        packet.packets_lost_client_to_server = 100;
+        packet.packets_lost_server_to_client = 100;
+        packet.packets_out_of_order_client_to_server = 10;
+        packet.packets_out_of_order_server_to_client = 10;
+        bench_serialize( "NextBackendSessionUpdateRequestPacket", packet );
+        bench_packet( "NextBackendSessionUpdateRequestPacket", NEXT_BACKEND_SESSION_UPDATE_REQUEST_PACKET, packet );
+    }
+
+    {
+        static NextBackendSessionUpdateResponsePacket packet;
+        packet.session_id = bench_random_uint64();
+        packet.slice_number = 100;
+        packet.session_data_bytes = NEXT_MAX_SESSION_DATA_BYTES;
+        bench_random_bytes( packet.session_data, NEXT_MAX_SESSION_DATA_BYTES );
+        bench_random_bytes( packet.session_data_signature, NEXT_CRYPTO_SIGN_BYTES );
+        packet.response_type = NEXT_UPDATE_TYPE_ROUTE;
+        packet.num_tokens = NEXT_MAX_TOKENS;
+        bench_random_bytes( packet.tokens, sizeof(packet.tokens) );
+        bench_serialize( "NextBackendSessionUpdateResponsePacket", packet );
+        bench_packet( "NextBackendSessionUpdateResponsePacket", NEXT_BACKEND_SESSION_UPDATE_RESPONSE_PACKET, packet );
+    }
+}
+
+void bench_packet_paths()
+{
+    const int payload_bytes[] = { 64, 256, NEXT_MTU };
+
+    static uint8_t game_packet_data[NEXT_MTU];
+    bench_random_bytes( game_packet_data, NEXT_MTU );
+
+    static uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+
+    for ( int i = 0; i < int( sizeof(payload_bytes) / sizeof(int) ); ++i )
+    {
+        const int game_packet_bytes = payload_bytes[i];
+
+        uint64_t sequence = 1000;
+        const uint64_t session_id = bench_random_uint64();
+        const uint8_t session_version = 1;
+
+        int packet_bytes = next_write_client_to_server_packet( packet_data, sequence, session_id, session_version, bench_session_private_key, game_packet_data, game_packet_bytes, bench_magic, bench_from_address, bench_to_address );
+
+        bench_run( "next_write_client_to_server_packet", "write", packet_bytes, [&]()
+        {
+            bench_clobber( game_packet_data );
+            int bytes = next_write_client_to_server_packet( bench_buffer, sequence++, session_id, session_version, bench_session_private_key, game_packet_data, game_packet_bytes, bench_magic, bench_from_address, bench_to_address );
+            bench_clobber( &bytes );
+        } );
+
+        bench_run( "next_write_server_to_client_packet", "write", packet_bytes, [&]()
+        {
+            bench_clobber( game_packet_data );
+            int bytes = next_write_server_to_client_packet( bench_buffer, sequence++, session_id, session_version, bench_session_private_key, game_packet_data, game_packet_bytes, bench_magic, bench_from_address, bench_to_address );
+            bench_clobber( &bytes );
+        } );
+
+        bench_run( "next_read_header", "read", packet_bytes, [&]()
+        {
+            bench_clobber( packet_data );
+            uint64_t read_sequence = 0;
+            uint64_t read_session_id = 0;
+            uint8_t read_session_version = 0;
+            if ( next_read_header( NEXT_CLIENT_TO_SERVER_PACKET, &read_sequence, &read_session_id, &read_session_version, bench_session_private_key, packet_data + 18, packet_bytes - 18 ) != NEXT_OK )
+            {
+                printf( "error: failed to read header\n" );
+                exit( 1 );
+            }
+            bench_clobber( &read_sequence );
+        } );
+
+        bench_run( "next_basic_packet_filter", "filter", packet_bytes, [&]()
+        {
+            bench_clobber( packet_data );
+            bool result = next_basic_packet_filter( packet_data, uint16_t( packet_bytes ) );
+            bench_clobber( &result );
+        } );
+
+        bench_run( "next_advanced_packet_filter", "filter", packet_bytes, [&]()
+        {
+            bench_clobber( packet_data );
+            bool result = next_advanced_packet_filter( packet_data, bench_magic, bench_from_address, bench_to_address, uint16_t( packet_bytes ) );
+            bench_clobber( &result );
+        } );
+    }
+}
+
+void bench_trackers()
+{
+    {
+        static next_replay_protection_t replay_protection;
+        next_replay_protection_reset( &replay_protection );
+        uint64_t sequence = 0;
+        bench_run( "next_replay_protection", "update", 0, [&]()
+        {
+            if ( !next_replay_protection_already_received( &replay_protection, sequence ) )
+            {
+                next_replay_protection_advance_sequence( &replay_protection, sequence );
+            }
+            bench_clobber( &replay_protection );
+            sequence += 1 + ( sequence % 3 == 0 );
+        } );
+    }
+
+    {
+        static next_packet_loss_tracker_t tracker;
+        next_packet_loss_tracker_reset( &tracker );
+        uint64_t sequence = 0;
+        bench_run( "next_packet_loss_tracker", "received", 0, [&]()
+        {
+            next_packet_loss_tracker_packet_received( &tracker, sequence );
+            bench_clobber( &tracker );
+            sequence += 1 + ( sequence % 10 == 0 );
+        } );
+
+        bench_run( "next_packet_loss_tracker", "update", 0, [&]()
+        {
+            next_packet_loss_tracker_packet_received( &tracker, sequence );
+            int lost = next_packet_loss_tracker_update( &tracker );
+            bench_clobber( &lost );
+            sequence += 1 + ( sequence % 10 == 0 );
+        } );
+    }
+
+    {
+        static next_out_of_order_tracker_t tracker;
+        next_out_of_order_tracker_reset( &tracker );
+        uint64_t sequence = 0;
+        bench_run( "next_out_of_order_tracker", "received", 0, [&]()
+        {
+            // IMPORTANT: swap every tenth pair so the out of order branch is exercised too
+            const uint64_t received_sequence = ( sequence % 10 == 0 ) ? sequence + 1 : ( ( sequence % 10 == 1 ) ? sequence - 1 : sequence );
+            next_out_of_order_tracker_packet_received( &tracker, received_sequence );
+            bench_clobber( &tracker );
+            sequence++;
+        } );
+    }
+
+    {
+        static next_jitter_tracker_t tracker;
+        next_jitter_tracker_reset( &tracker );
+        uint64_t sequence = 0;
+        double time = 0.0;
+        bench_run( "next_jitter_tracker", "received", 0, [&]()
+        {
+            next_jitter_tracker_packet_received( &tracker, sequence++, time );
+            bench_clobber( &tracker );
+            time += 0.01 + 0.001 * ( sequence % 7 );
+        } );
+    }
+
+    {
+        static next_ping_history_t history;
+        next_ping_history_clear( &history );
+        double time = 0.0;
+        for ( int i = 0; i < NEXT_PING_HISTORY_ENTRY_COUNT; ++i )
+        {
+            const uint64_t sequence = next_ping_history_ping_sent( &history, time );
+            if ( i % 20 != 0 )
+            {
+                next_ping_history_pong_received( &history, sequence, time + 0.05 + 0.001 * ( i % 7 ) );
+            }
+            time += 0.1;
+        }
+
+        bench_run( "next_route_stats_from_ping_history", "stats", 0, [&]()
+        {
+            next_route_stats_t stats;
+            bench_clobber( &history );
+            next_route_stats_from_ping_history( &history, time - NEXT_PING_STATS_WINDOW, time, &stats );
+            bench_clobber( &stats );
+        } );
+    }
+}
+
+void bench_session_manager()
+{
+    const int num_sessions[] = { 64, 256, 1024, 4096 };
+
+    static uint8_t ephemeral_private_key[NEXT_CRYPTO_SECRETBOX_KEYBYTES];
+    static uint8_t upgrade_token[NEXT_UPGRADE_TOKEN_BYTES];
+
+    for ( int i = 0; i < int( sizeof(num_sessions) / sizeof(int) ); ++i )
+    {
+        const int n = num_sessions[i];
+
+        char path[16];
+        snprintf( path, sizeof(path), "%d", n );
+
+        next_session_manager_t * session_manager = next_session_manager_create( NULL, n, NULL );
+        if ( !session_manager )
+        {
+            printf( "error: failed to create session manager\n" );
+            exit( 1 );
+        }
+
+        next_address_t * addresses = (next_address_t*) malloc( n * sizeof(next_address_t) );
+        uint64_t * session_ids = (uint64_t*) malloc( n * sizeof(uint64_t) );
+        for ( int j = 0; j < n; ++j )
+        {
+            char address_string[64];
+            snprintf( address_string, sizeof(address_string), "10.0.%d.%d:%d", ( j / 256 ) % 256, j % 256, 30000 + j );
+            next_address_parse( &addresses[j], address_string );
+            session_ids[j] = uint64_t( j ) + 1;
+            next_session_manager_add( session_manager, &addresses[j], session_ids[j], ephemeral_private_key, upgrade_token );
+        }
+
+        int index = 0;
+
+        bench_run( "next_session_manager_find_by_address", path, 0, [&]()
+        {
+            next_session_entry_t * entry = next_session_manager_find_by_address( session_manager, &addresses[index] );
+            bench_clobber( entry );
+            index = ( index + 7 ) % n;
+        } );
+
+        bench_run( "next_session_manager_find_by_session_id", path, 0, [&]()
+        {
+            next_session_entry_t * entry = next_session_manager_find_by_session_id( session_manager, session_ids[index] );
+            bench_clobber( entry );
+            index = ( index + 7 ) % n;
+        } );
+
+        // IMPORTANT: remove then add back so the session manager stays full while the slots churn
+
+        bench_run( "next_session_manager_remove_and_add", path, 0, [&]()
+        {
+            next_session_manager_remove_by_address( session_manager, &addresses[index] );
+            next_session_entry_t * entry = next_session_manager_add( session_manager, &addresses[index], session_ids[index], ephemeral_private_key, upgrade_token );
+            bench_clobber( entry );
+            index = ( index + 7 ) % n;
+        } );
+
+        free( addresses );
+        free( session_ids );
+
+        next_session_manager_destroy( session_manager );
+    }
+}
+
+int main( int argc, char ** argv )
+{
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[i], "--json" ) == 0 )
+        {
+            bench_json = true;
+        }
+    }
+
+    next_quiet( true );
+
+    if ( next_init( NULL, NULL ) != NEXT_OK )
+    {
+        printf( "error: failed to initialize network next\n" );
+        return 1;
+    }
+
+    next_crypto_random_bytes( bench_magic, sizeof(bench_magic) );
+    next_crypto_random_bytes( bench_from_address, sizeof(bench_from_address) );
+    next_crypto_random_bytes( bench_to_address, sizeof(bench_to_address) );
+    next_crypto_random_bytes( bench_session_private_key, sizeof(bench_session_private_key) );
+    next_crypto_sign_keypair( bench_sign_public_key, bench_sign_private_key );
+
+    if ( !bench_json )
+    {
+        printf( "\nRunning SDK benchmarks:\n\n" );
+#if NEXT_ENABLE_MEMORY_CHECKS
+        printf( "warning: memory checks are enabled. session manager and tracker results will be much slower than release\n\n" );
+#endif // #if NEXT_ENABLE_MEMORY_CHECKS
+    }
+
+    bench_packet_serialization();
+
+    bench_packet_paths();
+
+    bench_trackers();
+
+    bench_session_manager();
+
+    next_term();
+
+    if ( bench_json )
+    {
+        bench_print_json();
+    }
+    else
+    {
+        printf( "\n" );
+    }
+
+    fflush( stdout );
+
+    return 0;
+}
@@ -92,6 +92,9 @@
 
 #define NEXT_MAX_TAGS                                             8
 
+#define NEXT_QUEUE_OVERFLOW_DROP_NEWEST                           0
+#define NEXT_QUEUE_OVERFLOW_DROP_OLDEST                           1
+
 #if defined(_WIN32)
 #define NOMINMAX
 #endif
@@ -282,6 +285,25 @@ struct next_config_t
     int socket_receive_buffer_size;
     bool disable_network_next;
     bool disable_autodetect;
+    bool crypto_worker_thread;
+    bool async_log;
+    int notify_queue_length;
+    int command_queue_length;
+    int queue_overflow_policy;
+    bool memory_pool;
+    int max_sessions;
+    bool immediate_packet_delivery;
+    int client_thread_cpu;
+    int server_thread_cpu;
+    int client_busy_poll_microseconds;
+    int server_busy_poll_microseconds;
+    bool kernel_packet_filter;
+    bool io_uring;
+    char server_xdp_interface[256];
+    int server_xdp_queue;
+    bool payload_coalescing;
+    bool adaptive_multipath;
+    int fec_group_size;
 };
 
 NEXT_EXPORT_FUNC void next_default_config( struct next_config_t * config );
@@ -349,6 +371,20 @@ NEXT_EXPORT_FUNC uint64_t next_protocol_version();
 
 // -----------------------------------------
 
+struct next_latency_t
+{
+    uint64_t count;
+    float min;
+    float mean;
+    float p50;
+    float p90;
+    float p99;
+    float p999;
+    float max;
+};
+
+// -----------------------------------------
+
 struct next_client_stats_t
 {
     int platform_id;
@@ -377,6 +413,8 @@ struct next_client_stats_t
     uint64_t packets_out_of_order_server_to_client;
     float jitter_client_to_server;
     float jitter_server_to_client;
+    float fec_kbps_up;
+    float fec_kbps_down;
 };
 
 // -----------------------------------------
@@ -385,6 +423,28 @@ struct next_client_stats_t
 #define NEXT_CLIENT_STATE_OPEN          1
 #define NEXT_CLIENT_STATE_ERROR         2
 
+#define NEXT_CLIENT_METRIC_RECEIVE_TO_NOTIFY                0
+#define NEXT_CLIENT_METRIC_NOTIFY_TO_CALLBACK               1
+#define NEXT_CLIENT_METRIC_SEND_PACKET                      2
+#define NEXT_CLIENT_METRIC_SOCKET_SEND                      3
+#define NEXT_CLIENT_METRIC_MUTEX_WAIT                       4
+#define NEXT_CLIENT_METRIC_MUTEX_HOLD                       5
+#define NEXT_CLIENT_METRIC_UPDATE                           6
+#define NEXT_CLIENT_METRIC_UPDATE_INTERNAL                  7
+#define NEXT_CLIENT_METRIC_UPDATE_DIRECT_PINGS              8
+#define NEXT_CLIENT_METRIC_UPDATE_NEXT_PINGS                9
+#define NEXT_CLIENT_METRIC_UPDATE_CLIENT_RELAYS            10
+#define NEXT_CLIENT_METRIC_UPDATE_STATS                    11
+#define NEXT_CLIENT_METRIC_UPDATE_FALLBACK_TO_DIRECT       12
+#define NEXT_CLIENT_METRIC_UPDATE_ROUTE_MANAGER            13
+#define NEXT_CLIENT_METRIC_UPDATE_UPGRADE_RESPONSE         14
+#define NEXT_CLIENT_METRIC_NUM_METRICS                     15
+
+struct next_client_metrics_t
+{
+    struct next_latency_t latency[NEXT_CLIENT_METRIC_NUM_METRICS];
+};
+
 struct next_client_t;
 struct next_address_t;
 
@@ -410,6 +470,10 @@ NEXT_EXPORT_FUNC void next_client_send_packet_direct( struct next_client_t * cli
 
 NEXT_EXPORT_FUNC void next_client_send_packet_raw( struct next_client_t * client, const struct next_address_t * address, const uint8_t * packet_data, int packet_bytes );
 
+NEXT_EXPORT_FUNC void next_client_send_packets_begin( struct next_client_t * client );
+
+NEXT_EXPORT_FUNC void next_client_send_packets_end( struct next_client_t * client );
+
 NEXT_EXPORT_FUNC void next_client_report_session( struct next_client_t * client );
 
 NEXT_EXPORT_FUNC uint64_t next_client_session_id( struct next_client_t * client );
@@ -422,6 +486,8 @@ NEXT_EXPORT_FUNC bool next_client_ready( struct next_client_t * client );
 
 NEXT_EXPORT_FUNC bool next_client_fallback_to_direct( struct next_client_t * client );
 
+NEXT_EXPORT_FUNC void next_client_metrics( struct next_client_t * client, struct next_client_metrics_t * metrics );
+
 // -----------------------------------------
 
 struct next_server_stats_t
@@ -459,6 +525,67 @@ struct next_server_stats_t
 #define NEXT_SERVER_STATE_INITIALIZING              1
 #define NEXT_SERVER_STATE_INITIALIZED               2
 
+#define NEXT_SERVER_METRIC_RECEIVE_TO_NOTIFY                0
+#define NEXT_SERVER_METRIC_NOTIFY_TO_CALLBACK               1
+#define NEXT_SERVER_METRIC_SEND_PACKET                      2
+#define NEXT_SERVER_METRIC_SOCKET_SEND                      3
+#define NEXT_SERVER_METRIC_MUTEX_WAIT                       4
+#define NEXT_SERVER_METRIC_MUTEX_HOLD                       5
+#define NEXT_SERVER_METRIC_UPDATE                           6
+#define NEXT_SERVER_METRIC_UPDATE_INTERNAL                  7
+#define NEXT_SERVER_METRIC_UPDATE_FLUSH                     8
+#define NEXT_SERVER_METRIC_UPDATE_RESOLVE_HOSTNAME          9
+#define NEXT_SERVER_METRIC_UPDATE_AUTODETECT               10
+#define NEXT_SERVER_METRIC_UPDATE_INIT                     11
+#define NEXT_SERVER_METRIC_UPDATE_PENDING_UPGRADES         12
+#define NEXT_SERVER_METRIC_UPDATE_READY                    13
+#define NEXT_SERVER_METRIC_UPDATE_SERVER_RELAYS            14
+#define NEXT_SERVER_METRIC_UPDATE_CLIENT_RELAYS            15
+#define NEXT_SERVER_METRIC_UPDATE_ROUTE                    16
+#define NEXT_SERVER_METRIC_UPDATE_SESSIONS                 17
+#define NEXT_SERVER_METRIC_BACKEND_UPDATE                  18
+#define NEXT_SERVER_METRIC_PUMP_COMMANDS                   19
+#define NEXT_SERVER_METRIC_NUM_METRICS                     20
+
+struct next_server_metrics_t
+{
+    struct next_latency_t latency[NEXT_SERVER_METRIC_NUM_METRICS];
+};
+
+#define NEXT_SERVER_COUNTER_PACKETS_RECEIVED                0
+#define NEXT_SERVER_COUNTER_BYTES_RECEIVED                  1
+#define NEXT_SERVER_COUNTER_PACKETS_SENT                    2
+#define NEXT_SERVER_COUNTER_BYTES_SENT                      3
+#define NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED               4
+#define NEXT_SERVER_COUNTER_PAYLOADS_SENT                   5
+#define NEXT_SERVER_COUNTER_DROPPED_RECEIVE_CALLBACK        6
+#define NEXT_SERVER_COUNTER_DROPPED_BASIC_FILTER            7
+#define NEXT_SERVER_COUNTER_DROPPED_ADVANCED_FILTER         8
+#define NEXT_SERVER_COUNTER_DROPPED_DIRECT_PACKET           9
+#define NEXT_SERVER_COUNTER_DROPPED_REPLAY_PROTECTION      10
+#define NEXT_SERVER_COUNTER_DROPPED_NEXT_PACKET            11
+#define NEXT_SERVER_COUNTER_NOTIFY_QUEUE_PUSHED            12
+#define NEXT_SERVER_COUNTER_NOTIFY_QUEUE_POPPED            13
+#define NEXT_SERVER_COUNTER_NOTIFY_QUEUE_OVERFLOW          14
+#define NEXT_SERVER_COUNTER_COMMAND_QUEUE_OVERFLOW         15
+#define NEXT_SERVER_COUNTER_BACKEND_PACKETS_SENT           16
+#define NEXT_SERVER_COUNTER_BACKEND_RESENDS                17
+#define NEXT_SERVER_COUNTER_BACKEND_TIMEOUTS               18
+#define NEXT_SERVER_COUNTER_NOTIFY_QUEUE_HIGH_WATER_MARK   19
+#define NEXT_SERVER_COUNTER_COMMAND_QUEUE_HIGH_WATER_MARK  20
+#define NEXT_SERVER_COUNTER_MEMORY_POOL_FALLBACKS          21
+#define NEXT_SERVER_COUNTER_PAYLOADS_SENT_DIRECT           22
+#define NEXT_SERVER_COUNTER_PAYLOADS_SENT_NEXT             23
+#define NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED_DIRECT       24
+#define NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED_NEXT         25
+#define NEXT_SERVER_COUNTER_MULTIPATH_DUPLICATED           26
+#define NEXT_SERVER_COUNTER_MULTIPATH_SINGLE_PATH          27
+#define NEXT_SERVER_COUNTER_MULTIPATH_DUPLICATE_STARTED    28
+#define NEXT_SERVER_COUNTER_FEC_PARITY_SENT                29
+#define NEXT_SERVER_COUNTER_FEC_PARITY_RECEIVED            30
+#define NEXT_SERVER_COUNTER_FEC_RECOVERED                  31
+#define NEXT_SERVER_COUNTER_NUM_COUNTERS                   32
+
 struct next_server_t;
 struct next_address_t;
 
@@ -484,6 +611,10 @@ NEXT_EXPORT_FUNC void next_server_send_packet_direct( struct next_server_t * ser
 
 NEXT_EXPORT_FUNC void next_server_send_packet_raw( struct next_server_t * server, const struct next_address_t * to_address, const uint8_t * packet_data, int packet_bytes );
 
+NEXT_EXPORT_FUNC void next_server_send_packets_begin( struct next_server_t * server );
+
+NEXT_EXPORT_FUNC void next_server_send_packets_end( struct next_server_t * server );
+
 NEXT_EXPORT_FUNC bool next_server_stats( struct next_server_t * server, const struct next_address_t * address, struct next_server_stats_t * stats );
 
 NEXT_EXPORT_FUNC bool next_server_ready( struct next_server_t * server );
@@ -502,6 +633,12 @@ NEXT_EXPORT_FUNC void next_server_set_payload_receive_callback( struct next_serv
 
 NEXT_EXPORT_FUNC bool next_server_direct_only( struct next_server_t * server );
 
+NEXT_EXPORT_FUNC void next_server_metrics( struct next_server_t * server, struct next_server_metrics_t * metrics );
+
+NEXT_EXPORT_FUNC void next_server_counters( struct next_server_t * server, uint64_t * counters );
+
+NEXT_EXPORT_FUNC int next_server_session_stats( struct next_server_t * server, struct next_address_t * addresses, struct next_server_stats_t * stats, int max_sessions );
+
 // -----------------------------------------
 
 NEXT_EXPORT_FUNC bool next_packet_tagging_can_be_enabled();
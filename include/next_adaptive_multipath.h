@@ -0,0 +1,118 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_ADAPTIVE_MULTIPATH_H
+#define NEXT_ADAPTIVE_MULTIPATH_H
+
+#include "next.h"
+#include "next_constants.h"
+#include "next_ping_history.h"
+
+struct next_adaptive_multipath_sample_t
+{
+    next_route_stats_t next_route_stats;
+    next_route_stats_t direct_route_stats;
+    int payload_packets_lost;
+    int payload_packets_expected;
+    float payload_jitter;               // jitter (ms)
+};
+
+struct next_adaptive_multipath_t
+{
+    bool duplicate;
+    bool prefer_direct;
+    float payload_packet_loss;          // smoothed packet loss %
+    double last_degraded_time;
+};
+
+inline void next_adaptive_multipath_reset( next_adaptive_multipath_t * multipath )
+{
+    next_assert( multipath );
+    multipath->duplicate = false;
+    multipath->prefer_direct = false;
+    multipath->payload_packet_loss = 0.0f;
+    multipath->last_degraded_time = -1000.0;
+}
+
+inline bool next_adaptive_multipath_update( next_adaptive_multipath_t * multipath, double current_time, const next_adaptive_multipath_sample_t * sample )
+{
+    next_assert( multipath );
+    next_assert( sample );
+
+    // IMPORTANT: payload packet loss and jitter cover both paths, so they hide a bad primary path while we duplicate. That's fine, because
+    // the ping stats are per path and keep showing it, and the primary path must look healthy for the whole hold time before we stop duplicating
+
+    if ( sample->payload_packets_expected > 0 )
+    {
+        const float payload_packet_loss = float( sample->payload_packets_lost ) * 100.0f / float( sample->payload_packets_expected );
+        multipath->payload_packet_loss += ( payload_packet_loss - multipath->payload_packet_loss ) * 0.1f;
+    }
+
+    // send on the path with lower rtt, only switching when the other path is better by a clear margin
+
+    const float next_rtt = sample->next_route_stats.rtt;
+    const float direct_rtt = sample->direct_route_stats.rtt;
+
+    if ( next_rtt > 0.0f && direct_rtt > 0.0f )
+    {
+        if ( !multipath->prefer_direct && direct_rtt + NEXT_ADAPTIVE_MULTIPATH_RTT_THRESHOLD < next_rtt )
+        {
+            multipath->prefer_direct = true;
+        }
+        else if ( multipath->prefer_direct && next_rtt + NEXT_ADAPTIVE_MULTIPATH_RTT_THRESHOLD < direct_rtt )
+        {
+            multipath->prefer_direct = false;
+        }
+    }
+
+    const next_route_stats_t * primary = multipath->prefer_direct ? &sample->direct_route_stats : &sample->next_route_stats;
+
+    const bool degraded = primary->packet_loss >= NEXT_ADAPTIVE_MULTIPATH_ENTER_PACKET_LOSS ||
+                          primary->jitter >= NEXT_ADAPTIVE_MULTIPATH_ENTER_JITTER ||
+                          multipath->payload_packet_loss >= NEXT_ADAPTIVE_MULTIPATH_ENTER_PACKET_LOSS ||
+                          sample->payload_jitter >= NEXT_ADAPTIVE_MULTIPATH_ENTER_JITTER;
+
+    const bool healthy = primary->packet_loss <= NEXT_ADAPTIVE_MULTIPATH_EXIT_PACKET_LOSS &&
+                         primary->jitter <= NEXT_ADAPTIVE_MULTIPATH_EXIT_JITTER &&
+                         multipath->payload_packet_loss <= NEXT_ADAPTIVE_MULTIPATH_EXIT_PACKET_LOSS &&
+                         sample->payload_jitter <= NEXT_ADAPTIVE_MULTIPATH_EXIT_JITTER;
+
+    if ( !healthy )
+    {
+        multipath->last_degraded_time = current_time;
+    }
+
+    if ( degraded && !multipath->duplicate )
+    {
+        multipath->duplicate = true;
+        return true;
+    }
+
+    if ( multipath->duplicate && healthy && multipath->last_degraded_time + NEXT_ADAPTIVE_MULTIPATH_HOLD_TIME <= current_time )
+    {
+        multipath->duplicate = false;
+    }
+
+    return false;
+}
+
+#endif // #ifndef NEXT_ADAPTIVE_MULTIPATH_H
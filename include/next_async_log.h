@@ -0,0 +1,48 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_ASYNC_LOG_H
+#define NEXT_ASYNC_LOG_H
+
+#include "next.h"
+
+// IMPORTANT: Each thread that logs gets its own single producer ring, so next_printf never takes a lock and never
+// waits on stdout. Messages are formatted on the logging thread, because arguments like address strings often live
+// on its stack, and the text is copied into the ring. A background writer thread drains all rings and hands messages to
+// the write function. Messages from one thread always come out in order. Ordering across threads is best effort only,
+// because a message only becomes visible after its thread publishes it. When a ring is full the message is dropped and counted.
+
+typedef void (*next_async_log_write_function_t)( int level, double time, const char * message );
+
+struct next_async_log_t;
+
+next_async_log_t * next_async_log_create( void * context, next_async_log_write_function_t write_function );
+
+void next_async_log_destroy( next_async_log_t * log );
+
+bool next_async_log_push( next_async_log_t * log, int level, const char * message );
+
+void next_async_log_flush( next_async_log_t * log );
+
+uint64_t next_async_log_num_dropped( next_async_log_t * log );
+
+#endif // #ifndef NEXT_ASYNC_LOG_H
@@ -112,7 +112,8 @@ namespace next
         /**
             Write an array of bytes to the bit stream.
             Use this when you have to copy a large block of data into your bitstream.
-            Faster than just writing each byte to the bit stream via BitWriter::WriteBits( value, 8 ), because it aligns to byte index and copies into the buffer without bitpacking.
+            Faster than just writing each byte to the bit stream via BitWriter::WriteBits( value, 8 ), because the bytes are copied into the buffer at their byte offset with a single memcpy, whatever the word alignment.
+            The whole bytes held in scratch are stored first and any partial word after the copy is reloaded into scratch, so bitpacking continues seamlessly after the run.
             @param data The byte array data to write to the bit stream.
             @param bytes The number of bytes to write.
          */
@@ -120,42 +121,34 @@ namespace next
         void WriteBytes( const uint8_t * data, int bytes )
         {
             next_assert( GetAlignBits() == 0 );
+            next_assert( bytes >= 0 );
             next_assert( m_bitsWritten + bytes * 8 <= m_numBits );
-            next_assert( ( m_bitsWritten % 32 ) == 0 || ( m_bitsWritten % 32 ) == 8 || ( m_bitsWritten % 32 ) == 16 || ( m_bitsWritten % 32 ) == 24 );
-
-            int headBytes = ( 4 - ( m_bitsWritten % 32 ) / 8 ) % 4;
-            if ( headBytes > bytes )
-                headBytes = bytes;
-            for ( int i = 0; i < headBytes; ++i )
-                WriteBits( data[i], 8 );
-            if ( headBytes == bytes )
-                return;
-
-            FlushBits();
+            next_assert( ( m_scratchBits % 8 ) == 0 );
+            next_assert( m_bitsWritten == m_wordIndex * 32 + m_scratchBits );
 
-            next_assert( GetAlignBits() == 0 );
+            if ( bytes == 0 )
+                return;
 
-            int numWords = ( bytes - headBytes ) / 4;
-            if ( numWords > 0 )
+            if ( m_scratchBits != 0 )
             {
-                next_assert( ( m_bitsWritten % 32 ) == 0 );
-                memcpy( &m_data[m_wordIndex], data + headBytes, size_t(numWords) * 4 );
-                m_bitsWritten += numWords * 32;
-                m_wordIndex += numWords;
-                m_scratch = 0;
+                next_assert( m_wordIndex < m_numWords );
+                m_data[m_wordIndex] = host_to_network( uint32_t( m_scratch & 0xFFFFFFFF ) );
             }
 
-            next_assert( GetAlignBits() == 0 );
+            memcpy( ( (uint8_t*) m_data ) + m_bitsWritten / 8, data, bytes );
 
-            int tailStart = headBytes + numWords * 4;
-            int tailBytes = bytes - tailStart;
-            next_assert( tailBytes >= 0 && tailBytes < 4 );
-            for ( int i = 0; i < tailBytes; ++i )
-                WriteBits( data[tailStart+i], 8 );
+            m_bitsWritten += bytes * 8;
+            m_wordIndex = m_bitsWritten / 32;
+            m_scratchBits = m_bitsWritten % 32;
+            m_scratch = 0;
 
-            next_assert( GetAlignBits() == 0 );
+            if ( m_scratchBits != 0 )
+            {
+                next_assert( m_wordIndex < m_numWords );
+                m_scratch = uint64_t( network_to_host( m_data[m_wordIndex] ) ) & ( ( uint64_t(1) << m_scratchBits ) - 1 );
+            }
 
-            next_assert( headBytes + numWords * 4 + tailBytes == bytes );
+            next_assert( GetAlignBits() == 0 );
         }
 
         /**
@@ -343,45 +336,39 @@ namespace next
 
         /**
             Read bytes from the bitpacked data.
+            The bytes are copied out of the buffer from their byte offset with a single memcpy, whatever the word alignment.
+            Any partial word following the run is loaded into scratch so bit reads continue seamlessly after the run.
+            @param data The buffer to receive the bytes read.
+            @param bytes The number of bytes to read.
          */
 
         void ReadBytes( uint8_t * data, int bytes )
         {
             next_assert( GetAlignBits() == 0 );
+            next_assert( bytes >= 0 );
             next_assert( m_bitsRead + bytes * 8 <= m_numBits );
-            next_assert( ( m_bitsRead % 32 ) == 0 || ( m_bitsRead % 32 ) == 8 || ( m_bitsRead % 32 ) == 16 || ( m_bitsRead % 32 ) == 24 );
-
-            int headBytes = ( 4 - ( m_bitsRead % 32 ) / 8 ) % 4;
-            if ( headBytes > bytes )
-                headBytes = bytes;
-            for ( int i = 0; i < headBytes; ++i )
-                data[i] = (uint8_t) ReadBits( 8 );
-            if ( headBytes == bytes )
+            next_assert( m_bitsRead + m_scratchBits == m_wordIndex * 32 );
+
+            if ( bytes == 0 )
                 return;
 
-            next_assert( GetAlignBits() == 0 );
+            memcpy( data, ( (const uint8_t*) m_data ) + m_bitsRead / 8, bytes );
 
-            int numWords = ( bytes - headBytes ) / 4;
-            if ( numWords > 0 )
+            m_bitsRead += bytes * 8;
+            m_wordIndex = m_bitsRead / 32;
+            m_scratch = 0;
+            m_scratchBits = 0;
+
+            const int wordBits = m_bitsRead % 32;
+            if ( wordBits != 0 )
             {
-                next_assert( ( m_bitsRead % 32 ) == 0 );
-                memcpy( data + headBytes, &m_data[m_wordIndex], size_t(numWords) * 4 );
-                m_bitsRead += numWords * 32;
-                m_wordIndex += numWords;
-                m_scratchBits = 0;
+                next_assert( m_wordIndex < m_numWords );
+                m_scratch = uint64_t( network_to_host( m_data[m_wordIndex] ) ) >> wordBits;
+                m_scratchBits = 32 - wordBits;
+                m_wordIndex++;
             }
 
             next_assert( GetAlignBits() == 0 );
-
-            int tailStart = headBytes + numWords * 4;
-            int tailBytes = bytes - tailStart;
-            next_assert( tailBytes >= 0 && tailBytes < 4 );
-            for ( int i = 0; i < tailBytes; ++i )
-                data[tailStart+i] = (uint8_t) ReadBits( 8 );
-
-            next_assert( GetAlignBits() == 0 );
-
-            next_assert( headBytes + numWords * 4 + tailBytes == bytes );
         }
 
         /**
@@ -49,6 +49,8 @@ bool next_client_ready( next_client_t * client );
 
 bool next_client_fallback_to_direct( struct next_client_t * client );
 
+void next_client_metrics( next_client_t * client, next_client_metrics_t * metrics );
+
 void next_client_send_packet( next_client_t * client, const uint8_t * packet_data, int packet_bytes );
 
 void next_client_send_packet_direct( next_client_t * client, const uint8_t * packet_data, int packet_bytes );
@@ -25,6 +25,9 @@
 
 #include "next.h"
 
+// IMPORTANT: bump this whenever the layout of a packet exchanged between client and server changes
+#define NEXT_PROTOCOL_REVISION                                          2
+
 #define NEXT_SERVER_BACKEND_PORT                                  "40000"
 #define NEXT_SERVER_INIT_TIMEOUT                                      9.0
 #define NEXT_SERVER_AUTODETECT_TIMEOUT                                9.0
@@ -49,6 +52,33 @@
 #define NEXT_DIRECT_PINGS_PER_SECOND                                    5
 #define NEXT_COMMAND_QUEUE_LENGTH                                    1024
 #define NEXT_NOTIFY_QUEUE_LENGTH                                     1024
+#define NEXT_CRYPTO_WORKER_QUEUE_LENGTH                              1024
+#define NEXT_CRYPTO_WORKER_IDLE_WAIT_TIME                             0.1
+#define NEXT_CRYPTO_WORKER_BATCH_WINDOW                             0.001
+#define NEXT_ASYNC_LOG_MAX_THREADS                                     16
+#define NEXT_ASYNC_LOG_RING_BYTES                                   32768
+#define NEXT_ASYNC_LOG_IDLE_SLEEP_TIME                              0.001
+#define NEXT_ASYNC_LOG_FLUSH_TIMEOUT                                  1.0
+#define NEXT_LATENCY_HISTOGRAM_SUB_BUCKET_BITS                          3
+#define NEXT_LATENCY_HISTOGRAM_MAX_EXPONENT                            36
+#define NEXT_IMPAIRMENT_MAX_RULES                                      16
+#define NEXT_IMPAIRMENT_WHEEL_SLOTS                                  4096
+#define NEXT_IMPAIRMENT_SLOT_SECONDS                                0.001
+#define NEXT_IMPAIRMENT_MAX_PACKETS                                 16384
+#define NEXT_MAX_BUSY_POLL_MICROSECONDS                            100000
+#define NEXT_BPF_MAX_INSTRUCTIONS                                     128
+#define NEXT_BPF_UDP_HEADER_BYTES                                       8
+#define NEXT_IO_URING_SQ_ENTRIES                                      256
+#define NEXT_IO_URING_CQ_ENTRIES                                     1024
+#define NEXT_IO_URING_RECEIVE_BUFFERS                                 512
+#define NEXT_IO_URING_SEND_SLOTS                                      256
+#define NEXT_IO_URING_DESTROY_TIMEOUT                                 1.0
+#define NEXT_XDP_FRAMES                                              4096
+#define NEXT_XDP_FRAME_BYTES                                         2048
+#define NEXT_XDP_RING_ENTRIES                                        2048
+#define NEXT_XDP_MAX_QUEUES                                            64
+#define NEXT_XDP_MAX_PEERS                                           4096
+#define NEXT_XDP_MAX_INSTRUCTIONS                                      32
 #define NEXT_CLIENT_STATS_UPDATES_PER_SECOND                            5
 #define NEXT_SECONDS_BETWEEN_SERVER_UPDATES                          10.0
 #define NEXT_SECONDS_BETWEEN_SESSION_UPDATES                         10.0
@@ -90,6 +120,17 @@
 #define NEXT_CLIENT_COUNTER_PACKETS_LOST_SERVER_TO_CLIENT              12
 #define NEXT_CLIENT_COUNTER_PACKETS_OUT_OF_ORDER_CLIENT_TO_SERVER      13
 #define NEXT_CLIENT_COUNTER_PACKETS_OUT_OF_ORDER_SERVER_TO_CLIENT      14
+#define NEXT_CLIENT_COUNTER_NOTIFY_QUEUE_OVERFLOW                      15
+#define NEXT_CLIENT_COUNTER_NOTIFY_QUEUE_HIGH_WATER_MARK               16
+#define NEXT_CLIENT_COUNTER_COMMAND_QUEUE_OVERFLOW                     17
+#define NEXT_CLIENT_COUNTER_COMMAND_QUEUE_HIGH_WATER_MARK              18
+#define NEXT_CLIENT_COUNTER_MEMORY_POOL_FALLBACKS                      19
+#define NEXT_CLIENT_COUNTER_MULTIPATH_DUPLICATED                       20
+#define NEXT_CLIENT_COUNTER_MULTIPATH_SINGLE_PATH                      21
+#define NEXT_CLIENT_COUNTER_MULTIPATH_DUPLICATE_STARTED                22
+#define NEXT_CLIENT_COUNTER_FEC_PARITY_SENT                            23
+#define NEXT_CLIENT_COUNTER_FEC_PARITY_RECEIVED                        24
+#define NEXT_CLIENT_COUNTER_FEC_RECOVERED                              25
 
 #define NEXT_CLIENT_COUNTER_MAX                                        64
 
@@ -97,6 +138,16 @@
 #define NEXT_PACKET_LOSS_TRACKER_SAFETY                                30
 #define NEXT_SECONDS_BETWEEN_PACKET_LOSS_UPDATES                      0.1
 
+#define NEXT_ADAPTIVE_MULTIPATH_ENTER_PACKET_LOSS                     1.0
+#define NEXT_ADAPTIVE_MULTIPATH_EXIT_PACKET_LOSS                      0.1
+#define NEXT_ADAPTIVE_MULTIPATH_ENTER_JITTER                         10.0
+#define NEXT_ADAPTIVE_MULTIPATH_EXIT_JITTER                           5.0
+#define NEXT_ADAPTIVE_MULTIPATH_RTT_THRESHOLD                         5.0
+#define NEXT_ADAPTIVE_MULTIPATH_HOLD_TIME                            10.0
+
+#define NEXT_FEC_MAX_GROUP_SIZE                                        16
+#define NEXT_FEC_RECEIVE_GROUPS                                         4
+
 #define NEXT_SERVER_INIT_RESPONSE_OK                                    0
 #define NEXT_SERVER_INIT_RESPONSE_UNKNOWN_BUYER                         1
 #define NEXT_SERVER_INIT_RESPONSE_UNKNOWN_DATACENTER                    2
@@ -129,10 +180,12 @@
 
 #define NEXT_CLIENT_RELAY_PINGS_PER_SECOND                              2
 #define NEXT_SERVER_RELAY_PINGS_PER_SECOND                             60
+#define NEXT_ARENA_ALIGNMENT                                           64
 
 #define NEXT_IPV4_HEADER_BYTES                                         20
 #define NEXT_UDP_HEADER_BYTES                                           8
 #define NEXT_HEADER_BYTES                                              25
+#define NEXT_MAX_FEC_PAYLOAD_BYTES                                   1197
 
 #define NEXT_SESSION_PRIVATE_KEY_BYTES                                 32
 
@@ -25,6 +25,7 @@
 
 #include "next.h"
 #include "next_crypto.h"
+#include "next_read_write.h"
 
 struct next_continue_token_t
 {
@@ -47,6 +48,35 @@ inline void next_read_continue_token( next_continue_token_t * token, const uint8
     next_assert( p - buffer == NEXT_CONTINUE_TOKEN_BYTES );
 }
 
+inline void next_write_continue_token( const next_continue_token_t * token, uint8_t * buffer )
+{
+    next_assert( token );
+    next_assert( buffer );
+
+    uint8_t * p = buffer;
+
+    next_write_uint64( &p, token->expire_timestamp );
+    next_write_uint64( &p, token->session_id );
+    next_write_uint8( &p, token->session_version );
+
+    next_assert( p - buffer == NEXT_CONTINUE_TOKEN_BYTES );
+}
+
+inline int next_encrypt_continue_token( const uint8_t * key, const uint8_t * nonce, const uint8_t * token_data, uint8_t * buffer )
+{
+    next_assert( key );
+    next_assert( nonce );
+    next_assert( token_data );
+    next_assert( buffer );
+    unsigned long long encrypted_len;
+    if ( next_crypto_aead_xchacha20poly1305_ietf_encrypt( buffer, &encrypted_len, token_data, NEXT_CONTINUE_TOKEN_BYTES, NULL, 0, NULL, nonce, key ) != 0 )
+    {
+        return NEXT_ERROR;
+    }
+    next_assert( encrypted_len == NEXT_CONTINUE_TOKEN_BYTES + 16 );
+    return NEXT_OK;
+}
+
 inline int next_decrypt_continue_token( const uint8_t * key, const uint8_t * nonce, uint8_t * buffer, uint8_t * decrypted )
 {
     next_assert( key );
@@ -83,4 +113,32 @@ inline int next_read_encrypted_continue_token( uint8_t ** buffer, next_continue_
     return NEXT_OK;
 }
 
+// IMPORTANT: continue tokens are written by the backend. The SDK only writes them for tests and the local relay stand-in
+
+inline int next_write_encrypted_continue_token( uint8_t ** buffer, const next_continue_token_t * token, const uint8_t * key )
+{
+    next_assert( buffer );
+    next_assert( token );
+    next_assert( key );
+
+    uint8_t * nonce = *buffer;
+
+    next_crypto_random_bytes( nonce, 24 );
+
+    *buffer += 24;
+
+    uint8_t token_data[NEXT_CONTINUE_TOKEN_BYTES];
+
+    next_write_continue_token( token, token_data );
+
+    if ( next_encrypt_continue_token( key, nonce, token_data, *buffer ) != NEXT_OK )
+    {
+        return NEXT_ERROR;
+    }
+
+    *buffer += NEXT_CONTINUE_TOKEN_BYTES + 16;
+
+    return NEXT_OK;
+}
+
 #endif // #ifndef NEXT_CONTINUE_TOKEN_H
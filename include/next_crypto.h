@@ -43,6 +43,7 @@
 #define NEXT_CRYPTO_SIGN_BYTES                              64
 #define NEXT_CRYPTO_SIGN_PUBLICKEYBYTES                     32
 #define NEXT_CRYPTO_SIGN_SECRETKEYBYTES                     64
+#define NEXT_CRYPTO_SIGN_BATCH_MAX                          16
 
 #define NEXT_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES            16
 #define NEXT_CRYPTO_AEAD_CHACHA20POLY1305_KEYBYTES          32
@@ -73,6 +74,8 @@ int next_crypto_sign_final_create( struct next_crypto_sign_state_t * state, unsi
 
 int next_crypto_sign_final_verify( struct next_crypto_sign_state_t * state, const unsigned char * sig, const unsigned char * pk );
 
+int next_crypto_sign_final_verify_batch( struct next_crypto_sign_state_t * states, const unsigned char * const * sigs, int count, const unsigned char * pk );
+
 void next_crypto_secretbox_keygen( unsigned char * k );
 
 int next_crypto_secretbox_easy( unsigned char * c, const unsigned char * m, unsigned long long mlen, const unsigned char * n, const unsigned char * k );
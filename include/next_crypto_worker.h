@@ -0,0 +1,70 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_CRYPTO_WORKER_H
+#define NEXT_CRYPTO_WORKER_H
+
+#include "next.h"
+#include "next_address.h"
+
+#define NEXT_CRYPTO_WORKER_JOB_SIGN                     0
+#define NEXT_CRYPTO_WORKER_JOB_VERIFY                   1
+
+// IMPORTANT: Sign jobs carry a serialized, unsigned backend packet. The worker appends the signature and regenerates
+// the pittle and chonkle, so the packet is ready to send when it comes back. Verify jobs carry a received backend
+// packet including the 18 byte prefix. The worker only sets "verified", so the packet can be processed as if it just arrived.
+// Session update response verify jobs may be held for up to NEXT_CRYPTO_WORKER_BATCH_WINDOW and verified as a batch.
+// If a wake function is passed to create, the worker calls it from its own thread whenever results are ready to poll.
+
+struct next_crypto_worker_job_t
+{
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];     // IMPORTANT: first so it is dword aligned for the read stream
+    uint64_t cache_sequence;
+    int type;
+    int packet_bytes;
+    uint8_t packet_id;
+    bool verified;
+    next_address_t address;
+    uint8_t magic[8];
+    uint8_t from_address_data[4];
+    uint8_t to_address_data[4];
+};
+
+struct next_crypto_worker_t;
+
+next_crypto_worker_t * next_crypto_worker_create( void * context, const uint8_t * sign_private_key, const uint8_t * verify_public_key, void (*wake_function)( void * wake_data ), void * wake_data );
+
+void next_crypto_worker_destroy( next_crypto_worker_t * worker );
+
+next_crypto_worker_job_t * next_crypto_worker_create_job( next_crypto_worker_t * worker, int type );
+
+void next_crypto_worker_destroy_job( next_crypto_worker_t * worker, next_crypto_worker_job_t * job );
+
+int next_crypto_worker_submit( next_crypto_worker_t * worker, next_crypto_worker_job_t * job );
+
+next_crypto_worker_job_t * next_crypto_worker_poll( next_crypto_worker_t * worker );
+
+void next_crypto_worker_process_job( next_crypto_worker_job_t * job, const uint8_t * sign_private_key, const uint8_t * verify_public_key );
+
+void next_crypto_worker_verify_batch( next_crypto_worker_job_t ** jobs, int num_jobs, const uint8_t * verify_public_key );
+
+#endif // #ifndef NEXT_CRYPTO_WORKER_H
@@ -0,0 +1,396 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_FAST_SERIALIZE_H
+#define NEXT_FAST_SERIALIZE_H
+
+#include "next.h"
+#include "next_util.h"
+#include "next_stream.h"
+#include "next_serialize.h"
+#include "next_read_write.h"
+#include "next_packets.h"
+
+#include <memory.h>
+
+namespace next
+{
+    /**
+        Stream class for writing packets that have a compile-time size bound.
+        Produces exactly the same bits as WriteStream, but writes straight to a byte buffer at any byte offset.
+        There are no per-write bounds checks in release builds. The caller guarantees the buffer holds FastPacketSerializer<T>::MaxBytes.
+     */
+
+    class FastWriteStream
+    {
+    public:
+
+        enum { IsWriting = 1 };
+        enum { IsReading = 0 };
+
+        FastWriteStream( uint8_t * buffer, int bytes ) : m_data( buffer ), m_numBytes( bytes ), m_byteIndex( 0 ), m_scratch( 0 ), m_scratchBits( 0 )
+        {
+            next_assert( buffer );
+            next_assert( bytes >= 0 );
+        }
+
+        bool SerializeInteger( int32_t value, int32_t min, int32_t max )
+        {
+            next_assert( min < max );
+            next_assert( value >= min );
+            next_assert( value <= max );
+            WriteBits( uint32_t( value - min ), bits_required( min, max ) );
+            return true;
+        }
+
+        bool SerializeBits( uint32_t value, int bits )
+        {
+            next_assert( bits > 0 );
+            next_assert( bits <= 32 );
+            WriteBits( value, bits );
+            return true;
+        }
+
+        bool SerializeBytes( const uint8_t * data, int bytes )
+        {
+            next_assert( data );
+            next_assert( bytes >= 0 );
+            SerializeAlign();
+            FlushScratchBytes();
+            next_assert( m_byteIndex + bytes <= m_numBytes );
+            memcpy( m_data + m_byteIndex, data, bytes );
+            m_byteIndex += bytes;
+            return true;
+        }
+
+        bool SerializeAlign()
+        {
+            const int remainderBits = m_scratchBits % 8;
+            if ( remainderBits != 0 )
+            {
+                WriteBits( 0, 8 - remainderBits );
+            }
+            return true;
+        }
+
+        void Flush()
+        {
+            SerializeAlign();
+            FlushScratchBytes();
+        }
+
+        int GetBytesProcessed() const
+        {
+            return m_byteIndex + ( m_scratchBits + 7 ) / 8;
+        }
+
+    private:
+
+        void WriteBits( uint32_t value, int bits )
+        {
+            next_assert( uint64_t( value ) <= ( ( 1ULL << bits ) - 1 ) );
+
+            m_scratch |= uint64_t( value ) << m_scratchBits;
+            m_scratchBits += bits;
+
+            if ( m_scratchBits >= 32 )
+            {
+                next_assert( m_byteIndex + 4 <= m_numBytes );
+                const uint32_t word = host_to_network( uint32_t( m_scratch & 0xFFFFFFFF ) );
+                memcpy( m_data + m_byteIndex, &word, 4 );
+                m_byteIndex += 4;
+                m_scratch >>= 32;
+                m_scratchBits -= 32;
+            }
+        }
+
+        void FlushScratchBytes()
+        {
+            next_assert( ( m_scratchBits % 8 ) == 0 );
+            while ( m_scratchBits > 0 )
+            {
+                next_assert( m_byteIndex < m_numBytes );
+                m_data[m_byteIndex++] = uint8_t( m_scratch & 0xFF );
+                m_scratch >>= 8;
+                m_scratchBits -= 8;
+            }
+        }
+
+        uint8_t * m_data;               ///< The buffer being written to. Need not be aligned.
+        int m_numBytes;                 ///< The size of the buffer in bytes.
+        int m_byteIndex;                ///< The number of whole bytes flushed to the buffer so far.
+        uint64_t m_scratch;             ///< Bits not yet flushed to the buffer, lowest bits first.
+        int m_scratchBits;              ///< The number of bits in scratch. Always less than 32 between writes.
+    };
+
+    /**
+        Stream class for reading packets written by WriteStream or FastWriteStream.
+        Performs the same checks as ReadStream: reads past the end, non-zero align bits and out of range integers all fail.
+     */
+
+    class FastReadStream
+    {
+    public:
+
+        enum { IsWriting = 0 };
+        enum { IsReading = 1 };
+
+        FastReadStream( const uint8_t * buffer, int bytes ) : m_data( buffer ), m_numBytes( bytes ), m_numBits( bytes * 8 ), m_bitsRead( 0 ), m_byteIndex( 0 ), m_scratch( 0 ), m_scratchBits( 0 )
+        {
+            next_assert( buffer );
+            next_assert( bytes >= 0 );
+        }
+
+        bool SerializeInteger( int32_t & value, int32_t min, int32_t max )
+        {
+            next_assert( min < max );
+            const int bits = bits_required( min, max );
+            if ( WouldReadPastEnd( bits ) )
+                return false;
+            value = (int32_t) ReadBits( bits ) + min;
+            return true;
+        }
+
+        bool SerializeBits( uint32_t & value, int bits )
+        {
+            next_assert( bits > 0 );
+            next_assert( bits <= 32 );
+            if ( WouldReadPastEnd( bits ) )
+                return false;
+            value = ReadBits( bits );
+            return true;
+        }
+
+        bool SerializeBytes( uint8_t * data, int bytes )
+        {
+            if ( !SerializeAlign() )
+                return false;
+            if ( WouldReadPastEnd( bytes * 8 ) )
+                return false;
+            int i = 0;
+            while ( i < bytes && m_scratchBits > 0 )
+            {
+                data[i++] = uint8_t( ReadBits( 8 ) );
+            }
+            next_assert( m_scratchBits == 0 || i == bytes );
+            memcpy( data + i, m_data + m_byteIndex, bytes - i );
+            m_byteIndex += bytes - i;
+            m_bitsRead += ( bytes - i ) * 8;
+            return true;
+        }
+
+        bool SerializeAlign()
+        {
+            const int remainderBits = m_bitsRead % 8;
+            if ( remainderBits != 0 )
+            {
+                if ( WouldReadPastEnd( 8 - remainderBits ) )
+                    return false;
+                if ( ReadBits( 8 - remainderBits ) != 0 )
+                    return false;
+            }
+            return true;
+        }
+
+        int GetBytesProcessed() const
+        {
+            return ( m_bitsRead + 7 ) / 8;
+        }
+
+    private:
+
+        bool WouldReadPastEnd( int bits ) const
+        {
+            return m_bitsRead + bits > m_numBits;
+        }
+
+        uint32_t ReadBits( int bits )
+        {
+            next_assert( bits > 0 );
+            next_assert( bits <= 32 );
+
+            if ( m_scratchBits < bits )
+            {
+                if ( m_byteIndex + 4 <= m_numBytes )
+                {
+                    uint32_t word;
+                    memcpy( &word, m_data + m_byteIndex, 4 );
+                    m_scratch |= uint64_t( network_to_host( word ) ) << m_scratchBits;
+                    m_scratchBits += 32;
+                    m_byteIndex += 4;
+                }
+                else
+                {
+                    while ( m_scratchBits < bits )
+                    {
+                        next_assert( m_byteIndex < m_numBytes );
+                        m_scratch |= uint64_t( m_data[m_byteIndex++] ) << m_scratchBits;
+                        m_scratchBits += 8;
+                    }
+                }
+            }
+
+            const uint32_t output = uint32_t( m_scratch & ( ( 1ULL << bits ) - 1 ) );
+
+            m_scratch >>= bits;
+            m_scratchBits -= bits;
+            m_bitsRead += bits;
+
+            return output;
+        }
+
+        const uint8_t * m_data;         ///< The buffer being read from. Need not be aligned.
+        int m_numBytes;                 ///< The size of the buffer in bytes.
+        int m_numBits;                  ///< The size of the buffer in bits.
+        int m_bitsRead;                 ///< The number of bits read so far.
+        int m_byteIndex;                ///< The index of the next byte to load into scratch.
+        uint64_t m_scratch;             ///< Bits loaded but not yet read, lowest bits first.
+        int m_scratchBits;              ///< The number of bits in scratch.
+    };
+
+    /**
+        Type specialized serializers for the hot internal packets.
+        Each specialization has a compile-time upper bound on the payload size in MaxBytes and is wire compatible with Packet::Serialize on WriteStream/ReadStream.
+        Fixed layout packets are copied as little endian bytes and skip the bitpacker entirely.
+     */
+
+    template <typename T> struct FastPacketSerializer;
+
+    template <> struct FastPacketSerializer<NextDirectPingPacket>
+    {
+        enum { PacketId = NEXT_DIRECT_PING_PACKET };
+        enum { MaxBytes = 8 };
+
+        static int Write( NextDirectPingPacket & packet, uint8_t * buffer )
+        {
+            uint8_t * p = buffer;
+            next_write_uint64( &p, packet.ping_sequence );
+            return 8;
+        }
+
+        static bool Read( NextDirectPingPacket & packet, const uint8_t * buffer, int bytes )
+        {
+            if ( bytes < 8 )
+                return false;
+            const uint8_t * p = buffer;
+            packet.ping_sequence = next_read_uint64( &p );
+            return true;
+        }
+    };
+
+    template <> struct FastPacketSerializer<NextDirectPongPacket>
+    {
+        enum { PacketId = NEXT_DIRECT_PONG_PACKET };
+        enum { MaxBytes = 8 };
+
+        static int Write( NextDirectPongPacket & packet, uint8_t * buffer )
+        {
+            uint8_t * p = buffer;
+            next_write_uint64( &p, packet.ping_sequence );
+            return 8;
+        }
+
+        static bool Read( NextDirectPongPacket & packet, const uint8_t * buffer, int bytes )
+        {
+            if ( bytes < 8 )
+                return false;
+            const uint8_t * p = buffer;
+            packet.ping_sequence = next_read_uint64( &p );
+            return true;
+        }
+    };
+
+    template <> struct FastPacketSerializer<NextRouteAckPacket>
+    {
+        enum { PacketId = NEXT_ROUTE_ACK_PACKET };
+        enum { MaxBytes = 8 };
+
+        static int Write( NextRouteAckPacket & packet, uint8_t * buffer )
+        {
+            uint8_t * p = buffer;
+            next_write_uint64( &p, packet.sequence );
+            return 8;
+        }
+
+        static bool Read( NextRouteAckPacket & packet, const uint8_t * buffer, int bytes )
+        {
+            if ( bytes < 8 )
+                return false;
+            const uint8_t * p = buffer;
+            packet.sequence = next_read_uint64( &p );
+            return true;
+        }
+    };
+
+    template <> struct FastPacketSerializer<NextClientStatsPacket>
+    {
+        static_assert( NEXT_PLATFORM_MAX < 256, "platform id must fit in 8 bits" );
+        static_assert( NEXT_CONNECTION_TYPE_MAX < 256, "connection type must fit in 8 bits" );
+        static_assert( NEXT_MAX_CLIENT_RELAYS < 256, "num client relays must fit in 8 bits" );
+
+        enum { PacketId = NEXT_CLIENT_STATS_PACKET };
+        enum { MaxBits = 5 + 8 + 8 + 11 * 32 + 8 + 1 + NEXT_MAX_CLIENT_RELAYS * ( 64 + 8 + 8 + 32 ) + 3 * 64 + 32 + 64 };
+        enum { MaxBytes = ( MaxBits + 7 ) / 8 };
+
+        static int Write( NextClientStatsPacket & packet, uint8_t * buffer )
+        {
+            FastWriteStream stream( buffer, MaxBytes );
+            if ( !packet.Serialize( stream ) )
+                return -1;
+            stream.Flush();
+            return stream.GetBytesProcessed();
+        }
+
+        static bool Read( NextClientStatsPacket & packet, const uint8_t * buffer, int bytes )
+        {
+            FastReadStream stream( buffer, bytes );
+            return packet.Serialize( stream );
+        }
+    };
+
+    template <> struct FastPacketSerializer<NextRouteUpdatePacket>
+    {
+        static_assert( NEXT_MAX_TOKENS < 256, "num tokens must fit in 8 bits" );
+        static_assert( NEXT_ENCRYPTED_CONTINUE_TOKEN_BYTES <= NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES, "continue tokens must not be larger than route tokens" );
+
+        enum { PacketId = NEXT_ROUTE_UPDATE_PACKET };
+        enum { MaxBits = 64 + 2 + 8 + 1 + 7 + NEXT_MAX_TOKENS * NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES * 8 + 3 * 64 + 32 + 3 * 64 };
+        enum { MaxBytes = ( MaxBits + 7 ) / 8 };
+
+        static int Write( NextRouteUpdatePacket & packet, uint8_t * buffer )
+        {
+            FastWriteStream stream( buffer, MaxBytes );
+            if ( !packet.Serialize( stream ) )
+                return -1;
+            stream.Flush();
+            return stream.GetBytesProcessed();
+        }
+
+        static bool Read( NextRouteUpdatePacket & packet, const uint8_t * buffer, int bytes )
+        {
+            FastReadStream stream( buffer, bytes );
+            return packet.Serialize( stream );
+        }
+    };
+}
+
+#endif // #ifndef NEXT_FAST_SERIALIZE_H
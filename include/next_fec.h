@@ -0,0 +1,362 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_FEC_H
+#define NEXT_FEC_H
+
+#include "next.h"
+#include "next_constants.h"
+
+#include <string.h>
+
+// IMPORTANT: when both sides negotiate forward error correction, every upgraded payload starts with a one byte fec header holding its
+// index in the current group. After the last payload in a group, the sender sends a parity packet with the high bit set and the group
+// size in the low bits. Parity is the xor of every payload in the group, each with a two byte length in front and zero padded to the
+// longest, so the receiver can rebuild any one payload lost from the group. Groups are found from payload sequence numbers, so the
+// payloads in a group are sent with consecutive sequence numbers, and the parity packet takes the next one. The fec header and parity
+// length are reserved inside NEXT_MTU, so with fec on, upgraded payloads are at most NEXT_MAX_FEC_PAYLOAD_BYTES.
+
+#define NEXT_FEC_PARITY                                              0x80
+
+static_assert( NEXT_MAX_FEC_PAYLOAD_BYTES + 3 == NEXT_MTU, "parity packet for the largest payload plus its length and the fec header must fit in NEXT_MTU" );
+static_assert( NEXT_FEC_MAX_GROUP_SIZE <= 32, "fec groups are tracked with a 32 bit mask" );
+
+inline void next_fec_xor_payload( uint8_t * xor_data, int * xor_bytes, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( xor_data );
+    next_assert( xor_bytes );
+    next_assert( payload_data );
+    next_assert( payload_bytes > 0 );
+    next_assert( payload_bytes <= NEXT_MAX_FEC_PAYLOAD_BYTES );
+
+    xor_data[0] ^= uint8_t( payload_bytes >> 8 );
+    xor_data[1] ^= uint8_t( payload_bytes & 0xFF );
+
+    for ( int i = 0; i < payload_bytes; ++i )
+    {
+        xor_data[2+i] ^= payload_data[i];
+    }
+
+    if ( payload_bytes + 2 > *xor_bytes )
+    {
+        *xor_bytes = payload_bytes + 2;
+    }
+}
+
+inline int next_fec_read_packet( const uint8_t * packet_data, int packet_bytes, bool * parity, int * index, const uint8_t ** payload_data )
+{
+    next_assert( packet_data );
+    next_assert( parity );
+    next_assert( index );
+    next_assert( payload_data );
+
+    // IMPORTANT: for parity packets, index is the number of payloads in the group
+
+    if ( packet_bytes < 2 || packet_bytes > NEXT_MTU )
+        return -1;
+
+    *parity = ( packet_data[0] & NEXT_FEC_PARITY ) != 0;
+    *index = packet_data[0] & 0x7F;
+    *payload_data = packet_data + 1;
+
+    const int payload_bytes = packet_bytes - 1;
+
+    if ( *parity )
+    {
+        if ( *index < 2 || *index > NEXT_FEC_MAX_GROUP_SIZE || payload_bytes < 3 )
+            return -1;
+    }
+    else
+    {
+        if ( *index >= NEXT_FEC_MAX_GROUP_SIZE || payload_bytes > NEXT_MAX_FEC_PAYLOAD_BYTES )
+            return -1;
+    }
+
+    return payload_bytes;
+}
+
+// -----------------------------------------------------------------------------------
+
+struct next_fec_encoder_t
+{
+    int num_packets;
+    uint64_t first_sequence;
+    int parity_bytes;
+    uint8_t parity_data[NEXT_MTU-1];
+};
+
+inline void next_fec_encoder_reset( next_fec_encoder_t * encoder )
+{
+    next_assert( encoder );
+    encoder->num_packets = 0;
+    encoder->first_sequence = 0;
+    encoder->parity_bytes = 0;
+    memset( encoder->parity_data, 0, sizeof(encoder->parity_data) );
+}
+
+inline int next_fec_encoder_write_packet( const next_fec_encoder_t * encoder, uint8_t * buffer, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( encoder );
+    next_assert( buffer );
+    next_assert( payload_data );
+    next_assert( payload_bytes > 0 );
+    next_assert( payload_bytes <= NEXT_MAX_FEC_PAYLOAD_BYTES );
+    next_assert( encoder->num_packets < NEXT_FEC_MAX_GROUP_SIZE );
+
+    buffer[0] = uint8_t( encoder->num_packets );
+    memcpy( buffer + 1, payload_data, size_t(payload_bytes) );
+
+    return payload_bytes + 1;
+}
+
+inline bool next_fec_encoder_add_packet( next_fec_encoder_t * encoder, uint64_t sequence, const uint8_t * payload_data, int payload_bytes, int group_size )
+{
+    next_assert( encoder );
+    next_assert( group_size >= 2 );
+    next_assert( group_size <= NEXT_FEC_MAX_GROUP_SIZE );
+
+    // IMPORTANT: call this after sending the packet from next_fec_encoder_write_packet, with the sequence number it was sent with.
+    // When the sequence doesn't follow on from the group, the group is dropped without parity and the receiver never completes it
+
+    if ( encoder->num_packets == 0 )
+    {
+        encoder->first_sequence = sequence;
+    }
+    else if ( sequence != encoder->first_sequence + uint64_t( encoder->num_packets ) )
+    {
+        next_fec_encoder_reset( encoder );
+        return false;
+    }
+
+    next_fec_xor_payload( encoder->parity_data, &encoder->parity_bytes, payload_data, payload_bytes );
+
+    encoder->num_packets++;
+
+    return encoder->num_packets >= group_size;
+}
+
+inline int next_fec_encoder_write_parity( const next_fec_encoder_t * encoder, uint8_t * buffer )
+{
+    next_assert( encoder );
+    next_assert( buffer );
+    next_assert( encoder->num_packets >= 2 );
+    next_assert( encoder->num_packets <= NEXT_FEC_MAX_GROUP_SIZE );
+
+    buffer[0] = uint8_t( NEXT_FEC_PARITY | encoder->num_packets );
+    memcpy( buffer + 1, encoder->parity_data, size_t(encoder->parity_bytes) );
+
+    return encoder->parity_bytes + 1;
+}
+
+// -----------------------------------------------------------------------------------
+
+struct next_fec_group_t
+{
+    bool active;
+    bool finished;
+    uint64_t base_sequence;
+    uint32_t received_mask;
+    int num_received;
+    int num_packets;                            // zero until the parity packet arrives
+    int xor_bytes;
+    uint8_t xor_data[NEXT_MTU-1];
+};
+
+struct next_fec_decoder_t
+{
+    int recover_group;
+    next_fec_group_t groups[NEXT_FEC_RECEIVE_GROUPS];
+};
+
+inline void next_fec_decoder_reset( next_fec_decoder_t * decoder )
+{
+    next_assert( decoder );
+    decoder->recover_group = -1;
+    for ( int i = 0; i < NEXT_FEC_RECEIVE_GROUPS; ++i )
+    {
+        decoder->groups[i].active = false;
+    }
+}
+
+inline int next_fec_decoder_find_group( next_fec_decoder_t * decoder, uint64_t base_sequence )
+{
+    next_assert( decoder );
+
+    int free_index = -1;
+    int oldest_index = -1;
+
+    for ( int i = 0; i < NEXT_FEC_RECEIVE_GROUPS; ++i )
+    {
+        const next_fec_group_t * group = &decoder->groups[i];
+        if ( !group->active )
+        {
+            if ( free_index < 0 )
+            {
+                free_index = i;
+            }
+            continue;
+        }
+        if ( group->base_sequence == base_sequence )
+            return i;
+        if ( oldest_index < 0 || group->base_sequence < decoder->groups[oldest_index].base_sequence )
+        {
+            oldest_index = i;
+        }
+    }
+
+    // IMPORTANT: when every slot is in use, only replace the oldest group with a newer one. Late packets from an older group are just delivered
+
+    if ( free_index < 0 )
+    {
+        if ( decoder->groups[oldest_index].base_sequence > base_sequence )
+            return -1;
+        free_index = oldest_index;
+    }
+
+    next_fec_group_t * group = &decoder->groups[free_index];
+    group->active = true;
+    group->finished = false;
+    group->base_sequence = base_sequence;
+    group->received_mask = 0;
+    group->num_received = 0;
+    group->num_packets = 0;
+    group->xor_bytes = 0;
+    memset( group->xor_data, 0, sizeof(group->xor_data) );
+
+    return free_index;
+}
+
+inline int next_fec_decoder_add_packet( next_fec_decoder_t * decoder, uint64_t sequence, const uint8_t * packet_data, int packet_bytes, const uint8_t ** payload_data )
+{
+    next_assert( decoder );
+    next_assert( packet_data );
+    next_assert( payload_data );
+
+    // returns the payload bytes for a payload packet, zero for a parity packet and -1 if the packet is malformed
+
+    decoder->recover_group = -1;
+
+    bool parity = false;
+    int index = 0;
+    const int payload_bytes = next_fec_read_packet( packet_data, packet_bytes, &parity, &index, payload_data );
+    if ( payload_bytes < 0 || sequence < uint64_t( index ) )
+        return -1;
+
+    const int group_index = next_fec_decoder_find_group( decoder, sequence - uint64_t( index ) );
+    if ( group_index < 0 )
+        return parity ? 0 : payload_bytes;
+
+    next_fec_group_t * group = &decoder->groups[group_index];
+    if ( group->finished )
+        return parity ? 0 : payload_bytes;
+
+    if ( parity )
+    {
+        if ( group->num_packets != 0 )
+            return 0;
+
+        if ( group->received_mask & ~( ( 1u << index ) - 1 ) )
+        {
+            group->finished = true;
+            return 0;
+        }
+
+        for ( int i = 0; i < payload_bytes; ++i )
+        {
+            group->xor_data[i] ^= (*payload_data)[i];
+        }
+
+        if ( payload_bytes > group->xor_bytes )
+        {
+            group->xor_bytes = payload_bytes;
+        }
+
+        group->num_packets = index;
+    }
+    else
+    {
+        if ( group->num_packets != 0 && index >= group->num_packets )
+        {
+            group->finished = true;
+            return payload_bytes;
+        }
+
+        if ( group->received_mask & ( 1u << index ) )
+            return payload_bytes;
+
+        next_fec_xor_payload( group->xor_data, &group->xor_bytes, *payload_data, payload_bytes );
+
+        group->received_mask |= ( 1u << index );
+        group->num_received++;
+    }
+
+    if ( group->num_packets != 0 )
+    {
+        if ( group->num_received == group->num_packets )
+        {
+            group->finished = true;
+        }
+        else if ( group->num_received == group->num_packets - 1 )
+        {
+            decoder->recover_group = group_index;
+        }
+    }
+
+    return parity ? 0 : payload_bytes;
+}
+
+inline int next_fec_decoder_recover( next_fec_decoder_t * decoder, uint64_t * sequence, const uint8_t ** payload_data )
+{
+    next_assert( decoder );
+    next_assert( sequence );
+    next_assert( payload_data );
+
+    // call after each next_fec_decoder_add_packet. returns the bytes of a payload rebuilt from parity, zero if there is none and -1 if the group is corrupt
+
+    if ( decoder->recover_group < 0 )
+        return 0;
+
+    next_fec_group_t * group = &decoder->groups[decoder->recover_group];
+
+    decoder->recover_group = -1;
+    group->finished = true;
+
+    int missing = 0;
+    while ( group->received_mask & ( 1u << missing ) )
+    {
+        missing++;
+    }
+
+    next_assert( missing < group->num_packets );
+
+    const int payload_bytes = ( int( group->xor_data[0] ) << 8 ) | int( group->xor_data[1] );
+
+    if ( payload_bytes <= 0 || payload_bytes > NEXT_MAX_FEC_PAYLOAD_BYTES || payload_bytes + 2 > group->xor_bytes )
+        return -1;
+
+    *sequence = group->base_sequence + uint64_t( missing );
+    *payload_data = group->xor_data + 2;
+
+    return payload_bytes;
+}
+
+#endif // #ifndef NEXT_FEC_H
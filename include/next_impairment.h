@@ -0,0 +1,79 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_IMPAIRMENT_H
+#define NEXT_IMPAIRMENT_H
+
+#include "next.h"
+
+#if NEXT_DEVELOPMENT
+
+// IMPORTANT: Development only. Impairs packets sent through next_platform_socket_send_packet with latency, jitter, loss
+// bursts, reordering and duplication, configured per destination. All decisions come from one seeded random number
+// generator, so the same seed and the same send order give the same impairment. Delayed packets wait in a timing wheel
+// with NEXT_IMPAIRMENT_SLOT_SECONDS slots and are sent by a background thread when their slot comes up.
+
+struct next_address_t;
+struct next_platform_socket_t;
+
+struct next_impairment_config_t
+{
+    float latency_ms;                           // added to every packet
+    float jitter_ms;                            // uniform random extra delay in [0,jitter_ms]
+    float packet_loss_percent;                  // independent random loss
+    float burst_loss_percent;                   // chance a packet starts a loss burst
+    int burst_length;                           // packets lost in a row once a burst starts
+    float reorder_percent;                      // chance a packet is held back by reorder_ms so later packets overtake it
+    float reorder_ms;
+    float duplicate_percent;                    // chance a packet is sent twice, each copy with its own jitter
+};
+
+struct next_impairment_stats_t
+{
+    uint64_t packets_sent;
+    uint64_t packets_dropped;
+    uint64_t packets_delayed;
+    uint64_t packets_reordered;
+    uint64_t packets_duplicated;
+    uint64_t packets_overflowed;
+    int max_packets_in_flight;
+};
+
+int next_impairment_parse( const char * string, next_impairment_config_t * config );
+
+void next_impairment_seed( uint64_t seed );
+
+int next_impairment_set( const next_address_t * address, const next_impairment_config_t * config );
+
+void next_impairment_clear();
+
+void next_impairment_stats( next_impairment_stats_t * stats );
+
+bool next_impairment_send( next_platform_socket_t * socket, const next_address_t * to, const void * packet_data, int packet_bytes );
+
+void next_impairment_purge( next_platform_socket_t * socket );
+
+void next_impairment_term();
+
+#endif // #if NEXT_DEVELOPMENT
+
+#endif // #ifndef NEXT_IMPAIRMENT_H
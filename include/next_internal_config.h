@@ -38,6 +38,25 @@ struct next_internal_config_t
     int socket_receive_buffer_size;
     bool disable_network_next;
     bool disable_autodetect;
+    bool crypto_worker_thread;
+    bool async_log;
+    int notify_queue_length;
+    int command_queue_length;
+    int queue_overflow_policy;
+    bool memory_pool;
+    int max_sessions;
+    bool immediate_packet_delivery;
+    int client_thread_cpu;
+    int server_thread_cpu;
+    int client_busy_poll_microseconds;
+    int server_busy_poll_microseconds;
+    bool kernel_packet_filter;
+    bool io_uring;
+    char server_xdp_interface[256];
+    int server_xdp_queue;
+    bool payload_coalescing;
+    bool adaptive_multipath;
+    int fec_group_size;
 };
 
 #endif // #ifndef NEXT_H
@@ -0,0 +1,64 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_IO_URING_H
+#define NEXT_IO_URING_H
+
+#include "next.h"
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+// IMPORTANT: Linux only. An io_uring backend for the platform socket. A multishot recvmsg stays posted against a ring of
+// provided receive buffers, so under load packets are received without a syscall each. Sends are copied into send slots
+// and submitted as sendmsg requests, either one at a time or in batches. The socket is registered as a fixed file.
+// Receive must only be called from one thread. Send can be called from any thread.
+
+#include <sys/socket.h>
+
+struct next_io_uring_t;
+
+struct next_io_uring_packet_t
+{
+    const sockaddr_storage * from;
+    msghdr control;                             // only msg_control and msg_controllen are set, for reading cmsgs
+    const uint8_t * packet_data;
+    int packet_bytes;
+    int buffer_id;
+};
+
+next_io_uring_t * next_io_uring_create( void * context, int socket_handle );
+
+void next_io_uring_destroy( next_io_uring_t * uring );
+
+bool next_io_uring_send( next_io_uring_t * uring, const sockaddr * to, socklen_t to_length, const void * packet_data, int packet_bytes );
+
+void next_io_uring_send_batch_begin( next_io_uring_t * uring );
+
+void next_io_uring_send_batch_end( next_io_uring_t * uring );
+
+int next_io_uring_receive( next_io_uring_t * uring, next_io_uring_packet_t * packet, double timeout_seconds, double busy_poll_time );
+
+void next_io_uring_release( next_io_uring_t * uring, next_io_uring_packet_t * packet );
+
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+#endif // #ifndef NEXT_IO_URING_H
@@ -0,0 +1,281 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_LATENCY_HISTOGRAM_H
+#define NEXT_LATENCY_HISTOGRAM_H
+
+#include "next.h"
+#include "next_constants.h"
+#include "next_platform.h"
+
+#include <atomic>
+#include <math.h>
+#include <string.h>
+
+// IMPORTANT: Latency histograms are log-linear like HDR histograms. Values are recorded in nanoseconds, each power of two
+// is split into 2^NEXT_LATENCY_HISTOGRAM_SUB_BUCKET_BITS linear buckets, so any value is reported within 1/16th of its true
+// value, from one nanosecond up to 2^NEXT_LATENCY_HISTOGRAM_MAX_EXPONENT nanoseconds (~68 seconds). Each histogram must
+// only be recorded to from one thread. That lets recording be plain relaxed loads and stores with no locked instructions,
+// while any other thread can read a consistent enough snapshot at any time.
+
+#define NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS ( 1 << NEXT_LATENCY_HISTOGRAM_SUB_BUCKET_BITS )
+
+#define NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS ( ( NEXT_LATENCY_HISTOGRAM_MAX_EXPONENT - NEXT_LATENCY_HISTOGRAM_SUB_BUCKET_BITS + 1 ) * NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS )
+
+#define NEXT_LATENCY_HISTOGRAM_MAX_VALUE ( ( uint64_t(1) << NEXT_LATENCY_HISTOGRAM_MAX_EXPONENT ) - 1 )
+
+struct next_latency_histogram_t
+{
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> min;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS];
+};
+
+inline void next_latency_histogram_reset( next_latency_histogram_t * histogram )
+{
+    next_assert( histogram );
+
+    histogram->count.store( 0, std::memory_order_relaxed );
+    histogram->total.store( 0, std::memory_order_relaxed );
+    histogram->min.store( 0, std::memory_order_relaxed );
+    histogram->max.store( 0, std::memory_order_relaxed );
+    for ( int i = 0; i < NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS; i++ )
+    {
+        histogram->buckets[i].store( 0, std::memory_order_relaxed );
+    }
+}
+
+inline int next_latency_histogram_bucket_index( uint64_t value )
+{
+    if ( value > NEXT_LATENCY_HISTOGRAM_MAX_VALUE )
+        value = NEXT_LATENCY_HISTOGRAM_MAX_VALUE;
+
+    if ( value < NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS )
+        return int( value );
+
+#if defined(__GNUC__)
+    const int exponent = 63 - __builtin_clzll( value );
+#else // #if defined(__GNUC__)
+    int exponent = 0;
+    for ( uint64_t v = value >> 1; v != 0; v >>= 1 )
+    {
+        exponent++;
+    }
+#endif // #if defined(__GNUC__)
+
+    const int shift = exponent - NEXT_LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+
+    const int sub_bucket = int( ( value >> shift ) & ( NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS - 1 ) );
+
+    return ( shift + 1 ) * NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS + sub_bucket;
+}
+
+inline uint64_t next_latency_histogram_bucket_lower_bound( int index )
+{
+    next_assert( index >= 0 );
+    next_assert( index < NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS );
+
+    if ( index < NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS )
+        return uint64_t( index );
+
+    const int shift = index / NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS - 1;
+
+    const int sub_bucket = index % NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+    return uint64_t( NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS + sub_bucket ) << shift;
+}
+
+inline uint64_t next_latency_histogram_bucket_width( int index )
+{
+    next_assert( index >= 0 );
+    next_assert( index < NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS );
+
+    if ( index < NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS )
+        return 1;
+
+    return uint64_t(1) << ( index / NEXT_LATENCY_HISTOGRAM_SUB_BUCKETS - 1 );
+}
+
+inline void next_latency_histogram_record( next_latency_histogram_t * histogram, double seconds )
+{
+    next_assert( histogram );
+
+    const uint64_t value = seconds > 0.0 ? uint64_t( seconds * 1000000000.0 ) : 0;
+
+    const int index = next_latency_histogram_bucket_index( value );
+
+    // IMPORTANT: Single writer, so load + store is safe here and much cheaper than fetch_add.
+
+    histogram->buckets[index].store( histogram->buckets[index].load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+
+    const uint64_t count = histogram->count.load( std::memory_order_relaxed );
+
+    if ( count == 0 || value < histogram->min.load( std::memory_order_relaxed ) )
+    {
+        histogram->min.store( value, std::memory_order_relaxed );
+    }
+
+    if ( value > histogram->max.load( std::memory_order_relaxed ) )
+    {
+        histogram->max.store( value, std::memory_order_relaxed );
+    }
+
+    histogram->total.store( histogram->total.load( std::memory_order_relaxed ) + value, std::memory_order_relaxed );
+
+    histogram->count.store( count + 1, std::memory_order_release );
+}
+
+inline void next_latency_histogram_summary( const next_latency_histogram_t * const * histograms, int num_histograms, next_latency_t * summary )
+{
+    next_assert( histograms );
+    next_assert( num_histograms > 0 );
+    next_assert( summary );
+
+    memset( summary, 0, sizeof(next_latency_t) );
+
+    uint64_t buckets[NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS];
+    memset( buckets, 0, sizeof(buckets) );
+
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+
+    for ( int i = 0; i < num_histograms; i++ )
+    {
+        const next_latency_histogram_t * histogram = histograms[i];
+
+        next_assert( histogram );
+
+        const uint64_t histogram_count = histogram->count.load( std::memory_order_acquire );
+        if ( histogram_count == 0 )
+            continue;
+
+        const uint64_t histogram_min = histogram->min.load( std::memory_order_relaxed );
+        const uint64_t histogram_max = histogram->max.load( std::memory_order_relaxed );
+
+        if ( count == 0 || histogram_min < min )
+            min = histogram_min;
+
+        if ( histogram_max > max )
+            max = histogram_max;
+
+        count += histogram_count;
+        total += histogram->total.load( std::memory_order_relaxed );
+
+        for ( int j = 0; j < NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS; j++ )
+        {
+            buckets[j] += histogram->buckets[j].load( std::memory_order_relaxed );
+        }
+    }
+
+    if ( count == 0 )
+        return;
+
+    // IMPORTANT: The writer may be part way through a record while we read, so the bucket total can be off by one
+    // from the count. Percentiles are taken against the bucket total so they always land on a real bucket.
+
+    uint64_t bucket_total = 0;
+    for ( int i = 0; i < NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS; i++ )
+    {
+        bucket_total += buckets[i];
+    }
+
+    const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    float * results[] = { &summary->p50, &summary->p90, &summary->p99, &summary->p999 };
+
+    int bucket_index = 0;
+    uint64_t cumulative = buckets[0];
+
+    for ( int i = 0; i < int( sizeof(percentiles) / sizeof(double) ); i++ )
+    {
+        uint64_t rank = uint64_t( ceil( percentiles[i] * double( bucket_total ) ) );
+        if ( rank == 0 )
+            rank = 1;
+
+        while ( cumulative < rank && bucket_index < NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS - 1 )
+        {
+            bucket_index++;
+            cumulative += buckets[bucket_index];
+        }
+
+        uint64_t value = next_latency_histogram_bucket_lower_bound( bucket_index ) + next_latency_histogram_bucket_width( bucket_index ) / 2;
+        if ( value < min )
+            value = min;
+        if ( value > max )
+            value = max;
+
+        *results[i] = float( double( value ) / 1000000.0 );
+    }
+
+    summary->count = count;
+    summary->min = float( double( min ) / 1000000.0 );
+    summary->max = float( double( max ) / 1000000.0 );
+    summary->mean = float( double( total ) / double( count ) / 1000000.0 );
+}
+
+// ---------------------------------------------------------------
+
+struct next_latency_timer_t
+{
+    next_latency_histogram_t * histogram;
+    double start_time;
+    next_latency_timer_t( next_latency_histogram_t * histogram ) : histogram(histogram), start_time(next_platform_time()) {}
+    ~next_latency_timer_t() { next_latency_histogram_record( histogram, next_platform_time() - start_time ); }
+};
+
+#define next_latency_timer( _histogram ) next_latency_timer_t __latency_timer( _histogram )
+
+struct next_latency_mutex_helper_t
+{
+    next_platform_mutex_t * mutex;
+    next_latency_histogram_t * hold_histogram;
+    double acquire_time;
+    next_latency_mutex_helper_t( next_platform_mutex_t * mutex, next_latency_histogram_t * wait_histogram, next_latency_histogram_t * hold_histogram );
+    ~next_latency_mutex_helper_t();
+};
+
+#define next_latency_mutex_guard( _mutex, _wait_histogram, _hold_histogram ) next_latency_mutex_helper_t __mutex_helper( _mutex, _wait_histogram, _hold_histogram )
+
+inline next_latency_mutex_helper_t::next_latency_mutex_helper_t( next_platform_mutex_t * mutex, next_latency_histogram_t * wait_histogram, next_latency_histogram_t * hold_histogram ) : mutex(mutex), hold_histogram(hold_histogram)
+{
+    next_assert( mutex );
+    next_assert( wait_histogram );
+    next_assert( hold_histogram );
+    const double start_time = next_platform_time();
+    next_platform_mutex_acquire( mutex );
+    acquire_time = next_platform_time();
+    next_latency_histogram_record( wait_histogram, acquire_time - start_time );
+}
+
+inline next_latency_mutex_helper_t::~next_latency_mutex_helper_t()
+{
+    next_assert( mutex );
+    const double release_time = next_platform_time();
+    next_platform_mutex_release( mutex );
+    next_latency_histogram_record( hold_histogram, release_time - acquire_time );
+    mutex = NULL;
+}
+
+#endif // #ifndef NEXT_LATENCY_HISTOGRAM_H
@@ -35,4 +35,42 @@ void next_address_data( const next_address_t * address, uint8_t * address_data )
 
 bool next_advanced_packet_filter( const uint8_t * data, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address, uint16_t packet_length );
 
+// classic bpf version of the basic packet filter, for the kernel to run on the server socket before packets reach userspace
+
+#define NEXT_BPF_LD                 0x00
+#define NEXT_BPF_LDX                0x01
+#define NEXT_BPF_ALU                0x04
+#define NEXT_BPF_JMP                0x05
+#define NEXT_BPF_RET                0x06
+#define NEXT_BPF_MISC               0x07
+
+#define NEXT_BPF_W                  0x00
+#define NEXT_BPF_B                  0x10
+#define NEXT_BPF_ABS                0x20
+#define NEXT_BPF_LEN                0x80
+
+#define NEXT_BPF_ADD                0x00
+#define NEXT_BPF_OR                 0x40
+#define NEXT_BPF_NEG                0x80
+#define NEXT_BPF_XOR                0xa0
+
+#define NEXT_BPF_JEQ                0x10
+#define NEXT_BPF_JGT                0x20
+#define NEXT_BPF_JGE                0x30
+
+#define NEXT_BPF_K                  0x00
+#define NEXT_BPF_X                  0x08
+
+#define NEXT_BPF_TAX                0x00
+
+struct next_bpf_instruction_t
+{
+    uint16_t code;
+    uint8_t jt;
+    uint8_t jf;
+    uint32_t k;
+};
+
+int next_basic_packet_filter_bpf( next_bpf_instruction_t * program, int max_instructions );
+
 #endif // #ifndef NEXT_PACKET_FILTER_H
@@ -86,6 +86,8 @@ struct NextUpgradeRequestPacket
     uint8_t upcoming_magic[8];
     uint8_t current_magic[8];
     uint8_t previous_magic[8];
+    bool payload_coalescing;
+    bool fec;
 
     NextUpgradeRequestPacket()
     {
@@ -103,6 +105,13 @@ struct NextUpgradeRequestPacket
         serialize_bytes( stream, upcoming_magic, 8 );
         serialize_bytes( stream, current_magic, 8 );
         serialize_bytes( stream, previous_magic, 8 );
+        // IMPORTANT: fields added after the original handshake layout are only present when the protocol versions match,
+        // so a request from a peer on a different protocol still reads cleanly and is rejected as a version mismatch.
+        if ( protocol_version == next_protocol_version() )
+        {
+            serialize_bool( stream, payload_coalescing );
+            serialize_bool( stream, fec );
+        }
         return true;
     }
 };
@@ -117,6 +126,8 @@ struct NextUpgradeResponsePacket
     uint8_t upgrade_token[NEXT_UPGRADE_TOKEN_BYTES];
     int platform_id;
     int connection_type;
+    bool payload_coalescing;
+    bool fec;
 
     NextUpgradeResponsePacket()
     {
@@ -131,6 +142,9 @@ struct NextUpgradeResponsePacket
         serialize_bytes( stream, upgrade_token, NEXT_UPGRADE_TOKEN_BYTES );
         serialize_int( stream, platform_id, NEXT_PLATFORM_UNKNOWN, NEXT_PLATFORM_MAX );
         serialize_int( stream, connection_type, NEXT_CONNECTION_TYPE_UNKNOWN, NEXT_CONNECTION_TYPE_MAX );
+        // IMPORTANT: the client only responds to an upgrade request with a matching protocol version, so these are always present
+        serialize_bool( stream, payload_coalescing );
+        serialize_bool( stream, fec );
         return true;
     }
 };
@@ -937,6 +951,29 @@ struct NextBackendSessionUpdateResponsePacket
 
 // ------------------------------------------------------------------------------------------------------
 
+// IMPORTANT: holds the signed wire bytes of an outstanding backend request, so resends don't have to sign the same packet again.
+// The sequence identifies the request the cache is for. Signing jobs carry it, so a job that completes after the request was
+// sent again or replaced doesn't overwrite the cache. Zero means no request is outstanding.
+
+struct next_backend_packet_cache_t
+{
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+    uint64_t sequence;
+    int packet_bytes;
+    uint8_t packet_id;
+    uint8_t magic[8];
+    uint8_t from_address_data[4];
+    uint8_t to_address_data[4];
+};
+
+void next_backend_packet_cache_clear( next_backend_packet_cache_t * cache );
+
+void next_backend_packet_cache_store( next_backend_packet_cache_t * cache, uint8_t packet_id, const uint8_t * packet_data, int packet_bytes, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address );
+
+bool next_backend_packet_cache_valid( const next_backend_packet_cache_t * cache, uint8_t packet_id, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address );
+
+// ------------------------------------------------------------------------------------------------------
+
 int next_write_direct_packet( uint8_t * packet_data, uint8_t open_session_sequence, uint64_t send_sequence, const uint8_t * game_packet_data, int game_packet_bytes, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address );
 
 int next_write_route_request_packet( uint8_t * packet_data, const uint8_t * token_data, int token_bytes, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address );
@@ -967,10 +1004,18 @@ int next_write_packet( uint8_t packet_id, void * packet_object, uint8_t * packet
 
 bool next_is_payload_packet( uint8_t packet_id );
 
+bool next_is_fast_packet( uint8_t packet_id );
+
 int next_read_packet( uint8_t packet_id, uint8_t * packet_data, int begin, int end, void * packet_object, const int * signed_packet, const int * encrypted_packet, uint64_t * sequence, const uint8_t * sign_public_key, const uint8_t * encrypt_private_key, next_replay_protection_t * replay_protection );
 
 void next_post_validate_packet( uint8_t packet_id, const int * encrypted_packet, uint64_t * sequence, next_replay_protection_t * replay_protection );
 
+void next_sign_backend_packet( uint8_t * packet_data, int * packet_bytes, const uint8_t * sign_private_key );
+
+bool next_verify_backend_packet( uint8_t packet_id, const uint8_t * packet_data, int begin, int end, const uint8_t * sign_public_key );
+
+bool next_verify_backend_packet_batch( int num_packets, const uint8_t * packet_ids, const uint8_t * const * packet_data, const int * begin, const int * end, const uint8_t * sign_public_key );
+
 int next_write_backend_packet( uint8_t packet_id, void * packet_object, uint8_t * packet_data, int * packet_bytes, const int * signed_packet, const uint8_t * sign_private_key, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address );
 
 int next_read_backend_packet( uint8_t packet_id, uint8_t * packet_data, int begin, int end, void * packet_object, const int * signed_packet, const uint8_t * sign_public_key );
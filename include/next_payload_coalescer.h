@@ -0,0 +1,153 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_PAYLOAD_COALESCER_H
+#define NEXT_PAYLOAD_COALESCER_H
+
+#include "next.h"
+#include "next_constants.h"
+
+#include <string.h>
+
+// IMPORTANT: when both sides negotiate payload coalescing, every upgraded payload is a sequence of length prefixed game packets.
+// The prefix is one byte for packets under 128 bytes, otherwise two bytes with the high bit set. Coalesced payloads never exceed
+// the session's largest upgraded payload (NEXT_MTU, or NEXT_MAX_FEC_PAYLOAD_BYTES with fec), so a game packet too large to fit
+// with its prefix is sent passthrough instead.
+
+struct next_payload_coalescer_t
+{
+    int num_packets;
+    int payload_bytes;
+    uint8_t payload_data[NEXT_MTU];
+};
+
+inline int next_payload_coalescer_prefix_bytes( int packet_bytes )
+{
+    return ( packet_bytes < 0x80 ) ? 1 : 2;
+}
+
+inline bool next_payload_coalescer_packet_fits( int packet_bytes, int max_payload_bytes )
+{
+    next_assert( max_payload_bytes <= NEXT_MTU );
+    return packet_bytes > 0 && next_payload_coalescer_prefix_bytes( packet_bytes ) + packet_bytes <= max_payload_bytes;
+}
+
+inline int next_payload_coalescer_write_packet( uint8_t * buffer, const uint8_t * packet_data, int packet_bytes )
+{
+    next_assert( buffer );
+    next_assert( packet_data );
+    next_assert( next_payload_coalescer_packet_fits( packet_bytes, NEXT_MTU ) );
+
+    int prefix_bytes = 0;
+    if ( packet_bytes < 0x80 )
+    {
+        buffer[prefix_bytes++] = uint8_t( packet_bytes );
+    }
+    else
+    {
+        buffer[prefix_bytes++] = uint8_t( 0x80 | ( packet_bytes >> 8 ) );
+        buffer[prefix_bytes++] = uint8_t( packet_bytes & 0xFF );
+    }
+
+    memcpy( buffer + prefix_bytes, packet_data, size_t(packet_bytes) );
+
+    return prefix_bytes + packet_bytes;
+}
+
+inline void next_payload_coalescer_reset( next_payload_coalescer_t * coalescer )
+{
+    next_assert( coalescer );
+    coalescer->num_packets = 0;
+    coalescer->payload_bytes = 0;
+}
+
+inline bool next_payload_coalescer_add_packet( next_payload_coalescer_t * coalescer, const uint8_t * packet_data, int packet_bytes, int max_payload_bytes )
+{
+    next_assert( coalescer );
+    next_assert( packet_data );
+    next_assert( next_payload_coalescer_packet_fits( packet_bytes, max_payload_bytes ) );
+
+    if ( coalescer->payload_bytes + next_payload_coalescer_prefix_bytes( packet_bytes ) + packet_bytes > max_payload_bytes )
+        return false;
+
+    coalescer->payload_bytes += next_payload_coalescer_write_packet( coalescer->payload_data + coalescer->payload_bytes, packet_data, packet_bytes );
+    coalescer->num_packets++;
+
+    next_assert( coalescer->payload_bytes <= NEXT_MTU );
+
+    return true;
+}
+
+inline int next_payload_coalescer_read_packet( const uint8_t * payload_data, int payload_bytes, int * offset, const uint8_t ** packet_data )
+{
+    next_assert( payload_data );
+    next_assert( offset );
+    next_assert( packet_data );
+
+    int index = *offset;
+
+    if ( index >= payload_bytes )
+        return 0;
+
+    int packet_bytes = payload_data[index++];
+
+    if ( packet_bytes & 0x80 )
+    {
+        if ( index >= payload_bytes )
+            return -1;
+        packet_bytes = ( ( packet_bytes & 0x7F ) << 8 ) | payload_data[index++];
+    }
+
+    if ( packet_bytes == 0 || packet_bytes > NEXT_MTU || packet_bytes > payload_bytes - index )
+        return -1;
+
+    *packet_data = payload_data + index;
+    *offset = index + packet_bytes;
+
+    return packet_bytes;
+}
+
+inline int next_payload_coalescer_num_packets( const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( payload_data );
+
+    if ( payload_bytes <= 0 || payload_bytes > NEXT_MTU )
+        return -1;
+
+    int num_packets = 0;
+    int offset = 0;
+    const uint8_t * packet_data = NULL;
+
+    while ( true )
+    {
+        const int packet_bytes = next_payload_coalescer_read_packet( payload_data, payload_bytes, &offset, &packet_data );
+        if ( packet_bytes < 0 )
+            return -1;
+        if ( packet_bytes == 0 )
+            break;
+        num_packets++;
+    }
+
+    return num_packets;
+}
+
+#endif // #ifndef NEXT_PAYLOAD_COALESCER_H
@@ -25,6 +25,7 @@
 
 #include "next.h"
 #include "next_memory_checks.h"
+#include "next_pool.h"
 
 struct next_pending_session_entry_t
 {
@@ -62,8 +63,10 @@ struct next_pending_session_manager_t
     NEXT_DECLARE_SENTINEL(0)
 
     void * context;
+    next_arena_t * arena;
     int size;
     int max_entry_index;
+    int num_expansions;
     next_address_t * addresses;
     next_pending_session_entry_t * entries;
 
@@ -98,7 +101,7 @@ inline void next_pending_session_manager_verify_sentinels( next_pending_session_
 
 void next_pending_session_manager_destroy( next_pending_session_manager_t * pending_session_manager );
 
-inline next_pending_session_manager_t * next_pending_session_manager_create( void * context, int initial_size )
+inline next_pending_session_manager_t * next_pending_session_manager_create( void * context, int initial_size, next_arena_t * arena )
 {
     next_pending_session_manager_t * pending_session_manager = (next_pending_session_manager_t*) next_malloc( context, sizeof(next_pending_session_manager_t) );
 
@@ -111,9 +114,10 @@ inline next_pending_session_manager_t * next_pending_session_manager_create( voi
     next_pending_session_manager_initialize_sentinels( pending_session_manager );
 
     pending_session_manager->context = context;
+    pending_session_manager->arena = arena;
     pending_session_manager->size = initial_size;
-    pending_session_manager->addresses = (next_address_t*) next_malloc( context, initial_size * sizeof(next_address_t) );
-    pending_session_manager->entries = (next_pending_session_entry_t*) next_malloc( context, initial_size * sizeof(next_pending_session_entry_t) );
+    pending_session_manager->addresses = (next_address_t*) next_arena_malloc( arena, context, initial_size * sizeof(next_address_t) );
+    pending_session_manager->entries = (next_pending_session_entry_t*) next_arena_malloc( arena, context, initial_size * sizeof(next_pending_session_entry_t) );
 
     next_assert( pending_session_manager->addresses );
     next_assert( pending_session_manager->entries );
@@ -139,8 +143,8 @@ inline void next_pending_session_manager_destroy( next_pending_session_manager_t
 {
     next_pending_session_manager_verify_sentinels( pending_session_manager );
 
-    next_free( pending_session_manager->context, pending_session_manager->addresses );
-    next_free( pending_session_manager->context, pending_session_manager->entries );
+    next_arena_free( pending_session_manager->arena, pending_session_manager->context, pending_session_manager->addresses );
+    next_arena_free( pending_session_manager->arena, pending_session_manager->context, pending_session_manager->entries );
 
     next_clear_and_free( pending_session_manager->context, pending_session_manager, sizeof(next_pending_session_manager_t) );
 }
@@ -151,14 +155,16 @@ inline bool next_pending_session_manager_expand( next_pending_session_manager_t
 
     int new_size = pending_session_manager->size * 2;
 
+    next_printf( NEXT_LOG_LEVEL_WARN, "pending session manager expanding from %d to %d sessions. set max_sessions in next_config_t to avoid this", pending_session_manager->size, new_size );
+
     next_address_t * new_addresses = (next_address_t*) next_malloc( pending_session_manager->context, new_size * sizeof(next_address_t) );
 
     next_pending_session_entry_t * new_entries = (next_pending_session_entry_t*) next_malloc( pending_session_manager->context, new_size * sizeof(next_pending_session_entry_t) );
 
-    next_assert( pending_session_manager->addresses );
-    next_assert( pending_session_manager->entries );
+    next_assert( new_addresses );
+    next_assert( new_entries );
 
-    if ( pending_session_manager->addresses == NULL || pending_session_manager->entries == NULL )
+    if ( new_addresses == NULL || new_entries == NULL )
     {
         next_free( pending_session_manager->context, new_addresses );
         next_free( pending_session_manager->context, new_entries );
@@ -183,13 +189,14 @@ inline bool next_pending_session_manager_expand( next_pending_session_manager_t
         }
     }
 
-    next_free( pending_session_manager->context, pending_session_manager->addresses );
-    next_free( pending_session_manager->context, pending_session_manager->entries );
+    next_arena_free( pending_session_manager->arena, pending_session_manager->context, pending_session_manager->addresses );
+    next_arena_free( pending_session_manager->arena, pending_session_manager->context, pending_session_manager->entries );
 
     pending_session_manager->addresses = new_addresses;
     pending_session_manager->entries = new_entries;
     pending_session_manager->size = new_size;
     pending_session_manager->max_entry_index = index - 1;
+    pending_session_manager->num_expansions++;
 
     next_pending_session_manager_verify_sentinels( pending_session_manager );
 
@@ -84,6 +84,20 @@ NEXT_EXPORT_FUNC void next_platform_socket_send_packet( struct next_platform_soc
 
 NEXT_EXPORT_FUNC int next_platform_socket_receive_packet( struct next_platform_socket_t * socket, struct next_address_t * from, void * packet_data, int max_packet_size );
 
+NEXT_EXPORT_FUNC int next_platform_socket_receive_packet_with_timestamp( struct next_platform_socket_t * socket, struct next_address_t * from, void * packet_data, int max_packet_size, double * receive_time );
+
+NEXT_EXPORT_FUNC int next_platform_socket_busy_poll( struct next_platform_socket_t * socket, int busy_poll_microseconds );
+
+NEXT_EXPORT_FUNC int next_platform_socket_kernel_packet_filter( struct next_platform_socket_t * socket, bool enable );
+
+NEXT_EXPORT_FUNC int next_platform_socket_io_uring( struct next_platform_socket_t * socket );
+
+NEXT_EXPORT_FUNC void next_platform_socket_send_batch_begin( struct next_platform_socket_t * socket );
+
+NEXT_EXPORT_FUNC void next_platform_socket_send_batch_end( struct next_platform_socket_t * socket );
+
+NEXT_EXPORT_FUNC int next_platform_socket_xdp( struct next_platform_socket_t * socket, const char * interface_name, int queue );
+
 // ----------------------------------------------------------------
 
 NEXT_EXPORT_FUNC struct next_platform_thread_t * next_platform_thread_create( void * context, next_platform_thread_func_t func, void * arg );
@@ -96,6 +110,8 @@ NEXT_EXPORT_FUNC void next_platform_client_thread_priority( struct next_platform
 
 NEXT_EXPORT_FUNC void next_platform_server_thread_priority( struct next_platform_thread_t * thread );
 
+NEXT_EXPORT_FUNC int next_platform_thread_affinity( struct next_platform_thread_t * thread, int cpu );
+
 // ----------------------------------------------------------------
 
 NEXT_EXPORT_FUNC int next_platform_mutex_create( struct next_platform_mutex_t * mutex );
@@ -106,6 +122,16 @@ NEXT_EXPORT_FUNC void next_platform_mutex_acquire( struct next_platform_mutex_t
 
 NEXT_EXPORT_FUNC void next_platform_mutex_release( struct next_platform_mutex_t * mutex );
 
+// ----------------------------------------------------------------
+
+NEXT_EXPORT_FUNC int next_platform_semaphore_create( struct next_platform_semaphore_t * semaphore );
+
+NEXT_EXPORT_FUNC void next_platform_semaphore_destroy( struct next_platform_semaphore_t * semaphore );
+
+NEXT_EXPORT_FUNC void next_platform_semaphore_signal( struct next_platform_semaphore_t * semaphore );
+
+NEXT_EXPORT_FUNC bool next_platform_semaphore_wait( struct next_platform_semaphore_t * semaphore, double timeout_seconds );
+
 #ifdef __cplusplus
 
 struct next_platform_mutex_helper_t
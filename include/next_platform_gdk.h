@@ -66,6 +66,14 @@ struct next_platform_mutex_t
 
 // -------------------------------------
 
+struct next_platform_semaphore_t
+{
+    bool ok;
+    HANDLE handle;
+};
+
+// -------------------------------------
+
 #endif // #ifdef _GAMING_XBOX
 
 #endif // #ifndef NEXT_PLATFORM_GDK_H
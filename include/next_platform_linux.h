@@ -35,11 +35,19 @@
 
 typedef int next_platform_socket_handle_t;
 
+struct next_io_uring_t;
+struct next_xdp_t;
+
 struct next_platform_socket_t
 {
     void * context;
     int type;
     bool ipv6;
+    bool timestamps;
+    double busy_poll_time;
+    float timeout_seconds;
+    next_io_uring_t * io_uring;
+    next_xdp_t * xdp;
     next_platform_socket_handle_t handle;
 };
 
@@ -61,6 +69,16 @@ struct next_platform_mutex_t
 
 // -------------------------------------
 
+struct next_platform_semaphore_t
+{
+    bool ok;
+    int count;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+// -------------------------------------
+
 #endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
 
 #endif // #ifndef NEXT_LINUX_H
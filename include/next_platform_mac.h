@@ -59,6 +59,16 @@ struct next_platform_mutex_t
 
 // -------------------------------------
 
+struct next_platform_semaphore_t
+{
+    bool ok;
+    int count;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+// -------------------------------------
+
 #endif // #if NEXT_PLATFORM == NEXT_PLATFORM_MAC
 
 #endif // #ifndef NEXT_PLATFORM_MAC_H
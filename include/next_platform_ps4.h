@@ -60,6 +60,14 @@ struct next_platform_mutex_t
 
 // -------------------------------------
 
+struct next_platform_semaphore_t
+{
+    bool ok;
+    SceKernelSema handle;
+};
+
+// -------------------------------------
+
 #endif // #if NEXT_PLATFORM == NEXT_PLATFORM_PS4
 
 #endif // #ifndef NEXT_PLATFORM_PS4_H
@@ -64,6 +64,13 @@ struct next_platform_mutex_t
 
 // -------------------------------------
 
+struct next_platform_semaphore_t
+{
+    nn::os::SemaphoreType handle;
+};
+
+// -------------------------------------
+
 #endif // #if NEXT_PLATFORM == NEXT_PLATFORM_SWITCH
 
 #endif // #ifndef NEXT_SWITCH_H
@@ -75,6 +75,14 @@ struct next_platform_mutex_t
 
 // -------------------------------------
 
+struct next_platform_semaphore_t
+{
+    bool ok;
+    HANDLE handle;
+};
+
+// -------------------------------------
+
 #if NEXT_UNREAL_ENGINE
 #include "Windows/PostWindowsApi.h"
 #include "Windows/HideWindowsPlatformTypes.h"
@@ -0,0 +1,292 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef NEXT_POOL_H
+#define NEXT_POOL_H
+
+#include "next.h"
+#include "next_constants.h"
+#include "next_platform.h"
+#include "next_memory_checks.h"
+#include <atomic>
+#include <string.h>
+
+// IMPORTANT: An arena is one block of memory that is handed out front to back while a client or server is being created,
+// and released in one go when it is destroyed. It is not thread safe, so only allocate from it during create.
+
+struct next_arena_t
+{
+    NEXT_DECLARE_SENTINEL(0)
+
+    void * context;
+    uint8_t * data;
+    size_t size;
+    size_t offset;
+
+    NEXT_DECLARE_SENTINEL(1)
+};
+
+inline void next_arena_initialize_sentinels( next_arena_t * arena )
+{
+    (void) arena;
+    next_assert( arena );
+    NEXT_INITIALIZE_SENTINEL( arena, 0 )
+    NEXT_INITIALIZE_SENTINEL( arena, 1 )
+}
+
+inline void next_arena_verify_sentinels( next_arena_t * arena )
+{
+    (void) arena;
+    next_assert( arena );
+    NEXT_VERIFY_SENTINEL( arena, 0 )
+    NEXT_VERIFY_SENTINEL( arena, 1 )
+}
+
+inline next_arena_t * next_arena_create( void * context, size_t size )
+{
+    next_arena_t * arena = (next_arena_t*) next_malloc( context, sizeof(next_arena_t) );
+    next_assert( arena );
+    if ( !arena )
+        return NULL;
+
+    memset( arena, 0, sizeof(next_arena_t) );
+
+    next_arena_initialize_sentinels( arena );
+
+    arena->context = context;
+    arena->size = size + NEXT_ARENA_ALIGNMENT;
+    arena->data = (uint8_t*) next_malloc( context, arena->size );
+
+    if ( !arena->data )
+    {
+        next_free( context, arena );
+        return NULL;
+    }
+
+    next_arena_verify_sentinels( arena );
+
+    return arena;
+}
+
+inline void next_arena_destroy( next_arena_t * arena )
+{
+    next_arena_verify_sentinels( arena );
+
+    next_free( arena->context, arena->data );
+
+    next_clear_and_free( arena->context, arena, sizeof(next_arena_t) );
+}
+
+inline size_t next_arena_align( size_t bytes )
+{
+    return ( bytes + NEXT_ARENA_ALIGNMENT - 1 ) & ~size_t( NEXT_ARENA_ALIGNMENT - 1 );
+}
+
+inline void * next_arena_alloc( next_arena_t * arena, size_t bytes )
+{
+    next_arena_verify_sentinels( arena );
+
+    const uintptr_t base = (uintptr_t) arena->data;
+    const size_t start = size_t( next_arena_align( base + arena->offset ) - base );
+
+    if ( start + bytes > arena->size )
+        return NULL;
+
+    arena->offset = start + bytes;
+
+    return arena->data + start;
+}
+
+inline bool next_arena_contains( next_arena_t * arena, const void * p )
+{
+    return arena && (const uint8_t*) p >= arena->data && (const uint8_t*) p < arena->data + arena->size;
+}
+
+inline void * next_arena_malloc( next_arena_t * arena, void * context, size_t bytes )
+{
+    // IMPORTANT: when there is no arena, or it is full, fall back to the regular allocator
+
+    void * p = arena ? next_arena_alloc( arena, bytes ) : NULL;
+    if ( p )
+        return p;
+
+    return next_malloc( context, bytes );
+}
+
+inline void next_arena_free( next_arena_t * arena, void * context, void * p )
+{
+    if ( next_arena_contains( arena, p ) )
+        return;
+
+    next_free( context, p );
+}
+
+// IMPORTANT: A pool hands out fixed size blocks from a free list. Blocks are allocated on one thread and freed on another,
+// so the free list is protected by a mutex. When the pool is empty, or the block is too small, it falls back to next_malloc.
+
+struct next_pool_t
+{
+    NEXT_DECLARE_SENTINEL(0)
+
+    void * context;
+    next_arena_t * arena;
+    uint8_t * data;
+    int block_size;
+    int num_blocks;
+    int num_free;
+    int min_free;
+    std::atomic<uint64_t> num_fallback_allocs;
+    void * free_list;
+    next_platform_mutex_t mutex;
+
+    NEXT_DECLARE_SENTINEL(1)
+};
+
+inline void next_pool_initialize_sentinels( next_pool_t * pool )
+{
+    (void) pool;
+    next_assert( pool );
+    NEXT_INITIALIZE_SENTINEL( pool, 0 )
+    NEXT_INITIALIZE_SENTINEL( pool, 1 )
+}
+
+inline void next_pool_verify_sentinels( next_pool_t * pool )
+{
+    (void) pool;
+    next_assert( pool );
+    NEXT_VERIFY_SENTINEL( pool, 0 )
+    NEXT_VERIFY_SENTINEL( pool, 1 )
+}
+
+inline next_pool_t * next_pool_create( void * context, next_arena_t * arena, int block_size, int num_blocks )
+{
+    next_assert( block_size > 0 );
+    next_assert( num_blocks > 0 );
+
+    next_pool_t * pool = (next_pool_t*) next_malloc( context, sizeof(next_pool_t) );
+    next_assert( pool );
+    if ( !pool )
+        return NULL;
+
+    char * just_clear_it_and_dont_complain = (char*) pool;
+    memset( just_clear_it_and_dont_complain, 0, sizeof(next_pool_t) );
+
+    next_pool_initialize_sentinels( pool );
+
+    pool->context = context;
+    pool->arena = arena;
+    pool->block_size = (int) next_arena_align( size_t( block_size ) );
+    pool->num_blocks = num_blocks;
+
+    pool->data = (uint8_t*) next_arena_malloc( arena, context, size_t( pool->block_size ) * num_blocks );
+    if ( !pool->data )
+    {
+        next_free( context, pool );
+        return NULL;
+    }
+
+    if ( next_platform_mutex_create( &pool->mutex ) != NEXT_OK )
+    {
+        next_arena_free( arena, context, pool->data );
+        next_free( context, pool );
+        return NULL;
+    }
+
+    for ( int i = num_blocks - 1; i >= 0; --i )
+    {
+        void ** block = (void**) ( pool->data + size_t( i ) * pool->block_size );
+        *block = pool->free_list;
+        pool->free_list = block;
+    }
+
+    pool->num_free = num_blocks;
+    pool->min_free = num_blocks;
+
+    next_pool_verify_sentinels( pool );
+
+    return pool;
+}
+
+inline void next_pool_destroy( next_pool_t * pool )
+{
+    next_pool_verify_sentinels( pool );
+
+    next_platform_mutex_destroy( &pool->mutex );
+
+    next_arena_free( pool->arena, pool->context, pool->data );
+
+    next_clear_and_free( pool->context, pool, sizeof(next_pool_t) );
+}
+
+inline bool next_pool_contains( next_pool_t * pool, const void * p )
+{
+    return pool && (const uint8_t*) p >= pool->data && (const uint8_t*) p < pool->data + size_t( pool->block_size ) * pool->num_blocks;
+}
+
+inline void * next_pool_alloc( next_pool_t * pool, void * context, size_t bytes )
+{
+    // IMPORTANT: pool may be NULL, in which case this is just next_malloc
+
+    if ( !pool )
+        return next_malloc( context, bytes );
+
+    next_pool_verify_sentinels( pool );
+
+    if ( bytes <= size_t( pool->block_size ) )
+    {
+        next_platform_mutex_guard( &pool->mutex );
+        void ** block = (void**) pool->free_list;
+        if ( block )
+        {
+            pool->free_list = *block;
+            pool->num_free--;
+            if ( pool->num_free < pool->min_free )
+            {
+                pool->min_free = pool->num_free;
+            }
+            return block;
+        }
+        pool->num_fallback_allocs++;
+    }
+
+    return next_malloc( pool->context, bytes );
+}
+
+inline void next_pool_free( next_pool_t * pool, void * context, void * p )
+{
+    if ( !next_pool_contains( pool, p ) )
+    {
+        next_free( context, p );
+        return;
+    }
+
+    next_pool_verify_sentinels( pool );
+
+    next_platform_mutex_guard( &pool->mutex );
+    void ** block = (void**) p;
+    *block = pool->free_list;
+    pool->free_list = block;
+    pool->num_free++;
+}
+
+#endif // #ifndef NEXT_POOL_H
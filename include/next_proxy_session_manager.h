@@ -26,6 +26,14 @@
 #include "next.h"
 #include "next_memory_checks.h"
 #include "next_bandwidth_limiter.h"
+#include "next_payload_coalescer.h"
+#include "next_fec.h"
+
+struct next_proxy_session_fec_t
+{
+    next_fec_encoder_t encoder;
+    next_bandwidth_limiter_t send_bandwidth;
+};
 
 struct next_proxy_session_entry_t
 {
@@ -39,6 +47,13 @@ struct next_proxy_session_entry_t
     next_bandwidth_limiter_t send_bandwidth;
 
     NEXT_DECLARE_SENTINEL(2)
+
+    // IMPORTANT: payload coalescing and fec are off by default, so their state is only allocated for sessions that negotiated them
+
+    next_payload_coalescer_t * send_coalescer;
+    next_proxy_session_fec_t * fec;
+
+    NEXT_DECLARE_SENTINEL(3)
 };
 
 inline void next_proxy_session_entry_initialize_sentinels( next_proxy_session_entry_t * entry )
@@ -48,6 +63,7 @@ inline void next_proxy_session_entry_initialize_sentinels( next_proxy_session_en
     NEXT_INITIALIZE_SENTINEL( entry, 0 )
     NEXT_INITIALIZE_SENTINEL( entry, 1 )
     NEXT_INITIALIZE_SENTINEL( entry, 2 )
+    NEXT_INITIALIZE_SENTINEL( entry, 3 )
 }
 
 inline void next_proxy_session_entry_verify_sentinels( next_proxy_session_entry_t * entry )
@@ -57,6 +73,7 @@ inline void next_proxy_session_entry_verify_sentinels( next_proxy_session_entry_
     NEXT_VERIFY_SENTINEL( entry, 0 )
     NEXT_VERIFY_SENTINEL( entry, 1 )
     NEXT_VERIFY_SENTINEL( entry, 2 )
+    NEXT_VERIFY_SENTINEL( entry, 3 )
 }
 
 struct next_proxy_session_manager_t
@@ -66,6 +83,7 @@ struct next_proxy_session_manager_t
     void * context;
     int size;
     int max_entry_index;
+    int num_expansions;
     next_address_t * addresses;
     next_proxy_session_entry_t * entries;
 
@@ -100,6 +118,54 @@ inline void next_proxy_session_manager_verify_sentinels( next_proxy_session_mana
 
 void next_proxy_session_manager_destroy( next_proxy_session_manager_t * session_manager );
 
+inline void next_proxy_session_manager_free_features( next_proxy_session_manager_t * session_manager, next_proxy_session_entry_t * entry )
+{
+    next_assert( entry );
+
+    if ( entry->send_coalescer )
+    {
+        next_free( session_manager->context, entry->send_coalescer );
+        entry->send_coalescer = NULL;
+    }
+
+    if ( entry->fec )
+    {
+        next_free( session_manager->context, entry->fec );
+        entry->fec = NULL;
+    }
+}
+
+inline bool next_proxy_session_manager_enable_features( next_proxy_session_manager_t * session_manager, next_proxy_session_entry_t * entry, bool payload_coalescing, bool fec )
+{
+    next_proxy_session_manager_verify_sentinels( session_manager );
+
+    next_assert( entry );
+    next_assert( entry->send_coalescer == NULL );
+    next_assert( entry->fec == NULL );
+
+    if ( payload_coalescing )
+    {
+        entry->send_coalescer = (next_payload_coalescer_t*) next_malloc( session_manager->context, sizeof(next_payload_coalescer_t) );
+        if ( !entry->send_coalescer )
+            return false;
+        next_payload_coalescer_reset( entry->send_coalescer );
+    }
+
+    if ( fec )
+    {
+        entry->fec = (next_proxy_session_fec_t*) next_malloc( session_manager->context, sizeof(next_proxy_session_fec_t) );
+        if ( !entry->fec )
+        {
+            next_proxy_session_manager_free_features( session_manager, entry );
+            return false;
+        }
+        next_fec_encoder_reset( &entry->fec->encoder );
+        next_bandwidth_limiter_reset( &entry->fec->send_bandwidth );
+    }
+
+    return true;
+}
+
 inline next_proxy_session_manager_t * next_proxy_session_manager_create( void * context, int initial_size )
 {
     next_proxy_session_manager_t * session_manager = (next_proxy_session_manager_t*) next_malloc( context, sizeof(next_proxy_session_manager_t) );
@@ -142,6 +208,17 @@ inline void next_proxy_session_manager_destroy( next_proxy_session_manager_t * s
 {
     next_proxy_session_manager_verify_sentinels( session_manager );
 
+    if ( session_manager->addresses && session_manager->entries )
+    {
+        for ( int i = 0; i <= session_manager->max_entry_index; ++i )
+        {
+            if ( session_manager->addresses[i].type != NEXT_ADDRESS_NONE )
+            {
+                next_proxy_session_manager_free_features( session_manager, &session_manager->entries[i] );
+            }
+        }
+    }
+
     next_free( session_manager->context, session_manager->addresses );
     next_free( session_manager->context, session_manager->entries );
 
@@ -153,13 +230,16 @@ inline bool next_proxy_session_manager_expand( next_proxy_session_manager_t * se
     next_proxy_session_manager_verify_sentinels( session_manager );
 
     int new_size = session_manager->size * 2;
+
+    next_printf( NEXT_LOG_LEVEL_WARN, "proxy session manager expanding from %d to %d sessions. set max_sessions in next_config_t to avoid this", session_manager->size, new_size );
+
     next_address_t * new_addresses = (next_address_t*) next_malloc( session_manager->context, new_size * sizeof(next_address_t) );
     next_proxy_session_entry_t * new_entries = (next_proxy_session_entry_t*) next_malloc( session_manager->context, new_size * sizeof(next_proxy_session_entry_t) );
 
-    next_assert( session_manager->addresses );
-    next_assert( session_manager->entries );
+    next_assert( new_addresses );
+    next_assert( new_entries );
 
-    if ( session_manager->addresses == NULL || session_manager->entries == NULL )
+    if ( new_addresses == NULL || new_entries == NULL )
     {
         next_free( session_manager->context, new_addresses );
         next_free( session_manager->context, new_entries );
@@ -191,6 +271,7 @@ inline bool next_proxy_session_manager_expand( next_proxy_session_manager_t * se
     session_manager->entries = new_entries;
     session_manager->size = new_size;
     session_manager->max_entry_index = index - 1;
+    session_manager->num_expansions++;
 
     next_proxy_session_manager_verify_sentinels( session_manager );
 
@@ -251,6 +332,7 @@ inline void next_proxy_session_manager_remove_at_index( next_proxy_session_manag
     next_assert( index <= session_manager->max_entry_index );
     const int max_index = session_manager->max_entry_index;
     session_manager->addresses[index].type = NEXT_ADDRESS_NONE;
+    next_proxy_session_manager_free_features( session_manager, &session_manager->entries[index] );
     if ( index == max_index )
     {
         while ( index > 0 && session_manager->addresses[index].type == NEXT_ADDRESS_NONE )
@@ -25,12 +25,14 @@
 
 #include "next.h"
 #include "next_memory_checks.h"
+#include "next_pool.h"
 
 struct next_queue_t
 {
     NEXT_DECLARE_SENTINEL(0)
 
     void * context;
+    next_pool_t * pool;
     int size;
     int num_entries;
     int start_index;
@@ -57,6 +59,13 @@ inline void next_queue_verify_sentinels( next_queue_t * queue )
 
 inline void next_queue_destroy( next_queue_t * queue );
 
+inline void next_queue_free_entry( next_queue_t * queue, void * entry )
+{
+    // IMPORTANT: when entries come from a pool, the queue must give them back to that pool and not to next_free
+
+    next_pool_free( queue->pool, queue->context, entry );
+}
+
 inline next_queue_t * next_queue_create( void * context, int size )
 {
     next_queue_t * queue = (next_queue_t*) next_malloc( context, sizeof(next_queue_t) );
@@ -67,6 +76,7 @@ inline next_queue_t * next_queue_create( void * context, int size )
     next_queue_initialize_sentinels( queue );
 
     queue->context = context;
+    queue->pool = NULL;
     queue->size = size;
     queue->num_entries = 0;
     queue->start_index = 0;
@@ -95,7 +105,7 @@ inline void next_queue_clear( next_queue_t * queue )
     for ( int i = 0; i < queue->num_entries; ++i )
     {
         const int index = (start_index + i ) % queue_size;
-        next_free( queue->context, queue->entries[index] );
+        next_queue_free_entry( queue, queue->entries[index] );
         queue->entries[index] = NULL;
     }
 
@@ -122,7 +132,7 @@ inline int next_queue_push( next_queue_t * queue, void * entry )
 
     if ( queue->num_entries == queue->size )
     {
-        next_free( queue->context, entry );
+        next_queue_free_entry( queue, entry );
         return NEXT_ERROR;
     }
 
@@ -134,6 +144,33 @@ inline int next_queue_push( next_queue_t * queue, void * entry )
     return NEXT_OK;
 }
 
+inline int next_queue_push_drop_oldest( next_queue_t * queue, void * entry )
+{
+    next_queue_verify_sentinels( queue );
+
+    next_assert( entry );
+
+    // IMPORTANT: when the queue is full the oldest entry is freed to make room, so the newest entry always gets queued
+
+    int result = NEXT_OK;
+
+    if ( queue->num_entries == queue->size )
+    {
+        next_queue_free_entry( queue, queue->entries[queue->start_index] );
+        queue->entries[queue->start_index] = NULL;
+        queue->start_index = ( queue->start_index + 1 ) % queue->size;
+        queue->num_entries--;
+        result = NEXT_ERROR;
+    }
+
+    int index = ( queue->start_index + queue->num_entries ) % queue->size;
+
+    queue->entries[index] = entry;
+    queue->num_entries++;
+
+    return result;
+}
+
 inline void * next_queue_pop( next_queue_t * queue )
 {
     next_queue_verify_sentinels( queue );
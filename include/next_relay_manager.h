@@ -302,7 +302,7 @@ inline void next_relay_manager_send_pings( next_relay_manager_t * manager, next_
     }
 }
 
-inline void next_relay_manager_process_pong( next_relay_manager_t * manager, const next_address_t * from, uint64_t sequence )
+inline void next_relay_manager_process_pong( next_relay_manager_t * manager, const next_address_t * from, uint64_t sequence, double pong_receive_time )
 {
     next_relay_manager_verify_sentinels( manager );
 
@@ -312,7 +312,7 @@ inline void next_relay_manager_process_pong( next_relay_manager_t * manager, con
     {
         if ( next_address_equal( from, &manager->relay_addresses[i] ) )
         {
-            next_ping_history_pong_received( &manager->relay_ping_history[i], sequence, next_platform_time() );
+            next_ping_history_pong_received( &manager->relay_ping_history[i], sequence, pong_receive_time );
             return;
         }
     }
@@ -24,9 +24,20 @@
 #define NEXT_ROUTE_MANAGER_H
 
 #include "next.h"
+#include "next_address.h"
+#include "next_crypto.h"
 
 struct next_route_manager_t;
 
+struct next_route_manager_send_route_t
+{
+    next_address_t next_address;
+    uint64_t session_id;
+    uint8_t session_version;
+    uint8_t private_key[NEXT_CRYPTO_BOX_SECRETKEYBYTES];
+    bool current_route;
+};
+
 void next_route_manager_initialize_sentinels( next_route_manager_t * route_manager );
 
 void next_route_manager_verify_sentinels( next_route_manager_t * route_manager );
@@ -49,9 +60,13 @@ void next_route_manager_update( next_route_manager_t * route_manager, int update
 
 bool next_route_manager_has_network_next_route( next_route_manager_t * route_manager );
 
+// IMPORTANT: these three are called from the game thread without the route manager mutex, so sending a packet never waits on the internal thread
+
 uint64_t next_route_manager_next_send_sequence( next_route_manager_t * route_manager );
 
-bool next_route_manager_prepare_send_packet( next_route_manager_t * route_manager, uint64_t sequence, next_address_t * to, const uint8_t * payload_data, int payload_bytes, uint8_t * packet_data, int * packet_bytes, const uint8_t * magic, const next_address_t * client_external_address );
+void next_route_manager_get_send_route( next_route_manager_t * route_manager, next_route_manager_send_route_t * send_route );
+
+bool next_route_manager_prepare_send_packet( next_route_manager_t * route_manager, const next_route_manager_send_route_t * send_route, uint64_t sequence, next_address_t * to, const uint8_t * payload_data, int payload_bytes, uint8_t * packet_data, int * packet_bytes, const uint8_t * magic, const next_address_t * client_external_address );
 
 bool next_route_manager_process_server_to_client_packet( next_route_manager_t * route_manager, uint8_t packet_type, uint8_t * packet_data, int packet_bytes, uint64_t * payload_sequence );
 
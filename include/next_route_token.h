@@ -73,6 +73,53 @@ inline void next_read_route_token( next_route_token_t * token, const uint8_t * b
     next_assert( p - buffer == NEXT_ROUTE_TOKEN_BYTES );
 }
 
+inline void next_write_route_token( const next_route_token_t * token, uint8_t * buffer )
+{
+    next_assert( token );
+    next_assert( buffer );
+
+    uint8_t * p = buffer;
+
+    uint16_t next_port = token->next_port;
+    uint16_t prev_port = token->prev_port;
+
+    // IMPORTANT: ports are stored in big endian order because it works better with xdp relay
+#if NEXT_LITTLE_ENDIAN
+    next_port = next::bswap( next_port );
+    prev_port = next::bswap( prev_port );
+#endif // #if NEXT_LITTLE_ENDIAN
+
+    next_write_bytes( &p, token->private_key, NEXT_SESSION_PRIVATE_KEY_BYTES );
+    next_write_uint64( &p, token->expire_timestamp );
+    next_write_uint64( &p, token->session_id );
+    next_write_uint32( &p, token->kbps_up );
+    next_write_uint32( &p, token->kbps_down );
+    next_write_uint32( &p, token->next_address );
+    next_write_uint32( &p, token->prev_address );
+    next_write_uint16( &p, next_port );
+    next_write_uint16( &p, prev_port );
+    next_write_uint8( &p, token->session_version );
+    next_write_uint8( &p, token->next_internal );
+    next_write_uint8( &p, token->prev_internal );
+
+    next_assert( p - buffer == NEXT_ROUTE_TOKEN_BYTES );
+}
+
+inline int next_encrypt_route_token( const uint8_t * key, const uint8_t * nonce, const uint8_t * token_data, uint8_t * buffer )
+{
+    next_assert( key );
+    next_assert( nonce );
+    next_assert( token_data );
+    next_assert( buffer );
+    unsigned long long encrypted_len;
+    if ( next_crypto_aead_xchacha20poly1305_ietf_encrypt( buffer, &encrypted_len, token_data, NEXT_ROUTE_TOKEN_BYTES, NULL, 0, NULL, nonce, key ) != 0 )
+    {
+        return NEXT_ERROR;
+    }
+    next_assert( encrypted_len == NEXT_ROUTE_TOKEN_BYTES + 16 );
+    return NEXT_OK;
+}
+
 inline int next_decrypt_route_token( const uint8_t * key, const uint8_t * nonce, uint8_t * buffer, uint8_t * decrypted )
 {
     next_assert( key );
@@ -109,4 +156,32 @@ inline int next_read_encrypted_route_token( uint8_t ** buffer, next_route_token_
     return NEXT_OK;
 }
 
+// IMPORTANT: route tokens are written by the backend. The SDK only writes them for tests and the local relay stand-in
+
+inline int next_write_encrypted_route_token( uint8_t ** buffer, const next_route_token_t * token, const uint8_t * key )
+{
+    next_assert( buffer );
+    next_assert( token );
+    next_assert( key );
+
+    uint8_t * nonce = *buffer;
+
+    next_crypto_random_bytes( nonce, 24 );
+
+    *buffer += 24;
+
+    uint8_t token_data[NEXT_ROUTE_TOKEN_BYTES];
+
+    next_write_route_token( token, token_data );
+
+    if ( next_encrypt_route_token( key, nonce, token_data, *buffer ) != NEXT_OK )
+    {
+        return NEXT_ERROR;
+    }
+
+    *buffer += NEXT_ROUTE_TOKEN_BYTES + 16;
+
+    return NEXT_OK;
+}
+
 #endif // #ifndef NEXT_ROUTE_TOKEN_H
@@ -74,4 +74,10 @@ void next_server_set_payload_receive_callback( struct next_server_t * server, in
 
 bool next_server_direct_only( struct next_server_t * server );
 
+void next_server_metrics( next_server_t * server, next_server_metrics_t * metrics );
+
+void next_server_counters( next_server_t * server, uint64_t * counters );
+
+int next_server_session_stats( next_server_t * server, next_address_t * addresses, next_server_stats_t * stats, int max_sessions );
+
 #endif // #ifndef NEXT_SERVER_H
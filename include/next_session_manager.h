@@ -30,7 +30,10 @@
 #include "next_packet_loss_tracker.h"
 #include "next_out_of_order_tracker.h"
 #include "next_jitter_tracker.h"
+#include "next_adaptive_multipath.h"
+#include "next_fec.h"
 #include "next_platform.h"
+#include "next_pool.h"
 
 struct next_session_entry_t
 {
@@ -46,6 +49,8 @@ struct next_session_entry_t
     uint64_t previous_session_events;
     uint64_t current_session_events;
     uint8_t client_open_session_sequence;
+    bool payload_coalescing;
+    bool fec;
 
     NEXT_DECLARE_SENTINEL(1)
 
@@ -177,10 +182,14 @@ struct next_session_entry_t
     next_packet_loss_tracker_t packet_loss_tracker;
     next_out_of_order_tracker_t out_of_order_tracker;
     next_jitter_tracker_t jitter_tracker;
+    next_adaptive_multipath_t adaptive_multipath;
+    next_fec_decoder_t * fec_decoder;                   // IMPORTANT: only allocated for sessions that negotiated fec
 
     NEXT_DECLARE_SENTINEL(17)
 
     bool mutex_multipath;
+    bool mutex_multipath_duplicate;
+    bool mutex_multipath_prefer_direct;
     int mutex_envelope_kbps_up;
     int mutex_envelope_kbps_down;
     uint64_t mutex_payload_send_sequence;
@@ -218,6 +227,7 @@ struct next_session_entry_t
     double next_client_relay_request_packet_send_time;
     double client_relay_request_timeout_time;
     NextBackendClientRelayRequestPacket client_relay_request_packet;
+    next_backend_packet_cache_t client_relay_request_packet_cache;
     NextBackendClientRelayResponsePacket client_relay_response_packet;
 
     NEXT_DECLARE_SENTINEL(23)
@@ -309,8 +319,10 @@ struct next_session_manager_t
     NEXT_DECLARE_SENTINEL(0)
 
     void * context;
+    next_arena_t * arena;
     int size;
     int max_entry_index;
+    int num_expansions;
     uint64_t * session_ids;
     next_address_t * addresses;
     next_session_entry_t * entries;
@@ -346,7 +358,7 @@ inline void next_session_manager_verify_sentinels( next_session_manager_t * sess
 
 void next_session_manager_destroy( next_session_manager_t * session_manager );
 
-inline next_session_manager_t * next_session_manager_create( void * context, int initial_size )
+inline next_session_manager_t * next_session_manager_create( void * context, int initial_size, next_arena_t * arena )
 {
     next_session_manager_t * session_manager = (next_session_manager_t*) next_malloc( context, sizeof(next_session_manager_t) );
 
@@ -359,10 +371,11 @@ inline next_session_manager_t * next_session_manager_create( void * context, int
     next_session_manager_initialize_sentinels( session_manager );
 
     session_manager->context = context;
+    session_manager->arena = arena;
     session_manager->size = initial_size;
-    session_manager->session_ids = (uint64_t*) next_malloc( context, size_t(initial_size) * 8 );
-    session_manager->addresses = (next_address_t*) next_malloc( context, size_t(initial_size) * sizeof(next_address_t) );
-    session_manager->entries = (next_session_entry_t*) next_malloc( context, size_t(initial_size) * sizeof(next_session_entry_t) );
+    session_manager->session_ids = (uint64_t*) next_arena_malloc( arena, context, size_t(initial_size) * 8 );
+    session_manager->addresses = (next_address_t*) next_arena_malloc( arena, context, size_t(initial_size) * sizeof(next_address_t) );
+    session_manager->entries = (next_session_entry_t*) next_arena_malloc( arena, context, size_t(initial_size) * sizeof(next_session_entry_t) );
 
     next_assert( session_manager->session_ids );
     next_assert( session_manager->addresses );
@@ -387,9 +400,20 @@ inline void next_session_manager_destroy( next_session_manager_t * session_manag
 {
     next_session_manager_verify_sentinels( session_manager );
 
-    next_free( session_manager->context, session_manager->session_ids );
-    next_free( session_manager->context, session_manager->addresses );
-    next_free( session_manager->context, session_manager->entries );
+    if ( session_manager->session_ids && session_manager->addresses && session_manager->entries )
+    {
+        for ( int i = 0; i <= session_manager->max_entry_index; ++i )
+        {
+            if ( session_manager->session_ids[i] != 0 && session_manager->entries[i].fec_decoder )
+            {
+                next_free( session_manager->context, session_manager->entries[i].fec_decoder );
+            }
+        }
+    }
+
+    next_arena_free( session_manager->arena, session_manager->context, session_manager->session_ids );
+    next_arena_free( session_manager->arena, session_manager->context, session_manager->addresses );
+    next_arena_free( session_manager->arena, session_manager->context, session_manager->entries );
 
     next_clear_and_free( session_manager->context, session_manager, sizeof(next_session_manager_t) );
 }
@@ -402,6 +426,10 @@ inline bool next_session_manager_expand( next_session_manager_t * session_manage
 
     int new_size = session_manager->size * 2;
 
+    // IMPORTANT: expanding moves every entry, so pointers to entries are only stable while the initial size holds
+
+    next_printf( NEXT_LOG_LEVEL_WARN, "session manager expanding from %d to %d sessions. set max_sessions in next_config_t to avoid this", session_manager->size, new_size );
+
     uint64_t * new_session_ids = (uint64_t*) next_malloc( session_manager->context, size_t(new_size) * 8 );
     next_address_t * new_addresses = (next_address_t*) next_malloc( session_manager->context, size_t(new_size) * sizeof(next_address_t) );
     next_session_entry_t * new_entries = (next_session_entry_t*) next_malloc( session_manager->context, size_t(new_size) * sizeof(next_session_entry_t) );
@@ -435,15 +463,16 @@ inline bool next_session_manager_expand( next_session_manager_t * session_manage
         }
     }
 
-    next_free( session_manager->context, session_manager->session_ids );
-    next_free( session_manager->context, session_manager->addresses );
-    next_free( session_manager->context, session_manager->entries );
+    next_arena_free( session_manager->arena, session_manager->context, session_manager->session_ids );
+    next_arena_free( session_manager->arena, session_manager->context, session_manager->addresses );
+    next_arena_free( session_manager->arena, session_manager->context, session_manager->entries );
 
     session_manager->session_ids = new_session_ids;
     session_manager->addresses = new_addresses;
     session_manager->entries = new_entries;
     session_manager->size = new_size;
     session_manager->max_entry_index = index - 1;
+    session_manager->num_expansions++;
 
     return true;
 }
@@ -464,6 +493,7 @@ inline void next_clear_session_entry( next_session_entry_t * entry, const next_a
     next_packet_loss_tracker_reset( &entry->packet_loss_tracker );
     next_out_of_order_tracker_reset( &entry->out_of_order_tracker );
     next_jitter_tracker_reset( &entry->jitter_tracker );
+    next_adaptive_multipath_reset( &entry->adaptive_multipath );
 
     next_session_entry_verify_sentinels( entry );
 
@@ -525,6 +555,22 @@ inline next_session_entry_t * next_session_manager_add( next_session_manager_t *
     return entry;
 }
 
+inline bool next_session_manager_enable_fec( next_session_manager_t * session_manager, next_session_entry_t * entry )
+{
+    next_session_manager_verify_sentinels( session_manager );
+
+    next_assert( entry );
+    next_assert( entry->fec_decoder == NULL );
+
+    entry->fec_decoder = (next_fec_decoder_t*) next_malloc( session_manager->context, sizeof(next_fec_decoder_t) );
+    if ( !entry->fec_decoder )
+        return false;
+
+    next_fec_decoder_reset( entry->fec_decoder );
+
+    return true;
+}
+
 inline void next_session_manager_remove_at_index( next_session_manager_t * session_manager, int index )
 {
     next_session_manager_verify_sentinels( session_manager );
@@ -532,6 +578,13 @@ inline void next_session_manager_remove_at_index( next_session_manager_t * sessi
     next_assert( index >= 0 );
     next_assert( index <= session_manager->max_entry_index );
 
+    next_session_entry_t * entry = &session_manager->entries[index];
+    if ( entry->fec_decoder )
+    {
+        next_free( session_manager->context, entry->fec_decoder );
+        entry->fec_decoder = NULL;
+    }
+
     const int max_index = session_manager->max_entry_index;
     session_manager->session_ids[index] = 0;
     session_manager->addresses[index].type = NEXT_ADDRESS_NONE;
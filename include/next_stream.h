@@ -335,6 +335,128 @@ namespace next
         BitReader m_reader;             ///< The bit reader used for all bitpacked read operations.
     };
 
+    /**
+        Stream class for measuring how many bits a serialize function writes, without writing anything.
+        It looks like a write stream to serialize functions, so it takes the same code path as WriteStream and returns the same size.
+        Use this to size packets and buffers up front, or to check a packet fits before you write it.
+        IMPORTANT: Generally, you don't call methods on this class directly. Use the serialize_* macros instead.
+     */
+
+    class MeasureStream : public BaseStream
+    {
+    public:
+
+        enum { IsWriting = 1 };
+        enum { IsReading = 0 };
+
+        /**
+            Measure stream constructor.
+         */
+
+        MeasureStream() : BaseStream(), m_bitsWritten( 0 ) {}
+
+        /**
+            Serialize an integer (measure).
+            @param value The integer value in [min,max].
+            @param min The minimum value.
+            @param max The maximum value.
+            @returns Always returns true.
+         */
+
+        bool SerializeInteger( int32_t value, int32_t min, int32_t max )
+        {
+            (void) value;
+            next_assert( min < max );
+            next_assert( value >= min );
+            next_assert( value <= max );
+            m_bitsWritten += bits_required( min, max );
+            return true;
+        }
+
+        /**
+            Serialize a number of bits (measure).
+            @param value The unsigned integer value to serialize. Must be in range [0,(1<<bits)-1].
+            @param bits The number of bits to measure in [1,32].
+            @returns Always returns true.
+         */
+
+        bool SerializeBits( uint32_t value, int bits )
+        {
+            (void) value;
+            next_assert( bits > 0 );
+            next_assert( bits <= 32 );
+            m_bitsWritten += bits;
+            return true;
+        }
+
+        /**
+            Serialize an array of bytes (measure).
+            @param data Array of bytes that would be written.
+            @param bytes The number of bytes to measure.
+            @returns Always returns true.
+         */
+
+        bool SerializeBytes( const uint8_t * data, int bytes )
+        {
+            (void) data;
+            next_assert( bytes >= 0 );
+            SerializeAlign();
+            m_bitsWritten += bytes * 8;
+            return true;
+        }
+
+        /**
+            Serialize an align (measure).
+            @returns Always returns true.
+         */
+
+        bool SerializeAlign()
+        {
+            m_bitsWritten += GetAlignBits();
+            return true;
+        }
+
+        /**
+            If we were to write an align right now, how many bits would be required?
+            @returns The number of zero pad bits required to achieve byte alignment in [0,7].
+         */
+
+        int GetAlignBits() const
+        {
+            return ( 8 - ( m_bitsWritten % 8 ) ) % 8;
+        }
+
+        /**
+            Does nothing. Present so the measure stream can stand in for a write stream.
+         */
+
+        void Flush() {}
+
+        /**
+            How many bytes would have been written so far?
+            @returns Number of bytes that would be written. This is effectively the packet size.
+         */
+
+        int GetBytesProcessed() const
+        {
+            return ( m_bitsWritten + 7 ) / 8;
+        }
+
+        /**
+            Get number of bits that would have been written so far.
+            @returns Number of bits measured.
+         */
+
+        int GetBitsProcessed() const
+        {
+            return m_bitsWritten;
+        }
+
+    private:
+
+        int m_bitsWritten;              ///< The number of bits measured so far.
+    };
+
     /**
         Serialize integer value (read/write).
         This is a helper macro to make writing unified serialize functions easier.
@@ -118,10 +118,17 @@ namespace next
 
     inline int bits_required( uint32_t min, uint32_t max )
     {
+        // IMPORTANT: branch free. min == max falls out naturally as zero bits
 #ifdef __GNUC__
-        return ( min == max ) ? 0 : 32 - __builtin_clz( max - min );
+        return 63 - __builtin_clzll( ( uint64_t( max - min ) << 1 ) | 1 );
 #else // #ifdef __GNUC__
-        return ( min == max ) ? 0 : log2( max - min ) + 1;
+        const uint32_t x = max - min;
+        const uint32_t a = x | ( x >> 1 );
+        const uint32_t b = a | ( a >> 2 );
+        const uint32_t c = b | ( b >> 4 );
+        const uint32_t d = c | ( c >> 8 );
+        const uint32_t e = d | ( d >> 16 );
+        return popcount( e );
 #endif // #ifdef __GNUC__
     }
 
@@ -0,0 +1,56 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NEXT_XDP_H
+#define NEXT_XDP_H
+
+#include "next.h"
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+// IMPORTANT: Linux only. An AF_XDP fast path for the platform socket. A small XDP program on the interface redirects
+// IPv4 UDP packets for the bound port into a UMEM ring, so they are received without going through the kernel network
+// stack. Sends are written as raw ethernet frames to the TX ring. The next hop MAC and local IP for each peer are learned
+// from the frames it sends us, so sends to a peer we haven't heard from through XDP return false and the caller falls
+// back to the regular socket. Loopback peers are always sent to through the regular socket. Receive must only be called from one thread. Send can be called from any thread.
+
+struct next_address_t;
+
+struct next_xdp_t;
+
+next_xdp_t * next_xdp_create( void * context, const char * interface_name, int queue, uint16_t port );
+
+void next_xdp_destroy( next_xdp_t * xdp );
+
+int next_xdp_handle( next_xdp_t * xdp );
+
+bool next_xdp_send( next_xdp_t * xdp, const next_address_t * to, const void * packet_data, int packet_bytes );
+
+void next_xdp_send_batch_begin( next_xdp_t * xdp );
+
+void next_xdp_send_batch_end( next_xdp_t * xdp );
+
+int next_xdp_receive( next_xdp_t * xdp, next_address_t * from, void * packet_data, int max_packet_size );
+
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+#endif // #ifndef NEXT_XDP_H
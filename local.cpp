@@ -0,0 +1,853 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "next.h"
+#include "next_platform.h"
+#include "next_address.h"
+#include "next_base64.h"
+#include "next_crypto.h"
+#include "next_read_write.h"
+#include "next_header.h"
+#include "next_packets.h"
+#include "next_packet_filter.h"
+#include "next_route_token.h"
+#include "next_continue_token.h"
+
+#include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// IMPORTANT: local is a stand-in for the network next backend and relays, so the full next route data path can be load
+// tested offline on one machine. It runs a backend that answers server init, server update, relay and session update
+// requests, and a chain of relays that forward route requests, continue requests and session packets between client and
+// server. Every session update is answered with a route across all local relays. It is not secure and it is not a relay:
+// ping tokens and buyer signatures are not checked, and there is no bandwidth limiting or replay protection. Export the
+// public keys printed at startup before running the server and clients (eg. perf --mode next).
+
+extern int next_signed_packets[256];
+
+#define LOCAL_MAX_RELAYS ( NEXT_MAX_TOKENS - 2 )
+
+const int LocalMaxSessions = 16384;
+const uint64_t LocalRouteSeconds = uint64_t( NEXT_SLICE_SECONDS * 2 );
+const int LocalRouteKbps = 1024;
+
+// IMPORTANT: these keys are for local testing only. They are public, so never use them with a real backend
+
+const char * local_server_backend_public_key = "fWalwU0U/XpMGGwbgipH7N366QKqkRnJCIQN4VQYKw8=";
+const char * local_server_backend_private_key = "fZ8nkNYGMNQ20mmmckf5FtwVIKXLPE68ERzOXM61hjl9ZqXBTRT9ekwYbBuCKkfs3frpAqqRGckIhA3hVBgrDw==";
+const char * local_relay_backend_public_key = "OuSL4noCbJPYaRj97FeMQ4q0TBUO8tx4Frq+8QH0TDA=";
+const char * local_relay_backend_private_key = "7YzfmtolQhjddpzSL4v7YBB+qukd1TdJ5qdaxXSNtW0=";
+
+struct local_config_t
+{
+    char address[256];
+    int port;
+    int num_relays;
+};
+
+struct local_backend_session_t
+{
+    uint64_t session_id;
+    uint64_t expire_timestamp;
+    uint8_t session_version;
+    bool has_route;
+};
+
+struct local_relay_session_t
+{
+    uint64_t session_id;
+    uint64_t expire_timestamp;
+    uint8_t session_version;
+    uint8_t private_key[NEXT_SESSION_PRIVATE_KEY_BYTES];
+    next_address_t prev_address;
+    next_address_t next_address;
+};
+
+struct local_relay_t
+{
+    int index;
+    uint64_t relay_id;
+    next_address_t address;
+    uint8_t address_data[4];
+    next_platform_socket_t * socket;
+    next_platform_thread_t * thread;
+    local_relay_session_t * sessions;
+    uint64_t routes_created;
+    uint64_t packets_forwarded;
+    uint64_t packets_dropped;
+};
+
+static local_config_t local_config;
+
+static uint8_t local_magic[8];
+
+static uint8_t local_backend_public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+static uint8_t local_backend_private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+static uint8_t local_relay_public_key[NEXT_CRYPTO_KX_PUBLICKEYBYTES];
+static uint8_t local_relay_private_key[NEXT_CRYPTO_KX_SECRETKEYBYTES];
+
+// IMPORTANT: real relays each have their own key. Here every relay shares one key that only this process knows
+
+static uint8_t local_relay_token_key[32];
+
+static next_address_t local_backend_address;
+
+static local_backend_session_t * local_backend_sessions;
+
+static local_relay_t local_relays[LOCAL_MAX_RELAYS];
+
+static uint64_t local_session_updates;
+static uint64_t local_routes_issued;
+
+static volatile int quit = 0;
+
+void interrupt_handler( int signal )
+{
+    (void) signal; quit = 1;
+}
+
+static uint64_t local_timestamp()
+{
+    return uint64_t( time( NULL ) );
+}
+
+// IMPORTANT: session tables are direct mapped. A colliding session just replaces the old one, which is fine for testing
+
+static local_backend_session_t * local_backend_session( uint64_t session_id )
+{
+    local_backend_session_t * session = &local_backend_sessions[session_id % LocalMaxSessions];
+    if ( session->session_id != session_id )
+    {
+        memset( session, 0, sizeof(local_backend_session_t) );
+        session->session_id = session_id;
+    }
+    return session;
+}
+
+static local_relay_session_t * local_relay_find_session( local_relay_t * relay, uint64_t session_id, uint8_t session_version )
+{
+    local_relay_session_t * session = &relay->sessions[( session_id ^ session_version ) % LocalMaxSessions];
+    if ( session->session_id != session_id || session->session_version != session_version )
+        return NULL;
+    if ( session->expire_timestamp < local_timestamp() )
+        return NULL;
+    return session;
+}
+
+static local_relay_session_t * local_relay_add_session( local_relay_t * relay, uint64_t session_id, uint8_t session_version )
+{
+    local_relay_session_t * session = &relay->sessions[( session_id ^ session_version ) % LocalMaxSessions];
+    memset( session, 0, sizeof(local_relay_session_t) );
+    session->session_id = session_id;
+    session->session_version = session_version;
+    return session;
+}
+
+// ---------------------------------------------------------------------------------------
+
+static void local_backend_send_packet( next_platform_socket_t * socket, const next_address_t * to, uint8_t packet_id, void * packet_object )
+{
+    uint8_t magic[8];
+    memset( magic, 0, sizeof(magic) );
+
+    uint8_t from_address_data[4];
+    uint8_t to_address_data[4];
+
+    next_address_data( &local_backend_address, from_address_data );
+    next_address_data( to, to_address_data );
+
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+    int packet_bytes = 0;
+
+    if ( next_write_backend_packet( packet_id, packet_object, packet_data, &packet_bytes, next_signed_packets, local_backend_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "backend failed to write packet %d", packet_id );
+        return;
+    }
+
+    next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
+    next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
+
+    next_platform_socket_send_packet( socket, to, packet_data, packet_bytes );
+}
+
+static void local_backend_relays( int * num_relays, uint64_t * relay_ids, next_address_t * relay_addresses, uint8_t * relay_ping_tokens, int max_relays )
+{
+    *num_relays = local_config.num_relays < max_relays ? local_config.num_relays : max_relays;
+    for ( int i = 0; i < *num_relays; ++i )
+    {
+        relay_ids[i] = local_relays[i].relay_id;
+        relay_addresses[i] = local_relays[i].address;
+        next_crypto_random_bytes( relay_ping_tokens + i * NEXT_PING_TOKEN_BYTES, NEXT_PING_TOKEN_BYTES );
+    }
+}
+
+static bool local_backend_session_keys( const NextBackendSessionUpdateRequestPacket * request, uint8_t * client_key, uint8_t * server_key )
+{
+    // IMPORTANT: client and server derive their secret keys as kx clients with a NULL tx, which leaves their tx key in the rx
+    // buffer. Their tx key is our rx key
+
+    uint8_t tx[NEXT_CRYPTO_KX_SESSIONKEYBYTES];
+
+    if ( next_crypto_kx_server_session_keys( client_key, tx, local_relay_public_key, local_relay_private_key, request->client_route_public_key ) != 0 )
+        return false;
+
+    if ( next_crypto_kx_server_session_keys( server_key, tx, local_relay_public_key, local_relay_private_key, request->server_route_public_key ) != 0 )
+        return false;
+
+    return true;
+}
+
+static bool local_backend_write_route_tokens( const NextBackendSessionUpdateRequestPacket * request, local_backend_session_t * session, NextBackendSessionUpdateResponsePacket * response )
+{
+    const int num_tokens = local_config.num_relays + 2;
+
+    next_address_t addresses[NEXT_MAX_TOKENS];
+    addresses[0] = request->client_address;
+    for ( int i = 0; i < local_config.num_relays; ++i )
+    {
+        addresses[1+i] = local_relays[i].address;
+    }
+    addresses[num_tokens-1] = request->server_address;
+
+    uint8_t client_key[NEXT_CRYPTO_KX_SESSIONKEYBYTES];
+    uint8_t server_key[NEXT_CRYPTO_KX_SESSIONKEYBYTES];
+    if ( !local_backend_session_keys( request, client_key, server_key ) )
+        return false;
+
+    uint8_t session_private_key[NEXT_SESSION_PRIVATE_KEY_BYTES];
+    next_crypto_random_bytes( session_private_key, NEXT_SESSION_PRIVATE_KEY_BYTES );
+
+    uint8_t * p = response->tokens;
+
+    for ( int i = 0; i < num_tokens; ++i )
+    {
+        next_route_token_t token;
+        memset( &token, 0, sizeof(token) );
+        memcpy( token.private_key, session_private_key, NEXT_SESSION_PRIVATE_KEY_BYTES );
+        token.expire_timestamp = session->expire_timestamp;
+        token.session_id = request->session_id;
+        token.kbps_up = LocalRouteKbps;
+        token.kbps_down = LocalRouteKbps;
+        token.session_version = session->session_version;
+        if ( i > 0 )
+        {
+            token.prev_address = addresses[i-1].data.ip;
+            token.prev_port = addresses[i-1].port;
+        }
+        if ( i < num_tokens - 1 )
+        {
+            token.next_address = addresses[i+1].data.ip;
+            token.next_port = addresses[i+1].port;
+        }
+
+        const uint8_t * key = ( i == 0 ) ? client_key : ( ( i == num_tokens - 1 ) ? server_key : local_relay_token_key );
+
+        if ( next_write_encrypted_route_token( &p, &token, key ) != NEXT_OK )
+            return false;
+    }
+
+    response->num_tokens = num_tokens;
+
+    return true;
+}
+
+static bool local_backend_write_continue_tokens( const NextBackendSessionUpdateRequestPacket * request, local_backend_session_t * session, NextBackendSessionUpdateResponsePacket * response )
+{
+    const int num_tokens = local_config.num_relays + 2;
+
+    uint8_t client_key[NEXT_CRYPTO_KX_SESSIONKEYBYTES];
+    uint8_t server_key[NEXT_CRYPTO_KX_SESSIONKEYBYTES];
+    if ( !local_backend_session_keys( request, client_key, server_key ) )
+        return false;
+
+    uint8_t * p = response->tokens;
+
+    for ( int i = 0; i < num_tokens; ++i )
+    {
+        next_continue_token_t token;
+        memset( &token, 0, sizeof(token) );
+        token.expire_timestamp = session->expire_timestamp;
+        token.session_id = request->session_id;
+        token.session_version = session->session_version;
+
+        const uint8_t * key = ( i == 0 ) ? client_key : ( ( i == num_tokens - 1 ) ? server_key : local_relay_token_key );
+
+        if ( next_write_encrypted_continue_token( &p, &token, key ) != NEXT_OK )
+            return false;
+    }
+
+    response->num_tokens = num_tokens;
+
+    return true;
+}
+
+static void local_backend_process_session_update( next_platform_socket_t * socket, const next_address_t * from, const NextBackendSessionUpdateRequestPacket * request )
+{
+    local_session_updates++;
+
+    local_backend_session_t * session = local_backend_session( request->session_id );
+
+    NextBackendSessionUpdateResponsePacket response;
+    response.session_id = request->session_id;
+    response.slice_number = request->slice_number;
+    response.response_type = NEXT_UPDATE_TYPE_DIRECT;
+
+    const bool can_route = request->client_address.type == NEXT_ADDRESS_IPV4 && request->server_address.type == NEXT_ADDRESS_IPV4 && !request->fallback_to_direct;
+
+    if ( can_route )
+    {
+        session->expire_timestamp = local_timestamp() + LocalRouteSeconds;
+
+        if ( request->next && session->has_route )
+        {
+            if ( local_backend_write_continue_tokens( request, session, &response ) )
+            {
+                response.response_type = NEXT_UPDATE_TYPE_CONTINUE;
+            }
+        }
+        else
+        {
+            session->session_version++;
+            session->has_route = true;
+            if ( local_backend_write_route_tokens( request, session, &response ) )
+            {
+                response.response_type = NEXT_UPDATE_TYPE_ROUTE;
+                local_routes_issued++;
+            }
+        }
+    }
+    else
+    {
+        session->has_route = false;
+    }
+
+    if ( response.response_type == NEXT_UPDATE_TYPE_DIRECT )
+    {
+        response.num_tokens = 0;
+    }
+
+    next_printf( NEXT_LOG_LEVEL_DEBUG, "backend session update for session %" PRIx64 " slice %d -> %s", request->session_id, request->slice_number, response.response_type == NEXT_UPDATE_TYPE_ROUTE ? "route" : ( response.response_type == NEXT_UPDATE_TYPE_CONTINUE ? "continue" : "direct" ) );
+
+    local_backend_send_packet( socket, from, NEXT_BACKEND_SESSION_UPDATE_RESPONSE_PACKET, &response );
+}
+
+static void local_backend_process_packet( next_platform_socket_t * socket, const next_address_t * from, uint8_t * packet_data, int packet_bytes )
+{
+    if ( !next_basic_packet_filter( packet_data, packet_bytes ) )
+        return;
+
+    uint8_t magic[8];
+    memset( magic, 0, sizeof(magic) );
+
+    uint8_t from_address_data[4];
+    uint8_t to_address_data[4];
+
+    next_address_data( from, from_address_data );
+    next_address_data( &local_backend_address, to_address_data );
+
+    if ( !next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) )
+        return;
+
+    const uint8_t packet_id = packet_data[0];
+
+    // IMPORTANT: requests are signed with the buyer private key, but local doesn't know the buyer public key, so they are read unverified
+
+    switch ( packet_id )
+    {
+        case NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET:
+        {
+            NextBackendServerInitRequestPacket request;
+            if ( next_read_backend_packet( packet_id, packet_data, 18, packet_bytes, &request, NULL, NULL ) != packet_id )
+                return;
+
+            char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
+            next_printf( NEXT_LOG_LEVEL_INFO, "backend server init from %s (datacenter '%s')", next_address_to_string( from, address_buffer ), request.datacenter_name );
+
+            NextBackendServerInitResponsePacket response;
+            response.request_id = request.request_id;
+            response.response = NEXT_SERVER_INIT_RESPONSE_OK;
+            memcpy( response.upcoming_magic, local_magic, 8 );
+            memcpy( response.current_magic, local_magic, 8 );
+            memcpy( response.previous_magic, local_magic, 8 );
+
+            local_backend_send_packet( socket, from, NEXT_BACKEND_SERVER_INIT_RESPONSE_PACKET, &response );
+        }
+        break;
+
+        case NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET:
+        {
+            NextBackendServerUpdateRequestPacket request;
+            if ( next_read_backend_packet( packet_id, packet_data, 18, packet_bytes, &request, NULL, NULL ) != packet_id )
+                return;
+
+            NextBackendServerUpdateResponsePacket response;
+            response.request_id = request.request_id;
+            memcpy( response.upcoming_magic, local_magic, 8 );
+            memcpy( response.current_magic, local_magic, 8 );
+            memcpy( response.previous_magic, local_magic, 8 );
+
+            local_backend_send_packet( socket, from, NEXT_BACKEND_SERVER_UPDATE_RESPONSE_PACKET, &response );
+        }
+        break;
+
+        case NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET:
+        {
+            NextBackendServerRelayRequestPacket request;
+            if ( next_read_backend_packet( packet_id, packet_data, 18, packet_bytes, &request, NULL, NULL ) != packet_id )
+                return;
+
+            NextBackendServerRelayResponsePacket response;
+            response.request_id = request.request_id;
+            local_backend_relays( &response.num_server_relays, response.server_relay_ids, response.server_relay_addresses, &response.server_relay_ping_tokens[0][0], NEXT_MAX_SERVER_RELAYS );
+            response.expire_timestamp = local_timestamp() + LocalRouteSeconds;
+
+            local_backend_send_packet( socket, from, NEXT_BACKEND_SERVER_RELAY_RESPONSE_PACKET, &response );
+        }
+        break;
+
+        case NEXT_BACKEND_CLIENT_RELAY_REQUEST_PACKET:
+        {
+            NextBackendClientRelayRequestPacket request;
+            if ( next_read_backend_packet( packet_id, packet_data, 18, packet_bytes, &request, NULL, NULL ) != packet_id )
+                return;
+
+            NextBackendClientRelayResponsePacket response;
+            response.client_address = request.client_address;
+            response.request_id = request.request_id;
+            local_backend_relays( &response.num_client_relays, response.client_relay_ids, response.client_relay_addresses, &response.client_relay_ping_tokens[0][0], NEXT_MAX_CLIENT_RELAYS );
+            response.expire_timestamp = local_timestamp() + LocalRouteSeconds;
+
+            local_backend_send_packet( socket, from, NEXT_BACKEND_CLIENT_RELAY_RESPONSE_PACKET, &response );
+        }
+        break;
+
+        case NEXT_BACKEND_SESSION_UPDATE_REQUEST_PACKET:
+        {
+            NextBackendSessionUpdateRequestPacket request;
+            request.Reset();
+            if ( next_read_backend_packet( packet_id, packet_data, 18, packet_bytes, &request, NULL, NULL ) != packet_id )
+                return;
+
+            local_backend_process_session_update( socket, from, &request );
+        }
+        break;
+
+        default:
+            break;
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+
+static void local_relay_send( local_relay_t * relay, const next_address_t * to, uint8_t * packet_data, int packet_bytes )
+{
+    uint8_t to_address_data[4];
+    next_address_data( to, to_address_data );
+
+    // IMPORTANT: pittle and chonkle cover the from and to addresses, so they must be regenerated for every hop
+
+    next_generate_pittle( packet_data + 1, relay->address_data, to_address_data, uint16_t( packet_bytes ) );
+    next_generate_chonkle( packet_data + 3, local_magic, relay->address_data, to_address_data, uint16_t( packet_bytes ) );
+
+    next_platform_socket_send_packet( relay->socket, to, packet_data, packet_bytes );
+
+    relay->packets_forwarded++;
+}
+
+static void local_relay_process_route_request( local_relay_t * relay, const next_address_t * from, uint8_t * packet_data, int packet_bytes )
+{
+    if ( packet_bytes < 18 + NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES * 2 )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    uint8_t * p = packet_data + 18;
+    next_route_token_t token;
+    if ( next_read_encrypted_route_token( &p, &token, local_relay_token_key ) != NEXT_OK || token.expire_timestamp < local_timestamp() )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    local_relay_session_t * session = local_relay_find_session( relay, token.session_id, token.session_version );
+    if ( !session )
+    {
+        session = local_relay_add_session( relay, token.session_id, token.session_version );
+        memcpy( session->private_key, token.private_key, NEXT_SESSION_PRIVATE_KEY_BYTES );
+        session->prev_address = *from;
+        session->next_address.type = NEXT_ADDRESS_IPV4;
+        session->next_address.data.ip = token.next_address;
+        session->next_address.port = token.next_port;
+        relay->routes_created++;
+    }
+    session->expire_timestamp = token.expire_timestamp;
+
+    uint8_t forward_data[NEXT_MAX_PACKET_BYTES];
+    forward_data[0] = NEXT_ROUTE_REQUEST_PACKET;
+    const int forward_bytes = packet_bytes - NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES;
+    memcpy( forward_data + 18, packet_data + 18 + NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES, size_t(forward_bytes) - 18 );
+
+    local_relay_send( relay, &session->next_address, forward_data, forward_bytes );
+}
+
+static void local_relay_process_continue_request( local_relay_t * relay, uint8_t * packet_data, int packet_bytes )
+{
+    if ( packet_bytes < 18 + NEXT_ENCRYPTED_CONTINUE_TOKEN_BYTES * 2 )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    uint8_t * p = packet_data + 18;
+    next_continue_token_t token;
+    if ( next_read_encrypted_continue_token( &p, &token, local_relay_token_key ) != NEXT_OK || token.expire_timestamp < local_timestamp() )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    local_relay_session_t * session = local_relay_find_session( relay, token.session_id, token.session_version );
+    if ( !session )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+    session->expire_timestamp = token.expire_timestamp;
+
+    uint8_t forward_data[NEXT_MAX_PACKET_BYTES];
+    forward_data[0] = NEXT_CONTINUE_REQUEST_PACKET;
+    const int forward_bytes = packet_bytes - NEXT_ENCRYPTED_CONTINUE_TOKEN_BYTES;
+    memcpy( forward_data + 18, packet_data + 18 + NEXT_ENCRYPTED_CONTINUE_TOKEN_BYTES, size_t(forward_bytes) - 18 );
+
+    local_relay_send( relay, &session->next_address, forward_data, forward_bytes );
+}
+
+static void local_relay_process_session_packet( local_relay_t * relay, uint8_t packet_id, uint8_t * packet_data, int packet_bytes, bool forward )
+{
+    if ( packet_bytes < 18 + NEXT_HEADER_BYTES )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    uint64_t sequence;
+    uint64_t session_id;
+    uint8_t session_version;
+    next_peek_header( &sequence, &session_id, &session_version, packet_data + 18, packet_bytes - 18 );
+
+    local_relay_session_t * session = local_relay_find_session( relay, session_id, session_version );
+    if ( !session )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    if ( next_read_header( packet_id, &sequence, &session_id, &session_version, session->private_key, packet_data + 18, packet_bytes - 18 ) != NEXT_OK )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    local_relay_send( relay, forward ? &session->next_address : &session->prev_address, packet_data, packet_bytes );
+}
+
+static void local_relay_process_packet( local_relay_t * relay, const next_address_t * from, uint8_t * packet_data, int packet_bytes )
+{
+    if ( !next_basic_packet_filter( packet_data, packet_bytes ) )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    uint8_t from_address_data[4];
+    next_address_data( from, from_address_data );
+
+    if ( !next_advanced_packet_filter( packet_data, local_magic, from_address_data, relay->address_data, packet_bytes ) )
+    {
+        relay->packets_dropped++;
+        return;
+    }
+
+    const uint8_t packet_id = packet_data[0];
+
+    switch ( packet_id )
+    {
+        case NEXT_ROUTE_REQUEST_PACKET:
+            local_relay_process_route_request( relay, from, packet_data, packet_bytes );
+            break;
+
+        case NEXT_CONTINUE_REQUEST_PACKET:
+            local_relay_process_continue_request( relay, packet_data, packet_bytes );
+            break;
+
+        case NEXT_CLIENT_TO_SERVER_PACKET:
+        case NEXT_SESSION_PING_PACKET:
+            local_relay_process_session_packet( relay, packet_id, packet_data, packet_bytes, true );
+            break;
+
+        case NEXT_ROUTE_RESPONSE_PACKET:
+        case NEXT_CONTINUE_RESPONSE_PACKET:
+        case NEXT_SERVER_TO_CLIENT_PACKET:
+        case NEXT_SESSION_PONG_PACKET:
+            local_relay_process_session_packet( relay, packet_id, packet_data, packet_bytes, false );
+            break;
+
+        case NEXT_CLIENT_PING_PACKET:
+        {
+            if ( packet_bytes != 18 + 8 + 8 + 8 + NEXT_PING_TOKEN_BYTES )
+            {
+                relay->packets_dropped++;
+                return;
+            }
+            const uint8_t * p = packet_data + 18;
+            uint64_t ping_sequence = next_read_uint64( &p );
+            uint64_t session_id = next_read_uint64( &p );
+            uint8_t pong_data[NEXT_MAX_PACKET_BYTES];
+            const int pong_bytes = next_write_client_pong_packet( pong_data, ping_sequence, session_id, local_magic, relay->address_data, from_address_data );
+            next_platform_socket_send_packet( relay->socket, from, pong_data, pong_bytes );
+        }
+        break;
+
+        case NEXT_SERVER_PING_PACKET:
+        {
+            if ( packet_bytes != 18 + 8 + 8 + NEXT_PING_TOKEN_BYTES )
+            {
+                relay->packets_dropped++;
+                return;
+            }
+            const uint8_t * p = packet_data + 18;
+            uint64_t ping_sequence = next_read_uint64( &p );
+            uint8_t pong_data[NEXT_MAX_PACKET_BYTES];
+            const int pong_bytes = next_write_server_pong_packet( pong_data, ping_sequence, local_magic, relay->address_data, from_address_data );
+            next_platform_socket_send_packet( relay->socket, from, pong_data, pong_bytes );
+        }
+        break;
+
+        default:
+            relay->packets_dropped++;
+            break;
+    }
+}
+
+static void local_relay_thread_function( void * arg )
+{
+    local_relay_t * relay = (local_relay_t*) arg;
+
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+
+    while ( !quit )
+    {
+        next_address_t from;
+        const int packet_bytes = next_platform_socket_receive_packet( relay->socket, &from, packet_data, sizeof(packet_data) );
+        if ( packet_bytes <= 0 )
+            continue;
+
+        local_relay_process_packet( relay, &from, packet_data, packet_bytes );
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+
+static void local_usage()
+{
+    printf( "usage: local [--address ip] [--port N] [--relays N]\n" );
+}
+
+static bool local_parse_args( int argc, char ** argv )
+{
+    memset( &local_config, 0, sizeof(local_config) );
+    next_copy_string( local_config.address, "127.0.0.1", sizeof(local_config.address) );
+    local_config.port = atoi( NEXT_SERVER_BACKEND_PORT );
+    local_config.num_relays = 1;
+
+    for ( int i = 1; i + 1 < argc; i += 2 )
+    {
+        const char * arg = argv[i];
+        const char * value = argv[i+1];
+
+        if ( strcmp( arg, "--address" ) == 0 )
+            next_copy_string( local_config.address, value, sizeof(local_config.address) );
+        else if ( strcmp( arg, "--port" ) == 0 )
+            local_config.port = atoi( value );
+        else if ( strcmp( arg, "--relays" ) == 0 )
+            local_config.num_relays = atoi( value );
+        else
+            return false;
+    }
+
+    if ( argc % 2 == 0 )
+        return false;
+
+    if ( local_config.num_relays < 1 || local_config.num_relays > LOCAL_MAX_RELAYS )
+        return false;
+
+    if ( local_config.port <= 0 || local_config.port + local_config.num_relays > 65535 )
+        return false;
+
+    return true;
+}
+
+int main( int argc, char ** argv )
+{
+    if ( !local_parse_args( argc, argv ) )
+    {
+        local_usage();
+        return 1;
+    }
+
+    signal( SIGINT, interrupt_handler ); signal( SIGTERM, interrupt_handler );
+
+    if ( next_init( NULL, NULL ) != NEXT_OK )
+    {
+        printf( "error: could not initialize network next\n" );
+        return 1;
+    }
+
+    next_base64_decode_data( local_server_backend_public_key, local_backend_public_key, sizeof(local_backend_public_key) );
+    next_base64_decode_data( local_server_backend_private_key, local_backend_private_key, sizeof(local_backend_private_key) );
+    next_base64_decode_data( local_relay_backend_public_key, local_relay_public_key, sizeof(local_relay_public_key) );
+    next_base64_decode_data( local_relay_backend_private_key, local_relay_private_key, sizeof(local_relay_private_key) );
+
+    next_crypto_random_bytes( local_magic, sizeof(local_magic) );
+    next_crypto_random_bytes( local_relay_token_key, sizeof(local_relay_token_key) );
+
+    char address_string[NEXT_MAX_ADDRESS_STRING_LENGTH + 16];
+    snprintf( address_string, sizeof(address_string), "%s:%d", local_config.address, local_config.port );
+
+    if ( next_address_parse( &local_backend_address, address_string ) != NEXT_OK || local_backend_address.type != NEXT_ADDRESS_IPV4 )
+    {
+        printf( "error: local needs an ipv4 address, got '%s'\n", local_config.address );
+        next_term();
+        return 1;
+    }
+
+    local_backend_sessions = (local_backend_session_t*) calloc( LocalMaxSessions, sizeof(local_backend_session_t) );
+
+    next_platform_socket_t * backend_socket = next_platform_socket_create( NULL, &local_backend_address, NEXT_PLATFORM_SOCKET_BLOCKING, 0.1f, 4*1024*1024, 4*1024*1024 );
+    if ( !backend_socket )
+    {
+        printf( "error: could not create backend socket on %s\n", address_string );
+        next_term();
+        return 1;
+    }
+
+    bool relays_ok = true;
+
+    for ( int i = 0; i < local_config.num_relays; ++i )
+    {
+        local_relay_t * relay = &local_relays[i];
+        relay->index = i;
+        relay->relay_id = 0x10CA1000ULL + i;
+        relay->address = local_backend_address;
+        relay->address.port = uint16_t( local_config.port + 1 + i );
+        next_address_data( &relay->address, relay->address_data );
+        relay->sessions = (local_relay_session_t*) calloc( LocalMaxSessions, sizeof(local_relay_session_t) );
+        relay->socket = next_platform_socket_create( NULL, &relay->address, NEXT_PLATFORM_SOCKET_BLOCKING, 0.1f, 4*1024*1024, 4*1024*1024 );
+        if ( !relay->socket )
+        {
+            char buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
+            printf( "error: could not create relay socket on %s\n", next_address_to_string( &relay->address, buffer ) );
+            relays_ok = false;
+            break;
+        }
+        relay->thread = next_platform_thread_create( NULL, local_relay_thread_function, relay );
+        next_assert( relay->thread );
+    }
+
+    if ( relays_ok )
+    {
+        char buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
+        printf( "local backend on %s with %d relays on ports %d-%d\n\n", next_address_to_string( &local_backend_address, buffer ), local_config.num_relays, local_config.port + 1, local_config.port + local_config.num_relays );
+        printf( "export NEXT_SERVER_BACKEND_PUBLIC_KEY=%s\n", local_server_backend_public_key );
+        printf( "export NEXT_RELAY_BACKEND_PUBLIC_KEY=%s\n\n", local_relay_backend_public_key );
+        fflush( stdout );
+
+        uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+
+        double last_print_time = next_platform_time();
+
+        while ( !quit )
+        {
+            next_address_t from;
+            const int packet_bytes = next_platform_socket_receive_packet( backend_socket, &from, packet_data, sizeof(packet_data) );
+            if ( packet_bytes > 0 )
+            {
+                local_backend_process_packet( backend_socket, &from, packet_data, packet_bytes );
+            }
+
+            const double current_time = next_platform_time();
+            if ( current_time - last_print_time >= NEXT_SLICE_SECONDS )
+            {
+                last_print_time = current_time;
+
+                // IMPORTANT: relay counters are read without synchronization. They are only for display
+
+                uint64_t routes_created = 0;
+                uint64_t packets_forwarded = 0;
+                uint64_t packets_dropped = 0;
+                for ( int i = 0; i < local_config.num_relays; ++i )
+                {
+                    routes_created += local_relays[i].routes_created;
+                    packets_forwarded += local_relays[i].packets_forwarded;
+                    packets_dropped += local_relays[i].packets_dropped;
+                }
+
+                next_printf( NEXT_LOG_LEVEL_INFO, "%" PRIu64 " session updates, %" PRIu64 " routes issued, %" PRIu64 " relay routes, %" PRIu64 " packets forwarded, %" PRIu64 " dropped", local_session_updates, local_routes_issued, routes_created, packets_forwarded, packets_dropped );
+            }
+        }
+    }
+
+    quit = 1;
+
+    for ( int i = 0; i < local_config.num_relays; ++i )
+    {
+        local_relay_t * relay = &local_relays[i];
+        if ( relay->thread )
+        {
+            next_platform_thread_join( relay->thread );
+            next_platform_thread_destroy( relay->thread );
+        }
+        if ( relay->socket )
+        {
+            next_platform_socket_destroy( relay->socket );
+        }
+        free( relay->sessions );
+    }
+
+    next_platform_socket_destroy( backend_socket );
+
+    free( local_backend_sessions );
+
+    next_term();
+
+    return relays_ok ? 0 : 1;
+}
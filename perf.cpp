@@ -0,0 +1,767 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "next.h"
+#include "next_platform.h"
+#include "next_address.h"
+#include "next_read_write.h"
+#include "next_client.h"
+#include "next_latency_histogram.h"
+#include "next_impairment.h"
+
+#include <stdio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX || NEXT_PLATFORM == NEXT_PLATFORM_MAC
+#include <time.h>
+#include <sys/resource.h>
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX || NEXT_PLATFORM == NEXT_PLATFORM_MAC
+
+// IMPORTANT: perf is an end-to-end benchmark on loopback. One server and many clients run in this process and exchange
+// timestamped payloads that the server echoes back. It reports payload round trip time percentiles, process CPU off the
+// game thread per 1k packets, game thread time spent in next_server_update and next_server_send_packet, and the highest packet rate
+// the server sustains before the notify queue overflows. Run with --json to get a single JSON document for release gates.
+// Pass --impair "latency=50,jitter=10,loss=1" to impair every packet sent during the latency phase, and --seed to vary it.
+
+#define PERF_MODE_DIRECT                0
+#define PERF_MODE_UPGRADED              1
+#define PERF_MODE_NEXT                  2
+
+const int MaxClients = 1000;
+
+const uint32_t PerfPayloadMagic = 0x50455246;
+const int PerfPayloadHeaderBytes = 4 + 8 + 8;
+const double PerfWarmupTimeout = 30.0;
+const double PerfRampStepSeconds = 1.0;
+const int PerfRampMaxSteps = 16;
+
+const char * buyer_public_key = "5Vr+VZdUXckPZsd89NGTmXASmmlHRuWiyVs7orAxRV6hDkvTc3VMtCBDAd09F+1z/whRYMvtl+28E7MT/5mmn48iNJTQrGbC";
+const char * buyer_private_key = "5Vr+VZdUXckPZsd89NGTmXASmmlHRuWiyVs7orAxRV6hDkvTc3VMtCBDAd09F+1z/whRYMvtl+28E7MT/5mmn48iNJTQrGbC";
+
+struct perf_config_t
+{
+    int mode;
+    int num_clients;
+    double seconds;
+    double packets_per_second;
+    int payload_bytes;
+    int tick_rate;
+    int server_port;
+    bool ramp;
+    bool json;
+    char backend_hostname[256];
+    char impair[256];
+    uint64_t impair_seed;
+};
+
+struct perf_client_t
+{
+    next_client_t * client;
+    uint64_t sequence;
+    uint64_t measure_sequence;
+    uint64_t payloads_sent;
+    uint64_t payloads_received;
+    double send_accumulator;
+    next_latency_histogram_t rtt;
+};
+
+struct perf_cpu_t
+{
+    double process_seconds;
+    double game_thread_seconds;
+};
+
+static perf_config_t perf_config;
+
+static next_server_t * perf_server;
+
+static perf_client_t perf_clients[MaxClients];
+
+static uint64_t perf_server_payloads_received;
+
+static double perf_last_tick_time;
+
+static volatile int quit = 0;
+
+void interrupt_handler( int signal )
+{
+    (void) signal; quit = 1;
+}
+
+static const char * perf_mode_string( int mode )
+{
+    switch ( mode )
+    {
+        case PERF_MODE_DIRECT:      return "direct";
+        case PERF_MODE_UPGRADED:    return "upgraded";
+        case PERF_MODE_NEXT:        return "next";
+        default:                    return "unknown";
+    }
+}
+
+static void perf_cpu( perf_cpu_t * cpu )
+{
+    memset( cpu, 0, sizeof(perf_cpu_t) );
+
+    // IMPORTANT: process CPU minus game thread CPU covers every other thread in the process: the server and client internal threads,
+    // the crypto worker and the async log thread. It is not the server internal thread on its own, and is reported per 1k packets across all of them
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX || NEXT_PLATFORM == NEXT_PLATFORM_MAC
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) == 0 )
+    {
+        cpu->process_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+    }
+    struct timespec ts;
+    if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 )
+    {
+        cpu->game_thread_seconds = ts.tv_sec + ts.tv_nsec / 1000000000.0;
+    }
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX || NEXT_PLATFORM == NEXT_PLATFORM_MAC
+}
+
+static bool perf_cpu_supported()
+{
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX || NEXT_PLATFORM == NEXT_PLATFORM_MAC
+    return true;
+#else // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX || NEXT_PLATFORM == NEXT_PLATFORM_MAC
+    return false;
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX || NEXT_PLATFORM == NEXT_PLATFORM_MAC
+}
+
+static uint64_t perf_packets_processed()
+{
+    // IMPORTANT: total packets sent and received by the server and all clients
+
+    uint64_t packets = 0;
+
+    uint64_t server_counters[NEXT_SERVER_COUNTER_NUM_COUNTERS];
+    next_server_counters( perf_server, server_counters );
+    packets += server_counters[NEXT_SERVER_COUNTER_PACKETS_RECEIVED];
+    packets += server_counters[NEXT_SERVER_COUNTER_PACKETS_SENT];
+
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        uint64_t client_counters[NEXT_CLIENT_COUNTER_MAX];
+        next_client_counters( perf_clients[i].client, client_counters );
+        for ( int j = NEXT_CLIENT_COUNTER_PACKET_SENT_PASSTHROUGH; j <= NEXT_CLIENT_COUNTER_PACKET_RECEIVED_NEXT; ++j )
+        {
+            packets += client_counters[j];
+        }
+    }
+
+    return packets;
+}
+
+static uint64_t perf_server_counter( int index )
+{
+    uint64_t server_counters[NEXT_SERVER_COUNTER_NUM_COUNTERS];
+    next_server_counters( perf_server, server_counters );
+    return server_counters[index];
+}
+
+static uint64_t perf_payloads_sent()
+{
+    uint64_t payloads_sent = 0;
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        payloads_sent += perf_clients[i].payloads_sent;
+    }
+    return payloads_sent;
+}
+
+static uint64_t perf_payloads_received()
+{
+    uint64_t payloads_received = 0;
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        payloads_received += perf_clients[i].payloads_received;
+    }
+    return payloads_received;
+}
+
+void client_packet_received( next_client_t * client, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes )
+{
+    (void) client; (void) from;
+
+    next_assert( context );
+
+    perf_client_t * perf_client = (perf_client_t*) context;
+
+    if ( packet_bytes < PerfPayloadHeaderBytes )
+        return;
+
+    const uint8_t * p = packet_data;
+    if ( next_read_uint32( &p ) != PerfPayloadMagic )
+        return;
+
+    // IMPORTANT: warmup echoes can still be in flight when the measurement window starts. They were never counted as sent, so ignore them
+
+    const uint64_t sequence = next_read_uint64( &p );
+    if ( sequence < perf_client->measure_sequence )
+        return;
+
+    const double send_time = next_read_float64( &p );
+
+    next_latency_histogram_record( &perf_client->rtt, next_platform_time() - send_time );
+
+    perf_client->payloads_received++;
+}
+
+void server_packet_received( next_server_t * server, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes )
+{
+    (void) context;
+
+    perf_server_payloads_received++;
+
+    next_server_send_packet( server, from, packet_data, packet_bytes );
+
+    if ( perf_config.mode != PERF_MODE_DIRECT && !next_server_session_upgraded( server, from ) )
+    {
+        next_server_upgrade_session( server, from, NULL );
+    }
+}
+
+static void perf_send_payload( perf_client_t * perf_client )
+{
+    uint8_t packet_data[NEXT_MTU];
+    memset( packet_data, 0, perf_config.payload_bytes );
+
+    uint8_t * p = packet_data;
+    next_write_uint32( &p, PerfPayloadMagic );
+    next_write_uint64( &p, perf_client->sequence++ );
+    next_write_float64( &p, next_platform_time() );
+
+    next_client_send_packet( perf_client->client, packet_data, perf_config.payload_bytes );
+
+    perf_client->payloads_sent++;
+}
+
+static void perf_tick( double packets_per_second )
+{
+    const double tick_start = next_platform_time();
+
+    // IMPORTANT: sends are paced by elapsed time, not tick count, so sleep overshoot does not lower the send rate
+
+    double delta_time = perf_last_tick_time > 0.0 ? tick_start - perf_last_tick_time : 0.0;
+    if ( delta_time > 0.1 )
+    {
+        delta_time = 0.1;
+    }
+    perf_last_tick_time = tick_start;
+
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        perf_client_t * perf_client = &perf_clients[i];
+
+        perf_client->send_accumulator += packets_per_second * delta_time;
+
+        next_client_send_packets_begin( perf_client->client );
+
+        while ( perf_client->send_accumulator >= 1.0 )
+        {
+            perf_send_payload( perf_client );
+            perf_client->send_accumulator -= 1.0;
+        }
+
+        next_client_send_packets_end( perf_client->client );
+
+        next_client_update( perf_client->client );
+    }
+
+    // IMPORTANT: payloads are echoed back from the server packet received callback, so those sends are batched here too
+
+    next_server_send_packets_begin( perf_server );
+
+    next_server_update( perf_server );
+
+    next_server_send_packets_end( perf_server );
+
+    const double tick_time = next_platform_time() - tick_start;
+    const double tick_delta = 1.0 / perf_config.tick_rate;
+    if ( tick_time < tick_delta )
+    {
+        next_platform_sleep( tick_delta - tick_time );
+    }
+}
+
+static bool perf_warmed_up()
+{
+    if ( !next_server_ready( perf_server ) )
+        return false;
+
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        const perf_client_t * perf_client = &perf_clients[i];
+
+        if ( perf_client->payloads_received == 0 )
+            return false;
+
+        const next_client_stats_t * stats = next_client_stats( perf_client->client );
+
+        if ( perf_config.mode >= PERF_MODE_UPGRADED && !stats->upgraded )
+            return false;
+
+        if ( perf_config.mode == PERF_MODE_NEXT && !stats->next )
+            return false;
+    }
+
+    return true;
+}
+
+static int perf_clients_on_next()
+{
+    int clients_on_next = 0;
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        if ( next_client_stats( perf_clients[i].client )->next )
+        {
+            clients_on_next++;
+        }
+    }
+    return clients_on_next;
+}
+
+static void perf_rtt( next_latency_t * rtt )
+{
+    const next_latency_histogram_t * histograms[MaxClients];
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        histograms[i] = &perf_clients[i].rtt;
+    }
+    next_latency_histogram_summary( histograms, perf_config.num_clients, rtt );
+}
+
+static void perf_print_latency( const char * name, const next_latency_t * latency, bool last )
+{
+    if ( perf_config.json )
+    {
+        printf( "    \"%s\": { \"count\": %" PRIu64 ", \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"p999\": %.4f, \"max\": %.4f }%s\n",
+            name, latency->count, latency->min, latency->mean, latency->p50, latency->p90, latency->p99, latency->p999, latency->max, last ? "" : "," );
+    }
+    else
+    {
+        printf( "%-24s count %10" PRIu64 "  p50 %8.3f  p90 %8.3f  p99 %8.3f  p999 %8.3f  max %8.3f (ms)\n",
+            name, latency->count, latency->p50, latency->p90, latency->p99, latency->p999, latency->max );
+    }
+}
+
+static void perf_usage()
+{
+    printf( "usage: perf [--mode direct|upgraded|next] [--clients N] [--seconds S] [--pps N] [--payload-bytes N] [--tick-rate N] [--port N] [--backend hostname] [--impair spec] [--seed N] [--no-ramp] [--json]\n" );
+}
+
+static bool perf_parse_args( int argc, char ** argv )
+{
+    memset( &perf_config, 0, sizeof(perf_config) );
+    perf_config.mode = PERF_MODE_DIRECT;
+    perf_config.num_clients = 10;
+    perf_config.seconds = 10.0;
+    perf_config.packets_per_second = 60.0;
+    perf_config.payload_bytes = 100;
+    perf_config.tick_rate = 1000;
+    perf_config.server_port = 50000;
+    perf_config.ramp = true;
+    next_copy_string( perf_config.backend_hostname, "127.0.0.1", sizeof(perf_config.backend_hostname) );
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        const char * arg = argv[i];
+        const char * value = ( i + 1 < argc ) ? argv[i+1] : NULL;
+
+        if ( strcmp( arg, "--json" ) == 0 )
+        {
+            perf_config.json = true;
+        }
+        else if ( strcmp( arg, "--no-ramp" ) == 0 )
+        {
+            perf_config.ramp = false;
+        }
+        else if ( value == NULL )
+        {
+            return false;
+        }
+        else
+        {
+            if ( strcmp( arg, "--mode" ) == 0 )
+            {
+                if ( strcmp( value, "direct" ) == 0 )
+                    perf_config.mode = PERF_MODE_DIRECT;
+                else if ( strcmp( value, "upgraded" ) == 0 )
+                    perf_config.mode = PERF_MODE_UPGRADED;
+                else if ( strcmp( value, "next" ) == 0 )
+                    perf_config.mode = PERF_MODE_NEXT;
+                else
+                    return false;
+            }
+            else if ( strcmp( arg, "--clients" ) == 0 )
+                perf_config.num_clients = atoi( value );
+            else if ( strcmp( arg, "--seconds" ) == 0 )
+                perf_config.seconds = atof( value );
+            else if ( strcmp( arg, "--pps" ) == 0 )
+                perf_config.packets_per_second = atof( value );
+            else if ( strcmp( arg, "--payload-bytes" ) == 0 )
+                perf_config.payload_bytes = atoi( value );
+            else if ( strcmp( arg, "--tick-rate" ) == 0 )
+                perf_config.tick_rate = atoi( value );
+            else if ( strcmp( arg, "--port" ) == 0 )
+                perf_config.server_port = atoi( value );
+            else if ( strcmp( arg, "--backend" ) == 0 )
+                next_copy_string( perf_config.backend_hostname, value, sizeof(perf_config.backend_hostname) );
+            else if ( strcmp( arg, "--impair" ) == 0 )
+                next_copy_string( perf_config.impair, value, sizeof(perf_config.impair) );
+            else if ( strcmp( arg, "--seed" ) == 0 )
+                perf_config.impair_seed = strtoull( value, NULL, 10 );
+            else
+                return false;
+            i++;
+        }
+    }
+
+    if ( perf_config.num_clients < 1 || perf_config.num_clients > MaxClients )
+        return false;
+
+    if ( perf_config.payload_bytes < PerfPayloadHeaderBytes || perf_config.payload_bytes > NEXT_MTU )
+        return false;
+
+    if ( perf_config.seconds <= 0.0 || perf_config.packets_per_second <= 0.0 || perf_config.tick_rate <= 0 )
+        return false;
+
+#if NEXT_DEVELOPMENT
+    next_impairment_config_t impairment_config;
+    if ( perf_config.impair[0] != '\0' && next_impairment_parse( perf_config.impair, &impairment_config ) != NEXT_OK )
+        return false;
+#else // #if NEXT_DEVELOPMENT
+    if ( perf_config.impair[0] != '\0' )
+        return false;
+#endif // #if NEXT_DEVELOPMENT
+
+    return true;
+}
+
+int main( int argc, char ** argv )
+{
+    if ( !perf_parse_args( argc, argv ) )
+    {
+        perf_usage();
+        return 1;
+    }
+
+    signal( SIGINT, interrupt_handler ); signal( SIGTERM, interrupt_handler );
+
+    next_quiet( perf_config.json );
+
+    next_config_t config;
+    next_default_config( &config );
+    config.max_sessions = perf_config.num_clients;
+    if ( perf_config.mode != PERF_MODE_DIRECT )
+    {
+        next_copy_string( config.server_backend_hostname, perf_config.backend_hostname, sizeof(config.server_backend_hostname) );
+        next_copy_string( config.buyer_public_key, buyer_public_key, sizeof(config.buyer_public_key) );
+        next_copy_string( config.buyer_private_key, buyer_private_key, sizeof(config.buyer_private_key) );
+    }
+
+    if ( next_init( NULL, &config ) != NEXT_OK )
+    {
+        printf( "error: could not initialize network next\n" );
+        return 1;
+    }
+
+    char server_address[256];
+    char bind_address[256];
+    snprintf( server_address, sizeof(server_address), "127.0.0.1:%d", perf_config.server_port );
+    snprintf( bind_address, sizeof(bind_address), "0.0.0.0:%d", perf_config.server_port );
+
+    perf_server = next_server_create( NULL, server_address, bind_address, "local", server_packet_received );
+    if ( !perf_server )
+    {
+        printf( "error: could not create server\n" );
+        next_term();
+        return 1;
+    }
+
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        perf_client_t * perf_client = &perf_clients[i];
+        next_latency_histogram_reset( &perf_client->rtt );
+        perf_client->client = next_client_create( perf_client, "0.0.0.0:0", client_packet_received );
+        if ( !perf_client->client )
+        {
+            printf( "error: could not create client %d\n", i );
+            exit( 1 );
+        }
+        next_client_open_session( perf_client->client, server_address );
+    }
+
+    // warm up until every session is in the requested mode
+
+    const double warmup_start = next_platform_time();
+    while ( !quit && !perf_warmed_up() )
+    {
+        if ( next_platform_time() - warmup_start > PerfWarmupTimeout )
+        {
+            printf( "error: sessions did not reach %s mode within %.0f seconds", perf_mode_string( perf_config.mode ), PerfWarmupTimeout );
+            if ( perf_config.mode != PERF_MODE_DIRECT )
+            {
+                printf( ". is a backend running at %s? run ./local and export the keys it prints for an offline backend and relays", perf_config.backend_hostname );
+            }
+            printf( "\n" );
+            exit( 1 );
+        }
+        perf_tick( 10.0 );
+    }
+
+    const double warmup_time = next_platform_time() - warmup_start;
+
+    // latency phase: all clients send at the configured rate
+
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        next_latency_histogram_reset( &perf_clients[i].rtt );
+        perf_clients[i].measure_sequence = perf_clients[i].sequence;
+        perf_clients[i].payloads_sent = 0;
+        perf_clients[i].payloads_received = 0;
+    }
+
+    // IMPORTANT: impairment only covers the latency phase. Warmup stays clean so sessions reach the requested mode, and the ramp measures capacity
+
+    double drain_seconds = 0.25;
+
+#if NEXT_DEVELOPMENT
+    if ( perf_config.impair[0] != '\0' )
+    {
+        next_impairment_config_t impairment_config;
+        next_impairment_parse( perf_config.impair, &impairment_config );
+        next_impairment_seed( perf_config.impair_seed );
+        if ( next_impairment_set( NULL, &impairment_config ) != NEXT_OK )
+        {
+            printf( "error: could not set impairment\n" );
+            exit( 1 );
+        }
+        drain_seconds += ( impairment_config.latency_ms + impairment_config.jitter_ms + impairment_config.reorder_ms ) / 1000.0;
+    }
+#endif // #if NEXT_DEVELOPMENT
+
+    perf_cpu_t cpu_start;
+    perf_cpu( &cpu_start );
+    const uint64_t packets_start = perf_packets_processed();
+
+    const double latency_start = next_platform_time();
+    while ( !quit && next_platform_time() - latency_start < perf_config.seconds )
+    {
+        perf_tick( perf_config.packets_per_second );
+    }
+
+    // IMPORTANT: let payloads still in flight arrive before counting loss
+
+    const double drain_start = next_platform_time();
+    while ( !quit && next_platform_time() - drain_start < drain_seconds )
+    {
+        perf_tick( 0.0 );
+    }
+
+    perf_cpu_t cpu_end;
+    perf_cpu( &cpu_end );
+    const uint64_t packets_processed = perf_packets_processed() - packets_start;
+
+    next_latency_t rtt;
+    perf_rtt( &rtt );
+
+    const uint64_t payloads_sent = perf_payloads_sent();
+    const uint64_t payloads_received = perf_payloads_received();
+    const double payload_loss = payloads_sent > 0 ? 100.0 * ( 1.0 - double( payloads_received ) / double( payloads_sent ) ) : 0.0;
+
+    const double non_game_thread_cpu_seconds = ( cpu_end.process_seconds - cpu_start.process_seconds ) - ( cpu_end.game_thread_seconds - cpu_start.game_thread_seconds );
+    const double non_game_thread_cpu_ms_per_1k_packets = ( perf_cpu_supported() && packets_processed > 0 ) ? non_game_thread_cpu_seconds * 1000.0 / ( packets_processed / 1000.0 ) : -1.0;
+    const double game_thread_cpu_ms_per_1k_packets = ( perf_cpu_supported() && packets_processed > 0 ) ? ( cpu_end.game_thread_seconds - cpu_start.game_thread_seconds ) * 1000.0 / ( packets_processed / 1000.0 ) : -1.0;
+
+    const int clients_on_next = perf_clients_on_next();
+
+#if NEXT_DEVELOPMENT
+    next_impairment_stats_t impairment_stats;
+    next_impairment_stats( &impairment_stats );
+    next_impairment_clear();
+#endif // #if NEXT_DEVELOPMENT
+
+    // ramp phase: double the send rate every step until the server notify queue overflows or payloads are lost
+
+    double max_packets_per_second = 0.0;
+    double ramp_packets_per_second = 0.0;
+    double ramp_non_game_thread_cpu_ms_per_1k_packets = -1.0;
+    const char * ramp_limit = "none";
+
+    if ( perf_config.ramp )
+    {
+        double packets_per_second = perf_config.packets_per_second;
+
+        for ( int step = 0; step < PerfRampMaxSteps && !quit; ++step )
+        {
+            const uint64_t overflow_start = perf_server_counter( NEXT_SERVER_COUNTER_NOTIFY_QUEUE_OVERFLOW );
+            const uint64_t server_received_start = perf_server_payloads_received;
+            const uint64_t sent_start = perf_payloads_sent();
+            const uint64_t step_packets_start = perf_packets_processed();
+            perf_cpu_t step_cpu_start;
+            perf_cpu( &step_cpu_start );
+
+            const double step_start = next_platform_time();
+            while ( !quit && next_platform_time() - step_start < PerfRampStepSeconds )
+            {
+                perf_tick( packets_per_second );
+            }
+            const double step_time = next_platform_time() - step_start;
+
+            const double step_drain_start = next_platform_time();
+            while ( !quit && next_platform_time() - step_drain_start < 0.1 )
+            {
+                perf_tick( 0.0 );
+            }
+
+            perf_cpu_t step_cpu_end;
+            perf_cpu( &step_cpu_end );
+            const uint64_t step_packets = perf_packets_processed() - step_packets_start;
+
+            const uint64_t overflow = perf_server_counter( NEXT_SERVER_COUNTER_NOTIFY_QUEUE_OVERFLOW ) - overflow_start;
+            const uint64_t server_received = perf_server_payloads_received - server_received_start;
+            const uint64_t sent = perf_payloads_sent() - sent_start;
+
+            if ( overflow > 0 )
+            {
+                ramp_limit = "notify_overflow";
+                break;
+            }
+
+            if ( server_received < sent * 99 / 100 )
+            {
+                ramp_limit = "packet_loss";
+                break;
+            }
+
+            if ( sent < uint64_t( packets_per_second * perf_config.num_clients * step_time * 0.9 ) )
+            {
+                ramp_limit = "game_thread";
+                break;
+            }
+
+            max_packets_per_second = server_received / step_time;
+            ramp_packets_per_second = packets_per_second;
+
+            if ( perf_cpu_supported() && step_packets > 0 )
+            {
+                const double step_non_game_thread_cpu_seconds = ( step_cpu_end.process_seconds - step_cpu_start.process_seconds ) - ( step_cpu_end.game_thread_seconds - step_cpu_start.game_thread_seconds );
+                ramp_non_game_thread_cpu_ms_per_1k_packets = step_non_game_thread_cpu_seconds * 1000.0 / ( step_packets / 1000.0 );
+            }
+
+            packets_per_second *= 2.0;
+        }
+    }
+
+    next_server_metrics_t server_metrics;
+    next_server_metrics( perf_server, &server_metrics );
+
+    // report
+
+    if ( perf_config.json )
+    {
+        printf( "{\n" );
+        printf( "    \"version\": \"%s\",\n", NEXT_VERSION_FULL );
+        printf( "    \"mode\": \"%s\",\n", perf_mode_string( perf_config.mode ) );
+        printf( "    \"clients\": %d,\n", perf_config.num_clients );
+        printf( "    \"clients_on_next\": %d,\n", clients_on_next );
+        printf( "    \"payload_bytes\": %d,\n", perf_config.payload_bytes );
+        printf( "    \"packets_per_second_per_client\": %.1f,\n", perf_config.packets_per_second );
+        printf( "    \"tick_rate\": %d,\n", perf_config.tick_rate );
+        printf( "    \"seconds\": %.1f,\n", perf_config.seconds );
+        printf( "    \"warmup_seconds\": %.3f,\n", warmup_time );
+        printf( "    \"payloads_sent\": %" PRIu64 ",\n", payloads_sent );
+        printf( "    \"payloads_received\": %" PRIu64 ",\n", payloads_received );
+        printf( "    \"payload_loss_percent\": %.3f,\n", payload_loss );
+        printf( "    \"packets_processed\": %" PRIu64 ",\n", packets_processed );
+        printf( "    \"non_game_thread_cpu_ms_per_1k_packets\": %.4f,\n", non_game_thread_cpu_ms_per_1k_packets );
+        printf( "    \"game_thread_cpu_ms_per_1k_packets\": %.4f,\n", game_thread_cpu_ms_per_1k_packets );
+        printf( "    \"max_packets_per_second\": %.1f,\n", max_packets_per_second );
+        printf( "    \"max_packets_per_second_per_client\": %.1f,\n", ramp_packets_per_second );
+        printf( "    \"max_packets_per_second_non_game_thread_cpu_ms_per_1k_packets\": %.4f,\n", ramp_non_game_thread_cpu_ms_per_1k_packets );
+        printf( "    \"ramp_limit\": \"%s\",\n", ramp_limit );
+#if NEXT_DEVELOPMENT
+        if ( perf_config.impair[0] != '\0' )
+        {
+            printf( "    \"impairment\": { \"spec\": \"%s\", \"seed\": %" PRIu64 ", \"sent\": %" PRIu64 ", \"dropped\": %" PRIu64 ", \"delayed\": %" PRIu64 ", \"reordered\": %" PRIu64 ", \"duplicated\": %" PRIu64 ", \"overflowed\": %" PRIu64 ", \"max_in_flight\": %d },\n",
+                perf_config.impair, perf_config.impair_seed, impairment_stats.packets_sent, impairment_stats.packets_dropped, impairment_stats.packets_delayed,
+                impairment_stats.packets_reordered, impairment_stats.packets_duplicated, impairment_stats.packets_overflowed, impairment_stats.max_packets_in_flight );
+        }
+#endif // #if NEXT_DEVELOPMENT
+        perf_print_latency( "rtt_ms", &rtt, false );
+        perf_print_latency( "server_update_ms", &server_metrics.latency[NEXT_SERVER_METRIC_UPDATE], false );
+        perf_print_latency( "server_send_packet_ms", &server_metrics.latency[NEXT_SERVER_METRIC_SEND_PACKET], false );
+        perf_print_latency( "server_receive_to_notify_ms", &server_metrics.latency[NEXT_SERVER_METRIC_RECEIVE_TO_NOTIFY], true );
+        printf( "}\n" );
+    }
+    else
+    {
+        printf( "\n" );
+        printf( "mode                     %s (%d/%d clients on next)\n", perf_mode_string( perf_config.mode ), clients_on_next, perf_config.num_clients );
+        printf( "clients                  %d x %.1f packets/sec x %d bytes for %.1f seconds at %d ticks/sec\n", perf_config.num_clients, perf_config.packets_per_second, perf_config.payload_bytes, perf_config.seconds, perf_config.tick_rate );
+        printf( "payloads                 %" PRIu64 " sent, %" PRIu64 " received (%.3f%% loss)\n", payloads_sent, payloads_received, payload_loss );
+        printf( "non-game-thread process cpu %.4f ms per 1k packets (%" PRIu64 " packets)\n", non_game_thread_cpu_ms_per_1k_packets, packets_processed );
+        printf( "game thread cpu          %.4f ms per 1k packets\n", game_thread_cpu_ms_per_1k_packets );
+        if ( perf_config.ramp )
+        {
+            printf( "max packets/sec          %.1f (%.1f per client, limited by %s)\n", max_packets_per_second, ramp_packets_per_second, ramp_limit );
+            printf( "non-game-thread cpu at max %.4f ms per 1k packets\n", ramp_non_game_thread_cpu_ms_per_1k_packets );
+        }
+#if NEXT_DEVELOPMENT
+        if ( perf_config.impair[0] != '\0' )
+        {
+            printf( "impairment               %s (seed %" PRIu64 ")\n", perf_config.impair, perf_config.impair_seed );
+            printf( "impaired packets         %" PRIu64 " sent, %" PRIu64 " dropped, %" PRIu64 " delayed, %" PRIu64 " reordered, %" PRIu64 " duplicated, %" PRIu64 " overflowed, %d max in flight\n",
+                impairment_stats.packets_sent, impairment_stats.packets_dropped, impairment_stats.packets_delayed, impairment_stats.packets_reordered,
+                impairment_stats.packets_duplicated, impairment_stats.packets_overflowed, impairment_stats.max_packets_in_flight );
+        }
+#endif // #if NEXT_DEVELOPMENT
+        perf_print_latency( "rtt", &rtt, false );
+        perf_print_latency( "next_server_update", &server_metrics.latency[NEXT_SERVER_METRIC_UPDATE], false );
+        perf_print_latency( "next_server_send_packet", &server_metrics.latency[NEXT_SERVER_METRIC_SEND_PACKET], false );
+        perf_print_latency( "receive to notify", &server_metrics.latency[NEXT_SERVER_METRIC_RECEIVE_TO_NOTIFY], true );
+        printf( "\n" );
+    }
+
+    fflush( stdout );
+
+    for ( int i = 0; i < perf_config.num_clients; ++i )
+    {
+        next_client_destroy( perf_clients[i].client );
+    }
+
+    next_server_flush( perf_server );
+
+    next_server_destroy( perf_server );
+
+    next_term();
+
+    return 0;
+}
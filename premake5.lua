@@ -81,6 +81,18 @@ project "test"
 	filter "system:macosx"
 		linkoptions { "-framework SystemConfiguration -framework CoreFoundation" }
 
+project "bench"
+	kind "ConsoleApp"
+	links { "next", "sodium" }
+	files { "bench.cpp" }
+	includedirs { "include" }
+	filter "system:windows"
+		disablewarnings { "4324" }
+	filter "system:not windows"
+		links { "pthread" }
+	filter "system:macosx"
+		linkoptions { "-framework SystemConfiguration -framework CoreFoundation" }
+
 project "soak"
 	kind "ConsoleApp"
 	links { "next", "sodium" }
@@ -106,6 +118,30 @@ project "fuzz"
 	filter "system:macosx"
 		linkoptions { "-framework SystemConfiguration -framework CoreFoundation" }
 
+project "perf"
+	kind "ConsoleApp"
+	links { "next", "sodium" }
+	files { "perf.cpp" }
+	includedirs { "include" }
+	filter "system:windows"
+		disablewarnings { "4324" }
+	filter "system:not windows"
+		links { "pthread" }
+	filter "system:macosx"
+		linkoptions { "-framework SystemConfiguration -framework CoreFoundation" }
+
+project "local"
+	kind "ConsoleApp"
+	links { "next", "sodium" }
+	files { "local.cpp" }
+	includedirs { "include" }
+	filter "system:windows"
+		disablewarnings { "4324" }
+	filter "system:not windows"
+		links { "pthread" }
+	filter "system:macosx"
+		linkoptions { "-framework SystemConfiguration -framework CoreFoundation" }
+
 project "simple_client"
 	kind "ConsoleApp"
 	links { "next", "sodium" }
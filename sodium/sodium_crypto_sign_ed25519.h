@@ -33,6 +33,8 @@ size_t crypto_sign_ed25519_secretkeybytes(void);
 #define crypto_sign_ed25519_MESSAGEBYTES_MAX (SODIUM_SIZE_MAX - crypto_sign_ed25519_BYTES)
 size_t crypto_sign_ed25519_messagebytes_max(void);
 
+#define crypto_sign_ed25519_BATCHMAX 16U
+
 int crypto_sign_ed25519(unsigned char *sm, unsigned long long *smlen_p,
                         const unsigned char *m, unsigned long long mlen,
                         const unsigned char *sk)
@@ -95,6 +97,12 @@ int crypto_sign_ed25519ph_final_verify(crypto_sign_ed25519ph_state *state,
                                        const unsigned char *pk)
             __attribute__ ((warn_unused_result)) __attribute__ ((nonnull));
 
+int crypto_sign_ed25519ph_final_verify_batch(crypto_sign_ed25519ph_state *states,
+                                             const unsigned char * const *sigs,
+                                             size_t n,
+                                             const unsigned char *pk)
+            __attribute__ ((warn_unused_result)) __attribute__ ((nonnull));
+
 #ifdef __cplusplus
 }
 #endif
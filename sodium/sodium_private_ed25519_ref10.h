@@ -97,6 +97,12 @@ void ge25519_double_scalarmult_vartime(ge25519_p2 *r, const unsigned char *a,
                                        const ge25519_p3 *A,
                                        const unsigned char *b);
 
+#define ge25519_MULTI_SCALARMULT_MAX 17
+
+void ge25519_multi_scalarmult_vartime(ge25519_p3 *r, const unsigned char *a,
+                                      const ge25519_p3 *A, size_t n,
+                                      const unsigned char *b);
+
 void ge25519_scalarmult(ge25519_p3 *h, const unsigned char *a,
                         const ge25519_p3 *p);
 
@@ -754,6 +754,99 @@ ge25519_double_scalarmult_vartime(ge25519_p2 *r, const unsigned char *a,
     }
 }
 
+/*
+ r = a[0] * A[0] + ... + a[n-1] * A[n-1] + b * B
+ where a[i] is the i-th 32 byte scalar of a,
+ B is the Ed25519 base point (x,4/5) with x positive.
+
+ Preconditions:
+ n <= ge25519_MULTI_SCALARMULT_MAX
+
+ Straus' method: the doublings are shared between all points.
+ */
+
+void
+ge25519_multi_scalarmult_vartime(ge25519_p3 *r, const unsigned char *a,
+                                 const ge25519_p3 *A, size_t n,
+                                 const unsigned char *b)
+{
+    static const ge25519_precomp Bi[8] = {
+#ifdef HAVE_TI_MODE
+# include "sodium_fe_51_base2.h"
+#else
+# include "sodium_fe_25_5_base2.h"
+#endif
+    };
+    signed char    aslide[ge25519_MULTI_SCALARMULT_MAX][256];
+    signed char    bslide[256];
+    ge25519_cached Ai[ge25519_MULTI_SCALARMULT_MAX][8]; /* A,3A,...,15A */
+    ge25519_p1p1   t;
+    ge25519_p3     u;
+    ge25519_p3     A2;
+    ge25519_p2     acc;
+    size_t         j;
+    int            i;
+    int            k;
+
+    for (j = 0; j < n; ++j) {
+        slide_vartime(aslide[j], a + 32 * j);
+        ge25519_p3_to_cached(&Ai[j][0], &A[j]);
+        ge25519_p3_dbl(&t, &A[j]);
+        ge25519_p1p1_to_p3(&A2, &t);
+        for (k = 1; k < 8; ++k) {
+            ge25519_add(&t, &A2, &Ai[j][k - 1]);
+            ge25519_p1p1_to_p3(&u, &t);
+            ge25519_p3_to_cached(&Ai[j][k], &u);
+        }
+    }
+    slide_vartime(bslide, b);
+
+    for (i = 255; i >= 0; --i) {
+        if (bslide[i]) {
+            break;
+        }
+        for (j = 0; j < n; ++j) {
+            if (aslide[j][i]) {
+                break;
+            }
+        }
+        if (j < n) {
+            break;
+        }
+    }
+
+    ge25519_p3_0(r);
+    ge25519_p2_0(&acc);
+
+    for (; i >= 0; --i) {
+        ge25519_p2_dbl(&t, &acc);
+
+        for (j = 0; j < n; ++j) {
+            if (aslide[j][i] > 0) {
+                ge25519_p1p1_to_p3(&u, &t);
+                ge25519_add(&t, &u, &Ai[j][aslide[j][i] / 2]);
+            } else if (aslide[j][i] < 0) {
+                ge25519_p1p1_to_p3(&u, &t);
+                ge25519_sub(&t, &u, &Ai[j][(-aslide[j][i]) / 2]);
+            }
+        }
+
+        if (bslide[i] > 0) {
+            ge25519_p1p1_to_p3(&u, &t);
+            ge25519_madd(&t, &u, &Bi[bslide[i] / 2]);
+        } else if (bslide[i] < 0) {
+            ge25519_p1p1_to_p3(&u, &t);
+            ge25519_msub(&t, &u, &Bi[(-bslide[i]) / 2]);
+        }
+
+        if (i == 0) {
+            ge25519_p1p1_to_p3(r, &t);
+        } else {
+            ge25519_p1p1_to_p2(&acc, &t);
+        }
+    }
+}
+
 /*
  h = a * p
  where a = a[0]+256*a[1]+...+256^31 a[31]
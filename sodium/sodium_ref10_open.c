@@ -8,6 +8,7 @@
 #include "sodium_crypto_verify_32.h"
 #include "sodium_ref10_sign_ed25519.h"
 #include "sodium_private_ed25519_ref10.h"
+#include "sodium_randombytes.h"
 #include "sodium_utils.h"
 
 int
@@ -54,6 +55,86 @@ _crypto_sign_ed25519_verify_detached(const unsigned char *sig,
            sodium_memcmp(sig, rcheck, 32);
 }
 
+/*
+ Verifies n signatures made with the same public key in one go:
+
+ (z_0 s_0 + ... + z_n-1 s_n-1) B = z_0 R_0 + ... + z_n-1 R_n-1
+                                   + (z_0 h_0 + ... + z_n-1 h_n-1) A
+
+ with random 128 bit z_i. Returns 0 only if every signature verifies.
+ A failure does not say which signature is bad.
+ */
+
+int
+_crypto_sign_ed25519_verify_batch(const unsigned char * const *sig,
+                                  const unsigned char * const *m,
+                                  const unsigned long long    *mlen,
+                                  size_t                       n,
+                                  const unsigned char         *pk,
+                                  int prehashed)
+{
+    crypto_hash_sha512_state hs;
+    unsigned char            h[64];
+    unsigned char            z[32];
+    unsigned char            s[32];
+    unsigned char            scalars[32 * ge25519_MULTI_SCALARMULT_MAX];
+    unsigned char            check[32];
+    ge25519_p3               points[ge25519_MULTI_SCALARMULT_MAX];
+    ge25519_p3               P;
+    size_t                   i;
+
+    if (n == 0 || n > crypto_sign_ed25519_BATCHMAX) {
+        return -1;
+    }
+#ifndef ED25519_COMPAT
+    if (ge25519_is_canonical(pk) == 0 ||
+        ge25519_has_small_order(pk) != 0) {
+        return -1;
+    }
+#endif
+    if (ge25519_frombytes_negate_vartime(&points[n], pk) != 0) {
+        return -1;
+    }
+    memset(s, 0, sizeof s);
+    memset(scalars + 32 * n, 0, 32);
+    memset(z, 0, sizeof z);
+
+    for (i = 0; i < n; ++i) {
+#ifdef ED25519_COMPAT
+        if (sig[i][63] & 224) {
+            return -1;
+        }
+#else
+        if (sc25519_is_canonical(sig[i] + 32) == 0 ||
+            ge25519_has_small_order(sig[i]) != 0) {
+            return -1;
+        }
+#endif
+        if (ge25519_is_canonical(sig[i]) == 0 ||
+            ge25519_frombytes_negate_vartime(&points[i], sig[i]) != 0) {
+            return -1;
+        }
+        _crypto_sign_ed25519_ref10_hinit(&hs, prehashed);
+        crypto_hash_sha512_update(&hs, sig[i], 32);
+        crypto_hash_sha512_update(&hs, pk, 32);
+        crypto_hash_sha512_update(&hs, m[i], mlen[i]);
+        crypto_hash_sha512_final(&hs, h);
+        sc25519_reduce(h);
+
+        randombytes_buf(z, 16);
+        memcpy(scalars + 32 * i, z, 32);
+        sc25519_muladd(s, z, sig[i] + 32, s);
+        sc25519_muladd(scalars + 32 * n, z, h, scalars + 32 * n);
+    }
+
+    ge25519_multi_scalarmult_vartime(&P, scalars, points, n + 1, s);
+    ge25519_p3_tobytes(check, &P);
+
+    /* the sum must be the neutral element (0,1) */
+    check[0] ^= 1;
+    return sodium_is_zero(check, 32) - 1;
+}
+
 int
 crypto_sign_ed25519_verify_detached(const unsigned char *sig,
                                     const unsigned char *m,
@@ -15,4 +15,11 @@ int _crypto_sign_ed25519_verify_detached(const unsigned char *sig,
                                          unsigned long long   mlen,
                                          const unsigned char *pk,
                                          int prehashed);
+
+int _crypto_sign_ed25519_verify_batch(const unsigned char * const *sig,
+                                      const unsigned char * const *m,
+                                      const unsigned long long    *mlen,
+                                      size_t                       n,
+                                      const unsigned char         *pk,
+                                      int prehashed);
 #endif
@@ -95,3 +95,25 @@ crypto_sign_ed25519ph_final_verify(crypto_sign_ed25519ph_state *state,
 
     return _crypto_sign_ed25519_verify_detached(sig, ph, sizeof ph, pk, 1);
 }
+
+int
+crypto_sign_ed25519ph_final_verify_batch(crypto_sign_ed25519ph_state *states,
+                                         const unsigned char * const *sigs,
+                                         size_t                       n,
+                                         const unsigned char         *pk)
+{
+    unsigned char       ph[crypto_sign_ed25519_BATCHMAX][crypto_hash_sha512_BYTES];
+    const unsigned char *phs[crypto_sign_ed25519_BATCHMAX];
+    unsigned long long  phlens[crypto_sign_ed25519_BATCHMAX];
+    size_t              i;
+
+    if (n == 0 || n > crypto_sign_ed25519_BATCHMAX) {
+        return -1;
+    }
+    for (i = 0; i < n; ++i) {
+        crypto_hash_sha512_final(&states[i].hs, ph[i]);
+        phs[i] = ph[i];
+        phlens[i] = sizeof ph[i];
+    }
+    return _crypto_sign_ed25519_verify_batch(sigs, phs, phlens, n, pk, 1);
+}
@@ -49,6 +49,8 @@
 #include "next_route_manager.h"
 #include "next_autodetect.h"
 #include "next_internal_config.h"
+#include "next_async_log.h"
+#include "next_impairment.h"
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -136,6 +138,10 @@ const char * next_log_level_string( int level )
         return "???";
 }
 
+// IMPORTANT: set only on the async log writer thread, so the default log function prints when the message was logged, not when it was written
+
+static thread_local double async_log_time = 0.0;
+
 static void default_log_function( int level, const char * format, ... )
 {
     va_list args;
@@ -147,7 +153,7 @@ static void default_log_function( int level, const char * format, ... )
         if ( !log_quiet )
         {
             const char * level_string = next_log_level_string( level );
-            printf( "%.6f: %s: %s\n", next_platform_time(), level_string, buffer );
+            printf( "%.6f: %s: %s\n", async_log_time != 0.0 ? async_log_time : next_platform_time(), level_string, buffer );
         }
     }
     else
@@ -165,8 +171,24 @@ void next_log_function( void (*function)( int level, const char * format, ... )
     log_function = function;
 }
 
+static next_async_log_t * async_log = NULL;
+
+static void async_log_write_function( int level, double time, const char * message )
+{
+    async_log_time = time;
+    log_function( level, "%s", message );
+    async_log_time = 0.0;
+}
+
 void next_printf( const char * format, ... )
 {
+    // IMPORTANT: always synchronous. this is how asserts are reported, so drain anything queued ahead of it first
+
+    if ( async_log )
+    {
+        next_async_log_flush( async_log );
+    }
+
     va_list args;
     va_start( args, format );
     char buffer[1024];
@@ -183,8 +205,10 @@ void next_printf( int level, const char * format, ... )
     va_start( args, format );
     char buffer[1024];
     vsnprintf( buffer, sizeof( buffer ), format, args );
-    log_function( level, "%s", buffer );
     va_end( args );
+    if ( async_log && next_async_log_push( async_log, level, buffer ) )
+        return;
+    log_function( level, "%s", buffer );
 }
 
 // ------------------------------------------------------------
@@ -242,9 +266,11 @@ uint64_t next_protocol_version()
 {
 #if !NEXT_DEVELOPMENT
     #define VERSION_STRING(major,minor) #major #minor
-    return next_hash_string( VERSION_STRING(NEXT_VERSION_MAJOR_INT, NEXT_VERSION_MINOR_INT) );
+    #define REVISION_STRING_EXPAND(revision) #revision
+    #define REVISION_STRING(revision) REVISION_STRING_EXPAND(revision)
+    return next_hash_string( VERSION_STRING(NEXT_VERSION_MAJOR_INT, NEXT_VERSION_MINOR_INT) "." REVISION_STRING(NEXT_PROTOCOL_REVISION) );
 #else // #if !NEXT_DEVELOPMENT
-    return 0;
+    return NEXT_PROTOCOL_REVISION;
 #endif // #if !NEXT_DEVELOPMENT
 }
 
@@ -298,6 +324,11 @@ void next_default_config( next_config_t * config )
     config->server_backend_hostname[sizeof(config->server_backend_hostname)-1] = '\0';
     config->socket_send_buffer_size = NEXT_DEFAULT_SOCKET_SEND_BUFFER_SIZE;
     config->socket_receive_buffer_size = NEXT_DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE;
+    config->notify_queue_length = NEXT_NOTIFY_QUEUE_LENGTH;
+    config->command_queue_length = NEXT_COMMAND_QUEUE_LENGTH;
+    config->queue_overflow_policy = NEXT_QUEUE_OVERFLOW_DROP_NEWEST;
+    config->client_thread_cpu = -1;
+    config->server_thread_cpu = -1;
 }
 
 const char * next_platform_string( int platform_id )
@@ -373,6 +404,9 @@ int next_init( void * context, next_config_t * config_in )
 
     config.socket_send_buffer_size = NEXT_DEFAULT_SOCKET_SEND_BUFFER_SIZE;
     config.socket_receive_buffer_size = NEXT_DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE;
+    config.notify_queue_length = NEXT_NOTIFY_QUEUE_LENGTH;
+    config.command_queue_length = NEXT_COMMAND_QUEUE_LENGTH;
+    config.queue_overflow_policy = NEXT_QUEUE_OVERFLOW_DROP_NEWEST;
 
     const char * buyer_public_key_env = next_platform_getenv( "NEXT_BUYER_PUBLIC_KEY" );
     if ( buyer_public_key_env )
@@ -484,6 +518,45 @@ int next_init( void * context, next_config_t * config_in )
         next_printf( NEXT_LOG_LEVEL_INFO, "autodetect is disabled" );
     }
 
+    config.crypto_worker_thread = config_in ? config_in->crypto_worker_thread : false;
+
+    const char * next_crypto_worker_thread_override = next_platform_getenv( "NEXT_CRYPTO_WORKER_THREAD" );
+    {
+        if ( next_crypto_worker_thread_override != NULL )
+        {
+            config.crypto_worker_thread = atoi( next_crypto_worker_thread_override ) > 0;
+        }
+    }
+
+    if ( config.crypto_worker_thread )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "crypto worker thread is enabled" );
+    }
+
+    config.async_log = config_in ? config_in->async_log : false;
+
+    const char * next_async_log_override = next_platform_getenv( "NEXT_ASYNC_LOG" );
+    {
+        if ( next_async_log_override != NULL )
+        {
+            config.async_log = atoi( next_async_log_override ) > 0;
+        }
+    }
+
+    if ( config.async_log && !async_log )
+    {
+        async_log = next_async_log_create( context, async_log_write_function );
+        if ( async_log )
+        {
+            next_printf( NEXT_LOG_LEVEL_INFO, "async log is enabled" );
+        }
+        else
+        {
+            next_printf( NEXT_LOG_LEVEL_ERROR, "failed to create async log. logging synchronously" );
+            config.async_log = false;
+        }
+    }
+
     const char * socket_send_buffer_size_override = next_platform_getenv( "NEXT_SOCKET_SEND_BUFFER_SIZE" );
     if ( socket_send_buffer_size_override != NULL )
     {
@@ -506,6 +579,274 @@ int next_init( void * context, next_config_t * config_in )
         }
     }
 
+    if ( config_in && config_in->notify_queue_length > 0 )
+    {
+        config.notify_queue_length = config_in->notify_queue_length;
+    }
+
+    const char * notify_queue_length_override = next_platform_getenv( "NEXT_NOTIFY_QUEUE_LENGTH" );
+    if ( notify_queue_length_override != NULL )
+    {
+        int value = atoi( notify_queue_length_override );
+        if ( value > 0 )
+        {
+            next_printf( NEXT_LOG_LEVEL_INFO, "override notify queue length: %d", value );
+            config.notify_queue_length = value;
+        }
+    }
+
+    if ( config_in && config_in->command_queue_length > 0 )
+    {
+        config.command_queue_length = config_in->command_queue_length;
+    }
+
+    const char * command_queue_length_override = next_platform_getenv( "NEXT_COMMAND_QUEUE_LENGTH" );
+    if ( command_queue_length_override != NULL )
+    {
+        int value = atoi( command_queue_length_override );
+        if ( value > 0 )
+        {
+            next_printf( NEXT_LOG_LEVEL_INFO, "override command queue length: %d", value );
+            config.command_queue_length = value;
+        }
+    }
+
+    config.queue_overflow_policy = config_in ? config_in->queue_overflow_policy : NEXT_QUEUE_OVERFLOW_DROP_NEWEST;
+
+    const char * queue_overflow_policy_override = next_platform_getenv( "NEXT_QUEUE_OVERFLOW_POLICY" );
+    if ( queue_overflow_policy_override != NULL )
+    {
+        config.queue_overflow_policy = atoi( queue_overflow_policy_override );
+    }
+
+    if ( config.queue_overflow_policy != NEXT_QUEUE_OVERFLOW_DROP_NEWEST && config.queue_overflow_policy != NEXT_QUEUE_OVERFLOW_DROP_OLDEST )
+    {
+        next_printf( NEXT_LOG_LEVEL_WARN, "unknown queue overflow policy %d. dropping newest payloads", config.queue_overflow_policy );
+        config.queue_overflow_policy = NEXT_QUEUE_OVERFLOW_DROP_NEWEST;
+    }
+
+    if ( config.queue_overflow_policy == NEXT_QUEUE_OVERFLOW_DROP_OLDEST )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "queue overflow policy drops oldest payloads" );
+    }
+
+    config.memory_pool = config_in ? config_in->memory_pool : false;
+
+    const char * next_memory_pool_override = next_platform_getenv( "NEXT_MEMORY_POOL" );
+    {
+        if ( next_memory_pool_override != NULL )
+        {
+            config.memory_pool = atoi( next_memory_pool_override ) > 0;
+        }
+    }
+
+    config.max_sessions = config_in ? config_in->max_sessions : 0;
+
+    const char * max_sessions_override = next_platform_getenv( "NEXT_MAX_SESSIONS" );
+    if ( max_sessions_override != NULL )
+    {
+        int value = atoi( max_sessions_override );
+        if ( value > 0 )
+        {
+            next_printf( NEXT_LOG_LEVEL_INFO, "override max sessions: %d", value );
+            config.max_sessions = value;
+        }
+    }
+
+    if ( config.memory_pool )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "memory pool is enabled" );
+    }
+
+    config.immediate_packet_delivery = config_in ? config_in->immediate_packet_delivery : false;
+
+    const char * next_immediate_packet_delivery_override = next_platform_getenv( "NEXT_IMMEDIATE_PACKET_DELIVERY" );
+    {
+        if ( next_immediate_packet_delivery_override != NULL )
+        {
+            config.immediate_packet_delivery = atoi( next_immediate_packet_delivery_override ) > 0;
+        }
+    }
+
+    if ( config.immediate_packet_delivery )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "immediate packet delivery is enabled" );
+    }
+
+    config.client_thread_cpu = config_in ? config_in->client_thread_cpu : -1;
+
+    const char * client_thread_cpu_override = next_platform_getenv( "NEXT_CLIENT_THREAD_CPU" );
+    if ( client_thread_cpu_override != NULL )
+    {
+        config.client_thread_cpu = atoi( client_thread_cpu_override );
+    }
+
+    if ( config.client_thread_cpu >= 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "client thread cpu: %d", config.client_thread_cpu );
+    }
+
+    config.server_thread_cpu = config_in ? config_in->server_thread_cpu : -1;
+
+    const char * server_thread_cpu_override = next_platform_getenv( "NEXT_SERVER_THREAD_CPU" );
+    if ( server_thread_cpu_override != NULL )
+    {
+        config.server_thread_cpu = atoi( server_thread_cpu_override );
+    }
+
+    if ( config.server_thread_cpu >= 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "server thread cpu: %d", config.server_thread_cpu );
+    }
+
+    config.client_busy_poll_microseconds = config_in ? config_in->client_busy_poll_microseconds : 0;
+
+    const char * client_busy_poll_override = next_platform_getenv( "NEXT_CLIENT_BUSY_POLL" );
+    if ( client_busy_poll_override != NULL )
+    {
+        config.client_busy_poll_microseconds = atoi( client_busy_poll_override );
+    }
+
+    if ( config.client_busy_poll_microseconds > NEXT_MAX_BUSY_POLL_MICROSECONDS )
+    {
+        config.client_busy_poll_microseconds = NEXT_MAX_BUSY_POLL_MICROSECONDS;
+    }
+
+    if ( config.client_busy_poll_microseconds > 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "client busy poll: %dus", config.client_busy_poll_microseconds );
+    }
+
+    config.server_busy_poll_microseconds = config_in ? config_in->server_busy_poll_microseconds : 0;
+
+    const char * server_busy_poll_override = next_platform_getenv( "NEXT_SERVER_BUSY_POLL" );
+    if ( server_busy_poll_override != NULL )
+    {
+        config.server_busy_poll_microseconds = atoi( server_busy_poll_override );
+    }
+
+    if ( config.server_busy_poll_microseconds > NEXT_MAX_BUSY_POLL_MICROSECONDS )
+    {
+        config.server_busy_poll_microseconds = NEXT_MAX_BUSY_POLL_MICROSECONDS;
+    }
+
+    if ( config.server_busy_poll_microseconds > 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "server busy poll: %dus", config.server_busy_poll_microseconds );
+    }
+
+    config.kernel_packet_filter = config_in ? config_in->kernel_packet_filter : false;
+
+    const char * next_kernel_packet_filter_override = next_platform_getenv( "NEXT_KERNEL_PACKET_FILTER" );
+    {
+        if ( next_kernel_packet_filter_override != NULL )
+        {
+            config.kernel_packet_filter = atoi( next_kernel_packet_filter_override ) > 0;
+        }
+    }
+
+    if ( config.kernel_packet_filter )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "kernel packet filter is enabled" );
+    }
+
+    config.io_uring = config_in ? config_in->io_uring : false;
+
+    const char * next_io_uring_override = next_platform_getenv( "NEXT_IO_URING" );
+    {
+        if ( next_io_uring_override != NULL )
+        {
+            config.io_uring = atoi( next_io_uring_override ) > 0;
+        }
+    }
+
+    if ( config.io_uring )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "io_uring is enabled" );
+    }
+
+    next_copy_string( config.server_xdp_interface, config_in ? config_in->server_xdp_interface : "", sizeof(config.server_xdp_interface) );
+
+    const char * next_server_xdp_interface_override = next_platform_getenv( "NEXT_SERVER_XDP_INTERFACE" );
+    {
+        if ( next_server_xdp_interface_override != NULL )
+        {
+            next_copy_string( config.server_xdp_interface, next_server_xdp_interface_override, sizeof(config.server_xdp_interface) );
+        }
+    }
+
+    config.server_xdp_queue = config_in ? config_in->server_xdp_queue : 0;
+
+    const char * next_server_xdp_queue_override = next_platform_getenv( "NEXT_SERVER_XDP_QUEUE" );
+    {
+        if ( next_server_xdp_queue_override != NULL )
+        {
+            config.server_xdp_queue = atoi( next_server_xdp_queue_override );
+        }
+    }
+
+    if ( config.server_xdp_interface[0] != '\0' )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "server xdp interface: %s (queue %d)", config.server_xdp_interface, config.server_xdp_queue );
+    }
+
+    config.payload_coalescing = config_in ? config_in->payload_coalescing : false;
+
+    const char * next_payload_coalescing_override = next_platform_getenv( "NEXT_PAYLOAD_COALESCING" );
+    {
+        if ( next_payload_coalescing_override != NULL )
+        {
+            config.payload_coalescing = atoi( next_payload_coalescing_override ) > 0;
+        }
+    }
+
+    if ( config.payload_coalescing )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "payload coalescing is enabled" );
+    }
+
+    config.adaptive_multipath = config_in ? config_in->adaptive_multipath : false;
+
+    const char * next_adaptive_multipath_override = next_platform_getenv( "NEXT_ADAPTIVE_MULTIPATH" );
+    {
+        if ( next_adaptive_multipath_override != NULL )
+        {
+            config.adaptive_multipath = atoi( next_adaptive_multipath_override ) > 0;
+        }
+    }
+
+    if ( config.adaptive_multipath )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "adaptive multipath is enabled" );
+    }
+
+    config.fec_group_size = config_in ? config_in->fec_group_size : 0;
+
+    const char * next_fec_group_size_override = next_platform_getenv( "NEXT_FEC_GROUP_SIZE" );
+    {
+        if ( next_fec_group_size_override != NULL )
+        {
+            config.fec_group_size = atoi( next_fec_group_size_override );
+        }
+    }
+
+    if ( config.fec_group_size < 0 )
+    {
+        config.fec_group_size = 0;
+    }
+
+    if ( config.fec_group_size == 1 || config.fec_group_size > NEXT_FEC_MAX_GROUP_SIZE )
+    {
+        const int fec_group_size = ( config.fec_group_size == 1 ) ? 2 : NEXT_FEC_MAX_GROUP_SIZE;
+        next_printf( NEXT_LOG_LEVEL_WARN, "fec group size %d is out of range. using %d", config.fec_group_size, fec_group_size );
+        config.fec_group_size = fec_group_size;
+    }
+
+    if ( config.fec_group_size > 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "forward error correction is enabled (group size %d)", config.fec_group_size );
+    }
+
     const char * next_server_backend_hostname_override = next_platform_getenv( "NEXT_SERVER_BACKEND_HOSTNAME" );
 
     if ( next_server_backend_hostname_override )
@@ -550,6 +891,32 @@ int next_init( void * context, next_config_t * config_in )
         }
     }
 
+#if NEXT_DEVELOPMENT
+
+    const char * impairment_seed_env = next_platform_getenv( "NEXT_IMPAIRMENT_SEED" );
+    if ( impairment_seed_env )
+    {
+        const uint64_t seed = strtoull( impairment_seed_env, NULL, 10 );
+        next_printf( NEXT_LOG_LEVEL_INFO, "impairment seed: %" PRIu64, seed );
+        next_impairment_seed( seed );
+    }
+
+    const char * impairment_env = next_platform_getenv( "NEXT_IMPAIRMENT" );
+    if ( impairment_env && impairment_env[0] != '\0' )
+    {
+        next_impairment_config_t impairment_config;
+        if ( next_impairment_parse( impairment_env, &impairment_config ) == NEXT_OK && next_impairment_set( NULL, &impairment_config ) == NEXT_OK )
+        {
+            next_printf( NEXT_LOG_LEVEL_INFO, "impairment: %s", impairment_env );
+        }
+        else
+        {
+            next_printf( NEXT_LOG_LEVEL_ERROR, "impairment is invalid: \"%s\"", impairment_env );
+        }
+    }
+
+#endif // #if NEXT_DEVELOPMENT
+
     next_global_config = config;
 
     next_signed_packets[NEXT_UPGRADE_REQUEST_PACKET] = 1;
@@ -579,6 +946,19 @@ int next_init( void * context, next_config_t * config_in )
 
 void next_term()
 {
+    if ( async_log )
+    {
+        // IMPORTANT: the writer thread drains every ring before it exits, so nothing logged before next_term is lost
+
+        next_async_log_t * log = async_log;
+        async_log = NULL;
+        next_async_log_destroy( log );
+    }
+
+#if NEXT_DEVELOPMENT
+    next_impairment_term();
+#endif // #if NEXT_DEVELOPMENT
+
     next_platform_term();
 
     next_global_context = NULL;
@@ -0,0 +1,445 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "next_async_log.h"
+#include "next_memory_checks.h"
+#include "next_constants.h"
+#include "next_platform.h"
+
+#include <atomic>
+#include <inttypes.h>
+#include <memory.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NEXT_ASYNC_LOG_RING_FREE                0
+#define NEXT_ASYNC_LOG_RING_ACTIVE              1
+#define NEXT_ASYNC_LOG_RING_RETIRED             2
+
+static_assert( ( NEXT_ASYNC_LOG_RING_BYTES & ( NEXT_ASYNC_LOG_RING_BYTES - 1 ) ) == 0, "async log ring bytes must be a power of two" );
+
+struct next_async_log_record_t
+{
+    uint64_t sequence;
+    double time;
+    int32_t level;
+    int32_t bytes;                                  // IMPORTANT: includes the null terminator. zero marks padding to the end of the ring
+};
+
+const int NextAsyncLogRecordAlign = 8;
+
+static_assert( ( sizeof(next_async_log_record_t) % NextAsyncLogRecordAlign ) == 0, "async log record header must be aligned" );
+
+// IMPORTANT: single producer (the thread that owns the ring), single consumer (the writer thread)
+
+struct next_async_log_ring_t
+{
+    std::atomic<int> state;
+    std::atomic<uint32_t> write_index;
+    std::atomic<uint32_t> read_index;
+    std::atomic<uint64_t> num_dropped;
+    uint8_t data[NEXT_ASYNC_LOG_RING_BYTES];
+};
+
+struct next_async_log_t
+{
+    NEXT_DECLARE_SENTINEL(0)
+
+    void * context;
+    next_async_log_write_function_t write_function;
+    uint64_t generation;
+
+    NEXT_DECLARE_SENTINEL(1)
+
+    next_platform_thread_t * thread;
+
+    NEXT_DECLARE_SENTINEL(2)
+
+    std::atomic<uint64_t> quit;
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> num_written;
+
+    NEXT_DECLARE_SENTINEL(3)
+
+    // IMPORTANT: only touched by the writer thread
+
+    uint64_t num_dropped_reported;
+
+    NEXT_DECLARE_SENTINEL(4)
+
+    next_async_log_ring_t rings[NEXT_ASYNC_LOG_MAX_THREADS];
+
+    NEXT_DECLARE_SENTINEL(5)
+};
+
+void next_async_log_initialize_sentinels( next_async_log_t * log )
+{
+    (void) log;
+    next_assert( log );
+    NEXT_INITIALIZE_SENTINEL( log, 0 )
+    NEXT_INITIALIZE_SENTINEL( log, 1 )
+    NEXT_INITIALIZE_SENTINEL( log, 2 )
+    NEXT_INITIALIZE_SENTINEL( log, 3 )
+    NEXT_INITIALIZE_SENTINEL( log, 4 )
+    NEXT_INITIALIZE_SENTINEL( log, 5 )
+}
+
+void next_async_log_verify_sentinels( next_async_log_t * log )
+{
+    (void) log;
+    next_assert( log );
+    NEXT_VERIFY_SENTINEL( log, 0 )
+    NEXT_VERIFY_SENTINEL( log, 1 )
+    NEXT_VERIFY_SENTINEL( log, 2 )
+    NEXT_VERIFY_SENTINEL( log, 3 )
+    NEXT_VERIFY_SENTINEL( log, 4 )
+    NEXT_VERIFY_SENTINEL( log, 5 )
+}
+
+// ---------------------------------------------------------------
+
+static std::atomic<uint64_t> next_async_log_generation( 0 );
+
+static std::atomic<uint64_t> next_async_log_live_generation( 0 );
+
+static std::atomic<int> next_async_log_num_exiting_threads( 0 );
+
+// IMPORTANT: remembers which ring this thread claimed. The generation check makes sure a ring claimed from a log that
+// has since been destroyed is never reused, and the destructor hands the ring back to the writer when the thread exits.
+// The destructor never reads the log itself. It registers as exiting before it checks the live generation, and destroy
+// clears the live generation before it waits for exiting threads, so the ring is either retired before the log is freed or not touched at all.
+
+struct next_async_log_thread_slot_t
+{
+    next_async_log_t * log;
+    uint64_t generation;
+    next_async_log_ring_t * ring;
+
+    ~next_async_log_thread_slot_t()
+    {
+        if ( !ring )
+            return;
+
+        next_async_log_num_exiting_threads.fetch_add( 1 );
+
+        if ( next_async_log_live_generation.load() == generation )
+        {
+            ring->state.store( NEXT_ASYNC_LOG_RING_RETIRED, std::memory_order_release );
+        }
+
+        next_async_log_num_exiting_threads.fetch_sub( 1 );
+    }
+};
+
+static thread_local next_async_log_thread_slot_t next_async_log_thread_slot;
+
+static next_async_log_ring_t * next_async_log_thread_ring( next_async_log_t * log )
+{
+    next_async_log_thread_slot_t & slot = next_async_log_thread_slot;
+
+    if ( slot.log == log && slot.generation == log->generation )
+        return slot.ring;
+
+    slot.log = log;
+    slot.generation = log->generation;
+    slot.ring = NULL;
+
+    for ( int i = 0; i < NEXT_ASYNC_LOG_MAX_THREADS; ++i )
+    {
+        int expected = NEXT_ASYNC_LOG_RING_FREE;
+        if ( log->rings[i].state.compare_exchange_strong( expected, NEXT_ASYNC_LOG_RING_ACTIVE, std::memory_order_acq_rel ) )
+        {
+            slot.ring = &log->rings[i];
+            break;
+        }
+    }
+
+    return slot.ring;
+}
+
+// ---------------------------------------------------------------
+
+static inline uint32_t next_async_log_record_bytes( int message_bytes )
+{
+    return uint32_t( ( sizeof(next_async_log_record_t) + message_bytes + NextAsyncLogRecordAlign - 1 ) & ~( NextAsyncLogRecordAlign - 1 ) );
+}
+
+bool next_async_log_push( next_async_log_t * log, int level, const char * message )
+{
+    next_assert( log );
+    next_assert( message );
+
+    next_async_log_ring_t * ring = next_async_log_thread_ring( log );
+    if ( !ring )
+        return false;
+
+    const int message_bytes = (int) strlen( message ) + 1;
+    const uint32_t record_bytes = next_async_log_record_bytes( message_bytes );
+
+    next_assert( record_bytes <= NEXT_ASYNC_LOG_RING_BYTES / 2 );
+
+    uint32_t write_index = ring->write_index.load( std::memory_order_relaxed );
+    const uint32_t read_index = ring->read_index.load( std::memory_order_acquire );
+
+    const uint32_t offset = write_index & ( NEXT_ASYNC_LOG_RING_BYTES - 1 );
+    const uint32_t tail_bytes = NEXT_ASYNC_LOG_RING_BYTES - offset;
+    const uint32_t pad_bytes = ( tail_bytes < record_bytes ) ? tail_bytes : 0;
+    const uint32_t free_bytes = NEXT_ASYNC_LOG_RING_BYTES - ( write_index - read_index );
+
+    if ( free_bytes < pad_bytes + record_bytes )
+    {
+        ring->num_dropped.fetch_add( 1, std::memory_order_relaxed );
+        return true;
+    }
+
+    if ( pad_bytes )
+    {
+        if ( pad_bytes >= sizeof(next_async_log_record_t) )
+        {
+            next_async_log_record_t pad;
+            memset( &pad, 0, sizeof(pad) );
+            memcpy( ring->data + offset, &pad, sizeof(pad) );
+        }
+        write_index += pad_bytes;
+    }
+
+    next_async_log_record_t record;
+    record.sequence = log->sequence.fetch_add( 1, std::memory_order_relaxed );
+    record.time = next_platform_time();
+    record.level = level;
+    record.bytes = message_bytes;
+
+    uint8_t * p = ring->data + ( write_index & ( NEXT_ASYNC_LOG_RING_BYTES - 1 ) );
+    memcpy( p, &record, sizeof(record) );
+    memcpy( p + sizeof(record), message, message_bytes );
+
+    ring->write_index.store( write_index + record_bytes, std::memory_order_release );
+
+    return true;
+}
+
+// ---------------------------------------------------------------
+
+// IMPORTANT: returns the next record in the ring, skipping padding at the end of the ring. NULL if the ring is empty
+
+static const next_async_log_record_t * next_async_log_peek( next_async_log_ring_t * ring, uint32_t & read_index )
+{
+    read_index = ring->read_index.load( std::memory_order_relaxed );
+    const uint32_t write_index = ring->write_index.load( std::memory_order_acquire );
+
+    while ( read_index != write_index )
+    {
+        const uint32_t offset = read_index & ( NEXT_ASYNC_LOG_RING_BYTES - 1 );
+        const uint32_t tail_bytes = NEXT_ASYNC_LOG_RING_BYTES - offset;
+
+        if ( tail_bytes < sizeof(next_async_log_record_t) )
+        {
+            read_index += tail_bytes;
+            continue;
+        }
+
+        const next_async_log_record_t * record = (const next_async_log_record_t*) ( ring->data + offset );
+        if ( record->bytes == 0 )
+        {
+            read_index += tail_bytes;
+            continue;
+        }
+
+        return record;
+    }
+
+    ring->read_index.store( read_index, std::memory_order_release );
+
+    return NULL;
+}
+
+static int next_async_log_drain( next_async_log_t * log )
+{
+    int num_written = 0;
+
+    while ( true )
+    {
+        // IMPORTANT: merge the rings by sequence. This is best effort across threads: a thread takes its sequence number before
+        // it publishes the record, so a message with a later sequence on another ring can already be written by then
+
+        next_async_log_ring_t * next_ring = NULL;
+        const next_async_log_record_t * next_record = NULL;
+        uint32_t next_read_index = 0;
+
+        for ( int i = 0; i < NEXT_ASYNC_LOG_MAX_THREADS; ++i )
+        {
+            next_async_log_ring_t * ring = &log->rings[i];
+
+            const int state = ring->state.load( std::memory_order_acquire );
+            if ( state == NEXT_ASYNC_LOG_RING_FREE )
+                continue;
+
+            uint32_t read_index = 0;
+            const next_async_log_record_t * record = next_async_log_peek( ring, read_index );
+            if ( !record )
+            {
+                if ( state == NEXT_ASYNC_LOG_RING_RETIRED )
+                {
+                    ring->state.store( NEXT_ASYNC_LOG_RING_FREE, std::memory_order_release );
+                }
+                continue;
+            }
+
+            if ( !next_record || record->sequence < next_record->sequence )
+            {
+                next_ring = ring;
+                next_record = record;
+                next_read_index = read_index;
+            }
+        }
+
+        if ( !next_record )
+            break;
+
+        log->write_function( next_record->level, next_record->time, (const char*) ( next_record + 1 ) );
+
+        next_ring->read_index.store( next_read_index + next_async_log_record_bytes( next_record->bytes ), std::memory_order_release );
+
+        num_written++;
+    }
+
+    const uint64_t num_dropped = next_async_log_num_dropped( log );
+    if ( num_dropped != log->num_dropped_reported )
+    {
+        char message[256];
+        snprintf( message, sizeof(message), "async log dropped %" PRIu64 " messages", num_dropped - log->num_dropped_reported );
+        log->write_function( NEXT_LOG_LEVEL_WARN, next_platform_time(), message );
+        log->num_dropped_reported = num_dropped;
+    }
+
+    if ( num_written > 0 )
+    {
+        log->num_written.fetch_add( num_written, std::memory_order_release );
+    }
+
+    return num_written;
+}
+
+static void next_async_log_thread_function( void * context )
+{
+    next_assert( context );
+
+    next_async_log_t * log = (next_async_log_t*) context;
+
+    while ( !log->quit )
+    {
+        if ( next_async_log_drain( log ) == 0 )
+        {
+            next_platform_sleep( NEXT_ASYNC_LOG_IDLE_SLEEP_TIME );
+        }
+    }
+
+    next_async_log_drain( log );
+}
+
+// ---------------------------------------------------------------
+
+next_async_log_t * next_async_log_create( void * context, next_async_log_write_function_t write_function )
+{
+    next_assert( write_function );
+
+    next_async_log_t * log = (next_async_log_t*) next_malloc( context, sizeof(next_async_log_t) );
+    if ( !log )
+        return NULL;
+
+    memset( (char*) log, 0, sizeof(next_async_log_t) );
+
+    next_async_log_initialize_sentinels( log );
+
+    log->context = context;
+    log->write_function = write_function;
+    log->generation = ++next_async_log_generation;
+
+    next_async_log_live_generation.store( log->generation );
+
+    log->thread = next_platform_thread_create( context, next_async_log_thread_function, log );
+    if ( !log->thread )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "async log could not create thread" );
+        next_async_log_destroy( log );
+        return NULL;
+    }
+
+    next_async_log_verify_sentinels( log );
+
+    return log;
+}
+
+void next_async_log_destroy( next_async_log_t * log )
+{
+    next_async_log_verify_sentinels( log );
+
+    next_async_log_live_generation.store( 0 );
+
+    while ( next_async_log_num_exiting_threads.load() != 0 )
+    {
+        next_platform_sleep( 0.001 );
+    }
+
+    if ( log->thread )
+    {
+        log->quit = 1;
+        next_platform_thread_join( log->thread );
+        next_platform_thread_destroy( log->thread );
+        log->thread = NULL;
+    }
+
+    next_async_log_verify_sentinels( log );
+
+    next_clear_and_free( log->context, log, sizeof(next_async_log_t) );
+}
+
+void next_async_log_flush( next_async_log_t * log )
+{
+    next_async_log_verify_sentinels( log );
+
+    // IMPORTANT: waits until everything pushed before this call has been written, or until the timeout. dropped messages never get a sequence number
+
+    const uint64_t target = log->sequence.load( std::memory_order_acquire );
+
+    const double start_time = next_platform_time();
+
+    while ( log->num_written.load( std::memory_order_acquire ) < target )
+    {
+        if ( next_platform_time() - start_time > NEXT_ASYNC_LOG_FLUSH_TIMEOUT )
+            break;
+
+        next_platform_sleep( NEXT_ASYNC_LOG_IDLE_SLEEP_TIME );
+    }
+}
+
+uint64_t next_async_log_num_dropped( next_async_log_t * log )
+{
+    next_assert( log );
+
+    uint64_t num_dropped = 0;
+    for ( int i = 0; i < NEXT_ASYNC_LOG_MAX_THREADS; ++i )
+    {
+        num_dropped += log->rings[i].num_dropped.load( std::memory_order_relaxed );
+    }
+    return num_dropped;
+}
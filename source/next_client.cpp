@@ -23,17 +23,22 @@
 #include "next_client.h"
 #include "next_memory_checks.h"
 #include "next_queue.h"
+#include "next_pool.h"
 #include "next_platform.h"
 #include "next_relay_manager.h"
 #include "next_route_manager.h"
 #include "next_packet_loss_tracker.h"
 #include "next_out_of_order_tracker.h"
 #include "next_jitter_tracker.h"
+#include "next_adaptive_multipath.h"
+#include "next_fec.h"
 #include "next_bandwidth_limiter.h"
+#include "next_payload_coalescer.h"
 #include "next_replay_protection.h"
 #include "next_read_write.h"
 #include "next_header.h"
 #include "next_internal_config.h"
+#include "next_latency_histogram.h"
 
 #include <atomic>
 #include <stdio.h>
@@ -71,6 +76,14 @@ struct next_client_command_report_session_t : public next_client_command_t
     // ...
 };
 
+union next_client_command_storage_t
+{
+    next_client_command_open_session_t open_session;
+    next_client_command_close_session_t close_session;
+    next_client_command_destroy_t destroy;
+    next_client_command_report_session_t report_session;
+};
+
 // ---------------------------------------------------------------
 
 #define NEXT_CLIENT_NOTIFY_PACKET_RECEIVED          0
@@ -86,8 +99,10 @@ struct next_client_notify_t
 
 struct next_client_notify_packet_received_t : public next_client_notify_t
 {
+    double queue_time;
     bool direct;
     bool already_received;
+    bool coalesced;
     int payload_bytes;
     uint8_t payload_data[NEXT_MAX_PACKET_BYTES-1];
 };
@@ -97,6 +112,8 @@ struct next_client_notify_upgraded_t : public next_client_notify_t
     uint64_t session_id;
     next_address_t client_external_address;
     uint8_t current_magic[8];
+    bool payload_coalescing;
+    bool fec;
 };
 
 struct next_client_notify_stats_updated_t : public next_client_notify_t
@@ -114,6 +131,15 @@ struct next_client_notify_ready_t : public next_client_notify_t
 {
 };
 
+union next_client_notify_storage_t
+{
+    next_client_notify_packet_received_t packet_received;
+    next_client_notify_upgraded_t upgraded;
+    next_client_notify_stats_updated_t stats_updated;
+    next_client_notify_magic_updated_t magic_updated;
+    next_client_notify_ready_t ready;
+};
+
 // ---------------------------------------------------------------
 
 struct next_client_internal_t;
@@ -169,8 +195,12 @@ struct next_client_internal_t
     NEXT_DECLARE_SENTINEL(0)
 
     void * context;
+    next_arena_t * arena;
+    next_pool_t * notify_pool;
+    next_pool_t * command_pool;
     next_queue_t * command_queue;
     next_queue_t * notify_queue;
+    next_queue_t * payload_queue;
     next_platform_socket_t * socket;
     next_platform_mutex_t command_mutex;
     next_platform_mutex_t notify_mutex;
@@ -182,6 +212,8 @@ struct next_client_internal_t
     bool reported;
     bool fallback_to_direct;
     bool multipath;
+    bool payload_coalescing;
+    bool fec;
     uint8_t open_session_sequence;
     uint64_t upgrade_sequence;
     uint64_t session_id;
@@ -214,6 +246,9 @@ struct next_client_internal_t
     next_packet_loss_tracker_t packet_loss_tracker;
     next_out_of_order_tracker_t out_of_order_tracker;
     next_jitter_tracker_t jitter_tracker;
+    next_adaptive_multipath_t adaptive_multipath;
+    next_fec_decoder_t fec_decoder;
+    next_bandwidth_limiter_t fec_receive_bandwidth;
 
     NEXT_DECLARE_SENTINEL(4)
 
@@ -243,18 +278,27 @@ struct next_client_internal_t
 
     NEXT_DECLARE_SENTINEL(8)
 
-    next_platform_mutex_t direct_bandwidth_mutex;
-    float direct_bandwidth_usage_kbps_up;
-    float direct_bandwidth_usage_kbps_down;
+    // IMPORTANT: bandwidth telemetry is shared between the game thread and the internal thread with relaxed atomics so sending a packet never takes a lock
+
+    std::atomic<float> direct_bandwidth_usage_kbps_up;
+    std::atomic<float> direct_bandwidth_usage_kbps_down;
 
     NEXT_DECLARE_SENTINEL(9)
 
-    next_platform_mutex_t next_bandwidth_mutex;
-    bool next_bandwidth_over_limit;
-    float next_bandwidth_usage_kbps_up;
-    float next_bandwidth_usage_kbps_down;
-    float next_bandwidth_envelope_kbps_up;
-    float next_bandwidth_envelope_kbps_down;
+    std::atomic<bool> next_bandwidth_over_limit;
+    std::atomic<float> next_bandwidth_usage_kbps_up;
+    std::atomic<float> next_bandwidth_usage_kbps_down;
+    std::atomic<float> next_bandwidth_envelope_kbps_up;
+    std::atomic<float> next_bandwidth_envelope_kbps_down;
+
+    std::atomic<bool> multipath_duplicate;
+    std::atomic<bool> multipath_prefer_direct;
+    std::atomic<float> fec_bandwidth_usage_kbps_up;
+
+    void (*immediate_packet_received_callback)( next_client_t * client, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes );
+    next_client_t * immediate_packet_received_client;
+    next_bandwidth_limiter_t immediate_direct_receive_bandwidth;
+    next_bandwidth_limiter_t immediate_next_receive_bandwidth;
 
     NEXT_DECLARE_SENTINEL(10)
 
@@ -285,6 +329,11 @@ struct next_client_internal_t
     std::atomic<uint64_t> counters[NEXT_CLIENT_COUNTER_MAX];
 
     NEXT_DECLARE_SENTINEL(14)
+
+    double receive_time;
+    next_latency_histogram_t latency[NEXT_CLIENT_METRIC_NUM_METRICS];
+
+    NEXT_DECLARE_SENTINEL(15)
 };
 
 void next_client_internal_initialize_sentinels( next_client_internal_t * client )
@@ -306,6 +355,7 @@ void next_client_internal_initialize_sentinels( next_client_internal_t * client
     NEXT_INITIALIZE_SENTINEL( client, 12 )
     NEXT_INITIALIZE_SENTINEL( client, 13 )
     NEXT_INITIALIZE_SENTINEL( client, 14 )
+    NEXT_INITIALIZE_SENTINEL( client, 15 )
 
     next_replay_protection_initialize_sentinels( &client->payload_replay_protection );
     next_replay_protection_initialize_sentinels( &client->special_replay_protection );
@@ -336,6 +386,7 @@ void next_client_internal_verify_sentinels( next_client_internal_t * client )
     NEXT_VERIFY_SENTINEL( client, 12 )
     NEXT_VERIFY_SENTINEL( client, 13 )
     NEXT_VERIFY_SENTINEL( client, 14 )
+    NEXT_VERIFY_SENTINEL( client, 15 )
 
     if ( client->command_queue )
         next_queue_verify_sentinels( client->command_queue );
@@ -343,6 +394,9 @@ void next_client_internal_verify_sentinels( next_client_internal_t * client )
     if ( client->notify_queue )
         next_queue_verify_sentinels( client->notify_queue );
 
+    if ( client->payload_queue )
+        next_queue_verify_sentinels( client->payload_queue );
+
     next_replay_protection_verify_sentinels( &client->payload_replay_protection );
     next_replay_protection_verify_sentinels( &client->special_replay_protection );
     next_replay_protection_verify_sentinels( &client->internal_replay_protection );
@@ -357,6 +411,193 @@ void next_client_internal_verify_sentinels( next_client_internal_t * client )
         next_route_manager_verify_sentinels( client->route_manager );
 }
 
+// IMPORTANT: Both next_client_t and next_client_internal_t have a latency array, and each is only ever touched from its own
+// thread, so this guard records mutex wait and hold times into whichever one "client" refers to without any locking.
+
+#define next_client_mutex_guard( _mutex ) next_latency_mutex_guard( _mutex, &client->latency[NEXT_CLIENT_METRIC_MUTEX_WAIT], &client->latency[NEXT_CLIENT_METRIC_MUTEX_HOLD] )
+
+void next_client_internal_stamp_packet_received( next_client_internal_t * client, next_client_notify_packet_received_t * notify )
+{
+    notify->queue_time = next_platform_time();
+    next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_RECEIVE_TO_NOTIFY], notify->queue_time - client->receive_time );
+}
+
+void next_client_internal_queue_notify( next_client_internal_t * client, next_client_notify_t * notify )
+{
+    // IMPORTANT: call with notify_mutex held. received packets go in their own lane, so a flood of payloads can never push control notifies out
+
+    next_queue_t * queue = client->notify_queue;
+
+    bool drop_oldest = false;
+
+    if ( notify->type == NEXT_CLIENT_NOTIFY_PACKET_RECEIVED )
+    {
+        queue = client->payload_queue;
+        drop_oldest = next_global_config.queue_overflow_policy == NEXT_QUEUE_OVERFLOW_DROP_OLDEST;
+    }
+
+    const int result = drop_oldest ? next_queue_push_drop_oldest( queue, notify ) : next_queue_push( queue, notify );
+
+    if ( (uint64_t) queue->num_entries > client->counters[NEXT_CLIENT_COUNTER_NOTIFY_QUEUE_HIGH_WATER_MARK] )
+    {
+        client->counters[NEXT_CLIENT_COUNTER_NOTIFY_QUEUE_HIGH_WATER_MARK] = queue->num_entries;
+    }
+
+    if ( result != NEXT_OK )
+    {
+        client->counters[NEXT_CLIENT_COUNTER_NOTIFY_QUEUE_OVERFLOW]++;
+    }
+}
+
+void next_client_internal_packet_received( next_client_internal_t * client, bool direct, bool already_received, bool coalesced, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( payload_data );
+    next_assert( payload_bytes >= 0 );
+    next_assert( payload_bytes <= NEXT_MAX_PACKET_BYTES - 1 );
+
+    // IMPORTANT: with immediate packet delivery the callback runs right here on the internal thread, with a pointer into the receive
+    // buffer. Receive bandwidth is tracked here too, since these packets never reach next_client_update
+
+    if ( client->immediate_packet_received_callback )
+    {
+        if ( !already_received )
+        {
+            next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_RECEIVE_TO_NOTIFY], next_platform_time() - client->receive_time );
+            if ( coalesced )
+            {
+                int offset = 0;
+                const uint8_t * packet_data = NULL;
+                int packet_bytes = 0;
+                while ( ( packet_bytes = next_payload_coalescer_read_packet( payload_data, payload_bytes, &offset, &packet_data ) ) > 0 )
+                {
+                    client->immediate_packet_received_callback( client->immediate_packet_received_client, client->context, &client->server_address, packet_data, packet_bytes );
+                }
+            }
+            else
+            {
+                client->immediate_packet_received_callback( client->immediate_packet_received_client, client->context, &client->server_address, payload_data, payload_bytes );
+            }
+        }
+
+        const int wire_packet_bits = next_wire_packet_bits( payload_bytes );
+
+        if ( direct )
+        {
+            next_bandwidth_limiter_add_packet( &client->immediate_direct_receive_bandwidth, next_platform_time(), 0, wire_packet_bits );
+            client->direct_bandwidth_usage_kbps_down.store( float( next_bandwidth_limiter_usage_kbps( &client->immediate_direct_receive_bandwidth ) ), std::memory_order_relaxed );
+        }
+        else
+        {
+            const int envelope_kbps_down = int( client->next_bandwidth_envelope_kbps_down.load( std::memory_order_relaxed ) );
+            next_bandwidth_limiter_add_packet( &client->immediate_next_receive_bandwidth, next_platform_time(), envelope_kbps_down, wire_packet_bits );
+            client->next_bandwidth_usage_kbps_down.store( float( next_bandwidth_limiter_usage_kbps( &client->immediate_next_receive_bandwidth ) ), std::memory_order_relaxed );
+        }
+
+        return;
+    }
+
+    next_client_notify_packet_received_t * notify = (next_client_notify_packet_received_t*) next_pool_alloc( client->notify_pool, client->context, sizeof( next_client_notify_packet_received_t ) );
+    notify->type = NEXT_CLIENT_NOTIFY_PACKET_RECEIVED;
+    notify->direct = direct;
+    notify->already_received = already_received;
+    notify->coalesced = coalesced;
+    notify->payload_bytes = payload_bytes;
+    memcpy( notify->payload_data, payload_data, size_t(payload_bytes) );
+    next_client_internal_stamp_packet_received( client, notify );
+    {
+#if NEXT_SPIKE_TRACKING
+        next_printf( NEXT_LOG_LEVEL_SPAM, "client internal thread queues up NEXT_CLIENT_NOTIFY_PACKET_RECEIVED at %s:%d", __FILE__, __LINE__ );
+#endif // #if NEXT_SPIKE_TRACKING
+        next_client_mutex_guard( &client->notify_mutex );
+        next_client_internal_queue_notify( client, notify );
+    }
+}
+
+void next_client_internal_process_payload( next_client_internal_t * client, bool direct, bool already_received, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( payload_data );
+
+    if ( !client->payload_coalescing )
+    {
+        if ( payload_bytes > NEXT_MTU )
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "client ignored payload. payload is too large" );
+            return;
+        }
+
+        next_client_internal_packet_received( client, direct, already_received, false, payload_data, payload_bytes );
+        return;
+    }
+
+    // IMPORTANT: coalesced payloads are validated here, so they can be split into packets later without checking them again
+
+    if ( next_payload_coalescer_num_packets( payload_data, payload_bytes ) <= 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "client ignored coalesced payload. payload is malformed" );
+        return;
+    }
+
+    next_client_internal_packet_received( client, direct, already_received, true, payload_data, payload_bytes );
+}
+
+void next_client_internal_payload_received( next_client_internal_t * client, bool direct, bool already_received, uint64_t payload_sequence, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( payload_data );
+
+    if ( !client->fec )
+    {
+        next_client_internal_process_payload( client, direct, already_received, payload_data, payload_bytes );
+        return;
+    }
+
+    // IMPORTANT: payloads already received on the other path are passed on for bandwidth tracking, but never go into a fec group
+
+    if ( already_received )
+    {
+        bool parity = false;
+        int index = 0;
+        const uint8_t * fec_payload_data = NULL;
+        const int fec_payload_bytes = next_fec_read_packet( payload_data, payload_bytes, &parity, &index, &fec_payload_data );
+        if ( fec_payload_bytes > 0 && !parity )
+        {
+            next_client_internal_process_payload( client, direct, true, fec_payload_data, fec_payload_bytes );
+        }
+        return;
+    }
+
+    const uint8_t * fec_payload_data = NULL;
+    const int fec_payload_bytes = next_fec_decoder_add_packet( &client->fec_decoder, payload_sequence, payload_data, payload_bytes, &fec_payload_data );
+
+    if ( fec_payload_bytes < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "client ignored fec payload. payload is malformed" );
+        return;
+    }
+
+    if ( fec_payload_bytes > 0 )
+    {
+        next_client_internal_process_payload( client, direct, false, fec_payload_data, fec_payload_bytes );
+    }
+    else
+    {
+        next_bandwidth_limiter_add_packet( &client->fec_receive_bandwidth, next_platform_time(), 0, next_wire_packet_bits( payload_bytes ) );
+        client->counters[NEXT_CLIENT_COUNTER_FEC_PARITY_RECEIVED]++;
+    }
+
+    uint64_t recovered_sequence = 0;
+    const uint8_t * recovered_payload_data = NULL;
+    const int recovered_payload_bytes = next_fec_decoder_recover( &client->fec_decoder, &recovered_sequence, &recovered_payload_data );
+
+    // IMPORTANT: mark the rebuilt payload as received, so the original is dropped by replay protection if it turns up late
+
+    if ( recovered_payload_bytes > 0 && !next_replay_protection_already_received( &client->payload_replay_protection, recovered_sequence ) )
+    {
+        next_replay_protection_advance_sequence( &client->payload_replay_protection, recovered_sequence );
+        client->counters[NEXT_CLIENT_COUNTER_FEC_RECOVERED]++;
+        next_client_internal_process_payload( client, direct, false, recovered_payload_data, recovered_payload_bytes );
+    }
+}
+
 next_client_internal_t * next_client_internal_create( void * context, const char * bind_address_string )
 {
 #if !NEXT_DEVELOPMENT
@@ -390,7 +631,36 @@ next_client_internal_t * next_client_internal_create( void * context, const char
 
     next_client_internal_verify_sentinels( client );
 
-    client->command_queue = next_queue_create( context, NEXT_COMMAND_QUEUE_LENGTH );
+    if ( next_global_config.memory_pool )
+    {
+        // IMPORTANT: notifies are queued in two lanes, so the notify pool needs enough blocks to fill both
+
+        const int num_notifies = next_global_config.notify_queue_length * 2;
+        const int num_commands = next_global_config.command_queue_length;
+
+        size_t arena_bytes = 0;
+        arena_bytes += next_arena_align( sizeof(next_client_notify_storage_t) ) * num_notifies + NEXT_ARENA_ALIGNMENT;
+        arena_bytes += next_arena_align( sizeof(next_client_command_storage_t) ) * num_commands + NEXT_ARENA_ALIGNMENT;
+
+        client->arena = next_arena_create( context, arena_bytes );
+        if ( !client->arena )
+        {
+            next_printf( NEXT_LOG_LEVEL_ERROR, "client could not create memory arena" );
+            next_client_internal_destroy( client );
+            return NULL;
+        }
+
+        client->notify_pool = next_pool_create( context, client->arena, sizeof(next_client_notify_storage_t), num_notifies );
+        client->command_pool = next_pool_create( context, client->arena, sizeof(next_client_command_storage_t), num_commands );
+        if ( !client->notify_pool || !client->command_pool )
+        {
+            next_printf( NEXT_LOG_LEVEL_ERROR, "client could not create memory pools" );
+            next_client_internal_destroy( client );
+            return NULL;
+        }
+    }
+
+    client->command_queue = next_queue_create( context, next_global_config.command_queue_length );
     if ( !client->command_queue )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "client could not create client command queue" );
@@ -398,9 +668,11 @@ next_client_internal_t * next_client_internal_create( void * context, const char
         return NULL;
     }
 
+    client->command_queue->pool = client->command_pool;
+
     next_client_internal_verify_sentinels( client );
 
-    client->notify_queue = next_queue_create( context, NEXT_NOTIFY_QUEUE_LENGTH );
+    client->notify_queue = next_queue_create( context, next_global_config.notify_queue_length );
     if ( !client->notify_queue )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "client could not create client notify queue" );
@@ -408,6 +680,20 @@ next_client_internal_t * next_client_internal_create( void * context, const char
         return NULL;
     }
 
+    client->notify_queue->pool = client->notify_pool;
+
+    next_client_internal_verify_sentinels( client );
+
+    client->payload_queue = next_queue_create( context, next_global_config.notify_queue_length );
+    if ( !client->payload_queue )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "client could not create client payload queue" );
+        next_client_internal_destroy( client );
+        return NULL;
+    }
+
+    client->payload_queue->pool = client->notify_pool;
+
     next_client_internal_verify_sentinels( client );
 
     // IMPORTANT: for many platforms it's best practice to bind to ipv6 and go dual stack on the client
@@ -438,6 +724,16 @@ next_client_internal_t * next_client_internal_create( void * context, const char
         return NULL;
     }
 
+    if ( next_global_config.io_uring && next_platform_socket_io_uring( client->socket ) != NEXT_OK )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "client io_uring is not available. using regular socket calls" );
+    }
+
+    if ( next_global_config.client_busy_poll_microseconds > 0 && next_platform_socket_busy_poll( client->socket, next_global_config.client_busy_poll_microseconds ) != NEXT_OK )
+    {
+        next_printf( NEXT_LOG_LEVEL_WARN, "client busy poll is not supported on this platform" );
+    }
+
     char address_string[NEXT_MAX_ADDRESS_STRING_LENGTH];
     next_printf( NEXT_LOG_LEVEL_INFO, "client bound to %s", next_address_to_string( &bind_address, address_string ) );
     client->bound_port = bind_address.port;
@@ -482,22 +778,6 @@ next_client_internal_t * next_client_internal_create( void * context, const char
         return NULL;
     }
 
-    result = next_platform_mutex_create( &client->direct_bandwidth_mutex );
-    if ( result != NEXT_OK )
-    {
-        next_printf( NEXT_LOG_LEVEL_ERROR, "client could not create direct bandwidth mutex" );
-        next_client_internal_destroy( client );
-        return NULL;
-    }
-
-    result = next_platform_mutex_create( &client->next_bandwidth_mutex );
-    if ( result != NEXT_OK )
-    {
-        next_printf( NEXT_LOG_LEVEL_ERROR, "client could not create next bandwidth mutex" );
-        next_client_internal_destroy( client );
-        return NULL;
-    }
-
     next_ping_history_clear( &client->next_ping_history );
     next_ping_history_clear( &client->direct_ping_history );
 
@@ -508,6 +788,13 @@ next_client_internal_t * next_client_internal_create( void * context, const char
     next_packet_loss_tracker_reset( &client->packet_loss_tracker );
     next_out_of_order_tracker_reset( &client->out_of_order_tracker );
     next_jitter_tracker_reset( &client->jitter_tracker );
+    next_adaptive_multipath_reset( &client->adaptive_multipath );
+    next_fec_decoder_reset( &client->fec_decoder );
+    next_bandwidth_limiter_reset( &client->fec_receive_bandwidth );
+
+    client->multipath_duplicate.store( false, std::memory_order_relaxed );
+    client->multipath_prefer_direct.store( false, std::memory_order_relaxed );
+    client->fec_bandwidth_usage_kbps_up.store( 0.0f, std::memory_order_relaxed );
 
     next_client_internal_verify_sentinels( client );
 
@@ -533,6 +820,10 @@ void next_client_internal_destroy( next_client_internal_t * client )
     {
         next_queue_destroy( client->notify_queue );
     }
+    if ( client->payload_queue )
+    {
+        next_queue_destroy( client->payload_queue );
+    }
     if ( client->client_relay_manager )
     {
         next_relay_manager_destroy( client->client_relay_manager );
@@ -541,12 +832,22 @@ void next_client_internal_destroy( next_client_internal_t * client )
     {
         next_route_manager_destroy( client->route_manager );
     }
+    if ( client->notify_pool )
+    {
+        next_pool_destroy( client->notify_pool );
+    }
+    if ( client->command_pool )
+    {
+        next_pool_destroy( client->command_pool );
+    }
+    if ( client->arena )
+    {
+        next_arena_destroy( client->arena );
+    }
 
     next_platform_mutex_destroy( &client->command_mutex );
     next_platform_mutex_destroy( &client->notify_mutex );
     next_platform_mutex_destroy( &client->route_manager_mutex );
-    next_platform_mutex_destroy( &client->direct_bandwidth_mutex );
-    next_platform_mutex_destroy( &client->next_bandwidth_mutex );
 
     next_clear_and_free( client->context, client, sizeof(next_client_internal_t) );
 }
@@ -583,19 +884,11 @@ int next_client_internal_send_packet_to_server( next_client_internal_t * client,
     next_assert( next_basic_packet_filter( buffer, sizeof(buffer) ) );
     next_assert( next_advanced_packet_filter( buffer, client->current_magic, from_address_data, to_address_data, packet_bytes ) );
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double send_start_time = next_platform_time();
 
     next_platform_socket_send_packet( client->socket, &client->server_address, buffer, packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-    double finish_time = next_platform_time();
-    if ( finish_time - start_time > 0.001 )
-    {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-    }
-#endif // #if NEXT_SPIKE_TRACKING
+    next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
 
     return NEXT_OK;
 }
@@ -735,6 +1028,8 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
         memcpy( client->previous_magic, packet.previous_magic, 8 );
 
         client->client_external_address = packet.client_address;
+        client->payload_coalescing = packet.payload_coalescing && next_global_config.payload_coalescing;
+        client->fec = packet.fec && next_global_config.fec_group_size > 0;
 
         char address_buffer[256];
         next_printf( NEXT_LOG_LEVEL_DEBUG, "client external address is %s", next_address_to_string( &client->client_external_address, address_buffer ) );
@@ -749,6 +1044,9 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
 
         response.connection_type = next_platform_connection_type();
 
+        response.payload_coalescing = next_global_config.payload_coalescing;
+        response.fec = next_global_config.fec_group_size > 0;
+
         if ( next_client_internal_send_packet_to_server( client, NEXT_UPGRADE_RESPONSE_PACKET, &response ) != NEXT_OK )
         {
             next_printf( NEXT_LOG_LEVEL_WARN, "client failed to send upgrade response packet to server" );
@@ -861,18 +1159,20 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
         memcpy( client->client_send_key, client_send_key, NEXT_CRYPTO_KX_SESSIONKEYBYTES );
         memcpy( client->client_receive_key, client_receive_key, NEXT_CRYPTO_KX_SESSIONKEYBYTES );
 
-        next_client_notify_upgraded_t * notify = (next_client_notify_upgraded_t*) next_malloc( client->context, sizeof(next_client_notify_upgraded_t) );
+        next_client_notify_upgraded_t * notify = (next_client_notify_upgraded_t*) next_pool_alloc( client->notify_pool, client->context, sizeof( next_client_notify_upgraded_t ) );
         next_assert( notify );
         notify->type = NEXT_CLIENT_NOTIFY_UPGRADED;
         notify->session_id = client->session_id;
         notify->client_external_address = client->client_external_address;
         memcpy( notify->current_magic, client->current_magic, 8 );
+        notify->payload_coalescing = client->payload_coalescing;
+        notify->fec = client->fec;
         {
 #if NEXT_SPIKE_TRACKING
             next_printf( NEXT_LOG_LEVEL_SPAM, "client internal thread queues up NEXT_CLIENT_NOTIFY_UPGRADED at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-            next_platform_mutex_guard( &client->notify_mutex );
-            next_queue_push( client->notify_queue, notify );
+            next_client_mutex_guard( &client->notify_mutex );
+            next_client_internal_queue_notify( client, notify );
         }
 
         client->counters[NEXT_CLIENT_COUNTER_UPGRADE_SESSION]++;
@@ -930,20 +1230,10 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
             next_jitter_tracker_packet_received( &client->jitter_tracker, packet_sequence, packet_receive_time );
         }
 
-        next_client_notify_packet_received_t * notify = (next_client_notify_packet_received_t*) next_malloc( client->context, sizeof( next_client_notify_packet_received_t ) );
-        notify->type = NEXT_CLIENT_NOTIFY_PACKET_RECEIVED;
-        notify->direct = true;
-        notify->already_received = already_received;
-        notify->payload_bytes = packet_bytes - 9;
-        next_assert( notify->payload_bytes > 0 );
-        memcpy( notify->payload_data, packet_data + 9, size_t(notify->payload_bytes) );
-        {
-#if NEXT_SPIKE_TRACKING
-            next_printf( NEXT_LOG_LEVEL_SPAM, "client internal thread queues up NEXT_CLIENT_NOTIFY_PACKET_RECEIVED at %s:%d", __FILE__, __LINE__ );
-#endif // #if NEXT_SPIKE_TRACKING
-            next_platform_mutex_guard( &client->notify_mutex );
-            next_queue_push( client->notify_queue, notify );
-        }
+        next_assert( packet_bytes - 9 > 0 );
+
+        next_client_internal_payload_received( client, true, already_received, packet_sequence, packet_data + 9, packet_bytes - 9 );
+
         client->counters[NEXT_CLIENT_COUNTER_PACKET_RECEIVED_DIRECT]++;
 
         return;
@@ -1020,7 +1310,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
         uint8_t pending_route_session_version;
         uint8_t pending_route_private_key[NEXT_CRYPTO_BOX_SECRETKEYBYTES];
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             next_route_manager_get_pending_route_data( client->route_manager, &fallback_to_direct, &pending_route, &pending_route_session_id, &pending_route_session_version, &pending_route_private_key[0] );
         }
 
@@ -1046,7 +1336,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
             return;
         }
 
-        next_platform_mutex_guard( &client->route_manager_mutex );
+        next_client_mutex_guard( &client->route_manager_mutex );
 
         next_replay_protection_t * replay_protection = &client->special_replay_protection;
 
@@ -1080,11 +1370,8 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
         next_printf( NEXT_LOG_LEVEL_DEBUG, "client network next route is confirmed" );
 
         client->last_route_switch_time = next_platform_time();
-        {
-            next_platform_mutex_guard( &client->next_bandwidth_mutex );
-            client->next_bandwidth_envelope_kbps_up = route_kbps_up;
-            client->next_bandwidth_envelope_kbps_down = route_kbps_down;
-        }
+        client->next_bandwidth_envelope_kbps_up.store( float( route_kbps_up ), std::memory_order_relaxed );
+        client->next_bandwidth_envelope_kbps_down.store( float( route_kbps_down ), std::memory_order_relaxed );
 
         return;
     }
@@ -1111,7 +1398,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
         uint8_t current_route_session_version;
         uint8_t current_route_private_key[NEXT_CRYPTO_BOX_SECRETKEYBYTES];
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             next_route_manager_get_current_route_data( client->route_manager, &fallback_to_direct, &current_route, &pending_continue, &current_route_session_id, &current_route_session_version, &current_route_private_key[0] );
         }
 
@@ -1167,7 +1454,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
 
         next_printf( NEXT_LOG_LEVEL_DEBUG, "client received continue response from relay" );
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             next_route_manager_confirm_continue_route( client->route_manager );
         }
 
@@ -1189,7 +1476,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
 
         bool result = false;
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             result = next_route_manager_process_server_to_client_packet( client->route_manager, packet_id, packet_data, packet_bytes, &payload_sequence );
         }
 
@@ -1209,22 +1496,10 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
 
             next_out_of_order_tracker_packet_received( &client->out_of_order_tracker, payload_sequence );
 
-            next_jitter_tracker_packet_received( &client->jitter_tracker, payload_sequence, next_platform_time() );
+            next_jitter_tracker_packet_received( &client->jitter_tracker, payload_sequence, packet_receive_time );
         }
 
-        next_client_notify_packet_received_t * notify = (next_client_notify_packet_received_t*) next_malloc( client->context, sizeof( next_client_notify_packet_received_t ) );
-        notify->type = NEXT_CLIENT_NOTIFY_PACKET_RECEIVED;
-        notify->direct = false;
-        notify->already_received = already_received;
-        notify->payload_bytes = packet_bytes - NEXT_HEADER_BYTES;
-        memcpy( notify->payload_data, packet_data + NEXT_HEADER_BYTES, size_t(packet_bytes) - NEXT_HEADER_BYTES );
-        {
-#if NEXT_SPIKE_TRACKING
-            next_printf( NEXT_LOG_LEVEL_SPAM, "client internal thread queues up NEXT_CLIENT_NOTIFY_PACKET_RECEIVED at %s:%d", __FILE__, __LINE__ );
-#endif // #if NEXT_SPIKE_TRACKING
-            next_platform_mutex_guard( &client->notify_mutex );
-            next_queue_push( client->notify_queue, notify );
-        }
+        next_client_internal_payload_received( client, false, already_received, payload_sequence, packet_data + NEXT_HEADER_BYTES, packet_bytes - NEXT_HEADER_BYTES );
 
         client->counters[NEXT_CLIENT_COUNTER_PACKET_RECEIVED_NEXT]++;
 
@@ -1244,7 +1519,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
 
         bool result = false;
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             result = next_route_manager_process_server_to_client_packet( client->route_manager, packet_id, packet_data, packet_bytes, &payload_sequence );
         }
 
@@ -1263,7 +1538,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
 
         uint64_t ping_sequence = next_read_uint64( &p );
 
-        next_ping_history_pong_received( &client->next_ping_history, ping_sequence, next_platform_time() );
+        next_ping_history_pong_received( &client->next_ping_history, ping_sequence, packet_receive_time );
 
         client->last_next_pong_time = next_platform_time();
 
@@ -1307,7 +1582,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
             return;
         }
 
-        next_relay_manager_process_pong( client->client_relay_manager, from, ping_sequence );
+        next_relay_manager_process_pong( client->client_relay_manager, from, ping_sequence, packet_receive_time );
 
         return;
     }
@@ -1341,7 +1616,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
             return;
         }
 
-        next_ping_history_pong_received( &client->direct_ping_history, packet.ping_sequence, next_platform_time() );
+        next_ping_history_pong_received( &client->direct_ping_history, packet.ping_sequence, packet_receive_time );
 
         next_post_validate_packet( NEXT_DIRECT_PONG_PACKET, next_encrypted_packets, &packet_sequence, &client->internal_replay_protection );
 
@@ -1390,7 +1665,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
             next_printf( NEXT_LOG_LEVEL_DEBUG, "client received route update packet from server" );
 
             {
-                next_platform_mutex_guard( &client->route_manager_mutex );
+                next_client_mutex_guard( &client->route_manager_mutex );
                 next_route_manager_update( client->route_manager, packet.update_type, packet.num_tokens, packet.tokens, client->client_secret_key, client->current_magic, &client->client_external_address );
                 fallback_to_direct = next_route_manager_get_fallback_to_direct( client->route_manager );
             }
@@ -1454,7 +1729,7 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
                     memcpy( client->current_magic, packet.current_magic, 8 );
                     memcpy( client->previous_magic, packet.previous_magic, 8 );
 
-                    next_client_notify_magic_updated_t * notify = (next_client_notify_magic_updated_t*) next_malloc( client->context, sizeof(next_client_notify_magic_updated_t) );
+                    next_client_notify_magic_updated_t * notify = (next_client_notify_magic_updated_t*) next_pool_alloc( client->notify_pool, client->context, sizeof( next_client_notify_magic_updated_t ) );
                     next_assert( notify );
                     notify->type = NEXT_CLIENT_NOTIFY_MAGIC_UPDATED;
                     memcpy( notify->current_magic, client->current_magic, 8 );
@@ -1462,8 +1737,8 @@ void next_client_internal_process_network_next_packet( next_client_internal_t *
 #if NEXT_SPIKE_TRACKING
                         next_printf( NEXT_LOG_LEVEL_SPAM, "client internal thread queues up NEXT_CLIENT_NOTIFY_MAGIC_UPDATED at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-                        next_platform_mutex_guard( &client->notify_mutex );
-                        next_queue_push( client->notify_queue, notify );
+                        next_client_mutex_guard( &client->notify_mutex );
+                        next_client_internal_queue_notify( client, notify );
                     }
                 }
             }
@@ -1506,21 +1781,7 @@ void next_client_internal_process_passthrough_packet( next_client_internal_t * c
 
     if ( packet_bytes <= NEXT_MAX_PACKET_BYTES - 1 && from_server_address )
     {
-        next_client_notify_packet_received_t * notify = (next_client_notify_packet_received_t*) next_malloc( client->context, sizeof( next_client_notify_packet_received_t ) );
-        notify->type = NEXT_CLIENT_NOTIFY_PACKET_RECEIVED;
-        notify->direct = true;
-        notify->payload_bytes = packet_bytes;
-        notify->already_received = false;
-        next_assert( notify->payload_bytes >= 0 );
-        next_assert( notify->payload_bytes <= NEXT_MAX_PACKET_BYTES - 1 );
-        memcpy( notify->payload_data, packet_data, size_t(packet_bytes) );
-        {
-#if NEXT_SPIKE_TRACKING
-            next_printf( NEXT_LOG_LEVEL_SPAM, "client internal thread queues up NEXT_CLIENT_NOTIFY_PACKET_RECEIVED at %s:%d", __FILE__, __LINE__ );
-#endif // #if NEXT_SPIKE_TRACKING
-            next_platform_mutex_guard( &client->notify_mutex );
-            next_queue_push( client->notify_queue, notify );
-        }
+        next_client_internal_packet_received( client, true, false, false, packet_data, packet_bytes );
         client->counters[NEXT_CLIENT_COUNTER_PACKET_RECEIVED_PASSTHROUGH]++;
     }
 }
@@ -1543,14 +1804,16 @@ void next_client_internal_block_and_receive_packet( next_client_internal_t * cli
     next_printf( NEXT_LOG_LEVEL_SPAM, "client calls next_platform_socket_receive_packet on internal thread" );
 #endif // #if NEXT_SPIKE_TRACKING
 
-    int packet_bytes = next_platform_socket_receive_packet( client->socket, &from, packet_data, NEXT_MAX_PACKET_BYTES );
+    double packet_receive_time = next_platform_time();
+
+    int packet_bytes = next_platform_socket_receive_packet_with_timestamp( client->socket, &from, packet_data, NEXT_MAX_PACKET_BYTES, &packet_receive_time );
 
 #if NEXT_SPIKE_TRACKING
     char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
     next_printf( NEXT_LOG_LEVEL_SPAM, "client next_platform_socket_receive_packet returns with a %d byte packet from %s", packet_bytes, next_address_to_string( &from, address_buffer ) );
 #endif // #if NEXT_SPIKE_TRACKING
 
-    double packet_receive_time = next_platform_time();
+    client->receive_time = packet_receive_time;
 
     next_assert( packet_bytes >= 0 );
 
@@ -1586,7 +1849,7 @@ bool next_client_internal_pump_commands( next_client_internal_t * client )
     {
         void * entry = NULL;
         {
-            next_platform_mutex_guard( &client->command_mutex );
+            next_client_mutex_guard( &client->command_mutex );
             entry = next_queue_pop( client->command_queue );
         }
 
@@ -1617,21 +1880,21 @@ bool next_client_internal_pump_commands( next_client_internal_t * client )
                 next_printf( NEXT_LOG_LEVEL_INFO, "client opened session to %s", next_address_to_string( &open_session_command->server_address, buffer ) );
                 client->counters[NEXT_CLIENT_COUNTER_OPEN_SESSION]++;
                 {
-                    next_platform_mutex_guard( &client->route_manager_mutex );
+                    next_client_mutex_guard( &client->route_manager_mutex );
                     next_route_manager_reset( client->route_manager );
                     next_route_manager_direct_route( client->route_manager, true );
                 }
 
                 // IMPORTANT: Fire back ready when the client is ready to start sending packets and we're all dialed in for this session
-                next_client_notify_ready_t * notify = (next_client_notify_ready_t*) next_malloc( client->context, sizeof(next_client_notify_ready_t) );
+                next_client_notify_ready_t * notify = (next_client_notify_ready_t*) next_pool_alloc( client->notify_pool, client->context, sizeof( next_client_notify_ready_t ) );
                 next_assert( notify );
                 notify->type = NEXT_CLIENT_NOTIFY_READY;
                 {
 #if NEXT_SPIKE_TRACKING
                     next_printf( NEXT_LOG_LEVEL_SPAM, "client internal thread queues up NEXT_CLIENT_NOTIFY_READY at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-                    next_platform_mutex_guard( &client->notify_mutex );
-                    next_queue_push( client->notify_queue, notify );
+                    next_client_mutex_guard( &client->notify_mutex );
+                    next_client_internal_queue_notify( client, notify );
                 }
             }
             break;
@@ -1659,6 +1922,8 @@ bool next_client_internal_pump_commands( next_client_internal_t * client )
                 client->reported = false;
                 client->fallback_to_direct = false;
                 client->multipath = false;
+                client->payload_coalescing = false;
+                client->fec = false;
                 client->upgrade_sequence = 0;
                 client->session_id = 0;
                 client->internal_send_sequence = 0;
@@ -1697,29 +1962,33 @@ bool next_client_internal_pump_commands( next_client_internal_t * client )
                 next_replay_protection_reset( &client->special_replay_protection );
                 next_replay_protection_reset( &client->internal_replay_protection );
 
-                {
-                    next_platform_mutex_guard( &client->direct_bandwidth_mutex );
-                    client->direct_bandwidth_usage_kbps_up = 0;
-                    client->direct_bandwidth_usage_kbps_down = 0;
-                }
+                client->direct_bandwidth_usage_kbps_up.store( 0.0f, std::memory_order_relaxed );
+                client->direct_bandwidth_usage_kbps_down.store( 0.0f, std::memory_order_relaxed );
 
-                {
-                    next_platform_mutex_guard( &client->next_bandwidth_mutex );
-                    client->next_bandwidth_over_limit = false;
-                    client->next_bandwidth_usage_kbps_up = 0;
-                    client->next_bandwidth_usage_kbps_down = 0;
-                    client->next_bandwidth_envelope_kbps_up = 0;
-                    client->next_bandwidth_envelope_kbps_down = 0;
-                }
+                next_bandwidth_limiter_reset( &client->immediate_direct_receive_bandwidth );
+                next_bandwidth_limiter_reset( &client->immediate_next_receive_bandwidth );
+
+                client->next_bandwidth_over_limit.store( false, std::memory_order_relaxed );
+                client->next_bandwidth_usage_kbps_up.store( 0.0f, std::memory_order_relaxed );
+                client->next_bandwidth_usage_kbps_down.store( 0.0f, std::memory_order_relaxed );
+                client->next_bandwidth_envelope_kbps_up.store( 0.0f, std::memory_order_relaxed );
+                client->next_bandwidth_envelope_kbps_down.store( 0.0f, std::memory_order_relaxed );
 
                 {
-                    next_platform_mutex_guard( &client->route_manager_mutex );
+                    next_client_mutex_guard( &client->route_manager_mutex );
                     next_route_manager_reset( client->route_manager );
                 }
 
                 next_packet_loss_tracker_reset( &client->packet_loss_tracker );
                 next_out_of_order_tracker_reset( &client->out_of_order_tracker );
                 next_jitter_tracker_reset( &client->jitter_tracker );
+                next_adaptive_multipath_reset( &client->adaptive_multipath );
+                next_fec_decoder_reset( &client->fec_decoder );
+                next_bandwidth_limiter_reset( &client->fec_receive_bandwidth );
+
+                client->multipath_duplicate.store( false, std::memory_order_relaxed );
+                client->multipath_prefer_direct.store( false, std::memory_order_relaxed );
+                client->fec_bandwidth_usage_kbps_up.store( 0.0f, std::memory_order_relaxed );
 
                 client->counters[NEXT_CLIENT_COUNTER_CLOSE_SESSION]++;
             }
@@ -1750,7 +2019,7 @@ bool next_client_internal_pump_commands( next_client_internal_t * client )
             default: break;
         }
 
-        next_free( client->context, command );
+        next_pool_free( client->command_pool, client->context, command );
     }
 
     return quit;
@@ -1777,7 +2046,7 @@ void next_client_internal_update_stats( next_client_internal_t * client )
         bool network_next = false;
         bool fallback_to_direct = false;
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             network_next = next_route_manager_has_network_next_route( client->route_manager );
             fallback_to_direct = next_route_manager_get_fallback_to_direct( client->route_manager );
         }
@@ -1803,22 +2072,16 @@ void next_client_internal_update_stats( next_client_internal_t * client )
         next_route_stats_t direct_route_stats;
         next_route_stats_from_ping_history( &client->direct_ping_history, current_time - NEXT_PING_STATS_WINDOW, current_time, &direct_route_stats );
 
-        {
-            next_platform_mutex_guard( &client->direct_bandwidth_mutex );
-            client->client_stats.direct_kbps_up = client->direct_bandwidth_usage_kbps_up;
-            client->client_stats.direct_kbps_down = client->direct_bandwidth_usage_kbps_down;
-        }
+        client->client_stats.direct_kbps_up = client->direct_bandwidth_usage_kbps_up.load( std::memory_order_relaxed );
+        client->client_stats.direct_kbps_down = client->direct_bandwidth_usage_kbps_down.load( std::memory_order_relaxed );
 
         if ( network_next )
         {
             client->client_stats.next_rtt = next_route_stats.rtt;
             client->client_stats.next_jitter = next_route_stats.jitter;
             client->client_stats.next_packet_loss = next_route_stats.packet_loss;
-            {
-                next_platform_mutex_guard( &client->next_bandwidth_mutex );
-                client->client_stats.next_kbps_up = client->next_bandwidth_usage_kbps_up;
-                client->client_stats.next_kbps_down = client->next_bandwidth_usage_kbps_down;
-            }
+            client->client_stats.next_kbps_up = client->next_bandwidth_usage_kbps_up.load( std::memory_order_relaxed );
+            client->client_stats.next_kbps_down = client->next_bandwidth_usage_kbps_down.load( std::memory_order_relaxed );
         }
         else
         {
@@ -1843,7 +2106,7 @@ void next_client_internal_update_stats( next_client_internal_t * client )
         {
             next_printf( NEXT_LOG_LEVEL_ERROR, "client fakes fallback to direct" );
             {
-                next_platform_mutex_guard( &client->route_manager_mutex );
+                next_client_mutex_guard( &client->route_manager_mutex );
                 next_route_manager_fallback_to_direct( client->route_manager, NEXT_FLAGS_ROUTE_UPDATE_TIMED_OUT );
             }
         }
@@ -1853,9 +2116,21 @@ void next_client_internal_update_stats( next_client_internal_t * client )
         client->client_stats.next_packet_loss += next_fake_next_packet_loss;
  #endif // #if NEXT_DEVELOPMENT
 
+        int payload_packets_lost = 0;
+        int payload_packets_expected = 0;
+
         if ( !fallback_to_direct )
         {
+            const uint64_t last_packet_processed = client->packet_loss_tracker.last_packet_processed;
+
             const int packets_lost = next_packet_loss_tracker_update( &client->packet_loss_tracker );
+
+            if ( client->packet_loss_tracker.last_packet_processed > last_packet_processed )
+            {
+                payload_packets_lost = packets_lost;
+                payload_packets_expected = int( client->packet_loss_tracker.last_packet_processed - last_packet_processed );
+            }
+
             client->client_stats.packets_lost_server_to_client += packets_lost;
             client->counters[NEXT_CLIENT_COUNTER_PACKETS_LOST_SERVER_TO_CLIENT] += packets_lost;
 
@@ -1865,9 +2140,31 @@ void next_client_internal_update_stats( next_client_internal_t * client )
             client->client_stats.jitter_server_to_client = float( client->jitter_tracker.jitter * 1000.0 );
         }
 
+        if ( client->multipath && network_next && next_global_config.adaptive_multipath )
+        {
+            next_adaptive_multipath_sample_t sample;
+            sample.next_route_stats = next_route_stats;
+            sample.direct_route_stats = direct_route_stats;
+            sample.payload_packets_lost = payload_packets_lost;
+            sample.payload_packets_expected = payload_packets_expected;
+            sample.payload_jitter = float( client->jitter_tracker.jitter * 1000.0 );
+
+            if ( next_adaptive_multipath_update( &client->adaptive_multipath, current_time, &sample ) )
+            {
+                next_printf( NEXT_LOG_LEVEL_DEBUG, "client started duplicating packets across direct and network next" );
+                client->counters[NEXT_CLIENT_COUNTER_MULTIPATH_DUPLICATE_STARTED]++;
+            }
+
+            client->multipath_duplicate.store( client->adaptive_multipath.duplicate, std::memory_order_relaxed );
+            client->multipath_prefer_direct.store( client->adaptive_multipath.prefer_direct, std::memory_order_relaxed );
+        }
+
         client->client_stats.packets_sent_client_to_server = client->packets_sent;
 
-        next_client_notify_stats_updated_t * notify = (next_client_notify_stats_updated_t*) next_malloc( client->context, sizeof( next_client_notify_stats_updated_t ) );
+        client->client_stats.fec_kbps_up = client->fec_bandwidth_usage_kbps_up.load( std::memory_order_relaxed );
+        client->client_stats.fec_kbps_down = float( next_bandwidth_limiter_usage_kbps( &client->fec_receive_bandwidth ) );
+
+        next_client_notify_stats_updated_t * notify = (next_client_notify_stats_updated_t*) next_pool_alloc( client->notify_pool, client->context, sizeof( next_client_notify_stats_updated_t ) );
         notify->type = NEXT_CLIENT_NOTIFY_STATS_UPDATED;
         notify->stats = client->client_stats;
         notify->fallback_to_direct = fallback_to_direct;
@@ -1875,8 +2172,8 @@ void next_client_internal_update_stats( next_client_internal_t * client )
 #if NEXT_SPIKE_TRACKING
             next_printf( NEXT_LOG_LEVEL_SPAM, "client internal thread queues up NEXT_CLIENT_NOTIFY_STATS_UPDATED at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-            next_platform_mutex_guard( &client->notify_mutex );
-            next_queue_push( client->notify_queue, notify );
+            next_client_mutex_guard( &client->notify_mutex );
+            next_client_internal_queue_notify( client, notify );
         }
 
         client->last_stats_update_time = current_time;
@@ -1892,19 +2189,12 @@ void next_client_internal_update_stats( next_client_internal_t * client )
         packet.platform_id = client->client_stats.platform_id;
         packet.connection_type = client->client_stats.connection_type;
 
-        {
-            next_platform_mutex_guard( &client->direct_bandwidth_mutex );
-            packet.direct_kbps_up = (int) ceil( client->direct_bandwidth_usage_kbps_up );
-            packet.direct_kbps_down = (int) ceil( client->direct_bandwidth_usage_kbps_down );
-        }
+        packet.direct_kbps_up = (int) ceil( client->direct_bandwidth_usage_kbps_up.load( std::memory_order_relaxed ) );
+        packet.direct_kbps_down = (int) ceil( client->direct_bandwidth_usage_kbps_down.load( std::memory_order_relaxed ) );
 
-        {
-            next_platform_mutex_guard( &client->next_bandwidth_mutex );
-            packet.next_bandwidth_over_limit = client->next_bandwidth_over_limit;
-            packet.next_kbps_up = (int) ceil( client->next_bandwidth_usage_kbps_up );
-            packet.next_kbps_down = (int) ceil( client->next_bandwidth_usage_kbps_down );
-            client->next_bandwidth_over_limit = false;
-        }
+        packet.next_bandwidth_over_limit = client->next_bandwidth_over_limit.exchange( false, std::memory_order_relaxed );
+        packet.next_kbps_up = (int) ceil( client->next_bandwidth_usage_kbps_up.load( std::memory_order_relaxed ) );
+        packet.next_kbps_down = (int) ceil( client->next_bandwidth_usage_kbps_down.load( std::memory_order_relaxed ) );
 
         if ( !client->client_stats.next )
         {
@@ -1971,7 +2261,7 @@ void next_client_internal_update_direct_pings( next_client_internal_t * client )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "client direct pong timed out. falling back to direct" );
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             next_route_manager_fallback_to_direct( client->route_manager, NEXT_FLAGS_DIRECT_PONG_TIMED_OUT );
         }
         return;
@@ -2008,7 +2298,7 @@ void next_client_internal_update_next_pings( next_client_internal_t * client )
 
     bool has_next_route = false;
     {
-        next_platform_mutex_guard( &client->route_manager_mutex );
+        next_client_mutex_guard( &client->route_manager_mutex );
         has_next_route = next_route_manager_has_network_next_route( client->route_manager );
     }
 
@@ -2021,7 +2311,7 @@ void next_client_internal_update_next_pings( next_client_internal_t * client )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "client next pong timed out. falling back to direct" );
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             next_route_manager_fallback_to_direct( client->route_manager, NEXT_FLAGS_NEXT_PONG_TIMED_OUT );
         }
         return;
@@ -2037,7 +2327,7 @@ void next_client_internal_update_next_pings( next_client_internal_t * client )
         next_address_t to;
         uint8_t private_key[NEXT_CRYPTO_BOX_SECRETKEYBYTES];
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             next_route_manager_get_next_route_data( client->route_manager, &session_id, &session_version, &to, private_key );
         }
 
@@ -2060,19 +2350,11 @@ void next_client_internal_update_next_pings( next_client_internal_t * client )
         next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
         next_assert( next_advanced_packet_filter( packet_data, client->current_magic, from_address_data, to_address_data, packet_bytes ) );
 
-#if NEXT_SPIKE_TRACKING
-        double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+        const double send_start_time = next_platform_time();
 
         next_platform_socket_send_packet( client->socket, &to, packet_data, packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-        double finish_time = next_platform_time();
-        if ( finish_time - start_time > 0.001 )
-        {
-            next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-        }
-#endif // #if NEXT_SPIKE_TRACKING
+        next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
 
         client->last_next_ping_time = current_time;
     }
@@ -2159,7 +2441,7 @@ void next_client_internal_update_fallback_to_direct( next_client_internal_t * cl
 
     bool fallback_to_direct = false;
     {
-        next_platform_mutex_guard( &client->route_manager_mutex );
+        next_client_mutex_guard( &client->route_manager_mutex );
         if ( client->upgraded )
         {
             next_route_manager_check_for_timeouts( client->route_manager );
@@ -2180,7 +2462,7 @@ void next_client_internal_update_fallback_to_direct( next_client_internal_t * cl
         {
             next_printf( NEXT_LOG_LEVEL_ERROR, "client route update timeout. falling back to direct" );
             {
-                next_platform_mutex_guard( &client->route_manager_mutex );
+                next_client_mutex_guard( &client->route_manager_mutex );
                 next_route_manager_fallback_to_direct( client->route_manager, NEXT_FLAGS_ROUTE_UPDATE_TIMED_OUT );
             }
             client->counters[NEXT_CLIENT_COUNTER_FALLBACK_TO_DIRECT]++;
@@ -2213,7 +2495,7 @@ void next_client_internal_update_route_manager( next_client_internal_t * client
     bool send_route_request = false;
     bool send_continue_request = false;
     {
-        next_platform_mutex_guard( &client->route_manager_mutex );
+        next_client_mutex_guard( &client->route_manager_mutex );
         send_route_request = next_route_manager_send_route_request( client->route_manager, &route_request_to, route_request_packet_data, &route_request_packet_bytes );
         send_continue_request = next_route_manager_send_continue_request( client->route_manager, &continue_request_to, continue_request_packet_data, &continue_request_packet_bytes );
     }
@@ -2223,19 +2505,11 @@ void next_client_internal_update_route_manager( next_client_internal_t * client
         char buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
         next_printf( NEXT_LOG_LEVEL_DEBUG, "client sent route request to relay: %s", next_address_to_string( &route_request_to, buffer ) );
 
-#if NEXT_SPIKE_TRACKING
-        double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+        const double send_start_time = next_platform_time();
 
         next_platform_socket_send_packet( client->socket, &route_request_to, route_request_packet_data, route_request_packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-        double finish_time = next_platform_time();
-        if ( finish_time - start_time > 0.001 )
-        {
-            next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-        }
-#endif // #if NEXT_SPIKE_TRACKING
+        next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
     }
 
     if ( send_continue_request )
@@ -2243,19 +2517,11 @@ void next_client_internal_update_route_manager( next_client_internal_t * client
         char buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
         next_printf( NEXT_LOG_LEVEL_DEBUG, "client sent continue request to relay: %s", next_address_to_string( &continue_request_to, buffer ) );
 
-#if NEXT_SPIKE_TRACKING
-        double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+        const double send_start_time = next_platform_time();
 
         next_platform_socket_send_packet( client->socket, &continue_request_to, continue_request_packet_data, continue_request_packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-        double finish_time = next_platform_time();
-        if ( finish_time - start_time > 0.001 )
-        {
-            next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-        }
-#endif // #if NEXT_SPIKE_TRACKING
+        next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
     }
 }
 
@@ -2278,19 +2544,11 @@ void next_client_internal_update_upgrade_response( next_client_internal_t * clie
 
     next_assert( client->upgrade_response_packet_bytes > 0 );
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double send_start_time = next_platform_time();
 
     next_platform_socket_send_packet( client->socket, &client->server_address, client->upgrade_response_packet_data, client->upgrade_response_packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-    double finish_time = next_platform_time();
-    if ( finish_time - start_time > 0.001 )
-    {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-    }
-#endif // #if NEXT_SPIKE_TRACKING
+    next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
 
     next_printf( NEXT_LOG_LEVEL_DEBUG, "client sent cached upgrade response packet to server" );
 
@@ -2300,46 +2558,58 @@ void next_client_internal_update_upgrade_response( next_client_internal_t * clie
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "upgrade response timed out" );
         {
-            next_platform_mutex_guard( &client->route_manager_mutex );
+            next_client_mutex_guard( &client->route_manager_mutex );
             next_route_manager_fallback_to_direct( client->route_manager, NEXT_FLAGS_UPGRADE_RESPONSE_TIMED_OUT );
         }
         client->fallback_to_direct = true;
     }
 }
 
+static double next_client_internal_record_stage( next_client_internal_t * client, int metric, double stage_start_time )
+{
+    const double stage_finish_time = next_platform_time();
+    next_latency_histogram_record( &client->latency[metric], stage_finish_time - stage_start_time );
+    return stage_finish_time;
+}
+
 void next_client_internal_update( next_client_internal_t * client )
 {
     if ( next_global_config.disable_network_next )
         return;
-  
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+
+    const double start_time = next_platform_time();
+
+    double stage_start_time = start_time;
 
     next_client_internal_update_direct_pings( client );
 
+    stage_start_time = next_client_internal_record_stage( client, NEXT_CLIENT_METRIC_UPDATE_DIRECT_PINGS, stage_start_time );
+
     next_client_internal_update_next_pings( client );
 
+    stage_start_time = next_client_internal_record_stage( client, NEXT_CLIENT_METRIC_UPDATE_NEXT_PINGS, stage_start_time );
+
     next_client_internal_update_client_relays( client );
 
+    stage_start_time = next_client_internal_record_stage( client, NEXT_CLIENT_METRIC_UPDATE_CLIENT_RELAYS, stage_start_time );
+
     next_client_internal_update_stats( client );
 
+    stage_start_time = next_client_internal_record_stage( client, NEXT_CLIENT_METRIC_UPDATE_STATS, stage_start_time );
+
     next_client_internal_update_fallback_to_direct( client );
 
-    next_client_internal_update_route_manager( client );
+    stage_start_time = next_client_internal_record_stage( client, NEXT_CLIENT_METRIC_UPDATE_FALLBACK_TO_DIRECT, stage_start_time );
 
-    next_client_internal_update_upgrade_response( client );
+    next_client_internal_update_route_manager( client );
 
-#if NEXT_SPIKE_TRACKING
+    stage_start_time = next_client_internal_record_stage( client, NEXT_CLIENT_METRIC_UPDATE_ROUTE_MANAGER, stage_start_time );
 
-    double finish_time = next_platform_time();
+    next_client_internal_update_upgrade_response( client );
 
-    if ( finish_time - start_time > 0.001 )
-    {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_client_internal_update spike %.2f milliseconds", ( finish_time - start_time ) * 1000.0 );
-    }
+    stage_start_time = next_client_internal_record_stage( client, NEXT_CLIENT_METRIC_UPDATE_UPGRADE_RESPONSE, stage_start_time );
 
-#endif // #if NEXT_SPIKE_TRACKING
+    next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_UPDATE_INTERNAL], stage_start_time - start_time );
 }
 
 static void next_client_internal_thread_function( void * context )
@@ -2354,6 +2624,10 @@ static void next_client_internal_thread_function( void * context )
 
     while ( !quit )
     {
+        // IMPORTANT: packets sent on this thread are submitted together at the end of each pass, or when the receive waits
+
+        next_platform_socket_send_batch_begin( client->socket );
+
         next_client_internal_block_and_receive_packet( client );
 
         if ( next_platform_time() > last_update_time + 0.01 )
@@ -2364,6 +2638,8 @@ static void next_client_internal_thread_function( void * context )
 
             last_update_time = next_platform_time();
         }
+
+        next_platform_socket_send_batch_end( client->socket );
     }
 }
 
@@ -2378,6 +2654,9 @@ struct next_client_t
     bool ready;
     bool upgraded;
     bool fallback_to_direct;
+    bool payload_coalescing;
+    bool fec;
+    bool sending_packets;
     uint8_t open_session_sequence;
     uint8_t current_magic[8];
     uint16_t bound_port;
@@ -2404,6 +2683,19 @@ struct next_client_t
     uint64_t counters[NEXT_CLIENT_COUNTER_MAX];
 
     NEXT_DECLARE_SENTINEL(4)
+
+    next_latency_histogram_t latency[NEXT_CLIENT_METRIC_NUM_METRICS];
+
+    NEXT_DECLARE_SENTINEL(5)
+
+    next_payload_coalescer_t send_coalescer;
+
+    NEXT_DECLARE_SENTINEL(6)
+
+    next_fec_encoder_t fec_encoder;
+    next_bandwidth_limiter_t fec_send_bandwidth;
+
+    NEXT_DECLARE_SENTINEL(7)
 };
 
 void next_client_initialize_sentinels( next_client_t * client )
@@ -2415,6 +2707,9 @@ void next_client_initialize_sentinels( next_client_t * client )
     NEXT_INITIALIZE_SENTINEL( client, 2 )
     NEXT_INITIALIZE_SENTINEL( client, 3 )
     NEXT_INITIALIZE_SENTINEL( client, 4 )
+    NEXT_INITIALIZE_SENTINEL( client, 5 )
+    NEXT_INITIALIZE_SENTINEL( client, 6 )
+    NEXT_INITIALIZE_SENTINEL( client, 7 )
 }
 
 void next_client_verify_sentinels( next_client_t * client )
@@ -2426,10 +2721,29 @@ void next_client_verify_sentinels( next_client_t * client )
     NEXT_VERIFY_SENTINEL( client, 2 )
     NEXT_VERIFY_SENTINEL( client, 3 )
     NEXT_VERIFY_SENTINEL( client, 4 )
+    NEXT_VERIFY_SENTINEL( client, 5 )
+    NEXT_VERIFY_SENTINEL( client, 6 )
+    NEXT_VERIFY_SENTINEL( client, 7 )
 }
 
 void next_client_destroy( next_client_t * client );
 
+void next_client_queue_command( next_client_t * client, void * command )
+{
+    // IMPORTANT: call with the internal command_mutex held. when the queue is full next_queue_push frees the command
+
+    if ( next_queue_push( client->internal->command_queue, command ) != NEXT_OK )
+    {
+        client->counters[NEXT_CLIENT_COUNTER_COMMAND_QUEUE_OVERFLOW]++;
+        return;
+    }
+
+    if ( (uint64_t) client->internal->command_queue->num_entries > client->counters[NEXT_CLIENT_COUNTER_COMMAND_QUEUE_HIGH_WATER_MARK] )
+    {
+        client->counters[NEXT_CLIENT_COUNTER_COMMAND_QUEUE_HIGH_WATER_MARK] = client->internal->command_queue->num_entries;
+    }
+}
+
 next_client_t * next_client_create( void * context, const char * bind_address, void (*packet_received_callback)( next_client_t * client, void * context, const struct next_address_t * from, const uint8_t * packet_data, int packet_bytes ) )
 {
     next_assert( bind_address );
@@ -2439,7 +2753,8 @@ next_client_t * next_client_create( void * context, const char * bind_address, v
     if ( !client )
         return NULL;
 
-    memset( client, 0, sizeof( next_client_t) );
+    char * just_clear_it_and_dont_complain = (char*) client;
+    memset( just_clear_it_and_dont_complain, 0, sizeof(next_client_t) );
 
     next_client_initialize_sentinels( client );
 
@@ -2456,6 +2771,14 @@ next_client_t * next_client_create( void * context, const char * bind_address, v
 
     client->bound_port = client->internal->bound_port;
 
+    if ( next_global_config.immediate_packet_delivery )
+    {
+        // IMPORTANT: set before the internal thread starts, so it never sees a half set callback
+
+        client->internal->immediate_packet_received_callback = packet_received_callback;
+        client->internal->immediate_packet_received_client = client;
+    }
+
     client->thread = next_platform_thread_create( client->context, next_client_internal_thread_function, client->internal );
     next_assert( client->thread );
     if ( !client->thread )
@@ -2467,10 +2790,18 @@ next_client_t * next_client_create( void * context, const char * bind_address, v
 
     next_platform_client_thread_priority( client->thread );
 
+    if ( next_global_config.client_thread_cpu >= 0 && next_platform_thread_affinity( client->thread, next_global_config.client_thread_cpu ) != NEXT_OK )
+    {
+        next_printf( NEXT_LOG_LEVEL_WARN, "client could not pin thread to cpu %d", next_global_config.client_thread_cpu );
+    }
+
     next_bandwidth_limiter_reset( &client->direct_send_bandwidth );
     next_bandwidth_limiter_reset( &client->direct_receive_bandwidth );
     next_bandwidth_limiter_reset( &client->next_send_bandwidth );
     next_bandwidth_limiter_reset( &client->next_receive_bandwidth );
+    next_bandwidth_limiter_reset( &client->fec_send_bandwidth );
+
+    next_fec_encoder_reset( &client->fec_encoder );
 
     next_client_verify_sentinels( client );
 
@@ -2490,7 +2821,7 @@ void next_client_destroy( next_client_t * client )
 
     if ( client->thread )
     {
-        next_client_command_destroy_t * command = (next_client_command_destroy_t*) next_malloc( client->context, sizeof( next_client_command_destroy_t ) );
+        next_client_command_destroy_t * command = (next_client_command_destroy_t*) next_pool_alloc( client->internal->command_pool, client->context, sizeof( next_client_command_destroy_t ) );
         if ( !command )
         {
             next_printf( NEXT_LOG_LEVEL_ERROR, "client destroy failed. could not create destroy command" );
@@ -2501,8 +2832,8 @@ void next_client_destroy( next_client_t * client )
 #if NEXT_SPIKE_TRACKING
             next_printf( NEXT_LOG_LEVEL_SPAM, "client sent NEXT_CLIENT_COMMAND_DESTROY" );
 #endif // #if NEXT_SPIKE_TRACKING
-            next_platform_mutex_guard( &client->internal->command_mutex );
-            next_queue_push( client->internal->command_queue, command );
+            next_client_mutex_guard( &client->internal->command_mutex );
+            next_client_queue_command( client, command );
         }
 
         next_platform_thread_join( client->thread );
@@ -2533,7 +2864,7 @@ void next_client_open_session( next_client_t * client, const char * server_addre
         return;
     }
 
-    next_client_command_open_session_t * command = (next_client_command_open_session_t*) next_malloc( client->context, sizeof( next_client_command_open_session_t ) );
+    next_client_command_open_session_t * command = (next_client_command_open_session_t*) next_pool_alloc( client->internal->command_pool, client->context, sizeof( next_client_command_open_session_t ) );
     if ( !command )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "client open session failed. could not create open session command" );
@@ -2548,8 +2879,8 @@ void next_client_open_session( next_client_t * client, const char * server_addre
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "client sent NEXT_CLIENT_COMMAND_OPEN_SESSION" );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &client->internal->command_mutex );
-        next_queue_push( client->internal->command_queue, command );
+        next_client_mutex_guard( &client->internal->command_mutex );
+        next_client_queue_command( client, command );
     }
 
     client->state = NEXT_CLIENT_STATE_OPEN;
@@ -2577,7 +2908,7 @@ void next_client_close_session( next_client_t * client )
 
     next_assert( client->internal );
 
-    next_client_command_close_session_t * command = (next_client_command_close_session_t*) next_malloc( client->context, sizeof( next_client_command_close_session_t ) );
+    next_client_command_close_session_t * command = (next_client_command_close_session_t*) next_pool_alloc( client->internal->command_pool, client->context, sizeof( next_client_command_close_session_t ) );
     if ( !command )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "client close session failed. could not create close session command" );
@@ -2590,14 +2921,18 @@ void next_client_close_session( next_client_t * client )
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "client sent NEXT_CLIENT_COMMAND_CLOSE_SESSION" );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &client->internal->command_mutex );
-        next_queue_push( client->internal->command_queue, command );
+        next_client_mutex_guard( &client->internal->command_mutex );
+        next_client_queue_command( client, command );
     }
 
     client->ready = false;
     client->upgraded = false;
     client->fallback_to_direct = false;
+    client->payload_coalescing = false;
+    client->fec = false;
     client->session_id = 0;
+    next_payload_coalescer_reset( &client->send_coalescer );
+    next_fec_encoder_reset( &client->fec_encoder );
     memset( &client->client_stats, 0, sizeof(next_client_stats_t ) );
     memset( &client->server_address, 0, sizeof(next_address_t) );
     memset( &client->client_external_address, 0, sizeof(next_address_t) );
@@ -2605,6 +2940,7 @@ void next_client_close_session( next_client_t * client )
     next_bandwidth_limiter_reset( &client->direct_receive_bandwidth );
     next_bandwidth_limiter_reset( &client->next_send_bandwidth );
     next_bandwidth_limiter_reset( &client->next_receive_bandwidth );
+    next_bandwidth_limiter_reset( &client->fec_send_bandwidth );
     client->state = NEXT_CLIENT_STATE_CLOSED;
     memset( client->current_magic, 0, sizeof(client->current_magic) );
 }
@@ -2613,6 +2949,8 @@ void next_client_update( next_client_t * client )
 {
     next_client_verify_sentinels( client );
 
+    next_latency_timer( &client->latency[NEXT_CLIENT_METRIC_UPDATE] );
+
 #if NEXT_SPIKE_TRACKING
     next_printf( NEXT_LOG_LEVEL_SPAM, "next_client_update" );
 #endif // #if NEXT_SPIKE_TRACKING
@@ -2621,8 +2959,12 @@ void next_client_update( next_client_t * client )
     {
         void * entry = NULL;
         {
-            next_platform_mutex_guard( &client->internal->notify_mutex );
+            next_client_mutex_guard( &client->internal->notify_mutex );
             entry = next_queue_pop( client->internal->notify_queue );
+            if ( entry == NULL )
+            {
+                entry = next_queue_pop( client->internal->payload_queue );
+            }
         }
 
         if ( entry == NULL )
@@ -2650,7 +2992,21 @@ void next_client_update( next_client_t * client )
 
                 if ( !already_received )
                 {
-                    client->packet_received_callback( client, client->context, &client->server_address, packet_received->payload_data, packet_received->payload_bytes );
+                    next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_NOTIFY_TO_CALLBACK], next_platform_time() - packet_received->queue_time );
+                    if ( packet_received->coalesced )
+                    {
+                        int offset = 0;
+                        const uint8_t * packet_data = NULL;
+                        int packet_bytes = 0;
+                        while ( ( packet_bytes = next_payload_coalescer_read_packet( packet_received->payload_data, packet_received->payload_bytes, &offset, &packet_data ) ) > 0 )
+                        {
+                            client->packet_received_callback( client, client->context, &client->server_address, packet_data, packet_bytes );
+                        }
+                    }
+                    else
+                    {
+                        client->packet_received_callback( client, client->context, &client->server_address, packet_received->payload_data, packet_received->payload_bytes );
+                    }
                 }
 
                 const int wire_packet_bits = next_wire_packet_bits( packet_received->payload_bytes );
@@ -2661,27 +3017,17 @@ void next_client_update( next_client_t * client )
 
                     double direct_kbps_down = next_bandwidth_limiter_usage_kbps( &client->direct_receive_bandwidth );
 
-                    {
-                        next_platform_mutex_guard( &client->internal->direct_bandwidth_mutex );
-                        client->internal->direct_bandwidth_usage_kbps_down = direct_kbps_down;
-                    }
+                    client->internal->direct_bandwidth_usage_kbps_down.store( float( direct_kbps_down ), std::memory_order_relaxed );
                 }
                 else
                 {
-                    int envelope_kbps_down;
-                    {
-                        next_platform_mutex_guard( &client->internal->next_bandwidth_mutex );
-                        envelope_kbps_down = client->internal->next_bandwidth_envelope_kbps_down;
-                    }
+                    const int envelope_kbps_down = int( client->internal->next_bandwidth_envelope_kbps_down.load( std::memory_order_relaxed ) );
 
                     next_bandwidth_limiter_add_packet( &client->next_receive_bandwidth, next_platform_time(), envelope_kbps_down, wire_packet_bits );
 
                     double next_kbps_down = next_bandwidth_limiter_usage_kbps( &client->next_receive_bandwidth );
 
-                    {
-                        next_platform_mutex_guard( &client->internal->next_bandwidth_mutex );
-                        client->internal->next_bandwidth_usage_kbps_down = next_kbps_down;
-                    }
+                    client->internal->next_bandwidth_usage_kbps_down.store( float( next_kbps_down ), std::memory_order_relaxed );
                 }
             }
             break;
@@ -2696,6 +3042,8 @@ void next_client_update( next_client_t * client )
                 client->session_id = upgraded->session_id;
                 client->client_external_address = upgraded->client_external_address;
                 memcpy( client->current_magic, upgraded->current_magic, 8 );
+                client->payload_coalescing = upgraded->payload_coalescing;
+                client->fec = upgraded->fec;
                 next_printf( NEXT_LOG_LEVEL_INFO, "client upgraded to session %" PRIx64, client->session_id );
             }
             break;
@@ -2733,7 +3081,7 @@ void next_client_update( next_client_t * client )
             default: break;
         }
 
-        next_free( client->context, entry );
+        next_pool_free( client->internal->notify_pool, client->context, entry );
     }
 }
 
@@ -2749,175 +3097,261 @@ bool next_client_fallback_to_direct( struct next_client_t * client )
     return client->client_stats.fallback_to_direct;
 }
 
-void next_client_send_packet( next_client_t * client, const uint8_t * packet_data, int packet_bytes )
+static uint64_t next_client_send_upgraded_packet( next_client_t * client, const uint8_t * packet_data, int packet_bytes, bool fec_parity )
 {
-    next_client_verify_sentinels( client );
-
-    next_assert( client->internal );
-    next_assert( client->internal->socket );
+    next_assert( packet_data );
     next_assert( packet_bytes > 0 );
+    next_assert( packet_bytes <= NEXT_MTU );
 
-    if ( client->state != NEXT_CLIENT_STATE_OPEN )
+    // IMPORTANT: no locks on this path. The send sequence is atomic and the route is a seqlock snapshot published by the internal thread
+
+    const uint64_t send_sequence = next_route_manager_next_send_sequence( client->internal->route_manager );
+
+    next_route_manager_send_route_t send_route;
+    next_route_manager_get_send_route( client->internal->route_manager, &send_route );
+
+    bool send_over_network_next = send_route.current_route;
+
+    bool send_direct = !send_over_network_next;
+    bool multipath = client->client_stats.multipath;
+    if ( send_over_network_next && multipath )
     {
-        next_printf( NEXT_LOG_LEVEL_DEBUG, "client can't send packet because no session is open" );
-        return;
+        if ( next_global_config.adaptive_multipath && !client->internal->multipath_duplicate.load( std::memory_order_relaxed ) )
+        {
+            // primary path is healthy. only send on it
+
+            if ( client->internal->multipath_prefer_direct.load( std::memory_order_relaxed ) )
+            {
+                send_over_network_next = false;
+                send_direct = true;
+            }
+
+            client->counters[NEXT_CLIENT_COUNTER_MULTIPATH_SINGLE_PATH]++;
+        }
+        else
+        {
+            send_direct = true;
+
+            client->counters[NEXT_CLIENT_COUNTER_MULTIPATH_DUPLICATED]++;
+        }
     }
 
-    if ( packet_bytes > NEXT_MAX_PACKET_BYTES - 1 )
+    const int wire_packet_bits = next_wire_packet_bits( packet_bytes );
+
+    if ( fec_parity )
     {
-        next_printf( NEXT_LOG_LEVEL_ERROR, "client can't send packet because packet is too large" );
-        return;
-    }
+        // IMPORTANT: parity is tracked apart from the session bandwidth envelope, so it can never push payloads off network next.
+        // It goes over network next only while payloads and parity together fit in the envelope, otherwise it goes direct
 
-    if ( next_global_config.disable_network_next || client->fallback_to_direct )
+        next_bandwidth_limiter_add_packet( &client->fec_send_bandwidth, next_platform_time(), 0, wire_packet_bits );
+
+        const double fec_usage_kbps_up = next_bandwidth_limiter_usage_kbps( &client->fec_send_bandwidth );
+
+        client->internal->fec_bandwidth_usage_kbps_up.store( float( fec_usage_kbps_up ), std::memory_order_relaxed );
+
+        const float next_envelope_kbps_up = client->internal->next_bandwidth_envelope_kbps_up.load( std::memory_order_relaxed );
+
+        if ( send_over_network_next && next_bandwidth_limiter_usage_kbps( &client->next_send_bandwidth ) + fec_usage_kbps_up > next_envelope_kbps_up )
+        {
+            send_over_network_next = false;
+            send_direct = true;
+        }
+    }
+    else
     {
-        next_client_send_packet_direct( client, packet_data, packet_bytes );
-        return;
+        // track direct send bandwidth
+
+        next_bandwidth_limiter_add_packet( &client->direct_send_bandwidth, next_platform_time(), 0, wire_packet_bits );
+
+        double direct_usage_kbps_up = next_bandwidth_limiter_usage_kbps( &client->direct_send_bandwidth );
+
+        client->internal->direct_bandwidth_usage_kbps_up.store( float( direct_usage_kbps_up ), std::memory_order_relaxed );
     }
 
-#if NEXT_DEVELOPMENT
-    if ( next_packet_loss && ( rand() % 10 ) == 0 )
-        return;
-#endif // #if NEXT_DEVELOPMENT
+    // track next send bandwidth and don't send over network next if we're over the bandwidth budget
 
-    if ( client->upgraded && packet_bytes <= NEXT_MTU )
+    if ( send_over_network_next && !fec_parity )
     {
-        uint64_t send_sequence = 0;
-        bool send_over_network_next = false;
+        const int next_envelope_kbps_up = int( client->internal->next_bandwidth_envelope_kbps_up.load( std::memory_order_relaxed ) );
+
+        bool over_budget = next_bandwidth_limiter_add_packet( &client->next_send_bandwidth, next_platform_time(), next_envelope_kbps_up, wire_packet_bits );
+
+        double next_usage_kbps_up = next_bandwidth_limiter_usage_kbps( &client->next_send_bandwidth );
+
+        client->internal->next_bandwidth_usage_kbps_up.store( float( next_usage_kbps_up ), std::memory_order_relaxed );
+        if ( over_budget )
         {
-            next_platform_mutex_guard( &client->internal->route_manager_mutex );
-            send_sequence = next_route_manager_next_send_sequence( client->internal->route_manager );
-            send_over_network_next = next_route_manager_has_network_next_route( client->internal->route_manager );
+            client->internal->next_bandwidth_over_limit.store( true, std::memory_order_relaxed );
         }
 
-        bool send_direct = !send_over_network_next;
-        bool multipath = client->client_stats.multipath;
-        if ( send_over_network_next && multipath )
+        if ( over_budget )
         {
+            next_printf( NEXT_LOG_LEVEL_WARN, "client exceeded bandwidth budget (%d kbps)", next_envelope_kbps_up );
+            send_over_network_next = false;
             send_direct = true;
         }
+    }
 
-        // track direct send bandwidth
+    if ( send_over_network_next )
+    {
+        // send over network next
 
-        const int wire_packet_bits = next_wire_packet_bits( packet_bytes );
+        int next_packet_bytes = 0;
+        next_address_t next_to;
+        uint8_t next_packet_data[NEXT_MAX_PACKET_BYTES];
 
-        next_bandwidth_limiter_add_packet( &client->direct_send_bandwidth, next_platform_time(), 0, wire_packet_bits );
+        const bool result = next_route_manager_prepare_send_packet( client->internal->route_manager, &send_route, send_sequence, &next_to, packet_data, packet_bytes, next_packet_data, &next_packet_bytes, client->current_magic, &client->client_external_address );
 
-        double direct_usage_kbps_up = next_bandwidth_limiter_usage_kbps( &client->direct_send_bandwidth );
+        if ( result )
+        {
+            const double send_start_time = next_platform_time();
+
+            next_platform_socket_send_packet( client->internal->socket, &next_to, next_packet_data, next_packet_bytes );
 
+            next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
+
+            client->counters[NEXT_CLIENT_COUNTER_PACKET_SENT_NEXT]++;
+        }
+        else
         {
-            next_platform_mutex_guard( &client->internal->direct_bandwidth_mutex );
-            client->internal->direct_bandwidth_usage_kbps_up = direct_usage_kbps_up;
+            // could not send over network next
+            send_direct = true;
         }
+    }
 
-        // track next send bandwidth and don't send over network next if we're over the bandwidth budget
+    if ( send_direct )
+    {
+        // send direct from client to server
 
-        if ( send_over_network_next )
-        {
-            int next_envelope_kbps_up;
-            {
-                next_platform_mutex_guard( &client->internal->next_bandwidth_mutex );
-                next_envelope_kbps_up = client->internal->next_bandwidth_envelope_kbps_up;
-            }
+        uint8_t from_address_data[4];
+        uint8_t to_address_data[4];
 
-            bool over_budget = next_bandwidth_limiter_add_packet( &client->next_send_bandwidth, next_platform_time(), next_envelope_kbps_up, wire_packet_bits );
+        next_address_data( &client->client_external_address, from_address_data );
+        next_address_data( &client->server_address, to_address_data );
 
-            double next_usage_kbps_up = next_bandwidth_limiter_usage_kbps( &client->next_send_bandwidth );
+        uint8_t direct_packet_data[NEXT_MAX_PACKET_BYTES];
 
-            {
-                next_platform_mutex_guard( &client->internal->next_bandwidth_mutex );
-                client->internal->next_bandwidth_usage_kbps_up = next_usage_kbps_up;
-                if ( over_budget )
-                    client->internal->next_bandwidth_over_limit = true;
-            }
+        const int direct_packet_bytes = next_write_direct_packet( direct_packet_data, client->open_session_sequence, send_sequence, packet_data, packet_bytes, client->current_magic, from_address_data, to_address_data );
 
-            if ( over_budget )
-            {
-                next_printf( NEXT_LOG_LEVEL_WARN, "client exceeded bandwidth budget (%d kbps)", next_envelope_kbps_up );
-                send_over_network_next = false;
-                send_direct = true;
-            }
-        }
+        next_assert( direct_packet_bytes >= 0 );
 
-        if ( send_over_network_next )
-        {
-            // send over network next
+        next_assert( next_basic_packet_filter( direct_packet_data, direct_packet_bytes ) );
+        next_assert( next_advanced_packet_filter( direct_packet_data, client->current_magic, from_address_data, to_address_data, direct_packet_bytes ) );
 
-            int next_packet_bytes = 0;
-            next_address_t next_to;
-            uint8_t next_packet_data[NEXT_MAX_PACKET_BYTES];
+        (void) direct_packet_data;
+        (void) direct_packet_bytes;
 
-            bool result = false;
-            {
-                next_platform_mutex_guard( &client->internal->route_manager_mutex );
-                result = next_route_manager_prepare_send_packet( client->internal->route_manager, send_sequence, &next_to, packet_data, packet_bytes, next_packet_data, &next_packet_bytes, client->current_magic, &client->client_external_address );
-            }
+        const double send_start_time = next_platform_time();
 
-            if ( result )
-            {
-#if NEXT_SPIKE_TRACKING
-                double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+        next_platform_socket_send_packet( client->internal->socket, &client->server_address, direct_packet_data, direct_packet_bytes );
 
-                next_platform_socket_send_packet( client->internal->socket, &next_to, next_packet_data, next_packet_bytes );
+        next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
 
-#if NEXT_SPIKE_TRACKING
-                double finish_time = next_platform_time();
-                if ( finish_time - start_time > 0.001 )
-                {
-                    next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-                }
-#endif // #if NEXT_SPIKE_TRACKING
+        client->counters[NEXT_CLIENT_COUNTER_PACKET_SENT_DIRECT]++;
+    }
 
-                client->counters[NEXT_CLIENT_COUNTER_PACKET_SENT_NEXT]++;
-            }
-            else
-            {
-                // could not send over network next
-                send_direct = true;
-            }
-        }
+    client->internal->packets_sent++;
 
-        if ( send_direct )
-        {
-            // send direct from client to server
+    return send_sequence;
+}
 
-            uint8_t from_address_data[4];
-            uint8_t to_address_data[4];
+static void next_client_send_upgraded_payload( next_client_t * client, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( payload_data );
+    next_assert( payload_bytes > 0 );
+    next_assert( payload_bytes <= NEXT_MTU );
 
-            next_address_data( &client->client_external_address, from_address_data );
-            next_address_data( &client->server_address, to_address_data );
+    if ( !client->fec )
+    {
+        next_client_send_upgraded_packet( client, payload_data, payload_bytes, false );
+        return;
+    }
 
-            uint8_t direct_packet_data[NEXT_MAX_PACKET_BYTES];
+    uint8_t packet_data[NEXT_MTU];
 
-            const int direct_packet_bytes = next_write_direct_packet( direct_packet_data, client->open_session_sequence, send_sequence, packet_data, packet_bytes, client->current_magic, from_address_data, to_address_data );
+    const int packet_bytes = next_fec_encoder_write_packet( &client->fec_encoder, packet_data, payload_data, payload_bytes );
 
-            next_assert( direct_packet_bytes >= 0 );
+    const uint64_t send_sequence = next_client_send_upgraded_packet( client, packet_data, packet_bytes, false );
 
-            next_assert( next_basic_packet_filter( direct_packet_data, direct_packet_bytes ) );
-            next_assert( next_advanced_packet_filter( direct_packet_data, client->current_magic, from_address_data, to_address_data, direct_packet_bytes ) );
+    if ( next_fec_encoder_add_packet( &client->fec_encoder, send_sequence, payload_data, payload_bytes, next_global_config.fec_group_size ) )
+    {
+        const int parity_bytes = next_fec_encoder_write_parity( &client->fec_encoder, packet_data );
 
-            (void) direct_packet_data;
-            (void) direct_packet_bytes;
+        next_client_send_upgraded_packet( client, packet_data, parity_bytes, true );
 
-#if NEXT_SPIKE_TRACKING 
-            double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+        next_fec_encoder_reset( &client->fec_encoder );
 
-            next_platform_socket_send_packet( client->internal->socket, &client->server_address, direct_packet_data, direct_packet_bytes );
+        client->counters[NEXT_CLIENT_COUNTER_FEC_PARITY_SENT]++;
+    }
+}
 
-#if NEXT_SPIKE_TRACKING
-            double finish_time = next_platform_time();
-            if ( finish_time - start_time > 0.001 )
+void next_client_send_packet( next_client_t * client, const uint8_t * packet_data, int packet_bytes )
+{
+    next_client_verify_sentinels( client );
+
+    next_latency_timer( &client->latency[NEXT_CLIENT_METRIC_SEND_PACKET] );
+
+    next_assert( client->internal );
+    next_assert( client->internal->socket );
+    next_assert( packet_bytes > 0 );
+
+    if ( client->state != NEXT_CLIENT_STATE_OPEN )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "client can't send packet because no session is open" );
+        return;
+    }
+
+    if ( packet_bytes > NEXT_MAX_PACKET_BYTES - 1 )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "client can't send packet because packet is too large" );
+        return;
+    }
+
+    if ( next_global_config.disable_network_next || client->fallback_to_direct )
+    {
+        next_client_send_packet_direct( client, packet_data, packet_bytes );
+        return;
+    }
+
+#if NEXT_DEVELOPMENT
+    if ( next_packet_loss && ( rand() % 10 ) == 0 )
+        return;
+#endif // #if NEXT_DEVELOPMENT
+
+    // IMPORTANT: upgraded packets never exceed NEXT_MTU. Fec framing comes out of that, and so does the coalescing prefix,
+    // so a packet that doesn't fit with the framing the session negotiated goes passthrough
+
+    const int max_payload_bytes = client->fec ? NEXT_MAX_FEC_PAYLOAD_BYTES : NEXT_MTU;
+
+    const bool fits_upgraded = client->payload_coalescing ? next_payload_coalescer_packet_fits( packet_bytes, max_payload_bytes ) : packet_bytes <= max_payload_bytes;
+
+    if ( client->upgraded && fits_upgraded )
+    {
+        if ( !client->payload_coalescing )
+        {
+            next_client_send_upgraded_payload( client, packet_data, packet_bytes );
+            return;
+        }
+
+        if ( client->sending_packets )
+        {
+            // pack into the coalescer and send it when full or at next_client_send_packets_end
+
+            if ( !next_payload_coalescer_add_packet( &client->send_coalescer, packet_data, packet_bytes, max_payload_bytes ) )
             {
-                next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
+                next_client_send_upgraded_payload( client, client->send_coalescer.payload_data, client->send_coalescer.payload_bytes );
+                next_payload_coalescer_reset( &client->send_coalescer );
+                const bool added = next_payload_coalescer_add_packet( &client->send_coalescer, packet_data, packet_bytes, max_payload_bytes );
+                next_assert( added );
+                (void) added;
             }
-#endif // #if NEXT_SPIKE_TRACKING
 
-            client->counters[NEXT_CLIENT_COUNTER_PACKET_SENT_DIRECT]++;
+            return;
         }
 
-        client->internal->packets_sent++;
+        uint8_t payload_data[NEXT_MTU];
+        const int payload_bytes = next_payload_coalescer_write_packet( payload_data, packet_data, packet_bytes );
+        next_client_send_upgraded_payload( client, payload_data, payload_bytes );
     }
     else
     {
@@ -2957,19 +3391,11 @@ void next_client_send_packet_direct( next_client_t * client, const uint8_t * pac
     buffer[0] = NEXT_PASSTHROUGH_PACKET;
     memcpy( buffer + 1, packet_data, packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double send_start_time = next_platform_time();
 
     next_platform_socket_send_packet( client->internal->socket, &client->server_address, buffer, packet_bytes + 1 );
 
-#if NEXT_SPIKE_TRACKING
-    double finish_time = next_platform_time();
-    if ( finish_time - start_time > 0.001 )
-    {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-    }
-#endif // #if NEXT_SPIKE_TRACKING
+    next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
 
     client->counters[NEXT_CLIENT_COUNTER_PACKET_SENT_PASSTHROUGH]++;
 
@@ -2985,26 +3411,46 @@ void next_client_send_packet_raw( next_client_t * client, const next_address_t *
     next_assert( to_address );
     next_assert( packet_bytes > 0 );
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double send_start_time = next_platform_time();
 
     next_platform_socket_send_packet( client->internal->socket, to_address, packet_data, packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-    double finish_time = next_platform_time();
-    if ( finish_time - start_time > 0.001 )
+    next_latency_histogram_record( &client->latency[NEXT_CLIENT_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
+}
+
+void next_client_send_packets_begin( next_client_t * client )
+{
+    next_client_verify_sentinels( client );
+
+    client->sending_packets = true;
+
+    next_platform_socket_send_batch_begin( client->internal->socket );
+}
+
+void next_client_send_packets_end( next_client_t * client )
+{
+    next_client_verify_sentinels( client );
+
+    if ( client->send_coalescer.num_packets > 0 )
     {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
+        if ( client->upgraded && client->payload_coalescing )
+        {
+            next_client_send_upgraded_payload( client, client->send_coalescer.payload_data, client->send_coalescer.payload_bytes );
+        }
+
+        next_payload_coalescer_reset( &client->send_coalescer );
     }
-#endif // #if NEXT_SPIKE_TRACKING
+
+    client->sending_packets = false;
+
+    next_platform_socket_send_batch_end( client->internal->socket );
 }
 
 void next_client_report_session( next_client_t * client )
 {
     next_client_verify_sentinels( client );
 
-    next_client_command_report_session_t * command = (next_client_command_report_session_t*) next_malloc( client->context, sizeof( next_client_command_report_session_t ) );
+    next_client_command_report_session_t * command = (next_client_command_report_session_t*) next_pool_alloc( client->internal->command_pool, client->context, sizeof( next_client_command_report_session_t ) );
 
     if ( !command )
     {
@@ -3017,8 +3463,8 @@ void next_client_report_session( next_client_t * client )
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "client sent NEXT_CLIENT_COMMAND_REPORT_SESSION" );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &client->internal->command_mutex );
-        next_queue_push( client->internal->command_queue, command );
+        next_client_mutex_guard( &client->internal->command_mutex );
+        next_client_queue_command( client, command );
     }
 }
 
@@ -3048,6 +3494,23 @@ void next_client_counters( next_client_t * client, uint64_t * counters )
     memcpy( counters, client->counters, sizeof(uint64_t) * NEXT_CLIENT_COUNTER_MAX );
     for ( int i = 0; i < NEXT_CLIENT_COUNTER_MAX; ++i )
         counters[i] += client->internal->counters[i];
+    if ( client->internal->notify_pool )
+        counters[NEXT_CLIENT_COUNTER_MEMORY_POOL_FALLBACKS] += client->internal->notify_pool->num_fallback_allocs.load( std::memory_order_relaxed );
+    if ( client->internal->command_pool )
+        counters[NEXT_CLIENT_COUNTER_MEMORY_POOL_FALLBACKS] += client->internal->command_pool->num_fallback_allocs.load( std::memory_order_relaxed );
+}
+
+void next_client_metrics( next_client_t * client, next_client_metrics_t * metrics )
+{
+    next_client_verify_sentinels( client );
+
+    next_assert( metrics );
+
+    for ( int i = 0; i < NEXT_CLIENT_METRIC_NUM_METRICS; i++ )
+    {
+        const next_latency_histogram_t * histograms[] = { &client->latency[i], &client->internal->latency[i] };
+        next_latency_histogram_summary( histograms, 2, &metrics->latency[i] );
+    }
 }
 
 // ---------------------------------------------------------------
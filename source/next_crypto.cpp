@@ -22,6 +22,8 @@
 
 #include "next_crypto.h"
 
+#include <memory.h>
+
 #ifdef _MSC_VER
 #pragma warning(disable:4996)
 #pragma warning(push)
@@ -78,6 +80,20 @@ int next_crypto_sign_final_verify( struct next_crypto_sign_state_t * state, cons
     return crypto_sign_final_verify( (crypto_sign_state*) state, sig, pk );
 }
 
+int next_crypto_sign_final_verify_batch( struct next_crypto_sign_state_t * states, const unsigned char * const * sigs, int count, const unsigned char * pk )
+{
+    static_assert( sizeof(next_crypto_sign_state_t) >= sizeof(crypto_sign_ed25519ph_state), "sign state is too small" );
+    static_assert( NEXT_CRYPTO_SIGN_BATCH_MAX == crypto_sign_ed25519_BATCHMAX, "sign batch max mismatch" );
+    if ( count <= 0 || count > NEXT_CRYPTO_SIGN_BATCH_MAX )
+        return -1;
+    crypto_sign_ed25519ph_state batch_states[NEXT_CRYPTO_SIGN_BATCH_MAX];
+    for ( int i = 0; i < count; ++i )
+    {
+        memcpy( &batch_states[i], &states[i], sizeof(crypto_sign_ed25519ph_state) );
+    }
+    return crypto_sign_ed25519ph_final_verify_batch( batch_states, sigs, size_t(count), pk );
+}
+
 void next_crypto_secretbox_keygen( unsigned char * k )
 {
     return crypto_secretbox_keygen( k );
@@ -0,0 +1,454 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following 
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions 
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote 
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "next_crypto_worker.h"
+#include "next_memory_checks.h"
+#include "next_constants.h"
+#include "next_crypto.h"
+#include "next_packets.h"
+#include "next_packet_filter.h"
+#include "next_platform.h"
+#include "next_queue.h"
+
+#include <atomic>
+#include <memory.h>
+
+struct next_crypto_worker_t
+{
+    NEXT_DECLARE_SENTINEL(0)
+
+    void * context;
+    void (*wake_function)( void * wake_data );
+    void * wake_data;
+    uint8_t sign_private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+    uint8_t verify_public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+
+    NEXT_DECLARE_SENTINEL(1)
+
+    next_platform_thread_t * thread;
+    next_platform_mutex_t job_mutex;
+    next_platform_mutex_t result_mutex;
+    next_platform_semaphore_t job_semaphore;
+    next_queue_t * job_queue;
+    next_queue_t * result_queue;
+    bool job_mutex_created;
+    bool result_mutex_created;
+    bool job_semaphore_created;
+
+    NEXT_DECLARE_SENTINEL(2)
+
+    std::atomic<uint64_t> quit;
+    std::atomic<int> num_jobs_in_flight;
+
+    NEXT_DECLARE_SENTINEL(3)
+
+    // IMPORTANT: only touched by the worker thread
+
+    next_crypto_worker_job_t * batch_jobs[NEXT_CRYPTO_SIGN_BATCH_MAX];
+    int num_batch_jobs;
+    double batch_start_time;
+
+    NEXT_DECLARE_SENTINEL(4)
+};
+
+void next_crypto_worker_initialize_sentinels( next_crypto_worker_t * worker )
+{
+    (void) worker;
+    next_assert( worker );
+    NEXT_INITIALIZE_SENTINEL( worker, 0 )
+    NEXT_INITIALIZE_SENTINEL( worker, 1 )
+    NEXT_INITIALIZE_SENTINEL( worker, 2 )
+    NEXT_INITIALIZE_SENTINEL( worker, 3 )
+    NEXT_INITIALIZE_SENTINEL( worker, 4 )
+}
+
+void next_crypto_worker_verify_sentinels( next_crypto_worker_t * worker )
+{
+    (void) worker;
+    next_assert( worker );
+    NEXT_VERIFY_SENTINEL( worker, 0 )
+    NEXT_VERIFY_SENTINEL( worker, 1 )
+    NEXT_VERIFY_SENTINEL( worker, 2 )
+    NEXT_VERIFY_SENTINEL( worker, 3 )
+    NEXT_VERIFY_SENTINEL( worker, 4 )
+}
+
+void next_crypto_worker_process_job( next_crypto_worker_job_t * job, const uint8_t * sign_private_key, const uint8_t * verify_public_key )
+{
+    next_assert( job );
+
+    switch ( job->type )
+    {
+        case NEXT_CRYPTO_WORKER_JOB_SIGN:
+        {
+            next_assert( sign_private_key );
+            next_sign_backend_packet( job->packet_data, &job->packet_bytes, sign_private_key );
+            next_generate_pittle( job->packet_data + 1, job->from_address_data, job->to_address_data, job->packet_bytes );
+            next_generate_chonkle( job->packet_data + 3, job->magic, job->from_address_data, job->to_address_data, job->packet_bytes );
+        }
+        break;
+
+        case NEXT_CRYPTO_WORKER_JOB_VERIFY:
+        {
+            next_assert( verify_public_key );
+            job->verified = job->packet_bytes > 18 && next_verify_backend_packet( job->packet_id, job->packet_data, 18, job->packet_bytes, verify_public_key );
+        }
+        break;
+
+        default:
+            next_assert( false );
+            break;
+    }
+}
+
+void next_crypto_worker_verify_batch( next_crypto_worker_job_t ** jobs, int num_jobs, const uint8_t * verify_public_key )
+{
+    next_assert( jobs );
+    next_assert( num_jobs > 0 );
+    next_assert( num_jobs <= NEXT_CRYPTO_SIGN_BATCH_MAX );
+    next_assert( verify_public_key );
+
+    if ( num_jobs <= 0 )
+        return;
+
+    uint8_t packet_ids[NEXT_CRYPTO_SIGN_BATCH_MAX] = {};
+    const uint8_t * packet_data[NEXT_CRYPTO_SIGN_BATCH_MAX] = {};
+    int begin[NEXT_CRYPTO_SIGN_BATCH_MAX] = {};
+    int end[NEXT_CRYPTO_SIGN_BATCH_MAX] = {};
+
+    bool batch_ok = true;
+
+    for ( int i = 0; i < num_jobs; ++i )
+    {
+        next_assert( jobs[i]->type == NEXT_CRYPTO_WORKER_JOB_VERIFY );
+        if ( jobs[i]->packet_bytes <= 18 )
+        {
+            batch_ok = false;
+            break;
+        }
+        packet_ids[i] = jobs[i]->packet_id;
+        packet_data[i] = jobs[i]->packet_data;
+        begin[i] = 18;
+        end[i] = jobs[i]->packet_bytes;
+    }
+
+    if ( batch_ok )
+    {
+        batch_ok = next_verify_backend_packet_batch( num_jobs, packet_ids, packet_data, begin, end, verify_public_key );
+    }
+
+    if ( batch_ok )
+    {
+        for ( int i = 0; i < num_jobs; ++i )
+        {
+            jobs[i]->verified = true;
+        }
+        return;
+    }
+
+    // IMPORTANT: a failed batch doesn't say which packet is bad, so fall back to verifying each packet on its own
+
+    for ( int i = 0; i < num_jobs; ++i )
+    {
+        next_crypto_worker_process_job( jobs[i], NULL, verify_public_key );
+    }
+}
+
+static void next_crypto_worker_push_result( next_crypto_worker_t * worker, next_crypto_worker_job_t * job )
+{
+    // IMPORTANT: the result queue can't overflow, because submit never lets more than NEXT_CRYPTO_WORKER_QUEUE_LENGTH jobs in flight
+
+    next_platform_mutex_guard( &worker->result_mutex );
+    const int result = next_queue_push( worker->result_queue, job );
+    next_assert( result == NEXT_OK );
+    (void) result;
+}
+
+static void next_crypto_worker_flush_batch( next_crypto_worker_t * worker, bool verify )
+{
+    if ( worker->num_batch_jobs == 0 )
+        return;
+
+    if ( verify )
+    {
+        next_crypto_worker_verify_batch( worker->batch_jobs, worker->num_batch_jobs, worker->verify_public_key );
+    }
+
+    for ( int i = 0; i < worker->num_batch_jobs; ++i )
+    {
+        next_crypto_worker_push_result( worker, worker->batch_jobs[i] );
+        worker->batch_jobs[i] = NULL;
+    }
+
+    worker->num_batch_jobs = 0;
+}
+
+static void next_crypto_worker_wake( next_crypto_worker_t * worker )
+{
+    if ( worker->wake_function )
+    {
+        worker->wake_function( worker->wake_data );
+    }
+}
+
+static void next_crypto_worker_thread_function( void * context )
+{
+    next_assert( context );
+
+    next_crypto_worker_t * worker = (next_crypto_worker_t*) context;
+
+    while ( !worker->quit )
+    {
+        if ( worker->num_batch_jobs > 0 && next_platform_time() - worker->batch_start_time >= NEXT_CRYPTO_WORKER_BATCH_WINDOW )
+        {
+            next_crypto_worker_flush_batch( worker, true );
+            next_crypto_worker_wake( worker );
+        }
+
+        // IMPORTANT: submit signals the semaphore once per job, so block here until there is a job to pop.
+        // When a batch is held, only wait until its window closes. The idle timeout is just a backstop.
+
+        double wait_time = NEXT_CRYPTO_WORKER_IDLE_WAIT_TIME;
+        if ( worker->num_batch_jobs > 0 )
+        {
+            wait_time = worker->batch_start_time + NEXT_CRYPTO_WORKER_BATCH_WINDOW - next_platform_time();
+        }
+
+        if ( !next_platform_semaphore_wait( &worker->job_semaphore, wait_time ) )
+            continue;
+
+        next_crypto_worker_job_t * job = NULL;
+        {
+            next_platform_mutex_guard( &worker->job_mutex );
+            job = (next_crypto_worker_job_t*) next_queue_pop( worker->job_queue );
+        }
+
+        if ( !job )
+            continue;
+
+        // IMPORTANT: session update responses are the bulk of verify work at scale, and they are all signed with the same
+        // backend key, so hold them for a short window and verify them together. They are not handed back until verified.
+
+        if ( job->type == NEXT_CRYPTO_WORKER_JOB_VERIFY && job->packet_id == NEXT_BACKEND_SESSION_UPDATE_RESPONSE_PACKET )
+        {
+            if ( worker->num_batch_jobs == 0 )
+            {
+                worker->batch_start_time = next_platform_time();
+            }
+
+            worker->batch_jobs[worker->num_batch_jobs++] = job;
+
+            if ( worker->num_batch_jobs == NEXT_CRYPTO_SIGN_BATCH_MAX )
+            {
+                next_crypto_worker_flush_batch( worker, true );
+                next_crypto_worker_wake( worker );
+            }
+
+            continue;
+        }
+
+        next_crypto_worker_process_job( job, worker->sign_private_key, worker->verify_public_key );
+
+        next_crypto_worker_push_result( worker, job );
+
+        next_crypto_worker_wake( worker );
+    }
+
+    // IMPORTANT: hand back any held jobs unverified so they are cleaned up with the result queue
+
+    next_crypto_worker_flush_batch( worker, false );
+}
+
+next_crypto_worker_t * next_crypto_worker_create( void * context, const uint8_t * sign_private_key, const uint8_t * verify_public_key, void (*wake_function)( void * wake_data ), void * wake_data )
+{
+    next_assert( sign_private_key );
+    next_assert( verify_public_key );
+
+    next_crypto_worker_t * worker = (next_crypto_worker_t*) next_malloc( context, sizeof(next_crypto_worker_t) );
+    if ( !worker )
+        return NULL;
+
+    memset( (char*) worker, 0, sizeof(next_crypto_worker_t) );
+
+    next_crypto_worker_initialize_sentinels( worker );
+
+    worker->context = context;
+    worker->wake_function = wake_function;
+    worker->wake_data = wake_data;
+    memcpy( worker->sign_private_key, sign_private_key, NEXT_CRYPTO_SIGN_SECRETKEYBYTES );
+    memcpy( worker->verify_public_key, verify_public_key, NEXT_CRYPTO_SIGN_PUBLICKEYBYTES );
+
+    worker->job_queue = next_queue_create( context, NEXT_CRYPTO_WORKER_QUEUE_LENGTH );
+    worker->result_queue = next_queue_create( context, NEXT_CRYPTO_WORKER_QUEUE_LENGTH );
+    if ( !worker->job_queue || !worker->result_queue )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "crypto worker could not create queues" );
+        next_crypto_worker_destroy( worker );
+        return NULL;
+    }
+
+    worker->job_mutex_created = next_platform_mutex_create( &worker->job_mutex ) == NEXT_OK;
+    worker->result_mutex_created = next_platform_mutex_create( &worker->result_mutex ) == NEXT_OK;
+    if ( !worker->job_mutex_created || !worker->result_mutex_created )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "crypto worker could not create mutexes" );
+        next_crypto_worker_destroy( worker );
+        return NULL;
+    }
+
+    worker->job_semaphore_created = next_platform_semaphore_create( &worker->job_semaphore ) == NEXT_OK;
+    if ( !worker->job_semaphore_created )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "crypto worker could not create semaphore" );
+        next_crypto_worker_destroy( worker );
+        return NULL;
+    }
+
+    worker->thread = next_platform_thread_create( context, next_crypto_worker_thread_function, worker );
+    if ( !worker->thread )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "crypto worker could not create thread" );
+        next_crypto_worker_destroy( worker );
+        return NULL;
+    }
+
+    next_crypto_worker_verify_sentinels( worker );
+
+    return worker;
+}
+
+void next_crypto_worker_destroy( next_crypto_worker_t * worker )
+{
+    next_crypto_worker_verify_sentinels( worker );
+
+    if ( worker->thread )
+    {
+        worker->quit = 1;
+        next_platform_semaphore_signal( &worker->job_semaphore );
+        next_platform_thread_join( worker->thread );
+        next_platform_thread_destroy( worker->thread );
+        worker->thread = NULL;
+    }
+
+    if ( worker->job_queue )
+    {
+        next_queue_destroy( worker->job_queue );
+    }
+
+    if ( worker->result_queue )
+    {
+        next_queue_destroy( worker->result_queue );
+    }
+
+    if ( worker->job_mutex_created )
+    {
+        next_platform_mutex_destroy( &worker->job_mutex );
+    }
+
+    if ( worker->result_mutex_created )
+    {
+        next_platform_mutex_destroy( &worker->result_mutex );
+    }
+
+    if ( worker->job_semaphore_created )
+    {
+        next_platform_semaphore_destroy( &worker->job_semaphore );
+    }
+
+    next_crypto_worker_verify_sentinels( worker );
+
+    next_clear_and_free( worker->context, worker, sizeof(next_crypto_worker_t) );
+}
+
+next_crypto_worker_job_t * next_crypto_worker_create_job( next_crypto_worker_t * worker, int type )
+{
+    next_crypto_worker_verify_sentinels( worker );
+
+    next_crypto_worker_job_t * job = (next_crypto_worker_job_t*) next_malloc( worker->context, sizeof(next_crypto_worker_job_t) );
+    if ( !job )
+        return NULL;
+
+    next_assert( ( size_t(job->packet_data) % 4 ) == 0 );
+
+    job->cache_sequence = 0;
+    job->type = type;
+    job->packet_bytes = 0;
+    job->packet_id = 0;
+    job->verified = false;
+    memset( &job->address, 0, sizeof(next_address_t) );
+    memset( job->magic, 0, sizeof(job->magic) );
+    memset( job->from_address_data, 0, sizeof(job->from_address_data) );
+    memset( job->to_address_data, 0, sizeof(job->to_address_data) );
+
+    return job;
+}
+
+void next_crypto_worker_destroy_job( next_crypto_worker_t * worker, next_crypto_worker_job_t * job )
+{
+    next_crypto_worker_verify_sentinels( worker );
+    next_assert( job );
+    next_free( worker->context, job );
+}
+
+int next_crypto_worker_submit( next_crypto_worker_t * worker, next_crypto_worker_job_t * job )
+{
+    next_crypto_worker_verify_sentinels( worker );
+
+    next_assert( job );
+
+    // IMPORTANT: on failure the caller still owns the job, so it can fall back to doing the crypto inline
+
+    if ( worker->num_jobs_in_flight.fetch_add( 1 ) >= NEXT_CRYPTO_WORKER_QUEUE_LENGTH )
+    {
+        worker->num_jobs_in_flight--;
+        return NEXT_ERROR;
+    }
+
+    {
+        next_platform_mutex_guard( &worker->job_mutex );
+        const int result = next_queue_push( worker->job_queue, job );
+        next_assert( result == NEXT_OK );
+        (void) result;
+    }
+
+    next_platform_semaphore_signal( &worker->job_semaphore );
+
+    return NEXT_OK;
+}
+
+next_crypto_worker_job_t * next_crypto_worker_poll( next_crypto_worker_t * worker )
+{
+    next_crypto_worker_verify_sentinels( worker );
+
+    next_crypto_worker_job_t * job = NULL;
+    {
+        next_platform_mutex_guard( &worker->result_mutex );
+        job = (next_crypto_worker_job_t*) next_queue_pop( worker->result_queue );
+    }
+
+    if ( job )
+    {
+        worker->num_jobs_in_flight--;
+    }
+
+    return job;
+}
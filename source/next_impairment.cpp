@@ -0,0 +1,732 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "next_impairment.h"
+
+#if NEXT_DEVELOPMENT
+
+#include "next_memory_checks.h"
+#include "next_constants.h"
+#include "next_address.h"
+#include "next_platform.h"
+
+#include <atomic>
+#include <memory.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct next_impairment_packet_t
+{
+    next_impairment_packet_t * next;
+    next_platform_socket_t * socket;
+    next_address_t to;
+    int packet_bytes;
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+};
+
+struct next_impairment_rule_t
+{
+    bool active;
+    next_address_t address;                     // IMPORTANT: port 0 matches any port at this address
+    next_impairment_config_t config;
+    int burst_remaining;
+};
+
+struct next_impairment_t
+{
+    NEXT_DECLARE_SENTINEL(0)
+
+    next_platform_thread_t * thread;
+    next_platform_mutex_t mutex;
+    bool mutex_created;
+    std::atomic<uint64_t> quit;
+
+    NEXT_DECLARE_SENTINEL(1)
+
+    uint64_t random_state;
+    next_impairment_rule_t default_rule;
+    next_impairment_rule_t rules[NEXT_IMPAIRMENT_MAX_RULES];
+
+    NEXT_DECLARE_SENTINEL(2)
+
+    double start_time;
+    uint64_t current_tick;
+    next_impairment_packet_t * slot_head[NEXT_IMPAIRMENT_WHEEL_SLOTS];
+    next_impairment_packet_t * slot_tail[NEXT_IMPAIRMENT_WHEEL_SLOTS];
+    next_impairment_packet_t * free_packets;
+    int num_packets_allocated;
+    int num_packets_in_flight;
+
+    NEXT_DECLARE_SENTINEL(3)
+
+    next_impairment_stats_t stats;
+
+    NEXT_DECLARE_SENTINEL(4)
+};
+
+void next_impairment_initialize_sentinels( next_impairment_t * impairment )
+{
+    (void) impairment;
+    next_assert( impairment );
+    NEXT_INITIALIZE_SENTINEL( impairment, 0 )
+    NEXT_INITIALIZE_SENTINEL( impairment, 1 )
+    NEXT_INITIALIZE_SENTINEL( impairment, 2 )
+    NEXT_INITIALIZE_SENTINEL( impairment, 3 )
+    NEXT_INITIALIZE_SENTINEL( impairment, 4 )
+}
+
+void next_impairment_verify_sentinels( next_impairment_t * impairment )
+{
+    (void) impairment;
+    next_assert( impairment );
+    NEXT_VERIFY_SENTINEL( impairment, 0 )
+    NEXT_VERIFY_SENTINEL( impairment, 1 )
+    NEXT_VERIFY_SENTINEL( impairment, 2 )
+    NEXT_VERIFY_SENTINEL( impairment, 3 )
+    NEXT_VERIFY_SENTINEL( impairment, 4 )
+}
+
+// ---------------------------------------------------------------
+
+static next_impairment_t * next_impairment = NULL;
+
+static std::atomic<bool> next_impairment_active( false );
+
+static uint64_t next_impairment_seed_value = 0x4E455854494D5041ULL;
+
+// IMPORTANT: set while the delivery thread sends a packet that was held back, so it goes straight out this time
+
+static thread_local bool next_impairment_delivering = false;
+
+static uint64_t next_impairment_random_seed( uint64_t seed )
+{
+    // splitmix64, so nearby seeds give unrelated sequences and the state is never zero
+
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    z = z ^ ( z >> 31 );
+    return z ? z : 1;
+}
+
+static uint64_t next_impairment_random( next_impairment_t * impairment )
+{
+    // xorshift64*
+
+    uint64_t x = impairment->random_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    impairment->random_state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static float next_impairment_random_percent( next_impairment_t * impairment )
+{
+    return float( next_impairment_random( impairment ) >> 40 ) / float( 1 << 24 ) * 100.0f;
+}
+
+static float next_impairment_random_ms( next_impairment_t * impairment, float max_ms )
+{
+    if ( max_ms <= 0.0f )
+        return 0.0f;
+    return float( next_impairment_random( impairment ) >> 40 ) / float( 1 << 24 ) * max_ms;
+}
+
+// ---------------------------------------------------------------
+
+static void next_impairment_advance( next_impairment_t * impairment, double time )
+{
+    const uint64_t target_tick = uint64_t( ( time - impairment->start_time ) / NEXT_IMPAIRMENT_SLOT_SECONDS );
+
+    next_impairment_delivering = true;
+
+    while ( impairment->current_tick < target_tick )
+    {
+        impairment->current_tick++;
+
+        const int slot = int( impairment->current_tick % NEXT_IMPAIRMENT_WHEEL_SLOTS );
+
+        next_impairment_packet_t * packet = impairment->slot_head[slot];
+
+        impairment->slot_head[slot] = NULL;
+        impairment->slot_tail[slot] = NULL;
+
+        while ( packet )
+        {
+            next_impairment_packet_t * next = packet->next;
+            next_platform_socket_send_packet( packet->socket, &packet->to, packet->packet_data, packet->packet_bytes );
+            packet->next = impairment->free_packets;
+            impairment->free_packets = packet;
+            impairment->num_packets_in_flight--;
+            packet = next;
+        }
+    }
+
+    next_impairment_delivering = false;
+}
+
+static void next_impairment_thread_function( void * context )
+{
+    next_assert( context );
+
+    next_impairment_t * impairment = (next_impairment_t*) context;
+
+    while ( !impairment->quit )
+    {
+        next_platform_sleep( NEXT_IMPAIRMENT_SLOT_SECONDS );
+
+        next_platform_mutex_guard( &impairment->mutex );
+
+        next_impairment_advance( impairment, next_platform_time() );
+    }
+}
+
+static void next_impairment_destroy( next_impairment_t * impairment );
+
+static next_impairment_t * next_impairment_create()
+{
+    next_impairment_t * impairment = (next_impairment_t*) next_malloc( NULL, sizeof(next_impairment_t) );
+    if ( !impairment )
+        return NULL;
+
+    memset( (char*) impairment, 0, sizeof(next_impairment_t) );
+
+    next_impairment_initialize_sentinels( impairment );
+
+    impairment->random_state = next_impairment_random_seed( next_impairment_seed_value );
+    impairment->start_time = next_platform_time();
+
+    impairment->mutex_created = next_platform_mutex_create( &impairment->mutex ) == NEXT_OK;
+    if ( !impairment->mutex_created )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "impairment could not create mutex" );
+        next_impairment_destroy( impairment );
+        return NULL;
+    }
+
+    impairment->thread = next_platform_thread_create( NULL, next_impairment_thread_function, impairment );
+    if ( !impairment->thread )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "impairment could not create thread" );
+        next_impairment_destroy( impairment );
+        return NULL;
+    }
+
+    next_impairment_verify_sentinels( impairment );
+
+    return impairment;
+}
+
+static void next_impairment_destroy( next_impairment_t * impairment )
+{
+    next_impairment_verify_sentinels( impairment );
+
+    if ( impairment->thread )
+    {
+        impairment->quit = 1;
+        next_platform_thread_join( impairment->thread );
+        next_platform_thread_destroy( impairment->thread );
+        impairment->thread = NULL;
+    }
+
+    // IMPORTANT: packets still in the wheel are dropped
+
+    for ( int i = 0; i < NEXT_IMPAIRMENT_WHEEL_SLOTS; ++i )
+    {
+        next_impairment_packet_t * packet = impairment->slot_head[i];
+        while ( packet )
+        {
+            next_impairment_packet_t * next = packet->next;
+            next_free( NULL, packet );
+            packet = next;
+        }
+    }
+
+    next_impairment_packet_t * packet = impairment->free_packets;
+    while ( packet )
+    {
+        next_impairment_packet_t * next = packet->next;
+        next_free( NULL, packet );
+        packet = next;
+    }
+
+    if ( impairment->mutex_created )
+    {
+        next_platform_mutex_destroy( &impairment->mutex );
+    }
+
+    next_impairment_verify_sentinels( impairment );
+
+    next_clear_and_free( NULL, impairment, sizeof(next_impairment_t) );
+}
+
+// ---------------------------------------------------------------
+
+int next_impairment_parse( const char * string, next_impairment_config_t * config )
+{
+    next_assert( string );
+    next_assert( config );
+
+    memset( config, 0, sizeof(next_impairment_config_t) );
+    config->burst_length = 1;
+
+    char buffer[256];
+    next_copy_string( buffer, string, sizeof(buffer) );
+
+    char * p = buffer;
+    while ( *p )
+    {
+        char * end = strchr( p, ',' );
+        if ( end )
+        {
+            *end = '\0';
+        }
+
+        char * equals = strchr( p, '=' );
+        if ( !equals )
+            return NEXT_ERROR;
+
+        *equals = '\0';
+
+        const char * key = p;
+        const char * value_string = equals + 1;
+
+        char * value_end = NULL;
+        const float value = float( strtod( value_string, &value_end ) );
+        if ( value_end == value_string || *value_end != '\0' || value < 0.0f )
+            return NEXT_ERROR;
+
+        if ( strcmp( key, "latency" ) == 0 )
+            config->latency_ms = value;
+        else if ( strcmp( key, "jitter" ) == 0 )
+            config->jitter_ms = value;
+        else if ( strcmp( key, "loss" ) == 0 )
+            config->packet_loss_percent = value;
+        else if ( strcmp( key, "burst" ) == 0 )
+            config->burst_loss_percent = value;
+        else if ( strcmp( key, "burst_length" ) == 0 )
+            config->burst_length = int( value );
+        else if ( strcmp( key, "reorder" ) == 0 )
+            config->reorder_percent = value;
+        else if ( strcmp( key, "reorder_ms" ) == 0 )
+            config->reorder_ms = value;
+        else if ( strcmp( key, "duplicate" ) == 0 )
+            config->duplicate_percent = value;
+        else
+            return NEXT_ERROR;
+
+        if ( !end )
+            break;
+
+        p = end + 1;
+    }
+
+    return NEXT_OK;
+}
+
+static bool next_impairment_any_rule_active( next_impairment_t * impairment )
+{
+    if ( impairment->default_rule.active )
+        return true;
+
+    for ( int i = 0; i < NEXT_IMPAIRMENT_MAX_RULES; ++i )
+    {
+        if ( impairment->rules[i].active )
+            return true;
+    }
+
+    return false;
+}
+
+void next_impairment_seed( uint64_t seed )
+{
+    next_impairment_seed_value = seed;
+
+    if ( next_impairment )
+    {
+        next_platform_mutex_guard( &next_impairment->mutex );
+        next_impairment->random_state = next_impairment_random_seed( seed );
+    }
+}
+
+int next_impairment_set( const next_address_t * address, const next_impairment_config_t * config )
+{
+    if ( !next_impairment )
+    {
+        if ( !config )
+            return NEXT_OK;
+
+        next_impairment = next_impairment_create();
+        if ( !next_impairment )
+            return NEXT_ERROR;
+    }
+
+    next_platform_mutex_guard( &next_impairment->mutex );
+
+    next_impairment_rule_t * rule = NULL;
+
+    if ( address )
+    {
+        next_impairment_rule_t * free_rule = NULL;
+
+        for ( int i = 0; i < NEXT_IMPAIRMENT_MAX_RULES; ++i )
+        {
+            if ( next_impairment->rules[i].active && next_address_equal( &next_impairment->rules[i].address, address ) )
+            {
+                rule = &next_impairment->rules[i];
+                break;
+            }
+
+            if ( !free_rule && !next_impairment->rules[i].active )
+            {
+                free_rule = &next_impairment->rules[i];
+            }
+        }
+
+        if ( !rule )
+        {
+            if ( !config )
+                return NEXT_OK;
+
+            if ( !free_rule )
+            {
+                next_printf( NEXT_LOG_LEVEL_ERROR, "impairment has no room for another rule (max %d)", NEXT_IMPAIRMENT_MAX_RULES );
+                return NEXT_ERROR;
+            }
+
+            rule = free_rule;
+            rule->address = *address;
+        }
+    }
+    else
+    {
+        rule = &next_impairment->default_rule;
+    }
+
+    if ( config )
+    {
+        rule->active = true;
+        rule->config = *config;
+        rule->burst_remaining = 0;
+    }
+    else
+    {
+        memset( rule, 0, sizeof(next_impairment_rule_t) );
+    }
+
+    next_impairment_active = next_impairment_any_rule_active( next_impairment );
+
+    return NEXT_OK;
+}
+
+void next_impairment_clear()
+{
+    if ( !next_impairment )
+        return;
+
+    next_platform_mutex_guard( &next_impairment->mutex );
+
+    memset( &next_impairment->default_rule, 0, sizeof(next_impairment_rule_t) );
+    memset( next_impairment->rules, 0, sizeof(next_impairment->rules) );
+
+    next_impairment_active = false;
+}
+
+void next_impairment_stats( next_impairment_stats_t * stats )
+{
+    next_assert( stats );
+
+    memset( stats, 0, sizeof(next_impairment_stats_t) );
+
+    if ( !next_impairment )
+        return;
+
+    next_platform_mutex_guard( &next_impairment->mutex );
+
+    *stats = next_impairment->stats;
+}
+
+// ---------------------------------------------------------------
+
+static next_impairment_rule_t * next_impairment_find_rule( next_impairment_t * impairment, const next_address_t * to )
+{
+    next_impairment_rule_t * address_rule = NULL;
+
+    for ( int i = 0; i < NEXT_IMPAIRMENT_MAX_RULES; ++i )
+    {
+        next_impairment_rule_t * rule = &impairment->rules[i];
+
+        if ( !rule->active )
+            continue;
+
+        if ( next_address_equal( &rule->address, to ) )
+            return rule;
+
+        if ( rule->address.port == 0 && !address_rule )
+        {
+            next_address_t any_port = *to;
+            any_port.port = 0;
+            if ( next_address_equal( &rule->address, &any_port ) )
+            {
+                address_rule = rule;
+            }
+        }
+    }
+
+    if ( address_rule )
+        return address_rule;
+
+    return impairment->default_rule.active ? &impairment->default_rule : NULL;
+}
+
+static bool next_impairment_schedule( next_impairment_t * impairment, next_platform_socket_t * socket, const next_address_t * to, const void * packet_data, int packet_bytes, double delay_ms, double time )
+{
+    const uint64_t now_tick = uint64_t( ( time - impairment->start_time ) / NEXT_IMPAIRMENT_SLOT_SECONDS );
+
+    uint64_t tick = now_tick + uint64_t( delay_ms / 1000.0 / NEXT_IMPAIRMENT_SLOT_SECONDS + 0.5 );
+
+    if ( tick <= impairment->current_tick )
+    {
+        tick = impairment->current_tick + 1;
+    }
+
+    if ( tick >= impairment->current_tick + NEXT_IMPAIRMENT_WHEEL_SLOTS )
+    {
+        tick = impairment->current_tick + NEXT_IMPAIRMENT_WHEEL_SLOTS - 1;
+    }
+
+    next_impairment_packet_t * packet = impairment->free_packets;
+    if ( packet )
+    {
+        impairment->free_packets = packet->next;
+    }
+    else
+    {
+        if ( impairment->num_packets_allocated >= NEXT_IMPAIRMENT_MAX_PACKETS )
+            return false;
+
+        packet = (next_impairment_packet_t*) next_malloc( NULL, sizeof(next_impairment_packet_t) );
+        if ( !packet )
+            return false;
+
+        impairment->num_packets_allocated++;
+    }
+
+    packet->next = NULL;
+    packet->socket = socket;
+    packet->to = *to;
+    packet->packet_bytes = packet_bytes;
+    memcpy( packet->packet_data, packet_data, packet_bytes );
+
+    // IMPORTANT: append, so packets that land in the same slot go out in the order they were sent
+
+    const int slot = int( tick % NEXT_IMPAIRMENT_WHEEL_SLOTS );
+
+    if ( impairment->slot_tail[slot] )
+    {
+        impairment->slot_tail[slot]->next = packet;
+    }
+    else
+    {
+        impairment->slot_head[slot] = packet;
+    }
+
+    impairment->slot_tail[slot] = packet;
+
+    impairment->num_packets_in_flight++;
+
+    if ( impairment->num_packets_in_flight > impairment->stats.max_packets_in_flight )
+    {
+        impairment->stats.max_packets_in_flight = impairment->num_packets_in_flight;
+    }
+
+    return true;
+}
+
+bool next_impairment_send( next_platform_socket_t * socket, const next_address_t * to, const void * packet_data, int packet_bytes )
+{
+    if ( !next_impairment_active.load( std::memory_order_relaxed ) || next_impairment_delivering )
+        return false;
+
+    next_assert( socket );
+    next_assert( to );
+    next_assert( packet_data );
+    next_assert( packet_bytes > 0 );
+    next_assert( packet_bytes <= NEXT_MAX_PACKET_BYTES );
+
+    next_impairment_t * impairment = next_impairment;
+
+    next_assert( impairment );
+
+    int num_immediate = 0;
+
+    {
+        next_platform_mutex_guard( &impairment->mutex );
+
+        next_impairment_rule_t * rule = next_impairment_find_rule( impairment, to );
+        if ( !rule )
+            return false;
+
+        const next_impairment_config_t & config = rule->config;
+
+        impairment->stats.packets_sent++;
+
+        // loss. bursts drop this packet and the ones after it to the same destination
+
+        if ( rule->burst_remaining > 0 )
+        {
+            rule->burst_remaining--;
+            impairment->stats.packets_dropped++;
+            return true;
+        }
+
+        if ( config.burst_loss_percent > 0.0f && next_impairment_random_percent( impairment ) < config.burst_loss_percent )
+        {
+            rule->burst_remaining = ( config.burst_length > 1 ) ? config.burst_length - 1 : 0;
+            impairment->stats.packets_dropped++;
+            return true;
+        }
+
+        if ( config.packet_loss_percent > 0.0f && next_impairment_random_percent( impairment ) < config.packet_loss_percent )
+        {
+            impairment->stats.packets_dropped++;
+            return true;
+        }
+
+        const bool duplicate = config.duplicate_percent > 0.0f && next_impairment_random_percent( impairment ) < config.duplicate_percent;
+
+        if ( duplicate )
+        {
+            impairment->stats.packets_duplicated++;
+        }
+
+        const double time = next_platform_time();
+
+        const int num_copies = duplicate ? 2 : 1;
+
+        for ( int i = 0; i < num_copies; ++i )
+        {
+            double delay_ms = config.latency_ms + next_impairment_random_ms( impairment, config.jitter_ms );
+
+            if ( config.reorder_percent > 0.0f && next_impairment_random_percent( impairment ) < config.reorder_percent )
+            {
+                delay_ms += config.reorder_ms;
+                impairment->stats.packets_reordered++;
+            }
+
+            // IMPORTANT: below half a slot the packet goes out now. This keeps loss only impairment free of extra latency
+
+            if ( delay_ms < NEXT_IMPAIRMENT_SLOT_SECONDS * 1000.0 * 0.5 )
+            {
+                num_immediate++;
+                continue;
+            }
+
+            if ( next_impairment_schedule( impairment, socket, to, packet_data, packet_bytes, delay_ms, time ) )
+            {
+                impairment->stats.packets_delayed++;
+            }
+            else
+            {
+                impairment->stats.packets_overflowed++;
+            }
+        }
+    }
+
+    next_impairment_delivering = true;
+
+    for ( int i = 0; i < num_immediate; ++i )
+    {
+        next_platform_socket_send_packet( socket, to, packet_data, packet_bytes );
+    }
+
+    next_impairment_delivering = false;
+
+    return true;
+}
+
+void next_impairment_purge( next_platform_socket_t * socket )
+{
+    next_impairment_t * impairment = next_impairment;
+
+    if ( !impairment )
+        return;
+
+    next_platform_mutex_guard( &impairment->mutex );
+
+    for ( int i = 0; i < NEXT_IMPAIRMENT_WHEEL_SLOTS; ++i )
+    {
+        next_impairment_packet_t * previous = NULL;
+        next_impairment_packet_t * packet = impairment->slot_head[i];
+
+        while ( packet )
+        {
+            next_impairment_packet_t * next = packet->next;
+
+            if ( packet->socket == socket )
+            {
+                if ( previous )
+                {
+                    previous->next = next;
+                }
+                else
+                {
+                    impairment->slot_head[i] = next;
+                }
+
+                if ( impairment->slot_tail[i] == packet )
+                {
+                    impairment->slot_tail[i] = previous;
+                }
+
+                packet->next = impairment->free_packets;
+                impairment->free_packets = packet;
+                impairment->num_packets_in_flight--;
+            }
+            else
+            {
+                previous = packet;
+            }
+
+            packet = next;
+        }
+    }
+}
+
+void next_impairment_term()
+{
+    if ( !next_impairment )
+        return;
+
+    next_impairment_active = false;
+
+    next_impairment_destroy( next_impairment );
+
+    next_impairment = NULL;
+}
+
+#else // #if NEXT_DEVELOPMENT
+
+int next_impairment_dummy_symbol = 0;
+
+#endif // #if NEXT_DEVELOPMENT
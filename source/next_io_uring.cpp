@@ -0,0 +1,816 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "next_io_uring.h"
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define NEXT_IO_URING_HEADERS 1
+#endif // #if __has_include(<linux/io_uring.h>)
+#endif // #if defined(__has_include)
+
+#if NEXT_IO_URING_HEADERS
+
+#include "next_memory_checks.h"
+#include "next_constants.h"
+#include "next_platform.h"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#define NEXT_IO_URING_RECEIVE_USER_DATA         0xFFFFFFFFFFFFFFFFULL
+#define NEXT_IO_URING_CANCEL_USER_DATA          0xFFFFFFFFFFFFFFFEULL
+
+struct next_io_uring_send_slot_t
+{
+    msghdr msg;
+    iovec iov;
+    sockaddr_storage to;
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+};
+
+struct next_io_uring_t
+{
+    NEXT_DECLARE_SENTINEL(0)
+
+    void * context;
+    int ring_fd;
+
+    void * ring_memory;
+    size_t ring_memory_bytes;
+    io_uring_sqe * sqes;
+    size_t sqes_bytes;
+
+    unsigned * sq_head;
+    unsigned * sq_tail;
+    unsigned * sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+
+    unsigned * cq_head;
+    unsigned * cq_tail;
+    io_uring_cqe * cqes;
+    unsigned cq_mask;
+
+    NEXT_DECLARE_SENTINEL(1)
+
+    next_platform_mutex_t sq_mutex;
+    bool sq_mutex_created;
+    unsigned sq_pending;
+    int free_send_slots[NEXT_IO_URING_SEND_SLOTS];
+    int num_free_send_slots;
+    next_io_uring_send_slot_t * send_slots;
+
+    NEXT_DECLARE_SENTINEL(2)
+
+    io_uring_buf_ring * buffer_ring;
+    size_t buffer_ring_bytes;
+    uint8_t * receive_buffers;
+    size_t receive_buffers_bytes;
+    uint16_t buffer_ring_tail;
+    msghdr receive_msg;
+    bool receive_armed;
+
+    NEXT_DECLARE_SENTINEL(3)
+};
+
+static thread_local next_io_uring_t * next_io_uring_batch = NULL;
+static thread_local int next_io_uring_batch_depth = 0;
+
+static void next_io_uring_verify_sentinels( next_io_uring_t * uring )
+{
+    (void) uring;
+    next_assert( uring );
+    NEXT_VERIFY_SENTINEL( uring, 0 )
+    NEXT_VERIFY_SENTINEL( uring, 1 )
+    NEXT_VERIFY_SENTINEL( uring, 2 )
+    NEXT_VERIFY_SENTINEL( uring, 3 )
+}
+
+static int next_io_uring_enter( int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void * arg, size_t arg_bytes )
+{
+    return int( syscall( __NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_bytes ) );
+}
+
+static int next_io_uring_register( int ring_fd, unsigned opcode, void * arg, unsigned num_args )
+{
+    return int( syscall( __NR_io_uring_register, ring_fd, opcode, arg, num_args ) );
+}
+
+static const int NEXT_IO_URING_RECEIVE_CONTROL_BYTES = CMSG_SPACE( sizeof( timespec ) );
+
+static const int NEXT_IO_URING_RECEIVE_BUFFER_BYTES = int( sizeof( io_uring_recvmsg_out ) + sizeof( sockaddr_storage ) ) + NEXT_IO_URING_RECEIVE_CONTROL_BYTES + NEXT_MAX_PACKET_BYTES;
+
+// ---------------------------------------------------------------
+
+static io_uring_sqe * next_io_uring_get_sqe( next_io_uring_t * uring )
+{
+    // IMPORTANT: call with the sq mutex held
+
+    const unsigned head = __atomic_load_n( uring->sq_head, __ATOMIC_ACQUIRE );
+    const unsigned tail = *uring->sq_tail;
+
+    if ( tail - head >= uring->sq_entries )
+        return NULL;
+
+    const unsigned index = tail & uring->sq_mask;
+    io_uring_sqe * sqe = &uring->sqes[index];
+    memset( sqe, 0, sizeof(io_uring_sqe) );
+    uring->sq_array[index] = index;
+    return sqe;
+}
+
+static void next_io_uring_push_sqe( next_io_uring_t * uring )
+{
+    // IMPORTANT: call with the sq mutex held, after filling the sqe from next_io_uring_get_sqe
+
+    __atomic_store_n( uring->sq_tail, *uring->sq_tail + 1, __ATOMIC_RELEASE );
+    uring->sq_pending++;
+}
+
+static unsigned next_io_uring_take_pending( next_io_uring_t * uring )
+{
+    next_platform_mutex_acquire( &uring->sq_mutex );
+    const unsigned to_submit = uring->sq_pending;
+    uring->sq_pending = 0;
+    next_platform_mutex_release( &uring->sq_mutex );
+    return to_submit;
+}
+
+static void next_io_uring_return_pending( next_io_uring_t * uring, unsigned to_submit, int result )
+{
+    // entries the kernel didn't take stay in the sq, so they are counted again for the next submit
+
+    const unsigned submitted = result > 0 ? unsigned( result ) : 0;
+    if ( submitted >= to_submit )
+        return;
+
+    next_platform_mutex_acquire( &uring->sq_mutex );
+    uring->sq_pending += to_submit - submitted;
+    next_platform_mutex_release( &uring->sq_mutex );
+}
+
+static void next_io_uring_submit( next_io_uring_t * uring )
+{
+    const unsigned to_submit = next_io_uring_take_pending( uring );
+    if ( to_submit == 0 )
+        return;
+
+    int result = next_io_uring_enter( uring->ring_fd, to_submit, 0, 0, NULL, 0 );
+    if ( result < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring submit failed (%d)", errno );
+    }
+
+    next_io_uring_return_pending( uring, to_submit, result );
+}
+
+static bool next_io_uring_arm_receive( next_io_uring_t * uring )
+{
+    next_platform_mutex_acquire( &uring->sq_mutex );
+
+    io_uring_sqe * sqe = next_io_uring_get_sqe( uring );
+    if ( sqe )
+    {
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = 0;
+        sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+        sqe->addr = (uint64_t) &uring->receive_msg;
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->buf_group = 0;
+        sqe->user_data = NEXT_IO_URING_RECEIVE_USER_DATA;
+        next_io_uring_push_sqe( uring );
+    }
+
+    next_platform_mutex_release( &uring->sq_mutex );
+
+    if ( sqe )
+    {
+        uring->receive_armed = true;
+    }
+
+    return sqe != NULL;
+}
+
+static void next_io_uring_free_send_slot( next_io_uring_t * uring, int slot_index )
+{
+    next_platform_mutex_acquire( &uring->sq_mutex );
+    next_assert( uring->num_free_send_slots < NEXT_IO_URING_SEND_SLOTS );
+    uring->free_send_slots[uring->num_free_send_slots++] = slot_index;
+    next_platform_mutex_release( &uring->sq_mutex );
+}
+
+static void next_io_uring_add_buffer( next_io_uring_t * uring, int buffer_id )
+{
+    const unsigned index = uring->buffer_ring_tail & ( NEXT_IO_URING_RECEIVE_BUFFERS - 1 );
+    // IMPORTANT: the uapi header declares bufs as a flexible array inside a union, which c++ places at offset 8, not 0.
+    // the kernel reads entries from the start of the ring (the tail overlays the reserved field of the first entry)
+    io_uring_buf * buffer = ( (io_uring_buf*) uring->buffer_ring ) + index;
+    buffer->addr = (uint64_t) ( uring->receive_buffers + size_t( buffer_id ) * NEXT_IO_URING_RECEIVE_BUFFER_BYTES );
+    buffer->len = NEXT_IO_URING_RECEIVE_BUFFER_BYTES;
+    buffer->bid = uint16_t( buffer_id );
+    uring->buffer_ring_tail++;
+    __atomic_store_n( &uring->buffer_ring->tail, uring->buffer_ring_tail, __ATOMIC_RELEASE );
+}
+
+// ---------------------------------------------------------------
+
+next_io_uring_t * next_io_uring_create( void * context, int socket_handle )
+{
+    static_assert( ( NEXT_IO_URING_RECEIVE_BUFFERS & ( NEXT_IO_URING_RECEIVE_BUFFERS - 1 ) ) == 0, "receive buffers must be a power of two" );
+
+    next_io_uring_t * uring = (next_io_uring_t*) next_malloc( context, sizeof(next_io_uring_t) );
+    if ( !uring )
+        return NULL;
+
+    memset( uring, 0, sizeof(next_io_uring_t) );
+
+    NEXT_INITIALIZE_SENTINEL( uring, 0 )
+    NEXT_INITIALIZE_SENTINEL( uring, 1 )
+    NEXT_INITIALIZE_SENTINEL( uring, 2 )
+    NEXT_INITIALIZE_SENTINEL( uring, 3 )
+
+    uring->context = context;
+    uring->ring_fd = -1;
+
+    // IMPORTANT: any failure below means the kernel is too old or io_uring is disabled. the caller falls back to regular socket calls
+
+    io_uring_params params;
+    memset( &params, 0, sizeof(params) );
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = NEXT_IO_URING_CQ_ENTRIES;
+
+    uring->ring_fd = int( syscall( __NR_io_uring_setup, NEXT_IO_URING_SQ_ENTRIES, &params ) );
+    if ( uring->ring_fd < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring setup failed (%d)", errno );
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    if ( ( params.features & IORING_FEAT_SINGLE_MMAP ) == 0 || ( params.features & IORING_FEAT_EXT_ARG ) == 0 || ( params.features & IORING_FEAT_NODROP ) == 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring is missing required features (%x)", params.features );
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    const size_t sq_ring_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const size_t cq_ring_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    uring->ring_memory_bytes = sq_ring_bytes > cq_ring_bytes ? sq_ring_bytes : cq_ring_bytes;
+    uring->ring_memory = mmap( NULL, uring->ring_memory_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING );
+    if ( uring->ring_memory == MAP_FAILED )
+    {
+        uring->ring_memory = NULL;
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    uring->sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+    uring->sqes = (io_uring_sqe*) mmap( NULL, uring->sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQES );
+    if ( uring->sqes == MAP_FAILED )
+    {
+        uring->sqes = NULL;
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    uint8_t * ring = (uint8_t*) uring->ring_memory;
+    uring->sq_head = (unsigned*) ( ring + params.sq_off.head );
+    uring->sq_tail = (unsigned*) ( ring + params.sq_off.tail );
+    uring->sq_array = (unsigned*) ( ring + params.sq_off.array );
+    uring->sq_mask = *(unsigned*) ( ring + params.sq_off.ring_mask );
+    uring->sq_entries = params.sq_entries;
+    uring->cq_head = (unsigned*) ( ring + params.cq_off.head );
+    uring->cq_tail = (unsigned*) ( ring + params.cq_off.tail );
+    uring->cqes = (io_uring_cqe*) ( ring + params.cq_off.cqes );
+    uring->cq_mask = *(unsigned*) ( ring + params.cq_off.ring_mask );
+
+    if ( next_io_uring_register( uring->ring_fd, IORING_REGISTER_FILES, &socket_handle, 1 ) < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring could not register socket (%d)", errno );
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    // provided receive buffers
+
+    uring->buffer_ring_bytes = NEXT_IO_URING_RECEIVE_BUFFERS * sizeof(io_uring_buf);
+    uring->buffer_ring = (io_uring_buf_ring*) mmap( NULL, uring->buffer_ring_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( uring->buffer_ring == MAP_FAILED )
+    {
+        uring->buffer_ring = NULL;
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    uring->receive_buffers_bytes = size_t( NEXT_IO_URING_RECEIVE_BUFFERS ) * NEXT_IO_URING_RECEIVE_BUFFER_BYTES;
+    uring->receive_buffers = (uint8_t*) mmap( NULL, uring->receive_buffers_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( uring->receive_buffers == MAP_FAILED )
+    {
+        uring->receive_buffers = NULL;
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    io_uring_buf_reg buffer_reg;
+    memset( &buffer_reg, 0, sizeof(buffer_reg) );
+    buffer_reg.ring_addr = (uint64_t) uring->buffer_ring;
+    buffer_reg.ring_entries = NEXT_IO_URING_RECEIVE_BUFFERS;
+    buffer_reg.bgid = 0;
+    if ( next_io_uring_register( uring->ring_fd, IORING_REGISTER_PBUF_RING, &buffer_reg, 1 ) < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring could not register receive buffers (%d)", errno );
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    for ( int i = 0; i < NEXT_IO_URING_RECEIVE_BUFFERS; ++i )
+    {
+        next_io_uring_add_buffer( uring, i );
+    }
+
+    // send slots
+
+    uring->send_slots = (next_io_uring_send_slot_t*) next_malloc( context, NEXT_IO_URING_SEND_SLOTS * sizeof(next_io_uring_send_slot_t) );
+    if ( !uring->send_slots )
+    {
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+
+    for ( int i = 0; i < NEXT_IO_URING_SEND_SLOTS; ++i )
+    {
+        uring->free_send_slots[i] = NEXT_IO_URING_SEND_SLOTS - 1 - i;
+    }
+    uring->num_free_send_slots = NEXT_IO_URING_SEND_SLOTS;
+
+    if ( next_platform_mutex_create( &uring->sq_mutex ) != NEXT_OK )
+    {
+        next_io_uring_destroy( uring );
+        return NULL;
+    }
+    uring->sq_mutex_created = true;
+
+    // post the multishot receive. the kernel validates it on submit, so an old kernel fails it straight away
+
+    uring->receive_msg.msg_namelen = sizeof(sockaddr_storage);
+    uring->receive_msg.msg_controllen = NEXT_IO_URING_RECEIVE_CONTROL_BYTES;
+
+    next_io_uring_arm_receive( uring );
+    next_io_uring_submit( uring );
+
+    const unsigned cq_head = *uring->cq_head;
+    if ( cq_head != __atomic_load_n( uring->cq_tail, __ATOMIC_ACQUIRE ) )
+    {
+        io_uring_cqe * cqe = &uring->cqes[cq_head & uring->cq_mask];
+        if ( cqe->user_data == NEXT_IO_URING_RECEIVE_USER_DATA && cqe->res < 0 && cqe->res != -ENOBUFS )
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring multishot receive is not supported (%d)", -cqe->res );
+            next_io_uring_destroy( uring );
+            return NULL;
+        }
+    }
+
+    next_io_uring_verify_sentinels( uring );
+
+    return uring;
+}
+
+static bool next_io_uring_drain( next_io_uring_t * uring )
+{
+    // IMPORTANT: closing the ring fd doesn't stop the kernel straight away. ring teardown is async, so an in-flight sendmsg
+    // or the multishot recvmsg can still touch the send slots and receive buffers after close returns. cancel the receive,
+    // then wait until every send slot is back and the receive has posted its final completion before freeing anything.
+
+    if ( uring->receive_armed )
+    {
+        next_platform_mutex_acquire( &uring->sq_mutex );
+
+        io_uring_sqe * sqe = next_io_uring_get_sqe( uring );
+        if ( sqe )
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = NEXT_IO_URING_RECEIVE_USER_DATA;
+            sqe->user_data = NEXT_IO_URING_CANCEL_USER_DATA;
+            next_io_uring_push_sqe( uring );
+        }
+
+        next_platform_mutex_release( &uring->sq_mutex );
+    }
+
+    const double start_time = next_platform_time();
+
+    while ( uring->receive_armed || uring->num_free_send_slots < NEXT_IO_URING_SEND_SLOTS )
+    {
+        const double remaining = NEXT_IO_URING_DESTROY_TIMEOUT - ( next_platform_time() - start_time );
+        if ( remaining <= 0.0 )
+            return false;
+
+        const unsigned to_submit = next_io_uring_take_pending( uring );
+
+        __kernel_timespec ts;
+        ts.tv_sec = (long long) remaining;
+        ts.tv_nsec = (long long) ( ( remaining - double( ts.tv_sec ) ) * 1000000000.0 );
+
+        io_uring_getevents_arg arg;
+        memset( &arg, 0, sizeof(arg) );
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (uint64_t) &ts;
+
+        const int result = next_io_uring_enter( uring->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg) );
+
+        next_io_uring_return_pending( uring, to_submit, result < 0 ? 0 : result );
+
+        unsigned head = *uring->cq_head;
+        const unsigned tail = __atomic_load_n( uring->cq_tail, __ATOMIC_ACQUIRE );
+
+        while ( head != tail )
+        {
+            const io_uring_cqe cqe = uring->cqes[head & uring->cq_mask];
+            head++;
+
+            if ( cqe.user_data == NEXT_IO_URING_CANCEL_USER_DATA )
+                continue;
+
+            if ( cqe.user_data == NEXT_IO_URING_RECEIVE_USER_DATA )
+            {
+                if ( ( cqe.flags & IORING_CQE_F_MORE ) == 0 )
+                {
+                    uring->receive_armed = false;
+                }
+                continue;
+            }
+
+            next_assert( cqe.user_data < NEXT_IO_URING_SEND_SLOTS );
+            next_io_uring_free_send_slot( uring, int( cqe.user_data ) );
+        }
+
+        __atomic_store_n( uring->cq_head, head, __ATOMIC_RELEASE );
+    }
+
+    return true;
+}
+
+void next_io_uring_destroy( next_io_uring_t * uring )
+{
+    next_io_uring_verify_sentinels( uring );
+
+    // IMPORTANT: the send slots and sq mutex are created last, so if they exist the ring is fully set up and may have work in flight
+
+    if ( uring->send_slots && uring->sq_mutex_created && !next_io_uring_drain( uring ) )
+    {
+        // the kernel may still write into the receive buffers or read the send slots, so leak them rather than free them under it
+
+        next_printf( NEXT_LOG_LEVEL_WARN, "io_uring did not finish in-flight operations on destroy. leaking its buffers" );
+        uring->buffer_ring = NULL;
+        uring->receive_buffers = NULL;
+        uring->send_slots = NULL;
+    }
+
+    if ( uring->ring_fd >= 0 )
+    {
+        close( uring->ring_fd );
+    }
+
+    if ( uring->ring_memory )
+    {
+        munmap( uring->ring_memory, uring->ring_memory_bytes );
+    }
+
+    if ( uring->sqes )
+    {
+        munmap( uring->sqes, uring->sqes_bytes );
+    }
+
+    if ( uring->buffer_ring )
+    {
+        munmap( uring->buffer_ring, uring->buffer_ring_bytes );
+    }
+
+    if ( uring->receive_buffers )
+    {
+        munmap( uring->receive_buffers, uring->receive_buffers_bytes );
+    }
+
+    if ( uring->send_slots )
+    {
+        next_free( uring->context, uring->send_slots );
+    }
+
+    if ( uring->sq_mutex_created )
+    {
+        next_platform_mutex_destroy( &uring->sq_mutex );
+    }
+
+    if ( next_io_uring_batch == uring )
+    {
+        next_io_uring_batch = NULL;
+        next_io_uring_batch_depth = 0;
+    }
+
+    next_free( uring->context, uring );
+}
+
+bool next_io_uring_send( next_io_uring_t * uring, const sockaddr * to, socklen_t to_length, const void * packet_data, int packet_bytes )
+{
+    next_io_uring_verify_sentinels( uring );
+
+    next_assert( to );
+    next_assert( to_length <= sizeof(sockaddr_storage) );
+    next_assert( packet_data );
+    next_assert( packet_bytes > 0 );
+
+    if ( packet_bytes > NEXT_MAX_PACKET_BYTES )
+        return false;
+
+    next_platform_mutex_acquire( &uring->sq_mutex );
+
+    io_uring_sqe * sqe = uring->num_free_send_slots > 0 ? next_io_uring_get_sqe( uring ) : NULL;
+    if ( !sqe )
+    {
+        // out of send slots or sq entries. the caller sends this one with a regular syscall
+        next_platform_mutex_release( &uring->sq_mutex );
+        return false;
+    }
+
+    const int slot_index = uring->free_send_slots[--uring->num_free_send_slots];
+    next_io_uring_send_slot_t * slot = &uring->send_slots[slot_index];
+
+    memcpy( &slot->to, to, to_length );
+    memcpy( slot->packet_data, packet_data, packet_bytes );
+    slot->iov.iov_base = slot->packet_data;
+    slot->iov.iov_len = packet_bytes;
+    memset( &slot->msg, 0, sizeof(slot->msg) );
+    slot->msg.msg_name = &slot->to;
+    slot->msg.msg_namelen = to_length;
+    slot->msg.msg_iov = &slot->iov;
+    slot->msg.msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = 0;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = (uint64_t) &slot->msg;
+    sqe->len = 1;
+    sqe->user_data = uint64_t( slot_index );
+
+    next_io_uring_push_sqe( uring );
+
+    next_platform_mutex_release( &uring->sq_mutex );
+
+    // IMPORTANT: inside a batch on this thread, sends are submitted together when the batch ends or the receiver waits
+
+    if ( next_io_uring_batch != uring )
+    {
+        next_io_uring_submit( uring );
+    }
+
+    return true;
+}
+
+void next_io_uring_send_batch_begin( next_io_uring_t * uring )
+{
+    next_io_uring_verify_sentinels( uring );
+
+    if ( next_io_uring_batch != NULL && next_io_uring_batch != uring )
+        return;
+
+    next_io_uring_batch = uring;
+    next_io_uring_batch_depth++;
+}
+
+void next_io_uring_send_batch_end( next_io_uring_t * uring )
+{
+    next_io_uring_verify_sentinels( uring );
+
+    if ( next_io_uring_batch != uring )
+        return;
+
+    next_assert( next_io_uring_batch_depth > 0 );
+
+    if ( --next_io_uring_batch_depth > 0 )
+        return;
+
+    next_io_uring_batch = NULL;
+
+    next_io_uring_submit( uring );
+}
+
+static bool next_io_uring_reap( next_io_uring_t * uring, next_io_uring_packet_t * packet )
+{
+    // process completions until a received packet turns up. send completions just free their slot
+
+    unsigned head = *uring->cq_head;
+    const unsigned tail = __atomic_load_n( uring->cq_tail, __ATOMIC_ACQUIRE );
+
+    bool received = false;
+
+    while ( head != tail && !received )
+    {
+        const io_uring_cqe cqe = uring->cqes[head & uring->cq_mask];
+        head++;
+
+        if ( cqe.user_data != NEXT_IO_URING_RECEIVE_USER_DATA )
+        {
+            if ( cqe.res < 0 )
+            {
+                next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring send failed: %s", strerror( -cqe.res ) );
+            }
+            next_assert( cqe.user_data < NEXT_IO_URING_SEND_SLOTS );
+            next_io_uring_free_send_slot( uring, int( cqe.user_data ) );
+            continue;
+        }
+
+        if ( ( cqe.flags & IORING_CQE_F_MORE ) == 0 )
+        {
+            // the multishot receive ended, usually because every receive buffer was in use. repost it before waiting again
+            uring->receive_armed = false;
+        }
+
+        if ( ( cqe.flags & IORING_CQE_F_BUFFER ) == 0 )
+            continue;
+
+        const int buffer_id = int( cqe.flags >> IORING_CQE_BUFFER_SHIFT );
+
+        uint8_t * buffer = uring->receive_buffers + size_t( buffer_id ) * NEXT_IO_URING_RECEIVE_BUFFER_BYTES;
+
+        if ( cqe.res < int( sizeof(io_uring_recvmsg_out) ) )
+        {
+            next_io_uring_add_buffer( uring, buffer_id );
+            continue;
+        }
+
+        const io_uring_recvmsg_out * out = (const io_uring_recvmsg_out*) buffer;
+        uint8_t * name = buffer + sizeof(io_uring_recvmsg_out);
+        uint8_t * control = name + uring->receive_msg.msg_namelen;
+        uint8_t * payload = control + uring->receive_msg.msg_controllen;
+
+        const int payload_capacity = cqe.res - int( payload - buffer );
+        const int payload_bytes = int( out->payloadlen ) < payload_capacity ? int( out->payloadlen ) : payload_capacity;
+
+        if ( payload_bytes <= 0 || out->namelen > sizeof(sockaddr_storage) )
+        {
+            next_io_uring_add_buffer( uring, buffer_id );
+            continue;
+        }
+
+        memset( packet, 0, sizeof(next_io_uring_packet_t) );
+        packet->from = (const sockaddr_storage*) name;
+        packet->control.msg_control = control;
+        packet->control.msg_controllen = out->controllen;
+        packet->packet_data = payload;
+        packet->packet_bytes = payload_bytes;
+        packet->buffer_id = buffer_id;
+
+        received = true;
+    }
+
+    __atomic_store_n( uring->cq_head, head, __ATOMIC_RELEASE );
+
+    return received;
+}
+
+int next_io_uring_receive( next_io_uring_t * uring, next_io_uring_packet_t * packet, double timeout_seconds, double busy_poll_time )
+{
+    next_io_uring_verify_sentinels( uring );
+
+    next_assert( packet );
+
+    const double start_time = next_platform_time();
+
+    while ( true )
+    {
+        if ( next_io_uring_reap( uring, packet ) )
+            return 1;
+
+        if ( !uring->receive_armed )
+        {
+            next_io_uring_arm_receive( uring );
+        }
+
+        // IMPORTANT: in busy poll mode spin on the completion queue before falling back to waiting in the kernel
+
+        const double elapsed = next_platform_time() - start_time;
+
+        if ( busy_poll_time > 0.0 && elapsed < busy_poll_time )
+        {
+            next_io_uring_submit( uring );
+            continue;
+        }
+
+        if ( timeout_seconds == 0.0 || ( timeout_seconds > 0.0 && elapsed >= timeout_seconds ) )
+        {
+            next_io_uring_submit( uring );
+            return 0;
+        }
+
+        // wait for a completion, submitting any queued sends in the same syscall
+
+        const unsigned to_submit = next_io_uring_take_pending( uring );
+
+        int result;
+
+        if ( timeout_seconds > 0.0 )
+        {
+            const double remaining = timeout_seconds - elapsed;
+
+            __kernel_timespec ts;
+            ts.tv_sec = (long long) remaining;
+            ts.tv_nsec = (long long) ( ( remaining - double( ts.tv_sec ) ) * 1000000000.0 );
+
+            io_uring_getevents_arg arg;
+            memset( &arg, 0, sizeof(arg) );
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = (uint64_t) &ts;
+
+            result = next_io_uring_enter( uring->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg) );
+        }
+        else
+        {
+            result = next_io_uring_enter( uring->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
+        }
+
+        if ( result < 0 )
+        {
+            if ( errno != ETIME && errno != EINTR && errno != EBUSY )
+            {
+                next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring wait failed (%d)", errno );
+            }
+            next_io_uring_return_pending( uring, to_submit, 0 );
+        }
+        else
+        {
+            next_io_uring_return_pending( uring, to_submit, result );
+        }
+    }
+}
+
+void next_io_uring_release( next_io_uring_t * uring, next_io_uring_packet_t * packet )
+{
+    next_io_uring_verify_sentinels( uring );
+
+    next_assert( packet );
+    next_assert( packet->buffer_id >= 0 && packet->buffer_id < NEXT_IO_URING_RECEIVE_BUFFERS );
+
+    next_io_uring_add_buffer( uring, packet->buffer_id );
+}
+
+#else // #if NEXT_IO_URING_HEADERS
+
+next_io_uring_t * next_io_uring_create( void * context, int socket_handle )
+{
+    (void) context;
+    (void) socket_handle;
+    next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring headers were not available at build time" );
+    return NULL;
+}
+
+void next_io_uring_destroy( next_io_uring_t * ) {}
+
+bool next_io_uring_send( next_io_uring_t *, const sockaddr *, socklen_t, const void *, int ) { return false; }
+
+void next_io_uring_send_batch_begin( next_io_uring_t * ) {}
+
+void next_io_uring_send_batch_end( next_io_uring_t * ) {}
+
+int next_io_uring_receive( next_io_uring_t *, next_io_uring_packet_t *, double, double ) { return 0; }
+
+void next_io_uring_release( next_io_uring_t *, next_io_uring_packet_t * ) {}
+
+#endif // #if NEXT_IO_URING_HEADERS
+
+#else // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+int next_io_uring_dummy_symbol = 0;
+
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
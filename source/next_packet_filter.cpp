@@ -23,6 +23,7 @@
 #include "next_packet_filter.h"
 #include "next_address.h"
 #include "next_hash.h"
+#include "next_constants.h"
 
 #include <memory.h>
 
@@ -181,3 +182,146 @@ bool next_advanced_packet_filter( const uint8_t * data, const uint8_t * magic, c
 
     return true;
 }
+
+// ---------------------------------------------------------------
+
+enum next_bpf_label_t
+{
+    NEXT_BPF_LABEL_NEXT = 0,
+    NEXT_BPF_LABEL_ACCEPT,
+    NEXT_BPF_LABEL_DROP,
+};
+
+struct next_bpf_builder_t
+{
+    next_bpf_instruction_t * program;
+    uint8_t jt_label[NEXT_BPF_MAX_INSTRUCTIONS];
+    uint8_t jf_label[NEXT_BPF_MAX_INSTRUCTIONS];
+    int num_instructions;
+    int max_instructions;
+};
+
+static void next_bpf_emit( next_bpf_builder_t * builder, uint16_t code, uint32_t k, int jt_label = NEXT_BPF_LABEL_NEXT, int jf_label = NEXT_BPF_LABEL_NEXT )
+{
+    const int index = builder->num_instructions++;
+    if ( index >= builder->max_instructions )
+        return;
+    builder->program[index].code = code;
+    builder->program[index].jt = 0;
+    builder->program[index].jf = 0;
+    builder->program[index].k = k;
+    builder->jt_label[index] = uint8_t( jt_label );
+    builder->jf_label[index] = uint8_t( jf_label );
+}
+
+static void next_bpf_emit_load_byte( next_bpf_builder_t * builder, int offset )
+{
+    next_bpf_emit( builder, NEXT_BPF_LD | NEXT_BPF_B | NEXT_BPF_ABS, uint32_t( NEXT_BPF_UDP_HEADER_BYTES + offset ) );
+}
+
+static void next_bpf_emit_byte_range( next_bpf_builder_t * builder, int offset, uint8_t min_value, uint8_t max_value )
+{
+    next_bpf_emit_load_byte( builder, offset );
+    next_bpf_emit( builder, NEXT_BPF_JMP | NEXT_BPF_JGE | NEXT_BPF_K, min_value, NEXT_BPF_LABEL_NEXT, NEXT_BPF_LABEL_DROP );
+    next_bpf_emit( builder, NEXT_BPF_JMP | NEXT_BPF_JGT | NEXT_BPF_K, max_value, NEXT_BPF_LABEL_DROP, NEXT_BPF_LABEL_NEXT );
+}
+
+static void next_bpf_emit_byte_set( next_bpf_builder_t * builder, int offset, const uint8_t * values, int num_values )
+{
+    // each match skips the remaining compares, the last mismatch drops
+
+    next_bpf_emit_load_byte( builder, offset );
+    for ( int i = 0; i < num_values; ++i )
+    {
+        const int remaining = num_values - 1 - i;
+        next_bpf_emit( builder, NEXT_BPF_JMP | NEXT_BPF_JEQ | NEXT_BPF_K, values[i], NEXT_BPF_LABEL_NEXT, remaining > 0 ? NEXT_BPF_LABEL_NEXT : NEXT_BPF_LABEL_DROP );
+        if ( builder->num_instructions <= builder->max_instructions )
+        {
+            builder->program[builder->num_instructions-1].jt = uint8_t( remaining );
+        }
+    }
+}
+
+int next_basic_packet_filter_bpf( next_bpf_instruction_t * program, int max_instructions )
+{
+    next_assert( program );
+    next_assert( max_instructions > 0 );
+
+    // IMPORTANT: a filter attached to a udp socket sees the packet starting at the udp header, so payload bytes are offset by NEXT_BPF_UDP_HEADER_BYTES.
+    // This must accept exactly the packets next_basic_packet_filter accepts, minus packets the server would drop for their size anyway.
+
+    next_bpf_builder_t builder;
+    builder.program = program;
+    builder.num_instructions = 0;
+    builder.max_instructions = max_instructions < NEXT_BPF_MAX_INSTRUCTIONS ? max_instructions : NEXT_BPF_MAX_INSTRUCTIONS;
+
+    // drop packets that are too large to receive, or too small to hold a passthrough payload
+
+    next_bpf_emit( &builder, NEXT_BPF_LD | NEXT_BPF_W | NEXT_BPF_LEN, 0 );
+    next_bpf_emit( &builder, NEXT_BPF_JMP | NEXT_BPF_JGT | NEXT_BPF_K, NEXT_BPF_UDP_HEADER_BYTES + NEXT_MAX_PACKET_BYTES, NEXT_BPF_LABEL_DROP, NEXT_BPF_LABEL_NEXT );
+    next_bpf_emit( &builder, NEXT_BPF_JMP | NEXT_BPF_JGE | NEXT_BPF_K, NEXT_BPF_UDP_HEADER_BYTES + 2, NEXT_BPF_LABEL_NEXT, NEXT_BPF_LABEL_DROP );
+
+    // passthrough packets
+
+    next_bpf_emit_load_byte( &builder, 0 );
+    next_bpf_emit( &builder, NEXT_BPF_JMP | NEXT_BPF_JEQ | NEXT_BPF_K, 0, NEXT_BPF_LABEL_ACCEPT, NEXT_BPF_LABEL_NEXT );
+
+    // network next packets
+
+    next_bpf_emit( &builder, NEXT_BPF_LD | NEXT_BPF_W | NEXT_BPF_LEN, 0 );
+    next_bpf_emit( &builder, NEXT_BPF_JMP | NEXT_BPF_JGE | NEXT_BPF_K, NEXT_BPF_UDP_HEADER_BYTES + 18, NEXT_BPF_LABEL_NEXT, NEXT_BPF_LABEL_DROP );
+
+    // data[2] == 1 | ( ( 255 - data[1] ) ^ 113 )
+
+    next_bpf_emit_load_byte( &builder, 1 );
+    next_bpf_emit( &builder, NEXT_BPF_ALU | NEXT_BPF_NEG, 0 );
+    next_bpf_emit( &builder, NEXT_BPF_ALU | NEXT_BPF_ADD | NEXT_BPF_K, 255 );
+    next_bpf_emit( &builder, NEXT_BPF_ALU | NEXT_BPF_XOR | NEXT_BPF_K, 113 );
+    next_bpf_emit( &builder, NEXT_BPF_ALU | NEXT_BPF_OR | NEXT_BPF_K, 1 );
+    next_bpf_emit( &builder, NEXT_BPF_MISC | NEXT_BPF_TAX, 0 );
+    next_bpf_emit_load_byte( &builder, 2 );
+    next_bpf_emit( &builder, NEXT_BPF_JMP | NEXT_BPF_JEQ | NEXT_BPF_X, 0, NEXT_BPF_LABEL_NEXT, NEXT_BPF_LABEL_DROP );
+
+    const uint8_t data_10[] = { 0x07, 0x4F };
+    const uint8_t data_11[] = { 0x25, 0x53 };
+    const uint8_t data_15[] = { 0x61, 0x05, 0x2B, 0x0D };
+
+    next_bpf_emit_byte_range( &builder, 3, 0x2A, 0x2D );
+    next_bpf_emit_byte_range( &builder, 4, 0xC8, 0xE7 );
+    next_bpf_emit_byte_range( &builder, 5, 0x05, 0x44 );
+    next_bpf_emit_byte_range( &builder, 7, 0x4E, 0x51 );
+    next_bpf_emit_byte_range( &builder, 8, 0x60, 0xDF );
+    next_bpf_emit_byte_range( &builder, 9, 0x64, 0xE3 );
+    next_bpf_emit_byte_set( &builder, 10, data_10, 2 );
+    next_bpf_emit_byte_set( &builder, 11, data_11, 2 );
+    next_bpf_emit_byte_range( &builder, 12, 0x7C, 0x83 );
+    next_bpf_emit_byte_range( &builder, 13, 0xAF, 0xB6 );
+    next_bpf_emit_byte_range( &builder, 14, 0x21, 0x60 );
+    next_bpf_emit_byte_set( &builder, 15, data_15, 4 );
+    next_bpf_emit_byte_range( &builder, 16, 0xD2, 0xF1 );
+    next_bpf_emit_byte_range( &builder, 17, 0x11, 0x90 );
+
+    const int accept_index = builder.num_instructions;
+    next_bpf_emit( &builder, NEXT_BPF_RET | NEXT_BPF_K, 0xFFFFFFFF );
+
+    const int drop_index = builder.num_instructions;
+    next_bpf_emit( &builder, NEXT_BPF_RET | NEXT_BPF_K, 0 );
+
+    if ( builder.num_instructions > builder.max_instructions )
+        return 0;
+
+    // resolve labels to relative jumps
+
+    for ( int i = 0; i < builder.num_instructions; ++i )
+    {
+        if ( ( program[i].code & 0x07 ) != NEXT_BPF_JMP )
+            continue;
+
+        if ( builder.jt_label[i] == NEXT_BPF_LABEL_ACCEPT ) program[i].jt = uint8_t( accept_index - ( i + 1 ) );
+        if ( builder.jt_label[i] == NEXT_BPF_LABEL_DROP ) program[i].jt = uint8_t( drop_index - ( i + 1 ) );
+        if ( builder.jf_label[i] == NEXT_BPF_LABEL_ACCEPT ) program[i].jf = uint8_t( accept_index - ( i + 1 ) );
+        if ( builder.jf_label[i] == NEXT_BPF_LABEL_DROP ) program[i].jf = uint8_t( drop_index - ( i + 1 ) );
+    }
+
+    return builder.num_instructions;
+}
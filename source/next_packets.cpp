@@ -26,6 +26,7 @@
 #include "next_packet_filter.h"
 #include "next_serialize.h"
 #include "next_replay_protection.h"
+#include "next_fast_serialize.h"
 
 #include <stdlib.h>
 #if NEXT_PLATFORM == NEXT_PLATFORM_WINDOWS || NEXT_PLATFORM == NEXT_PLATFORM_GDK
@@ -321,12 +322,141 @@ int next_write_server_pong_packet( uint8_t * packet_data, uint64_t ping_sequence
     return packet_length;
 }
 
+static int next_finish_packet( uint8_t packet_id, uint8_t * packet_data, int * packet_bytes, const int * signed_packet, const int * encrypted_packet, uint64_t * sequence, const uint8_t * sign_private_key, const uint8_t * encrypt_private_key, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address )
+{
+    if ( signed_packet && signed_packet[packet_id] )
+    {
+        next_assert( sign_private_key );
+        next_crypto_sign_state_t state;
+        next_crypto_sign_init( &state );
+        next_crypto_sign_update( &state, packet_data, 1 );
+        next_crypto_sign_update( &state, packet_data + 18, *packet_bytes - 18 );
+        next_crypto_sign_final_create( &state, packet_data + *packet_bytes, NULL, sign_private_key );
+        *packet_bytes += NEXT_CRYPTO_SIGN_BYTES;
+    }
+
+    if ( encrypted_packet && encrypted_packet[packet_id] )
+    {
+        next_assert( !( signed_packet && signed_packet[packet_id] ) );
+
+        uint8_t * additional = packet_data;
+        uint8_t * nonce = packet_data + 18;
+        uint8_t * message = packet_data + 18 + 8;
+        int message_length = *packet_bytes - 18 - 8;
+
+        unsigned long long encrypted_bytes = 0;
+
+        next_crypto_aead_chacha20poly1305_encrypt( message, &encrypted_bytes,
+                                                   message, message_length,
+                                                   additional, 1,
+                                                   NULL, nonce, encrypt_private_key );
+
+        next_assert( encrypted_bytes == uint64_t(message_length) + NEXT_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES );
+
+        *packet_bytes = 18 + 8 + encrypted_bytes;
+
+        (*sequence)++;
+    }
+
+    int packet_length = *packet_bytes;
+
+    next_generate_pittle( packet_data + 1, from_address, to_address, packet_length );
+    next_generate_chonkle( packet_data + 3, magic, from_address, to_address, packet_length );
+
+    return NEXT_OK;
+}
+
+template <typename T> int next_write_fast_packet_payload( void * packet_object, uint8_t * buffer )
+{
+    static_assert( 18 + 8 + next::FastPacketSerializer<T>::MaxBytes + NEXT_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES <= NEXT_MAX_PACKET_BYTES, "fast packet can exceed max packet bytes" );
+    return next::FastPacketSerializer<T>::Write( *( (T*) packet_object ), buffer );
+}
+
+template <typename T> bool next_read_fast_packet_payload( void * packet_object, const uint8_t * buffer, int bytes )
+{
+    return next::FastPacketSerializer<T>::Read( *( (T*) packet_object ), buffer, bytes );
+}
+
+bool next_is_fast_packet( uint8_t packet_id )
+{
+    return packet_id == NEXT_DIRECT_PING_PACKET ||
+           packet_id == NEXT_DIRECT_PONG_PACKET ||
+           packet_id == NEXT_CLIENT_STATS_PACKET ||
+           packet_id == NEXT_ROUTE_UPDATE_PACKET ||
+           packet_id == NEXT_ROUTE_ACK_PACKET;
+}
+
+static int next_write_fast_packet( uint8_t packet_id, void * packet_object, uint8_t * packet_data, int * packet_bytes, bool encrypted, uint64_t * sequence )
+{
+    // IMPORTANT: the prefix and sequence are whole bytes, so writing them directly gives the same bits as the write stream
+
+    packet_data[0] = packet_id;
+    memset( packet_data + 1, 0, 17 );
+
+    uint8_t * p = packet_data + 18;
+
+    if ( encrypted )
+    {
+        next_assert( sequence );
+        next_write_uint64( &p, *sequence );
+    }
+
+    int payload_bytes = -1;
+
+    switch ( packet_id )
+    {
+        case NEXT_DIRECT_PING_PACKET:   payload_bytes = next_write_fast_packet_payload<NextDirectPingPacket>( packet_object, p );       break;
+        case NEXT_DIRECT_PONG_PACKET:   payload_bytes = next_write_fast_packet_payload<NextDirectPongPacket>( packet_object, p );       break;
+        case NEXT_CLIENT_STATS_PACKET:  payload_bytes = next_write_fast_packet_payload<NextClientStatsPacket>( packet_object, p );      break;
+        case NEXT_ROUTE_UPDATE_PACKET:  payload_bytes = next_write_fast_packet_payload<NextRouteUpdatePacket>( packet_object, p );      break;
+        case NEXT_ROUTE_ACK_PACKET:     payload_bytes = next_write_fast_packet_payload<NextRouteAckPacket>( packet_object, p );         break;
+        default: break;
+    }
+
+    if ( payload_bytes < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to write packet %d", packet_id );
+        return NEXT_ERROR;
+    }
+
+    *packet_bytes = int( p - packet_data ) + payload_bytes;
+
+    return NEXT_OK;
+}
+
+static bool next_read_fast_packet( uint8_t packet_id, const uint8_t * packet_data, int begin, int end, void * packet_object )
+{
+    const int bytes = end - begin;
+    if ( bytes < 0 )
+        return false;
+
+    switch ( packet_id )
+    {
+        case NEXT_DIRECT_PING_PACKET:   return next_read_fast_packet_payload<NextDirectPingPacket>( packet_object, packet_data + begin, bytes );
+        case NEXT_DIRECT_PONG_PACKET:   return next_read_fast_packet_payload<NextDirectPongPacket>( packet_object, packet_data + begin, bytes );
+        case NEXT_CLIENT_STATS_PACKET:  return next_read_fast_packet_payload<NextClientStatsPacket>( packet_object, packet_data + begin, bytes );
+        case NEXT_ROUTE_UPDATE_PACKET:  return next_read_fast_packet_payload<NextRouteUpdatePacket>( packet_object, packet_data + begin, bytes );
+        case NEXT_ROUTE_ACK_PACKET:     return next_read_fast_packet_payload<NextRouteAckPacket>( packet_object, packet_data + begin, bytes );
+        default: return false;
+    }
+}
+
 int next_write_packet( uint8_t packet_id, void * packet_object, uint8_t * packet_data, int * packet_bytes, const int * signed_packet, const int * encrypted_packet, uint64_t * sequence, const uint8_t * sign_private_key, const uint8_t * encrypt_private_key, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address )
 {
     next_assert( packet_object );
     next_assert( packet_data );
     next_assert( packet_bytes );
 
+    if ( next_is_fast_packet( packet_id ) )
+    {
+        next_assert( encrypt_private_key || !( encrypted_packet && encrypted_packet[packet_id] ) );
+
+        if ( next_write_fast_packet( packet_id, packet_object, packet_data, packet_bytes, encrypted_packet && encrypted_packet[packet_id], sequence ) != NEXT_OK )
+            return NEXT_ERROR;
+
+        return next_finish_packet( packet_id, packet_data, packet_bytes, signed_packet, encrypted_packet, sequence, sign_private_key, encrypt_private_key, magic, from_address, to_address );
+    }
+
     next::WriteStream stream( packet_data, NEXT_MAX_PACKET_BYTES );
 
     typedef next::WriteStream Stream;
@@ -381,61 +511,6 @@ int next_write_packet( uint8_t packet_id, void * packet_object, uint8_t * packet
         }
         break;
 
-        case NEXT_DIRECT_PING_PACKET:
-        {
-            NextDirectPingPacket * packet = (NextDirectPingPacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-            {
-                next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to write direct ping packet" );
-                return NEXT_ERROR;
-            }
-        }
-        break;
-
-        case NEXT_DIRECT_PONG_PACKET:
-        {
-            NextDirectPongPacket * packet = (NextDirectPongPacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-            {
-                next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to write direct pong packet" );
-                return NEXT_ERROR;
-            }
-        }
-        break;
-
-        case NEXT_CLIENT_STATS_PACKET:
-        {
-            NextClientStatsPacket * packet = (NextClientStatsPacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-            {
-                next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to write client stats packet" );
-                return NEXT_ERROR;
-            }
-        }
-        break;
-
-        case NEXT_ROUTE_UPDATE_PACKET:
-        {
-            NextRouteUpdatePacket * packet = (NextRouteUpdatePacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-            {
-                next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to write route update packet" );
-                return NEXT_ERROR;
-            }
-        }
-        break;
-
-        case NEXT_ROUTE_ACK_PACKET:
-        {
-            NextRouteAckPacket * packet = (NextRouteAckPacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-            {
-                next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to write route ack packet" );
-                return NEXT_ERROR;
-            }
-        }
-        break;
-
         case NEXT_CLIENT_RELAY_UPDATE_PACKET:
         {
             NextClientRelayUpdatePacket * packet = (NextClientRelayUpdatePacket*) packet_object;
@@ -466,46 +541,7 @@ int next_write_packet( uint8_t packet_id, void * packet_object, uint8_t * packet
 
     *packet_bytes = stream.GetBytesProcessed();
 
-    if ( signed_packet && signed_packet[packet_id] )
-    {
-        next_assert( sign_private_key );
-        next_crypto_sign_state_t state;
-        next_crypto_sign_init( &state );
-        next_crypto_sign_update( &state, packet_data, 1 );
-        next_crypto_sign_update( &state, packet_data + 18, *packet_bytes - 18 );
-        next_crypto_sign_final_create( &state, packet_data + *packet_bytes, NULL, sign_private_key );
-        *packet_bytes += NEXT_CRYPTO_SIGN_BYTES;
-    }
-
-    if ( encrypted_packet && encrypted_packet[packet_id] )
-    {
-        next_assert( !( signed_packet && signed_packet[packet_id] ) );
-
-        uint8_t * additional = packet_data;
-        uint8_t * nonce = packet_data + 18;
-        uint8_t * message = packet_data + 18 + 8;
-        int message_length = *packet_bytes - 18 - 8;
-
-        unsigned long long encrypted_bytes = 0;
-
-        next_crypto_aead_chacha20poly1305_encrypt( message, &encrypted_bytes,
-                                                   message, message_length,
-                                                   additional, 1,
-                                                   NULL, nonce, encrypt_private_key );
-
-        next_assert( encrypted_bytes == uint64_t(message_length) + NEXT_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES );
-
-        *packet_bytes = 18 + 8 + encrypted_bytes;
-
-        (*sequence)++;
-    }
-
-    int packet_length = *packet_bytes;
-
-    next_generate_pittle( packet_data + 1, from_address, to_address, packet_length );
-    next_generate_chonkle( packet_data + 3, magic, from_address, to_address, packet_length );
-
-    return NEXT_OK;
+    return next_finish_packet( packet_id, packet_data, packet_bytes, signed_packet, encrypted_packet, sequence, sign_private_key, encrypt_private_key, magic, from_address, to_address );
 }
 
 bool next_is_payload_packet( uint8_t packet_id )
@@ -519,11 +555,6 @@ int next_read_packet( uint8_t packet_id, uint8_t * packet_data, int begin, int e
     next_assert( packet_data );
     next_assert( packet_object );
 
-    next::ReadStream stream( packet_data, end );
-
-    uint8_t * dummy = (uint8_t*) alloca( begin );
-    serialize_bytes( stream, dummy, begin );
-
     if ( signed_packet && signed_packet[packet_id] )
     {
         next_assert( sign_public_key );
@@ -587,12 +618,30 @@ int next_read_packet( uint8_t packet_id, uint8_t * packet_data, int begin, int e
 
         next_assert( decrypted_bytes == uint64_t(message_length) - NEXT_CRYPTO_AEAD_CHACHA20POLY1305_ABYTES );
 
-        serialize_bytes( stream, dummy, 8 );
-
         if ( next_replay_protection_already_received( replay_protection, *sequence ) )
             return NEXT_ERROR;
     }
 
+    const bool encrypted = encrypted_packet && encrypted_packet[packet_id];
+
+    if ( next_is_fast_packet( packet_id ) )
+    {
+        if ( !next_read_fast_packet( packet_id, packet_data, begin + ( encrypted ? 8 : 0 ), end, packet_object ) )
+            return NEXT_ERROR;
+
+        return (int) packet_id;
+    }
+
+    next::ReadStream stream( packet_data, end );
+
+    uint8_t * dummy = (uint8_t*) alloca( begin );
+    serialize_bytes( stream, dummy, begin );
+
+    if ( encrypted )
+    {
+        serialize_bytes( stream, dummy, 8 );
+    }
+
     switch ( packet_id )
     {
         case NEXT_UPGRADE_REQUEST_PACKET:
@@ -619,46 +668,6 @@ int next_read_packet( uint8_t packet_id, uint8_t * packet_data, int begin, int e
         }
         break;
 
-        case NEXT_DIRECT_PING_PACKET:
-        {
-            NextDirectPingPacket * packet = (NextDirectPingPacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-                return NEXT_ERROR;
-        }
-        break;
-
-        case NEXT_DIRECT_PONG_PACKET:
-        {
-            NextDirectPongPacket * packet = (NextDirectPongPacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-                return NEXT_ERROR;
-        }
-        break;
-
-        case NEXT_CLIENT_STATS_PACKET:
-        {
-            NextClientStatsPacket * packet = (NextClientStatsPacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-                return NEXT_ERROR;
-        }
-        break;
-
-        case NEXT_ROUTE_UPDATE_PACKET:
-        {
-            NextRouteUpdatePacket * packet = (NextRouteUpdatePacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-                return NEXT_ERROR;
-        }
-        break;
-
-        case NEXT_ROUTE_ACK_PACKET:
-        {
-            NextRouteAckPacket * packet = (NextRouteAckPacket*) packet_object;
-            if ( !packet->Serialize( stream ) )
-                return NEXT_ERROR;
-        }
-        break;
-
         case NEXT_CLIENT_RELAY_UPDATE_PACKET:
         {
             NextClientRelayUpdatePacket * packet = (NextClientRelayUpdatePacket*) packet_object;
@@ -692,6 +701,130 @@ void next_post_validate_packet( uint8_t packet_id, const int * encrypted_packet,
     }
 }
 
+void next_sign_backend_packet( uint8_t * packet_data, int * packet_bytes, const uint8_t * sign_private_key )
+{
+    next_assert( packet_data );
+    next_assert( packet_bytes );
+    next_assert( *packet_bytes >= 18 );
+    next_assert( *packet_bytes + int( NEXT_CRYPTO_SIGN_BYTES ) <= NEXT_MAX_PACKET_BYTES );
+    next_assert( sign_private_key );
+
+    next_crypto_sign_state_t state;
+    next_crypto_sign_init( &state );
+    next_crypto_sign_update( &state, packet_data, 1 );
+    next_crypto_sign_update( &state, packet_data + 18, size_t(*packet_bytes) - 18 );
+    next_crypto_sign_final_create( &state, packet_data + *packet_bytes, NULL, sign_private_key );
+    *packet_bytes += NEXT_CRYPTO_SIGN_BYTES;
+}
+
+bool next_verify_backend_packet( uint8_t packet_id, const uint8_t * packet_data, int begin, int end, const uint8_t * sign_public_key )
+{
+    next_assert( packet_data );
+    next_assert( sign_public_key );
+
+    const int packet_bytes = end - begin;
+
+    if ( packet_bytes < int( NEXT_CRYPTO_SIGN_BYTES ) )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "signed backend packet is too small to be valid" );
+        return false;
+    }
+
+    next_crypto_sign_state_t state;
+    next_crypto_sign_init( &state );
+    next_crypto_sign_update( &state, &packet_id, 1 );
+    next_crypto_sign_update( &state, packet_data + begin, packet_bytes - NEXT_CRYPTO_SIGN_BYTES );
+    if ( next_crypto_sign_final_verify( &state, packet_data + end - NEXT_CRYPTO_SIGN_BYTES, sign_public_key ) != 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "signed backend packet did not verify" );
+        return false;
+    }
+
+    return true;
+}
+
+bool next_verify_backend_packet_batch( int num_packets, const uint8_t * packet_ids, const uint8_t * const * packet_data, const int * begin, const int * end, const uint8_t * sign_public_key )
+{
+    next_assert( num_packets > 0 );
+    next_assert( num_packets <= NEXT_CRYPTO_SIGN_BATCH_MAX );
+    next_assert( packet_ids );
+    next_assert( packet_data );
+    next_assert( begin );
+    next_assert( end );
+    next_assert( sign_public_key );
+
+    // IMPORTANT: true only if every packet in the batch verifies. On false, verify packets individually to find the bad ones
+
+    next_crypto_sign_state_t states[NEXT_CRYPTO_SIGN_BATCH_MAX];
+    const unsigned char * signatures[NEXT_CRYPTO_SIGN_BATCH_MAX];
+
+    for ( int i = 0; i < num_packets; ++i )
+    {
+        const int packet_bytes = end[i] - begin[i];
+
+        if ( packet_bytes < int( NEXT_CRYPTO_SIGN_BYTES ) )
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "signed backend packet is too small to be valid" );
+            return false;
+        }
+
+        next_crypto_sign_init( &states[i] );
+        next_crypto_sign_update( &states[i], &packet_ids[i], 1 );
+        next_crypto_sign_update( &states[i], packet_data[i] + begin[i], packet_bytes - NEXT_CRYPTO_SIGN_BYTES );
+        signatures[i] = packet_data[i] + end[i] - NEXT_CRYPTO_SIGN_BYTES;
+    }
+
+    if ( next_crypto_sign_final_verify_batch( states, signatures, num_packets, sign_public_key ) != 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "signed backend packet batch did not verify" );
+        return false;
+    }
+
+    return true;
+}
+
+void next_backend_packet_cache_clear( next_backend_packet_cache_t * cache )
+{
+    next_assert( cache );
+    cache->sequence = 0;
+    cache->packet_bytes = 0;
+    cache->packet_id = 0;
+}
+
+void next_backend_packet_cache_store( next_backend_packet_cache_t * cache, uint8_t packet_id, const uint8_t * packet_data, int packet_bytes, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address )
+{
+    next_assert( cache );
+    next_assert( packet_data );
+    next_assert( packet_bytes > 0 );
+    next_assert( packet_bytes <= NEXT_MAX_PACKET_BYTES );
+    next_assert( magic );
+    next_assert( from_address );
+    next_assert( to_address );
+
+    memcpy( cache->packet_data, packet_data, packet_bytes );
+    cache->packet_bytes = packet_bytes;
+    cache->packet_id = packet_id;
+    memcpy( cache->magic, magic, 8 );
+    memcpy( cache->from_address_data, from_address, 4 );
+    memcpy( cache->to_address_data, to_address, 4 );
+}
+
+bool next_backend_packet_cache_valid( const next_backend_packet_cache_t * cache, uint8_t packet_id, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address )
+{
+    next_assert( cache );
+    next_assert( magic );
+    next_assert( from_address );
+    next_assert( to_address );
+
+    // IMPORTANT: the pittle and chonkle depend on the magic and addresses, so the cached bytes are stale if any of them change
+
+    return cache->packet_bytes > 0 &&
+           cache->packet_id == packet_id &&
+           memcmp( cache->magic, magic, 8 ) == 0 &&
+           memcmp( cache->from_address_data, from_address, 4 ) == 0 &&
+           memcmp( cache->to_address_data, to_address, 4 ) == 0;
+}
+
 int next_write_backend_packet( uint8_t packet_id, void * packet_object, uint8_t * packet_data, int * packet_bytes, const int * signed_packet, const uint8_t * sign_private_key, const uint8_t * magic, const uint8_t * from_address, const uint8_t * to_address )
 {
     next_assert( packet_object );
@@ -805,13 +938,7 @@ int next_write_backend_packet( uint8_t packet_id, void * packet_object, uint8_t
 
     if ( signed_packet && signed_packet[packet_id] )
     {
-        next_assert( sign_private_key );
-        next_crypto_sign_state_t state;
-        next_crypto_sign_init( &state );
-        next_crypto_sign_update( &state, packet_data, 1 );
-        next_crypto_sign_update( &state, packet_data + 18, size_t(*packet_bytes) - 18 );
-        next_crypto_sign_final_create( &state, packet_data + *packet_bytes, NULL, sign_private_key );
-        *packet_bytes += NEXT_CRYPTO_SIGN_BYTES;
+        next_sign_backend_packet( packet_data, packet_bytes, sign_private_key );
     }
 
     next_generate_pittle( packet_data + 1, from_address, to_address, *packet_bytes );
@@ -833,25 +960,8 @@ int next_read_backend_packet( uint8_t packet_id, uint8_t * packet_data, int begi
 
     if ( signed_packet && signed_packet[packet_id] )
     {
-        next_assert( sign_public_key );
-
-        const int packet_bytes = end - begin;
-
-        if ( packet_bytes < int( NEXT_CRYPTO_SIGN_BYTES ) )
-        {
-            next_printf( NEXT_LOG_LEVEL_DEBUG, "signed backend packet is too small to be valid" );
-            return NEXT_ERROR;
-        }
-
-        next_crypto_sign_state_t state;
-        next_crypto_sign_init( &state );
-        next_crypto_sign_update( &state, &packet_id, 1 );
-        next_crypto_sign_update( &state, packet_data + begin, packet_bytes - NEXT_CRYPTO_SIGN_BYTES );
-        if ( next_crypto_sign_final_verify( &state, packet_data + end - NEXT_CRYPTO_SIGN_BYTES, sign_public_key ) != 0 )
-        {
-            next_printf( NEXT_LOG_LEVEL_DEBUG, "signed backend packet did not verify" );
+        if ( !next_verify_backend_packet( packet_id, packet_data, begin, end, sign_public_key ) )
             return NEXT_ERROR;
-        }
     }
 
     switch ( packet_id )
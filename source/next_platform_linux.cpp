@@ -26,6 +26,11 @@
 
 #include "next_platform.h"
 #include "next_address.h"
+#include "next_impairment.h"
+#include "next_packet_filter.h"
+#include "next_io_uring.h"
+#include "next_xdp.h"
+#include "next_constants.h"
 
 #include <netdb.h>
 #include <sys/types.h>
@@ -42,10 +47,13 @@
 #include <linux/rtnetlink.h>
 #include <sys/ioctl.h>
 #include <linux/wireless.h>
+#include <linux/filter.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
 #include <alloca.h>
+#include <poll.h>
+#include <time.h>
 
 // ---------------------------------------------------
 
@@ -207,6 +215,16 @@ next_platform_socket_t * next_platform_socket_create( void * context, next_addre
 
     socket->ipv6 = address->type == NEXT_ADDRESS_IPV6;
 
+    socket->timestamps = false;
+
+    socket->busy_poll_time = 0.0;
+
+    socket->timeout_seconds = timeout_seconds;
+
+    socket->io_uring = NULL;
+
+    socket->xdp = NULL;
+
     socket->handle = ::socket( ( address->type == NEXT_ADDRESS_IPV6 ) ? AF_INET6 : AF_INET, SOCK_DGRAM, IPPROTO_UDP );
 
     if ( socket->handle < 0 )
@@ -356,6 +374,20 @@ next_platform_socket_t * next_platform_socket_create( void * context, next_addre
         setsockopt( socket->handle, IPPROTO_IP, IP_MTU_DISCOVER, &val, sizeof(val) );
     }
 
+    // request kernel receive timestamps so packet receive times don't include time spent waiting to be read
+
+    {
+        int yes = 1;
+        if ( setsockopt( socket->handle, SOL_SOCKET, SO_TIMESTAMPNS, &yes, sizeof(yes) ) == 0 )
+        {
+            socket->timestamps = true;
+        }
+        else
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to enable kernel receive timestamps" );
+        }
+    }
+
     // tag packet as low latency
 
     if ( next_packet_tagging_enabled )
@@ -384,6 +416,21 @@ next_platform_socket_t * next_platform_socket_create( void * context, next_addre
 void next_platform_socket_destroy( next_platform_socket_t * socket )
 {
     next_assert( socket );
+
+#if NEXT_DEVELOPMENT
+    next_impairment_purge( socket );
+#endif // #if NEXT_DEVELOPMENT
+
+    if ( socket->io_uring )
+    {
+        next_io_uring_destroy( socket->io_uring );
+    }
+
+    if ( socket->xdp )
+    {
+        next_xdp_destroy( socket->xdp );
+    }
+
     if ( socket->handle != 0 )
     {
         close( socket->handle );
@@ -393,12 +440,20 @@ void next_platform_socket_destroy( next_platform_socket_t * socket )
 
 void next_platform_socket_send_packet( next_platform_socket_t * socket, const next_address_t * to_input, const void * packet_data, int packet_bytes )
 {
+#if NEXT_DEVELOPMENT
+    if ( next_impairment_send( socket, to_input, packet_data, packet_bytes ) )
+        return;
+#endif // #if NEXT_DEVELOPMENT
+
     next_assert( socket );
     next_assert( to_input );
     next_assert( to_input->type == NEXT_ADDRESS_IPV6 || to_input->type == NEXT_ADDRESS_IPV4 );
     next_assert( packet_data );
     next_assert( packet_bytes > 0 );
 
+    if ( socket->xdp && next_xdp_send( socket->xdp, to_input, packet_data, packet_bytes ) )
+        return;
+
     next_address_t to = *to_input;
 
     if ( socket->ipv6 )
@@ -418,6 +473,8 @@ void next_platform_socket_send_packet( next_platform_socket_t * socket, const ne
             ( (uint16_t*) &socket_address.sin6_addr ) [i] = next_platform_htons( to.data.ipv6[i] );
         }
         socket_address.sin6_port = next_platform_htons( to.port );
+        if ( socket->io_uring && next_io_uring_send( socket->io_uring, (sockaddr*)( &socket_address ), sizeof(sockaddr_in6), packet_data, packet_bytes ) )
+            return;
         int result = int( sendto( socket->handle, (char*)( packet_data ), packet_bytes, 0, (sockaddr*)( &socket_address ), sizeof(sockaddr_in6) ) );
         if ( result < 0 )
         {
@@ -438,6 +495,8 @@ void next_platform_socket_send_packet( next_platform_socket_t * socket, const ne
                                              ( ( (uint32_t) to.data.ipv4[2] ) << 16 )  | 
                                              ( ( (uint32_t) to.data.ipv4[3] ) << 24 );
             socket_address.sin_port = next_platform_htons( to.port );
+            if ( socket->io_uring && next_io_uring_send( socket->io_uring, (sockaddr*)( &socket_address ), sizeof(sockaddr_in), packet_data, packet_bytes ) )
+                return;
             int result = int( sendto( socket->handle, (const char*)( packet_data ), packet_bytes, 0, (sockaddr*)( &socket_address ), sizeof(sockaddr_in) ) );
             if ( result < 0 )
             {
@@ -455,35 +514,49 @@ void next_platform_socket_send_packet( next_platform_socket_t * socket, const ne
 
 int next_platform_socket_receive_packet( next_platform_socket_t * socket, next_address_t * from, void * packet_data, int max_packet_size )
 {
-    next_assert( socket );
-    next_assert( from );
-    next_assert( packet_data );
-    next_assert( max_packet_size > 0 );
+    return next_platform_socket_receive_packet_with_timestamp( socket, from, packet_data, max_packet_size, NULL );
+}
 
-    sockaddr_storage sockaddr_from;
-    socklen_t from_length = sizeof( sockaddr_from );
+static double next_platform_kernel_receive_time( msghdr * msg )
+{
+    // IMPORTANT: the kernel stamps packets with CLOCK_REALTIME, but next_platform_time is CLOCK_MONOTONIC_RAW.
+    // Convert by measuring how long ago the packet arrived and subtracting that from the current platform time.
 
-    int result = int( recvfrom( socket->handle, (char*) packet_data, max_packet_size, socket->type == NEXT_PLATFORM_SOCKET_NON_BLOCKING ? MSG_DONTWAIT : 0, (sockaddr*) &sockaddr_from, &from_length ) );
+    const double current_time = next_platform_time();
 
-    if ( result <= 0 )
+    for ( cmsghdr * cmsg = CMSG_FIRSTHDR( msg ); cmsg != NULL; cmsg = CMSG_NXTHDR( msg, cmsg ) )
     {
-        if ( errno == EAGAIN || errno == EINTR )
-        {
-            return 0;
-        }
+        if ( cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPNS )
+            continue;
 
-        next_printf( NEXT_LOG_LEVEL_DEBUG, "recvfrom failed with error %d", errno );
-        
-        return 0;
+        timespec packet_ts;
+        memcpy( &packet_ts, CMSG_DATA( cmsg ), sizeof( packet_ts ) );
+
+        timespec now_ts;
+        clock_gettime( CLOCK_REALTIME, &now_ts );
+
+        const double age = double( now_ts.tv_sec - packet_ts.tv_sec ) + double( now_ts.tv_nsec - packet_ts.tv_nsec ) / 1000000000.0;
+
+        // if the realtime clock has stepped, the age is meaningless. fall back to the current time
+
+        if ( age < 0.0 || age > 1.0 )
+            break;
+
+        return current_time - age;
     }
 
-    if ( sockaddr_from.ss_family == AF_INET6 )
+    return current_time;
+}
+
+static bool next_platform_socket_address_from_sockaddr( next_platform_socket_t * socket, const sockaddr_storage * sockaddr_from, next_address_t * from )
+{
+    if ( sockaddr_from->ss_family == AF_INET6 )
     {
-        sockaddr_in6 * addr_ipv6 = (sockaddr_in6*) &sockaddr_from;
+        const sockaddr_in6 * addr_ipv6 = (const sockaddr_in6*) sockaddr_from;
         from->type = NEXT_ADDRESS_IPV6;
         for ( int i = 0; i < 8; ++i )
         {
-            from->data.ipv6[i] = next_platform_ntohs( ( (uint16_t*) &addr_ipv6->sin6_addr ) [i] );
+            from->data.ipv6[i] = next_platform_ntohs( ( (const uint16_t*) &addr_ipv6->sin6_addr ) [i] );
         }
         from->port = next_platform_ntohs( addr_ipv6->sin6_port );
 
@@ -492,9 +565,9 @@ int next_platform_socket_receive_packet( next_platform_socket_t * socket, next_a
             next_address_convert_ipv6_to_ipv4( from );
         }
     }
-    else if ( sockaddr_from.ss_family == AF_INET )
+    else if ( sockaddr_from->ss_family == AF_INET )
     {
-        sockaddr_in * addr_ipv4 = (sockaddr_in*) &sockaddr_from;
+        const sockaddr_in * addr_ipv4 = (const sockaddr_in*) sockaddr_from;
         from->type = NEXT_ADDRESS_IPV4;
         from->data.ipv4[0] = (uint8_t) ( ( addr_ipv4->sin_addr.s_addr & 0x000000FF ) );
         from->data.ipv4[1] = (uint8_t) ( ( addr_ipv4->sin_addr.s_addr & 0x0000FF00 ) >> 8 );
@@ -505,14 +578,312 @@ int next_platform_socket_receive_packet( next_platform_socket_t * socket, next_a
     else
     {
         next_assert( 0 );
+        return false;
+    }
+
+    return true;
+}
+
+static int next_platform_socket_receive_packet_io_uring( next_platform_socket_t * socket, next_address_t * from, void * packet_data, int max_packet_size, double * receive_time )
+{
+    double timeout_seconds = -1.0;
+    if ( socket->type == NEXT_PLATFORM_SOCKET_NON_BLOCKING )
+    {
+        timeout_seconds = 0.0;
+    }
+    else if ( socket->timeout_seconds > 0.0f )
+    {
+        timeout_seconds = socket->timeout_seconds;
+    }
+
+    next_io_uring_packet_t packet;
+    if ( !next_io_uring_receive( socket->io_uring, &packet, timeout_seconds, socket->busy_poll_time ) )
+        return 0;
+
+    int packet_bytes = packet.packet_bytes < max_packet_size ? packet.packet_bytes : max_packet_size;
+
+    if ( next_platform_socket_address_from_sockaddr( socket, packet.from, from ) )
+    {
+        memcpy( packet_data, packet.packet_data, packet_bytes );
+
+        if ( receive_time )
+        {
+            *receive_time = socket->timestamps ? next_platform_kernel_receive_time( &packet.control ) : next_platform_time();
+        }
+    }
+    else
+    {
+        packet_bytes = 0;
+    }
+
+    next_io_uring_release( socket->io_uring, &packet );
+
+    return packet_bytes;
+}
+
+static int next_platform_socket_receive_packet_kernel( next_platform_socket_t * socket, next_address_t * from, void * packet_data, int max_packet_size, double * receive_time, bool wait )
+{
+    sockaddr_storage sockaddr_from;
+
+    iovec iov;
+    iov.iov_base = packet_data;
+    iov.iov_len = max_packet_size;
+
+    char control[CMSG_SPACE( sizeof( timespec ) )];
+
+    msghdr msg;
+    memset( &msg, 0, sizeof( msg ) );
+    msg.msg_name = &sockaddr_from;
+    msg.msg_namelen = sizeof( sockaddr_from );
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof( control );
+
+    // IMPORTANT: in busy poll mode we spin on non-blocking reads for the busy poll time, and only fall back to a
+    // blocking read with the socket timeout once no packet has arrived in that window. under load the thread never sleeps.
+
+    const bool busy_poll = wait && socket->busy_poll_time > 0.0;
+
+    const double busy_poll_start_time = busy_poll ? next_platform_time() : 0.0;
+
+    int result = 0;
+
+    while ( true )
+    {
+        msg.msg_namelen = sizeof( sockaddr_from );
+        msg.msg_controllen = sizeof( control );
+
+        const bool spin = busy_poll && next_platform_time() - busy_poll_start_time < socket->busy_poll_time;
+
+        result = int( recvmsg( socket->handle, &msg, ( !wait || spin ) ? MSG_DONTWAIT : 0 ) );
+
+        if ( result < 0 && spin && ( errno == EAGAIN || errno == EINTR ) )
+            continue;
+
+        break;
+    }
+
+    if ( result <= 0 )
+    {
+        if ( errno == EAGAIN || errno == EINTR )
+        {
+            return 0;
+        }
+
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "recvmsg failed with error %d", errno );
+        
         return 0;
     }
+
+    if ( receive_time )
+    {
+        *receive_time = socket->timestamps ? next_platform_kernel_receive_time( &msg ) : next_platform_time();
+    }
+
+    if ( !next_platform_socket_address_from_sockaddr( socket, &sockaddr_from, from ) )
+        return 0;
   
     next_assert( result >= 0 );
 
     return result;
 }
 
+static int next_platform_socket_receive_packet_xdp( next_platform_socket_t * socket, next_address_t * from, void * packet_data, int max_packet_size, double * receive_time )
+{
+    // IMPORTANT: packets for our port arrive on the xsk. anything the xdp program passes up the regular network stack
+    // (IPv6, fragments, packets on other rx queues) still arrives on the socket, so a blocking read polls both.
+
+    const double busy_poll_start_time = socket->busy_poll_time > 0.0 ? next_platform_time() : 0.0;
+
+    while ( true )
+    {
+        int packet_bytes = next_xdp_receive( socket->xdp, from, packet_data, max_packet_size );
+        if ( packet_bytes > 0 )
+        {
+            if ( receive_time )
+            {
+                *receive_time = next_platform_time();
+            }
+            return packet_bytes;
+        }
+
+        packet_bytes = next_platform_socket_receive_packet_kernel( socket, from, packet_data, max_packet_size, receive_time, false );
+        if ( packet_bytes > 0 || socket->type == NEXT_PLATFORM_SOCKET_NON_BLOCKING )
+            return packet_bytes;
+
+        if ( socket->busy_poll_time > 0.0 && next_platform_time() - busy_poll_start_time < socket->busy_poll_time )
+            continue;
+
+        pollfd handles[2];
+        handles[0].fd = next_xdp_handle( socket->xdp );
+        handles[0].events = POLLIN;
+        handles[0].revents = 0;
+        handles[1].fd = socket->handle;
+        handles[1].events = POLLIN;
+        handles[1].revents = 0;
+
+        const int timeout_milliseconds = socket->timeout_seconds > 0.0f ? int( ceil( socket->timeout_seconds * 1000.0f ) ) : -1;
+
+        const int result = poll( handles, 2, timeout_milliseconds );
+        if ( result == 0 )
+            return 0;
+
+        if ( result < 0 && errno != EINTR )
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "poll failed with error %d", errno );
+            return 0;
+        }
+    }
+}
+
+int next_platform_socket_receive_packet_with_timestamp( next_platform_socket_t * socket, next_address_t * from, void * packet_data, int max_packet_size, double * receive_time )
+{
+    next_assert( socket );
+    next_assert( from );
+    next_assert( packet_data );
+    next_assert( max_packet_size > 0 );
+
+    if ( socket->io_uring )
+        return next_platform_socket_receive_packet_io_uring( socket, from, packet_data, max_packet_size, receive_time );
+
+    if ( socket->xdp )
+        return next_platform_socket_receive_packet_xdp( socket, from, packet_data, max_packet_size, receive_time );
+
+    return next_platform_socket_receive_packet_kernel( socket, from, packet_data, max_packet_size, receive_time, socket->type == NEXT_PLATFORM_SOCKET_BLOCKING );
+}
+
+int next_platform_socket_busy_poll( next_platform_socket_t * socket, int busy_poll_microseconds )
+{
+    next_assert( socket );
+    next_assert( busy_poll_microseconds > 0 );
+
+    if ( socket->type != NEXT_PLATFORM_SOCKET_BLOCKING )
+        return NEXT_ERROR;
+
+#ifdef SO_BUSY_POLL
+    // ask the kernel to poll the device queue on reads too. values above net.core.busy_read need CAP_NET_ADMIN
+    if ( setsockopt( socket->handle, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_microseconds, sizeof(busy_poll_microseconds) ) != 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to set SO_BUSY_POLL on socket (%d)", errno );
+    }
+#endif // #ifdef SO_BUSY_POLL
+
+    socket->busy_poll_time = busy_poll_microseconds / 1000000.0;
+
+    return NEXT_OK;
+}
+
+static_assert( sizeof( next_bpf_instruction_t ) == sizeof( sock_filter ), "bpf instruction must match sock_filter" );
+
+int next_platform_socket_kernel_packet_filter( next_platform_socket_t * socket, bool enable )
+{
+    next_assert( socket );
+
+    if ( !enable )
+    {
+        int dummy = 0;
+        if ( setsockopt( socket->handle, SOL_SOCKET, SO_DETACH_FILTER, &dummy, sizeof(dummy) ) != 0 && errno != ENOENT )
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to detach kernel packet filter (%d)", errno );
+            return NEXT_ERROR;
+        }
+        return NEXT_OK;
+    }
+
+    next_bpf_instruction_t program[NEXT_BPF_MAX_INSTRUCTIONS];
+
+    const int num_instructions = next_basic_packet_filter_bpf( program, NEXT_BPF_MAX_INSTRUCTIONS );
+    if ( num_instructions <= 0 )
+        return NEXT_ERROR;
+
+    sock_fprog filter;
+    filter.len = (unsigned short) num_instructions;
+    filter.filter = (sock_filter*) program;
+
+    if ( setsockopt( socket->handle, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter) ) != 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "failed to attach kernel packet filter (%d)", errno );
+        return NEXT_ERROR;
+    }
+
+    return NEXT_OK;
+}
+
+int next_platform_socket_io_uring( next_platform_socket_t * socket )
+{
+    next_assert( socket );
+
+    if ( socket->io_uring )
+        return NEXT_OK;
+
+    if ( socket->xdp )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "io_uring can't be used together with xdp on the same socket" );
+        return NEXT_ERROR;
+    }
+
+    socket->io_uring = next_io_uring_create( socket->context, socket->handle );
+
+    return socket->io_uring ? NEXT_OK : NEXT_ERROR;
+}
+
+void next_platform_socket_send_batch_begin( next_platform_socket_t * socket )
+{
+    next_assert( socket );
+
+    if ( socket->io_uring )
+    {
+        next_io_uring_send_batch_begin( socket->io_uring );
+    }
+
+    if ( socket->xdp )
+    {
+        next_xdp_send_batch_begin( socket->xdp );
+    }
+}
+
+void next_platform_socket_send_batch_end( next_platform_socket_t * socket )
+{
+    next_assert( socket );
+
+    if ( socket->io_uring )
+    {
+        next_io_uring_send_batch_end( socket->io_uring );
+    }
+
+    if ( socket->xdp )
+    {
+        next_xdp_send_batch_end( socket->xdp );
+    }
+}
+
+int next_platform_socket_xdp( next_platform_socket_t * socket, const char * interface_name, int queue )
+{
+    next_assert( socket );
+    next_assert( interface_name );
+
+    if ( socket->xdp )
+        return NEXT_OK;
+
+    if ( socket->io_uring )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp can't be used together with io_uring on the same socket" );
+        return NEXT_ERROR;
+    }
+
+    sockaddr_storage address;
+    socklen_t address_length = sizeof(address);
+    if ( getsockname( socket->handle, (sockaddr*) &address, &address_length ) != 0 )
+        return NEXT_ERROR;
+
+    const uint16_t port = next_platform_ntohs( address.ss_family == AF_INET6 ? ( (sockaddr_in6*) &address )->sin6_port : ( (sockaddr_in*) &address )->sin_port );
+
+    socket->xdp = next_xdp_create( socket->context, interface_name, queue, port );
+
+    return socket->xdp ? NEXT_OK : NEXT_ERROR;
+}
+
 // ---------------------------------------------------
 
 struct thread_shim_data_t
@@ -591,6 +962,23 @@ void next_platform_server_thread_priority( next_platform_thread_t * thread )
     pthread_setschedparam( thread->handle, SCHED_RR, &param );
 }
 
+int next_platform_thread_affinity( next_platform_thread_t * thread, int cpu )
+{
+    next_assert( thread );
+
+    if ( cpu < 0 || cpu >= CPU_SETSIZE || cpu >= sysconf( _SC_NPROCESSORS_CONF ) )
+        return NEXT_ERROR;
+
+    cpu_set_t cpu_set;
+    CPU_ZERO( &cpu_set );
+    CPU_SET( cpu, &cpu_set );
+
+    if ( pthread_setaffinity_np( thread->handle, sizeof(cpu_set), &cpu_set ) != 0 )
+        return NEXT_ERROR;
+
+    return NEXT_OK;
+}
+
 // ---------------------------------------------------
 
 int next_platform_mutex_create( next_platform_mutex_t * mutex )
@@ -639,6 +1027,85 @@ void next_platform_mutex_destroy( next_platform_mutex_t * mutex )
 
 // ---------------------------------------------------
 
+int next_platform_semaphore_create( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+
+    memset( semaphore, 0, sizeof(next_platform_semaphore_t) );
+
+    if ( pthread_mutex_init( &semaphore->mutex, NULL ) != 0 )
+        return NEXT_ERROR;
+
+    // IMPORTANT: wait with the monotonic clock, so changes to the wall clock don't stretch or cut short a timeout
+
+    pthread_condattr_t attr;
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    const int result = pthread_cond_init( &semaphore->cond, &attr );
+    pthread_condattr_destroy( &attr );
+
+    if ( result != 0 )
+    {
+        pthread_mutex_destroy( &semaphore->mutex );
+        return NEXT_ERROR;
+    }
+
+    semaphore->ok = true;
+
+    return NEXT_OK;
+}
+
+void next_platform_semaphore_destroy( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    if ( semaphore->ok )
+    {
+        pthread_cond_destroy( &semaphore->cond );
+        pthread_mutex_destroy( &semaphore->mutex );
+        memset( semaphore, 0, sizeof(next_platform_semaphore_t) );
+    }
+}
+
+void next_platform_semaphore_signal( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    next_assert( semaphore->ok );
+    pthread_mutex_lock( &semaphore->mutex );
+    semaphore->count++;
+    pthread_cond_signal( &semaphore->cond );
+    pthread_mutex_unlock( &semaphore->mutex );
+}
+
+bool next_platform_semaphore_wait( next_platform_semaphore_t * semaphore, double timeout_seconds )
+{
+    next_assert( semaphore );
+    next_assert( semaphore->ok );
+
+    timespec deadline;
+    clock_gettime( CLOCK_MONOTONIC, &deadline );
+    const long long timeout_nanoseconds = timeout_seconds > 0.0 ? (long long) ( timeout_seconds * 1000000000.0 ) : 0;
+    const long long nanoseconds = deadline.tv_nsec + timeout_nanoseconds % 1000000000LL;
+    deadline.tv_sec += time_t( timeout_nanoseconds / 1000000000LL + nanoseconds / 1000000000LL );
+    deadline.tv_nsec = long( nanoseconds % 1000000000LL );
+
+    pthread_mutex_lock( &semaphore->mutex );
+    while ( semaphore->count == 0 )
+    {
+        if ( pthread_cond_timedwait( &semaphore->cond, &semaphore->mutex, &deadline ) == ETIMEDOUT )
+            break;
+    }
+    const bool signaled = semaphore->count > 0;
+    if ( signaled )
+    {
+        semaphore->count--;
+    }
+    pthread_mutex_unlock( &semaphore->mutex );
+
+    return signaled;
+}
+
+// ---------------------------------------------------
+
 extern void * next_global_context;
 
 template <typename T> struct next_vector_t
@@ -26,6 +26,7 @@
 
 #include "next_platform.h"
 #include "next_address.h"
+#include "next_impairment.h"
 
 #define __APPLE_USE_RFC_3542
 
@@ -421,6 +422,10 @@ void next_platform_socket_destroy( next_platform_socket_t * socket )
 {
     next_assert( socket );
 
+#if NEXT_DEVELOPMENT
+    next_impairment_purge( socket );
+#endif // #if NEXT_DEVELOPMENT
+
     if ( socket->handle != 0 )
     {
         close( socket->handle );
@@ -431,6 +436,11 @@ void next_platform_socket_destroy( next_platform_socket_t * socket )
 
 void next_platform_socket_send_packet( next_platform_socket_t * socket, const next_address_t * input_to, const void * packet_data, int packet_bytes )
 {
+#if NEXT_DEVELOPMENT
+    if ( next_impairment_send( socket, input_to, packet_data, packet_bytes ) )
+        return;
+#endif // #if NEXT_DEVELOPMENT
+
     next_assert( socket );
     next_assert( input_to );
     next_assert( input_to->type == NEXT_ADDRESS_IPV6 || input_to->type == NEXT_ADDRESS_IPV4 );
@@ -553,6 +563,58 @@ int next_platform_socket_receive_packet( next_platform_socket_t * socket, next_a
     return result;
 }
 
+int next_platform_socket_receive_packet_with_timestamp( next_platform_socket_t * socket, next_address_t * from, void * packet_data, int max_packet_size, double * receive_time )
+{
+    // kernel receive timestamps are not supported on this platform, so stamp the packet when it is read
+
+    const int packet_bytes = next_platform_socket_receive_packet( socket, from, packet_data, max_packet_size );
+    if ( packet_bytes > 0 && receive_time )
+    {
+        *receive_time = next_platform_time();
+    }
+    return packet_bytes;
+}
+
+int next_platform_socket_busy_poll( next_platform_socket_t * socket, int busy_poll_microseconds )
+{
+    // busy poll receive is not supported on this platform
+    (void) socket;
+    (void) busy_poll_microseconds;
+    return NEXT_ERROR;
+}
+
+int next_platform_socket_kernel_packet_filter( next_platform_socket_t * socket, bool enable )
+{
+    // kernel packet filters are not supported on this platform
+    (void) socket;
+    return enable ? NEXT_ERROR : NEXT_OK;
+}
+
+int next_platform_socket_io_uring( next_platform_socket_t * socket )
+{
+    // io_uring is linux only
+    (void) socket;
+    return NEXT_ERROR;
+}
+
+void next_platform_socket_send_batch_begin( next_platform_socket_t * socket )
+{
+    (void) socket;
+}
+
+void next_platform_socket_send_batch_end( next_platform_socket_t * socket )
+{
+    (void) socket;
+}
+
+int next_platform_socket_xdp( next_platform_socket_t * socket, const char * interface_name, int queue )
+{
+    (void) socket;
+    (void) interface_name;
+    (void) queue;
+    return NEXT_ERROR;
+}
+
 // ---------------------------------------------------
 
 struct thread_shim_data_t
@@ -631,6 +693,14 @@ void next_platform_server_thread_priority( next_platform_thread_t * thread )
     pthread_setschedparam( thread->handle, SCHED_RR, &param );
 }
 
+int next_platform_thread_affinity( next_platform_thread_t * thread, int cpu )
+{
+    // IMPORTANT: thread affinity is not set by the SDK on this platform. adjust it in the thread priority functions above.
+    (void) thread;
+    (void) cpu;
+    return NEXT_ERROR;
+}
+
 // ---------------------------------------------------
 
 int next_platform_mutex_create( next_platform_mutex_t * mutex )
@@ -681,6 +751,79 @@ void next_platform_mutex_destroy( next_platform_mutex_t * mutex )
 
 // ---------------------------------------------------
 
+int next_platform_semaphore_create( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+
+    memset( semaphore, 0, sizeof(next_platform_semaphore_t) );
+
+    if ( pthread_mutex_init( &semaphore->mutex, NULL ) != 0 )
+        return NEXT_ERROR;
+
+    if ( pthread_cond_init( &semaphore->cond, NULL ) != 0 )
+    {
+        pthread_mutex_destroy( &semaphore->mutex );
+        return NEXT_ERROR;
+    }
+
+    semaphore->ok = true;
+
+    return NEXT_OK;
+}
+
+void next_platform_semaphore_destroy( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    if ( semaphore->ok )
+    {
+        pthread_cond_destroy( &semaphore->cond );
+        pthread_mutex_destroy( &semaphore->mutex );
+        memset( semaphore, 0, sizeof(next_platform_semaphore_t) );
+    }
+}
+
+void next_platform_semaphore_signal( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    next_assert( semaphore->ok );
+    pthread_mutex_lock( &semaphore->mutex );
+    semaphore->count++;
+    pthread_cond_signal( &semaphore->cond );
+    pthread_mutex_unlock( &semaphore->mutex );
+}
+
+bool next_platform_semaphore_wait( next_platform_semaphore_t * semaphore, double timeout_seconds )
+{
+    next_assert( semaphore );
+    next_assert( semaphore->ok );
+
+    // IMPORTANT: mac has no monotonic clock for condition variables, so wait relative to now and recompute what is left after each wakeup
+
+    const double deadline = next_platform_time() + timeout_seconds;
+
+    pthread_mutex_lock( &semaphore->mutex );
+    while ( semaphore->count == 0 )
+    {
+        const double remaining = deadline - next_platform_time();
+        if ( remaining <= 0.0 )
+            break;
+        timespec wait_time;
+        wait_time.tv_sec = time_t( remaining );
+        wait_time.tv_nsec = long( ( remaining - double( wait_time.tv_sec ) ) * 1000000000.0 );
+        pthread_cond_timedwait_relative_np( &semaphore->cond, &semaphore->mutex, &wait_time );
+    }
+    const bool signaled = semaphore->count > 0;
+    if ( signaled )
+    {
+        semaphore->count--;
+    }
+    pthread_mutex_unlock( &semaphore->mutex );
+
+    return signaled;
+}
+
+// ---------------------------------------------------
+
 bool next_platform_packet_tagging_can_be_enabled()
 {
     return true;
@@ -26,6 +26,7 @@
 
 #include "next_platform.h"
 #include "next_address.h"
+#include "next_impairment.h"
 
 #include <nn/socket.h>
 #include <nn/crypto.h>
@@ -96,6 +97,14 @@ void next_platform_server_thread_priority( next_platform_thread_t * thread )
     (void) thread;
 }
 
+int next_platform_thread_affinity( next_platform_thread_t * thread, int cpu )
+{
+    // IMPORTANT: thread affinity is not set by the SDK on this platform. adjust it in the thread priority functions above.
+    (void) thread;
+    (void) cpu;
+    return NEXT_ERROR;
+}
+
 int next_platform_mutex_create( next_platform_mutex_t * mutex )
 {
     next_assert( mutex );
@@ -122,6 +131,35 @@ void next_platform_mutex_destroy( next_platform_mutex_t * mutex )
     memset( mutex, 0, sizeof(next_platform_mutex_t) );
 }
 
+// semaphore
+
+int next_platform_semaphore_create( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    nn::os::InitializeSemaphore( &semaphore->handle, 0, 0x7FFFFFFF );
+    return NEXT_OK;
+}
+
+void next_platform_semaphore_destroy( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    nn::os::FinalizeSemaphore( &semaphore->handle );
+    memset( semaphore, 0, sizeof(next_platform_semaphore_t) );
+}
+
+void next_platform_semaphore_signal( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    nn::os::ReleaseSemaphore( &semaphore->handle );
+}
+
+bool next_platform_semaphore_wait( next_platform_semaphore_t * semaphore, double timeout_seconds )
+{
+    next_assert( semaphore );
+    const int64_t microseconds = timeout_seconds > 0.0 ? int64_t( timeout_seconds * 1000000.0 ) : 0;
+    return nn::os::TimedAcquireSemaphore( &semaphore->handle, nn::TimeSpan::FromMicroSeconds( microseconds ) );
+}
+
 // time
 
 void next_platform_sleep( double time )
@@ -453,6 +491,10 @@ void next_platform_socket_destroy( next_platform_socket_t * socket )
 {
     next_assert( socket );
 
+#if NEXT_DEVELOPMENT
+    next_impairment_purge( socket );
+#endif // #if NEXT_DEVELOPMENT
+
     next_platform_socket_cleanup( socket );
 
     next_free( socket->context, socket );
@@ -460,6 +502,11 @@ void next_platform_socket_destroy( next_platform_socket_t * socket )
 
 void next_platform_socket_send_packet( next_platform_socket_t * socket, const next_address_t * to, const void * packet_data, int packet_bytes )
 {
+#if NEXT_DEVELOPMENT
+    if ( next_impairment_send( socket, to, packet_data, packet_bytes ) )
+        return;
+#endif // #if NEXT_DEVELOPMENT
+
     next_assert( socket );
     next_assert( to );
     next_assert( to->type == NEXT_ADDRESS_IPV4 );
@@ -555,6 +602,58 @@ int next_platform_socket_receive_packet( next_platform_socket_t * socket, next_a
     return result;
 }
 
+int next_platform_socket_receive_packet_with_timestamp( next_platform_socket_t * socket, next_address_t * from, void * packet_data, int max_packet_size, double * receive_time )
+{
+    // kernel receive timestamps are not supported on this platform, so stamp the packet when it is read
+
+    const int packet_bytes = next_platform_socket_receive_packet( socket, from, packet_data, max_packet_size );
+    if ( packet_bytes > 0 && receive_time )
+    {
+        *receive_time = next_platform_time();
+    }
+    return packet_bytes;
+}
+
+int next_platform_socket_busy_poll( next_platform_socket_t * socket, int busy_poll_microseconds )
+{
+    // busy poll receive is not supported on this platform
+    (void) socket;
+    (void) busy_poll_microseconds;
+    return NEXT_ERROR;
+}
+
+int next_platform_socket_kernel_packet_filter( next_platform_socket_t * socket, bool enable )
+{
+    // kernel packet filters are not supported on this platform
+    (void) socket;
+    return enable ? NEXT_ERROR : NEXT_OK;
+}
+
+int next_platform_socket_io_uring( next_platform_socket_t * socket )
+{
+    // io_uring is linux only
+    (void) socket;
+    return NEXT_ERROR;
+}
+
+void next_platform_socket_send_batch_begin( next_platform_socket_t * socket )
+{
+    (void) socket;
+}
+
+void next_platform_socket_send_batch_end( next_platform_socket_t * socket )
+{
+    (void) socket;
+}
+
+int next_platform_socket_xdp( next_platform_socket_t * socket, const char * interface_name, int queue )
+{
+    (void) socket;
+    (void) interface_name;
+    (void) queue;
+    return NEXT_ERROR;
+}
+
 int next_platform_id()
 {
     return NEXT_PLATFORM_SWITCH;
@@ -26,6 +26,7 @@
 
 #include "next_platform.h"
 #include "next_address.h"
+#include "next_impairment.h"
 
 #if NEXT_UNREAL_ENGINE
 #include "Windows/AllowWindowsPlatformTypes.h"
@@ -179,6 +180,19 @@ void next_platform_server_thread_priority( next_platform_thread_t * thread )
     SetThreadPriority( thread->handle, THREAD_PRIORITY_TIME_CRITICAL );
 }
 
+int next_platform_thread_affinity( next_platform_thread_t * thread, int cpu )
+{
+    next_assert( thread );
+
+    if ( cpu < 0 || cpu >= int( sizeof(DWORD_PTR) * 8 ) )
+        return NEXT_ERROR;
+
+    if ( SetThreadAffinityMask( thread->handle, DWORD_PTR(1) << cpu ) == 0 )
+        return NEXT_ERROR;
+
+    return NEXT_OK;
+}
+
 int next_platform_mutex_create( next_platform_mutex_t * mutex )
 {
     next_assert( mutex );
@@ -219,6 +233,48 @@ void next_platform_mutex_destroy( next_platform_mutex_t * mutex )
     }
 }
 
+// semaphore
+
+int next_platform_semaphore_create( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+
+    memset( semaphore, 0, sizeof(next_platform_semaphore_t) );
+
+    semaphore->handle = CreateSemaphoreA( NULL, 0, 0x7FFFFFFF, NULL );
+    if ( semaphore->handle == NULL )
+        return NEXT_ERROR;
+
+    semaphore->ok = true;
+
+    return NEXT_OK;
+}
+
+void next_platform_semaphore_destroy( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    if ( semaphore->ok )
+    {
+        CloseHandle( semaphore->handle );
+        memset( semaphore, 0, sizeof(next_platform_semaphore_t) );
+    }
+}
+
+void next_platform_semaphore_signal( next_platform_semaphore_t * semaphore )
+{
+    next_assert( semaphore );
+    next_assert( semaphore->ok );
+    ReleaseSemaphore( semaphore->handle, 1, NULL );
+}
+
+bool next_platform_semaphore_wait( next_platform_semaphore_t * semaphore, double timeout_seconds )
+{
+    next_assert( semaphore );
+    next_assert( semaphore->ok );
+    const DWORD milliseconds = timeout_seconds > 0.0 ? DWORD( timeout_seconds * 1000.0 ) : 0;
+    return WaitForSingleObject( semaphore->handle, milliseconds ) == WAIT_OBJECT_0;
+}
+
 // time
 
 void next_platform_sleep( double time )
@@ -528,6 +584,10 @@ void next_platform_socket_destroy( next_platform_socket_t * socket )
 {
     next_assert( socket );
 
+#if NEXT_DEVELOPMENT
+    next_impairment_purge( socket );
+#endif // #if NEXT_DEVELOPMENT
+
     if ( socket->handle != 0 )
     {
         closesocket( socket->handle );
@@ -539,6 +599,11 @@ void next_platform_socket_destroy( next_platform_socket_t * socket )
 
 void next_platform_socket_send_packet( next_platform_socket_t * socket, const next_address_t * input_to, const void * packet_data, int packet_bytes )
 {
+#if NEXT_DEVELOPMENT
+    if ( next_impairment_send( socket, input_to, packet_data, packet_bytes ) )
+        return;
+#endif // #if NEXT_DEVELOPMENT
+
     next_assert( socket );
     next_assert( input_to );
     next_assert( input_to->type == NEXT_ADDRESS_IPV6 || input_to->type == NEXT_ADDRESS_IPV4 );
@@ -665,6 +730,58 @@ int next_platform_socket_receive_packet( next_platform_socket_t * socket, next_a
     return result;
 }
 
+int next_platform_socket_receive_packet_with_timestamp( next_platform_socket_t * socket, next_address_t * from, void * packet_data, int max_packet_size, double * receive_time )
+{
+    // kernel receive timestamps are not supported on this platform, so stamp the packet when it is read
+
+    const int packet_bytes = next_platform_socket_receive_packet( socket, from, packet_data, max_packet_size );
+    if ( packet_bytes > 0 && receive_time )
+    {
+        *receive_time = next_platform_time();
+    }
+    return packet_bytes;
+}
+
+int next_platform_socket_busy_poll( next_platform_socket_t * socket, int busy_poll_microseconds )
+{
+    // busy poll receive is not supported on this platform
+    (void) socket;
+    (void) busy_poll_microseconds;
+    return NEXT_ERROR;
+}
+
+int next_platform_socket_kernel_packet_filter( next_platform_socket_t * socket, bool enable )
+{
+    // kernel packet filters are not supported on this platform
+    (void) socket;
+    return enable ? NEXT_ERROR : NEXT_OK;
+}
+
+int next_platform_socket_io_uring( next_platform_socket_t * socket )
+{
+    // io_uring is linux only
+    (void) socket;
+    return NEXT_ERROR;
+}
+
+void next_platform_socket_send_batch_begin( next_platform_socket_t * socket )
+{
+    (void) socket;
+}
+
+void next_platform_socket_send_batch_end( next_platform_socket_t * socket )
+{
+    (void) socket;
+}
+
+int next_platform_socket_xdp( next_platform_socket_t * socket, const char * interface_name, int queue )
+{
+    (void) socket;
+    (void) interface_name;
+    (void) queue;
+    return NEXT_ERROR;
+}
+
 extern void * next_global_context;
 
 static int get_connection_type()
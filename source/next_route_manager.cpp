@@ -33,6 +33,7 @@
 #include "next_header.h"
 
 #include <memory.h>
+#include <atomic>
 
 struct next_route_data_t
 {
@@ -126,18 +127,29 @@ void next_route_data_verify_sentinels( next_route_data_t * route_data )
     NEXT_VERIFY_SENTINEL( route_data, 9 )
 }
 
+#define NEXT_ROUTE_MANAGER_SEND_ROUTE_WORDS ( ( sizeof(next_route_manager_send_route_t) + 7 ) / 8 )
+
 struct next_route_manager_t
 {
     NEXT_DECLARE_SENTINEL(0)
 
     void * context;
-    uint64_t send_sequence;
     bool fallback_to_direct;
     next_route_data_t route_data;
     double last_route_update_time;
     uint32_t flags;
 
     NEXT_DECLARE_SENTINEL(1)
+
+    // IMPORTANT: read by the game thread without the route manager mutex. The send route is a copy of the current route,
+    // published with a seqlock whenever it changes: the sequence is odd while a write is in progress, and readers retry
+    // until they see the same even sequence before and after copying the words out.
+
+    std::atomic<uint64_t> send_sequence;
+    std::atomic<uint32_t> send_route_sequence;
+    std::atomic<uint64_t> send_route_words[NEXT_ROUTE_MANAGER_SEND_ROUTE_WORDS];
+
+    NEXT_DECLARE_SENTINEL(2)
 };
 
 void next_route_manager_initialize_sentinels( next_route_manager_t * route_manager )
@@ -146,6 +158,7 @@ void next_route_manager_initialize_sentinels( next_route_manager_t * route_manag
     next_assert( route_manager );
     NEXT_INITIALIZE_SENTINEL( route_manager, 0 )
     NEXT_INITIALIZE_SENTINEL( route_manager, 1 )
+    NEXT_INITIALIZE_SENTINEL( route_manager, 2 )
     next_route_data_initialize_sentinels( &route_manager->route_data );
 }
 
@@ -155,15 +168,45 @@ void next_route_manager_verify_sentinels( next_route_manager_t * route_manager )
     next_assert( route_manager );
     NEXT_VERIFY_SENTINEL( route_manager, 0 )
     NEXT_VERIFY_SENTINEL( route_manager, 1 )
+    NEXT_VERIFY_SENTINEL( route_manager, 2 )
     next_route_data_verify_sentinels( &route_manager->route_data );
 }
 
+static void next_route_manager_publish_send_route( next_route_manager_t * route_manager )
+{
+    next_route_manager_send_route_t send_route;
+    memset( &send_route, 0, sizeof(send_route) );
+    send_route.current_route = route_manager->route_data.current_route;
+    if ( send_route.current_route )
+    {
+        send_route.next_address = route_manager->route_data.current_route_next_address;
+        send_route.session_id = route_manager->route_data.current_route_session_id;
+        send_route.session_version = route_manager->route_data.current_route_session_version;
+        memcpy( send_route.private_key, route_manager->route_data.current_route_private_key, NEXT_CRYPTO_BOX_SECRETKEYBYTES );
+    }
+
+    uint64_t words[NEXT_ROUTE_MANAGER_SEND_ROUTE_WORDS];
+    memset( words, 0, sizeof(words) );
+    memcpy( words, &send_route, sizeof(send_route) );
+
+    // IMPORTANT: only the internal thread publishes, always with the route manager mutex held, so there is a single writer
+
+    const uint32_t sequence = route_manager->send_route_sequence.load( std::memory_order_relaxed );
+    route_manager->send_route_sequence.store( sequence + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    for ( size_t i = 0; i < NEXT_ROUTE_MANAGER_SEND_ROUTE_WORDS; ++i )
+    {
+        route_manager->send_route_words[i].store( words[i], std::memory_order_relaxed );
+    }
+    route_manager->send_route_sequence.store( sequence + 2, std::memory_order_release );
+}
+
 next_route_manager_t * next_route_manager_create( void * context )
 {
     next_route_manager_t * route_manager = (next_route_manager_t*) next_malloc( context, sizeof(next_route_manager_t) );
     if ( !route_manager )
         return NULL;
-    memset( route_manager, 0, sizeof(next_route_manager_t) );
+    memset( (char*) route_manager, 0, sizeof(next_route_manager_t) );
     next_route_manager_initialize_sentinels( route_manager );
     route_manager->context = context;
     return route_manager;
@@ -173,7 +216,7 @@ void next_route_manager_reset( next_route_manager_t * route_manager )
 {
     next_route_manager_verify_sentinels( route_manager );
 
-    route_manager->send_sequence = 0;
+    route_manager->send_sequence.store( 0, std::memory_order_relaxed );
     route_manager->fallback_to_direct = false;
     route_manager->last_route_update_time = 0.0;
 
@@ -183,6 +226,8 @@ void next_route_manager_reset( next_route_manager_t * route_manager )
 
     route_manager->flags = 0;
 
+    next_route_manager_publish_send_route( route_manager );
+
     next_route_manager_verify_sentinels( route_manager );
 }
 
@@ -205,6 +250,8 @@ void next_route_manager_fallback_to_direct( next_route_manager_t * route_manager
     memcpy( route_manager->route_data.previous_route_private_key, route_manager->route_data.current_route_private_key, NEXT_CRYPTO_BOX_SECRETKEYBYTES );
 
     route_manager->route_data.current_route = false;
+
+    next_route_manager_publish_send_route( route_manager );
 }
 
 void next_route_manager_direct_route( next_route_manager_t * route_manager, bool quiet )
@@ -225,6 +272,8 @@ void next_route_manager_direct_route( next_route_manager_t * route_manager, bool
     memcpy( route_manager->route_data.previous_route_private_key, route_manager->route_data.current_route_private_key, NEXT_CRYPTO_BOX_SECRETKEYBYTES );
 
     route_manager->route_data.current_route = false;
+
+    next_route_manager_publish_send_route( route_manager );
 }
 
 void next_route_manager_begin_next_route( next_route_manager_t * route_manager, int num_tokens, uint8_t * tokens, const uint8_t * client_secret_key, const uint8_t * magic, const next_address_t * client_external_address )
@@ -380,24 +429,53 @@ bool next_route_manager_has_network_next_route( next_route_manager_t * route_man
 uint64_t next_route_manager_next_send_sequence( next_route_manager_t * route_manager )
 {
     next_route_manager_verify_sentinels( route_manager );
-    return route_manager->send_sequence++;
+    return route_manager->send_sequence.fetch_add( 1, std::memory_order_relaxed );
 }
 
-bool next_route_manager_prepare_send_packet( next_route_manager_t * route_manager, uint64_t sequence, next_address_t * to, const uint8_t * payload_data, int payload_bytes, uint8_t * packet_data, int * packet_bytes, const uint8_t * magic, const next_address_t * client_external_address )
+void next_route_manager_get_send_route( next_route_manager_t * route_manager, next_route_manager_send_route_t * send_route )
 {
     next_route_manager_verify_sentinels( route_manager );
 
-    if ( !route_manager->route_data.current_route )
+    next_assert( send_route );
+
+    uint64_t words[NEXT_ROUTE_MANAGER_SEND_ROUTE_WORDS];
+
+    while ( true )
+    {
+        const uint32_t sequence_before = route_manager->send_route_sequence.load( std::memory_order_acquire );
+        if ( sequence_before & 1 )
+            continue;
+
+        for ( size_t i = 0; i < NEXT_ROUTE_MANAGER_SEND_ROUTE_WORDS; ++i )
+        {
+            words[i] = route_manager->send_route_words[i].load( std::memory_order_relaxed );
+        }
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+
+        if ( route_manager->send_route_sequence.load( std::memory_order_relaxed ) == sequence_before )
+            break;
+    }
+
+    memcpy( send_route, words, sizeof(next_route_manager_send_route_t) );
+}
+
+bool next_route_manager_prepare_send_packet( next_route_manager_t * route_manager, const next_route_manager_send_route_t * send_route, uint64_t sequence, next_address_t * to, const uint8_t * payload_data, int payload_bytes, uint8_t * packet_data, int * packet_bytes, const uint8_t * magic, const next_address_t * client_external_address )
+{
+    next_route_manager_verify_sentinels( route_manager );
+
+    next_assert( send_route );
+
+    if ( !send_route->current_route )
         return false;
 
-    next_assert( route_manager->route_data.current_route );
     next_assert( to );
     next_assert( payload_data );
     next_assert( payload_bytes );
     next_assert( packet_data );
     next_assert( packet_bytes );
 
-    *to = route_manager->route_data.current_route_next_address;
+    *to = send_route->next_address;
 
     uint8_t from_address_data[4];
     uint8_t to_address_data[4];
@@ -405,7 +483,7 @@ bool next_route_manager_prepare_send_packet( next_route_manager_t * route_manage
     next_address_data( client_external_address, from_address_data );
     next_address_data( to, to_address_data );
 
-    *packet_bytes = next_write_client_to_server_packet( packet_data, sequence, route_manager->route_data.current_route_session_id, route_manager->route_data.current_route_session_version, route_manager->route_data.current_route_private_key, payload_data, payload_bytes, magic, from_address_data, to_address_data );
+    *packet_bytes = next_write_client_to_server_packet( packet_data, sequence, send_route->session_id, send_route->session_version, send_route->private_key, payload_data, payload_bytes, magic, from_address_data, to_address_data );
 
     if ( *packet_bytes == 0 )
     {
@@ -641,6 +719,8 @@ void next_route_manager_confirm_pending_route( next_route_manager_t * route_mana
     route_manager->route_data.current_route = true;
     route_manager->route_data.pending_route = false;
 
+    next_route_manager_publish_send_route( route_manager );
+
     *route_kbps_up = route_manager->route_data.current_route_kbps_up;
     *route_kbps_down = route_manager->route_data.current_route_kbps_down;
 }
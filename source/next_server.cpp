@@ -22,6 +22,7 @@
 
 #include "next_server.h"
 #include "next_queue.h"
+#include "next_pool.h"
 #include "next_hash.h"
 #include "next_pending_session_manager.h"
 #include "next_proxy_session_manager.h"
@@ -34,6 +35,8 @@
 #include "next_internal_config.h"
 #include "next_platform.h"
 #include "next_relay_manager.h"
+#include "next_crypto_worker.h"
+#include "next_latency_histogram.h"
 
 #include <atomic>
 #include <stdio.h>
@@ -90,6 +93,16 @@ struct next_server_command_set_payload_receive_callback_t : public next_server_c
     void * callback_data;
 };
 
+union next_server_command_storage_t
+{
+    next_server_command_upgrade_session_t upgrade_session;
+    next_server_command_session_event_t session_event;
+    next_server_command_flush_t flush;
+    next_server_command_set_packet_receive_callback_t set_packet_receive_callback;
+    next_server_command_set_send_packet_to_address_callback_t set_send_packet_to_address_callback;
+    next_server_command_set_payload_receive_callback_t set_payload_receive_callback;
+};
+
 // ---------------------------------------------------------------
 
 #define NEXT_SERVER_NOTIFY_PACKET_RECEIVED                      0
@@ -109,6 +122,7 @@ struct next_server_notify_t
 
 struct next_server_notify_packet_received_t : public next_server_notify_t
 {
+    double queue_time;
     next_address_t from;
     int packet_bytes;
     uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
@@ -130,6 +144,8 @@ struct next_server_notify_session_upgraded_t : public next_server_notify_t
 {
     next_address_t address;
     uint64_t session_id;
+    bool payload_coalescing;
+    bool fec;
 };
 
 struct next_server_notify_session_timed_out_t : public next_server_notify_t
@@ -163,6 +179,20 @@ struct next_server_notify_direct_only_t : public next_server_notify_t
     // ...
 };
 
+union next_server_notify_storage_t
+{
+    next_server_notify_packet_received_t packet_received;
+    next_server_notify_pending_session_cancelled_t pending_session_cancelled;
+    next_server_notify_pending_session_timed_out_t pending_session_timed_out;
+    next_server_notify_session_upgraded_t session_upgraded;
+    next_server_notify_session_timed_out_t session_timed_out;
+    next_server_notify_init_timed_out_t init_timed_out;
+    next_server_notify_ready_t ready;
+    next_server_notify_flush_finished_t flush_finished;
+    next_server_notify_magic_updated_t magic_updated;
+    next_server_notify_direct_only_t direct_only;
+};
+
 // ---------------------------------------------------------------
 
 struct next_server_internal_t;
@@ -189,9 +219,15 @@ void next_server_internal_send_packet_to_address( next_server_internal_t * serve
 
 void next_server_internal_send_packet_to_backend( next_server_internal_t * server, const uint8_t * packet_data, int packet_bytes );
 
+int next_server_internal_send_backend_packet( next_server_internal_t * server, uint8_t packet_id, void * packet_object );
+
+int next_server_internal_resend_backend_packet( next_server_internal_t * server, uint8_t packet_id, void * packet_object );
+
+next_backend_packet_cache_t * next_server_internal_backend_packet_cache( next_server_internal_t * server, uint8_t packet_id, const next_address_t * client_address );
+
 int next_server_internal_send_packet( next_server_internal_t * server, const next_address_t * to_address, uint8_t packet_id, void * packet_object );
 
-next_session_entry_t * next_server_internal_process_client_to_server_packet( next_server_internal_t * server, uint8_t packet_type, uint8_t * packet_data, int packet_bytes );
+next_session_entry_t * next_server_internal_process_client_to_server_packet( next_server_internal_t * server, uint8_t packet_type, uint8_t * packet_data, int packet_bytes, uint64_t * payload_sequence );
 
 void next_server_internal_update_ready( next_server_internal_t * server );
 
@@ -207,12 +243,18 @@ void next_server_internal_update_sessions( next_server_internal_t * server );
 
 void next_server_internal_update_flush( next_server_internal_t * server );
 
-void next_server_internal_process_network_next_packet( next_server_internal_t * server, const next_address_t * from, uint8_t * packet_data, int begin, int end );
+void next_server_internal_process_network_next_packet( next_server_internal_t * server, const next_address_t * from, uint8_t * packet_data, int begin, int end, bool backend_packet_verified );
 
 void next_server_internal_process_passthrough_packet( next_server_internal_t * server, const next_address_t * from, uint8_t * packet_data, int packet_bytes );
 
 void next_server_internal_block_and_receive_packet( next_server_internal_t * server );
 
+void next_server_internal_pump_crypto_worker( next_server_internal_t * server );
+
+void next_server_internal_create_wake_socket( next_server_internal_t * server );
+
+void next_server_internal_wake( void * data );
+
 void next_server_internal_upgrade_session( next_server_internal_t * server, const next_address_t * address, uint64_t session_id, uint64_t user_hash );
 
 void next_server_internal_session_events( next_server_internal_t * server, const next_address_t * address, uint64_t session_events );
@@ -264,14 +306,24 @@ struct next_server_internal_t
     next_address_t backend_address;
     next_address_t server_address;
     next_address_t bind_address;
+    next_arena_t * arena;
+    next_pool_t * notify_pool;
+    next_pool_t * command_pool;
     next_queue_t * command_queue;
     next_queue_t * notify_queue;
+    next_queue_t * payload_queue;
     next_platform_mutex_t session_mutex;
     next_platform_mutex_t command_mutex;
     next_platform_mutex_t notify_mutex;
     next_platform_socket_t * socket;
     next_pending_session_manager_t * pending_session_manager;
     next_session_manager_t * session_manager;
+    next_crypto_worker_t * crypto_worker;
+    uint64_t backend_packet_cache_sequence;
+    next_platform_socket_t * wake_socket;
+    next_address_t wake_address;
+    next_address_t wake_socket_address;
+    std::atomic<bool> wake_pending;
 
     NEXT_DECLARE_SENTINEL(3)
 
@@ -321,6 +373,7 @@ struct next_server_internal_t
     double server_update_resend_time;
     int server_update_num_sessions;
     bool server_update_first;
+    next_backend_packet_cache_t server_update_packet_cache;
 
     NEXT_DECLARE_SENTINEL(9)
 
@@ -329,6 +382,7 @@ struct next_server_internal_t
     double next_server_relay_request_packet_send_time;
     double server_relay_request_timeout_time;
     NextBackendServerRelayRequestPacket server_relay_request_packet;    
+    next_backend_packet_cache_t server_relay_request_packet_cache;
 
     NEXT_DECLARE_SENTINEL(10)
 
@@ -373,7 +427,16 @@ struct next_server_internal_t
     int (*payload_receive_callback)( void * data, const next_address_t * client_address, const uint8_t * payload_data, int payload_bytes );
     void * payload_receive_callback_data;
 
+    void (*immediate_packet_received_callback)( next_server_t * server, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes );
+    next_server_t * immediate_packet_received_server;
+
     NEXT_DECLARE_SENTINEL(16)
+
+    double receive_time;
+    next_latency_histogram_t latency[NEXT_SERVER_METRIC_NUM_METRICS];
+    std::atomic<uint64_t> counters[NEXT_SERVER_COUNTER_NUM_COUNTERS];
+
+    NEXT_DECLARE_SENTINEL(17)
 };
 
 void next_server_internal_initialize_sentinels( next_server_internal_t * server )
@@ -397,6 +460,7 @@ void next_server_internal_initialize_sentinels( next_server_internal_t * server
     NEXT_INITIALIZE_SENTINEL( server, 14 )
     NEXT_INITIALIZE_SENTINEL( server, 15 )
     NEXT_INITIALIZE_SENTINEL( server, 16 )
+    NEXT_INITIALIZE_SENTINEL( server, 17 )
 }
 
 void next_server_internal_verify_sentinels( next_server_internal_t * server )
@@ -420,6 +484,7 @@ void next_server_internal_verify_sentinels( next_server_internal_t * server )
     NEXT_VERIFY_SENTINEL( server, 14 )
     NEXT_VERIFY_SENTINEL( server, 15 )
     NEXT_VERIFY_SENTINEL( server, 16 )
+    NEXT_VERIFY_SENTINEL( server, 17 )
     if ( server->session_manager )
         next_session_manager_verify_sentinels( server->session_manager );
     if ( server->pending_session_manager )
@@ -428,6 +493,167 @@ void next_server_internal_verify_sentinels( next_server_internal_t * server )
         next_relay_manager_verify_sentinels( server->server_relay_manager );
 }
 
+// IMPORTANT: Both next_server_t and next_server_internal_t have a latency array, and each is only ever touched from its own
+// thread, so this guard records mutex wait and hold times into whichever one "server" refers to without any locking.
+
+#define next_server_mutex_guard( _mutex ) next_latency_mutex_guard( _mutex, &server->latency[NEXT_SERVER_METRIC_MUTEX_WAIT], &server->latency[NEXT_SERVER_METRIC_MUTEX_HOLD] )
+
+void next_server_internal_stamp_packet_received( next_server_internal_t * server, next_server_notify_packet_received_t * notify )
+{
+    notify->queue_time = next_platform_time();
+    next_latency_histogram_record( &server->latency[NEXT_SERVER_METRIC_RECEIVE_TO_NOTIFY], notify->queue_time - server->receive_time );
+    server->counters[NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED]++;
+}
+
+void next_server_internal_queue_notify( next_server_internal_t * server, next_server_notify_t * notify )
+{
+    // IMPORTANT: call with notify_mutex held. when a queue is full the push frees a notify, so count it here
+
+    // IMPORTANT: received packets go in their own lane, so a flood of payloads can never push control notifies out
+
+    next_queue_t * queue = server->notify_queue;
+
+    bool drop_oldest = false;
+
+    if ( notify->type == NEXT_SERVER_NOTIFY_PACKET_RECEIVED )
+    {
+        queue = server->payload_queue;
+        drop_oldest = next_global_config.queue_overflow_policy == NEXT_QUEUE_OVERFLOW_DROP_OLDEST;
+    }
+
+    const int result = drop_oldest ? next_queue_push_drop_oldest( queue, notify ) : next_queue_push( queue, notify );
+
+    if ( (uint64_t) queue->num_entries > server->counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_HIGH_WATER_MARK] )
+    {
+        server->counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_HIGH_WATER_MARK] = queue->num_entries;
+    }
+
+    // IMPORTANT: dropping the oldest payload leaves the queue depth unchanged, so it counts as an overflow and not a push
+
+    if ( result != NEXT_OK )
+    {
+        server->counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_OVERFLOW]++;
+        return;
+    }
+
+    server->counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_PUSHED]++;
+}
+
+void next_server_internal_packet_received( next_server_internal_t * server, const next_address_t * from, const uint8_t * packet_data, int packet_bytes )
+{
+    next_assert( from );
+    next_assert( packet_data );
+    next_assert( packet_bytes > 0 );
+    next_assert( packet_bytes <= NEXT_MAX_PACKET_BYTES - 1 );
+
+    // IMPORTANT: with immediate packet delivery the callback runs right here on the internal thread, with a pointer into the receive buffer
+
+    if ( server->immediate_packet_received_callback )
+    {
+        next_latency_histogram_record( &server->latency[NEXT_SERVER_METRIC_RECEIVE_TO_NOTIFY], next_platform_time() - server->receive_time );
+        server->counters[NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED]++;
+        server->immediate_packet_received_callback( server->immediate_packet_received_server, server->context, from, packet_data, packet_bytes );
+        return;
+    }
+
+    next_server_notify_packet_received_t * notify = (next_server_notify_packet_received_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_packet_received_t ) );
+    notify->type = NEXT_SERVER_NOTIFY_PACKET_RECEIVED;
+    notify->from = *from;
+    notify->packet_bytes = packet_bytes;
+    memcpy( notify->packet_data, packet_data, size_t(packet_bytes) );
+    next_server_internal_stamp_packet_received( server, notify );
+    {
+#if NEXT_SPIKE_TRACKING
+        char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
+        next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_PACKET_RECEIVED at %s:%d - from = %s, packet_bytes = %d", __FILE__, __LINE__, next_address_to_string( &notify->from, address_buffer ), notify->packet_bytes );
+#endif // #if NEXT_SPIKE_TRACKING
+        next_server_mutex_guard( &server->notify_mutex );
+        next_server_internal_queue_notify( server, notify );
+    }
+}
+
+void next_server_internal_process_payload( next_server_internal_t * server, const next_session_entry_t * entry, const next_address_t * from, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( entry );
+    next_assert( payload_data );
+
+    if ( !entry->payload_coalescing )
+    {
+        if ( payload_bytes > NEXT_MTU )
+        {
+            char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored payload from %s. payload is too large", next_address_to_string( from, address_buffer ) );
+            return;
+        }
+
+        next_server_internal_packet_received( server, from, payload_data, payload_bytes );
+        return;
+    }
+
+    // IMPORTANT: validate the whole coalesced payload first, so a malformed payload delivers no packets at all
+
+    if ( next_payload_coalescer_num_packets( payload_data, payload_bytes ) <= 0 )
+    {
+        char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored coalesced payload from %s. payload is malformed", next_address_to_string( from, address_buffer ) );
+        return;
+    }
+
+    int offset = 0;
+    const uint8_t * packet_data = NULL;
+    int packet_bytes = 0;
+    while ( ( packet_bytes = next_payload_coalescer_read_packet( payload_data, payload_bytes, &offset, &packet_data ) ) > 0 )
+    {
+        next_server_internal_packet_received( server, from, packet_data, packet_bytes );
+    }
+}
+
+void next_server_internal_payload_received( next_server_internal_t * server, next_session_entry_t * entry, const next_address_t * from, uint64_t payload_sequence, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( entry );
+    next_assert( payload_data );
+
+    if ( !entry->fec )
+    {
+        next_server_internal_process_payload( server, entry, from, payload_data, payload_bytes );
+        return;
+    }
+
+    const uint8_t * fec_payload_data = NULL;
+    next_assert( entry->fec_decoder );
+
+    const int fec_payload_bytes = next_fec_decoder_add_packet( entry->fec_decoder, payload_sequence, payload_data, payload_bytes, &fec_payload_data );
+
+    if ( fec_payload_bytes < 0 )
+    {
+        char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored fec payload from %s. payload is malformed", next_address_to_string( from, address_buffer ) );
+        return;
+    }
+
+    if ( fec_payload_bytes > 0 )
+    {
+        next_server_internal_process_payload( server, entry, from, fec_payload_data, fec_payload_bytes );
+    }
+    else
+    {
+        server->counters[NEXT_SERVER_COUNTER_FEC_PARITY_RECEIVED]++;
+    }
+
+    uint64_t recovered_sequence = 0;
+    const uint8_t * recovered_payload_data = NULL;
+    const int recovered_payload_bytes = next_fec_decoder_recover( entry->fec_decoder, &recovered_sequence, &recovered_payload_data );
+
+    // IMPORTANT: mark the rebuilt payload as received, so the original is dropped by replay protection if it turns up late
+
+    if ( recovered_payload_bytes > 0 && !next_replay_protection_already_received( &entry->payload_replay_protection, recovered_sequence ) )
+    {
+        next_replay_protection_advance_sequence( &entry->payload_replay_protection, recovered_sequence );
+        server->counters[NEXT_SERVER_COUNTER_FEC_RECOVERED]++;
+        next_server_internal_process_payload( server, entry, from, recovered_payload_data, recovered_payload_bytes );
+    }
+}
+
 static void next_server_internal_resolve_hostname_thread_function( void * context );
 
 static void next_server_internal_autodetect_thread_function( void * context );
@@ -486,6 +712,69 @@ void next_server_internal_initialize( next_server_internal_t * server )
     next_server_internal_autodetect( server );
 }
 
+void next_server_internal_create_wake_socket( next_server_internal_t * server )
+{
+    next_assert( server );
+    next_assert( server->socket );
+
+    // IMPORTANT: the internal thread blocks in receive for up to 0.1 seconds. crypto worker results would sit in the
+    // queue until it wakes, so the worker sends a tiny packet from this socket to the server socket to wake it early.
+
+    next_address_t wake_address = server->bind_address;
+    if ( wake_address.type == NEXT_ADDRESS_IPV4 && wake_address.data.ip == 0 )
+    {
+        next_address_parse( &wake_address, "127.0.0.1" );
+    }
+#if NEXT_PLATFORM_HAS_IPV6
+    else if ( wake_address.type == NEXT_ADDRESS_IPV6 )
+    {
+        bool any = true;
+        for ( int i = 0; i < 8; ++i )
+        {
+            if ( wake_address.data.ipv6[i] != 0 )
+                any = false;
+        }
+        if ( any )
+        {
+            next_address_parse( &wake_address, "::1" );
+        }
+    }
+#endif // #if NEXT_PLATFORM_HAS_IPV6
+    wake_address.port = server->bind_address.port;
+
+    next_address_t wake_socket_address = wake_address;
+    wake_socket_address.port = 0;
+
+    server->wake_socket = next_platform_socket_create( server->context, &wake_socket_address, NEXT_PLATFORM_SOCKET_NON_BLOCKING, 0.0f, next_global_config.socket_send_buffer_size, next_global_config.socket_receive_buffer_size );
+    if ( !server->wake_socket )
+    {
+        next_printf( NEXT_LOG_LEVEL_WARN, "server could not create wake socket. crypto worker results will be picked up when the server socket receive times out" );
+        return;
+    }
+
+    server->wake_address = wake_address;
+    server->wake_socket_address = wake_socket_address;
+    server->wake_pending = false;
+}
+
+void next_server_internal_wake( void * data )
+{
+    next_server_internal_t * server = (next_server_internal_t*) data;
+
+    next_assert( server );
+    next_assert( server->wake_socket );
+
+    // IMPORTANT: called on the crypto worker thread. only one wake packet is outstanding at a time.
+    // the packet is two zero bytes so it passes the kernel packet filter as a passthrough packet.
+
+    if ( server->wake_pending.exchange( true ) )
+        return;
+
+    const uint8_t wake_packet[2] = { 0, 0 };
+
+    next_platform_socket_send_packet( server->wake_socket, &server->wake_address, wake_packet, sizeof(wake_packet) );
+}
+
 static void next_server_internal_thread_function( void * context );
 
 next_server_internal_t * next_server_internal_create( void * context, const char * server_address_string, const char * bind_address_string, const char * datacenter_string )
@@ -573,7 +862,45 @@ next_server_internal_t * next_server_internal_create( void * context, const char
         server->no_datacenter_specified = true;
     }
 
-    server->command_queue = next_queue_create( context, NEXT_COMMAND_QUEUE_LENGTH );
+    // IMPORTANT: with max_sessions set, the session managers are sized once here and never expand, so entries never move
+
+    const int max_sessions = next_global_config.max_sessions > 0 ? next_global_config.max_sessions : NEXT_INITIAL_SESSION_SIZE;
+    const int max_pending_sessions = next_global_config.max_sessions > 0 ? next_global_config.max_sessions : NEXT_INITIAL_PENDING_SESSION_SIZE;
+
+    if ( next_global_config.memory_pool )
+    {
+        // IMPORTANT: notifies are queued in two lanes, so the notify pool needs enough blocks to fill both
+
+        const int num_notifies = next_global_config.notify_queue_length * 2;
+        const int num_commands = next_global_config.command_queue_length;
+
+        size_t arena_bytes = 0;
+        arena_bytes += next_arena_align( sizeof(next_server_notify_storage_t) ) * num_notifies + NEXT_ARENA_ALIGNMENT;
+        arena_bytes += next_arena_align( sizeof(next_server_command_storage_t) ) * num_commands + NEXT_ARENA_ALIGNMENT;
+        arena_bytes += ( 8 + sizeof(next_address_t) + sizeof(next_session_entry_t) ) * size_t(max_sessions) + NEXT_ARENA_ALIGNMENT * 3;
+        arena_bytes += ( sizeof(next_address_t) + sizeof(next_pending_session_entry_t) ) * size_t(max_pending_sessions) + NEXT_ARENA_ALIGNMENT * 2;
+
+        server->arena = next_arena_create( context, arena_bytes );
+        if ( !server->arena )
+        {
+            next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create memory arena" );
+            next_server_internal_destroy( server );
+            return NULL;
+        }
+
+        server->notify_pool = next_pool_create( context, server->arena, sizeof(next_server_notify_storage_t), num_notifies );
+        server->command_pool = next_pool_create( context, server->arena, sizeof(next_server_command_storage_t), num_commands );
+        if ( !server->notify_pool || !server->command_pool )
+        {
+            next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create memory pools" );
+            next_server_internal_destroy( server );
+            return NULL;
+        }
+
+        next_printf( NEXT_LOG_LEVEL_INFO, "server memory pool is %.1f MB for %d sessions", arena_bytes / ( 1024.0 * 1024.0 ), max_sessions );
+    }
+
+    server->command_queue = next_queue_create( context, next_global_config.command_queue_length );
     if ( !server->command_queue )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create command queue" );
@@ -581,7 +908,9 @@ next_server_internal_t * next_server_internal_create( void * context, const char
         return NULL;
     }
 
-    server->notify_queue = next_queue_create( context, NEXT_NOTIFY_QUEUE_LENGTH );
+    server->command_queue->pool = server->command_pool;
+
+    server->notify_queue = next_queue_create( context, next_global_config.notify_queue_length );
     if ( !server->notify_queue )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create notify queue" );
@@ -589,6 +918,18 @@ next_server_internal_t * next_server_internal_create( void * context, const char
         return NULL;
     }
 
+    server->notify_queue->pool = server->notify_pool;
+
+    server->payload_queue = next_queue_create( context, next_global_config.notify_queue_length );
+    if ( !server->payload_queue )
+    {
+        next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create payload queue" );
+        next_server_internal_destroy( server );
+        return NULL;
+    }
+
+    server->payload_queue->pool = server->notify_pool;
+
     server->socket = next_platform_socket_create( server->context, &bind_address, NEXT_PLATFORM_SOCKET_BLOCKING, 0.1f, next_global_config.socket_send_buffer_size, next_global_config.socket_receive_buffer_size );
     if ( server->socket == NULL )
     {
@@ -597,6 +938,32 @@ next_server_internal_t * next_server_internal_create( void * context, const char
         return NULL;
     }
 
+    if ( next_global_config.server_busy_poll_microseconds > 0 && next_platform_socket_busy_poll( server->socket, next_global_config.server_busy_poll_microseconds ) != NEXT_OK )
+    {
+        next_printf( NEXT_LOG_LEVEL_WARN, "server busy poll is not supported on this platform" );
+    }
+
+    bool xdp = false;
+
+    if ( next_global_config.server_xdp_interface[0] != '\0' )
+    {
+        xdp = next_platform_socket_xdp( server->socket, next_global_config.server_xdp_interface, next_global_config.server_xdp_queue ) == NEXT_OK;
+        if ( !xdp )
+        {
+            next_printf( NEXT_LOG_LEVEL_INFO, "server xdp is not available on '%s'. using regular socket calls", next_global_config.server_xdp_interface );
+        }
+    }
+
+    if ( !xdp && next_global_config.io_uring && next_platform_socket_io_uring( server->socket ) != NEXT_OK )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "server io_uring is not available. using regular socket calls" );
+    }
+
+    if ( next_global_config.kernel_packet_filter && next_platform_socket_kernel_packet_filter( server->socket, true ) != NEXT_OK )
+    {
+        next_printf( NEXT_LOG_LEVEL_WARN, "server could not attach kernel packet filter" );
+    }
+
     if ( server_address.port == 0 )
     {
         server_address.port = bind_address.port;
@@ -652,7 +1019,7 @@ next_server_internal_t * next_server_internal_create( void * context, const char
         return NULL;
     }
 
-    server->pending_session_manager = next_pending_session_manager_create( context, NEXT_INITIAL_PENDING_SESSION_SIZE );
+    server->pending_session_manager = next_pending_session_manager_create( context, max_pending_sessions, server->arena );
     if ( server->pending_session_manager == NULL )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create pending session manager" );
@@ -660,7 +1027,7 @@ next_server_internal_t * next_server_internal_create( void * context, const char
         return NULL;
     }
 
-    server->session_manager = next_session_manager_create( context, NEXT_INITIAL_SESSION_SIZE );
+    server->session_manager = next_session_manager_create( context, max_sessions, server->arena );
     if ( server->session_manager == NULL )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create session manager" );
@@ -668,6 +1035,11 @@ next_server_internal_t * next_server_internal_create( void * context, const char
         return NULL;
     }
 
+    if ( next_global_config.max_sessions > 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_INFO, "server preallocated %d sessions", max_sessions );
+    }
+
     server->server_relay_manager = next_relay_manager_create( context, NEXT_SERVER_RELAY_PINGS_PER_SECOND );
     if ( !server->server_relay_manager )
     {
@@ -676,6 +1048,17 @@ next_server_internal_t * next_server_internal_create( void * context, const char
         return NULL;
     }
 
+    if ( next_global_config.crypto_worker_thread && server->valid_buyer_private_key )
+    {
+        next_server_internal_create_wake_socket( server );
+
+        server->crypto_worker = next_crypto_worker_create( context, server->buyer_private_key, next_server_backend_public_key, server->wake_socket ? next_server_internal_wake : NULL, server );
+        if ( !server->crypto_worker )
+        {
+            next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create crypto worker. backend packets will be signed and verified on the internal thread" );
+        }
+    }
+
     const bool datacenter_is_local = datacenter[0] == 'l' &&
                                      datacenter[1] == 'o' &&
                                      datacenter[2] == 'c' &&
@@ -740,6 +1123,18 @@ void next_server_internal_destroy( next_server_internal_t * server )
 
     next_server_internal_verify_sentinels( server );
 
+    if ( server->crypto_worker )
+    {
+        next_crypto_worker_destroy( server->crypto_worker );
+        server->crypto_worker = NULL;
+    }
+
+    if ( server->wake_socket )
+    {
+        next_platform_socket_destroy( server->wake_socket );
+        server->wake_socket = NULL;
+    }
+
     if ( server->socket )
     {
         next_platform_socket_destroy( server->socket );
@@ -765,6 +1160,11 @@ void next_server_internal_destroy( next_server_internal_t * server )
         next_queue_destroy( server->notify_queue );
     }
 
+    if ( server->payload_queue )
+    {
+        next_queue_destroy( server->payload_queue );
+    }
+
     if ( server->session_manager )
     {
         next_session_manager_destroy( server->session_manager );
@@ -783,6 +1183,24 @@ void next_server_internal_destroy( next_server_internal_t * server )
         server->server_relay_manager = NULL;
     }
 
+    if ( server->notify_pool )
+    {
+        next_pool_destroy( server->notify_pool );
+        server->notify_pool = NULL;
+    }
+
+    if ( server->command_pool )
+    {
+        next_pool_destroy( server->command_pool );
+        server->command_pool = NULL;
+    }
+
+    if ( server->arena )
+    {
+        next_arena_destroy( server->arena );
+        server->arena = NULL;
+    }
+
     next_platform_mutex_destroy( &server->session_mutex );
     next_platform_mutex_destroy( &server->command_mutex );
     next_platform_mutex_destroy( &server->notify_mutex );
@@ -816,19 +1234,14 @@ void next_server_internal_send_packet_to_address( next_server_internal_t * serve
             return;
     }
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double send_start_time = next_platform_time();
 
     next_platform_socket_send_packet( server->socket, address, packet_data, packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-    double finish_time = next_platform_time();
-    if ( finish_time - start_time > 0.001 )
-    {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-    }
-#endif // #if NEXT_SPIKE_TRACKING
+    next_latency_histogram_record( &server->latency[NEXT_SERVER_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
+
+    server->counters[NEXT_SERVER_COUNTER_PACKETS_SENT]++;
+    server->counters[NEXT_SERVER_COUNTER_BYTES_SENT] += packet_bytes;
 }
 
 void next_server_internal_send_packet_to_backend( next_server_internal_t * server, const uint8_t * packet_data, int packet_bytes )
@@ -842,58 +1255,202 @@ void next_server_internal_send_packet_to_backend( next_server_internal_t * serve
     next_assert( packet_data );
     next_assert( packet_bytes > 0 );
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double send_start_time = next_platform_time();
 
     next_platform_socket_send_packet( server->socket, &server->backend_address, packet_data, packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-    double finish_time = next_platform_time();
-    if ( finish_time - start_time > 0.001 )
-    {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
-    }
-#endif // #if NEXT_SPIKE_TRACKING
+    server->counters[NEXT_SERVER_COUNTER_BACKEND_PACKETS_SENT]++;
+
+    next_latency_histogram_record( &server->latency[NEXT_SERVER_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
+
+    server->counters[NEXT_SERVER_COUNTER_PACKETS_SENT]++;
+    server->counters[NEXT_SERVER_COUNTER_BYTES_SENT] += packet_bytes;
 }
 
-int next_server_internal_send_packet( next_server_internal_t * server, const next_address_t * to_address, uint8_t packet_id, void * packet_object )
+next_backend_packet_cache_t * next_server_internal_backend_packet_cache( next_server_internal_t * server, uint8_t packet_id, const next_address_t * client_address )
 {
-    next_assert( server );
-    next_assert( server->socket );
-    next_assert( packet_object );
-
     next_server_internal_verify_sentinels( server );
 
-    int packet_bytes = 0;
-
-    uint8_t buffer[NEXT_MAX_PACKET_BYTES];
-
-    uint64_t * sequence = NULL;
-    uint8_t * send_key = NULL;
+    // IMPORTANT: only requests that are resent with identical content are cached. session update requests are not,
+    // because the retry number is part of the signed content and changes with every resend
 
-    uint8_t magic[8];
-    if ( packet_id != NEXT_UPGRADE_REQUEST_PACKET )
-    {
-        memcpy( magic, server->current_magic, 8 );
-    }
-    else
+    switch ( packet_id )
     {
-        memset( magic, 0, sizeof(magic) );
-    }
+        case NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET:
+            return &server->server_update_packet_cache;
 
-    if ( next_encrypted_packets[packet_id] )
-    {
-        next_session_entry_t * session = next_session_manager_find_by_address( server->session_manager, to_address );
+        case NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET:
+            return &server->server_relay_request_packet_cache;
 
-        if ( !session )
+        case NEXT_BACKEND_CLIENT_RELAY_REQUEST_PACKET:
         {
-            next_printf( NEXT_LOG_LEVEL_WARN, "server can't send encrypted packet to address. no session found" );
-            return NEXT_ERROR;
+            next_assert( client_address );
+            next_session_entry_t * entry = next_session_manager_find_by_address( server->session_manager, client_address );
+            return entry ? &entry->client_relay_request_packet_cache : NULL;
         }
 
-        sequence = &session->internal_send_sequence;
-        send_key = session->send_key;
+        default:
+            return NULL;
+    }
+}
+
+int next_server_internal_send_backend_packet( next_server_internal_t * server, uint8_t packet_id, void * packet_object )
+{
+    next_server_internal_verify_sentinels( server );
+
+    next_assert( packet_object );
+
+    uint8_t magic[8];
+    memset( magic, 0, sizeof(magic) );
+
+    uint8_t from_address_data[4];
+    uint8_t to_address_data[4];
+
+    next_address_data( &server->server_address, from_address_data );
+    next_address_data( &server->backend_address, to_address_data );
+
+    next_address_t client_address;
+    memset( &client_address, 0, sizeof(client_address) );
+    if ( packet_id == NEXT_BACKEND_CLIENT_RELAY_REQUEST_PACKET )
+    {
+        client_address = ( (NextBackendClientRelayRequestPacket*) packet_object )->client_address;
+    }
+
+    // IMPORTANT: the content is new, so whatever is cached for this request must not be resent from here on,
+    // and signing jobs still in flight for the old content must not store their bytes when they complete
+
+    next_backend_packet_cache_t * cache = next_server_internal_backend_packet_cache( server, packet_id, &client_address );
+    if ( cache )
+    {
+        next_backend_packet_cache_clear( cache );
+        cache->sequence = ++server->backend_packet_cache_sequence;
+    }
+
+    if ( server->crypto_worker )
+    {
+        // IMPORTANT: serialize here but sign on the crypto worker. the signed packet is sent in next_server_internal_pump_crypto_worker
+
+        next_crypto_worker_job_t * job = next_crypto_worker_create_job( server->crypto_worker, NEXT_CRYPTO_WORKER_JOB_SIGN );
+        if ( !job )
+            return NEXT_ERROR;
+
+        if ( next_write_backend_packet( packet_id, packet_object, job->packet_data, &job->packet_bytes, NULL, NULL, magic, from_address_data, to_address_data ) != NEXT_OK )
+        {
+            next_crypto_worker_destroy_job( server->crypto_worker, job );
+            return NEXT_ERROR;
+        }
+
+        job->cache_sequence = cache ? cache->sequence : 0;
+        job->packet_id = packet_id;
+        job->address = client_address;
+        memcpy( job->magic, magic, 8 );
+        memcpy( job->from_address_data, from_address_data, 4 );
+        memcpy( job->to_address_data, to_address_data, 4 );
+
+        if ( next_crypto_worker_submit( server->crypto_worker, job ) == NEXT_OK )
+            return NEXT_OK;
+
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "server crypto worker is full. signing backend packet on internal thread" );
+
+        next_crypto_worker_destroy_job( server->crypto_worker, job );
+    }
+
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+
+    next_assert( ( size_t(packet_data) % 4 ) == 0 );
+
+    int packet_bytes = 0;
+    if ( next_write_backend_packet( packet_id, packet_object, packet_data, &packet_bytes, next_signed_packets, server->buyer_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
+        return NEXT_ERROR;
+
+    next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
+    next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
+
+    if ( cache )
+    {
+        next_backend_packet_cache_store( cache, packet_id, packet_data, packet_bytes, magic, from_address_data, to_address_data );
+    }
+
+    next_server_internal_send_packet_to_backend( server, packet_data, packet_bytes );
+
+    return NEXT_OK;
+}
+
+int next_server_internal_resend_backend_packet( next_server_internal_t * server, uint8_t packet_id, void * packet_object )
+{
+    next_server_internal_verify_sentinels( server );
+
+    next_assert( packet_object );
+
+    uint8_t magic[8];
+    memset( magic, 0, sizeof(magic) );
+
+    uint8_t from_address_data[4];
+    uint8_t to_address_data[4];
+
+    next_address_data( &server->server_address, from_address_data );
+    next_address_data( &server->backend_address, to_address_data );
+
+    const next_address_t * client_address = NULL;
+    if ( packet_id == NEXT_BACKEND_CLIENT_RELAY_REQUEST_PACKET )
+    {
+        client_address = &( (NextBackendClientRelayRequestPacket*) packet_object )->client_address;
+    }
+
+    next_backend_packet_cache_t * cache = next_server_internal_backend_packet_cache( server, packet_id, client_address );
+
+    if ( cache && next_backend_packet_cache_valid( cache, packet_id, magic, from_address_data, to_address_data ) )
+    {
+        next_server_internal_send_packet_to_backend( server, cache->packet_data, cache->packet_bytes );
+        server->counters[NEXT_SERVER_COUNTER_BACKEND_RESENDS]++;
+        return NEXT_OK;
+    }
+
+    if ( next_server_internal_send_backend_packet( server, packet_id, packet_object ) != NEXT_OK )
+        return NEXT_ERROR;
+
+    server->counters[NEXT_SERVER_COUNTER_BACKEND_RESENDS]++;
+
+    return NEXT_OK;
+}
+
+int next_server_internal_send_packet( next_server_internal_t * server, const next_address_t * to_address, uint8_t packet_id, void * packet_object )
+{
+    next_assert( server );
+    next_assert( server->socket );
+    next_assert( packet_object );
+
+    next_server_internal_verify_sentinels( server );
+
+    int packet_bytes = 0;
+
+    uint8_t buffer[NEXT_MAX_PACKET_BYTES];
+
+    uint64_t * sequence = NULL;
+    uint8_t * send_key = NULL;
+
+    uint8_t magic[8];
+    if ( packet_id != NEXT_UPGRADE_REQUEST_PACKET )
+    {
+        memcpy( magic, server->current_magic, 8 );
+    }
+    else
+    {
+        memset( magic, 0, sizeof(magic) );
+    }
+
+    if ( next_encrypted_packets[packet_id] )
+    {
+        next_session_entry_t * session = next_session_manager_find_by_address( server->session_manager, to_address );
+
+        if ( !session )
+        {
+            next_printf( NEXT_LOG_LEVEL_WARN, "server can't send encrypted packet to address. no session found" );
+            return NEXT_ERROR;
+        }
+
+        sequence = &session->internal_send_sequence;
+        send_key = session->send_key;
     }
 
     uint8_t from_address_data[4];
@@ -933,10 +1490,11 @@ inline int next_sequence_greater_than( uint8_t s1, uint8_t s2 )
            ( ( s1 < s2 ) && ( s2 - s1  > 128 ) );
 }
 
-next_session_entry_t * next_server_internal_process_client_to_server_packet( next_server_internal_t * server, uint8_t packet_type, uint8_t * packet_data, int packet_bytes )
+next_session_entry_t * next_server_internal_process_client_to_server_packet( next_server_internal_t * server, uint8_t packet_type, uint8_t * packet_data, int packet_bytes, uint64_t * payload_sequence )
 {
     next_assert( server );
     next_assert( packet_data );
+    next_assert( payload_sequence );
 
     next_server_internal_verify_sentinels( server );
 
@@ -994,7 +1552,7 @@ next_session_entry_t * next_server_internal_process_client_to_server_packet( nex
         memcpy( entry->current_route_private_key, entry->pending_route_private_key, NEXT_CRYPTO_BOX_SECRETKEYBYTES );
 
         {
-            next_platform_mutex_guard( &server->session_mutex );
+            next_server_mutex_guard( &server->session_mutex );
             entry->mutex_envelope_kbps_up = entry->current_route_kbps_up;
             entry->mutex_envelope_kbps_down = entry->current_route_kbps_down;
             entry->mutex_send_over_network_next = true;
@@ -1024,11 +1582,13 @@ next_session_entry_t * next_server_internal_process_client_to_server_packet( nex
 
     next_replay_protection_advance_sequence( replay_protection, packet_sequence );
 
+    *payload_sequence = packet_sequence;
+
     if ( packet_type == NEXT_CLIENT_TO_SERVER_PACKET )
     {
         next_packet_loss_tracker_packet_received( &entry->packet_loss_tracker, packet_sequence );
         next_out_of_order_tracker_packet_received( &entry->out_of_order_tracker, packet_sequence );
-        next_jitter_tracker_packet_received( &entry->jitter_tracker, packet_sequence, next_platform_time() );
+        next_jitter_tracker_packet_received( &entry->jitter_tracker, packet_sequence, server->receive_time );
     }
 
     return entry;
@@ -1053,15 +1613,15 @@ void next_server_internal_update_ready( next_server_internal_t * server )
 
         server->ready = true;
 
-        next_server_notify_ready_t * notify = (next_server_notify_ready_t*) next_malloc( server->context, sizeof( next_server_notify_ready_t ) );
+        next_server_notify_ready_t * notify = (next_server_notify_ready_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_ready_t ) );
         notify->type = NEXT_SERVER_NOTIFY_READY;
         next_copy_string( notify->datacenter_name, server->datacenter_name, NEXT_MAX_DATACENTER_NAME_LENGTH );
         {
 #if NEXT_SPIKE_TRACKING
             next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_READY at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-            next_platform_mutex_guard( &server->notify_mutex );
-            next_queue_push( server->notify_queue, notify );
+            next_server_mutex_guard( &server->notify_mutex );
+            next_server_internal_queue_notify( server, notify );
         }
     }
 
@@ -1086,15 +1646,15 @@ void next_server_internal_update_ready( next_server_internal_t * server )
 
     server->ready = true;
 
-    next_server_notify_ready_t * notify = (next_server_notify_ready_t*) next_malloc( server->context, sizeof( next_server_notify_ready_t ) );
+    next_server_notify_ready_t * notify = (next_server_notify_ready_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_ready_t ) );
     notify->type = NEXT_SERVER_NOTIFY_READY;
     next_copy_string( notify->datacenter_name, server->datacenter_name, NEXT_MAX_DATACENTER_NAME_LENGTH );
     {
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_READY at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &server->notify_mutex );
-        next_queue_push( server->notify_queue, notify );
+        next_server_mutex_guard( &server->notify_mutex );
+        next_server_internal_queue_notify( server, notify );
     }
 }
 
@@ -1128,6 +1688,7 @@ void next_server_internal_update_server_relays( next_server_internal_t * server
             server->server_relay_request_packet.buyer_id = server->buyer_id;
             server->server_relay_request_packet.datacenter_id = server->datacenter_id;
             server->server_relay_request_packet.request_id = next_random_uint64();
+            next_backend_packet_cache_clear( &server->server_relay_request_packet_cache );
 
             server->requesting_server_relays = true;                     
             server->next_server_relay_request_packet_send_time = current_time;   
@@ -1143,6 +1704,8 @@ void next_server_internal_update_server_relays( next_server_internal_t * server
         {
             next_printf( NEXT_LOG_LEVEL_WARN, "server timed out requesting server relays" );
 
+            server->counters[NEXT_SERVER_COUNTER_BACKEND_TIMEOUTS]++;
+
             memset( (char*) &server->server_relay_response_packet, 0, sizeof(NextBackendServerRelayResponsePacket) );
             server->next_server_relay_request_packet_send_time = current_time + NEXT_SERVER_RELAYS_UPDATE_TIME_BASE + ( rand() % NEXT_SERVER_RELAYS_UPDATE_TIME_VARIATION );
             server->requesting_server_relays = false;
@@ -1156,30 +1719,12 @@ void next_server_internal_update_server_relays( next_server_internal_t * server
         {
             next_printf( NEXT_LOG_LEVEL_DEBUG, "send server relay request packet" );
                     
-            uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-
-            next_assert( ( size_t(packet_data) % 4 ) == 0 );
-
-            uint8_t magic[8];
-            memset( magic, 0, sizeof(magic) );
-
-            uint8_t from_address_data[4];
-            uint8_t to_address_data[4];
-
-            next_address_data( &server->server_address, from_address_data );
-            next_address_data( &server->backend_address, to_address_data );
-            int packet_bytes = 0;
-            if ( next_write_backend_packet( NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, &server->server_relay_request_packet, packet_data, &packet_bytes, next_signed_packets, server->buyer_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
+            if ( next_server_internal_resend_backend_packet( server, NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, &server->server_relay_request_packet ) != NEXT_OK )
             {
                 next_printf( NEXT_LOG_LEVEL_ERROR, "server failed to write server relay request packet for backend" );
                 return;
             }
 
-            next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
-            next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
-
-            next_server_internal_send_packet_to_backend( server, packet_data, packet_bytes );
-
             server->next_server_relay_request_packet_send_time = current_time + NEXT_SERVER_RELAYS_REQUEST_SEND_RATE;
         }
     }
@@ -1281,6 +1826,7 @@ void next_server_internal_update_client_relays( next_server_internal_t * server
                 entry->client_relay_request_packet.datacenter_id = server->datacenter_id;
                 entry->client_relay_request_packet.request_id = next_random_uint64();
                 entry->client_relay_request_packet.client_address = entry->address;
+                next_backend_packet_cache_clear( &entry->client_relay_request_packet_cache );
 
                 entry->requesting_client_relays = true;                  
                 entry->next_client_relay_request_packet_send_time = current_time;   
@@ -1296,6 +1842,8 @@ void next_server_internal_update_client_relays( next_server_internal_t * server
             {
                 next_printf( NEXT_LOG_LEVEL_WARN, "server timed out requesting client relays for session %" PRIx64, entry->session_id );
 
+                server->counters[NEXT_SERVER_COUNTER_BACKEND_TIMEOUTS]++;
+
                 memset( (char*) &entry->client_relay_response_packet, 0, sizeof(NextBackendClientRelayResponsePacket) );
                 entry->next_client_relay_request_packet_send_time = current_time + NEXT_CLIENT_RELAYS_UPDATE_TIME_BASE + ( rand() % NEXT_CLIENT_RELAYS_UPDATE_TIME_VARIATION );
                 entry->requesting_client_relays = false;
@@ -1309,30 +1857,12 @@ void next_server_internal_update_client_relays( next_server_internal_t * server
             {
                 next_printf( NEXT_LOG_LEVEL_DEBUG, "send client relay request packet for session %" PRIx64, entry->session_id );
                         
-                uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-
-                next_assert( ( size_t(packet_data) % 4 ) == 0 );
-
-                uint8_t magic[8];
-                memset( magic, 0, sizeof(magic) );
-
-                uint8_t from_address_data[4];
-                uint8_t to_address_data[4];
-
-                next_address_data( &server->server_address, from_address_data );
-                next_address_data( &server->backend_address, to_address_data );
-                int packet_bytes = 0;
-                if ( next_write_backend_packet( NEXT_BACKEND_CLIENT_RELAY_REQUEST_PACKET, &entry->client_relay_request_packet, packet_data, &packet_bytes, next_signed_packets, server->buyer_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
+                if ( next_server_internal_resend_backend_packet( server, NEXT_BACKEND_CLIENT_RELAY_REQUEST_PACKET, &entry->client_relay_request_packet ) != NEXT_OK )
                 {
                     next_printf( NEXT_LOG_LEVEL_ERROR, "server failed to write client relay request packet for session %" PRIx64, entry->session_id );
                     return;
                 }
 
-                next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
-                next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
-
-                next_server_internal_send_packet_to_backend( server, packet_data, packet_bytes );
-
                 entry->next_client_relay_request_packet_send_time = current_time + NEXT_CLIENT_RELAYS_REQUEST_SEND_RATE;
             }
         }
@@ -1408,7 +1938,7 @@ void next_server_internal_update_route( next_server_internal_t * server )
             packet.jitter_client_to_server = float( entry->stats_jitter_client_to_server );
 
             {
-                next_platform_mutex_guard( &server->session_mutex );
+                next_server_mutex_guard( &server->session_mutex );
                 packet.packets_sent_server_to_client = entry->stats_packets_sent_server_to_client;
             }
 
@@ -1453,7 +1983,7 @@ void next_server_internal_update_pending_upgrades( next_server_internal_t * serv
             char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server upgrade request timed out for client %s", next_address_to_string( &entry->address, address_buffer ) );
             next_pending_session_manager_remove_at_index( server->pending_session_manager, i );
-            next_server_notify_pending_session_timed_out_t * notify = (next_server_notify_pending_session_timed_out_t*) next_malloc( server->context, sizeof( next_server_notify_pending_session_timed_out_t ) );
+            next_server_notify_pending_session_timed_out_t * notify = (next_server_notify_pending_session_timed_out_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_pending_session_timed_out_t ) );
             notify->type = NEXT_SERVER_NOTIFY_PENDING_SESSION_TIMED_OUT;
             notify->address = entry->address;
             notify->session_id = entry->session_id;
@@ -1461,8 +1991,8 @@ void next_server_internal_update_pending_upgrades( next_server_internal_t * serv
 #if NEXT_SPIKE_TRACKING
                 next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_PENDING_SESSION_TIMED_OUT at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING                
-                next_platform_mutex_guard( &server->notify_mutex );
-                next_queue_push( server->notify_queue, notify );
+                next_server_mutex_guard( &server->notify_mutex );
+                next_server_internal_queue_notify( server, notify );
             }
             continue;
         }
@@ -1484,6 +2014,8 @@ void next_server_internal_update_pending_upgrades( next_server_internal_t * serv
             memcpy( packet.upcoming_magic, server->upcoming_magic, 8 );
             memcpy( packet.current_magic, server->current_magic, 8 );
             memcpy( packet.previous_magic, server->previous_magic, 8 );
+            packet.payload_coalescing = next_global_config.payload_coalescing;
+            packet.fec = next_global_config.fec_group_size > 0;
 
             next_server_internal_send_packet( server, &entry->address, NEXT_UPGRADE_REQUEST_PACKET, &packet );
         }
@@ -1528,7 +2060,7 @@ void next_server_internal_update_sessions( next_server_internal_t * server )
         // IMPORTANT: Don't time out sessions during server flush. Otherwise the server flush might wait longer than necessary.
         if ( !server->flushing && entry->last_client_stats_update + NEXT_SERVER_SESSION_TIMEOUT <= current_time )
         {
-            next_server_notify_session_timed_out_t * notify = (next_server_notify_session_timed_out_t*) next_malloc( server->context, sizeof( next_server_notify_session_timed_out_t ) );
+            next_server_notify_session_timed_out_t * notify = (next_server_notify_session_timed_out_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_session_timed_out_t ) );
             notify->type = NEXT_SERVER_NOTIFY_SESSION_TIMED_OUT;
             notify->address = entry->address;
             notify->session_id = entry->session_id;
@@ -1536,12 +2068,12 @@ void next_server_internal_update_sessions( next_server_internal_t * server )
 #if NEXT_SPIKE_TRACKING
                 next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_SESSION_TIMED_OUT at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING                
-                next_platform_mutex_guard( &server->notify_mutex );
-                next_queue_push( server->notify_queue, notify );
+                next_server_mutex_guard( &server->notify_mutex );
+                next_server_internal_queue_notify( server, notify );
             }
 
             {
-                next_platform_mutex_guard( &server->session_mutex );
+                next_server_mutex_guard( &server->session_mutex );
                 next_session_manager_remove_at_index( server->session_manager, index );
             }
     
@@ -1564,7 +2096,7 @@ void next_server_internal_update_sessions( next_server_internal_t * server )
             entry->waiting_for_update_response = false;
 
             {
-                next_platform_mutex_guard( &server->session_mutex );
+                next_server_mutex_guard( &server->session_mutex );
                 entry->mutex_send_over_network_next = false;
             }
         }
@@ -1590,19 +2122,19 @@ void next_server_internal_update_flush( next_server_internal_t * server )
         
         server->flushed = true;
 
-        next_server_notify_flush_finished_t * notify = (next_server_notify_flush_finished_t*) next_malloc( server->context, sizeof( next_server_notify_flush_finished_t ) );
+        next_server_notify_flush_finished_t * notify = (next_server_notify_flush_finished_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_flush_finished_t ) );
         notify->type = NEXT_SERVER_NOTIFY_FLUSH_FINISHED;
         {
 #if NEXT_SPIKE_TRACKING
             next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_FLUSH_FINISHED at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING                
-            next_platform_mutex_guard( &server->notify_mutex );
-            next_queue_push( server->notify_queue, notify );
+            next_server_mutex_guard( &server->notify_mutex );
+            next_server_internal_queue_notify( server, notify );
         }
     }
 }
 
-void next_server_internal_process_network_next_packet( next_server_internal_t * server, const next_address_t * from, uint8_t * packet_data, int begin, int end )
+void next_server_internal_process_network_next_packet( next_server_internal_t * server, const next_address_t * from, uint8_t * packet_data, int begin, int end, bool backend_packet_verified )
 {
     next_assert( server );
     next_assert( from );
@@ -1622,6 +2154,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
         if ( !next_basic_packet_filter( packet_data + begin, end - begin ) )
         {
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server basic packet filter dropped packet" );
+            server->counters[NEXT_SERVER_COUNTER_DROPPED_BASIC_FILTER]++;
             return;
         }
 
@@ -1640,6 +2173,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
                     if ( !next_advanced_packet_filter( packet_data + begin, server->previous_magic, from_address_data, to_address_data, end - begin ) )
                     {
                         next_printf( NEXT_LOG_LEVEL_DEBUG, "server advanced packet filter dropped packet" );
+                        server->counters[NEXT_SERVER_COUNTER_DROPPED_ADVANCED_FILTER]++;
                         return;
                     }
                 }
@@ -1652,11 +2186,35 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
             if ( !next_advanced_packet_filter( packet_data + begin, magic, from_address_data, to_address_data, end - begin ) )
             {
                 next_printf( NEXT_LOG_LEVEL_DEBUG, "server advanced packet filter dropped packet (backend)" );
+                server->counters[NEXT_SERVER_COUNTER_DROPPED_ADVANCED_FILTER]++;
                 return;
             }
         }
     }
 
+    // IMPORTANT: with the crypto worker enabled, signed backend packets are verified off the internal thread, then come back here
+
+    if ( server->crypto_worker && !backend_packet_verified && packet_id >= NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET && next_signed_packets[packet_id] )
+    {
+        next_crypto_worker_job_t * job = next_crypto_worker_create_job( server->crypto_worker, NEXT_CRYPTO_WORKER_JOB_VERIFY );
+        if ( job )
+        {
+            job->packet_id = uint8_t( packet_id );
+            job->address = *from;
+            job->packet_bytes = end - begin;
+            memcpy( job->packet_data, packet_data + begin, size_t(end) - begin );
+
+            if ( next_crypto_worker_submit( server->crypto_worker, job ) == NEXT_OK )
+                return;
+
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "server crypto worker is full. verifying backend packet on internal thread" );
+
+            next_crypto_worker_destroy_job( server->crypto_worker, job );
+        }
+    }
+
+    const int * backend_signed_packets = backend_packet_verified ? NULL : next_signed_packets;
+
     begin += 18;
 
     if ( server->state == NEXT_SERVER_STATE_INITIALIZING )
@@ -1673,7 +2231,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
 
             NextBackendServerInitResponsePacket packet;
 
-            if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, next_signed_packets, next_server_backend_public_key ) != packet_id )
+            if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, backend_signed_packets, next_server_backend_public_key ) != packet_id )
             {
                 next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored server init response packet from backend. packet failed to read" );
                 return;
@@ -1755,15 +2313,15 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
                 packet.previous_magic[6],
                 packet.previous_magic[7] );
 
-            next_server_notify_magic_updated_t * notify = (next_server_notify_magic_updated_t*) next_malloc( server->context, sizeof( next_server_notify_magic_updated_t ) );
+            next_server_notify_magic_updated_t * notify = (next_server_notify_magic_updated_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_magic_updated_t ) );
             notify->type = NEXT_SERVER_NOTIFY_MAGIC_UPDATED;
             memcpy( notify->current_magic, server->current_magic, 8 );
             {
 #if NEXT_SPIKE_TRACKING
                 next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_MAGIC_UPDATED at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING                
-                next_platform_mutex_guard( &server->notify_mutex );
-                next_queue_push( server->notify_queue, notify );
+                next_server_mutex_guard( &server->notify_mutex );
+                next_server_internal_queue_notify( server, notify );
             }
 
             return;
@@ -1790,6 +2348,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
         {
             char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored direct packet from %s. packet is too small to be valid", next_address_to_string( from, address_buffer ) );
+            server->counters[NEXT_SERVER_COUNTER_DROPPED_DIRECT_PACKET]++;
             return;
         }
 
@@ -1797,6 +2356,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
         {
             char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored direct packet from %s. packet is too large to be valid", next_address_to_string( from, address_buffer ) );
+            server->counters[NEXT_SERVER_COUNTER_DROPPED_DIRECT_PACKET]++;
             return;
         }
 
@@ -1811,6 +2371,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
         {
             char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored direct packet from %s. could not find session for address", next_address_to_string( from, address_buffer ) );
+            server->counters[NEXT_SERVER_COUNTER_DROPPED_DIRECT_PACKET]++;
             return;
         }
 
@@ -1818,11 +2379,15 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
         {
             char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored direct packet from %s. session mismatch", next_address_to_string( from, address_buffer ) );
+            server->counters[NEXT_SERVER_COUNTER_DROPPED_DIRECT_PACKET]++;
             return;
         }
 
         if ( next_replay_protection_already_received( &entry->payload_replay_protection, packet_sequence ) )
+        {
+            server->counters[NEXT_SERVER_COUNTER_DROPPED_REPLAY_PROTECTION]++;
             return;
+        }
 
         next_replay_protection_advance_sequence( &entry->payload_replay_protection, packet_sequence );
 
@@ -1830,23 +2395,13 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
 
         next_out_of_order_tracker_packet_received( &entry->out_of_order_tracker, packet_sequence );
 
-        next_jitter_tracker_packet_received( &entry->jitter_tracker, packet_sequence, next_platform_time() );
+        next_jitter_tracker_packet_received( &entry->jitter_tracker, packet_sequence, server->receive_time );
 
-        next_server_notify_packet_received_t * notify = (next_server_notify_packet_received_t*) next_malloc( server->context, sizeof( next_server_notify_packet_received_t ) );
-        notify->type = NEXT_SERVER_NOTIFY_PACKET_RECEIVED;
-        notify->from = *from;
-        notify->packet_bytes = packet_bytes - 9;
-        next_assert( notify->packet_bytes > 0 );
-        next_assert( notify->packet_bytes <= NEXT_MTU );
-        memcpy( notify->packet_data, packet_data + begin + 9, size_t(notify->packet_bytes) );
-        {
-#if NEXT_SPIKE_TRACKING
-            char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
-            next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_PACKET_RECEIVED at %s:%d - from = %s, packet_bytes = %d", __FILE__, __LINE__, next_address_to_string( &notify->from, address_buffer ), notify->packet_bytes );
-#endif // #if NEXT_SPIKE_TRACKING                
-            next_platform_mutex_guard( &server->notify_mutex );
-            next_queue_push( server->notify_queue, notify );
-        }
+        server->counters[NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED_DIRECT]++;
+
+        next_assert( packet_bytes - 9 <= NEXT_MTU );
+
+        next_server_internal_payload_received( server, entry, from, packet_sequence, packet_data + begin + 9, packet_bytes - 9 );
 
         return;
     }
@@ -1859,7 +2414,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
 
         NextBackendServerUpdateResponsePacket packet;
 
-        if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, next_signed_packets, next_server_backend_public_key ) != packet_id )
+        if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, backend_signed_packets, next_server_backend_public_key ) != packet_id )
         {
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored server update response packet from backend. packet failed to read" );
             return;
@@ -1908,15 +2463,15 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
                 packet.previous_magic[6],
                 packet.previous_magic[7] );
 
-            next_server_notify_magic_updated_t * notify = (next_server_notify_magic_updated_t*) next_malloc( server->context, sizeof( next_server_notify_magic_updated_t ) );
+            next_server_notify_magic_updated_t * notify = (next_server_notify_magic_updated_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_magic_updated_t ) );
             notify->type = NEXT_SERVER_NOTIFY_MAGIC_UPDATED;
             memcpy( notify->current_magic, server->current_magic, 8 );
             {
 #if NEXT_SPIKE_TRACKING
                 next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_MAGIC_UPDATED at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING                
-                next_platform_mutex_guard( &server->notify_mutex );
-                next_queue_push( server->notify_queue, notify );
+                next_server_mutex_guard( &server->notify_mutex );
+                next_server_internal_queue_notify( server, notify );
             }
         }
     }
@@ -1929,7 +2484,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
 
         NextBackendSessionUpdateResponsePacket packet;
 
-        if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, next_signed_packets, next_server_backend_public_key ) != packet_id )
+        if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, backend_signed_packets, next_server_backend_public_key ) != packet_id )
         {
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored session update response packet from backend. packet failed to read" );
             return;
@@ -1972,7 +2527,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server multipath enabled for session %" PRIx64, entry->session_id );
             entry->multipath = true;
             {
-                next_platform_mutex_guard( &server->session_mutex );
+                next_server_mutex_guard( &server->session_mutex );
                 entry->mutex_multipath = true;
             }
         }
@@ -2004,7 +2559,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
         {
             bool session_transitions_to_direct = false;
             {
-                next_platform_mutex_guard( &server->session_mutex );
+                next_server_mutex_guard( &server->session_mutex );
                 if ( entry->mutex_send_over_network_next )
                 {
                     entry->mutex_send_over_network_next = false;
@@ -2052,7 +2607,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
 
         NextBackendServerRelayResponsePacket packet;
 
-        if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, next_signed_packets, next_server_backend_public_key ) != packet_id )
+        if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, backend_signed_packets, next_server_backend_public_key ) != packet_id )
         {
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored server relay response packet from backend. packet failed to read" );
             return;
@@ -2098,7 +2653,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
 
         NextBackendClientRelayResponsePacket packet;
 
-        if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, next_signed_packets, next_server_backend_public_key ) != packet_id )
+        if ( next_read_backend_packet( packet_id, packet_data, begin, end, &packet, backend_signed_packets, next_server_backend_public_key ) != packet_id )
         {
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored client relay response packet from backend. packet failed to read" );
             return;
@@ -2244,7 +2799,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
 
             next_session_entry_t * entry = NULL;
             {
-                next_platform_mutex_guard( &server->session_mutex );
+                next_server_mutex_guard( &server->session_mutex );
                 entry = next_session_manager_add( server->session_manager, &pending_entry->address, pending_entry->session_id, pending_entry->private_key, pending_entry->upgrade_token );
             }
             if ( entry == NULL )
@@ -2260,22 +2815,36 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
             entry->last_client_stats_update = next_platform_time();
             entry->user_hash = pending_entry->user_hash;
             entry->client_open_session_sequence = packet.client_open_session_sequence;
+            entry->payload_coalescing = packet.payload_coalescing && next_global_config.payload_coalescing;
+            entry->fec = packet.fec && next_global_config.fec_group_size > 0;
+            if ( entry->fec && !next_session_manager_enable_fec( server->session_manager, entry ) )
+            {
+                {
+                    next_server_mutex_guard( &server->session_mutex );
+                    next_session_manager_remove_by_address( server->session_manager, &pending_entry->address );
+                }
+                char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
+                next_printf( NEXT_LOG_LEVEL_ERROR, "server ignored upgrade response from %s. failed to allocate fec decoder", next_address_to_string( from, address_buffer ) );
+                return;
+            }
             entry->stats_platform_id = packet.platform_id;
             entry->stats_connection_type = packet.connection_type;
             entry->last_upgraded_packet_receive_time = next_platform_time();
 
             // notify session upgraded
 
-            next_server_notify_session_upgraded_t * notify = (next_server_notify_session_upgraded_t*) next_malloc( server->context, sizeof( next_server_notify_session_upgraded_t ) );
+            next_server_notify_session_upgraded_t * notify = (next_server_notify_session_upgraded_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_session_upgraded_t ) );
             notify->type = NEXT_SERVER_NOTIFY_SESSION_UPGRADED;
             notify->address = entry->address;
             notify->session_id = entry->session_id;
+            notify->payload_coalescing = entry->payload_coalescing;
+            notify->fec = entry->fec;
             {
 #if NEXT_SPIKE_TRACKING
                 next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_SESSION_UPGRADED at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING                
-                next_platform_mutex_guard( &server->notify_mutex );
-                next_queue_push( server->notify_queue, notify );
+                next_server_mutex_guard( &server->notify_mutex );
+                next_server_internal_queue_notify( server, notify );
             }
 
             char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
@@ -2511,30 +3080,27 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
             return;
         }
 
-        next_session_entry_t * entry = next_server_internal_process_client_to_server_packet( server, packet_id, packet_data + begin, packet_bytes );
+        if ( packet_bytes > NEXT_HEADER_BYTES + NEXT_MTU )
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored client to server packet. packet too large to be valid" );
+            return;
+        }
+
+        uint64_t payload_sequence = 0;
+
+        next_session_entry_t * entry = next_server_internal_process_client_to_server_packet( server, packet_id, packet_data + begin, packet_bytes, &payload_sequence );
         if ( !entry )
         {
             // IMPORTANT: There is no need to log this case, because next_server_internal_process_client_to_server_packet already
             // logs all cases where it returns NULL to the debug log. Logging here duplicates the log and incorrectly prints
             // out an error when the packet has already been received on the direct path, when multipath is enabled.
+            server->counters[NEXT_SERVER_COUNTER_DROPPED_NEXT_PACKET]++;
             return;
         }
 
-        next_server_notify_packet_received_t * notify = (next_server_notify_packet_received_t*) next_malloc( server->context, sizeof( next_server_notify_packet_received_t ) );
-        notify->type = NEXT_SERVER_NOTIFY_PACKET_RECEIVED;
-        notify->from = entry->address;
-        notify->packet_bytes = packet_bytes - NEXT_HEADER_BYTES;
-        next_assert( notify->packet_bytes > 0 );
-        next_assert( notify->packet_bytes <= NEXT_MTU );
-        memcpy( notify->packet_data, packet_data + begin + NEXT_HEADER_BYTES, size_t(notify->packet_bytes) );
-        {
-#if NEXT_SPIKE_TRACKING
-            char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
-            next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_PACKET_RECEIVED at %s:%d - from = %s, packet_bytes = %d", __FILE__, __LINE__, next_address_to_string( &notify->from, address_buffer ), notify->packet_bytes );
-#endif // #if NEXT_SPIKE_TRACKING                
-            next_platform_mutex_guard( &server->notify_mutex );
-            next_queue_push( server->notify_queue, notify );
-        }
+        server->counters[NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED_NEXT]++;
+
+        next_server_internal_payload_received( server, entry, &entry->address, payload_sequence, packet_data + begin + NEXT_HEADER_BYTES, packet_bytes - NEXT_HEADER_BYTES );
 
         return;
     }
@@ -2553,7 +3119,9 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
             return;
         }
 
-        next_session_entry_t * entry = next_server_internal_process_client_to_server_packet( server, packet_id, packet_data + begin, packet_bytes );
+        uint64_t packet_sequence = 0;
+
+        next_session_entry_t * entry = next_server_internal_process_client_to_server_packet( server, packet_id, packet_data + begin, packet_bytes, &packet_sequence );
         if ( !entry )
         {
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored session ping packet. did not verify" );
@@ -2610,7 +3178,7 @@ void next_server_internal_process_network_next_packet( next_server_internal_t *
 
         uint64_t ping_sequence = next_read_uint64( &p );
 
-        next_relay_manager_process_pong( server->server_relay_manager, from, ping_sequence );
+        next_relay_manager_process_pong( server->server_relay_manager, from, ping_sequence, server->receive_time );
     }
 
     // ----------------------------------
@@ -2836,21 +3404,7 @@ void next_server_internal_process_passthrough_packet( next_server_internal_t * s
                 return;
         }
 
-        next_server_notify_packet_received_t * notify = (next_server_notify_packet_received_t*) next_malloc( server->context, sizeof( next_server_notify_packet_received_t ) );
-        notify->type = NEXT_SERVER_NOTIFY_PACKET_RECEIVED;
-        notify->from = *from;
-        notify->packet_bytes = packet_bytes;
-        next_assert( packet_bytes > 0 );
-        next_assert( packet_bytes <= NEXT_MAX_PACKET_BYTES - 1 );
-        memcpy( notify->packet_data, packet_data, size_t(packet_bytes) );
-        {
-#if NEXT_SPIKE_TRACKING
-            char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
-            next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_PACKET_RECEIVED at %s:%d - from = %s, packet_bytes = %d", __FILE__, __LINE__, next_address_to_string( &notify->from, address_buffer ), notify->packet_bytes );
-#endif // #if NEXT_SPIKE_TRACKING                
-            next_platform_mutex_guard( &server->notify_mutex );
-            next_queue_push( server->notify_queue, notify );
-        }
+        next_server_internal_packet_received( server, from, packet_data, packet_bytes );
     }
 }
 
@@ -2872,7 +3426,9 @@ void next_server_internal_block_and_receive_packet( next_server_internal_t * ser
     next_printf( NEXT_LOG_LEVEL_SPAM, "server calls next_platform_socket_receive_packet on internal thread" );
 #endif // #if NEXT_SPIKE_TRACKING
 
-    const int packet_bytes = next_platform_socket_receive_packet( server->socket, &from, packet_data, NEXT_MAX_PACKET_BYTES );
+    double packet_receive_time = 0.0;
+
+    const int packet_bytes = next_platform_socket_receive_packet_with_timestamp( server->socket, &from, packet_data, NEXT_MAX_PACKET_BYTES, &packet_receive_time );
 
 #if NEXT_SPIKE_TRACKING
     char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
@@ -2884,6 +3440,14 @@ void next_server_internal_block_and_receive_packet( next_server_internal_t * ser
 
     next_assert( packet_bytes > 0 );
 
+    if ( server->wake_socket && next_address_equal( &from, &server->wake_socket_address ) )
+        return;
+
+    server->receive_time = packet_receive_time;
+
+    server->counters[NEXT_SERVER_COUNTER_PACKETS_RECEIVED]++;
+    server->counters[NEXT_SERVER_COUNTER_BYTES_RECEIVED] += packet_bytes;
+
     int begin = 0;
     int end = packet_bytes;
 
@@ -2897,7 +3461,10 @@ void next_server_internal_block_and_receive_packet( next_server_internal_t * ser
         next_assert( end <= NEXT_MAX_PACKET_BYTES );
 
         if ( end - begin <= 0 )
-            return;        
+        {
+            server->counters[NEXT_SERVER_COUNTER_DROPPED_RECEIVE_CALLBACK]++;
+            return;
+        }
     }
 
 #if NEXT_DEVELOPMENT
@@ -2909,7 +3476,7 @@ void next_server_internal_block_and_receive_packet( next_server_internal_t * ser
 
     if ( packet_type != NEXT_PASSTHROUGH_PACKET )
     {
-        next_server_internal_process_network_next_packet( server, &from, packet_data, begin, end );
+        next_server_internal_process_network_next_packet( server, &from, packet_data, begin, end, false );
     }
     else
     {
@@ -2918,6 +3485,69 @@ void next_server_internal_block_and_receive_packet( next_server_internal_t * ser
     }
 }
 
+void next_server_internal_pump_crypto_worker( next_server_internal_t * server )
+{
+    next_server_internal_verify_sentinels( server );
+
+    if ( !server->crypto_worker )
+        return;
+
+    // IMPORTANT: clear before polling, so a job that completes while we drain sends a fresh wake packet
+
+    server->wake_pending = false;
+
+    while ( true )
+    {
+        next_crypto_worker_job_t * job = next_crypto_worker_poll( server->crypto_worker );
+        if ( !job )
+            break;
+
+        switch ( job->type )
+        {
+            case NEXT_CRYPTO_WORKER_JOB_SIGN:
+            {
+                next_assert( next_basic_packet_filter( job->packet_data, job->packet_bytes ) );
+                next_assert( next_advanced_packet_filter( job->packet_data, job->magic, job->from_address_data, job->to_address_data, job->packet_bytes ) );
+
+                // IMPORTANT: if the request was sent again or replaced while this job was in flight, these bytes are outdated
+
+                next_backend_packet_cache_t * cache = next_server_internal_backend_packet_cache( server, job->packet_id, &job->address );
+                if ( job->cache_sequence != 0 && ( !cache || cache->sequence != job->cache_sequence ) )
+                {
+                    next_printf( NEXT_LOG_LEVEL_DEBUG, "server dropped outdated signed backend packet %d", job->packet_id );
+                    break;
+                }
+
+                if ( cache )
+                {
+                    next_backend_packet_cache_store( cache, job->packet_id, job->packet_data, job->packet_bytes, job->magic, job->from_address_data, job->to_address_data );
+                }
+
+                next_server_internal_send_packet_to_backend( server, job->packet_data, job->packet_bytes );
+            }
+            break;
+
+            case NEXT_CRYPTO_WORKER_JOB_VERIFY:
+            {
+                if ( job->verified )
+                {
+                    next_server_internal_process_network_next_packet( server, &job->address, job->packet_data, 0, job->packet_bytes, true );
+                }
+                else
+                {
+                    next_printf( NEXT_LOG_LEVEL_DEBUG, "server ignored backend packet %d. signature did not verify", job->packet_id );
+                }
+            }
+            break;
+
+            default:
+                break;
+        }
+
+        next_crypto_worker_destroy_job( server->crypto_worker, job );
+    }
+}
+
 void next_server_internal_upgrade_session( next_server_internal_t * server, const next_address_t * address, uint64_t session_id, uint64_t user_hash )
 {
     next_assert( server );
@@ -3066,7 +3696,7 @@ void next_server_internal_pump_commands( next_server_internal_t * server )
 
         void * entry = NULL;
         {
-            next_platform_mutex_guard( &server->command_mutex );
+            next_server_mutex_guard( &server->command_mutex );
             entry = next_queue_pop( server->command_queue );
         }
 
@@ -3114,6 +3744,12 @@ void next_server_internal_pump_commands( next_server_internal_t * server )
                 next_server_command_set_packet_receive_callback_t * cmd = (next_server_command_set_packet_receive_callback_t*) command;
                 server->packet_receive_callback = cmd->callback;
                 server->packet_receive_callback_data = cmd->callback_data;
+
+                // IMPORTANT: the packet receive callback can rewrite packets before they are filtered, so the kernel filter can't run with one set
+                if ( next_global_config.kernel_packet_filter )
+                {
+                    next_platform_socket_kernel_packet_filter( server->socket, cmd->callback == NULL );
+                }
             }
             break;
 
@@ -3142,7 +3778,7 @@ void next_server_internal_pump_commands( next_server_internal_t * server )
             default: break;
         }
 
-        next_free( server->context, command );
+        next_pool_free( server->command_pool, server->context, command );
     }
 }
 
@@ -3248,7 +3884,7 @@ static bool next_server_internal_update_resolve_hostname( next_server_internal_t
     next_address_t result;
     memset( &result, 0, sizeof(next_address_t) );
     {
-        next_platform_mutex_guard( &server->resolve_hostname_mutex );
+        next_server_mutex_guard( &server->resolve_hostname_mutex );
         finished = server->resolve_hostname_finished;
         result = server->resolve_hostname_result;
     }
@@ -3382,7 +4018,7 @@ static bool next_server_internal_update_autodetect( next_server_internal_t * ser
 
     bool finished = false;
     {
-        next_platform_mutex_guard( &server->autodetect_mutex );
+        next_server_mutex_guard( &server->autodetect_mutex );
         finished = server->autodetect_finished;
     }
 
@@ -3450,9 +4086,11 @@ void next_server_internal_update_init( next_server_internal_t * server )
     {
         next_printf( NEXT_LOG_LEVEL_INFO, "server init timed out. falling back to direct mode only :(" );
 
+        server->counters[NEXT_SERVER_COUNTER_BACKEND_TIMEOUTS]++;
+
         server->state = NEXT_SERVER_STATE_DIRECT_ONLY;
 
-        next_server_notify_direct_only_t * notify_direct_only = (next_server_notify_direct_only_t*) next_malloc( server->context, sizeof(next_server_notify_direct_only_t) );
+        next_server_notify_direct_only_t * notify_direct_only = (next_server_notify_direct_only_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_direct_only_t ) );
         next_assert( notify_direct_only );
         notify_direct_only->type = NEXT_SERVER_NOTIFY_DIRECT_ONLY;
 
@@ -3460,8 +4098,8 @@ void next_server_internal_update_init( next_server_internal_t * server )
 #if NEXT_SPIKE_TRACKING
             next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_DIRECT_ONLY and NEXT_SERVER_NOTIFY_READY at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING                
-            next_platform_mutex_guard( &server->notify_mutex );
-            next_queue_push( server->notify_queue, notify_direct_only );
+            next_server_mutex_guard( &server->notify_mutex );
+            next_server_internal_queue_notify( server, notify_direct_only );
         }
 
         return;
@@ -3490,15 +4128,15 @@ void next_server_internal_update_init( next_server_internal_t * server )
     {
         next_printf( NEXT_LOG_LEVEL_INFO, "server aborted init" );
         server->state = NEXT_SERVER_STATE_DIRECT_ONLY;
-        next_server_notify_direct_only_t * notify_direct_only = (next_server_notify_direct_only_t*) next_malloc( server->context, sizeof(next_server_notify_direct_only_t) );
+        next_server_notify_direct_only_t * notify_direct_only = (next_server_notify_direct_only_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_direct_only_t ) );
         next_assert( notify_direct_only );
         notify_direct_only->type = NEXT_SERVER_NOTIFY_DIRECT_ONLY;
         {
 #if NEXT_SPIKE_TRACKING
             next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_DIRECT_ONLY at %s:%d", __FILE__, __FILE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-            next_platform_mutex_guard( &server->notify_mutex );
-            next_queue_push( server->notify_queue, notify_direct_only );
+            next_server_mutex_guard( &server->notify_mutex );
+            next_server_internal_queue_notify( server, notify_direct_only );
         }
         return;
     }
@@ -3523,31 +4161,12 @@ void next_server_internal_update_init( next_server_internal_t * server )
     next_copy_string( packet.datacenter_name, server->datacenter_name, NEXT_MAX_DATACENTER_NAME_LENGTH );
     packet.datacenter_name[NEXT_MAX_DATACENTER_NAME_LENGTH-1] = '\0';
 
-    uint8_t magic[8];
-    memset( magic, 0, sizeof(magic) );
-
-    uint8_t from_address_data[4];
-    uint8_t to_address_data[4];
-
-    next_address_data( &server->server_address, from_address_data );
-    next_address_data( &server->backend_address, to_address_data );
-
-    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-
-    next_assert( ( size_t(packet_data) % 4 ) == 0 );
-
-    int packet_bytes = 0;
-    if ( next_write_backend_packet( NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET, &packet, packet_data, &packet_bytes, next_signed_packets, server->buyer_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
+    if ( next_server_internal_send_backend_packet( server, NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET, &packet ) != NEXT_OK )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server failed to write server init request packet for backend" );
         return;
     }
 
-    next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
-    next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
-
-    next_server_internal_send_packet_to_backend( server, packet_data, packet_bytes );
-
     next_printf( NEXT_LOG_LEVEL_DEBUG, "server sent init request to backend" );
 }
 
@@ -3583,11 +4202,44 @@ void next_server_internal_backend_update( next_server_internal_t * server )
 
         if ( session->next_tracker_update_time <= current_time )
         {
+            const uint64_t last_packet_processed = session->packet_loss_tracker.last_packet_processed;
             const int packets_lost = next_packet_loss_tracker_update( &session->packet_loss_tracker );
             session->stats_packets_lost_client_to_server += packets_lost;
             session->stats_packets_out_of_order_client_to_server = session->out_of_order_tracker.num_out_of_order_packets;
             session->stats_jitter_client_to_server = session->jitter_tracker.jitter * 1000.0;
             session->next_tracker_update_time = current_time + NEXT_SECONDS_BETWEEN_PACKET_LOSS_UPDATES;
+
+            if ( session->multipath && session->stats_next && next_global_config.adaptive_multipath )
+            {
+                // IMPORTANT: the server doesn't ping, so route stats come from the client, which measures the round trip over each path
+
+                next_adaptive_multipath_sample_t sample;
+                sample.next_route_stats.rtt = session->stats_next_rtt;
+                sample.next_route_stats.jitter = session->stats_next_jitter;
+                sample.next_route_stats.packet_loss = session->stats_next_packet_loss;
+                sample.direct_route_stats.rtt = session->stats_direct_rtt;
+                sample.direct_route_stats.jitter = session->stats_direct_jitter;
+                sample.direct_route_stats.packet_loss = session->stats_direct_packet_loss;
+                sample.payload_packets_lost = 0;
+                sample.payload_packets_expected = 0;
+                sample.payload_jitter = session->stats_jitter_client_to_server;
+
+                if ( session->packet_loss_tracker.last_packet_processed > last_packet_processed )
+                {
+                    sample.payload_packets_lost = packets_lost;
+                    sample.payload_packets_expected = int( session->packet_loss_tracker.last_packet_processed - last_packet_processed );
+                }
+
+                if ( next_adaptive_multipath_update( &session->adaptive_multipath, current_time, &sample ) )
+                {
+                    next_printf( NEXT_LOG_LEVEL_DEBUG, "server started duplicating packets across direct and network next for session %" PRIx64, session->session_id );
+                    server->counters[NEXT_SERVER_COUNTER_MULTIPATH_DUPLICATE_STARTED]++;
+                }
+
+                next_server_mutex_guard( &server->session_mutex );
+                session->mutex_multipath_duplicate = session->adaptive_multipath.duplicate;
+                session->mutex_multipath_prefer_direct = session->adaptive_multipath.prefer_direct;
+            }
         }
     }
 
@@ -3603,16 +4255,17 @@ void next_server_internal_backend_update( next_server_internal_t * server )
         if ( server->server_update_request_id != 0 )
         {
             next_printf( NEXT_LOG_LEVEL_INFO, "server update response timed out. falling back to direct mode only :(" );
+            server->counters[NEXT_SERVER_COUNTER_BACKEND_TIMEOUTS]++;
             server->state = NEXT_SERVER_STATE_DIRECT_ONLY;
-            next_server_notify_direct_only_t * notify_direct_only = (next_server_notify_direct_only_t*) next_malloc( server->context, sizeof(next_server_notify_direct_only_t) );
+            next_server_notify_direct_only_t * notify_direct_only = (next_server_notify_direct_only_t*) next_pool_alloc( server->notify_pool, server->context, sizeof( next_server_notify_direct_only_t ) );
             next_assert( notify_direct_only );
             notify_direct_only->type = NEXT_SERVER_NOTIFY_DIRECT_ONLY;
             {
 #if NEXT_SPIKE_TRACKING
                 next_printf( NEXT_LOG_LEVEL_SPAM, "server internal thread queued up NEXT_SERVER_NOTIFY_DIRECT_ONLY at %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-                next_platform_mutex_guard( &server->notify_mutex );
-                next_queue_push( server->notify_queue, notify_direct_only );
+                next_server_mutex_guard( &server->notify_mutex );
+                next_server_internal_queue_notify( server, notify_direct_only );
             }
             return;
         }
@@ -3634,30 +4287,11 @@ void next_server_internal_backend_update( next_server_internal_t * server )
         packet.server_address = server->server_address;
         packet.uptime = uint64_t( time(NULL) - server->start_time );
 
-        uint8_t magic[8];
-        memset( magic, 0, sizeof(magic) );
-
-        uint8_t from_address_data[4];
-        uint8_t to_address_data[4];
-
-        next_address_data( &server->server_address, from_address_data );
-        next_address_data( &server->backend_address, to_address_data );
-
-        uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-
-        next_assert( ( size_t(packet_data) % 4 ) == 0 );
-
-        int packet_bytes = 0;
-        if ( next_write_backend_packet( NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET, &packet, packet_data, &packet_bytes, next_signed_packets, server->buyer_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
-        {
-            next_printf( NEXT_LOG_LEVEL_ERROR, "server failed to write server update request packet for backend" );
-            return;
-        }
-
-        next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
-        next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
-
-        next_server_internal_send_packet_to_backend( server, packet_data, packet_bytes );
+        if ( next_server_internal_send_backend_packet( server, NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET, &packet ) != NEXT_OK )
+        {
+            next_printf( NEXT_LOG_LEVEL_ERROR, "server failed to write server update request packet for backend" );
+            return;
+        }
 
         server->server_update_last_time = current_time;
 
@@ -3681,31 +4315,12 @@ void next_server_internal_backend_update( next_server_internal_t * server )
         packet.num_sessions = server->server_update_num_sessions;
         packet.server_address = server->server_address;
 
-        uint8_t magic[8];
-        memset( magic, 0, sizeof(magic) );
-
-        uint8_t from_address_data[4];
-        uint8_t to_address_data[4];
-
-        next_address_data( &server->server_address, from_address_data );
-        next_address_data( &server->backend_address, to_address_data );
-
-        uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-
-        next_assert( ( size_t(packet_data) % 4 ) == 0 );
-
-        int packet_bytes = 0;
-        if ( next_write_backend_packet( NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET, &packet, packet_data, &packet_bytes, next_signed_packets, server->buyer_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
+        if ( next_server_internal_resend_backend_packet( server, NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET, &packet ) != NEXT_OK )
         {
             next_printf( NEXT_LOG_LEVEL_ERROR, "server failed to write server update packet for backend" );
             return;
         }
 
-        next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
-        next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
-
-        next_server_internal_send_packet_to_backend( server, packet_data, packet_bytes );
-
         next_printf( NEXT_LOG_LEVEL_DEBUG, "server resent server update packet to backend", packet.num_sessions );
 
         server->server_update_resend_time = current_time + 1.0;
@@ -3747,7 +4362,7 @@ void next_server_internal_backend_update( next_server_internal_t * server )
             packet.next_kbps_down = session->stats_next_kbps_down;
             packet.packets_sent_client_to_server = session->stats_packets_sent_client_to_server;
             {
-                next_platform_mutex_guard( &server->session_mutex );
+                next_server_mutex_guard( &server->session_mutex );
                 packet.packets_sent_server_to_client = session->stats_packets_sent_server_to_client;
             }
 
@@ -3828,31 +4443,12 @@ void next_server_internal_backend_update( next_server_internal_t * server )
             }
 #endif // #if NEXT_DEVELOPMENT
 
-            uint8_t magic[8];
-            memset( magic, 0, sizeof(magic) );
-
-            uint8_t from_address_data[4];
-            uint8_t to_address_data[4];
-
-            next_address_data( &server->server_address, from_address_data );
-            next_address_data( &server->backend_address, to_address_data );
-
-            uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-
-            next_assert( ( size_t(packet_data) % 4 ) == 0 );
-
-            int packet_bytes = 0;
-            if ( next_write_backend_packet( NEXT_BACKEND_SESSION_UPDATE_REQUEST_PACKET, &packet, packet_data, &packet_bytes, next_signed_packets, server->buyer_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
+            if ( next_server_internal_send_backend_packet( server, NEXT_BACKEND_SESSION_UPDATE_REQUEST_PACKET, &packet ) != NEXT_OK )
             {
                 next_printf( NEXT_LOG_LEVEL_ERROR, "server failed to write server init request packet for backend" );
                 return;
             }
 
-            next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
-            next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
-
-            next_server_internal_send_packet_to_backend( server, packet_data, packet_bytes );
-
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server sent session update packet to backend for session %" PRIx64, session->session_id );
 
             if ( session->next_session_update_time == 0.0 )
@@ -3887,92 +4483,96 @@ void next_server_internal_backend_update( next_server_internal_t * server )
 
             next_printf( NEXT_LOG_LEVEL_DEBUG, "server resent session update packet to backend for session %" PRIx64 " (%d)", session->session_id, session->session_update_request_packet.retry_number );
 
-            uint8_t magic[8];
-            memset( magic, 0, sizeof(magic) );
-
-            uint8_t from_address_data[4];
-            uint8_t to_address_data[4];
-
-            next_address_data( &server->server_address, from_address_data );
-            next_address_data( &server->backend_address, to_address_data );
-
-            uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-
-            next_assert( ( size_t(packet_data) % 4 ) == 0 );
-
-            int packet_bytes = 0;
-            if ( next_write_backend_packet( NEXT_BACKEND_SESSION_UPDATE_REQUEST_PACKET, &session->session_update_request_packet, packet_data, &packet_bytes, next_signed_packets, server->buyer_private_key, magic, from_address_data, to_address_data ) != NEXT_OK )
+            if ( next_server_internal_send_backend_packet( server, NEXT_BACKEND_SESSION_UPDATE_REQUEST_PACKET, &session->session_update_request_packet ) != NEXT_OK )
             {
                 next_printf( NEXT_LOG_LEVEL_ERROR, "server failed to write session update request packet for backend" );
                 return;
             }
 
-            next_assert( next_basic_packet_filter( packet_data, packet_bytes ) );
-            next_assert( next_advanced_packet_filter( packet_data, magic, from_address_data, to_address_data, packet_bytes ) );
-
-            next_server_internal_send_packet_to_backend( server, packet_data, packet_bytes );
-
             session->next_session_resend_time += NEXT_SESSION_UPDATE_RESEND_TIME;
         }
 
         if ( !session->session_update_timed_out && session->waiting_for_update_response && session->next_session_update_time - NEXT_SECONDS_BETWEEN_SESSION_UPDATES + NEXT_SESSION_UPDATE_TIMEOUT <= current_time )
         {
             next_printf( NEXT_LOG_LEVEL_ERROR, "server timed out waiting for backend response for session %" PRIx64, session->session_id );
+            server->counters[NEXT_SERVER_COUNTER_BACKEND_TIMEOUTS]++;
             session->waiting_for_update_response = false;
             session->next_session_update_time = -1.0;
             session->session_update_timed_out = true;
 
             // IMPORTANT: Send packets direct from now on for this session
             {
-                next_platform_mutex_guard( &server->session_mutex );
+                next_server_mutex_guard( &server->session_mutex );
                 session->mutex_send_over_network_next = false;
             }
         }
     }
 }
 
+static double next_server_internal_record_stage( next_server_internal_t * server, int metric, double stage_start_time )
+{
+    const double stage_finish_time = next_platform_time();
+    next_latency_histogram_record( &server->latency[metric], stage_finish_time - stage_start_time );
+    return stage_finish_time;
+}
+
 static void next_server_update_internal( next_server_internal_t * server )
 {
     next_assert( !next_global_config.disable_network_next );
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double start_time = next_platform_time();
+
+    double stage_start_time = start_time;
 
     next_server_internal_update_flush( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_FLUSH, stage_start_time );
+
     next_server_internal_update_resolve_hostname( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_RESOLVE_HOSTNAME, stage_start_time );
+
     next_server_internal_update_autodetect( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_AUTODETECT, stage_start_time );
+
     next_server_internal_update_init( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_INIT, stage_start_time );
+
     next_server_internal_update_pending_upgrades( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_PENDING_UPGRADES, stage_start_time );
+
     next_server_internal_update_ready( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_READY, stage_start_time );
+
     next_server_internal_update_server_relays( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_SERVER_RELAYS, stage_start_time );
+
     next_server_internal_update_client_relays( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_CLIENT_RELAYS, stage_start_time );
+
     next_server_internal_update_route( server );
 
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_ROUTE, stage_start_time );
+
     next_server_internal_update_sessions( server );
 
-    next_server_internal_backend_update( server );
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_UPDATE_SESSIONS, stage_start_time );
 
-    next_server_internal_pump_commands( server );
+    next_server_internal_backend_update( server );
 
-#if NEXT_SPIKE_TRACKING
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_BACKEND_UPDATE, stage_start_time );
 
-    double finish_time = next_platform_time();
+    next_server_internal_pump_commands( server );
 
-    if ( finish_time - start_time > 0.001 )
-    {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_server_update_internal spike %.2f milliseconds", ( finish_time - start_time ) * 1000.0 );
-    }
+    stage_start_time = next_server_internal_record_stage( server, NEXT_SERVER_METRIC_PUMP_COMMANDS, stage_start_time );
 
-#endif // #if NEXT_SPIKE_TRACKING
+    next_latency_histogram_record( &server->latency[NEXT_SERVER_METRIC_UPDATE_INTERNAL], stage_start_time - start_time );
 }
 
 static void next_server_internal_thread_function( void * context )
@@ -3985,14 +4585,22 @@ static void next_server_internal_thread_function( void * context )
 
     while ( !server->quit )
     {
+        // IMPORTANT: packets sent on this thread are submitted together at the end of each pass, or when the receive waits
+
+        next_platform_socket_send_batch_begin( server->socket );
+
         next_server_internal_block_and_receive_packet( server );
 
+        next_server_internal_pump_crypto_worker( server );
+
         if ( !next_global_config.disable_network_next && next_platform_time() >= last_update_time + 0.1 )
         {
             next_server_update_internal( server );
 
             last_update_time = next_platform_time();
         }
+
+        next_platform_socket_send_batch_end( server->socket );
     }
 }
 
@@ -4014,6 +4622,8 @@ struct next_server_t
     bool flushing;
     bool flushed;
     bool direct_only;
+    bool sending_packets;
+    bool coalesced_packets_pending;
 
     NEXT_DECLARE_SENTINEL(1)
 
@@ -4026,6 +4636,11 @@ struct next_server_t
     void * send_packet_to_address_callback_data;
 
     NEXT_DECLARE_SENTINEL(3)
+
+    next_latency_histogram_t latency[NEXT_SERVER_METRIC_NUM_METRICS];
+    std::atomic<uint64_t> counters[NEXT_SERVER_COUNTER_NUM_COUNTERS];
+
+    NEXT_DECLARE_SENTINEL(4)
 };
 
 void next_server_initialize_sentinels( next_server_t * server )
@@ -4036,6 +4651,7 @@ void next_server_initialize_sentinels( next_server_t * server )
     NEXT_INITIALIZE_SENTINEL( server, 1 )
     NEXT_INITIALIZE_SENTINEL( server, 2 )
     NEXT_INITIALIZE_SENTINEL( server, 3 )
+    NEXT_INITIALIZE_SENTINEL( server, 4 )
 }
 
 void next_server_verify_sentinels( next_server_t * server )
@@ -4046,6 +4662,7 @@ void next_server_verify_sentinels( next_server_t * server )
     NEXT_VERIFY_SENTINEL( server, 1 )
     NEXT_VERIFY_SENTINEL( server, 2 )
     NEXT_VERIFY_SENTINEL( server, 3 )
+    NEXT_VERIFY_SENTINEL( server, 4 )
     if ( server->session_manager )
         next_proxy_session_manager_verify_sentinels( server->session_manager );
     if ( server->pending_session_manager )
@@ -4054,6 +4671,22 @@ void next_server_verify_sentinels( next_server_t * server )
 
 void next_server_destroy( next_server_t * server );
 
+void next_server_queue_command( next_server_t * server, void * command )
+{
+    // IMPORTANT: call with the internal command_mutex held. when the queue is full next_queue_push frees the command
+
+    if ( next_queue_push( server->internal->command_queue, command ) != NEXT_OK )
+    {
+        server->counters[NEXT_SERVER_COUNTER_COMMAND_QUEUE_OVERFLOW]++;
+        return;
+    }
+
+    if ( (uint64_t) server->internal->command_queue->num_entries > server->counters[NEXT_SERVER_COUNTER_COMMAND_QUEUE_HIGH_WATER_MARK] )
+    {
+        server->counters[NEXT_SERVER_COUNTER_COMMAND_QUEUE_HIGH_WATER_MARK] = server->internal->command_queue->num_entries;
+    }
+}
+
 next_server_t * next_server_create( void * context, const char * server_address, const char * bind_address, const char * datacenter, void (*packet_received_callback)( next_server_t * server, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes ) )
 {
     next_assert( server_address );
@@ -4064,7 +4697,8 @@ next_server_t * next_server_create( void * context, const char * server_address,
     if ( !server )
         return NULL;
 
-    memset( server, 0, sizeof( next_server_t) );
+    char * just_clear_it_and_dont_complain = (char*) server;
+    memset( just_clear_it_and_dont_complain, 0, sizeof(next_server_t) );
 
     next_server_initialize_sentinels( server );
 
@@ -4081,6 +4715,14 @@ next_server_t * next_server_create( void * context, const char * server_address,
     server->address = server->internal->server_address;
     server->bound_port = server->internal->server_address.port;
 
+    if ( next_global_config.immediate_packet_delivery )
+    {
+        // IMPORTANT: set before the internal thread starts, so it never sees a half set callback
+
+        server->internal->immediate_packet_received_callback = packet_received_callback;
+        server->internal->immediate_packet_received_server = server;
+    }
+
     server->thread = next_platform_thread_create( server->context, next_server_internal_thread_function, server->internal );
     if ( !server->thread )
     {
@@ -4091,7 +4733,12 @@ next_server_t * next_server_create( void * context, const char * server_address,
 
     next_platform_server_thread_priority( server->thread );
 
-    server->pending_session_manager = next_proxy_session_manager_create( context, NEXT_INITIAL_PENDING_SESSION_SIZE );
+    if ( next_global_config.server_thread_cpu >= 0 && next_platform_thread_affinity( server->thread, next_global_config.server_thread_cpu ) != NEXT_OK )
+    {
+        next_printf( NEXT_LOG_LEVEL_WARN, "server could not pin thread to cpu %d", next_global_config.server_thread_cpu );
+    }
+
+    server->pending_session_manager = next_proxy_session_manager_create( context, next_global_config.max_sessions > 0 ? next_global_config.max_sessions : NEXT_INITIAL_PENDING_SESSION_SIZE );
     if ( server->pending_session_manager == NULL )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create pending session manager (proxy)" );
@@ -4099,7 +4746,7 @@ next_server_t * next_server_create( void * context, const char * server_address,
         return NULL;
     }
 
-    server->session_manager = next_proxy_session_manager_create( context, NEXT_INITIAL_SESSION_SIZE );
+    server->session_manager = next_proxy_session_manager_create( context, next_global_config.max_sessions > 0 ? next_global_config.max_sessions : NEXT_INITIAL_SESSION_SIZE );
     if ( server->session_manager == NULL )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server could not create session manager (proxy)" );
@@ -4162,6 +4809,8 @@ void next_server_update( next_server_t * server )
 {
     next_server_verify_sentinels( server );
 
+    next_latency_timer( &server->latency[NEXT_SERVER_METRIC_UPDATE] );
+
 #if NEXT_SPIKE_TRACKING
     next_printf( NEXT_LOG_LEVEL_SPAM, "next_server_update" );
 #endif // #if NEXT_SPIKE_TRACKING
@@ -4170,13 +4819,19 @@ void next_server_update( next_server_t * server )
     {
         void * queue_entry = NULL;
         {
-            next_platform_mutex_guard( &server->internal->notify_mutex );
+            next_server_mutex_guard( &server->internal->notify_mutex );
             queue_entry = next_queue_pop( server->internal->notify_queue );
+            if ( queue_entry == NULL )
+            {
+                queue_entry = next_queue_pop( server->internal->payload_queue );
+            }
         }
 
         if ( queue_entry == NULL )
             break;
 
+        server->counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_POPPED]++;
+
         next_server_notify_t * notify = (next_server_notify_t*) queue_entry;
 
         switch ( notify->type )
@@ -4194,6 +4849,7 @@ void next_server_update( next_server_t * server )
                 char address_buffer[NEXT_MAX_ADDRESS_STRING_LENGTH];
                 next_printf( NEXT_LOG_LEVEL_SPAM, "server calling packet received callback: from = %s, packet_bytes = %d", next_address_to_string( &packet_received->from, address_buffer ), packet_received->packet_bytes );
 #endif // #if NEXT_SPIKE_TRACKING
+                next_latency_histogram_record( &server->latency[NEXT_SERVER_METRIC_NOTIFY_TO_CALLBACK], next_platform_time() - packet_received->queue_time );
                 server->packet_received_callback( server, server->context, &packet_received->from, packet_received->packet_data, packet_received->packet_bytes );
             }
             break;
@@ -4212,6 +4868,10 @@ void next_server_update( next_server_t * server )
                     next_proxy_session_manager_remove_by_address( server->session_manager, &session_upgraded->address );
                     next_proxy_session_manager_remove_by_address( server->pending_session_manager, &session_upgraded->address );
                     proxy_entry = next_proxy_session_manager_add( server->session_manager, &session_upgraded->address, session_upgraded->session_id );
+                    if ( proxy_entry && !next_proxy_session_manager_enable_features( server->session_manager, proxy_entry, session_upgraded->payload_coalescing, session_upgraded->fec ) )
+                    {
+                        next_printf( NEXT_LOG_LEVEL_ERROR, "server could not allocate payload coalescing and fec state for session %" PRIx64 ". packets will be sent passthrough", session_upgraded->session_id );
+                    }
                 }
             }
             break;
@@ -4305,7 +4965,7 @@ void next_server_update( next_server_t * server )
             default: break;
         }
 
-        next_free( server->context, queue_entry );
+        next_pool_free( server->internal->notify_pool, server->context, queue_entry );
     }
 }
 
@@ -4327,7 +4987,7 @@ uint64_t next_server_upgrade_session( next_server_t * server, const next_address
 
     // send upgrade session command to internal server
 
-    next_server_command_upgrade_session_t * command = (next_server_command_upgrade_session_t*) next_malloc( server->context, sizeof( next_server_command_upgrade_session_t ) );
+    next_server_command_upgrade_session_t * command = (next_server_command_upgrade_session_t*) next_pool_alloc( server->internal->command_pool, server->context, sizeof( next_server_command_upgrade_session_t ) );
     if ( !command )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server upgrade session failed. could not create upgrade session command" );
@@ -4347,8 +5007,8 @@ uint64_t next_server_upgrade_session( next_server_t * server, const next_address
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "server queues up NEXT_SERVER_COMMAND_UPGRADE_SESSION from %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &server->internal->command_mutex );
-        next_queue_push( server->internal->command_queue, command );
+        next_server_mutex_guard( &server->internal->command_mutex );
+        next_server_queue_command( server, command );
     }
 
     // remove any existing entry for this address. latest upgrade takes precedence
@@ -4402,25 +5062,213 @@ void next_server_send_packet_to_address( next_server_t * server, const next_addr
             return;
     }
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double send_start_time = next_platform_time();
 
     next_platform_socket_send_packet( server->internal->socket, address, packet_data, packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-    double finish_time = next_platform_time();
-    if ( finish_time - start_time > 0.001 )
+    next_latency_histogram_record( &server->latency[NEXT_SERVER_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
+
+    server->counters[NEXT_SERVER_COUNTER_PACKETS_SENT]++;
+    server->counters[NEXT_SERVER_COUNTER_BYTES_SENT] += packet_bytes;
+}
+
+static uint64_t next_server_send_upgraded_packet( next_server_t * server, const next_address_t * to_address, next_proxy_session_entry_t * entry, next_session_entry_t * internal_entry, const uint8_t * packet_data, int packet_bytes, bool fec_parity )
+{
+    next_assert( to_address );
+    next_assert( entry );
+    next_assert( internal_entry );
+    next_assert( packet_data );
+    next_assert( packet_bytes > 0 );
+    next_assert( packet_bytes <= NEXT_MTU );
+
+    bool send_over_network_next = false;
+    bool send_upgraded_direct = false;
+    bool multipath = false;
+    bool multipath_duplicate = false;
+    bool multipath_prefer_direct = false;
+    int envelope_kbps_down = 0;
+    uint8_t open_session_sequence = 0;
+    uint64_t send_sequence = 0;
+    uint64_t session_id = 0;
+    uint8_t session_version = 0;
+    next_address_t session_address;
+    uint8_t session_private_key[NEXT_CRYPTO_BOX_SECRETKEYBYTES];
+
+    {
+        next_server_mutex_guard( &server->internal->session_mutex );
+        multipath = internal_entry->mutex_multipath;
+        multipath_duplicate = internal_entry->mutex_multipath_duplicate;
+        multipath_prefer_direct = internal_entry->mutex_multipath_prefer_direct;
+        envelope_kbps_down = internal_entry->mutex_envelope_kbps_down;
+        send_over_network_next = internal_entry->mutex_send_over_network_next;
+        send_upgraded_direct = !send_over_network_next;
+        send_sequence = internal_entry->mutex_payload_send_sequence++;
+        open_session_sequence = internal_entry->client_open_session_sequence;
+        session_id = internal_entry->mutex_session_id;
+        session_version = internal_entry->mutex_session_version;
+        session_address = internal_entry->mutex_send_address;
+        memcpy( session_private_key, internal_entry->mutex_private_key, NEXT_CRYPTO_BOX_SECRETKEYBYTES );
+        internal_entry->stats_packets_sent_server_to_client++;
+    }
+
+    if ( send_over_network_next && multipath )
+    {
+        if ( next_global_config.adaptive_multipath && !multipath_duplicate )
+        {
+            // primary path is healthy. only send on it
+
+            if ( multipath_prefer_direct )
+            {
+                send_over_network_next = false;
+                send_upgraded_direct = true;
+            }
+
+            multipath = false;
+
+            server->counters[NEXT_SERVER_COUNTER_MULTIPATH_SINGLE_PATH]++;
+        }
+        else
+        {
+            send_upgraded_direct = true;
+
+            server->counters[NEXT_SERVER_COUNTER_MULTIPATH_DUPLICATED]++;
+        }
+    }
+
+    if ( fec_parity )
     {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
+        // IMPORTANT: parity is tracked apart from the session bandwidth envelope, so it can never push payloads off network next.
+        // It goes over network next only while payloads and parity together fit in the envelope, otherwise it goes direct
+
+        const int wire_packet_bits = next_wire_packet_bits( packet_bytes );
+
+        next_assert( entry->fec );
+
+        next_bandwidth_limiter_add_packet( &entry->fec->send_bandwidth, next_platform_time(), 0, wire_packet_bits );
+
+        if ( send_over_network_next && next_bandwidth_limiter_usage_kbps( &entry->send_bandwidth ) + next_bandwidth_limiter_usage_kbps( &entry->fec->send_bandwidth ) > envelope_kbps_down )
+        {
+            send_over_network_next = false;
+            send_upgraded_direct = true;
+        }
+    }
+    else if ( send_over_network_next )
+    {
+        const int wire_packet_bits = next_wire_packet_bits( packet_bytes );
+
+        bool over_budget = next_bandwidth_limiter_add_packet( &entry->send_bandwidth, next_platform_time(), envelope_kbps_down, wire_packet_bits );
+
+        if ( over_budget )
+        {
+            next_printf( NEXT_LOG_LEVEL_WARN, "server exceeded bandwidth budget for session %" PRIx64 " (%d kbps)", session_id, envelope_kbps_down );
+            {
+                next_server_mutex_guard( &server->internal->session_mutex );
+                internal_entry->stats_server_bandwidth_over_limit = true;
+            }
+            send_over_network_next = false;
+            if ( !multipath )
+            {
+                send_upgraded_direct = true;
+            }
+        }
+    }
+
+    if ( send_over_network_next )
+    {
+        // send over network next
+
+        uint8_t from_address_data[4];
+        uint8_t to_address_data[4];
+
+        next_address_data( &server->address, from_address_data );
+        next_address_data( &session_address, to_address_data );
+
+        uint8_t next_packet_data[NEXT_MAX_PACKET_BYTES];
+
+        int next_packet_bytes = next_write_server_to_client_packet( next_packet_data, send_sequence, session_id, session_version, session_private_key, packet_data, packet_bytes, server->current_magic, from_address_data, to_address_data );
+
+        next_assert( next_packet_bytes > 0 );
+
+        next_assert( next_basic_packet_filter( next_packet_data, next_packet_bytes ) );
+        next_assert( next_advanced_packet_filter( next_packet_data, server->current_magic, from_address_data, to_address_data, next_packet_bytes ) );
+
+        next_server_send_packet_to_address( server, &session_address, next_packet_data, next_packet_bytes );
+
+        server->counters[NEXT_SERVER_COUNTER_PAYLOADS_SENT_NEXT]++;
+    }
+
+    if ( send_upgraded_direct )
+    {
+        // direct packet
+
+        uint8_t from_address_data[4];
+        uint8_t to_address_data[4];
+
+        next_address_data( &server->address, from_address_data );
+        next_address_data( to_address, to_address_data );
+
+        uint8_t direct_packet_data[NEXT_MAX_PACKET_BYTES];
+
+        int direct_packet_bytes = next_write_direct_packet( direct_packet_data, open_session_sequence, send_sequence, packet_data, packet_bytes, server->current_magic, from_address_data, to_address_data );
+
+        next_assert( direct_packet_bytes >= 27 );
+        next_assert( direct_packet_bytes <= NEXT_MTU + 27 );
+        next_assert( direct_packet_data[0] == NEXT_DIRECT_PACKET );
+
+        next_assert( next_basic_packet_filter( direct_packet_data, direct_packet_bytes ) );
+        next_assert( next_advanced_packet_filter( direct_packet_data, server->current_magic, from_address_data, to_address_data, direct_packet_bytes ) );
+
+        next_server_send_packet_to_address( server, to_address, direct_packet_data, direct_packet_bytes );
+
+        server->counters[NEXT_SERVER_COUNTER_PAYLOADS_SENT_DIRECT]++;
+    }
+
+    return send_sequence;
+}
+
+static void next_server_send_upgraded_payload( next_server_t * server, const next_address_t * to_address, next_proxy_session_entry_t * entry, next_session_entry_t * internal_entry, bool fec, const uint8_t * payload_data, int payload_bytes )
+{
+    next_assert( entry );
+    next_assert( payload_data );
+    next_assert( payload_bytes > 0 );
+    next_assert( payload_bytes <= NEXT_MTU );
+
+    if ( !fec )
+    {
+        next_server_send_upgraded_packet( server, to_address, entry, internal_entry, payload_data, payload_bytes, false );
+        return;
+    }
+
+    uint8_t packet_data[NEXT_MTU];
+
+    next_assert( entry->fec );
+
+    next_fec_encoder_t * encoder = &entry->fec->encoder;
+
+    const int packet_bytes = next_fec_encoder_write_packet( encoder, packet_data, payload_data, payload_bytes );
+
+    const uint64_t send_sequence = next_server_send_upgraded_packet( server, to_address, entry, internal_entry, packet_data, packet_bytes, false );
+
+    if ( next_fec_encoder_add_packet( encoder, send_sequence, payload_data, payload_bytes, next_global_config.fec_group_size ) )
+    {
+        const int parity_bytes = next_fec_encoder_write_parity( encoder, packet_data );
+
+        next_server_send_upgraded_packet( server, to_address, entry, internal_entry, packet_data, parity_bytes, true );
+
+        next_fec_encoder_reset( encoder );
+
+        server->counters[NEXT_SERVER_COUNTER_FEC_PARITY_SENT]++;
     }
-#endif // #if NEXT_SPIKE_TRACKING
 }
 
 void next_server_send_packet( next_server_t * server, const next_address_t * to_address, const uint8_t * packet_data, int packet_bytes )
 {
     next_server_verify_sentinels( server );
 
+    next_latency_timer( &server->latency[NEXT_SERVER_METRIC_SEND_PACKET] );
+
+    server->counters[NEXT_SERVER_COUNTER_PAYLOADS_SENT]++;
+
     next_assert( to_address );
     next_assert( packet_data );
     next_assert( packet_bytes > 0 );
@@ -4439,28 +5287,21 @@ void next_server_send_packet( next_server_t * server, const next_address_t * to_
 
     next_proxy_session_entry_t * entry = next_proxy_session_manager_find( server->session_manager, to_address );
 
-    bool send_over_network_next = false;
-    bool send_upgraded_direct = false;
-
     if ( entry && packet_bytes <= NEXT_MTU )
     {
-        bool multipath = false;
-        int envelope_kbps_down = 0;
-        uint8_t open_session_sequence = 0;
-        uint64_t send_sequence = 0;
-        uint64_t session_id = 0;
-        uint8_t session_version = 0;
-        next_address_t session_address;
         double last_upgraded_packet_receive_time = 0.0;
-        uint8_t session_private_key[NEXT_CRYPTO_BOX_SECRETKEYBYTES];
+        bool payload_coalescing = false;
+        bool fec = false;
 
         next_session_entry_t * internal_entry = NULL;
         {
-            next_platform_mutex_guard( &server->internal->session_mutex );
+            next_server_mutex_guard( &server->internal->session_mutex );
             internal_entry = next_session_manager_find_by_address( server->internal->session_manager, to_address );
             if ( internal_entry )
             {
                 last_upgraded_packet_receive_time = internal_entry->last_upgraded_packet_receive_time;
+                payload_coalescing = internal_entry->payload_coalescing;
+                fec = internal_entry->fec;
             }
         }
 
@@ -4472,92 +5313,52 @@ void next_server_send_packet( next_server_t * server, const next_address_t * to_
             return;
         }
 
-        {
-            next_platform_mutex_guard( &server->internal->session_mutex );
-            multipath = internal_entry->mutex_multipath;
-            envelope_kbps_down = internal_entry->mutex_envelope_kbps_down;
-            send_over_network_next = internal_entry->mutex_send_over_network_next;
-            send_upgraded_direct = !send_over_network_next;
-            send_sequence = internal_entry->mutex_payload_send_sequence++;
-            open_session_sequence = internal_entry->client_open_session_sequence;
-            session_id = internal_entry->mutex_session_id;
-            session_version = internal_entry->mutex_session_version;
-            session_address = internal_entry->mutex_send_address;
-            memcpy( session_private_key, internal_entry->mutex_private_key, NEXT_CRYPTO_BOX_SECRETKEYBYTES );
-            internal_entry->stats_packets_sent_server_to_client++;
-        }
+        // IMPORTANT: upgraded packets never exceed NEXT_MTU. Fec framing comes out of that, and so does the coalescing prefix,
+        // so a packet that doesn't fit with the framing the session negotiated goes passthrough
 
-        if ( multipath )
-        {
-            send_upgraded_direct = true;
-        }
+        const int max_payload_bytes = fec ? NEXT_MAX_FEC_PAYLOAD_BYTES : NEXT_MTU;
 
-        if ( send_over_network_next )
+        if ( payload_coalescing ? !next_payload_coalescer_packet_fits( packet_bytes, max_payload_bytes ) : packet_bytes > max_payload_bytes )
         {
-            const int wire_packet_bits = next_wire_packet_bits( packet_bytes );
+            next_server_send_packet_direct( server, to_address, packet_data, packet_bytes );
+            return;
+        }
 
-            bool over_budget = next_bandwidth_limiter_add_packet( &entry->send_bandwidth, next_platform_time(), envelope_kbps_down, wire_packet_bits );
+        // IMPORTANT: the state for negotiated features is allocated when the session upgrade reaches this thread. until then, or if that failed, send passthrough
 
-            if ( over_budget )
-            {
-                next_printf( NEXT_LOG_LEVEL_WARN, "server exceeded bandwidth budget for session %" PRIx64 " (%d kbps)", session_id, envelope_kbps_down );
-                {
-                    next_platform_mutex_guard( &server->internal->session_mutex );
-                    internal_entry->stats_server_bandwidth_over_limit = true;
-                }
-                send_over_network_next = false;
-                if ( !multipath )
-                {
-                    send_upgraded_direct = true;
-                }
-            }
+        if ( ( payload_coalescing && !entry->send_coalescer ) || ( fec && !entry->fec ) )
+        {
+            next_server_send_packet_direct( server, to_address, packet_data, packet_bytes );
+            return;
         }
 
-        if ( send_over_network_next )
+        if ( !payload_coalescing )
         {
-            // send over network next
-
-            uint8_t from_address_data[4];
-            uint8_t to_address_data[4];
-
-            next_address_data( &server->address, from_address_data );
-            next_address_data( &session_address, to_address_data );
-
-            uint8_t next_packet_data[NEXT_MAX_PACKET_BYTES];
-
-            int next_packet_bytes = next_write_server_to_client_packet( next_packet_data, send_sequence, session_id, session_version, session_private_key, packet_data, packet_bytes, server->current_magic, from_address_data, to_address_data );
-
-            next_assert( next_packet_bytes > 0 );
-
-            next_assert( next_basic_packet_filter( next_packet_data, next_packet_bytes ) );
-            next_assert( next_advanced_packet_filter( next_packet_data, server->current_magic, from_address_data, to_address_data, next_packet_bytes ) );
-
-            next_server_send_packet_to_address( server, &session_address, next_packet_data, next_packet_bytes );
+            next_server_send_upgraded_payload( server, to_address, entry, internal_entry, fec, packet_data, packet_bytes );
+            return;
         }
 
-        if ( send_upgraded_direct )
+        if ( server->sending_packets )
         {
-            // direct packet
-
-            uint8_t from_address_data[4];
-            uint8_t to_address_data[4];
+            // pack into the session coalescer and send it when full or at next_server_send_packets_end
 
-            next_address_data( &server->address, from_address_data );
-            next_address_data( to_address, to_address_data );
-
-            uint8_t direct_packet_data[NEXT_MAX_PACKET_BYTES];
-
-            int direct_packet_bytes = next_write_direct_packet( direct_packet_data, open_session_sequence, send_sequence, packet_data, packet_bytes, server->current_magic, from_address_data, to_address_data );
-
-            next_assert( direct_packet_bytes >= 27 );
-            next_assert( direct_packet_bytes <= NEXT_MTU + 27 );
-            next_assert( direct_packet_data[0] == NEXT_DIRECT_PACKET );
+            if ( !next_payload_coalescer_add_packet( entry->send_coalescer, packet_data, packet_bytes, max_payload_bytes ) )
+            {
+                next_server_send_upgraded_payload( server, to_address, entry, internal_entry, fec, entry->send_coalescer->payload_data, entry->send_coalescer->payload_bytes );
+                next_payload_coalescer_reset( entry->send_coalescer );
+                const bool added = next_payload_coalescer_add_packet( entry->send_coalescer, packet_data, packet_bytes, max_payload_bytes );
+                next_assert( added );
+                (void) added;
+            }
 
-            next_assert( next_basic_packet_filter( direct_packet_data, direct_packet_bytes ) );
-            next_assert( next_advanced_packet_filter( direct_packet_data, server->current_magic, from_address_data, to_address_data, direct_packet_bytes ) );
+            server->coalesced_packets_pending = true;
 
-            next_server_send_packet_to_address( server, to_address, direct_packet_data, direct_packet_bytes );
+            return;
         }
+
+        uint8_t payload_data[NEXT_MTU];
+        const int payload_bytes = next_payload_coalescer_write_packet( payload_data, packet_data, packet_bytes );
+        next_server_send_upgraded_payload( server, to_address, entry, internal_entry, fec, payload_data, payload_bytes );
     }
     else
     {
@@ -4596,33 +5397,92 @@ void next_server_send_packet_raw( struct next_server_t * server, const struct ne
     next_assert( packet_data );
     next_assert( packet_bytes > 0 );
 
-#if NEXT_SPIKE_TRACKING
-    double start_time = next_platform_time();
-#endif // #if NEXT_SPIKE_TRACKING
+    const double send_start_time = next_platform_time();
 
     next_platform_socket_send_packet( server->internal->socket, to_address, packet_data, packet_bytes );
 
-#if NEXT_SPIKE_TRACKING
-    double finish_time = next_platform_time();
-    if ( finish_time - start_time > 0.001 )
+    next_latency_histogram_record( &server->latency[NEXT_SERVER_METRIC_SOCKET_SEND], next_platform_time() - send_start_time );
+
+    server->counters[NEXT_SERVER_COUNTER_PACKETS_SENT]++;
+    server->counters[NEXT_SERVER_COUNTER_BYTES_SENT] += packet_bytes;
+}
+
+void next_server_send_packets_begin( struct next_server_t * server )
+{
+    next_server_verify_sentinels( server );
+
+    server->sending_packets = true;
+
+    next_platform_socket_send_batch_begin( server->internal->socket );
+}
+
+static void next_server_flush_coalesced_packets( next_server_t * server, next_proxy_session_entry_t * entry )
+{
+    next_assert( entry );
+    next_assert( entry->send_coalescer );
+    next_assert( entry->send_coalescer->num_packets > 0 );
+
+    next_session_entry_t * internal_entry = NULL;
+    bool fec = false;
     {
-        next_printf( NEXT_LOG_LEVEL_WARN, "next_platform_socket_send_packet spiked %.2f milliseconds at %s:%d", ( finish_time - start_time ) * 1000.0, __FILE__, __LINE__ );
+        next_server_mutex_guard( &server->internal->session_mutex );
+        internal_entry = next_session_manager_find_by_address( server->internal->session_manager, &entry->address );
+        if ( internal_entry )
+        {
+            fec = internal_entry->fec;
+        }
     }
-#endif // #if NEXT_SPIKE_TRACKING
+
+    if ( internal_entry && ( !fec || entry->fec ) )
+    {
+        next_server_send_upgraded_payload( server, &entry->address, entry, internal_entry, fec, entry->send_coalescer->payload_data, entry->send_coalescer->payload_bytes );
+    }
+    else
+    {
+        // IMPORTANT: the session went away or changed since these packets were queued, so send them as passthrough packets instead
+
+        int offset = 0;
+        const uint8_t * packet_data = NULL;
+        int packet_bytes = 0;
+        while ( ( packet_bytes = next_payload_coalescer_read_packet( entry->send_coalescer->payload_data, entry->send_coalescer->payload_bytes, &offset, &packet_data ) ) > 0 )
+        {
+            next_server_send_packet_direct( server, &entry->address, packet_data, packet_bytes );
+        }
+    }
+
+    next_payload_coalescer_reset( entry->send_coalescer );
 }
 
-bool next_server_stats( next_server_t * server, const next_address_t * address, next_server_stats_t * stats )
+void next_server_send_packets_end( struct next_server_t * server )
 {
-    next_assert( server );
-    next_assert( address );
-    next_assert( stats );
+    next_server_verify_sentinels( server );
+
+    if ( server->coalesced_packets_pending )
+    {
+        const int max_index = server->session_manager->max_entry_index;
+        for ( int i = 0; i <= max_index; ++i )
+        {
+            if ( server->session_manager->addresses[i].type == NEXT_ADDRESS_NONE )
+                continue;
 
-    next_platform_mutex_guard( &server->internal->session_mutex );
+            next_proxy_session_entry_t * entry = &server->session_manager->entries[i];
 
-    next_session_entry_t * entry = next_session_manager_find_by_address( server->internal->session_manager, address );
-    if ( !entry )
-        return false;
+            if ( entry->send_coalescer && entry->send_coalescer->num_packets > 0 )
+            {
+                next_server_flush_coalesced_packets( server, entry );
+            }
+        }
+
+        server->coalesced_packets_pending = false;
+    }
+
+    server->sending_packets = false;
 
+    next_platform_socket_send_batch_end( server->internal->socket );
+}
+
+static void next_server_copy_session_stats( const next_session_entry_t * entry, next_server_stats_t * stats )
+{
     stats->session_id = entry->session_id;
     stats->user_hash = entry->user_hash;
     stats->platform_id = entry->stats_platform_id;
@@ -4650,6 +5510,21 @@ bool next_server_stats( next_server_t * server, const next_address_t * address,
     stats->packets_out_of_order_server_to_client = entry->stats_packets_out_of_order_server_to_client;
     stats->jitter_client_to_server = entry->stats_jitter_client_to_server;
     stats->jitter_server_to_client = entry->stats_jitter_server_to_client;
+}
+
+bool next_server_stats( next_server_t * server, const next_address_t * address, next_server_stats_t * stats )
+{
+    next_assert( server );
+    next_assert( address );
+    next_assert( stats );
+
+    next_server_mutex_guard( &server->internal->session_mutex );
+
+    next_session_entry_t * entry = next_session_manager_find_by_address( server->internal->session_manager, address );
+    if ( !entry )
+        return false;
+
+    next_server_copy_session_stats( entry, stats );
 
     return true;
 }
@@ -4681,7 +5556,7 @@ void next_server_session_event( struct next_server_t * server, const struct next
     
     // send session event command to internal server
 
-    next_server_command_session_event_t * command = (next_server_command_session_event_t*) next_malloc( server->context, sizeof( next_server_command_session_event_t ) );
+    next_server_command_session_event_t * command = (next_server_command_session_event_t*) next_pool_alloc( server->internal->command_pool, server->context, sizeof( next_server_command_session_event_t ) );
     if ( !command )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "session event failed. could not create session event command" );
@@ -4696,8 +5571,8 @@ void next_server_session_event( struct next_server_t * server, const struct next
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "server queues up NEXT_SERVER_COMMAND_SERVER_EVENT from %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &server->internal->command_mutex );
-        next_queue_push( server->internal->command_queue, command );
+        next_server_mutex_guard( &server->internal->command_mutex );
+        next_server_queue_command( server, command );
     }
 }
 
@@ -4719,7 +5594,7 @@ void next_server_flush( struct next_server_t * server )
 
     // send flush command to internal server
 
-    next_server_command_flush_t * command = (next_server_command_flush_t*) next_malloc( server->context, sizeof( next_server_command_flush_t ) );
+    next_server_command_flush_t * command = (next_server_command_flush_t*) next_pool_alloc( server->internal->command_pool, server->context, sizeof( next_server_command_flush_t ) );
     if ( !command )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server flush failed. could not create server flush command" );
@@ -4732,8 +5607,8 @@ void next_server_flush( struct next_server_t * server )
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "server queues up NEXT_SERVER_COMMAND_FLUSH from %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &server->internal->command_mutex );
-        next_queue_push( server->internal->command_queue, command );
+        next_server_mutex_guard( &server->internal->command_mutex );
+        next_server_queue_command( server, command );
     }
 
     server->flushing = true;
@@ -4763,7 +5638,7 @@ void next_server_set_packet_receive_callback( struct next_server_t * server, voi
 {
     next_assert( server );
 
-    next_server_command_set_packet_receive_callback_t * command = (next_server_command_set_packet_receive_callback_t*) next_malloc( server->context, sizeof( next_server_command_set_packet_receive_callback_t ) );
+    next_server_command_set_packet_receive_callback_t * command = (next_server_command_set_packet_receive_callback_t*) next_pool_alloc( server->internal->command_pool, server->context, sizeof( next_server_command_set_packet_receive_callback_t ) );
     if ( !command )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server set packet receive callback failed. could not create command" );
@@ -4778,8 +5653,8 @@ void next_server_set_packet_receive_callback( struct next_server_t * server, voi
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "server queues up NEXT_SERVER_COMMAND_SET_PACKET_RECEIVE_CALLBACK from %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &server->internal->command_mutex );
-        next_queue_push( server->internal->command_queue, command );
+        next_server_mutex_guard( &server->internal->command_mutex );
+        next_server_queue_command( server, command );
     }
 }
 
@@ -4790,7 +5665,7 @@ void next_server_set_send_packet_to_address_callback( struct next_server_t * ser
     server->send_packet_to_address_callback = callback;
     server->send_packet_to_address_callback_data = callback_data;
 
-    next_server_command_set_send_packet_to_address_callback_t * command = (next_server_command_set_send_packet_to_address_callback_t*) next_malloc( server->context, sizeof( next_server_command_set_send_packet_to_address_callback_t ) );
+    next_server_command_set_send_packet_to_address_callback_t * command = (next_server_command_set_send_packet_to_address_callback_t*) next_pool_alloc( server->internal->command_pool, server->context, sizeof( next_server_command_set_send_packet_to_address_callback_t ) );
     if ( !command )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server set send packet to address callback failed. could not create command" );
@@ -4805,8 +5680,8 @@ void next_server_set_send_packet_to_address_callback( struct next_server_t * ser
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "server queues up NEXT_SERVER_COMMAND_SEND_PACKET_TO_ADDRESS_CALLBACK from %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &server->internal->command_mutex );
-        next_queue_push( server->internal->command_queue, command );
+        next_server_mutex_guard( &server->internal->command_mutex );
+        next_server_queue_command( server, command );
     }
 }
 
@@ -4814,7 +5689,7 @@ void next_server_set_payload_receive_callback( struct next_server_t * server, in
 {
     next_assert( server );
 
-    next_server_command_set_payload_receive_callback_t * command = (next_server_command_set_payload_receive_callback_t*) next_malloc( server->context, sizeof( next_server_command_set_payload_receive_callback_t ) );
+    next_server_command_set_payload_receive_callback_t * command = (next_server_command_set_payload_receive_callback_t*) next_pool_alloc( server->internal->command_pool, server->context, sizeof( next_server_command_set_payload_receive_callback_t ) );
     if ( !command )
     {
         next_printf( NEXT_LOG_LEVEL_ERROR, "server set payload receive callback failed. could not create command" );
@@ -4829,8 +5704,8 @@ void next_server_set_payload_receive_callback( struct next_server_t * server, in
 #if NEXT_SPIKE_TRACKING
         next_printf( NEXT_LOG_LEVEL_SPAM, "server queues up NEXT_SERVER_COMMAND_SEND_PACKET_TO_ADDRESS_CALLBACK from %s:%d", __FILE__, __LINE__ );
 #endif // #if NEXT_SPIKE_TRACKING
-        next_platform_mutex_guard( &server->internal->command_mutex );
-        next_queue_push( server->internal->command_queue, command );
+        next_server_mutex_guard( &server->internal->command_mutex );
+        next_server_queue_command( server, command );
     }
 }
 
@@ -4840,4 +5715,72 @@ bool next_server_direct_only( struct next_server_t * server )
     return server->direct_only;
 }
 
+void next_server_metrics( next_server_t * server, next_server_metrics_t * metrics )
+{
+    next_server_verify_sentinels( server );
+
+    next_assert( metrics );
+
+    for ( int i = 0; i < NEXT_SERVER_METRIC_NUM_METRICS; i++ )
+    {
+        const next_latency_histogram_t * histograms[] = { &server->latency[i], &server->internal->latency[i] };
+        next_latency_histogram_summary( histograms, 2, &metrics->latency[i] );
+    }
+}
+
+void next_server_counters( next_server_t * server, uint64_t * counters )
+{
+    next_server_verify_sentinels( server );
+
+    next_assert( counters );
+
+    for ( int i = 0; i < NEXT_SERVER_COUNTER_NUM_COUNTERS; i++ )
+    {
+        counters[i] = server->counters[i].load( std::memory_order_relaxed ) + server->internal->counters[i].load( std::memory_order_relaxed );
+    }
+
+    if ( server->internal->notify_pool )
+    {
+        counters[NEXT_SERVER_COUNTER_MEMORY_POOL_FALLBACKS] += server->internal->notify_pool->num_fallback_allocs.load( std::memory_order_relaxed );
+    }
+
+    if ( server->internal->command_pool )
+    {
+        counters[NEXT_SERVER_COUNTER_MEMORY_POOL_FALLBACKS] += server->internal->command_pool->num_fallback_allocs.load( std::memory_order_relaxed );
+    }
+}
+
+int next_server_session_stats( next_server_t * server, next_address_t * addresses, next_server_stats_t * stats, int max_sessions )
+{
+    next_server_verify_sentinels( server );
+
+    next_assert( addresses );
+    next_assert( stats );
+    next_assert( max_sessions >= 0 );
+
+    next_server_mutex_guard( &server->internal->session_mutex );
+
+    next_session_manager_t * session_manager = server->internal->session_manager;
+
+    int num_sessions = 0;
+
+    const int max_index = session_manager->max_entry_index;
+
+    for ( int i = 0; i <= max_index && num_sessions < max_sessions; ++i )
+    {
+        if ( session_manager->session_ids[i] == 0 )
+            continue;
+
+        const next_session_entry_t * entry = &session_manager->entries[i];
+
+        addresses[num_sessions] = entry->address;
+
+        next_server_copy_session_stats( entry, &stats[num_sessions] );
+
+        num_sessions++;
+    }
+
+    return num_sessions;
+}
+
 // ---------------------------------------------------------------
@@ -32,8 +32,11 @@
 #include "next_bitpacker.h"
 #include "next_stream.h"
 #include "next_serialize.h"
+#include "next_fast_serialize.h"
+#include "next_latency_histogram.h"
 #include "next_base64.h"
 #include "next_queue.h"
+#include "next_pool.h"
 #include "next_hash.h"
 #include "next_replay_protection.h"
 #include "next_ping_history.h"
@@ -43,20 +46,35 @@
 #include "next_header.h"
 #include "next_packet_filter.h"
 #include "next_bandwidth_limiter.h"
+#include "next_payload_coalescer.h"
+#include "next_fec.h"
 #include "next_packet_loss_tracker.h"
 #include "next_out_of_order_tracker.h"
 #include "next_jitter_tracker.h"
+#include "next_adaptive_multipath.h"
 #include "next_pending_session_manager.h"
 #include "next_proxy_session_manager.h"
 #include "next_session_manager.h"
 #include "next_relay_manager.h"
+#include "next_route_manager.h"
 #include "next_internal_config.h"
+#include "next_crypto_worker.h"
+#include "next_async_log.h"
+#include "next_impairment.h"
+#include "next_xdp.h"
 
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <atomic>
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
 
 static void next_check_handler( const char * condition,
                                 const char * function,
@@ -193,6 +211,40 @@ void test_queue()
 
     next_check( next_queue_push( queue, next_malloc( NULL, 100 ) ) == NEXT_ERROR );
 
+    // pushing with drop oldest on a full queue frees the oldest entry and queues the new one
+
+    {
+        void * newest = next_malloc( NULL, EntrySize );
+        next_check( next_queue_push_drop_oldest( queue, newest ) == NEXT_ERROR );
+        next_check( queue->num_entries == QueueSize );
+
+        void * oldest = next_queue_pop( queue );
+        next_check( oldest == entries[1] );
+        next_free( NULL, oldest );
+
+        next_check( next_queue_push_drop_oldest( queue, next_malloc( NULL, EntrySize ) ) == NEXT_OK );
+
+        for ( i = 2; i < QueueSize; ++i )
+        {
+            void * entry = next_queue_pop( queue );
+            next_check( entry == entries[i] );
+            next_free( NULL, entry );
+        }
+
+        next_check( next_queue_pop( queue ) == newest );
+        next_free( NULL, newest );
+
+        next_free( NULL, next_queue_pop( queue ) );
+
+        next_check( queue->num_entries == 0 );
+
+        for ( i = 0; i < QueueSize; ++i )
+        {
+            entries[i] = next_malloc( NULL, EntrySize );
+            next_check( next_queue_push( queue, entries[i] ) == NEXT_OK );
+        }
+    }
+
     // make sure all packets pop off in the correct order
 
     for ( i = 0; i < QueueSize; ++i )
@@ -224,6 +276,94 @@ void test_queue()
     next_queue_destroy( queue );
 }
 
+void test_pool()
+{
+    const int NumBlocks = 16;
+    const int BlockSize = 100;
+
+    next_arena_t * arena = next_arena_create( NULL, next_arena_align( BlockSize ) * NumBlocks + 1024 );
+    next_check( arena );
+
+    // arena allocations are aligned and come out of one block of memory
+
+    void * a = next_arena_alloc( arena, 10 );
+    void * b = next_arena_alloc( arena, 10 );
+    next_check( a && b );
+    next_check( ( uintptr_t(a) % NEXT_ARENA_ALIGNMENT ) == 0 );
+    next_check( ( uintptr_t(b) % NEXT_ARENA_ALIGNMENT ) == 0 );
+    next_check( next_arena_contains( arena, a ) );
+    next_check( next_arena_contains( arena, b ) );
+
+    // when the arena is full, next_arena_malloc falls back to the regular allocator
+
+    next_check( next_arena_alloc( arena, 1024 * 1024 ) == NULL );
+    void * c = next_arena_malloc( arena, NULL, 1024 * 1024 );
+    next_check( c );
+    next_check( !next_arena_contains( arena, c ) );
+    next_arena_free( arena, NULL, c );
+    next_arena_free( arena, NULL, a );
+
+    // pool blocks are handed out from the arena and recycled
+
+    next_pool_t * pool = next_pool_create( NULL, arena, BlockSize, NumBlocks );
+    next_check( pool );
+    next_check( next_arena_contains( arena, pool->data ) );
+
+    void * blocks[NumBlocks];
+    for ( int i = 0; i < NumBlocks; ++i )
+    {
+        blocks[i] = next_pool_alloc( pool, NULL, BlockSize );
+        next_check( next_pool_contains( pool, blocks[i] ) );
+        memset( blocks[i], 0xFF, BlockSize );
+    }
+
+    next_check( pool->num_free == 0 );
+    next_check( pool->num_fallback_allocs == 0 );
+
+    // when the pool is empty, or the allocation is too big, it falls back to next_malloc
+
+    void * fallback = next_pool_alloc( pool, NULL, BlockSize );
+    next_check( fallback );
+    next_check( !next_pool_contains( pool, fallback ) );
+    next_check( pool->num_fallback_allocs == 1 );
+    next_pool_free( pool, NULL, fallback );
+
+    void * too_big = next_pool_alloc( pool, NULL, 4096 );
+    next_check( too_big );
+    next_check( !next_pool_contains( pool, too_big ) );
+    next_pool_free( pool, NULL, too_big );
+
+    for ( int i = 0; i < NumBlocks; ++i )
+    {
+        next_pool_free( pool, NULL, blocks[i] );
+    }
+
+    next_check( pool->num_free == NumBlocks );
+    next_check( pool->min_free == 0 );
+
+    // queues give their entries back to the pool
+
+    next_queue_t * queue = next_queue_create( NULL, 4 );
+    queue->pool = pool;
+    for ( int i = 0; i < 8; ++i )
+    {
+        next_queue_push( queue, next_pool_alloc( pool, NULL, BlockSize ) );
+    }
+    next_check( pool->num_free == NumBlocks - 4 );
+    next_queue_destroy( queue );
+    next_check( pool->num_free == NumBlocks );
+
+    // a NULL pool is just next_malloc and next_free
+
+    void * heap = next_pool_alloc( NULL, NULL, BlockSize );
+    next_check( heap );
+    next_pool_free( NULL, NULL, heap );
+
+    next_pool_destroy( pool );
+
+    next_arena_destroy( arena );
+}
+
 using namespace next;
 
 void test_bitpacker()
@@ -285,6 +425,55 @@ void test_bitpacker()
     next_check( reader.GetBitsRemaining() == bytesWritten * 8 - bitsWritten );
 }
 
+void test_bitpacker_bytes()
+{
+    // write byte runs at every alignment within a word, with bitpacked values either side of them
+
+    const int BufferSize = 256;
+
+    uint8_t buffer[BufferSize];
+    uint8_t input[64];
+    uint8_t output[64];
+
+    for ( int i = 0; i < (int) sizeof(input); ++i )
+        input[i] = uint8_t( i * 37 + 11 );
+
+    for ( int head = 0; head < 8; ++head )
+    {
+        for ( int bytes = 0; bytes <= (int) sizeof(input); ++bytes )
+        {
+            memset( buffer, 0xFF, sizeof(buffer) );
+
+            BitWriter writer( buffer, BufferSize );
+            for ( int i = 0; i < head; ++i )
+                writer.WriteBits( uint32_t( i + 1 ), 8 );
+            writer.WriteBits( 5, 3 );
+            writer.WriteAlign();
+            writer.WriteBytes( input, bytes );
+            writer.WriteBits( 0x12345, 19 );
+            writer.WriteBits( 0xFFFFFFFF, 32 );
+            writer.FlushBits();
+
+            const int bitsWritten = head * 8 + 8 + bytes * 8 + 19 + 32;
+            next_check( writer.GetBitsWritten() == bitsWritten );
+
+            const int bytesWritten = writer.GetBytesWritten();
+
+            BitReader reader( buffer, bytesWritten );
+            for ( int i = 0; i < head; ++i )
+                next_check( reader.ReadBits( 8 ) == uint32_t( i + 1 ) );
+            next_check( reader.ReadBits( 3 ) == 5 );
+            next_check( reader.ReadAlign() );
+            memset( output, 0, sizeof(output) );
+            reader.ReadBytes( output, bytes );
+            next_check( memcmp( input, output, bytes ) == 0 );
+            next_check( reader.ReadBits( 19 ) == 0x12345 );
+            next_check( reader.ReadBits( 32 ) == 0xFFFFFFFF );
+            next_check( reader.GetBitsRead() == bitsWritten );
+        }
+    }
+}
+
 const int MaxItems = 11;
 
 struct TestData
@@ -429,6 +618,32 @@ void test_stream()
     next_check( readObject == writeObject );
 }
 
+void test_measure_stream()
+{
+    const int BufferSize = 1024;
+
+    uint8_t buffer[BufferSize];
+
+    TestContext context;
+    context.min = -10;
+    context.max = +10;
+
+    TestObject object;
+    object.Init();
+
+    MeasureStream measureStream;
+    measureStream.SetContext( &context );
+    next_check( object.Serialize( measureStream ) );
+
+    WriteStream writeStream( buffer, BufferSize );
+    writeStream.SetContext( &context );
+    next_check( object.Serialize( writeStream ) );
+    writeStream.Flush();
+
+    next_check( measureStream.GetBitsProcessed() == writeStream.GetBitsProcessed() );
+    next_check( measureStream.GetBytesProcessed() == writeStream.GetBytesProcessed() );
+}
+
 void test_bits_required()
 {
     next_check( bits_required( 0, 0 ) == 0 );
@@ -443,6 +658,15 @@ void test_bits_required()
     next_check( bits_required( 0, 255 ) == 8 );
     next_check( bits_required( 0, 65535 ) == 16 );
     next_check( bits_required( 0, 4294967295U ) == 32 );
+    next_check( bits_required( 100, 100 ) == 0 );
+    next_check( bits_required( 100, 101 ) == 1 );
+    next_check( bits_required( uint32_t(-10), 10 ) == 5 );
+
+    for ( int i = 0; i < 32; ++i )
+    {
+        next_check( bits_required( 0, 1U << i ) == i + 1 );
+        next_check( bits_required( 0, ( 1U << i ) - 1 ) == i );
+    }
 }
 
 void test_address()
@@ -1032,6 +1256,68 @@ void test_crypto_sign_detached()
     next_check( next_crypto_sign_final_verify( &state, signature, public_key ) == 0 );
 }
 
+void test_crypto_sign_batch()
+{
+    unsigned char public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+    unsigned char private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+    next_crypto_sign_keypair( public_key, private_key );
+
+    static unsigned char messages[NEXT_CRYPTO_SIGN_BATCH_MAX][256];
+    static unsigned char signatures[NEXT_CRYPTO_SIGN_BATCH_MAX][NEXT_CRYPTO_SIGN_BYTES];
+    static next_crypto_sign_state_t states[NEXT_CRYPTO_SIGN_BATCH_MAX];
+    const unsigned char * signature_pointers[NEXT_CRYPTO_SIGN_BATCH_MAX];
+
+    for ( int i = 0; i < NEXT_CRYPTO_SIGN_BATCH_MAX; ++i )
+    {
+        next_crypto_random_bytes( messages[i], sizeof(messages[i]) );
+        next_crypto_sign_state_t state;
+        next_crypto_sign_init( &state );
+        next_crypto_sign_update( &state, messages[i], i + 1 );
+        next_crypto_sign_final_create( &state, signatures[i], NULL, private_key );
+        signature_pointers[i] = signatures[i];
+    }
+
+    for ( int count = 1; count <= NEXT_CRYPTO_SIGN_BATCH_MAX; ++count )
+    {
+        for ( int i = 0; i < count; ++i )
+        {
+            next_crypto_sign_init( &states[i] );
+            next_crypto_sign_update( &states[i], messages[i], i + 1 );
+        }
+        next_check( next_crypto_sign_final_verify_batch( states, signature_pointers, count, public_key ) == 0 );
+    }
+
+    // one bad message or signature fails the whole batch
+
+    for ( int bad = 0; bad < NEXT_CRYPTO_SIGN_BATCH_MAX; ++bad )
+    {
+        for ( int i = 0; i < NEXT_CRYPTO_SIGN_BATCH_MAX; ++i )
+        {
+            next_crypto_sign_init( &states[i] );
+            next_crypto_sign_update( &states[i], messages[i], i + 1 );
+        }
+        messages[bad][0] ^= 1;
+        next_crypto_sign_init( &states[bad] );
+        next_crypto_sign_update( &states[bad], messages[bad], bad + 1 );
+        next_check( next_crypto_sign_final_verify_batch( states, signature_pointers, NEXT_CRYPTO_SIGN_BATCH_MAX, public_key ) != 0 );
+        messages[bad][0] ^= 1;
+
+        for ( int i = 0; i < NEXT_CRYPTO_SIGN_BATCH_MAX; ++i )
+        {
+            next_crypto_sign_init( &states[i] );
+            next_crypto_sign_update( &states[i], messages[i], i + 1 );
+        }
+        signatures[bad][40] ^= 1;
+        next_check( next_crypto_sign_final_verify_batch( states, signature_pointers, NEXT_CRYPTO_SIGN_BATCH_MAX, public_key ) != 0 );
+        signatures[bad][40] ^= 1;
+    }
+
+    // the batch size is limited
+
+    next_check( next_crypto_sign_final_verify_batch( states, signature_pointers, 0, public_key ) != 0 );
+    next_check( next_crypto_sign_final_verify_batch( states, signature_pointers, NEXT_CRYPTO_SIGN_BATCH_MAX + 1, public_key ) != 0 );
+}
+
 void test_crypto_key_exchange()
 {
     uint8_t client_public_key[NEXT_CRYPTO_KX_PUBLICKEYBYTES];
@@ -1201,6 +1487,64 @@ void test_platform_socket()
         next_platform_socket_destroy( socket );
     }
 
+    // receive timestamp (ipv4)
+    {
+        next_address_t bind_address;
+        next_address_t local_address;
+        next_address_parse( &bind_address, "0.0.0.0" );
+        next_address_parse( &local_address, "127.0.0.1" );
+        next_platform_socket_t * socket = next_platform_socket_create( NULL, &bind_address, NEXT_PLATFORM_SOCKET_BLOCKING, -1.0f, 64*1024, 64*1024 );
+        local_address.port = bind_address.port;
+        next_check( socket );
+        uint8_t packet[256];
+        memset( packet, 0, sizeof(packet) );
+        const double send_time = next_platform_time();
+        next_platform_socket_send_packet( socket, &local_address, packet, sizeof(packet) );
+        next_platform_sleep( 0.05 );
+        next_address_t from;
+        double receive_time = -1.0;
+        const int packet_bytes = next_platform_socket_receive_packet_with_timestamp( socket, &from, packet, sizeof(packet), &receive_time );
+        const double read_time = next_platform_time();
+        next_check( packet_bytes == sizeof(packet) );
+        next_check( next_address_equal( &from, &local_address ) );
+        next_check( receive_time >= 0.0 );
+        next_check( receive_time <= read_time );
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+        // the kernel stamps the packet on arrival, not when it is read after the sleep
+        next_check( receive_time >= send_time - 0.01 );
+        next_check( read_time - receive_time >= 0.025 );
+#else // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+        (void) send_time;
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+        next_platform_socket_destroy( socket );
+    }
+
+    // blocking socket with busy poll (ipv4)
+    {
+        next_address_t bind_address;
+        next_address_t local_address;
+        next_address_parse( &bind_address, "0.0.0.0" );
+        next_address_parse( &local_address, "127.0.0.1" );
+        next_platform_socket_t * socket = next_platform_socket_create( NULL, &bind_address, NEXT_PLATFORM_SOCKET_BLOCKING, 0.01f, 64*1024, 64*1024 );
+        local_address.port = bind_address.port;
+        next_check( socket );
+        const int result = next_platform_socket_busy_poll( socket, 1000 );
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+        next_check( result == NEXT_OK );
+#else // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+        (void) result;
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+        uint8_t packet[256];
+        memset( packet, 0, sizeof(packet) );
+        next_platform_socket_send_packet( socket, &local_address, packet, sizeof(packet) );
+        next_address_t from;
+        next_check( next_platform_socket_receive_packet( socket, &from, packet, sizeof(packet) ) == sizeof(packet) );
+        next_check( next_address_equal( &from, &local_address ) );
+        // once idle it backs off to a blocking read, which times out
+        next_check( next_platform_socket_receive_packet( socket, &from, packet, sizeof(packet) ) == 0 );
+        next_platform_socket_destroy( socket );
+    }
+
 #if NEXT_PLATFORM_HAS_IPV6
 
     // non-blocking socket (ipv6)
@@ -1264,115 +1608,615 @@ void test_platform_socket()
 #endif // #if NEXT_PLATFORM_HAS_IPV6
 }
 
-static bool threads_work = false;
-
-static void test_thread_function(void*)
-{
-    threads_work = true;
-}
-
-void test_platform_thread()
-{
-    next_platform_thread_t * thread = next_platform_thread_create( NULL, test_thread_function, NULL );
-    next_check( thread );
-    next_platform_thread_join( thread );
-    next_platform_thread_destroy( thread );
-    next_check( threads_work );
-}
-
-void test_platform_mutex()
+void test_platform_socket_io_uring()
 {
-    next_platform_mutex_t mutex;
-    int result = next_platform_mutex_create( &mutex );
-    next_check( result == NEXT_OK );
-    next_platform_mutex_acquire( &mutex );
-    next_platform_mutex_release( &mutex );
+    for ( int socket_type = NEXT_PLATFORM_SOCKET_NON_BLOCKING; socket_type <= NEXT_PLATFORM_SOCKET_BLOCKING; ++socket_type )
     {
-        next_platform_mutex_guard( &mutex );
-        // ...
-    }
-    next_platform_mutex_destroy( &mutex );
-}
+        next_address_t bind_address;
+        next_address_t local_address;
+        next_address_parse( &bind_address, "0.0.0.0" );
+        next_address_parse( &local_address, "127.0.0.1" );
+        next_platform_socket_t * socket = next_platform_socket_create( NULL, &bind_address, socket_type, 0.1f, 1024*1024, 1024*1024 );
+        local_address.port = bind_address.port;
+        next_check( socket );
 
-static int num_client_packets_received = 0;
+        if ( next_platform_socket_io_uring( socket ) != NEXT_OK )
+        {
+            // io_uring isn't available on this platform or kernel. the socket keeps working with regular socket calls
+            next_platform_socket_destroy( socket );
+            return;
+        }
 
-static void test_client_packet_received_callback( next_client_t * client, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes )
-{
-    (void) client;
-    (void) context;
-    (void) from;
-    (void) packet_data;
-    (void) packet_bytes;
-    num_client_packets_received++;
-}
+        // more packets than there are receive buffers or send slots, sent in batches and one at a time
 
-void test_client_ipv4()
-{
-    next_client_t * client = next_client_create( NULL, "0.0.0.0:0", test_client_packet_received_callback );
-    next_check( client );
-    next_check( next_client_port( client ) != 0 );
-    next_client_open_session( client, "127.0.0.1:12345" );
-    uint8_t packet[256];
-    memset( packet, 0, sizeof(packet) );
-    next_client_send_packet( client, packet, sizeof(packet) );
-    next_client_update( client );
-    next_client_close_session( client );
-    next_client_destroy( client );
-}
+        const int num_packets = 2000;
 
-#if NEXT_PLATFORM_CAN_RUN_SERVER
+        int num_received = 0;
+        int next_sequence = 0;
 
-static int num_server_packets_received = 0;
+        uint8_t packet[NEXT_MAX_PACKET_BYTES];
 
-static void test_server_packet_received_callback(next_server_t* server, void* context, const next_address_t* from, const uint8_t* packet_data, int packet_bytes)
-{
-    (void)server; (void)context;
-    next_server_send_packet(server, from, packet_data, packet_bytes);
-    num_server_packets_received++;
-}
+        while ( next_sequence < num_packets || num_received < num_packets )
+        {
+            const bool batch = ( next_sequence / 100 ) % 2 == 0;
 
-void test_server_ipv4()
-{
-    next_server_t * server = next_server_create( NULL, "127.0.0.1:0", "0.0.0.0:0", "local", test_server_packet_received_callback );
-    next_check( server );
-    next_check( next_server_port( server ) != 0 );
-    next_address_t address;
-    next_address_parse( &address, "127.0.0.1" );
-    address.port = next_server_port( server );;
-    uint8_t packet[256];
-    memset( packet, 0, sizeof(packet) );
-    next_server_send_packet( server, &address, packet, sizeof(packet) );
-    next_server_update( server );
-    next_server_flush( server );
-    next_server_destroy( server );
-}
+            if ( batch )
+            {
+                next_platform_socket_send_batch_begin( socket );
+            }
 
-#endif // #if NEXT_PLATFORM_CAN_RUN_SERVER
+            for ( int i = 0; i < 50 && next_sequence < num_packets; ++i )
+            {
+                const int packet_bytes = 4 + ( next_sequence % ( NEXT_MAX_PACKET_BYTES - 4 ) );
+                memset( packet, uint8_t( next_sequence ), packet_bytes );
+                memcpy( packet, &next_sequence, 4 );
+                next_platform_socket_send_packet( socket, &local_address, packet, packet_bytes );
+                next_sequence++;
+            }
 
-void test_upgrade_token()
-{
-    NextUpgradeToken in, out;
+            if ( batch )
+            {
+                next_platform_socket_send_batch_end( socket );
+            }
 
-    next_crypto_random_bytes( (uint8_t*) &in.session_id, 8 );
-    next_crypto_random_bytes( (uint8_t*) &in.expire_timestamp, 8 );
-    next_address_parse( &in.client_address, "127.0.0.1:40000" );
-    next_address_parse( &in.server_address, "127.0.0.1:50000" );
+            while ( true )
+            {
+                next_address_t from;
+                double receive_time = -1.0;
+                const int packet_bytes = next_platform_socket_receive_packet_with_timestamp( socket, &from, packet, sizeof(packet), &receive_time );
+                if ( packet_bytes == 0 )
+                    break;
+
+                int sequence = 0;
+                memcpy( &sequence, packet, 4 );
+                next_check( sequence == num_received );
+                next_check( packet_bytes == 4 + ( sequence % ( NEXT_MAX_PACKET_BYTES - 4 ) ) );
+                next_check( packet_bytes == 4 || packet[packet_bytes-1] == uint8_t( sequence ) );
+                next_check( next_address_equal( &from, &local_address ) );
+                next_check( receive_time >= 0.0 );
+                next_check( receive_time <= next_platform_time() );
+                num_received++;
+
+                if ( num_received == next_sequence )
+                    break;
+            }
+        }
 
-    unsigned char private_key[NEXT_CRYPTO_SECRETBOX_KEYBYTES];
-    next_crypto_secretbox_keygen( private_key );
+        // nothing left to receive. a blocking socket times out
 
-    uint8_t buffer[NEXT_UPGRADE_TOKEN_BYTES];
+        next_address_t from;
+        const double start_time = next_platform_time();
+        next_check( next_platform_socket_receive_packet( socket, &from, packet, sizeof(packet) ) == 0 );
+        if ( socket_type == NEXT_PLATFORM_SOCKET_BLOCKING )
+        {
+            next_check( next_platform_time() - start_time >= 0.05 );
+        }
 
-    in.Write( buffer, private_key );
+        // destroy with sends in flight and the receive still posted. destroy cancels and waits for them, well within its timeout
 
-    next_check( out.Read( buffer, private_key ) == true );
+        next_platform_socket_send_batch_begin( socket );
+        for ( int i = 0; i < 100; ++i )
+        {
+            memset( packet, uint8_t( i ), 100 );
+            next_platform_socket_send_packet( socket, &local_address, packet, 100 );
+        }
+        next_platform_socket_send_batch_end( socket );
 
-    next_check( memcmp( &in, &out, sizeof(NextUpgradeToken) ) == 0 );
+        const double destroy_start_time = next_platform_time();
+        next_platform_socket_destroy( socket );
+        next_check( next_platform_time() - destroy_start_time < NEXT_IO_URING_DESTROY_TIMEOUT );
+    }
 }
 
-void test_header()
+void test_platform_socket_xdp()
 {
-    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+    // generic mode xdp on the loopback interface. this needs CAP_NET_ADMIN and CAP_BPF, so skip it when they aren't available.
+    // packets sent through the socket are received through xdp. sends to loopback addresses always go through the socket
+
+    next_address_t bind_address;
+    next_address_t local_address;
+    next_address_parse( &bind_address, "0.0.0.0" );
+    next_address_parse( &local_address, "127.0.0.1" );
+    next_platform_socket_t * socket = next_platform_socket_create( NULL, &bind_address, NEXT_PLATFORM_SOCKET_NON_BLOCKING, 0.0f, 64*1024, 64*1024 );
+    local_address.port = bind_address.port;
+    next_check( socket );
+
+    next_xdp_t * xdp = next_xdp_create( NULL, "lo", 0, bind_address.port );
+    if ( !xdp )
+    {
+        next_platform_socket_destroy( socket );
+        return;
+    }
+
+    uint8_t packet[NEXT_MAX_PACKET_BYTES];
+
+    for ( int i = 0; i < 100; ++i )
+    {
+        const int packet_bytes = 1 + ( i * 13 ) % NEXT_MAX_PACKET_BYTES;
+        memset( packet, uint8_t( i ), packet_bytes );
+
+        next_check( !next_xdp_send( xdp, &local_address, packet, packet_bytes ) );
+
+        next_platform_socket_send_packet( socket, &local_address, packet, packet_bytes );
+
+        next_address_t from;
+        int received_bytes = 0;
+        const double start_time = next_platform_time();
+        while ( received_bytes == 0 && next_platform_time() - start_time < 1.0 )
+        {
+            received_bytes = next_xdp_receive( xdp, &from, packet, sizeof(packet) );
+        }
+
+        next_check( received_bytes == packet_bytes );
+        next_check( packet[0] == uint8_t( i ) && packet[packet_bytes-1] == uint8_t( i ) );
+        next_check( next_address_equal( &from, &local_address ) );
+
+        // it never reached the socket
+
+        next_check( next_platform_socket_receive_packet( socket, &from, packet, sizeof(packet) ) == 0 );
+    }
+
+    // destroying the xdp detaches the program from the interface, so packets go to the socket again
+
+    next_xdp_destroy( xdp );
+
+    memset( packet, 0xFF, 100 );
+    next_platform_socket_send_packet( socket, &local_address, packet, 100 );
+
+    next_address_t from;
+    int received_bytes = 0;
+    const double start_time = next_platform_time();
+    while ( received_bytes == 0 && next_platform_time() - start_time < 1.0 )
+    {
+        received_bytes = next_platform_socket_receive_packet( socket, &from, packet, sizeof(packet) );
+    }
+    next_check( received_bytes == 100 );
+
+    next_platform_socket_destroy( socket );
+
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+}
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+static void test_xdp_veth_cleanup()
+{
+    // deleting the namespace deletes the veth end inside it, which deletes the pair
+
+    if ( system( "ip netns del next_xdp_test > /dev/null 2>&1" ) != 0 ) {}
+    if ( system( "ip link del next_xdp0 > /dev/null 2>&1" ) != 0 ) {}
+}
+
+static next_platform_socket_t * test_xdp_veth_peer_socket( next_address_t * peer_address )
+{
+    // switch this thread into the namespace just long enough to create the socket. the socket stays in the namespace
+
+    const int original_namespace = open( "/proc/self/ns/net", O_RDONLY );
+    const int test_namespace = open( "/var/run/netns/next_xdp_test", O_RDONLY );
+
+    next_platform_socket_t * socket = NULL;
+
+    if ( original_namespace >= 0 && test_namespace >= 0 && setns( test_namespace, CLONE_NEWNET ) == 0 )
+    {
+        socket = next_platform_socket_create( NULL, peer_address, NEXT_PLATFORM_SOCKET_NON_BLOCKING, 0.0f, 64*1024, 64*1024 );
+        next_check( setns( original_namespace, CLONE_NEWNET ) == 0 );
+    }
+
+    if ( original_namespace >= 0 )
+        close( original_namespace );
+
+    if ( test_namespace >= 0 )
+        close( test_namespace );
+
+    return socket;
+}
+
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+void test_platform_socket_xdp_veth()
+{
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+    // xdp on one end of a veth pair, with a regular socket on the other end in its own network namespace. this covers
+    // the tx frame builder, which the loopback test can't reach. it needs CAP_NET_ADMIN and the ip tool, so skip without them
+
+    test_xdp_veth_cleanup();
+
+    if ( system( "ip netns add next_xdp_test > /dev/null 2>&1 && "
+                 "ip link add next_xdp0 type veth peer name next_xdp1 > /dev/null 2>&1 && "
+                 "ip link set next_xdp1 netns next_xdp_test && "
+                 "ip addr add 10.254.254.1/24 dev next_xdp0 && "
+                 "ip link set next_xdp0 up && "
+                 "ip netns exec next_xdp_test ip addr add 10.254.254.2/24 dev next_xdp1 && "
+                 "ip netns exec next_xdp_test ip link set next_xdp1 up" ) != 0 )
+    {
+        test_xdp_veth_cleanup();
+        return;
+    }
+
+    next_address_t peer_address;
+    next_address_parse( &peer_address, "10.254.254.2" );
+    next_platform_socket_t * peer_socket = test_xdp_veth_peer_socket( &peer_address );
+    if ( !peer_socket )
+    {
+        test_xdp_veth_cleanup();
+        return;
+    }
+
+    next_address_t bind_address;
+    next_address_t local_address;
+    next_address_parse( &bind_address, "10.254.254.1" );
+    next_address_parse( &local_address, "10.254.254.1" );
+    next_platform_socket_t * socket = next_platform_socket_create( NULL, &bind_address, NEXT_PLATFORM_SOCKET_NON_BLOCKING, 0.0f, 64*1024, 64*1024 );
+    local_address.port = bind_address.port;
+    next_check( socket );
+
+    next_xdp_t * xdp = next_xdp_create( NULL, "next_xdp0", 0, bind_address.port );
+    if ( !xdp )
+    {
+        next_platform_socket_destroy( socket );
+        next_platform_socket_destroy( peer_socket );
+        test_xdp_veth_cleanup();
+        return;
+    }
+
+    // we can't send to the peer through xdp until we have received from it through xdp
+
+    uint8_t packet[NEXT_MAX_PACKET_BYTES];
+    memset( packet, 0, 100 );
+    next_check( !next_xdp_send( xdp, &peer_address, packet, 100 ) );
+
+    // the peer sends to us, we receive it through xdp and echo it back through xdp. the peer receives the echo on its socket
+
+    for ( int i = 0; i < 100; ++i )
+    {
+        const int packet_bytes = 1 + ( i * 13 ) % NEXT_MAX_PACKET_BYTES;
+        memset( packet, uint8_t( i ), packet_bytes );
+
+        next_platform_socket_send_packet( peer_socket, &local_address, packet, packet_bytes );
+
+        next_address_t from;
+        int received_bytes = 0;
+        double start_time = next_platform_time();
+        while ( received_bytes == 0 && next_platform_time() - start_time < 1.0 )
+        {
+            received_bytes = next_xdp_receive( xdp, &from, packet, sizeof(packet) );
+        }
+
+        next_check( received_bytes == packet_bytes );
+        next_check( packet[0] == uint8_t( i ) && packet[packet_bytes-1] == uint8_t( i ) );
+        next_check( next_address_equal( &from, &peer_address ) );
+
+        // every other echo goes out in a batch
+
+        const bool batch = ( i % 2 ) == 1;
+
+        if ( batch )
+        {
+            next_xdp_send_batch_begin( xdp );
+        }
+
+        next_check( next_xdp_send( xdp, &from, packet, received_bytes ) );
+
+        if ( batch )
+        {
+            next_xdp_send_batch_end( xdp );
+        }
+
+        memset( packet, 0, sizeof(packet) );
+
+        received_bytes = 0;
+        start_time = next_platform_time();
+        while ( received_bytes == 0 && next_platform_time() - start_time < 1.0 )
+        {
+            received_bytes = next_platform_socket_receive_packet( peer_socket, &from, packet, sizeof(packet) );
+        }
+
+        next_check( received_bytes == packet_bytes );
+        next_check( packet[0] == uint8_t( i ) && packet[packet_bytes-1] == uint8_t( i ) );
+        next_check( next_address_equal( &from, &local_address ) );
+    }
+
+    // more sends than there are tx frames, so completed frames must be reclaimed and reused
+
+    int num_sent = 0;
+    int num_received = 0;
+    const double start_time = next_platform_time();
+    while ( num_received < NEXT_XDP_FRAMES && next_platform_time() - start_time < 5.0 )
+    {
+        if ( num_sent < NEXT_XDP_FRAMES && next_xdp_send( xdp, &peer_address, packet, 100 ) )
+        {
+            num_sent++;
+        }
+
+        next_address_t from;
+        while ( next_platform_socket_receive_packet( peer_socket, &from, packet, sizeof(packet) ) == 100 )
+        {
+            num_received++;
+        }
+    }
+    next_check( num_sent == NEXT_XDP_FRAMES );
+    next_check( num_received > NEXT_XDP_FRAMES / 2 );
+
+    next_xdp_destroy( xdp );
+    next_platform_socket_destroy( socket );
+    next_platform_socket_destroy( peer_socket );
+
+    test_xdp_veth_cleanup();
+
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+}
+
+static bool threads_work = false;
+
+static void test_thread_function(void*)
+{
+    threads_work = true;
+}
+
+static std::atomic<bool> affinity_thread_quit;
+
+static void test_affinity_thread_function(void*)
+{
+    while ( !affinity_thread_quit.load() )
+    {
+        next_platform_sleep( 0.001 );
+    }
+}
+
+void test_platform_thread()
+{
+    {
+        next_platform_thread_t * thread = next_platform_thread_create( NULL, test_thread_function, NULL );
+        next_check( thread );
+        next_platform_thread_join( thread );
+        next_platform_thread_destroy( thread );
+        next_check( threads_work );
+    }
+
+    // thread affinity
+    {
+        affinity_thread_quit = false;
+        next_platform_thread_t * thread = next_platform_thread_create( NULL, test_affinity_thread_function, NULL );
+        next_check( thread );
+        next_check( next_platform_thread_affinity( thread, -1 ) == NEXT_ERROR );
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+        next_check( next_platform_thread_affinity( thread, 0 ) == NEXT_OK );
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+        affinity_thread_quit = true;
+        next_platform_thread_join( thread );
+        next_platform_thread_destroy( thread );
+    }
+}
+
+void test_platform_mutex()
+{
+    next_platform_mutex_t mutex;
+    int result = next_platform_mutex_create( &mutex );
+    next_check( result == NEXT_OK );
+    next_platform_mutex_acquire( &mutex );
+    next_platform_mutex_release( &mutex );
+    {
+        next_platform_mutex_guard( &mutex );
+        // ...
+    }
+    next_platform_mutex_destroy( &mutex );
+}
+
+static next_platform_semaphore_t semaphore_thread_semaphore;
+
+static void semaphore_thread_function( void * context )
+{
+    (void) context;
+    next_platform_sleep( 0.01 );
+    next_platform_semaphore_signal( &semaphore_thread_semaphore );
+}
+
+void test_platform_semaphore()
+{
+    next_platform_semaphore_t semaphore;
+    int result = next_platform_semaphore_create( &semaphore );
+    next_check( result == NEXT_OK );
+
+    // timeout with nothing signaled
+
+    const double start_time = next_platform_time();
+    next_check( !next_platform_semaphore_wait( &semaphore, 0.01 ) );
+    next_check( next_platform_time() - start_time >= 0.005 );
+    next_check( !next_platform_semaphore_wait( &semaphore, 0.0 ) );
+
+    // each signal is consumed by exactly one wait
+
+    next_platform_semaphore_signal( &semaphore );
+    next_platform_semaphore_signal( &semaphore );
+    next_check( next_platform_semaphore_wait( &semaphore, 0.0 ) );
+    next_check( next_platform_semaphore_wait( &semaphore, 0.0 ) );
+    next_check( !next_platform_semaphore_wait( &semaphore, 0.0 ) );
+
+    next_platform_semaphore_destroy( &semaphore );
+
+    // a signal from another thread wakes a blocked wait well before the timeout
+
+    result = next_platform_semaphore_create( &semaphore_thread_semaphore );
+    next_check( result == NEXT_OK );
+    next_platform_thread_t * thread = next_platform_thread_create( NULL, semaphore_thread_function, NULL );
+    next_check( thread );
+    const double wait_start_time = next_platform_time();
+    next_check( next_platform_semaphore_wait( &semaphore_thread_semaphore, 10.0 ) );
+    next_check( next_platform_time() - wait_start_time < 5.0 );
+    next_platform_thread_join( thread );
+    next_platform_thread_destroy( thread );
+    next_platform_semaphore_destroy( &semaphore_thread_semaphore );
+}
+
+static int num_client_packets_received = 0;
+
+static void test_client_packet_received_callback( next_client_t * client, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes )
+{
+    (void) client;
+    (void) context;
+    (void) from;
+    (void) packet_data;
+    (void) packet_bytes;
+    num_client_packets_received++;
+}
+
+void test_client_ipv4()
+{
+    next_client_t * client = next_client_create( NULL, "0.0.0.0:0", test_client_packet_received_callback );
+    next_check( client );
+    next_check( next_client_port( client ) != 0 );
+    next_client_open_session( client, "127.0.0.1:12345" );
+    uint8_t packet[256];
+    memset( packet, 0, sizeof(packet) );
+    next_client_send_packet( client, packet, sizeof(packet) );
+    next_client_update( client );
+    next_client_metrics_t metrics;
+    next_client_metrics( client, &metrics );
+    next_check( metrics.latency[NEXT_CLIENT_METRIC_SEND_PACKET].count == 1 );
+    next_check( metrics.latency[NEXT_CLIENT_METRIC_UPDATE].count == 1 );
+    next_client_close_session( client );
+    next_client_destroy( client );
+}
+
+#if NEXT_PLATFORM_CAN_RUN_SERVER
+
+static int num_server_packets_received = 0;
+
+static void test_server_packet_received_callback(next_server_t* server, void* context, const next_address_t* from, const uint8_t* packet_data, int packet_bytes)
+{
+    (void)server; (void)context;
+    next_server_send_packet(server, from, packet_data, packet_bytes);
+    num_server_packets_received++;
+}
+
+void test_server_ipv4()
+{
+    next_server_t * server = next_server_create( NULL, "127.0.0.1:0", "0.0.0.0:0", "local", test_server_packet_received_callback );
+    next_check( server );
+    next_check( next_server_port( server ) != 0 );
+    next_address_t address;
+    next_address_parse( &address, "127.0.0.1" );
+    address.port = next_server_port( server );;
+    uint8_t packet[256];
+    memset( packet, 0, sizeof(packet) );
+    next_server_send_packet( server, &address, packet, sizeof(packet) );
+    next_server_update( server );
+    next_server_metrics_t metrics;
+    next_server_metrics( server, &metrics );
+    next_check( metrics.latency[NEXT_SERVER_METRIC_SEND_PACKET].count >= 1 );
+    next_check( metrics.latency[NEXT_SERVER_METRIC_UPDATE].count == 1 );
+    uint64_t counters[NEXT_SERVER_COUNTER_NUM_COUNTERS];
+    next_server_counters( server, counters );
+    next_check( counters[NEXT_SERVER_COUNTER_PAYLOADS_SENT] >= 1 );
+    next_check( counters[NEXT_SERVER_COUNTER_PACKETS_SENT] >= 1 );
+    next_check( counters[NEXT_SERVER_COUNTER_BYTES_SENT] >= sizeof(packet) );
+    next_check( counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_POPPED] <= counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_PUSHED] );
+    next_check( counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_OVERFLOW] == 0 );
+    next_address_t session_addresses[4];
+    next_server_stats_t session_stats[4];
+    next_check( next_server_session_stats( server, session_addresses, session_stats, 4 ) == 0 );
+    next_server_flush( server );
+    next_server_destroy( server );
+}
+
+#endif // #if NEXT_PLATFORM_CAN_RUN_SERVER
+
+void test_upgrade_token()
+{
+    NextUpgradeToken in, out;
+
+    next_crypto_random_bytes( (uint8_t*) &in.session_id, 8 );
+    next_crypto_random_bytes( (uint8_t*) &in.expire_timestamp, 8 );
+    next_address_parse( &in.client_address, "127.0.0.1:40000" );
+    next_address_parse( &in.server_address, "127.0.0.1:50000" );
+
+    unsigned char private_key[NEXT_CRYPTO_SECRETBOX_KEYBYTES];
+    next_crypto_secretbox_keygen( private_key );
+
+    uint8_t buffer[NEXT_UPGRADE_TOKEN_BYTES];
+
+    in.Write( buffer, private_key );
+
+    next_check( out.Read( buffer, private_key ) == true );
+
+    next_check( memcmp( &in, &out, sizeof(NextUpgradeToken) ) == 0 );
+}
+
+void test_route_token()
+{
+    next_route_token_t in, out;
+    memset( &in, 0, sizeof(in) );
+    memset( &out, 0, sizeof(out) );
+
+    next_crypto_random_bytes( in.private_key, NEXT_SESSION_PRIVATE_KEY_BYTES );
+    next_crypto_random_bytes( (uint8_t*) &in.expire_timestamp, 8 );
+    next_crypto_random_bytes( (uint8_t*) &in.session_id, 8 );
+    in.kbps_up = 256;
+    in.kbps_down = 512;
+    next_crypto_random_bytes( (uint8_t*) &in.next_address, 4 );
+    next_crypto_random_bytes( (uint8_t*) &in.prev_address, 4 );
+    in.next_port = 40001;
+    in.prev_port = 50000;
+    in.session_version = 7;
+    in.next_internal = 1;
+    in.prev_internal = 0;
+
+    uint8_t key[32];
+    next_crypto_random_bytes( key, sizeof(key) );
+
+    uint8_t buffer[NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES];
+
+    uint8_t * p = buffer;
+    next_check( next_write_encrypted_route_token( &p, &in, key ) == NEXT_OK );
+    next_check( p - buffer == NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES );
+
+    p = buffer;
+    next_check( next_read_encrypted_route_token( &p, &out, key ) == NEXT_OK );
+    next_check( p - buffer == NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES );
+
+    next_check( memcmp( &in, &out, sizeof(next_route_token_t) ) == 0 );
+
+    key[0] ^= 1;
+    p = buffer;
+    next_check( next_read_encrypted_route_token( &p, &out, key ) == NEXT_ERROR );
+}
+
+void test_continue_token()
+{
+    next_continue_token_t in, out;
+    memset( &in, 0, sizeof(in) );
+    memset( &out, 0, sizeof(out) );
+
+    next_crypto_random_bytes( (uint8_t*) &in.expire_timestamp, 8 );
+    next_crypto_random_bytes( (uint8_t*) &in.session_id, 8 );
+    in.session_version = 11;
+
+    uint8_t key[32];
+    next_crypto_random_bytes( key, sizeof(key) );
+
+    uint8_t buffer[NEXT_ENCRYPTED_CONTINUE_TOKEN_BYTES];
+
+    uint8_t * p = buffer;
+    next_check( next_write_encrypted_continue_token( &p, &in, key ) == NEXT_OK );
+    next_check( p - buffer == NEXT_ENCRYPTED_CONTINUE_TOKEN_BYTES );
+
+    p = buffer;
+    next_check( next_read_encrypted_continue_token( &p, &out, key ) == NEXT_OK );
+    next_check( p - buffer == NEXT_ENCRYPTED_CONTINUE_TOKEN_BYTES );
+
+    next_check( memcmp( &in, &out, sizeof(next_continue_token_t) ) == 0 );
+
+    key[0] ^= 1;
+    p = buffer;
+    next_check( next_read_encrypted_continue_token( &p, &out, key ) == NEXT_ERROR );
+}
+
+void test_header()
+{
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
     uint64_t iterations = 100;
     for ( uint64_t i = 0; i < iterations; ++i )
     {
@@ -1506,17 +2350,193 @@ void test_advanced_packet_filter()
         next_crypto_random_bytes( magic, 8 );
         next_crypto_random_bytes( from_address, 4 );
         next_crypto_random_bytes( to_address, 4 );
-        int packet_length = 18 + ( i % ( sizeof(output) - 18 ) );
-        for ( int j = 0; j < int(sizeof(output)); ++j )
+        int packet_length = 18 + ( i % ( sizeof(output) - 18 ) );
+        for ( int j = 0; j < int(sizeof(output)); ++j )
+        {
+            output[j] = uint8_t( rand() % 256 );
+        }
+        if ( next_advanced_packet_filter( output, magic, from_address, to_address, packet_length ) )
+        {
+            pass++;
+        }
+    }
+    next_check( pass == 0 );
+}
+
+static uint32_t test_run_bpf( const next_bpf_instruction_t * program, int num_instructions, const uint8_t * packet_data, int packet_bytes )
+{
+    // just enough of a classic bpf interpreter to run the instructions the packet filter generates
+    uint32_t A = 0;
+    uint32_t X = 0;
+    int pc = 0;
+    while ( pc < num_instructions )
+    {
+        const next_bpf_instruction_t & instruction = program[pc++];
+        switch ( instruction.code )
+        {
+            case NEXT_BPF_LD | NEXT_BPF_W | NEXT_BPF_LEN:   A = uint32_t( packet_bytes );                                       break;
+            case NEXT_BPF_LD | NEXT_BPF_B | NEXT_BPF_ABS:
+                if ( int( instruction.k ) >= packet_bytes )
+                    return 0;
+                A = packet_data[instruction.k];
+                break;
+            case NEXT_BPF_ALU | NEXT_BPF_NEG:               A = uint32_t( 0 ) - A;                                              break;
+            case NEXT_BPF_ALU | NEXT_BPF_ADD | NEXT_BPF_K:  A += instruction.k;                                                 break;
+            case NEXT_BPF_ALU | NEXT_BPF_XOR | NEXT_BPF_K:  A ^= instruction.k;                                                 break;
+            case NEXT_BPF_ALU | NEXT_BPF_OR | NEXT_BPF_K:   A |= instruction.k;                                                 break;
+            case NEXT_BPF_MISC | NEXT_BPF_TAX:              X = A;                                                              break;
+            case NEXT_BPF_JMP | NEXT_BPF_JEQ | NEXT_BPF_K:  pc += ( A == instruction.k ) ? instruction.jt : instruction.jf;     break;
+            case NEXT_BPF_JMP | NEXT_BPF_JEQ | NEXT_BPF_X:  pc += ( A == X ) ? instruction.jt : instruction.jf;                 break;
+            case NEXT_BPF_JMP | NEXT_BPF_JGT | NEXT_BPF_K:  pc += ( A > instruction.k ) ? instruction.jt : instruction.jf;      break;
+            case NEXT_BPF_JMP | NEXT_BPF_JGE | NEXT_BPF_K:  pc += ( A >= instruction.k ) ? instruction.jt : instruction.jf;     break;
+            case NEXT_BPF_RET | NEXT_BPF_K:                 return instruction.k;
+            default:
+                next_check( !"unexpected bpf instruction" );
+                return 0;
+        }
+    }
+    next_check( !"bpf program fell off the end" );
+    return 0;
+}
+
+static int test_kernel_packet_filter_corpus( uint8_t * packet_data, int max_packet_bytes, int index )
+{
+    // a mix of garbage, valid packets, valid packets with one byte corrupted, and passthrough packets
+
+    int packet_bytes = ( index % 4 == 0 ) ? ( rand() % 32 ) : ( rand() % max_packet_bytes );
+
+    for ( int i = 0; i < packet_bytes; ++i )
+    {
+        packet_data[i] = uint8_t( rand() % 256 );
+    }
+
+    const int type = index % 5;
+
+    if ( ( type == 1 || type == 2 ) && packet_bytes >= 18 )
+    {
+        uint8_t magic[8];
+        uint8_t from_address[4];
+        uint8_t to_address[4];
+        next_crypto_random_bytes( magic, 8 );
+        next_crypto_random_bytes( from_address, 4 );
+        next_crypto_random_bytes( to_address, 4 );
+        next_generate_pittle( packet_data + 1, from_address, to_address, uint16_t( packet_bytes ) );
+        next_generate_chonkle( packet_data + 3, magic, from_address, to_address, uint16_t( packet_bytes ) );
+        packet_data[0] = uint8_t( 1 + rand() % 255 );
+        if ( type == 2 )
         {
-            output[j] = uint8_t( rand() % 256 );
+            packet_data[1 + rand() % 17] ^= uint8_t( 1 + rand() % 255 );
         }
-        if ( next_advanced_packet_filter( output, magic, from_address, to_address, packet_length ) )
+    }
+    else if ( type == 3 && packet_bytes > 0 )
+    {
+        packet_data[0] = 0;
+    }
+
+    return packet_bytes;
+}
+
+static bool test_kernel_packet_filter_expected( const uint8_t * packet_data, int packet_bytes )
+{
+    if ( packet_bytes <= 0 || packet_bytes > NEXT_MAX_PACKET_BYTES )
+        return false;
+
+    if ( packet_data[0] == 0 )
+        return packet_bytes >= 2;
+
+    return next_basic_packet_filter( packet_data, uint16_t( packet_bytes ) );
+}
+
+void test_kernel_packet_filter()
+{
+    next_bpf_instruction_t program[NEXT_BPF_MAX_INSTRUCTIONS];
+    const int num_instructions = next_basic_packet_filter_bpf( program, NEXT_BPF_MAX_INSTRUCTIONS );
+    next_check( num_instructions > 0 );
+    next_check( next_basic_packet_filter_bpf( program, 8 ) == 0 );
+    next_basic_packet_filter_bpf( program, NEXT_BPF_MAX_INSTRUCTIONS );
+
+    // the bpf program and the basic packet filter must agree across a fuzz corpus
+
+    const int max_packet_bytes = NEXT_MAX_PACKET_BYTES + 64;
+
+    uint8_t buffer[NEXT_BPF_UDP_HEADER_BYTES + max_packet_bytes];
+    memset( buffer, 0, NEXT_BPF_UDP_HEADER_BYTES );
+    uint8_t * packet_data = buffer + NEXT_BPF_UDP_HEADER_BYTES;
+
+    srand( 45 );
+
+    int num_accepted = 0;
+    int num_dropped = 0;
+
+    for ( int i = 0; i < 100000; ++i )
+    {
+        const int packet_bytes = test_kernel_packet_filter_corpus( packet_data, max_packet_bytes, i );
+        const bool expected = test_kernel_packet_filter_expected( packet_data, packet_bytes );
+        const bool accepted = test_run_bpf( program, num_instructions, buffer, NEXT_BPF_UDP_HEADER_BYTES + packet_bytes ) != 0;
+        next_check( accepted == expected );
+        if ( accepted )
+            num_accepted++;
+        else
+            num_dropped++;
+    }
+
+    next_check( num_accepted > 10000 );
+    next_check( num_dropped > 10000 );
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+    // the kernel must agree too. each corpus packet is followed by a marker, so a packet that doesn't arrive before its marker was dropped
+
+    {
+        next_address_t bind_address;
+        next_address_t local_address;
+        next_address_parse( &bind_address, "0.0.0.0" );
+        next_address_parse( &local_address, "127.0.0.1" );
+        next_platform_socket_t * socket = next_platform_socket_create( NULL, &bind_address, NEXT_PLATFORM_SOCKET_BLOCKING, 0.5f, 256*1024, 256*1024 );
+        local_address.port = bind_address.port;
+        next_check( socket );
+        next_check( next_platform_socket_kernel_packet_filter( socket, true ) == NEXT_OK );
+
+        const uint8_t marker[] = { 0, 0xFE, 0xED };
+
+        uint8_t receive_buffer[max_packet_bytes];
+
+        for ( int i = 0; i < 500; ++i )
         {
-            pass++;
+            const int packet_bytes = test_kernel_packet_filter_corpus( packet_data, max_packet_bytes, i );
+            if ( packet_bytes == 0 || ( packet_bytes == sizeof(marker) && memcmp( packet_data, marker, sizeof(marker) ) == 0 ) )
+                continue;
+
+            next_platform_socket_send_packet( socket, &local_address, packet_data, packet_bytes );
+            next_platform_socket_send_packet( socket, &local_address, marker, sizeof(marker) );
+
+            next_address_t from;
+            int receive_bytes = next_platform_socket_receive_packet( socket, &from, receive_buffer, sizeof(receive_buffer) );
+            next_check( receive_bytes > 0 );
+
+            const bool received = !( receive_bytes == sizeof(marker) && memcmp( receive_buffer, marker, sizeof(marker) ) == 0 );
+            next_check( received == test_kernel_packet_filter_expected( packet_data, packet_bytes ) );
+
+            if ( received )
+            {
+                next_check( receive_bytes == packet_bytes );
+                receive_bytes = next_platform_socket_receive_packet( socket, &from, receive_buffer, sizeof(receive_buffer) );
+                next_check( receive_bytes == sizeof(marker) );
+            }
         }
+
+        // with the filter detached everything arrives again
+
+        next_check( next_platform_socket_kernel_packet_filter( socket, false ) == NEXT_OK );
+        const uint8_t garbage[] = { 1, 2, 3 };
+        next_platform_socket_send_packet( socket, &local_address, garbage, sizeof(garbage) );
+        next_address_t from;
+        next_check( next_platform_socket_receive_packet( socket, &from, receive_buffer, sizeof(receive_buffer) ) == sizeof(garbage) );
+
+        next_platform_socket_destroy( socket );
     }
-    next_check( pass == 0 );
+
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
 }
 
 void test_passthrough()
@@ -1666,6 +2686,247 @@ void test_bandwidth_limiter()
     }
 }
 
+void test_payload_coalescer()
+{
+    uint8_t packet_data[NEXT_MTU];
+    for ( int i = 0; i < NEXT_MTU; ++i )
+        packet_data[i] = uint8_t( i );
+
+    static next_payload_coalescer_t coalescer;
+
+    next_payload_coalescer_reset( &coalescer );
+
+    // pack small and large packets until full, then read them back
+
+    int packet_sizes[NEXT_MTU];
+    int num_packets = 0;
+    while ( true )
+    {
+        const int packet_bytes = ( num_packets % 3 == 0 ) ? 200 : 1 + ( num_packets % 127 );
+        if ( !next_payload_coalescer_add_packet( &coalescer, packet_data, packet_bytes, NEXT_MTU ) )
+            break;
+        packet_sizes[num_packets++] = packet_bytes;
+    }
+
+    next_check( num_packets > 1 );
+    next_check( coalescer.num_packets == num_packets );
+    next_check( coalescer.payload_bytes <= NEXT_MTU );
+    next_check( next_payload_coalescer_num_packets( coalescer.payload_data, coalescer.payload_bytes ) == num_packets );
+
+    {
+        int offset = 0;
+        const uint8_t * read_packet_data = NULL;
+        for ( int i = 0; i < num_packets; ++i )
+        {
+            const int read_packet_bytes = next_payload_coalescer_read_packet( coalescer.payload_data, coalescer.payload_bytes, &offset, &read_packet_data );
+            next_check( read_packet_bytes == packet_sizes[i] );
+            next_check( memcmp( read_packet_data, packet_data, size_t(read_packet_bytes) ) == 0 );
+        }
+        next_check( next_payload_coalescer_read_packet( coalescer.payload_data, coalescer.payload_bytes, &offset, &read_packet_data ) == 0 );
+    }
+
+    // the largest packet that fits with its prefix fills the payload to exactly NEXT_MTU, anything larger goes passthrough
+
+    next_check( next_payload_coalescer_packet_fits( NEXT_MTU - 2, NEXT_MTU ) );
+    next_check( !next_payload_coalescer_packet_fits( NEXT_MTU - 1, NEXT_MTU ) );
+    next_check( !next_payload_coalescer_packet_fits( NEXT_MTU, NEXT_MTU ) );
+
+    next_payload_coalescer_reset( &coalescer );
+    next_check( next_payload_coalescer_add_packet( &coalescer, packet_data, NEXT_MTU - 2, NEXT_MTU ) );
+    next_check( coalescer.payload_bytes == NEXT_MTU );
+    next_check( !next_payload_coalescer_add_packet( &coalescer, packet_data, 1, NEXT_MTU ) );
+    next_check( next_payload_coalescer_num_packets( coalescer.payload_data, coalescer.payload_bytes ) == 1 );
+
+    // with fec on, the fec framing comes out of NEXT_MTU too
+
+    next_check( next_payload_coalescer_packet_fits( NEXT_MAX_FEC_PAYLOAD_BYTES - 2, NEXT_MAX_FEC_PAYLOAD_BYTES ) );
+    next_check( !next_payload_coalescer_packet_fits( NEXT_MAX_FEC_PAYLOAD_BYTES - 1, NEXT_MAX_FEC_PAYLOAD_BYTES ) );
+
+    next_payload_coalescer_reset( &coalescer );
+    next_check( next_payload_coalescer_add_packet( &coalescer, packet_data, NEXT_MAX_FEC_PAYLOAD_BYTES - 2, NEXT_MAX_FEC_PAYLOAD_BYTES ) );
+    next_check( coalescer.payload_bytes == NEXT_MAX_FEC_PAYLOAD_BYTES );
+    next_check( !next_payload_coalescer_add_packet( &coalescer, packet_data, 1, NEXT_MAX_FEC_PAYLOAD_BYTES ) );
+
+    // malformed payloads are rejected
+
+    uint8_t payload_data[NEXT_MTU];
+    memset( payload_data, 0, sizeof(payload_data) );
+
+    next_check( next_payload_coalescer_num_packets( payload_data, 0 ) == -1 );
+    next_check( next_payload_coalescer_num_packets( payload_data, 4 ) == -1 );
+
+    payload_data[0] = 10;
+    next_check( next_payload_coalescer_num_packets( payload_data, 10 ) == -1 );
+    next_check( next_payload_coalescer_num_packets( payload_data, 11 ) == 1 );
+
+    payload_data[0] = 0x80;
+    next_check( next_payload_coalescer_num_packets( payload_data, 1 ) == -1 );
+
+    next_check( next_payload_coalescer_num_packets( payload_data, NEXT_MTU + 1 ) == -1 );
+
+    payload_data[0] = 0x80 | ( ( NEXT_MTU + 1 ) >> 8 );
+    payload_data[1] = uint8_t( ( NEXT_MTU + 1 ) & 0xFF );
+    next_check( next_payload_coalescer_num_packets( payload_data, NEXT_MTU ) == -1 );
+
+    for ( int i = 0; i < 1000; ++i )
+    {
+        const int payload_bytes = 1 + rand() % NEXT_MTU;
+        next_crypto_random_bytes( payload_data, payload_bytes );
+        const int count = next_payload_coalescer_num_packets( payload_data, payload_bytes );
+        next_check( count == -1 || count > 0 );
+    }
+}
+
+void test_fec()
+{
+    const int group_size = 4;
+
+    uint8_t payload_data[group_size][NEXT_MAX_FEC_PAYLOAD_BYTES];
+    int payload_bytes[group_size];
+    for ( int i = 0; i < group_size; ++i )
+    {
+        payload_bytes[i] = ( i == 2 ) ? NEXT_MAX_FEC_PAYLOAD_BYTES : 10 + i * 100;
+        next_crypto_random_bytes( payload_data[i], payload_bytes[i] );
+    }
+
+    static next_fec_encoder_t encoder;
+    static next_fec_decoder_t decoder;
+
+    uint8_t packet_data[group_size][NEXT_MTU];
+    int packet_bytes[group_size];
+    uint8_t parity_data[NEXT_MTU];
+    int parity_bytes = 0;
+
+    const uint64_t base_sequence = 1000;
+
+    next_fec_encoder_reset( &encoder );
+    for ( int i = 0; i < group_size; ++i )
+    {
+        packet_bytes[i] = next_fec_encoder_write_packet( &encoder, packet_data[i], payload_data[i], payload_bytes[i] );
+        next_check( packet_bytes[i] == payload_bytes[i] + 1 );
+        const bool full = next_fec_encoder_add_packet( &encoder, base_sequence + i, payload_data[i], payload_bytes[i], group_size );
+        next_check( full == ( i == group_size - 1 ) );
+    }
+    parity_bytes = next_fec_encoder_write_parity( &encoder, parity_data );
+    next_check( parity_bytes == NEXT_MTU );
+
+    // drop each payload in turn, with parity arriving last and first, and recover it
+
+    for ( int missing = 0; missing < group_size; ++missing )
+    {
+        for ( int parity_first = 0; parity_first <= 1; ++parity_first )
+        {
+            next_fec_decoder_reset( &decoder );
+
+            const uint8_t * read_payload = NULL;
+            uint64_t recovered_sequence = 0;
+            int recovered_bytes = 0;
+
+            if ( parity_first )
+            {
+                next_check( next_fec_decoder_add_packet( &decoder, base_sequence + group_size, parity_data, parity_bytes, &read_payload ) == 0 );
+                next_check( next_fec_decoder_recover( &decoder, &recovered_sequence, &read_payload ) == 0 );
+            }
+
+            for ( int i = 0; i < group_size; ++i )
+            {
+                if ( i == missing )
+                    continue;
+                next_check( next_fec_decoder_add_packet( &decoder, base_sequence + i, packet_data[i], packet_bytes[i], &read_payload ) == payload_bytes[i] );
+                next_check( memcmp( read_payload, payload_data[i], size_t(payload_bytes[i]) ) == 0 );
+                const int result = next_fec_decoder_recover( &decoder, &recovered_sequence, &read_payload );
+                next_check( result >= 0 );
+                if ( result > 0 )
+                {
+                    recovered_bytes = result;
+                }
+            }
+
+            if ( !parity_first )
+            {
+                next_check( next_fec_decoder_add_packet( &decoder, base_sequence + group_size, parity_data, parity_bytes, &read_payload ) == 0 );
+                recovered_bytes = next_fec_decoder_recover( &decoder, &recovered_sequence, &read_payload );
+            }
+
+            next_check( recovered_bytes == payload_bytes[missing] );
+            next_check( recovered_sequence == base_sequence + missing );
+            next_check( memcmp( read_payload, payload_data[missing], size_t(recovered_bytes) ) == 0 );
+
+            // the late original is still delivered, but nothing is recovered twice
+
+            next_check( next_fec_decoder_add_packet( &decoder, base_sequence + missing, packet_data[missing], packet_bytes[missing], &read_payload ) == payload_bytes[missing] );
+            next_check( next_fec_decoder_recover( &decoder, &recovered_sequence, &read_payload ) == 0 );
+        }
+    }
+
+    // nothing to recover when two payloads are lost
+
+    {
+        next_fec_decoder_reset( &decoder );
+        const uint8_t * read_payload = NULL;
+        uint64_t recovered_sequence = 0;
+        for ( int i = 2; i < group_size; ++i )
+        {
+            next_check( next_fec_decoder_add_packet( &decoder, base_sequence + i, packet_data[i], packet_bytes[i], &read_payload ) == payload_bytes[i] );
+            next_check( next_fec_decoder_recover( &decoder, &recovered_sequence, &read_payload ) == 0 );
+        }
+        next_check( next_fec_decoder_add_packet( &decoder, base_sequence + group_size, parity_data, parity_bytes, &read_payload ) == 0 );
+        next_check( next_fec_decoder_recover( &decoder, &recovered_sequence, &read_payload ) == 0 );
+    }
+
+    // a gap in the send sequence abandons the group
+
+    next_fec_encoder_reset( &encoder );
+    next_check( !next_fec_encoder_add_packet( &encoder, 10, payload_data[0], payload_bytes[0], group_size ) );
+    next_check( !next_fec_encoder_add_packet( &encoder, 11, payload_data[1], payload_bytes[1], group_size ) );
+    next_check( !next_fec_encoder_add_packet( &encoder, 13, payload_data[2], payload_bytes[2], group_size ) );
+    next_check( encoder.num_packets == 0 );
+    for ( int i = 0; i < group_size - 1; ++i )
+    {
+        next_check( !next_fec_encoder_add_packet( &encoder, 20 + i, payload_data[i], payload_bytes[i], group_size ) );
+    }
+    next_check( next_fec_encoder_add_packet( &encoder, 20 + group_size - 1, payload_data[group_size-1], payload_bytes[group_size-1], group_size ) );
+
+    // malformed packets are rejected
+
+    {
+        next_fec_decoder_reset( &decoder );
+
+        const uint8_t * read_payload = NULL;
+        uint8_t bad_packet[NEXT_MTU];
+        memset( bad_packet, 0, sizeof(bad_packet) );
+
+        next_check( next_fec_decoder_add_packet( &decoder, 100, bad_packet, 0, &read_payload ) == -1 );
+        next_check( next_fec_decoder_add_packet( &decoder, 100, bad_packet, 1, &read_payload ) == -1 );
+
+        bad_packet[0] = NEXT_FEC_MAX_GROUP_SIZE;
+        next_check( next_fec_decoder_add_packet( &decoder, 100, bad_packet, 10, &read_payload ) == -1 );
+
+        bad_packet[0] = 5;
+        next_check( next_fec_decoder_add_packet( &decoder, 2, bad_packet, 10, &read_payload ) == -1 );
+
+        bad_packet[0] = 0;
+        next_check( next_fec_decoder_add_packet( &decoder, 100, bad_packet, NEXT_MAX_FEC_PAYLOAD_BYTES + 2, &read_payload ) == -1 );
+
+        bad_packet[0] = NEXT_FEC_PARITY | 1;
+        next_check( next_fec_decoder_add_packet( &decoder, 100, bad_packet, 10, &read_payload ) == -1 );
+
+        bad_packet[0] = NEXT_FEC_PARITY | ( NEXT_FEC_MAX_GROUP_SIZE + 1 );
+        next_check( next_fec_decoder_add_packet( &decoder, 100, bad_packet, 10, &read_payload ) == -1 );
+
+        for ( int i = 0; i < 10000; ++i )
+        {
+            const int bytes = 1 + rand() % NEXT_MTU;
+            next_crypto_random_bytes( bad_packet, bytes );
+            const int result = next_fec_decoder_add_packet( &decoder, 1000 + uint64_t( rand() % 64 ), bad_packet, bytes, &read_payload );
+            next_check( result >= -1 );
+            uint64_t recovered_sequence = 0;
+            const int recovered = next_fec_decoder_recover( &decoder, &recovered_sequence, &read_payload );
+            next_check( recovered >= -1 && recovered <= NEXT_MAX_FEC_PAYLOAD_BYTES );
+        }
+    }
+}
+
 void test_packet_loss_tracker()
 {
     next_packet_loss_tracker_t tracker;
@@ -1844,6 +3105,108 @@ void test_jitter_tracker()
     next_check( tracker.jitter <= 0.000001 );
 }
 
+void test_adaptive_multipath()
+{
+    next_adaptive_multipath_t multipath;
+    next_adaptive_multipath_reset( &multipath );
+
+    next_check( !multipath.duplicate );
+    next_check( !multipath.prefer_direct );
+
+    next_adaptive_multipath_sample_t sample;
+    memset( &sample, 0, sizeof(sample) );
+    sample.next_route_stats.rtt = 20.0f;
+    sample.direct_route_stats.rtt = 50.0f;
+    sample.payload_packets_expected = 100;
+
+    double t = 0.0;
+
+    // a healthy primary path sends on one path only
+
+    next_check( !next_adaptive_multipath_update( &multipath, t, &sample ) );
+    next_check( !multipath.duplicate );
+    next_check( !multipath.prefer_direct );
+
+    // packet loss on the primary path starts duplication
+
+    t += 1.0;
+    sample.next_route_stats.packet_loss = 5.0f;
+    next_check( next_adaptive_multipath_update( &multipath, t, &sample ) );
+    next_check( multipath.duplicate );
+
+    t += 1.0;
+    next_check( !next_adaptive_multipath_update( &multipath, t, &sample ) );
+    next_check( multipath.duplicate );
+
+    // loss between the exit and enter thresholds keeps duplicating, however long it lasts
+
+    sample.next_route_stats.packet_loss = 0.5f;
+    for ( int i = 0; i < 100; ++i )
+    {
+        t += 1.0;
+        next_adaptive_multipath_update( &multipath, t, &sample );
+        next_check( multipath.duplicate );
+    }
+
+    // a healthy primary path only stops duplication after the hold time
+
+    sample.next_route_stats.packet_loss = 0.0f;
+    const double healthy_time = t + 1.0;
+    while ( t < healthy_time + NEXT_ADAPTIVE_MULTIPATH_HOLD_TIME - 2.0 )
+    {
+        t += 1.0;
+        next_adaptive_multipath_update( &multipath, t, &sample );
+        next_check( multipath.duplicate );
+    }
+
+    t += 5.0;
+    next_adaptive_multipath_update( &multipath, t, &sample );
+    next_check( !multipath.duplicate );
+
+    // jitter on the primary path starts duplication too
+
+    t += 1.0;
+    sample.next_route_stats.jitter = NEXT_ADAPTIVE_MULTIPATH_ENTER_JITTER;
+    next_check( next_adaptive_multipath_update( &multipath, t, &sample ) );
+    sample.next_route_stats.jitter = 0.0f;
+
+    t += NEXT_ADAPTIVE_MULTIPATH_HOLD_TIME + 1.0;
+    next_adaptive_multipath_update( &multipath, t, &sample );
+    next_check( !multipath.duplicate );
+
+    // direct only becomes the primary path when it is clearly faster, and loss on the other path doesn't matter
+
+    t += 1.0;
+    sample.direct_route_stats.rtt = sample.next_route_stats.rtt - NEXT_ADAPTIVE_MULTIPATH_RTT_THRESHOLD * 0.5f;
+    next_adaptive_multipath_update( &multipath, t, &sample );
+    next_check( !multipath.prefer_direct );
+
+    t += 1.0;
+    sample.direct_route_stats.rtt = sample.next_route_stats.rtt - NEXT_ADAPTIVE_MULTIPATH_RTT_THRESHOLD * 2.0f;
+    sample.next_route_stats.packet_loss = 50.0f;
+    next_check( !next_adaptive_multipath_update( &multipath, t, &sample ) );
+    next_check( multipath.prefer_direct );
+    next_check( !multipath.duplicate );
+
+    // sustained payload packet loss starts duplication
+
+    sample.next_route_stats.packet_loss = 0.0f;
+    sample.payload_packets_lost = 10;
+    bool started = false;
+    for ( int i = 0; i < 10 && !started; ++i )
+    {
+        t += 1.0;
+        started = next_adaptive_multipath_update( &multipath, t, &sample );
+    }
+    next_check( started );
+    next_check( multipath.duplicate );
+
+    next_adaptive_multipath_reset( &multipath );
+
+    next_check( !multipath.duplicate );
+    next_check( !multipath.prefer_direct );
+}
+
 extern void * next_default_malloc_function( void * context, size_t bytes );
 
 extern void next_default_free_function( void * context, void * p );
@@ -1856,6 +3219,76 @@ static void context_check_free( void * context, void * p )
     next_default_free_function( context, p );;
 }
 
+void test_latency_histogram()
+{
+    for ( uint64_t value = 0; value < 100000; value++ )
+    {
+        const int index = next_latency_histogram_bucket_index( value );
+        next_check( index >= 0 );
+        next_check( index < NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS );
+        next_check( next_latency_histogram_bucket_lower_bound( index ) <= value );
+        next_check( value < next_latency_histogram_bucket_lower_bound( index ) + next_latency_histogram_bucket_width( index ) );
+    }
+
+    for ( int i = 0; i < 10000; i++ )
+    {
+        const uint64_t value = next_random_uint64() & NEXT_LATENCY_HISTOGRAM_MAX_VALUE;
+        const int index = next_latency_histogram_bucket_index( value );
+        next_check( next_latency_histogram_bucket_lower_bound( index ) <= value );
+        next_check( value < next_latency_histogram_bucket_lower_bound( index ) + next_latency_histogram_bucket_width( index ) );
+    }
+
+    next_check( next_latency_histogram_bucket_index( ~uint64_t(0) ) == NEXT_LATENCY_HISTOGRAM_NUM_BUCKETS - 1 );
+
+    next_latency_histogram_t a;
+    next_latency_histogram_t b;
+    next_latency_histogram_reset( &a );
+    next_latency_histogram_reset( &b );
+
+    const next_latency_histogram_t * histograms[] = { &a, &b };
+
+    next_latency_t summary;
+    next_latency_histogram_summary( histograms, 2, &summary );
+    next_check( summary.count == 0 );
+    next_check( summary.max == 0.0f );
+    next_check( summary.p99 == 0.0f );
+
+    // 1us .. 1000us in a, 10ms in b
+
+    for ( int i = 1; i <= 1000; i++ )
+    {
+        next_latency_histogram_record( &a, i * 0.000001 );
+        next_latency_histogram_record( &b, 0.01 );
+    }
+
+    next_latency_histogram_summary( histograms, 1, &summary );
+    next_check( summary.count == 1000 );
+    next_check( fabs( summary.min - 0.001f ) < 0.0001f );
+    next_check( fabs( summary.max - 1.0f ) < 0.001f );
+    next_check( fabs( summary.mean - 0.5005f ) < 0.001f );
+    next_check( fabs( summary.p50 - 0.5f ) < 0.5f / 16.0f );
+    next_check( fabs( summary.p90 - 0.9f ) < 0.9f / 16.0f );
+    next_check( fabs( summary.p99 - 0.99f ) < 0.99f / 16.0f );
+    next_check( summary.p999 <= summary.max );
+
+    next_latency_histogram_summary( histograms, 2, &summary );
+    next_check( summary.count == 2000 );
+    next_check( fabs( summary.p50 - 1.0f ) < 1.0f / 16.0f );
+    next_check( fabs( summary.p90 - 10.0f ) < 10.0f / 16.0f );
+    next_check( fabs( summary.max - 10.0f ) < 0.01f );
+
+    next_platform_mutex_t mutex;
+    next_check( next_platform_mutex_create( &mutex ) == NEXT_OK );
+    next_latency_histogram_reset( &a );
+    next_latency_histogram_reset( &b );
+    {
+        next_latency_mutex_guard( &mutex, &a, &b );
+    }
+    next_check( a.count == 1 );
+    next_check( b.count == 1 );
+    next_platform_mutex_destroy( &mutex );
+}
+
 void test_free_retains_context()
 {
     void * (*current_malloc)( void * context, size_t bytes ) = next_default_malloc_function;
@@ -1879,7 +3312,7 @@ void test_pending_session_manager()
 {
     const int InitialSize = 32;
 
-    next_pending_session_manager_t * pending_session_manager = next_pending_session_manager_create( NULL, InitialSize );
+    next_pending_session_manager_t * pending_session_manager = next_pending_session_manager_create( NULL, InitialSize, NULL );
 
     next_check( pending_session_manager );
 
@@ -2025,6 +3458,9 @@ void test_proxy_session_manager()
         next_check( entry );
         next_check( entry->session_id == uint64_t(i) + 1000 );
         next_check( next_address_equal( &address, &entry->address ) == 1 );
+        next_check( entry->send_coalescer == NULL );
+        next_check( entry->fec == NULL );
+        next_check( next_proxy_session_manager_enable_features( proxy_session_manager, entry, (i%3) == 1, (i%3) == 2 ) );
         address.port++;
     }
 
@@ -2037,6 +3473,12 @@ void test_proxy_session_manager()
         next_check( entry );
         next_check( entry->session_id == uint64_t(i) + 1000 );
         next_check( next_address_equal( &address, &entry->address ) == 1 );
+        next_check( ( entry->send_coalescer != NULL ) == ( (i%3) == 1 ) );
+        next_check( ( entry->fec != NULL ) == ( (i%3) == 2 ) );
+        if ( entry->send_coalescer )
+        {
+            next_check( entry->send_coalescer->num_packets == 0 );
+        }
         address.port++;
     }
 
@@ -2109,7 +3551,7 @@ void test_session_manager()
 {
     const int InitialSize = 1;
 
-    next_session_manager_t * session_manager = next_session_manager_create( NULL, InitialSize );
+    next_session_manager_t * session_manager = next_session_manager_create( NULL, InitialSize, NULL );
 
     next_check( session_manager );
 
@@ -2136,6 +3578,11 @@ void test_session_manager()
         next_check( next_address_equal( &address, &entry->address ) == 1 );
         next_check( memcmp( entry->ephemeral_private_key, &private_keys[i*NEXT_CRYPTO_SECRETBOX_KEYBYTES], NEXT_CRYPTO_SECRETBOX_KEYBYTES ) == 0 );
         next_check( memcmp( entry->upgrade_token, &upgrade_tokens[i*NEXT_UPGRADE_TOKEN_BYTES], NEXT_UPGRADE_TOKEN_BYTES ) == 0 );
+        next_check( entry->fec_decoder == NULL );
+        if ( (i%3) == 0 )
+        {
+            next_check( next_session_manager_enable_fec( session_manager, entry ) );
+        }
         address.port++;
     }
 
@@ -2148,6 +3595,7 @@ void test_session_manager()
         next_check( entry );
         next_check( entry->session_id == uint64_t(i)+1000 );
         next_check( next_address_equal( &address, &entry->address ) == 1 );
+        next_check( ( entry->fec_decoder != NULL ) == ( (i%3) == 0 ) );
         address.port++;
     }
 
@@ -2186,6 +3634,8 @@ void test_session_manager()
 
     next_session_manager_expand( session_manager );
 
+    next_check( session_manager->num_expansions == 3 );
+
     address.port = 12346;
     for ( int i = 0; i < session_manager->size; ++i )
     {
@@ -2216,11 +3666,59 @@ void test_session_manager()
     next_session_manager_destroy( session_manager );
 }
 
+void test_session_manager_max_sessions()
+{
+    const int MaxSessions = 64;
+
+    next_session_manager_t * session_manager = next_session_manager_create( NULL, MaxSessions, NULL );
+
+    next_check( session_manager );
+
+    next_address_t address;
+    next_address_parse( &address, "127.0.0.1:12345" );
+
+    uint8_t private_key[NEXT_CRYPTO_SECRETBOX_KEYBYTES];
+    uint8_t upgrade_token[NEXT_UPGRADE_TOKEN_BYTES];
+    next_crypto_random_bytes( private_key, sizeof(private_key) );
+    next_crypto_random_bytes( upgrade_token, sizeof(upgrade_token) );
+
+    // fill up to max sessions and make sure entries never move
+
+    next_session_entry_t * entries[MaxSessions];
+
+    for ( int i = 0; i < MaxSessions; ++i )
+    {
+        entries[i] = next_session_manager_add( session_manager, &address, uint64_t(i)+1000, private_key, upgrade_token );
+        next_check( entries[i] );
+        address.port++;
+    }
+
+    next_check( session_manager->num_expansions == 0 );
+    next_check( session_manager->size == MaxSessions );
+
+    address.port = 12345;
+    for ( int i = 0; i < MaxSessions; ++i )
+    {
+        next_check( next_session_manager_find_by_address( session_manager, &address ) == entries[i] );
+        address.port++;
+    }
+
+    // going past max sessions still works, but it expands
+
+    address.port = 12345 + MaxSessions;
+    next_check( next_session_manager_add( session_manager, &address, uint64_t(MaxSessions)+1000, private_key, upgrade_token ) );
+    next_check( session_manager->num_expansions == 1 );
+    next_check( next_session_manager_num_entries( session_manager ) == MaxSessions + 1 );
+
+    next_session_manager_destroy( session_manager );
+}
+
 void test_relay_manager()
 {
     uint64_t relay_ids[NEXT_MAX_CLIENT_RELAYS];
     next_address_t relay_addresses[NEXT_MAX_CLIENT_RELAYS];
     uint8_t relay_ping_tokens[NEXT_MAX_CLIENT_RELAYS * NEXT_PING_TOKEN_BYTES];
+    next_crypto_random_bytes( relay_ping_tokens, sizeof(relay_ping_tokens) );
     uint64_t relay_ping_expire_timestamp = 0x129387193871987LL;
 
     for ( int i = 0; i < NEXT_MAX_CLIENT_RELAYS; ++i )
@@ -2306,6 +3804,92 @@ void test_relay_manager()
     next_relay_manager_destroy( manager );
 }
 
+void test_route_manager()
+{
+    next_route_manager_t * route_manager = next_route_manager_create( NULL );
+    next_check( route_manager );
+
+    uint8_t magic[8];
+    next_crypto_random_bytes( magic, sizeof(magic) );
+
+    next_address_t client_external_address;
+    next_address_parse( &client_external_address, "127.0.0.1:30000" );
+
+    uint8_t client_secret_key[NEXT_SECRET_KEY_BYTES];
+    next_crypto_random_bytes( client_secret_key, sizeof(client_secret_key) );
+
+    uint8_t payload[100];
+    memset( payload, 0, sizeof(payload) );
+
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+    int packet_bytes = 0;
+    next_address_t to;
+
+    // the send sequence counts up from zero and starts over on reset
+
+    next_check( next_route_manager_next_send_sequence( route_manager ) == 0 );
+    next_check( next_route_manager_next_send_sequence( route_manager ) == 1 );
+    next_route_manager_reset( route_manager );
+    next_check( next_route_manager_next_send_sequence( route_manager ) == 0 );
+
+    // no route yet
+
+    next_route_manager_send_route_t send_route;
+    next_route_manager_get_send_route( route_manager, &send_route );
+    next_check( !send_route.current_route );
+    next_check( !next_route_manager_prepare_send_packet( route_manager, &send_route, 0, &to, payload, sizeof(payload), packet_data, &packet_bytes, magic, &client_external_address ) );
+
+    // a route is only published to the send path once it is confirmed
+
+    next_route_token_t route_token;
+    memset( &route_token, 0, sizeof(route_token) );
+    next_crypto_random_bytes( route_token.private_key, NEXT_SESSION_PRIVATE_KEY_BYTES );
+    route_token.expire_timestamp = 1000;
+    route_token.session_id = 0x12345;
+    route_token.session_version = 3;
+    route_token.kbps_up = 256;
+    route_token.kbps_down = 256;
+    next_address_t relay_address;
+    next_address_parse( &relay_address, "127.0.0.1:40001" );
+    route_token.next_address = relay_address.data.ip;
+    route_token.next_port = relay_address.port;
+
+    uint8_t tokens[NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES*2];
+    next_crypto_random_bytes( tokens, sizeof(tokens) );
+    uint8_t * p = tokens;
+    next_check( next_write_encrypted_route_token( &p, &route_token, client_secret_key ) == NEXT_OK );
+
+    next_route_manager_update( route_manager, NEXT_UPDATE_TYPE_ROUTE, 2, tokens, client_secret_key, magic, &client_external_address );
+
+    next_route_manager_get_send_route( route_manager, &send_route );
+    next_check( !send_route.current_route );
+
+    int route_kbps_up = 0;
+    int route_kbps_down = 0;
+    next_route_manager_confirm_pending_route( route_manager, &route_kbps_up, &route_kbps_down );
+    next_check( route_kbps_up == 256 );
+    next_check( route_kbps_down == 256 );
+
+    next_route_manager_get_send_route( route_manager, &send_route );
+    next_check( send_route.current_route );
+    next_check( send_route.session_id == route_token.session_id );
+    next_check( send_route.session_version == route_token.session_version );
+    next_check( next_address_equal( &send_route.next_address, &relay_address ) );
+    next_check( memcmp( send_route.private_key, route_token.private_key, NEXT_CRYPTO_BOX_SECRETKEYBYTES ) == 0 );
+
+    next_check( next_route_manager_prepare_send_packet( route_manager, &send_route, 1, &to, payload, sizeof(payload), packet_data, &packet_bytes, magic, &client_external_address ) );
+    next_check( next_address_equal( &to, &relay_address ) );
+    next_check( packet_bytes > int( sizeof(payload) ) );
+
+    // falling back to direct takes the route away from the send path
+
+    next_route_manager_fallback_to_direct( route_manager, 0 );
+    next_route_manager_get_send_route( route_manager, &send_route );
+    next_check( !send_route.current_route );
+
+    next_route_manager_destroy( route_manager );
+}
+
 void test_direct_packet()
 {
     uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
@@ -2463,8 +4047,12 @@ void test_upgrade_request_packet()
         unsigned char private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
         next_crypto_sign_keypair( public_key, private_key );
 
+        // every fourth request comes from a peer on another protocol version, and must still read so it can be rejected cleanly
+
+        const bool same_protocol = ( i % 4 ) != 3;
+
         static NextUpgradeRequestPacket in, out;
-        in.protocol_version = next_protocol_version();
+        in.protocol_version = same_protocol ? next_protocol_version() : next_protocol_version() + 1;
         in.session_id = 1231234127431LL;
         next_address_parse( &in.client_address, "127.0.0.1:50000" );
         next_address_parse( &in.server_address, "127.0.0.1:12345" );
@@ -2473,6 +4061,8 @@ void test_upgrade_request_packet()
         next_crypto_random_bytes( in.upcoming_magic, 8 );
         next_crypto_random_bytes( in.current_magic, 8 );
         next_crypto_random_bytes( in.previous_magic, 8 );
+        in.payload_coalescing = ( i & 1 ) != 0;
+        in.fec = ( i & 2 ) != 0;
 
         int packet_bytes = 0;
         int result = next_write_packet( NEXT_UPGRADE_REQUEST_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, NULL, NULL, private_key, NULL, magic, from_address, to_address );
@@ -2485,6 +4075,8 @@ void test_upgrade_request_packet()
         const int begin = 18;
         const int end = packet_bytes;
 
+        out = NextUpgradeRequestPacket();
+
         int packet_type = next_read_packet( NEXT_UPGRADE_REQUEST_PACKET, packet_data, begin, end, &out, next_signed_packets, NULL, NULL, public_key, NULL, NULL );
 
         next_check( packet_type == NEXT_UPGRADE_REQUEST_PACKET );
@@ -2498,6 +4090,8 @@ void test_upgrade_request_packet()
         next_check( memcmp( in.upcoming_magic, out.upcoming_magic, 8 ) == 0 );
         next_check( memcmp( in.current_magic, out.current_magic, 8 ) == 0 );
         next_check( memcmp( in.previous_magic, out.previous_magic, 8 ) == 0 );
+        next_check( out.payload_coalescing == ( same_protocol && in.payload_coalescing ) );
+        next_check( out.fec == ( same_protocol && in.fec ) );
     }
 }
 
@@ -2520,6 +4114,8 @@ void test_upgrade_response_packet()
         next_crypto_random_bytes( in.upgrade_token, NEXT_UPGRADE_TOKEN_BYTES );
         in.platform_id = NEXT_PLATFORM_WINDOWS;
         in.connection_type = NEXT_CONNECTION_TYPE_CELLULAR;
+        in.payload_coalescing = ( i & 1 ) != 0;
+        in.fec = ( i & 2 ) != 0;
 
         int packet_bytes = 0;
         int result = next_write_packet( NEXT_UPGRADE_RESPONSE_PACKET, &in, packet_data, &packet_bytes, NULL, NULL, NULL, NULL, NULL, magic, from_address, to_address );
@@ -2541,6 +4137,8 @@ void test_upgrade_response_packet()
         next_check( memcmp( in.upgrade_token, out.upgrade_token, NEXT_UPGRADE_TOKEN_BYTES ) == 0 );
         next_check( in.platform_id == out.platform_id );
         next_check( in.connection_type == out.connection_type );
+        next_check( in.payload_coalescing == out.payload_coalescing );
+        next_check( in.fec == out.fec );
     }
 }
 
@@ -3277,8 +4875,111 @@ void test_route_ack_packet()
         const int end = packet_bytes;
         next_check( next_read_packet( NEXT_ROUTE_ACK_PACKET, packet_data, begin, end, &out, next_signed_packets, next_encrypted_packets, &out_sequence, NULL, private_key, &replay_protection ) == NEXT_ROUTE_ACK_PACKET );
 
-        next_check( in_sequence == out_sequence + 1 );
-        next_check( in.sequence == out.sequence );
+        next_check( in_sequence == out_sequence + 1 );
+        next_check( in.sequence == out.sequence );
+    }
+}
+
+template <typename T> void test_fast_packet_serializer_round_trip( T & in )
+{
+    // IMPORTANT: the fast serializers must be bit-for-bit compatible with the generic streams
+
+    static uint8_t generic_data[NEXT_MAX_PACKET_BYTES];
+    static uint8_t fast_data[NEXT_MAX_PACKET_BYTES];
+    memset( generic_data, 0, sizeof(generic_data) );
+    memset( fast_data, 0, sizeof(fast_data) );
+
+    next::WriteStream write_stream( generic_data, NEXT_MAX_PACKET_BYTES );
+    next_check( in.Serialize( write_stream ) );
+    write_stream.Flush();
+    const int generic_bytes = write_stream.GetBytesProcessed();
+
+    const int fast_bytes = next::FastPacketSerializer<T>::Write( in, fast_data );
+    next_check( fast_bytes > 0 );
+    next_check( fast_bytes <= next::FastPacketSerializer<T>::MaxBytes );
+    next_check( fast_bytes == generic_bytes );
+    next_check( memcmp( generic_data, fast_data, fast_bytes ) == 0 );
+
+    static T out;
+    next_check( next::FastPacketSerializer<T>::Read( out, generic_data, generic_bytes ) );
+    static uint8_t check_data[NEXT_MAX_PACKET_BYTES];
+    next_check( next::FastPacketSerializer<T>::Write( out, check_data ) == fast_bytes );
+    next_check( memcmp( check_data, fast_data, fast_bytes ) == 0 );
+
+    next::ReadStream read_stream( fast_data, fast_bytes );
+    next_check( out.Serialize( read_stream ) );
+    next_check( next::FastPacketSerializer<T>::Write( out, check_data ) == fast_bytes );
+    next_check( memcmp( check_data, fast_data, fast_bytes ) == 0 );
+
+    next_check( !next::FastPacketSerializer<T>::Read( out, fast_data, fast_bytes - 1 ) );
+}
+
+void test_fast_packet_serializers()
+{
+    uint64_t iterations = 100;
+    for ( uint64_t i = 0; i < iterations; ++i )
+    {
+        static NextDirectPingPacket ping;
+        ping.ping_sequence = next_random_uint64();
+        test_fast_packet_serializer_round_trip( ping );
+
+        static NextDirectPongPacket pong;
+        pong.ping_sequence = next_random_uint64();
+        test_fast_packet_serializer_round_trip( pong );
+
+        static NextRouteAckPacket ack;
+        ack.sequence = next_random_uint64();
+        test_fast_packet_serializer_round_trip( ack );
+
+        static NextClientStatsPacket stats;
+        stats.fallback_to_direct = rand() % 2;
+        stats.next = rand() % 2;
+        stats.multipath = rand() % 2;
+        stats.reported = rand() % 2;
+        stats.next_bandwidth_over_limit = rand() % 2;
+        stats.platform_id = rand() % ( NEXT_PLATFORM_MAX + 1 );
+        stats.connection_type = rand() % ( NEXT_CONNECTION_TYPE_MAX + 1 );
+        stats.direct_kbps_up = next_random_float();
+        stats.direct_kbps_down = next_random_float();
+        stats.next_kbps_up = next_random_float();
+        stats.next_kbps_down = next_random_float();
+        stats.direct_rtt = next_random_float();
+        stats.direct_jitter = next_random_float();
+        stats.direct_packet_loss = next_random_float();
+        stats.direct_max_packet_loss_seen = next_random_float();
+        stats.next_rtt = next_random_float();
+        stats.next_jitter = next_random_float();
+        stats.next_packet_loss = next_random_float();
+        stats.max_jitter_seen = next_random_float();
+        stats.num_client_relays = rand() % ( NEXT_MAX_CLIENT_RELAYS + 1 );
+        for ( int j = 0; j < stats.num_client_relays; ++j )
+        {
+            stats.client_relay_ids[j] = next_random_uint64();
+            stats.client_relay_rtt[j] = uint8_t( rand() );
+            stats.client_relay_jitter[j] = uint8_t( rand() );
+            stats.client_relay_packet_loss[j] = next_random_float();
+        }
+        stats.packets_sent_client_to_server = next_random_uint64();
+        stats.packets_lost_server_to_client = next_random_uint64();
+        stats.packets_out_of_order_server_to_client = next_random_uint64();
+        stats.jitter_server_to_client = next_random_float();
+        stats.client_relay_request_id = next_random_uint64();
+        test_fast_packet_serializer_round_trip( stats );
+
+        static NextRouteUpdatePacket update;
+        update.sequence = next_random_uint64();
+        update.update_type = uint8_t( rand() % ( NEXT_UPDATE_TYPE_CONTINUE + 1 ) );
+        update.multipath = rand() % 2;
+        update.num_tokens = 1 + rand() % NEXT_MAX_TOKENS;
+        next_crypto_random_bytes( update.tokens, NEXT_ENCRYPTED_ROUTE_TOKEN_BYTES * NEXT_MAX_TOKENS );
+        update.packets_sent_server_to_client = next_random_uint64();
+        update.packets_lost_client_to_server = next_random_uint64();
+        update.packets_out_of_order_client_to_server = next_random_uint64();
+        update.jitter_client_to_server = next_random_float();
+        next_crypto_random_bytes( update.upcoming_magic, 8 );
+        next_crypto_random_bytes( update.current_magic, 8 );
+        next_crypto_random_bytes( update.previous_magic, 8 );
+        test_fast_packet_serializer_round_trip( update );
     }
 }
 
@@ -4108,138 +5809,633 @@ void test_client_relay_response_packet()
         in.num_client_relays = rand() % ( NEXT_MAX_CLIENT_RELAYS + 1 );
         for ( int i = 0; i < in.num_client_relays; i++ )
         {
-            in.client_relay_ids[i] = next_random_uint64();
-            next_address_parse( &in.client_relay_addresses[i], "127.0.0.1:50000" );
-            next_crypto_random_bytes( in.client_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES );
+            in.client_relay_ids[i] = next_random_uint64();
+            next_address_parse( &in.client_relay_addresses[i], "127.0.0.1:50000" );
+            next_crypto_random_bytes( in.client_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES );
+        }
+        in.expire_timestamp = next_random_uint64();
+
+        int packet_bytes = 0;
+        next_check( next_write_backend_packet( NEXT_BACKEND_CLIENT_RELAY_RESPONSE_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
+
+        const uint8_t packet_id = packet_data[0];
+        next_check( packet_id == NEXT_BACKEND_CLIENT_RELAY_RESPONSE_PACKET );
+
+        next_check( next_basic_packet_filter( packet_data, packet_bytes ) );
+        next_check( next_advanced_packet_filter( packet_data, magic, from_address, to_address, packet_bytes ) );
+
+        const int begin = 18;
+        const int end = packet_bytes;
+
+        next_check( next_read_backend_packet( packet_id, packet_data, begin, end, &out, next_signed_packets, public_key ) == NEXT_BACKEND_CLIENT_RELAY_RESPONSE_PACKET );
+
+        next_check( next_address_equal( &in.client_address, &out.client_address ) );
+        next_check( in.request_id == out.request_id );
+        next_check( in.latitude == out.latitude );
+        next_check( in.longitude == out.longitude );
+        next_check( in.num_client_relays == out.num_client_relays );
+        for ( int i = 0; i < in.num_client_relays; i++ )
+        {
+            next_check( in.client_relay_ids[i] == out.client_relay_ids[i] );
+            next_check( next_address_equal( &in.client_relay_addresses[i], &out.client_relay_addresses[i] ) );
+            next_check( memcmp( in.client_relay_ping_tokens[i], out.client_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES ) == 0 );
+        }
+        next_check( in.expire_timestamp == out.expire_timestamp );
+    }
+}
+
+void test_server_relay_request_packet()
+{
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+    uint64_t iterations = 100;
+    for ( uint64_t i = 0; i < iterations; ++i )
+    {
+        unsigned char public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+        unsigned char private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+        next_crypto_sign_keypair( public_key, private_key );
+
+        uint8_t magic[8];
+        uint8_t from_address[4];
+        uint8_t to_address[4];
+        next_crypto_random_bytes( magic, 8 );
+        next_crypto_random_bytes( from_address, 4 );
+        next_crypto_random_bytes( to_address, 4 );
+
+        static NextBackendServerRelayRequestPacket in, out;
+        in.buyer_id = next_random_uint64();
+        in.datacenter_id = next_random_uint64();
+        in.request_id = next_random_uint64();
+
+        int packet_bytes = 0;
+        next_check( next_write_backend_packet( NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
+
+        const uint8_t packet_id = packet_data[0];
+        next_check( packet_id == NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET );
+
+        next_check( next_basic_packet_filter( packet_data, packet_bytes ) );
+        next_check( next_advanced_packet_filter( packet_data, magic, from_address, to_address, packet_bytes ) );
+
+        const int begin = 18;
+        const int end = packet_bytes;
+
+        next_check( next_read_backend_packet( packet_id, packet_data, begin, end, &out, next_signed_packets, public_key ) == NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET );
+
+        next_check( in.version_major == out.version_major );
+        next_check( in.version_minor == out.version_minor );
+        next_check( in.version_patch == out.version_patch );
+        next_check( in.buyer_id == out.buyer_id );
+        next_check( in.datacenter_id == out.datacenter_id );
+        next_check( in.request_id == out.request_id );
+    }
+}
+
+void test_server_relay_response_packet()
+{
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+    uint64_t iterations = 100;
+    for ( uint64_t j = 0; j < iterations; ++j )
+    {
+        unsigned char public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+        unsigned char private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+        next_crypto_sign_keypair( public_key, private_key );
+
+        uint8_t magic[8];
+        uint8_t from_address[4];
+        uint8_t to_address[4];
+        next_crypto_random_bytes( magic, 8 );
+        next_crypto_random_bytes( from_address, 4 );
+        next_crypto_random_bytes( to_address, 4 );
+
+        static NextBackendServerRelayResponsePacket in, out;
+        in.request_id = next_random_uint64();
+        in.num_server_relays = rand() % ( NEXT_MAX_SERVER_RELAYS + 1 );
+        for ( int i = 0; i < in.num_server_relays; i++ )
+        {
+            in.server_relay_ids[i] = next_random_uint64();
+            next_address_parse( &in.server_relay_addresses[i], "127.0.0.1:50000" );
+            next_crypto_random_bytes( in.server_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES );
+        }
+        in.expire_timestamp = next_random_uint64();
+
+        int packet_bytes = 0;
+        next_check( next_write_backend_packet( NEXT_BACKEND_SERVER_RELAY_RESPONSE_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
+
+        const uint8_t packet_id = packet_data[0];
+        next_check( packet_id == NEXT_BACKEND_SERVER_RELAY_RESPONSE_PACKET );
+
+        next_check( next_basic_packet_filter( packet_data, packet_bytes ) );
+        next_check( next_advanced_packet_filter( packet_data, magic, from_address, to_address, packet_bytes ) );
+
+        const int begin = 18;
+        const int end = packet_bytes;
+
+        next_check( next_read_backend_packet( packet_id, packet_data, begin, end, &out, next_signed_packets, public_key ) == NEXT_BACKEND_SERVER_RELAY_RESPONSE_PACKET );
+
+        next_check( in.request_id == out.request_id );
+        next_check( in.num_server_relays == out.num_server_relays );
+        for ( int i = 0; i < in.num_server_relays; i++ )
+        {
+            next_check( in.server_relay_ids[i] == out.server_relay_ids[i] );
+            next_check( next_address_equal( &in.server_relay_addresses[i], &out.server_relay_addresses[i] ) );
+            next_check( memcmp( in.server_relay_ping_tokens[i], out.server_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES ) == 0 );
+        }
+        next_check( in.expire_timestamp == out.expire_timestamp );
+    }
+}
+
+void test_backend_packet_cache()
+{
+    unsigned char public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+    unsigned char private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+    next_crypto_sign_keypair( public_key, private_key );
+
+    uint8_t magic[8];
+    uint8_t from_address[4];
+    uint8_t to_address[4];
+    next_crypto_random_bytes( magic, 8 );
+    next_crypto_random_bytes( from_address, 4 );
+    next_crypto_random_bytes( to_address, 4 );
+
+    static NextBackendServerRelayRequestPacket in, out;
+    in.buyer_id = 1231234127431LL;
+    in.request_id = next_random_uint64();
+    in.datacenter_id = next_datacenter_id( "local" );
+
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+    int packet_bytes = 0;
+    next_check( next_write_backend_packet( NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
+
+    static next_backend_packet_cache_t cache;
+    next_backend_packet_cache_clear( &cache );
+    next_check( !next_backend_packet_cache_valid( &cache, NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, magic, from_address, to_address ) );
+
+    next_backend_packet_cache_store( &cache, NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, packet_data, packet_bytes, magic, from_address, to_address );
+    next_check( next_backend_packet_cache_valid( &cache, NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, magic, from_address, to_address ) );
+    next_check( !next_backend_packet_cache_valid( &cache, NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET, magic, from_address, to_address ) );
+
+    // the cached bytes are exactly what would be sent again
+
+    next_check( cache.packet_bytes == packet_bytes );
+    next_check( memcmp( cache.packet_data, packet_data, packet_bytes ) == 0 );
+    next_check( next_basic_packet_filter( cache.packet_data, cache.packet_bytes ) );
+    next_check( next_advanced_packet_filter( cache.packet_data, magic, from_address, to_address, cache.packet_bytes ) );
+    next_check( next_read_backend_packet( NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, cache.packet_data, 18, cache.packet_bytes, &out, next_signed_packets, public_key ) == NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET );
+    next_check( out.request_id == in.request_id );
+
+    // a new magic or address makes the cached bytes stale
+
+    uint8_t other[8];
+    memcpy( other, magic, 8 );
+    other[0] ^= 1;
+    next_check( !next_backend_packet_cache_valid( &cache, NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, other, from_address, to_address ) );
+    memcpy( other, from_address, 4 );
+    other[3] ^= 1;
+    next_check( !next_backend_packet_cache_valid( &cache, NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, magic, other, to_address ) );
+    memcpy( other, to_address, 4 );
+    other[0] ^= 1;
+    next_check( !next_backend_packet_cache_valid( &cache, NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, magic, from_address, other ) );
+
+    // clearing also forgets which request the cache was for, so signing jobs still in flight for it are dropped
+
+    cache.sequence = 1000;
+    next_backend_packet_cache_clear( &cache );
+    next_check( cache.sequence == 0 );
+    next_check( !next_backend_packet_cache_valid( &cache, NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, magic, from_address, to_address ) );
+}
+
+const int AsyncLogMaxMessages = 4096;
+
+struct async_log_test_t
+{
+    std::atomic<int> blocked;
+    int num_messages;
+    int num_warnings;
+    int levels[AsyncLogMaxMessages];
+    char messages[AsyncLogMaxMessages][64];
+};
+
+static async_log_test_t async_log_test;
+
+static void test_async_log_write_function( int level, double time, const char * message )
+{
+    next_check( time > 0.0 );
+
+    while ( async_log_test.blocked )
+    {
+        next_platform_sleep( 0.001 );
+    }
+
+    if ( level == NEXT_LOG_LEVEL_WARN && strstr( message, "dropped" ) )
+    {
+        async_log_test.num_warnings++;
+        return;
+    }
+
+    next_check( async_log_test.num_messages < AsyncLogMaxMessages );
+    async_log_test.levels[async_log_test.num_messages] = level;
+    next_copy_string( async_log_test.messages[async_log_test.num_messages], message, sizeof(async_log_test.messages[0]) );
+    async_log_test.num_messages++;
+}
+
+struct async_log_test_thread_t
+{
+    next_async_log_t * log;
+    int thread_index;
+    int num_messages;
+    int num_pushed;
+};
+
+static void test_async_log_thread_function( void * data )
+{
+    async_log_test_thread_t * thread = (async_log_test_thread_t*) data;
+    for ( int i = 0; i < thread->num_messages; ++i )
+    {
+        char message[64];
+        snprintf( message, sizeof(message), "%d %d", thread->thread_index, i );
+        if ( next_async_log_push( thread->log, NEXT_LOG_LEVEL_DEBUG, message ) )
+            thread->num_pushed++;
+    }
+}
+
+void test_async_log()
+{
+    memset( (char*) &async_log_test, 0, sizeof(async_log_test) );
+
+    next_async_log_t * log = next_async_log_create( NULL, test_async_log_write_function );
+    next_check( log );
+
+    // messages from one thread come out in order, with their level
+
+    for ( int i = 0; i < 100; ++i )
+    {
+        char message[64];
+        snprintf( message, sizeof(message), "message %d", i );
+        next_check( next_async_log_push( log, ( i % 2 ) ? NEXT_LOG_LEVEL_INFO : NEXT_LOG_LEVEL_ERROR, message ) );
+    }
+
+    next_async_log_flush( log );
+
+    next_check( async_log_test.num_messages == 100 );
+    for ( int i = 0; i < 100; ++i )
+    {
+        char message[64];
+        snprintf( message, sizeof(message), "message %d", i );
+        next_check( strcmp( async_log_test.messages[i], message ) == 0 );
+        next_check( async_log_test.levels[i] == ( ( i % 2 ) ? NEXT_LOG_LEVEL_INFO : NEXT_LOG_LEVEL_ERROR ) );
+    }
+
+    // many threads, more than there are rings in total, each get a ring and keep their own order
+
+    const int NumThreads = 10;
+    const int MessagesPerThread = 100;
+
+    for ( int round = 0; round < 2; ++round )
+    {
+        async_log_test.num_messages = 0;
+
+        static async_log_test_thread_t threads[NumThreads];
+        next_platform_thread_t * thread_handles[NumThreads];
+        for ( int i = 0; i < NumThreads; ++i )
+        {
+            threads[i].log = log;
+            threads[i].thread_index = i;
+            threads[i].num_messages = MessagesPerThread;
+            threads[i].num_pushed = 0;
+            thread_handles[i] = next_platform_thread_create( NULL, test_async_log_thread_function, &threads[i] );
+            next_check( thread_handles[i] );
+        }
+
+        for ( int i = 0; i < NumThreads; ++i )
+        {
+            next_platform_thread_join( thread_handles[i] );
+            next_platform_thread_destroy( thread_handles[i] );
+            next_check( threads[i].num_pushed == MessagesPerThread );
+        }
+
+        next_async_log_flush( log );
+
+        next_check( async_log_test.num_messages == NumThreads * MessagesPerThread );
+
+        int next_message[NumThreads];
+        memset( next_message, 0, sizeof(next_message) );
+        for ( int i = 0; i < async_log_test.num_messages; ++i )
+        {
+            int thread_index = -1;
+            int message_index = -1;
+            next_check( sscanf( async_log_test.messages[i], "%d %d", &thread_index, &message_index ) == 2 );
+            next_check( thread_index >= 0 && thread_index < NumThreads );
+            next_check( message_index == next_message[thread_index] );
+            next_message[thread_index]++;
+        }
+
+        // IMPORTANT: give the writer a moment to hand the rings of the exited threads back
+
+        next_platform_sleep( 0.1 );
+    }
+
+    // when the writer falls behind, messages are dropped and counted, never blocking the thread that logs
+
+    async_log_test.num_messages = 0;
+    async_log_test.blocked = 1;
+
+    next_check( next_async_log_push( log, NEXT_LOG_LEVEL_INFO, "blocker" ) );
+    next_platform_sleep( 0.1 );
+
+    const int NumOverflowMessages = 1000;
+    for ( int i = 0; i < NumOverflowMessages; ++i )
+    {
+        char message[64];
+        snprintf( message, sizeof(message), "overflow %d", i );
+        next_check( next_async_log_push( log, NEXT_LOG_LEVEL_INFO, message ) );
+    }
+
+    const uint64_t num_dropped = next_async_log_num_dropped( log );
+    next_check( num_dropped > 0 );
+    next_check( num_dropped < NumOverflowMessages );
+
+    async_log_test.blocked = 0;
+
+    next_async_log_flush( log );
+
+    next_check( async_log_test.num_messages == 1 + NumOverflowMessages - int( num_dropped ) );
+    next_check( async_log_test.num_warnings == 1 );
+
+    next_async_log_destroy( log );
+}
+
+static std::atomic<int> crypto_worker_num_wakes;
+
+static void test_crypto_worker_wake( void * data )
+{
+    next_check( data == &crypto_worker_num_wakes );
+    crypto_worker_num_wakes++;
+}
+
+void test_crypto_worker()
+{
+    unsigned char public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+    unsigned char private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+    next_crypto_sign_keypair( public_key, private_key );
+
+    crypto_worker_num_wakes = 0;
+
+    next_crypto_worker_t * worker = next_crypto_worker_create( NULL, private_key, public_key, test_crypto_worker_wake, &crypto_worker_num_wakes );
+    next_check( worker );
+
+    uint8_t magic[8];
+    uint8_t from_address[4];
+    uint8_t to_address[4];
+    next_crypto_random_bytes( magic, 8 );
+    next_crypto_random_bytes( from_address, 4 );
+    next_crypto_random_bytes( to_address, 4 );
+
+    static NextBackendServerInitRequestPacket in, out;
+    in.request_id = next_random_uint64();
+    in.buyer_id = 1231234127431LL;
+    in.datacenter_id = next_datacenter_id( "local" );
+    strcpy( in.datacenter_name, "local" );
+
+    // sign on the worker and check the result is identical to signing inline
+
+    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+    int packet_bytes = 0;
+    next_check( next_write_backend_packet( NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
+
+    next_crypto_worker_job_t * job = next_crypto_worker_create_job( worker, NEXT_CRYPTO_WORKER_JOB_SIGN );
+    next_check( job );
+    next_check( next_write_backend_packet( NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET, &in, job->packet_data, &job->packet_bytes, NULL, NULL, magic, from_address, to_address ) == NEXT_OK );
+    job->packet_id = NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET;
+    memcpy( job->magic, magic, 8 );
+    memcpy( job->from_address_data, from_address, 4 );
+    memcpy( job->to_address_data, to_address, 4 );
+    next_check( next_crypto_worker_submit( worker, job ) == NEXT_OK );
+
+    next_crypto_worker_job_t * result = NULL;
+    for ( int i = 0; i < 1000 && !result; ++i )
+    {
+        result = next_crypto_worker_poll( worker );
+        if ( !result )
+            next_platform_sleep( 0.001 );
+    }
+    next_check( result == job );
+    next_check( result->packet_bytes == packet_bytes );
+    next_check( memcmp( result->packet_data, packet_data, packet_bytes ) == 0 );
+    next_check( next_basic_packet_filter( result->packet_data, result->packet_bytes ) );
+    next_check( next_advanced_packet_filter( result->packet_data, magic, from_address, to_address, result->packet_bytes ) );
+    next_check( next_read_backend_packet( NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET, result->packet_data, 18, result->packet_bytes, &out, next_signed_packets, public_key ) == NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET );
+    next_check( in.request_id == out.request_id );
+    next_crypto_worker_destroy_job( worker, result );
+
+    // verify a good packet and a corrupted packet on the worker
+
+    const int num_jobs = 2;
+
+    for ( int i = 0; i < num_jobs; ++i )
+    {
+        job = next_crypto_worker_create_job( worker, NEXT_CRYPTO_WORKER_JOB_VERIFY );
+        next_check( job );
+        job->packet_id = NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET;
+        job->packet_bytes = packet_bytes;
+        memcpy( job->packet_data, packet_data, packet_bytes );
+        if ( i == 1 )
+        {
+            job->packet_data[20] ^= 1;
+        }
+        next_check( next_crypto_worker_submit( worker, job ) == NEXT_OK );
+    }
+
+    int num_results = 0;
+    for ( int i = 0; i < 1000 && num_results < num_jobs; ++i )
+    {
+        result = next_crypto_worker_poll( worker );
+        if ( !result )
+        {
+            next_platform_sleep( 0.001 );
+            continue;
         }
-        in.expire_timestamp = next_random_uint64();
+        next_check( result->type == NEXT_CRYPTO_WORKER_JOB_VERIFY );
+        next_check( result->verified == ( num_results == 0 ) );
+        next_crypto_worker_destroy_job( worker, result );
+        num_results++;
+    }
+    next_check( num_results == num_jobs );
 
-        int packet_bytes = 0;
-        next_check( next_write_backend_packet( NEXT_BACKEND_CLIENT_RELAY_RESPONSE_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
+    // session update responses are verified in a batch. one bad packet falls back to individual verification
 
-        const uint8_t packet_id = packet_data[0];
-        next_check( packet_id == NEXT_BACKEND_CLIENT_RELAY_RESPONSE_PACKET );
+    static NextBackendSessionUpdateResponsePacket response_in;
+    response_in.slice_number = 0;
+    response_in.session_id = next_random_uint64();
+    response_in.response_type = NEXT_UPDATE_TYPE_DIRECT;
 
-        next_check( next_basic_packet_filter( packet_data, packet_bytes ) );
-        next_check( next_advanced_packet_filter( packet_data, magic, from_address, to_address, packet_bytes ) );
+    uint8_t response_packet_data[NEXT_MAX_PACKET_BYTES];
+    int response_packet_bytes = 0;
+    next_check( next_write_backend_packet( NEXT_BACKEND_SESSION_UPDATE_RESPONSE_PACKET, &response_in, response_packet_data, &response_packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
 
-        const int begin = 18;
-        const int end = packet_bytes;
+    const int num_batch_jobs = NEXT_CRYPTO_SIGN_BATCH_MAX + 4;
+    const int bad_job = 5;
 
-        next_check( next_read_backend_packet( packet_id, packet_data, begin, end, &out, next_signed_packets, public_key ) == NEXT_BACKEND_CLIENT_RELAY_RESPONSE_PACKET );
+    for ( int i = 0; i < num_batch_jobs; ++i )
+    {
+        job = next_crypto_worker_create_job( worker, NEXT_CRYPTO_WORKER_JOB_VERIFY );
+        next_check( job );
+        job->packet_id = NEXT_BACKEND_SESSION_UPDATE_RESPONSE_PACKET;
+        job->packet_bytes = response_packet_bytes;
+        memcpy( job->packet_data, response_packet_data, response_packet_bytes );
+        job->packet_data[20] ^= ( i == bad_job ) ? 1 : 0;
+        job->address.port = uint16_t( i );
+        next_check( next_crypto_worker_submit( worker, job ) == NEXT_OK );
+    }
 
-        next_check( next_address_equal( &in.client_address, &out.client_address ) );
-        next_check( in.request_id == out.request_id );
-        next_check( in.latitude == out.latitude );
-        next_check( in.longitude == out.longitude );
-        next_check( in.num_client_relays == out.num_client_relays );
-        for ( int i = 0; i < in.num_client_relays; i++ )
+    num_results = 0;
+    for ( int i = 0; i < 1000 && num_results < num_batch_jobs; ++i )
+    {
+        result = next_crypto_worker_poll( worker );
+        if ( !result )
         {
-            next_check( in.client_relay_ids[i] == out.client_relay_ids[i] );
-            next_check( next_address_equal( &in.client_relay_addresses[i], &out.client_relay_addresses[i] ) );
-            next_check( memcmp( in.client_relay_ping_tokens[i], out.client_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES ) == 0 );
+            next_platform_sleep( 0.001 );
+            continue;
         }
-        next_check( in.expire_timestamp == out.expire_timestamp );
+        next_check( result->type == NEXT_CRYPTO_WORKER_JOB_VERIFY );
+        next_check( result->verified == ( result->address.port != bad_job ) );
+        next_crypto_worker_destroy_job( worker, result );
+        num_results++;
     }
-}
-
-void test_server_relay_request_packet()
-{
-    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-    uint64_t iterations = 100;
-    for ( uint64_t i = 0; i < iterations; ++i )
-    {
-        unsigned char public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
-        unsigned char private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
-        next_crypto_sign_keypair( public_key, private_key );
+    next_check( num_results == num_batch_jobs );
 
-        uint8_t magic[8];
-        uint8_t from_address[4];
-        uint8_t to_address[4];
-        next_crypto_random_bytes( magic, 8 );
-        next_crypto_random_bytes( from_address, 4 );
-        next_crypto_random_bytes( to_address, 4 );
+    // jobs still in flight are cleaned up on destroy
 
-        static NextBackendServerRelayRequestPacket in, out;
-        in.buyer_id = next_random_uint64();
-        in.datacenter_id = next_random_uint64();
-        in.request_id = next_random_uint64();
+    job = next_crypto_worker_create_job( worker, NEXT_CRYPTO_WORKER_JOB_VERIFY );
+    next_check( job );
+    job->packet_id = NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET;
+    job->packet_bytes = packet_bytes;
+    memcpy( job->packet_data, packet_data, packet_bytes );
+    next_check( next_crypto_worker_submit( worker, job ) == NEXT_OK );
 
-        int packet_bytes = 0;
-        next_check( next_write_backend_packet( NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
+    next_crypto_worker_destroy( worker );
 
-        const uint8_t packet_id = packet_data[0];
-        next_check( packet_id == NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET );
+    // the worker wakes the owner once per sign or verify result, and at least once per batch
 
-        next_check( next_basic_packet_filter( packet_data, packet_bytes ) );
-        next_check( next_advanced_packet_filter( packet_data, magic, from_address, to_address, packet_bytes ) );
+    next_check( crypto_worker_num_wakes >= 3 + 2 );
+}
 
-        const int begin = 18;
-        const int end = packet_bytes;
+static int test_impairment_receive_pattern( next_platform_socket_t * socket, const next_address_t * address, uint8_t * received, int num_packets )
+{
+    uint8_t packet[256];
+    memset( packet, 0, sizeof(packet) );
+    for ( int i = 0; i < num_packets; ++i )
+    {
+        packet[0] = uint8_t( i );
+        next_platform_socket_send_packet( socket, address, packet, sizeof(packet) );
+    }
 
-        next_check( next_read_backend_packet( packet_id, packet_data, begin, end, &out, next_signed_packets, public_key ) == NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET );
+    next_platform_sleep( 0.1 );
 
-        next_check( in.version_major == out.version_major );
-        next_check( in.version_minor == out.version_minor );
-        next_check( in.version_patch == out.version_patch );
-        next_check( in.buyer_id == out.buyer_id );
-        next_check( in.datacenter_id == out.datacenter_id );
-        next_check( in.request_id == out.request_id );
+    memset( received, 0, num_packets );
+    int num_received = 0;
+    next_address_t from;
+    while ( next_platform_socket_receive_packet( socket, &from, packet, sizeof(packet) ) )
+    {
+        next_check( packet[0] < num_packets );
+        received[packet[0]] = 1;
+        num_received++;
     }
+
+    return num_received;
 }
 
-void test_server_relay_response_packet()
+void test_impairment()
 {
-    uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
-    uint64_t iterations = 100;
-    for ( uint64_t j = 0; j < iterations; ++j )
+    next_impairment_config_t config;
+    next_check( next_impairment_parse( "latency=50,jitter=10,loss=1,burst=0.5,burst_length=8,reorder=1,reorder_ms=20,duplicate=0.5", &config ) == NEXT_OK );
+    next_check( config.latency_ms == 50.0f );
+    next_check( config.jitter_ms == 10.0f );
+    next_check( config.packet_loss_percent == 1.0f );
+    next_check( config.burst_loss_percent == 0.5f );
+    next_check( config.burst_length == 8 );
+    next_check( config.reorder_percent == 1.0f );
+    next_check( config.reorder_ms == 20.0f );
+    next_check( config.duplicate_percent == 0.5f );
+    next_check( next_impairment_parse( "latency", &config ) == NEXT_ERROR );
+    next_check( next_impairment_parse( "latency=abc", &config ) == NEXT_ERROR );
+    next_check( next_impairment_parse( "bandwidth=10", &config ) == NEXT_ERROR );
+
+    next_address_t bind_address;
+    next_address_t local_address;
+    next_address_parse( &bind_address, "0.0.0.0" );
+    next_address_parse( &local_address, "127.0.0.1" );
+    next_platform_socket_t * socket = next_platform_socket_create( NULL, &bind_address, NEXT_PLATFORM_SOCKET_NON_BLOCKING, 0, 256*1024, 256*1024 );
+    next_check( socket );
+    local_address.port = bind_address.port;
+
+    // latency holds the packet back until its slot in the wheel comes up
+
     {
-        unsigned char public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
-        unsigned char private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
-        next_crypto_sign_keypair( public_key, private_key );
+        next_check( next_impairment_parse( "latency=50", &config ) == NEXT_OK );
+        next_check( next_impairment_set( &local_address, &config ) == NEXT_OK );
 
-        uint8_t magic[8];
-        uint8_t from_address[4];
-        uint8_t to_address[4];
-        next_crypto_random_bytes( magic, 8 );
-        next_crypto_random_bytes( from_address, 4 );
-        next_crypto_random_bytes( to_address, 4 );
+        uint8_t packet[256];
+        memset( packet, 0, sizeof(packet) );
+        const double send_time = next_platform_time();
+        next_platform_socket_send_packet( socket, &local_address, packet, sizeof(packet) );
 
-        static NextBackendServerRelayResponsePacket in, out;
-        in.request_id = next_random_uint64();
-        in.num_server_relays = rand() % ( NEXT_MAX_SERVER_RELAYS + 1 );
-        for ( int i = 0; i < in.num_server_relays; i++ )
+        next_address_t from;
+        next_check( !next_platform_socket_receive_packet( socket, &from, packet, sizeof(packet) ) );
+
+        bool received = false;
+        while ( next_platform_time() < send_time + 1.0 )
         {
-            in.server_relay_ids[i] = next_random_uint64();
-            next_address_parse( &in.server_relay_addresses[i], "127.0.0.1:50000" );
-            next_crypto_random_bytes( in.server_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES );
+            if ( next_platform_socket_receive_packet( socket, &from, packet, sizeof(packet) ) )
+            {
+                received = true;
+                break;
+            }
+            next_platform_sleep( 0.001 );
         }
-        in.expire_timestamp = next_random_uint64();
+        next_check( received );
+        next_check( next_platform_time() - send_time >= 0.045 );
+    }
 
-        int packet_bytes = 0;
-        next_check( next_write_backend_packet( NEXT_BACKEND_SERVER_RELAY_RESPONSE_PACKET, &in, packet_data, &packet_bytes, next_signed_packets, private_key, magic, from_address, to_address ) == NEXT_OK );
+    // the same seed gives the same losses
 
-        const uint8_t packet_id = packet_data[0];
-        next_check( packet_id == NEXT_BACKEND_SERVER_RELAY_RESPONSE_PACKET );
+    {
+        next_check( next_impairment_parse( "loss=50", &config ) == NEXT_OK );
 
-        next_check( next_basic_packet_filter( packet_data, packet_bytes ) );
-        next_check( next_advanced_packet_filter( packet_data, magic, from_address, to_address, packet_bytes ) );
+        const int NumPackets = 200;
+        uint8_t received_a[NumPackets];
+        uint8_t received_b[NumPackets];
 
-        const int begin = 18;
-        const int end = packet_bytes;
+        next_impairment_seed( 12345 );
+        next_check( next_impairment_set( &local_address, &config ) == NEXT_OK );
+        const int num_received_a = test_impairment_receive_pattern( socket, &local_address, received_a, NumPackets );
 
-        next_check( next_read_backend_packet( packet_id, packet_data, begin, end, &out, next_signed_packets, public_key ) == NEXT_BACKEND_SERVER_RELAY_RESPONSE_PACKET );
+        next_impairment_seed( 12345 );
+        next_check( next_impairment_set( &local_address, &config ) == NEXT_OK );
+        const int num_received_b = test_impairment_receive_pattern( socket, &local_address, received_b, NumPackets );
 
-        next_check( in.request_id == out.request_id );
-        next_check( in.num_server_relays == out.num_server_relays );
-        for ( int i = 0; i < in.num_server_relays; i++ )
-        {
-            next_check( in.server_relay_ids[i] == out.server_relay_ids[i] );
-            next_check( next_address_equal( &in.server_relay_addresses[i], &out.server_relay_addresses[i] ) );
-            next_check( memcmp( in.server_relay_ping_tokens[i], out.server_relay_ping_tokens[i], NEXT_PING_TOKEN_BYTES ) == 0 );
-        }
-        next_check( in.expire_timestamp == out.expire_timestamp );
+        next_check( num_received_a > NumPackets / 4 );
+        next_check( num_received_a < NumPackets * 3 / 4 );
+        next_check( num_received_a == num_received_b );
+        next_check( memcmp( received_a, received_b, NumPackets ) == 0 );
+    }
+
+    // removing the rule sends packets straight through again
+
+    {
+        next_check( next_impairment_set( &local_address, NULL ) == NEXT_OK );
+
+        uint8_t received[8];
+        next_check( test_impairment_receive_pattern( socket, &local_address, received, 8 ) == 8 );
     }
+
+    next_impairment_stats_t stats;
+    next_impairment_stats( &stats );
+    next_check( stats.packets_sent == 401 );
+    next_check( stats.packets_delayed == 1 );
+    next_check( stats.packets_dropped > 0 );
+
+    next_impairment_clear();
+
+    next_platform_socket_destroy( socket );
 }
 
 static uint64_t test_passthrough_packets_client_packets_received;
@@ -4311,6 +6507,111 @@ void test_passthrough_packets()
     next_assert( test_passthrough_packets_client_packets_received > 10 );
     next_assert( test_passthrough_packets_server_packets_received > 10 );
 
+    uint64_t server_counters[NEXT_SERVER_COUNTER_NUM_COUNTERS];
+    next_server_counters( server, server_counters );
+    next_check( server_counters[NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED] >= uint64_t( test_passthrough_packets_server_packets_received ) );
+    next_check( server_counters[NEXT_SERVER_COUNTER_PACKETS_RECEIVED] >= server_counters[NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED] );
+    next_check( server_counters[NEXT_SERVER_COUNTER_BYTES_RECEIVED] >= server_counters[NEXT_SERVER_COUNTER_PACKETS_RECEIVED] );
+    next_check( server_counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_POPPED] >= uint64_t( test_passthrough_packets_server_packets_received ) );
+    next_check( server_counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_HIGH_WATER_MARK] >= 1 );
+    next_check( server_counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_HIGH_WATER_MARK] <= uint64_t( NEXT_NOTIFY_QUEUE_LENGTH ) );
+
+    next_client_close_session( client );
+
+    next_client_destroy( client );
+
+    next_server_flush( server );
+
+    next_server_destroy( server );
+}
+
+#endif // #if NEXT_PLATFORM_CAN_RUN_SERVER
+
+#if NEXT_PLATFORM_CAN_RUN_SERVER
+
+static std::atomic<uint64_t> test_immediate_packet_delivery_client_packets_received;
+static std::atomic<uint64_t> test_immediate_packet_delivery_server_packets_received;
+static std::atomic<bool> test_immediate_packet_delivery_client_address_set;
+static next_address_t test_immediate_packet_delivery_client_address;
+
+void test_immediate_packet_delivery_client_packet_received_callback( next_client_t * client, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes )
+{
+    (void) client;
+    (void) context;
+    (void) from;
+    for ( int i = 0; i < packet_bytes; i++ )
+    {
+        if ( packet_data[i] != uint8_t( packet_bytes + i ) )
+            return;
+    }
+    test_immediate_packet_delivery_client_packets_received++;
+}
+
+void test_immediate_packet_delivery_server_packet_received_callback( next_server_t * server, void * context, const next_address_t * from, const uint8_t * packet_data, int packet_bytes )
+{
+    (void) server;
+    (void) context;
+    if ( !test_immediate_packet_delivery_client_address_set )
+    {
+        test_immediate_packet_delivery_client_address = *from;
+        test_immediate_packet_delivery_client_address_set = true;
+    }
+    for ( int i = 0; i < packet_bytes; i++ )
+    {
+        if ( packet_data[i] != uint8_t( packet_bytes + i ) )
+            return;
+    }
+    test_immediate_packet_delivery_server_packets_received++;
+}
+
+void test_immediate_packet_delivery()
+{
+    // IMPORTANT: neither next_client_update nor next_server_update is called, so packets can only arrive through the internal threads
+
+    const bool immediate_packet_delivery = next_global_config.immediate_packet_delivery;
+    next_global_config.immediate_packet_delivery = true;
+
+    next_server_t * server = next_server_create( NULL, "127.0.0.1", "0.0.0.0:12346", "local", test_immediate_packet_delivery_server_packet_received_callback );
+    next_check( server );
+
+    next_client_t * client = next_client_create( NULL, "0.0.0.0:0", test_immediate_packet_delivery_client_packet_received_callback );
+    next_check( client );
+
+    next_client_open_session( client, "127.0.0.1:12346" );
+
+    uint8_t packet_data[NEXT_MTU];
+
+    const double start_time = next_platform_time();
+
+    while ( next_platform_time() < start_time + 5.0 )
+    {
+        const int packet_bytes = 1 + rand() % NEXT_MTU;
+        for ( int j = 0; j < packet_bytes; j++ )
+        {
+            packet_data[j] = uint8_t( packet_bytes + j );
+        }
+
+        next_client_send_packet( client, packet_data, packet_bytes );
+
+        if ( test_immediate_packet_delivery_client_address_set )
+        {
+            next_server_send_packet( server, &test_immediate_packet_delivery_client_address, packet_data, packet_bytes );
+        }
+
+        if ( test_immediate_packet_delivery_client_packets_received > 10 && test_immediate_packet_delivery_server_packets_received > 10 )
+            break;
+
+        next_platform_sleep( 0.001 );
+    }
+
+    next_check( test_immediate_packet_delivery_client_packets_received > 10 );
+    next_check( test_immediate_packet_delivery_server_packets_received > 10 );
+
+    uint64_t server_counters[NEXT_SERVER_COUNTER_NUM_COUNTERS];
+    next_server_counters( server, server_counters );
+    next_check( server_counters[NEXT_SERVER_COUNTER_PAYLOADS_RECEIVED] >= uint64_t( test_immediate_packet_delivery_server_packets_received ) );
+    next_check( server_counters[NEXT_SERVER_COUNTER_NOTIFY_QUEUE_POPPED] == 0 );
+
     next_client_close_session( client );
 
     next_client_destroy( client );
@@ -4318,6 +6619,150 @@ void test_passthrough_packets()
     next_server_flush( server );
 
     next_server_destroy( server );
+
+    next_global_config.immediate_packet_delivery = immediate_packet_delivery;
+}
+
+extern uint8_t next_server_backend_public_key[];
+
+struct backend_resend_test_t
+{
+    uint8_t packet_id;
+    int first_packet_bytes;
+    int num_resends;
+    uint8_t first_packet_data[NEXT_MAX_PACKET_BYTES];
+};
+
+static backend_resend_test_t backend_resend_test[2];
+
+void test_backend_packet_resend()
+{
+    // a fake backend answers the server init request, then ignores server update and server relay requests so the server resends them.
+    // the server resolves the backend to the default backend port, so skip when something else already has it (eg. a local backend)
+
+    next_address_t backend_address;
+    next_address_parse( &backend_address, "127.0.0.1:" NEXT_SERVER_BACKEND_PORT );
+    next_platform_socket_t * backend_socket = next_platform_socket_create( NULL, &backend_address, NEXT_PLATFORM_SOCKET_BLOCKING, 0.01f, 64*1024, 64*1024 );
+    if ( !backend_socket )
+        return;
+
+    const next_internal_config_t config = next_global_config;
+
+    const int signed_server_update_request = next_signed_packets[NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET];
+    const int signed_server_relay_request = next_signed_packets[NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET];
+
+    uint8_t server_backend_public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+    memcpy( server_backend_public_key, next_server_backend_public_key, NEXT_CRYPTO_SIGN_PUBLICKEYBYTES );
+
+    uint8_t backend_public_key[NEXT_CRYPTO_SIGN_PUBLICKEYBYTES];
+    uint8_t backend_private_key[NEXT_CRYPTO_SIGN_SECRETKEYBYTES];
+    next_crypto_sign_keypair( backend_public_key, backend_private_key );
+    memcpy( next_server_backend_public_key, backend_public_key, NEXT_CRYPTO_SIGN_PUBLICKEYBYTES );
+
+    next_crypto_sign_keypair( next_global_config.buyer_public_key, next_global_config.buyer_private_key );
+    next_global_config.valid_buyer_public_key = true;
+    next_global_config.valid_buyer_private_key = true;
+    next_global_config.server_buyer_id = 1;
+    next_copy_string( next_global_config.server_backend_hostname, "127.0.0.1", sizeof(next_global_config.server_backend_hostname) );
+    next_global_config.disable_network_next = false;
+    next_global_config.disable_autodetect = true;
+    next_global_config.crypto_worker_thread = false;
+
+    memset( backend_resend_test, 0, sizeof(backend_resend_test) );
+    backend_resend_test[0].packet_id = NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET;
+    backend_resend_test[1].packet_id = NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET;
+
+    next_server_t * server = next_server_create( NULL, "127.0.0.1:0", "0.0.0.0:0", "local", test_server_packet_received_callback );
+    next_check( server );
+
+    const double start_time = next_platform_time();
+
+    while ( next_platform_time() < start_time + 10.0 )
+    {
+        next_server_update( server );
+
+        if ( backend_resend_test[0].num_resends > 0 && backend_resend_test[1].num_resends > 0 )
+            break;
+
+        next_address_t from;
+        uint8_t packet_data[NEXT_MAX_PACKET_BYTES];
+        const int packet_bytes = next_platform_socket_receive_packet( backend_socket, &from, packet_data, sizeof(packet_data) );
+        if ( packet_bytes <= 18 )
+            continue;
+
+        const uint8_t packet_id = packet_data[0];
+
+        if ( packet_id == NEXT_BACKEND_SERVER_INIT_REQUEST_PACKET )
+        {
+            NextBackendServerInitRequestPacket request;
+            next_check( next_read_backend_packet( packet_id, packet_data, 18, packet_bytes, &request, next_signed_packets, next_global_config.buyer_public_key ) == packet_id );
+
+            NextBackendServerInitResponsePacket response;
+            response.request_id = request.request_id;
+            response.response = NEXT_SERVER_INIT_RESPONSE_OK;
+
+            uint8_t magic[8];
+            memset( magic, 0, sizeof(magic) );
+
+            uint8_t from_address_data[4];
+            uint8_t to_address_data[4];
+            next_address_data( &backend_address, from_address_data );
+            next_address_data( &from, to_address_data );
+
+            uint8_t response_data[NEXT_MAX_PACKET_BYTES];
+            int response_bytes = 0;
+            next_check( next_write_backend_packet( NEXT_BACKEND_SERVER_INIT_RESPONSE_PACKET, &response, response_data, &response_bytes, next_signed_packets, backend_private_key, magic, from_address_data, to_address_data ) == NEXT_OK );
+
+            next_platform_socket_send_packet( backend_socket, &from, response_data, response_bytes );
+
+            continue;
+        }
+
+        for ( int i = 0; i < 2; ++i )
+        {
+            backend_resend_test_t * test = &backend_resend_test[i];
+
+            if ( packet_id != test->packet_id )
+                continue;
+
+            if ( test->first_packet_bytes == 0 )
+            {
+                // IMPORTANT: from here on the request is no longer marked as signed, so serializing it again would leave the signature off.
+                // a resend that matches the first send byte for byte can only have come from the cache
+
+                next_check( next_verify_backend_packet( packet_id, packet_data, 18, packet_bytes, next_global_config.buyer_public_key ) );
+
+                memcpy( test->first_packet_data, packet_data, packet_bytes );
+                test->first_packet_bytes = packet_bytes;
+
+                next_signed_packets[packet_id] = 0;
+            }
+            else
+            {
+                next_check( packet_bytes == test->first_packet_bytes );
+                next_check( memcmp( packet_data, test->first_packet_data, packet_bytes ) == 0 );
+                test->num_resends++;
+            }
+        }
+    }
+
+    next_check( backend_resend_test[0].num_resends > 0 );
+    next_check( backend_resend_test[1].num_resends > 0 );
+
+    uint64_t counters[NEXT_SERVER_COUNTER_NUM_COUNTERS];
+    next_server_counters( server, counters );
+    next_check( counters[NEXT_SERVER_COUNTER_BACKEND_RESENDS] >= 2 );
+
+    next_server_destroy( server );
+
+    next_platform_socket_destroy( backend_socket );
+
+    next_signed_packets[NEXT_BACKEND_SERVER_UPDATE_REQUEST_PACKET] = signed_server_update_request;
+    next_signed_packets[NEXT_BACKEND_SERVER_RELAY_REQUEST_PACKET] = signed_server_relay_request;
+
+    memcpy( next_server_backend_public_key, server_backend_public_key, NEXT_CRYPTO_SIGN_PUBLICKEYBYTES );
+
+    next_global_config = config;
 }
 
 #endif // #if NEXT_PLATFORM_CAN_RUN_SERVER
@@ -4358,9 +6803,12 @@ void next_run_tests()
         RUN_TEST( test_base64 );
         RUN_TEST( test_hash );
         RUN_TEST( test_queue );
+        RUN_TEST( test_pool );
         RUN_TEST( test_bitpacker );
+        RUN_TEST( test_bitpacker_bytes );
         RUN_TEST( test_bits_required );
         RUN_TEST( test_stream );
+        RUN_TEST( test_measure_stream );
         RUN_TEST( test_address );
         RUN_TEST( test_replay_protection );
         RUN_TEST( test_ping_stats );
@@ -4371,23 +6819,31 @@ void next_run_tests()
         RUN_TEST( test_crypto_aead );
         RUN_TEST( test_crypto_aead_ietf );
         RUN_TEST( test_crypto_sign_detached );
+        RUN_TEST( test_crypto_sign_batch );
         RUN_TEST( test_crypto_key_exchange );
         RUN_TEST( test_basic_read_and_write );
         RUN_TEST( test_address_read_and_write );
         RUN_TEST( test_address_ipv4_read_and_write );
         RUN_TEST( test_platform_socket );
+        RUN_TEST( test_platform_socket_io_uring );
+        RUN_TEST( test_platform_socket_xdp );
+        RUN_TEST( test_platform_socket_xdp_veth );
         RUN_TEST( test_platform_thread );
         RUN_TEST( test_platform_mutex );
+        RUN_TEST( test_platform_semaphore );
         RUN_TEST( test_client_ipv4 );
 #if NEXT_PLATFORM_CAN_RUN_SERVER
         RUN_TEST( test_server_ipv4 );
 #endif // #if NEXT_PLATFORM_CAN_RUN_SERVER
         RUN_TEST( test_upgrade_token );
+        RUN_TEST( test_route_token );
+        RUN_TEST( test_continue_token );
         RUN_TEST( test_header );
         RUN_TEST( test_abi );
         RUN_TEST( test_packet_filter );
         RUN_TEST( test_basic_packet_filter );
         RUN_TEST( test_advanced_packet_filter );
+        RUN_TEST( test_kernel_packet_filter );
         RUN_TEST( test_passthrough );
         RUN_TEST( test_address_data_ipv4 );
         RUN_TEST( test_anonymize_address_ipv4 );
@@ -4395,14 +6851,20 @@ void next_run_tests()
         RUN_TEST( test_anonymize_address_ipv6 );
 #endif // #if NEXT_PLATFORM_HAS_IPV6
         RUN_TEST( test_bandwidth_limiter );
+        RUN_TEST( test_payload_coalescer );
+        RUN_TEST( test_fec );
         RUN_TEST( test_packet_loss_tracker );
         RUN_TEST( test_out_of_order_tracker );
         RUN_TEST( test_jitter_tracker );
+        RUN_TEST( test_adaptive_multipath );
+        RUN_TEST( test_latency_histogram );
         RUN_TEST( test_free_retains_context );
         RUN_TEST( test_pending_session_manager );
         RUN_TEST( test_proxy_session_manager );
         RUN_TEST( test_session_manager );
+        RUN_TEST( test_session_manager_max_sessions );
         RUN_TEST( test_relay_manager );
+        RUN_TEST( test_route_manager );
         RUN_TEST( test_direct_packet );
         RUN_TEST( test_direct_ping_packet );
         RUN_TEST( test_direct_pong_packet );
@@ -4423,6 +6885,7 @@ void next_run_tests()
         RUN_TEST( test_route_update_packet_new_route );
         RUN_TEST( test_route_update_packet_continue_route );
         RUN_TEST( test_route_ack_packet );
+        RUN_TEST( test_fast_packet_serializers );
         RUN_TEST( test_client_relay_update_packet );
         RUN_TEST( test_client_relay_ack_packet );
         RUN_TEST( test_client_ping_packet );
@@ -4441,8 +6904,14 @@ void next_run_tests()
         RUN_TEST( test_client_relay_response_packet );
         RUN_TEST( test_server_relay_request_packet );
         RUN_TEST( test_server_relay_response_packet );
+        RUN_TEST( test_backend_packet_cache );
+        RUN_TEST( test_crypto_worker );
+        RUN_TEST( test_async_log );
+        RUN_TEST( test_impairment );
 #if NEXT_PLATFORM_CAN_RUN_SERVER
         RUN_TEST( test_passthrough_packets );
+        RUN_TEST( test_immediate_packet_delivery );
+        RUN_TEST( test_backend_packet_resend );
 #endif // #if NEXT_PLATFORM_CAN_RUN_SERVER
         RUN_TEST( test_packet_tagging );
     }
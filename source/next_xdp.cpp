@@ -0,0 +1,840 @@
+/*
+    Network Next. Copyright © 2017 - 2024 Network Next, Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following
+    conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions
+       and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote
+       products derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+    NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "next_xdp.h"
+
+#if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+#if defined(__has_include)
+#if __has_include(<linux/if_xdp.h>) && __has_include(<linux/bpf.h>)
+#define NEXT_XDP_HEADERS 1
+#endif // #if __has_include(<linux/if_xdp.h>) && __has_include(<linux/bpf.h>)
+#endif // #if defined(__has_include)
+
+#if NEXT_XDP_HEADERS
+
+#include "next_memory_checks.h"
+#include "next_constants.h"
+#include "next_platform.h"
+#include "next_address.h"
+
+#include <linux/if_xdp.h>
+#include <linux/if_link.h>
+#include <linux/bpf.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif // #ifndef AF_XDP
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif // #ifndef SOL_XDP
+
+#define NEXT_XDP_ETHERNET_HEADER_BYTES                                 14
+#define NEXT_XDP_IPV4_HEADER_BYTES                                     20
+#define NEXT_XDP_UDP_HEADER_BYTES                                       8
+#define NEXT_XDP_HEADER_BYTES ( NEXT_XDP_ETHERNET_HEADER_BYTES + NEXT_XDP_IPV4_HEADER_BYTES + NEXT_XDP_UDP_HEADER_BYTES )
+
+static_assert( ( NEXT_XDP_RING_ENTRIES & ( NEXT_XDP_RING_ENTRIES - 1 ) ) == 0, "xdp ring entries must be a power of two" );
+static_assert( ( NEXT_XDP_MAX_PEERS & ( NEXT_XDP_MAX_PEERS - 1 ) ) == 0, "xdp max peers must be a power of two" );
+static_assert( NEXT_XDP_FRAMES == NEXT_XDP_RING_ENTRIES * 2, "half of the xdp frames are for receive, half for send" );
+static_assert( NEXT_XDP_HEADER_BYTES + NEXT_MAX_PACKET_BYTES + XDP_PACKET_HEADROOM <= NEXT_XDP_FRAME_BYTES, "xdp frames must fit a packet" );
+
+struct next_xdp_ring_t
+{
+    uint32_t * producer;
+    uint32_t * consumer;
+    uint32_t * flags;
+    void * descriptors;
+    void * memory;
+    size_t memory_bytes;
+};
+
+struct next_xdp_peer_t
+{
+    uint32_t address;                           // network order. zero if the entry is empty
+    uint32_t local_address;
+    uint8_t mac[6];                             // next hop, eg. the gateway for peers on the internet
+    uint8_t local_mac[6];
+};
+
+struct next_xdp_t
+{
+    NEXT_DECLARE_SENTINEL(0)
+
+    void * context;
+    uint16_t port;                              // network order
+    bool need_wakeup;
+
+    int xsk_handle;
+    int map_handle;
+    int program_handle;
+    int link_handle;
+
+    uint8_t * umem;
+    size_t umem_bytes;
+
+    NEXT_DECLARE_SENTINEL(1)
+
+    next_xdp_ring_t fill;
+    next_xdp_ring_t completion;
+    next_xdp_ring_t rx;
+    next_xdp_ring_t tx;
+
+    NEXT_DECLARE_SENTINEL(2)
+
+    next_platform_mutex_t tx_mutex;
+    bool tx_mutex_created;
+    uint64_t free_tx_frames[NEXT_XDP_FRAMES/2];
+    int num_free_tx_frames;
+    bool tx_pending;
+
+    NEXT_DECLARE_SENTINEL(3)
+
+    next_xdp_peer_t peers[NEXT_XDP_MAX_PEERS];
+
+    NEXT_DECLARE_SENTINEL(4)
+};
+
+static thread_local next_xdp_t * next_xdp_batch = NULL;
+static thread_local int next_xdp_batch_depth = 0;
+
+static void next_xdp_verify_sentinels( next_xdp_t * xdp )
+{
+    (void) xdp;
+    next_assert( xdp );
+    NEXT_VERIFY_SENTINEL( xdp, 0 )
+    NEXT_VERIFY_SENTINEL( xdp, 1 )
+    NEXT_VERIFY_SENTINEL( xdp, 2 )
+    NEXT_VERIFY_SENTINEL( xdp, 3 )
+    NEXT_VERIFY_SENTINEL( xdp, 4 )
+}
+
+static int next_xdp_bpf( int command, bpf_attr * attr )
+{
+    return int( syscall( __NR_bpf, command, attr, sizeof(bpf_attr) ) );
+}
+
+static next_xdp_peer_t * next_xdp_peer( next_xdp_t * xdp, uint32_t address )
+{
+    return &xdp->peers[ ( ( address * 2654435761U ) >> 16 ) & ( NEXT_XDP_MAX_PEERS - 1 ) ];
+}
+
+static uint16_t next_xdp_read_uint16( const uint8_t * p )
+{
+    return uint16_t( ( p[0] << 8 ) | p[1] );
+}
+
+static void next_xdp_write_uint16( uint8_t * p, uint16_t value )
+{
+    p[0] = uint8_t( value >> 8 );
+    p[1] = uint8_t( value );
+}
+
+// ---------------------------------------------------------------
+
+struct next_xdp_program_t
+{
+    bpf_insn instructions[NEXT_XDP_MAX_INSTRUCTIONS];
+    int num_instructions;
+    int pass_jumps[NEXT_XDP_MAX_INSTRUCTIONS];
+    int num_pass_jumps;
+};
+
+static void next_xdp_emit( next_xdp_program_t * program, uint8_t code, uint8_t dst, uint8_t src, int16_t offset, int32_t immediate )
+{
+    next_assert( program->num_instructions < NEXT_XDP_MAX_INSTRUCTIONS );
+    bpf_insn * instruction = &program->instructions[program->num_instructions++];
+    memset( instruction, 0, sizeof(bpf_insn) );
+    instruction->code = code;
+    instruction->dst_reg = dst;
+    instruction->src_reg = src;
+    instruction->off = offset;
+    instruction->imm = immediate;
+}
+
+static void next_xdp_emit_pass_unless_equal( next_xdp_program_t * program, uint8_t size, int16_t offset, int32_t value )
+{
+    // r5 = *(size*)(r2 + offset); if r5 != value goto pass
+
+    next_xdp_emit( program, BPF_LDX | size | BPF_MEM, BPF_REG_5, BPF_REG_2, offset, 0 );
+    program->pass_jumps[program->num_pass_jumps++] = program->num_instructions;
+    next_xdp_emit( program, BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, 0, value );
+}
+
+static void next_xdp_generate_program( next_xdp_program_t * program, uint16_t port, int map_handle )
+{
+    // IMPORTANT: redirect unfragmented IPv4 UDP packets without IP options for our port to the xsk for this rx queue.
+    // everything else, and packets on queues without an xsk, goes up the regular network stack. loads are host endian,
+    // so constants are compared in network order as they appear in memory.
+
+    memset( program, 0, sizeof(next_xdp_program_t) );
+
+    next_xdp_emit( program, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0 );
+    next_xdp_emit( program, BPF_LDX | BPF_W | BPF_MEM, BPF_REG_2, BPF_REG_6, offsetof( xdp_md, data ), 0 );
+    next_xdp_emit( program, BPF_LDX | BPF_W | BPF_MEM, BPF_REG_3, BPF_REG_6, offsetof( xdp_md, data_end ), 0 );
+    next_xdp_emit( program, BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0 );
+    next_xdp_emit( program, BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, NEXT_XDP_HEADER_BYTES );
+    program->pass_jumps[program->num_pass_jumps++] = program->num_instructions;
+    next_xdp_emit( program, BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 0, 0 );
+
+    next_xdp_emit_pass_unless_equal( program, BPF_H, 12, next_platform_htons( 0x0800 ) );
+    next_xdp_emit_pass_unless_equal( program, BPF_B, 14, 0x45 );
+    next_xdp_emit_pass_unless_equal( program, BPF_B, 23, IPPROTO_UDP );
+
+    next_xdp_emit( program, BPF_LDX | BPF_H | BPF_MEM, BPF_REG_5, BPF_REG_2, 20, 0 );
+    next_xdp_emit( program, BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_5, 0, 0, next_platform_htons( 0x3FFF ) );
+    program->pass_jumps[program->num_pass_jumps++] = program->num_instructions;
+    next_xdp_emit( program, BPF_JMP | BPF_JNE | BPF_K, BPF_REG_5, 0, 0, 0 );
+
+    next_xdp_emit_pass_unless_equal( program, BPF_H, 36, port );
+
+    // return bpf_redirect_map( &xsk_map, ctx->rx_queue_index, XDP_PASS )
+
+    next_xdp_emit( program, BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, map_handle );
+    next_xdp_emit( program, 0, 0, 0, 0, 0 );
+    next_xdp_emit( program, BPF_LDX | BPF_W | BPF_MEM, BPF_REG_2, BPF_REG_6, offsetof( xdp_md, rx_queue_index ), 0 );
+    next_xdp_emit( program, BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS );
+    next_xdp_emit( program, BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map );
+    next_xdp_emit( program, BPF_JMP | BPF_EXIT, 0, 0, 0, 0 );
+
+    const int pass = program->num_instructions;
+
+    next_xdp_emit( program, BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS );
+    next_xdp_emit( program, BPF_JMP | BPF_EXIT, 0, 0, 0, 0 );
+
+    for ( int i = 0; i < program->num_pass_jumps; ++i )
+    {
+        const int index = program->pass_jumps[i];
+        program->instructions[index].off = int16_t( pass - ( index + 1 ) );
+    }
+}
+
+// ---------------------------------------------------------------
+
+static bool next_xdp_map_ring( int xsk_handle, next_xdp_ring_t * ring, const xdp_ring_offset * offsets, size_t descriptor_bytes, off_t page_offset )
+{
+    ring->memory_bytes = offsets->desc + NEXT_XDP_RING_ENTRIES * descriptor_bytes;
+    ring->memory = mmap( NULL, ring->memory_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xsk_handle, page_offset );
+    if ( ring->memory == MAP_FAILED )
+    {
+        ring->memory = NULL;
+        return false;
+    }
+
+    uint8_t * memory = (uint8_t*) ring->memory;
+    ring->producer = (uint32_t*) ( memory + offsets->producer );
+    ring->consumer = (uint32_t*) ( memory + offsets->consumer );
+    ring->flags = (uint32_t*) ( memory + offsets->flags );
+    ring->descriptors = memory + offsets->desc;
+
+    return true;
+}
+
+static void next_xdp_unmap_ring( next_xdp_ring_t * ring )
+{
+    if ( ring->memory )
+    {
+        munmap( ring->memory, ring->memory_bytes );
+        ring->memory = NULL;
+    }
+}
+
+static bool next_xdp_attach( next_xdp_t * xdp, int ifindex, uint32_t mode )
+{
+    bpf_attr attr;
+    memset( &attr, 0, sizeof(attr) );
+    attr.link_create.prog_fd = xdp->program_handle;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = mode;
+    xdp->link_handle = next_xdp_bpf( BPF_LINK_CREATE, &attr );
+    return xdp->link_handle >= 0;
+}
+
+next_xdp_t * next_xdp_create( void * context, const char * interface_name, int queue, uint16_t port )
+{
+    next_assert( interface_name );
+    next_assert( port != 0 );
+
+    const int ifindex = int( if_nametoindex( interface_name ) );
+    if ( ifindex == 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp interface '%s' does not exist", interface_name );
+        return NULL;
+    }
+
+    if ( queue < 0 || queue >= NEXT_XDP_MAX_QUEUES )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp queue %d is out of range", queue );
+        return NULL;
+    }
+
+    next_xdp_t * xdp = (next_xdp_t*) next_malloc( context, sizeof(next_xdp_t) );
+    if ( !xdp )
+        return NULL;
+
+    memset( xdp, 0, sizeof(next_xdp_t) );
+
+    NEXT_INITIALIZE_SENTINEL( xdp, 0 )
+    NEXT_INITIALIZE_SENTINEL( xdp, 1 )
+    NEXT_INITIALIZE_SENTINEL( xdp, 2 )
+    NEXT_INITIALIZE_SENTINEL( xdp, 3 )
+    NEXT_INITIALIZE_SENTINEL( xdp, 4 )
+
+    xdp->context = context;
+    xdp->port = next_platform_htons( port );
+    xdp->xsk_handle = -1;
+    xdp->map_handle = -1;
+    xdp->program_handle = -1;
+    xdp->link_handle = -1;
+
+    // IMPORTANT: any failure below means the kernel doesn't support AF_XDP, we don't have CAP_NET_ADMIN and CAP_BPF,
+    // or another XDP program is already attached to the interface. the caller falls back to the regular socket
+
+    bpf_attr attr;
+    memset( &attr, 0, sizeof(attr) );
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = NEXT_XDP_MAX_QUEUES;
+    xdp->map_handle = next_xdp_bpf( BPF_MAP_CREATE, &attr );
+    if ( xdp->map_handle < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not create xsk map (%d)", errno );
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+
+    next_xdp_program_t program;
+    next_xdp_generate_program( &program, xdp->port, xdp->map_handle );
+
+    static const char license[] = "BSD";
+
+    memset( &attr, 0, sizeof(attr) );
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t) program.instructions;
+    attr.insn_cnt = uint32_t( program.num_instructions );
+    attr.license = (uint64_t) license;
+    xdp->program_handle = next_xdp_bpf( BPF_PROG_LOAD, &attr );
+    if ( xdp->program_handle < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not load program (%d)", errno );
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+
+    // prefer native mode in the driver. generic mode works on any interface, including veth pairs for local testing.
+    // until the xsk is in the map below, the program passes everything up the regular network stack
+
+    bool generic_mode = false;
+    if ( !next_xdp_attach( xdp, ifindex, XDP_FLAGS_DRV_MODE ) )
+    {
+        generic_mode = true;
+        if ( !next_xdp_attach( xdp, ifindex, XDP_FLAGS_SKB_MODE ) )
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not attach program to '%s' (%d)", interface_name, errno );
+            next_xdp_destroy( xdp );
+            return NULL;
+        }
+    }
+
+    // umem. the first half of the frames are for receive, the second half for send
+
+    xdp->umem_bytes = size_t( NEXT_XDP_FRAMES ) * NEXT_XDP_FRAME_BYTES;
+    xdp->umem = (uint8_t*) mmap( NULL, xdp->umem_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0 );
+    if ( xdp->umem == MAP_FAILED )
+    {
+        xdp->umem = NULL;
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+
+    xdp->xsk_handle = ::socket( AF_XDP, SOCK_RAW, 0 );
+    if ( xdp->xsk_handle < 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not create xsk (%d)", errno );
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+
+    xdp_umem_reg umem_reg;
+    memset( &umem_reg, 0, sizeof(umem_reg) );
+    umem_reg.addr = (uint64_t) xdp->umem;
+    umem_reg.len = xdp->umem_bytes;
+    umem_reg.chunk_size = NEXT_XDP_FRAME_BYTES;
+    if ( setsockopt( xdp->xsk_handle, SOL_XDP, XDP_UMEM_REG, &umem_reg, sizeof(umem_reg) ) != 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not register umem (%d)", errno );
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+
+    const int ring_entries = NEXT_XDP_RING_ENTRIES;
+    if ( setsockopt( xdp->xsk_handle, SOL_XDP, XDP_UMEM_FILL_RING, &ring_entries, sizeof(ring_entries) ) != 0 ||
+         setsockopt( xdp->xsk_handle, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_entries, sizeof(ring_entries) ) != 0 ||
+         setsockopt( xdp->xsk_handle, SOL_XDP, XDP_RX_RING, &ring_entries, sizeof(ring_entries) ) != 0 ||
+         setsockopt( xdp->xsk_handle, SOL_XDP, XDP_TX_RING, &ring_entries, sizeof(ring_entries) ) != 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not size rings (%d)", errno );
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+
+    xdp_mmap_offsets offsets;
+    socklen_t offsets_length = sizeof(offsets);
+    if ( getsockopt( xdp->xsk_handle, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsets_length ) != 0 ||
+         !next_xdp_map_ring( xdp->xsk_handle, &xdp->fill, &offsets.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING ) ||
+         !next_xdp_map_ring( xdp->xsk_handle, &xdp->completion, &offsets.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING ) ||
+         !next_xdp_map_ring( xdp->xsk_handle, &xdp->rx, &offsets.rx, sizeof(xdp_desc), XDP_PGOFF_RX_RING ) ||
+         !next_xdp_map_ring( xdp->xsk_handle, &xdp->tx, &offsets.tx, sizeof(xdp_desc), XDP_PGOFF_TX_RING ) )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not map rings (%d)", errno );
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+
+    uint64_t * fill_descriptors = (uint64_t*) xdp->fill.descriptors;
+    for ( int i = 0; i < NEXT_XDP_RING_ENTRIES; ++i )
+    {
+        fill_descriptors[i] = uint64_t( i ) * NEXT_XDP_FRAME_BYTES;
+    }
+    __atomic_store_n( xdp->fill.producer, uint32_t( NEXT_XDP_RING_ENTRIES ), __ATOMIC_RELEASE );
+
+    for ( int i = 0; i < NEXT_XDP_FRAMES / 2; ++i )
+    {
+        xdp->free_tx_frames[i] = uint64_t( NEXT_XDP_FRAMES / 2 + i ) * NEXT_XDP_FRAME_BYTES;
+    }
+    xdp->num_free_tx_frames = NEXT_XDP_FRAMES / 2;
+
+    sockaddr_xdp xsk_address;
+    memset( &xsk_address, 0, sizeof(xsk_address) );
+    xsk_address.sxdp_family = AF_XDP;
+    xsk_address.sxdp_ifindex = uint32_t( ifindex );
+    xsk_address.sxdp_queue_id = uint32_t( queue );
+    xsk_address.sxdp_flags = uint16_t( XDP_USE_NEED_WAKEUP | ( generic_mode ? XDP_COPY : 0 ) );
+    xdp->need_wakeup = true;
+    if ( bind( xdp->xsk_handle, (sockaddr*) &xsk_address, sizeof(xsk_address) ) != 0 )
+    {
+        xsk_address.sxdp_flags = uint16_t( generic_mode ? XDP_COPY : 0 );
+        xdp->need_wakeup = false;
+        if ( bind( xdp->xsk_handle, (sockaddr*) &xsk_address, sizeof(xsk_address) ) != 0 )
+        {
+            next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not bind xsk to '%s' queue %d (%d)", interface_name, queue, errno );
+            next_xdp_destroy( xdp );
+            return NULL;
+        }
+    }
+
+    if ( next_platform_mutex_create( &xdp->tx_mutex ) != NEXT_OK )
+    {
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+    xdp->tx_mutex_created = true;
+
+    uint32_t key = uint32_t( queue );
+    uint32_t value = uint32_t( xdp->xsk_handle );
+    memset( &attr, 0, sizeof(attr) );
+    attr.map_fd = uint32_t( xdp->map_handle );
+    attr.key = (uint64_t) &key;
+    attr.value = (uint64_t) &value;
+    if ( next_xdp_bpf( BPF_MAP_UPDATE_ELEM, &attr ) != 0 )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp could not add xsk to map (%d)", errno );
+        next_xdp_destroy( xdp );
+        return NULL;
+    }
+
+    next_printf( NEXT_LOG_LEVEL_INFO, "xdp attached to '%s' queue %d in %s mode", interface_name, queue, generic_mode ? "generic" : "native" );
+
+    next_xdp_verify_sentinels( xdp );
+
+    return xdp;
+}
+
+void next_xdp_destroy( next_xdp_t * xdp )
+{
+    next_xdp_verify_sentinels( xdp );
+
+    // closing the link detaches the program from the interface
+
+    if ( xdp->link_handle >= 0 )
+    {
+        close( xdp->link_handle );
+    }
+
+    if ( xdp->program_handle >= 0 )
+    {
+        close( xdp->program_handle );
+    }
+
+    if ( xdp->map_handle >= 0 )
+    {
+        close( xdp->map_handle );
+    }
+
+    next_xdp_unmap_ring( &xdp->fill );
+    next_xdp_unmap_ring( &xdp->completion );
+    next_xdp_unmap_ring( &xdp->rx );
+    next_xdp_unmap_ring( &xdp->tx );
+
+    if ( xdp->xsk_handle >= 0 )
+    {
+        close( xdp->xsk_handle );
+    }
+
+    if ( xdp->umem )
+    {
+        munmap( xdp->umem, xdp->umem_bytes );
+    }
+
+    if ( xdp->tx_mutex_created )
+    {
+        next_platform_mutex_destroy( &xdp->tx_mutex );
+    }
+
+    if ( next_xdp_batch == xdp )
+    {
+        next_xdp_batch = NULL;
+        next_xdp_batch_depth = 0;
+    }
+
+    next_free( xdp->context, xdp );
+}
+
+int next_xdp_handle( next_xdp_t * xdp )
+{
+    next_xdp_verify_sentinels( xdp );
+    return xdp->xsk_handle;
+}
+
+// ---------------------------------------------------------------
+
+static void next_xdp_kick( next_xdp_t * xdp )
+{
+    // IMPORTANT: call with the tx mutex held
+
+    if ( !xdp->tx_pending )
+        return;
+
+    xdp->tx_pending = false;
+
+    if ( xdp->need_wakeup && ( __atomic_load_n( xdp->tx.flags, __ATOMIC_ACQUIRE ) & XDP_RING_NEED_WAKEUP ) == 0 )
+        return;
+
+    if ( sendto( xdp->xsk_handle, NULL, 0, MSG_DONTWAIT, NULL, 0 ) < 0 && errno != EAGAIN && errno != EBUSY && errno != ENOBUFS && errno != ENETDOWN )
+    {
+        next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp tx wakeup failed (%d)", errno );
+    }
+}
+
+static void next_xdp_reclaim_tx_frames( next_xdp_t * xdp )
+{
+    // IMPORTANT: call with the tx mutex held
+
+    const uint64_t * completion_descriptors = (const uint64_t*) xdp->completion.descriptors;
+
+    uint32_t consumer = *xdp->completion.consumer;
+    const uint32_t producer = __atomic_load_n( xdp->completion.producer, __ATOMIC_ACQUIRE );
+
+    while ( consumer != producer )
+    {
+        next_assert( xdp->num_free_tx_frames < NEXT_XDP_FRAMES / 2 );
+        xdp->free_tx_frames[xdp->num_free_tx_frames++] = completion_descriptors[consumer & ( NEXT_XDP_RING_ENTRIES - 1 )];
+        consumer++;
+    }
+
+    __atomic_store_n( xdp->completion.consumer, consumer, __ATOMIC_RELEASE );
+}
+
+static uint16_t next_xdp_ipv4_checksum( const uint8_t * header )
+{
+    uint32_t sum = 0;
+    for ( int i = 0; i < NEXT_XDP_IPV4_HEADER_BYTES; i += 2 )
+    {
+        sum += next_xdp_read_uint16( header + i );
+    }
+    while ( sum >> 16 )
+    {
+        sum = ( sum & 0xFFFF ) + ( sum >> 16 );
+    }
+    return uint16_t( ~sum );
+}
+
+extern bool next_packet_tagging_enabled;
+
+bool next_xdp_send( next_xdp_t * xdp, const next_address_t * to, const void * packet_data, int packet_bytes )
+{
+    next_xdp_verify_sentinels( xdp );
+
+    next_assert( to );
+    next_assert( packet_data );
+    next_assert( packet_bytes > 0 );
+
+    if ( to->type != NEXT_ADDRESS_IPV4 || packet_bytes > NEXT_MAX_PACKET_BYTES )
+        return false;
+
+    uint32_t address;
+    memcpy( &address, to->data.ipv4, 4 );
+
+    next_platform_mutex_acquire( &xdp->tx_mutex );
+
+    const next_xdp_peer_t * peer = next_xdp_peer( xdp, address );
+    if ( peer->address != address )
+    {
+        // we haven't received from this peer through xdp yet, so we don't know where to send it
+        next_platform_mutex_release( &xdp->tx_mutex );
+        return false;
+    }
+
+    next_xdp_reclaim_tx_frames( xdp );
+
+    if ( xdp->num_free_tx_frames == 0 )
+    {
+        next_xdp_kick( xdp );
+        next_xdp_reclaim_tx_frames( xdp );
+    }
+
+    const uint32_t producer = *xdp->tx.producer;
+
+    if ( xdp->num_free_tx_frames == 0 || producer - __atomic_load_n( xdp->tx.consumer, __ATOMIC_ACQUIRE ) >= uint32_t( NEXT_XDP_RING_ENTRIES ) )
+    {
+        next_platform_mutex_release( &xdp->tx_mutex );
+        return false;
+    }
+
+    const uint64_t frame_address = xdp->free_tx_frames[--xdp->num_free_tx_frames];
+
+    uint8_t * frame = xdp->umem + frame_address;
+
+    memcpy( frame, peer->mac, 6 );
+    memcpy( frame + 6, peer->local_mac, 6 );
+    next_xdp_write_uint16( frame + 12, 0x0800 );
+
+    uint8_t * ip = frame + NEXT_XDP_ETHERNET_HEADER_BYTES;
+    ip[0] = 0x45;
+    ip[1] = next_packet_tagging_enabled ? 46 : 0;
+    next_xdp_write_uint16( ip + 2, uint16_t( NEXT_XDP_IPV4_HEADER_BYTES + NEXT_XDP_UDP_HEADER_BYTES + packet_bytes ) );
+    next_xdp_write_uint16( ip + 4, 0 );
+    next_xdp_write_uint16( ip + 6, 0x4000 );
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    next_xdp_write_uint16( ip + 10, 0 );
+    memcpy( ip + 12, &peer->local_address, 4 );
+    memcpy( ip + 16, &peer->address, 4 );
+    next_xdp_write_uint16( ip + 10, next_xdp_ipv4_checksum( ip ) );
+
+    // the udp checksum is optional for IPv4. packets are authenticated above this layer
+
+    uint8_t * udp = ip + NEXT_XDP_IPV4_HEADER_BYTES;
+    memcpy( udp, &xdp->port, 2 );
+    next_xdp_write_uint16( udp + 2, to->port );
+    next_xdp_write_uint16( udp + 4, uint16_t( NEXT_XDP_UDP_HEADER_BYTES + packet_bytes ) );
+    next_xdp_write_uint16( udp + 6, 0 );
+
+    memcpy( udp + NEXT_XDP_UDP_HEADER_BYTES, packet_data, packet_bytes );
+
+    xdp_desc * tx_descriptors = (xdp_desc*) xdp->tx.descriptors;
+    xdp_desc * descriptor = &tx_descriptors[producer & ( NEXT_XDP_RING_ENTRIES - 1 )];
+    descriptor->addr = frame_address;
+    descriptor->len = uint32_t( NEXT_XDP_HEADER_BYTES + packet_bytes );
+    descriptor->options = 0;
+
+    __atomic_store_n( xdp->tx.producer, producer + 1, __ATOMIC_RELEASE );
+
+    xdp->tx_pending = true;
+
+    if ( next_xdp_batch != xdp )
+    {
+        next_xdp_kick( xdp );
+    }
+
+    next_platform_mutex_release( &xdp->tx_mutex );
+
+    return true;
+}
+
+void next_xdp_send_batch_begin( next_xdp_t * xdp )
+{
+    next_xdp_verify_sentinels( xdp );
+
+    if ( next_xdp_batch != NULL && next_xdp_batch != xdp )
+        return;
+
+    next_xdp_batch = xdp;
+    next_xdp_batch_depth++;
+}
+
+void next_xdp_send_batch_end( next_xdp_t * xdp )
+{
+    next_xdp_verify_sentinels( xdp );
+
+    if ( next_xdp_batch != xdp )
+        return;
+
+    next_assert( next_xdp_batch_depth > 0 );
+
+    if ( --next_xdp_batch_depth > 0 )
+        return;
+
+    next_xdp_batch = NULL;
+
+    next_platform_mutex_acquire( &xdp->tx_mutex );
+    next_xdp_kick( xdp );
+    next_platform_mutex_release( &xdp->tx_mutex );
+}
+
+// ---------------------------------------------------------------
+
+static int next_xdp_read_frame( next_xdp_t * xdp, const uint8_t * frame, int frame_bytes, next_address_t * from, void * packet_data, int max_packet_size )
+{
+    if ( frame_bytes < NEXT_XDP_HEADER_BYTES || next_xdp_read_uint16( frame + 12 ) != 0x0800 )
+        return 0;
+
+    const uint8_t * ip = frame + NEXT_XDP_ETHERNET_HEADER_BYTES;
+    if ( ip[0] != 0x45 || ip[9] != IPPROTO_UDP )
+        return 0;
+
+    const uint8_t * udp = ip + NEXT_XDP_IPV4_HEADER_BYTES;
+    if ( memcmp( udp + 2, &xdp->port, 2 ) != 0 )
+        return 0;
+
+    const int udp_bytes = next_xdp_read_uint16( udp + 4 );
+    if ( udp_bytes <= NEXT_XDP_UDP_HEADER_BYTES || NEXT_XDP_ETHERNET_HEADER_BYTES + NEXT_XDP_IPV4_HEADER_BYTES + udp_bytes > frame_bytes )
+        return 0;
+
+    const int packet_bytes = udp_bytes - NEXT_XDP_UDP_HEADER_BYTES;
+    if ( packet_bytes > max_packet_size )
+        return 0;
+
+    memset( from, 0, sizeof(next_address_t) );
+    from->type = NEXT_ADDRESS_IPV4;
+    memcpy( from->data.ipv4, ip + 12, 4 );
+    from->port = next_xdp_read_uint16( udp );
+
+    memcpy( packet_data, udp + NEXT_XDP_UDP_HEADER_BYTES, packet_bytes );
+
+    // learn where to send packets to this peer. only take the lock when something changed. loopback peers are never learned,
+    // because frames we send to a loopback address have no route attached and the kernel drops them as martians
+
+    if ( ip[12] == 127 )
+        return packet_bytes;
+
+    uint32_t address;
+    uint32_t local_address;
+    memcpy( &address, ip + 12, 4 );
+    memcpy( &local_address, ip + 16, 4 );
+
+    next_xdp_peer_t * peer = next_xdp_peer( xdp, address );
+    if ( peer->address != address || peer->local_address != local_address || memcmp( peer->mac, frame + 6, 6 ) != 0 || memcmp( peer->local_mac, frame, 6 ) != 0 )
+    {
+        next_platform_mutex_acquire( &xdp->tx_mutex );
+        peer->address = address;
+        peer->local_address = local_address;
+        memcpy( peer->mac, frame + 6, 6 );
+        memcpy( peer->local_mac, frame, 6 );
+        next_platform_mutex_release( &xdp->tx_mutex );
+    }
+
+    return packet_bytes;
+}
+
+int next_xdp_receive( next_xdp_t * xdp, next_address_t * from, void * packet_data, int max_packet_size )
+{
+    next_xdp_verify_sentinels( xdp );
+
+    next_assert( from );
+    next_assert( packet_data );
+
+    const xdp_desc * rx_descriptors = (const xdp_desc*) xdp->rx.descriptors;
+    uint64_t * fill_descriptors = (uint64_t*) xdp->fill.descriptors;
+
+    while ( true )
+    {
+        const uint32_t consumer = *xdp->rx.consumer;
+
+        if ( consumer == __atomic_load_n( xdp->rx.producer, __ATOMIC_ACQUIRE ) )
+        {
+            if ( xdp->need_wakeup && ( __atomic_load_n( xdp->fill.flags, __ATOMIC_ACQUIRE ) & XDP_RING_NEED_WAKEUP ) )
+            {
+                recvfrom( xdp->xsk_handle, NULL, 0, MSG_DONTWAIT, NULL, NULL );
+            }
+            return 0;
+        }
+
+        const xdp_desc descriptor = rx_descriptors[consumer & ( NEXT_XDP_RING_ENTRIES - 1 )];
+
+        __atomic_store_n( xdp->rx.consumer, consumer + 1, __ATOMIC_RELEASE );
+
+        const int packet_bytes = next_xdp_read_frame( xdp, xdp->umem + descriptor.addr, int( descriptor.len ), from, packet_data, max_packet_size );
+
+        // give the frame back to the kernel. the fill ring always has room, since there are only as many receive frames as entries
+
+        const uint32_t fill_producer = *xdp->fill.producer;
+        fill_descriptors[fill_producer & ( NEXT_XDP_RING_ENTRIES - 1 )] = descriptor.addr - ( descriptor.addr % NEXT_XDP_FRAME_BYTES );
+        __atomic_store_n( xdp->fill.producer, fill_producer + 1, __ATOMIC_RELEASE );
+
+        if ( packet_bytes > 0 )
+            return packet_bytes;
+    }
+}
+
+#else // #if NEXT_XDP_HEADERS
+
+next_xdp_t * next_xdp_create( void * context, const char * interface_name, int queue, uint16_t port )
+{
+    (void) context;
+    (void) interface_name;
+    (void) queue;
+    (void) port;
+    next_printf( NEXT_LOG_LEVEL_DEBUG, "xdp headers were not available at build time" );
+    return NULL;
+}
+
+void next_xdp_destroy( next_xdp_t * ) {}
+
+int next_xdp_handle( next_xdp_t * ) { return -1; }
+
+bool next_xdp_send( next_xdp_t *, const next_address_t *, const void *, int ) { return false; }
+
+void next_xdp_send_batch_begin( next_xdp_t * ) {}
+
+void next_xdp_send_batch_end( next_xdp_t * ) {}
+
+int next_xdp_receive( next_xdp_t *, next_address_t *, void *, int ) { return 0; }
+
+#endif // #if NEXT_XDP_HEADERS
+
+#else // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX
+
+int next_xdp_dummy_symbol = 0;
+
+#endif // #if NEXT_PLATFORM == NEXT_PLATFORM_LINUX